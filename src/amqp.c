@@ -821,12 +821,16 @@ static int camqp_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
       return status;
     }
   } else if (conf->format == CAMQP_FORMAT_JSON) {
-    size_t bfree = sizeof(buffer);
-    size_t bfill = 0;
-
-    format_json_initialize(buffer, &bfill, &bfree);
-    format_json_value_list(buffer, &bfill, &bfree, ds, vl, conf->store_rates);
-    format_json_finalize(buffer, &bfill, &bfree);
+    json_encoder_t e;
+    json_encoder_init_fixed(&e, buffer, sizeof(buffer));
+    json_encoder_array_open(&e);
+    status = format_json_encode_value_list(&e, ds, vl, conf->store_rates);
+    json_encoder_array_close(&e);
+    if (status != 0) {
+      ERROR("amqp plugin: format_json_encode_value_list failed with status %i.",
+            status);
+      return status;
+    }
   } else if (conf->format == CAMQP_FORMAT_GRAPHITE) {
     status =
         format_graphite(buffer, sizeof(buffer), ds, vl, conf->prefix,
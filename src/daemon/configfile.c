@@ -110,6 +110,7 @@ static cf_global_option_t cf_global_options[] = {
     {"WriteThreads", NULL, 0, "5"},
     {"WriteQueueLimitHigh", NULL, 0, NULL},
     {"WriteQueueLimitLow", NULL, 0, NULL},
+    {"WriteQueueImplementation", NULL, 0, "List"},
     {"Timeout", NULL, 0, "2"},
     {"AutoLoadPlugin", NULL, 0, "false"},
     {"CollectInternalStats", NULL, 0, "false"},
@@ -445,6 +446,10 @@ static int dispatch_block(oconfig_item_t *ci) {
     return dispatch_block_plugin(ci);
   else if (strcasecmp(ci->key, "Chain") == 0)
     return fc_configure(ci);
+  else if (strcasecmp(ci->key, "ReadThreadGroup") == 0)
+    return plugin_configure_read_thread_group(ci);
+  else if (strcasecmp(ci->key, "WriteSpill") == 0)
+    return plugin_configure_write_spill(ci);
 
   return 0;
 }
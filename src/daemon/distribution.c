@@ -1,148 +1,464 @@
-#include <math.h>
+/**
+ * collectd - src/daemon/distribution.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
 #include "collectd.h"
+
 #include "distribution.h"
 
-struct bucket_s{
-	size_t bucket_counter;
-	double min_boundary;
-	double max_boundary;
-};
+#include <math.h>
+
+#define LAYOUT_LINEAR 1
+#define LAYOUT_EXPONENTIAL 2
+#define LAYOUT_LOG_LINEAR 3
+#define LAYOUT_CUSTOM 4
 
 struct distribution_s {
-     bucket_t *buckets;
-     size_t num_buckets;
-     size_t total_scalar_count;
-     double raw_data_sum;
+  int layout;
+
+  /* Parameters of the layout. The bounds of all but custom layouts are
+   * computed, so that large distributions only need memory for the
+   * counters. */
+  double size;            /* linear */
+  double initial_size;    /* exponential */
+  double factor;          /* exponential */
+  double log_factor;      /* exponential */
+  int lowest_exp;         /* log-linear: the first bound is 2^lowest_exp */
+  size_t sub_buckets;     /* log-linear */
+  double *bounds;         /* custom */
+
+  size_t num_buckets;
+  uint64_t *counters;
+  uint64_t count;
+  double sum;
 };
 
-//bucket constructor
-bucket_t initialize_bucket(double min_boundary, double max_boundary) {
-    bucket_t new_bucket = {
-        .bucket_counter = 0,
-        .min_boundary = min_boundary,
-        .max_boundary = max_boundary,
-    };
-    return new_bucket;
-} 
-
-//increment bucket_counter of specific bucket
-void increment(bucket_t *bucket) { 
-    bucket->bucket_counter++;
-} 
-
-distribution_t * distribution_new_linear(size_t num_buckets, double size) {
-    distribution_t *new_distribution = calloc(1, sizeof(distribution_t));
-    new_distribution->buckets = calloc(num_buckets, sizeof(bucket_t));
-
-   for(size_t i = 0; i < num_buckets; i++)
-    {
-        if(i == 0)
-        {
-            new_distribution->buckets[i] = initialize_bucket(0, size);
-        }
-        else if(i < num_buckets - 1)
-        {
-            new_distribution->buckets[i] = initialize_bucket(i * size + 1, i*size + size);
-        }
-        else 
-        {
-            new_distribution->buckets[i] = initialize_bucket(new_distribution->buckets[i - 1].max_boundary + 1, INFINITY);
-        }
-    }
-    
-    new_distribution->num_buckets = num_buckets;
-    new_distribution->total_scalar_count = 0;
-    new_distribution->raw_data_sum = 0;
-}
-
-distribution_t * distribution_new_exponential(size_t num_buckets, double initial_size, double factor) {
-    distribution_t *new_distribution = calloc(1, sizeof(distribution_t));
-    new_distribution->buckets = calloc(num_buckets, sizeof(bucket_t));
-    double previous_bucket_size;
-    double new_max;
-
-    for(int i = 0; i < num_buckets; i++)
-    {
-        if(i == 0)
-        {
-            new_distribution->buckets[i] = initialize_bucket(0, initial_size);
-        }
-        else if(i < num_buckets - 1)
-        {
-            previous_bucket_size = new_distribution->buckets[i - 1].max_boundary - new_distribution->buckets[i - 1].min_boundary;
-            new_max = new_distribution->buckets[i - 1].max_boundary + previous_bucket_size * factor;
-            new_distribution->buckets[i] = initialize_bucket(new_distribution->buckets[i - 1].max_boundary + 1, new_max);
-        }
-        else
-        {
-            new_distribution->buckets[i] = initialize_bucket(new_distribution->buckets[i - 1].max_boundary + 1, INFINITY);
-        }
-        
-    }
-    
-    new_distribution->num_buckets = num_buckets;
-    new_distribution->total_scalar_count = 0;
-    new_distribution->raw_data_sum = 0;
-}
-
-distribution_t * distribution_new_custom(size_t num_buckets, double *custom_buckets_sizes) {
-    distribution_t *new_distribution = calloc(1, sizeof(distribution_t));
-    new_distribution->buckets = calloc(num_buckets, sizeof(bucket_t));
-
-    for(size_t i = 0; i < num_buckets; i++)
-    {
-        if(i == 0)
-        {
-            new_distribution->buckets[i] = initialize_bucket(0, custom_buckets_sizes[0]);
-        }
-        else if(i < num_buckets - 1)
-        {
-            new_distribution->buckets[i] = initialize_bucket(new_distribution->buckets[i - 1].max_boundary + 1, custom_buckets_sizes[i]);
-        }
-        else
-        {
-            new_distribution->buckets[i] = initialize_bucket(new_distribution->buckets[i - 1].max_boundary + 1, INFINITY);
-        }
+static distribution_t *distribution_alloc(int layout, /* {{{ */
+                                          size_t num_buckets) {
+  if (num_buckets == 0)
+    return NULL;
+
+  distribution_t *d = calloc(1, sizeof(*d));
+  if (d == NULL)
+    return NULL;
+
+  d->counters = calloc(num_buckets, sizeof(*d->counters));
+  if (d->counters == NULL) {
+    free(d);
+    return NULL;
+  }
+
+  d->layout = layout;
+  d->num_buckets = num_buckets;
+  return d;
+} /* }}} distribution_t *distribution_alloc */
+
+distribution_t *distribution_new_linear(size_t num_buckets, /* {{{ */
+                                        double size) {
+  if (!(size > 0) || !isfinite(size))
+    return NULL;
+
+  distribution_t *d = distribution_alloc(LAYOUT_LINEAR, num_buckets);
+  if (d == NULL)
+    return NULL;
+
+  d->size = size;
+  return d;
+} /* }}} distribution_t *distribution_new_linear */
+
+distribution_t *distribution_new_exponential(size_t num_buckets, /* {{{ */
+                                             double initial_size,
+                                             double factor) {
+  if (!(initial_size > 0) || !isfinite(initial_size) || !(factor > 1) ||
+      !isfinite(factor))
+    return NULL;
+
+  distribution_t *d = distribution_alloc(LAYOUT_EXPONENTIAL, num_buckets);
+  if (d == NULL)
+    return NULL;
+
+  d->initial_size = initial_size;
+  d->factor = factor;
+  d->log_factor = log(factor);
+  return d;
+} /* }}} distribution_t *distribution_new_exponential */
+
+distribution_t *distribution_new_log_linear(double lowest, /* {{{ */
+                                            double highest,
+                                            size_t sub_buckets) {
+  if (!(lowest > 0) || !isfinite(highest) || !(highest > lowest) ||
+      (sub_buckets == 0) || ((sub_buckets & (sub_buckets - 1)) != 0))
+    return NULL;
+
+  /* Round `lowest' down and `highest' up to a power of two. */
+  int lowest_exp;
+  frexp(lowest, &lowest_exp);
+  lowest_exp--;
+
+  int highest_exp;
+  double m = frexp(highest, &highest_exp);
+  if (m == 0.5)
+    highest_exp--;
+
+  /* One bucket up to 2^lowest_exp, `sub_buckets' buckets per power of two and
+   * one bucket for the values above 2^highest_exp. */
+  size_t octaves = (size_t)(highest_exp - lowest_exp);
+  distribution_t *d =
+      distribution_alloc(LAYOUT_LOG_LINEAR, 2 + octaves * sub_buckets);
+  if (d == NULL)
+    return NULL;
+
+  d->lowest_exp = lowest_exp;
+  d->sub_buckets = sub_buckets;
+  return d;
+} /* }}} distribution_t *distribution_new_log_linear */
+
+distribution_t *distribution_new_custom(size_t num_bounds, /* {{{ */
+                                        double const *bounds) {
+  if ((num_bounds == 0) || (bounds == NULL))
+    return NULL;
+
+  for (size_t i = 0; i < num_bounds; i++) {
+    if (isnan(bounds[i]) || ((i > 0) && !(bounds[i] > bounds[i - 1])))
+      return NULL;
+  }
+
+  size_t num_buckets = num_bounds;
+  if (!isinf(bounds[num_bounds - 1]))
+    num_buckets++;
+
+  distribution_t *d = distribution_alloc(LAYOUT_CUSTOM, num_buckets);
+  if (d == NULL)
+    return NULL;
+
+  d->bounds = calloc(num_buckets, sizeof(*d->bounds));
+  if (d->bounds == NULL) {
+    distribution_destroy(d);
+    return NULL;
+  }
+  memcpy(d->bounds, bounds, num_bounds * sizeof(*bounds));
+  d->bounds[num_buckets - 1] = INFINITY;
+
+  return d;
+} /* }}} distribution_t *distribution_new_custom */
+
+void distribution_destroy(distribution_t *dist) /* {{{ */
+{
+  if (dist == NULL)
+    return;
+
+  free(dist->bounds);
+  free(dist->counters);
+  free(dist);
+} /* }}} void distribution_destroy */
+
+double distribution_bucket_bound(distribution_t const *dist, /* {{{ */
+                                 size_t index) {
+  if ((dist == NULL) || (index >= dist->num_buckets))
+    return NAN;
+  if (index == dist->num_buckets - 1)
+    return INFINITY;
+
+  switch (dist->layout) {
+  case LAYOUT_LINEAR:
+    return ((double)(index + 1)) * dist->size;
+  case LAYOUT_EXPONENTIAL:
+    return dist->initial_size * pow(dist->factor, (double)index);
+  case LAYOUT_LOG_LINEAR: {
+    if (index == 0)
+      return ldexp(1.0, dist->lowest_exp);
+    size_t octave = (index - 1) / dist->sub_buckets;
+    size_t sub = (index - 1) % dist->sub_buckets + 1;
+    return ldexp(1.0 + ((double)sub) / ((double)dist->sub_buckets),
+                 dist->lowest_exp + (int)octave);
+  }
+  default:
+    return dist->bounds[index];
+  }
+} /* }}} double distribution_bucket_bound */
+
+/* Returns the index of the bucket `value' belongs to. The layouts with
+ * computed bounds estimate the index in constant time and correct rounding
+ * errors by comparing with the bounds. */
+static size_t distribution_find_bucket(distribution_t const *d, /* {{{ */
+                                       double value) {
+  size_t last = d->num_buckets - 1;
+  double guess = 0.0;
+
+  switch (d->layout) {
+  case LAYOUT_LINEAR:
+    guess = ceil(value / d->size) - 1.0;
+    break;
+  case LAYOUT_EXPONENTIAL:
+    if (value > d->initial_size)
+      guess = ceil(log(value / d->initial_size) / d->log_factor);
+    break;
+  case LAYOUT_LOG_LINEAR:
+    if (value > ldexp(1.0, d->lowest_exp)) {
+      int exp;
+      double m = frexp(value, &exp); /* value = 2m * 2^(exp-1) */
+      guess = 1.0 + ((double)(exp - 1 - d->lowest_exp)) * d->sub_buckets +
+              floor((2.0 * m - 1.0) * d->sub_buckets);
     }
-    
-    new_distribution->num_buckets = num_buckets;
-    new_distribution->total_scalar_count = 0;
-    new_distribution->raw_data_sum = 0;
-}
-
-void distribution_update(distribution_t *dist, double gauge) {
-    for(size_t i = 0; i < dist->num_buckets; i++)
-    {
-        if(gauge >= dist->buckets[i].min_boundary && gauge <= dist->buckets[i].max_boundary)
-        {
-            dist->buckets[i].bucket_counter++;
-        }
+    break;
+  default: {
+    size_t lo = 0;
+    size_t hi = last;
+    while (lo < hi) {
+      size_t mid = lo + (hi - lo) / 2;
+      if (value <= d->bounds[mid])
+        hi = mid;
+      else
+        lo = mid + 1;
     }
-}
-
-double distribution_average(distribution_t *dist) {
-    return dist->raw_data_sum / dist->total_scalar_count;
-}
-
-int distribution_percentile(distribution_t *dist, uint8_t percent) {
-    int sum = 0;
-    int bound = 0;
-    double target_amount = (percent * 100) / dist->num_buckets;
-    for(size_t i = 0; i < dist->num_buckets; i++)
-    {
-        sum += dist->buckets[i].bucket_counter;
-        if(sum >= target_amount)
-        {
-            bound = dist->buckets[i].max_boundary;
-            break;
-        }
+    return lo;
+  }
+  }
+
+  if (!(guess > 0.0))
+    guess = 0.0;
+  if (!(guess < (double)last))
+    guess = (double)last;
+
+  size_t index = (size_t)guess;
+  while ((index > 0) && (value <= distribution_bucket_bound(d, index - 1)))
+    index--;
+  while ((index < last) && (value > distribution_bucket_bound(d, index)))
+    index++;
+
+  return index;
+} /* }}} size_t distribution_find_bucket */
+
+static void atomic_add_double(double *dst, double value) /* {{{ */
+{
+  double old_value;
+  double new_value;
+
+  __atomic_load(dst, &old_value, __ATOMIC_RELAXED);
+  do {
+    new_value = old_value + value;
+  } while (!__atomic_compare_exchange(dst, &old_value, &new_value,
+                                      /* weak = */ true, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED));
+} /* }}} void atomic_add_double */
+
+void distribution_update(distribution_t *dist, double value) /* {{{ */
+{
+  if ((dist == NULL) || isnan(value))
+    return;
+
+  size_t index = distribution_find_bucket(dist, value);
+  __atomic_fetch_add(&dist->counters[index], 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&dist->count, 1, __ATOMIC_RELAXED);
+  atomic_add_double(&dist->sum, value);
+} /* }}} void distribution_update */
+
+void distribution_reset(distribution_t *dist) /* {{{ */
+{
+  if (dist == NULL)
+    return;
+
+  double zero = 0.0;
+  for (size_t i = 0; i < dist->num_buckets; i++)
+    __atomic_store_n(&dist->counters[i], 0, __ATOMIC_RELAXED);
+  __atomic_store_n(&dist->count, 0, __ATOMIC_RELAXED);
+  __atomic_store(&dist->sum, &zero, __ATOMIC_RELAXED);
+} /* }}} void distribution_reset */
+
+static bool distribution_same_layout(distribution_t const *a, /* {{{ */
+                                     distribution_t const *b) {
+  if ((a->layout != b->layout) || (a->num_buckets != b->num_buckets))
+    return false;
+
+  switch (a->layout) {
+  case LAYOUT_LINEAR:
+    return a->size == b->size;
+  case LAYOUT_EXPONENTIAL:
+    return (a->initial_size == b->initial_size) && (a->factor == b->factor);
+  case LAYOUT_LOG_LINEAR:
+    return (a->lowest_exp == b->lowest_exp) &&
+           (a->sub_buckets == b->sub_buckets);
+  default:
+    return memcmp(a->bounds, b->bounds, a->num_buckets * sizeof(*a->bounds)) ==
+           0;
+  }
+} /* }}} bool distribution_same_layout */
+
+distribution_t *distribution_clone(distribution_t const *dist) /* {{{ */
+{
+  if (dist == NULL)
+    return NULL;
+
+  distribution_t *d = distribution_alloc(dist->layout, dist->num_buckets);
+  if (d == NULL)
+    return NULL;
+
+  d->size = dist->size;
+  d->initial_size = dist->initial_size;
+  d->factor = dist->factor;
+  d->log_factor = dist->log_factor;
+  d->lowest_exp = dist->lowest_exp;
+  d->sub_buckets = dist->sub_buckets;
+  if (dist->bounds != NULL) {
+    d->bounds = calloc(dist->num_buckets, sizeof(*d->bounds));
+    if (d->bounds == NULL) {
+      distribution_destroy(d);
+      return NULL;
     }
-    return bound;
-}
+    memcpy(d->bounds, dist->bounds, dist->num_buckets * sizeof(*d->bounds));
+  }
+
+  for (size_t i = 0; i < dist->num_buckets; i++) {
+    d->counters[i] = __atomic_load_n(&dist->counters[i], __ATOMIC_RELAXED);
+    d->count += d->counters[i];
+  }
+  __atomic_load(&dist->sum, &d->sum, __ATOMIC_RELAXED);
+
+  return d;
+} /* }}} distribution_t *distribution_clone */
+
+int distribution_merge(distribution_t *dst, /* {{{ */
+                       distribution_t const *src) {
+  if ((dst == NULL) || (src == NULL) || !distribution_same_layout(dst, src))
+    return EINVAL;
+
+  for (size_t i = 0; i < src->num_buckets; i++) {
+    uint64_t n = __atomic_load_n(&src->counters[i], __ATOMIC_RELAXED);
+    if (n != 0)
+      __atomic_fetch_add(&dst->counters[i], n, __ATOMIC_RELAXED);
+  }
+  __atomic_fetch_add(&dst->count,
+                     __atomic_load_n(&src->count, __ATOMIC_RELAXED),
+                     __ATOMIC_RELAXED);
+
+  double sum;
+  __atomic_load(&src->sum, &sum, __ATOMIC_RELAXED);
+  atomic_add_double(&dst->sum, sum);
+
+  return 0;
+} /* }}} int distribution_merge */
+
+distribution_t *distribution_delta(distribution_t const *curr, /* {{{ */
+                                   distribution_t const *prev) {
+  if ((curr == NULL) || (prev == NULL) || !distribution_same_layout(curr, prev))
+    return NULL;
+
+  distribution_t *d = distribution_clone(curr);
+  if (d == NULL)
+    return NULL;
+
+  /* If any bucket went down, `curr' has been reset after `prev' was taken and
+   * all of its values are new. */
+  for (size_t i = 0; i < d->num_buckets; i++) {
+    if (d->counters[i] < __atomic_load_n(&prev->counters[i], __ATOMIC_RELAXED))
+      return d;
+  }
+
+  double prev_sum;
+  __atomic_load(&prev->sum, &prev_sum, __ATOMIC_RELAXED);
+
+  d->count = 0;
+  for (size_t i = 0; i < d->num_buckets; i++) {
+    d->counters[i] -= __atomic_load_n(&prev->counters[i], __ATOMIC_RELAXED);
+    d->count += d->counters[i];
+  }
+  d->sum -= prev_sum;
+
+  return d;
+} /* }}} distribution_t *distribution_delta */
+
+size_t distribution_num_buckets(distribution_t const *dist) /* {{{ */
+{
+  if (dist == NULL)
+    return 0;
+  return dist->num_buckets;
+} /* }}} size_t distribution_num_buckets */
+
+uint64_t distribution_bucket_count(distribution_t const *dist, /* {{{ */
+                                   size_t index) {
+  if ((dist == NULL) || (index >= dist->num_buckets))
+    return 0;
+  return __atomic_load_n(&dist->counters[index], __ATOMIC_RELAXED);
+} /* }}} uint64_t distribution_bucket_count */
+
+uint64_t distribution_count(distribution_t const *dist) /* {{{ */
+{
+  if (dist == NULL)
+    return 0;
+  return __atomic_load_n(&dist->count, __ATOMIC_RELAXED);
+} /* }}} uint64_t distribution_count */
+
+double distribution_sum(distribution_t const *dist) /* {{{ */
+{
+  if (dist == NULL)
+    return NAN;
+
+  double sum;
+  __atomic_load(&dist->sum, &sum, __ATOMIC_RELAXED);
+  return sum;
+} /* }}} double distribution_sum */
+
+double distribution_average(distribution_t const *dist) /* {{{ */
+{
+  uint64_t count = distribution_count(dist);
+  if (count == 0)
+    return NAN;
+
+  return distribution_sum(dist) / ((double)count);
+} /* }}} double distribution_average */
+
+double distribution_percentile(distribution_t const *dist, /* {{{ */
+                               double percent) {
+  if ((dist == NULL) || !((percent > 0.0) && (percent <= 100.0)))
+    return NAN;
+
+  /* Sum the buckets rather than using `count', which may be ahead of the
+   * buckets while the distribution is updated. */
+  uint64_t total = 0;
+  for (size_t i = 0; i < dist->num_buckets; i++)
+    total += distribution_bucket_count(dist, i);
+  if (total == 0)
+    return NAN;
+
+  double target = ((double)total) * percent / 100.0;
+  uint64_t sum_lower = 0;
+  uint64_t sum_upper = 0;
+  size_t index;
+  for (index = 0; index < dist->num_buckets; index++) {
+    sum_lower = sum_upper;
+    sum_upper += distribution_bucket_count(dist, index);
+    if (((double)sum_upper) >= target)
+      break;
+  }
 
-void distribution_destroy(distribution_t *dist) {
-    free(dist->buckets);
-    free(dist);
-}
+  if (index == 0)
+    return distribution_bucket_bound(dist, 0);
+  if (index >= dist->num_buckets - 1)
+    return distribution_bucket_bound(dist, dist->num_buckets - 2);
 
+  double lower = distribution_bucket_bound(dist, index - 1);
+  double upper = distribution_bucket_bound(dist, index);
+  double p = (target - ((double)sum_lower)) /
+             ((double)(sum_upper - sum_lower));
 
+  return lower + p * (upper - lower);
+} /* }}} double distribution_percentile */
@@ -1,17 +1,181 @@
-#include "collectd.h"
+/**
+ * collectd - src/daemon/distribution.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef DAEMON_DISTRIBUTION_H
+#define DAEMON_DISTRIBUTION_H 1
 
-struct bucket_s;
-typedef struct bucket_s bucket_t;
+#include "collectd.h"
 
+/*
+ * A distribution counts values in buckets. Bucket i holds the values v with
+ * bound(i-1) < v <= bound(i); the first bucket has no lower bound and the
+ * upper bound of the last bucket is infinity. This matches the "le" buckets of
+ * Prometheus histograms.
+ *
+ * distribution_update() does not take a lock and may be called concurrently
+ * with all other functions but distribution_destroy(). The bucket is found in
+ * constant time for linear, exponential and log-linear layouts and in
+ * logarithmic time for custom layouts, and the counters are updated
+ * atomically. While a distribution is being updated, its count and sum may
+ * not match its buckets exactly; distribution_clone() returns a snapshot
+ * whose count is the sum of its buckets.
+ */
 struct distribution_s;
 typedef struct distribution_s distribution_t;
 
+/*
+ * NAME
+ *   distribution_new_linear
+ *
+ * DESCRIPTION
+ *   Creates a distribution with `num_buckets' buckets of width `size'. The
+ *   upper bound of bucket i is (i + 1) * size.
+ *
+ * RETURN VALUE
+ *   The new distribution or NULL on error.
+ */
+distribution_t *distribution_new_linear(size_t num_buckets, double size);
+
+/*
+ * NAME
+ *   distribution_new_exponential
+ *
+ * DESCRIPTION
+ *   Creates a distribution with `num_buckets' buckets. The upper bound of
+ *   bucket i is initial_size * factor^i; `factor' must be greater than one.
+ *
+ * RETURN VALUE
+ *   The new distribution or NULL on error.
+ */
+distribution_t *distribution_new_exponential(size_t num_buckets,
+                                             double initial_size,
+                                             double factor);
+
+/*
+ * NAME
+ *   distribution_new_log_linear
+ *
+ * DESCRIPTION
+ *   Creates a distribution in the style of an HDR histogram: every power of
+ *   two between `lowest' and `highest' is split into `sub_buckets' buckets of
+ *   equal width, so the relative error is at most 1 / sub_buckets over the
+ *   whole range. Values up to `lowest' go into the first bucket, values above
+ *   `highest' into the last. `lowest' and `highest' are rounded to powers of
+ *   two and `sub_buckets' must be a power of two.
+ *
+ * RETURN VALUE
+ *   The new distribution or NULL on error.
+ */
+distribution_t *distribution_new_log_linear(double lowest, double highest,
+                                            size_t sub_buckets);
+
+/*
+ * NAME
+ *   distribution_new_custom
+ *
+ * DESCRIPTION
+ *   Creates a distribution with the ascending upper bounds `bounds'. A bucket
+ *   with an infinite upper bound is added unless the last bound is infinite.
+ *
+ * RETURN VALUE
+ *   The new distribution or NULL on error.
+ */
+distribution_t *distribution_new_custom(size_t num_bounds,
+                                        double const *bounds);
+
+void distribution_destroy(distribution_t *dist);
+
+/* Adds `value' to the distribution. NaN is ignored. */
+void distribution_update(distribution_t *dist, double value);
+
+/* Resets all counters to zero. */
+void distribution_reset(distribution_t *dist);
+
+/*
+ * NAME
+ *   distribution_clone
+ *
+ * DESCRIPTION
+ *   Returns a snapshot of `dist' with the same bucket layout. The count of the
+ *   snapshot is the sum of its buckets.
+ *
+ * RETURN VALUE
+ *   The copy or NULL on error.
+ */
+distribution_t *distribution_clone(distribution_t const *dist);
+
+/*
+ * NAME
+ *   distribution_merge
+ *
+ * DESCRIPTION
+ *   Adds the counters of `src' to `dst'. Both must have the same bucket
+ *   layout.
+ *
+ * RETURN VALUE
+ *   Zero on success, EINVAL if the layouts differ.
+ */
+int distribution_merge(distribution_t *dst, distribution_t const *src);
+
+/*
+ * NAME
+ *   distribution_delta
+ *
+ * DESCRIPTION
+ *   Returns a distribution holding the values added to `curr' since the
+ *   snapshot `prev' was taken. Both must have the same bucket layout and
+ *   `curr' is usually a newer snapshot of the same distribution.
+ *
+ * RETURN VALUE
+ *   The difference or NULL if the layouts differ or on error.
+ */
+distribution_t *distribution_delta(distribution_t const *curr,
+                                   distribution_t const *prev);
+
+size_t distribution_num_buckets(distribution_t const *dist);
+/* Returns the upper bound of bucket `index'. */
+double distribution_bucket_bound(distribution_t const *dist, size_t index);
+uint64_t distribution_bucket_count(distribution_t const *dist, size_t index);
+
+uint64_t distribution_count(distribution_t const *dist);
+double distribution_sum(distribution_t const *dist);
+/* Returns NaN if the distribution is empty. */
+double distribution_average(distribution_t const *dist);
 
-distribution_t * distribution_new_linear(size_t no_buckets, double size);
-distribution_t * distribution_new_exponential(size_t no_buckets, double initial_size, double factor);
-distribution_t * distribution_new_custom(size_t no_buckets, double *custom_buckets_sizes);
+/*
+ * NAME
+ *   distribution_percentile
+ *
+ * DESCRIPTION
+ *   Estimates the value below which `percent' percent of the values fall by
+ *   interpolating linearly within the bucket the percentile falls into. For
+ *   the first bucket its upper bound and for the last bucket its lower bound
+ *   is returned.
+ *
+ * RETURN VALUE
+ *   The estimate or NaN if the distribution is empty or `percent' is not in
+ *   the (0, 100] range.
+ */
+double distribution_percentile(distribution_t const *dist, double percent);
 
-void distribution_update(distribution_t *dist, double gauge);
-int distribution_percentile(distribution_t *dist, uint8_t percent);
-double distribution_average(distribution_t *dist);
-void distribution_destroy(distribution_t *d);
+#endif /* DAEMON_DISTRIBUTION_H */
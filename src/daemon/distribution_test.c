@@ -0,0 +1,281 @@
+/**
+ * collectd - src/daemon/distribution_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#define DBL_PRECISION 1e-9
+
+#include "collectd.h"
+#include "utils/common/common.h" /* for STATIC_ARRAY_SIZE */
+
+#include "distribution.h"
+#include "testing.h"
+
+#include <math.h>
+#include <pthread.h>
+
+#define UPDATE_THREADS 4
+#define UPDATE_VALUES 100000
+
+/* Returns the index of the bucket `value' was counted in. */
+static size_t bucket_of(distribution_t *d, double value) {
+  distribution_t *before = distribution_clone(d);
+  distribution_update(d, value);
+
+  size_t index = distribution_num_buckets(d);
+  for (size_t i = 0; i < distribution_num_buckets(d); i++) {
+    if (distribution_bucket_count(d, i) != distribution_bucket_count(before, i))
+      index = i;
+  }
+
+  distribution_destroy(before);
+  return index;
+}
+
+DEF_TEST(linear) {
+  distribution_t *d;
+  CHECK_NOT_NULL(d = distribution_new_linear(5, 10.0));
+
+  EXPECT_EQ_INT(5, (int)distribution_num_buckets(d));
+  EXPECT_EQ_DOUBLE(10.0, distribution_bucket_bound(d, 0));
+  EXPECT_EQ_DOUBLE(40.0, distribution_bucket_bound(d, 3));
+  EXPECT_EQ_DOUBLE(INFINITY, distribution_bucket_bound(d, 4));
+
+  struct {
+    double value;
+    size_t want;
+  } cases[] = {
+      {-5.0, 0}, {0.0, 0}, {10.0, 0}, {10.5, 1}, {20.0, 1},
+      {39.9, 3}, {40.0, 3}, {40.1, 4}, {1e9, 4}, {INFINITY, 4},
+  };
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    printf("# linear: value = %g\n", cases[i].value);
+    EXPECT_EQ_INT((int)cases[i].want, (int)bucket_of(d, cases[i].value));
+  }
+
+  distribution_destroy(d);
+  return 0;
+}
+
+DEF_TEST(exponential) {
+  distribution_t *d;
+  CHECK_NOT_NULL(d = distribution_new_exponential(6, 1.0, 3.0));
+
+  /* 1, 3, 9, 27, 81, inf */
+  EXPECT_EQ_DOUBLE(81.0, distribution_bucket_bound(d, 4));
+
+  struct {
+    double value;
+    size_t want;
+  } cases[] = {
+      {0.5, 0}, {1.0, 0}, {1.1, 1}, {3.0, 1},  {3.1, 2},
+      {9.0, 2}, {26.9, 3}, {27.0, 3}, {81.0, 4}, {81.1, 5},
+  };
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    printf("# exponential: value = %g\n", cases[i].value);
+    EXPECT_EQ_INT((int)cases[i].want, (int)bucket_of(d, cases[i].value));
+  }
+
+  OK(distribution_new_exponential(6, 1.0, 1.0) == NULL);
+
+  distribution_destroy(d);
+  return 0;
+}
+
+DEF_TEST(log_linear) {
+  distribution_t *d;
+  /* 1, then four buckets per power of two up to 8, then inf. */
+  CHECK_NOT_NULL(d = distribution_new_log_linear(1.0, 8.0, 4));
+
+  EXPECT_EQ_INT(2 + 3 * 4, (int)distribution_num_buckets(d));
+  EXPECT_EQ_DOUBLE(1.0, distribution_bucket_bound(d, 0));
+  EXPECT_EQ_DOUBLE(1.25, distribution_bucket_bound(d, 1));
+  EXPECT_EQ_DOUBLE(2.0, distribution_bucket_bound(d, 4));
+  EXPECT_EQ_DOUBLE(2.5, distribution_bucket_bound(d, 5));
+  EXPECT_EQ_DOUBLE(8.0, distribution_bucket_bound(d, 12));
+
+  struct {
+    double value;
+    size_t want;
+  } cases[] = {
+      {0.1, 0}, {1.0, 0},  {1.1, 1},  {1.25, 1}, {1.26, 2},
+      {2.0, 4}, {2.01, 5}, {7.9, 12}, {8.0, 12}, {8.01, 13},
+  };
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    printf("# log_linear: value = %g\n", cases[i].value);
+    EXPECT_EQ_INT((int)cases[i].want, (int)bucket_of(d, cases[i].value));
+  }
+
+  OK(distribution_new_log_linear(1.0, 8.0, 3) == NULL);
+
+  distribution_destroy(d);
+  return 0;
+}
+
+DEF_TEST(custom) {
+  double bounds[] = {0.1, 0.5, 2.0, 10.0};
+  distribution_t *d;
+  CHECK_NOT_NULL(
+      d = distribution_new_custom(STATIC_ARRAY_SIZE(bounds), bounds));
+
+  EXPECT_EQ_INT(5, (int)distribution_num_buckets(d));
+
+  struct {
+    double value;
+    size_t want;
+  } cases[] = {
+      {0.0, 0}, {0.1, 0}, {0.2, 1}, {2.0, 2}, {9.0, 3}, {10.5, 4},
+  };
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    printf("# custom: value = %g\n", cases[i].value);
+    EXPECT_EQ_INT((int)cases[i].want, (int)bucket_of(d, cases[i].value));
+  }
+
+  double unsorted[] = {1.0, 0.5};
+  OK(distribution_new_custom(STATIC_ARRAY_SIZE(unsorted), unsorted) == NULL);
+
+  distribution_destroy(d);
+  return 0;
+}
+
+DEF_TEST(percentile) {
+  distribution_t *d;
+  CHECK_NOT_NULL(d = distribution_new_linear(20, 10.0));
+
+  EXPECT_EQ_DOUBLE(NAN, distribution_percentile(d, 50.0));
+  EXPECT_EQ_DOUBLE(NAN, distribution_average(d));
+
+  for (int i = 1; i <= 100; i++)
+    distribution_update(d, (double)i);
+
+  EXPECT_EQ_UINT64(100, distribution_count(d));
+  EXPECT_EQ_DOUBLE(5050.0, distribution_sum(d));
+  EXPECT_EQ_DOUBLE(50.5, distribution_average(d));
+
+  EXPECT_EQ_DOUBLE(10.0, distribution_percentile(d, 5.0));
+  EXPECT_EQ_DOUBLE(50.0, distribution_percentile(d, 50.0));
+  EXPECT_EQ_DOUBLE(95.0, distribution_percentile(d, 95.0));
+  EXPECT_EQ_DOUBLE(100.0, distribution_percentile(d, 100.0));
+  EXPECT_EQ_DOUBLE(NAN, distribution_percentile(d, 0.0));
+  EXPECT_EQ_DOUBLE(NAN, distribution_percentile(d, 101.0));
+
+  distribution_reset(d);
+  EXPECT_EQ_UINT64(0, distribution_count(d));
+  EXPECT_EQ_DOUBLE(NAN, distribution_percentile(d, 50.0));
+
+  distribution_destroy(d);
+  return 0;
+}
+
+DEF_TEST(merge_and_delta) {
+  distribution_t *a;
+  distribution_t *b;
+  CHECK_NOT_NULL(a = distribution_new_linear(4, 1.0));
+  CHECK_NOT_NULL(b = distribution_new_linear(4, 1.0));
+
+  distribution_update(a, 0.5);
+  distribution_update(a, 1.5);
+  distribution_update(b, 1.5);
+  distribution_update(b, 3.5);
+
+  CHECK_ZERO(distribution_merge(a, b));
+  EXPECT_EQ_UINT64(4, distribution_count(a));
+  EXPECT_EQ_DOUBLE(7.0, distribution_sum(a));
+  EXPECT_EQ_UINT64(1, distribution_bucket_count(a, 0));
+  EXPECT_EQ_UINT64(2, distribution_bucket_count(a, 1));
+  EXPECT_EQ_UINT64(0, distribution_bucket_count(a, 2));
+  EXPECT_EQ_UINT64(1, distribution_bucket_count(a, 3));
+
+  distribution_t *snapshot;
+  CHECK_NOT_NULL(snapshot = distribution_clone(a));
+  distribution_update(a, 2.5);
+  distribution_update(a, 2.5);
+
+  distribution_t *delta;
+  CHECK_NOT_NULL(delta = distribution_delta(a, snapshot));
+  EXPECT_EQ_UINT64(2, distribution_count(delta));
+  EXPECT_EQ_DOUBLE(5.0, distribution_sum(delta));
+  EXPECT_EQ_UINT64(2, distribution_bucket_count(delta, 2));
+  EXPECT_EQ_UINT64(0, distribution_bucket_count(delta, 1));
+  distribution_destroy(delta);
+
+  /* After a reset, everything in the current distribution is new. */
+  distribution_reset(a);
+  distribution_update(a, 0.5);
+  CHECK_NOT_NULL(delta = distribution_delta(a, snapshot));
+  EXPECT_EQ_UINT64(1, distribution_count(delta));
+  distribution_destroy(delta);
+
+  distribution_t *other;
+  CHECK_NOT_NULL(other = distribution_new_linear(4, 2.0));
+  EXPECT_EQ_INT(EINVAL, distribution_merge(a, other));
+  OK(distribution_delta(a, other) == NULL);
+
+  distribution_destroy(other);
+  distribution_destroy(snapshot);
+  distribution_destroy(b);
+  distribution_destroy(a);
+  return 0;
+}
+
+static void *update_thread(void *arg) {
+  distribution_t *d = arg;
+
+  for (int i = 0; i < UPDATE_VALUES; i++)
+    distribution_update(d, (double)(i % 1000));
+
+  return NULL;
+}
+
+DEF_TEST(concurrent_update) {
+  distribution_t *d;
+  CHECK_NOT_NULL(d = distribution_new_log_linear(1.0, 1024.0, 16));
+
+  pthread_t threads[UPDATE_THREADS];
+  for (size_t i = 0; i < UPDATE_THREADS; i++)
+    CHECK_ZERO(pthread_create(threads + i, NULL, update_thread, d));
+  for (size_t i = 0; i < UPDATE_THREADS; i++)
+    CHECK_ZERO(pthread_join(threads[i], NULL));
+
+  uint64_t total = 0;
+  for (size_t i = 0; i < distribution_num_buckets(d); i++)
+    total += distribution_bucket_count(d, i);
+
+  EXPECT_EQ_UINT64(UPDATE_THREADS * UPDATE_VALUES, total);
+  EXPECT_EQ_UINT64(UPDATE_THREADS * UPDATE_VALUES, distribution_count(d));
+  EXPECT_EQ_DOUBLE(UPDATE_THREADS * (UPDATE_VALUES / 1000) * 499500.0,
+                   distribution_sum(d));
+
+  distribution_destroy(d);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(linear);
+  RUN_TEST(exponential);
+  RUN_TEST(log_linear);
+  RUN_TEST(custom);
+  RUN_TEST(percentile);
+  RUN_TEST(merge_and_delta);
+  RUN_TEST(concurrent_update);
+
+  END_TEST;
+}
@@ -30,7 +30,26 @@
 #include "filter_chain.h"
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils_cache.h"
 #include "utils_complain.h"
+#include "utils_series.h"
+
+/* The results of matches that only look at the identifier are cached per
+ * chain, in a hash table keyed by identifier. */
+#define FC_CACHE_SHARDS_NUM 16
+#define FC_CACHE_SHARD_MIN_SLOTS 64
+/* Unless a chain's "CacheSize" is configured, its cache holds up to twice as
+ * many identifiers as the value cache has series, but at least
+ * FC_CACHE_SHARD_MIN_ENTRIES per shard. The number of series is checked at
+ * most once per FC_CACHE_SIZE_INTERVAL. When a shard is full, an entry that has
+ * not been used recently is evicted for each new one. */
+#define FC_CACHE_SHARD_MIN_ENTRIES 1024
+#define FC_CACHE_SIZE_FACTOR 2
+#define FC_CACHE_SIZE_INTERVAL TIME_T_TO_CDTIME_T_STATIC(10)
+/* Results are cached for this many rules per chain. The matches of any
+ * further rules are always evaluated. */
+#define FC_CACHE_RULES_MAX 512
+#define FC_CACHE_WORDS (FC_CACHE_RULES_MAX / 64)
 
 /*
  * Data types
@@ -65,8 +84,32 @@ struct fc_rule_s {
   fc_match_t *matches;
   fc_target_t *targets;
   fc_rule_t *next;
+
+  /* Set by fc_chain_compile(): Whether the result of the matches is cached
+   * and the bit holding it in fc_cache_entry_t.matches. */
+  bool cached;
+  size_t cache_index;
 }; /* }}} */
 
+/* Cached results of the rules of a chain for one identifier. */
+typedef struct {
+  uint64_t hash;
+  series_id_t id;
+  bool referenced; /* set when used, cleared by the clock hand */
+  uint64_t matches[]; /* one bit per cached rule */
+} fc_cache_entry_t;
+
+typedef struct {
+  pthread_rwlock_t lock;
+  fc_cache_entry_t **slots;
+  size_t slots_num; /* zero or a power of two */
+  size_t entries_num;
+
+  size_t entries_max;
+  cdtime_t entries_max_time;
+  size_t hand; /* next slot considered for eviction */
+} fc_cache_shard_t;
+
 /* List of chains, used for `chain_list_head' */
 struct fc_chain_s /* {{{ */
 {
@@ -74,6 +117,10 @@ struct fc_chain_s /* {{{ */
   fc_rule_t *rules;
   fc_target_t *targets;
   fc_chain_t *next;
+
+  size_t cached_rules_num;
+  fc_cache_shard_t *cache; /* FC_CACHE_SHARDS_NUM shards, if rules are cached */
+  size_t cache_size;       /* zero to size the cache from the value cache */
 }; /* }}} */
 
 /* Writer configuration. */
@@ -81,6 +128,7 @@ struct fc_writer_s;
 typedef struct fc_writer_s fc_writer_t; /* {{{ */
 struct fc_writer_s {
   char *plugin;
+  size_t id; /* see plugin_write_target_id() */
   c_complain_t complaint;
 }; /* }}} */
 
@@ -146,6 +194,37 @@ static void fc_free_rules(fc_rule_t *r) /* {{{ */
   free(r);
 } /* }}} void fc_free_rules */
 
+static void fc_cache_entry_free(fc_cache_entry_t *entry) /* {{{ */
+{
+  if (entry == NULL)
+    return;
+
+  series_id_release(&entry->id);
+  free(entry);
+} /* }}} void fc_cache_entry_free */
+
+static void fc_cache_shard_clear(fc_cache_shard_t *shard) /* {{{ */
+{
+  for (size_t i = 0; i < shard->slots_num; i++)
+    fc_cache_entry_free(shard->slots[i]);
+  sfree(shard->slots);
+  shard->slots_num = 0;
+  shard->entries_num = 0;
+  shard->hand = 0;
+} /* }}} void fc_cache_shard_clear */
+
+static void fc_free_cache(fc_cache_shard_t *cache) /* {{{ */
+{
+  if (cache == NULL)
+    return;
+
+  for (size_t i = 0; i < FC_CACHE_SHARDS_NUM; i++) {
+    fc_cache_shard_clear(&cache[i]);
+    pthread_rwlock_destroy(&cache[i].lock);
+  }
+  free(cache);
+} /* }}} void fc_free_cache */
+
 static void fc_free_chains(fc_chain_t *c) /* {{{ */
 {
   if (c == NULL)
@@ -153,6 +232,7 @@ static void fc_free_chains(fc_chain_t *c) /* {{{ */
 
   fc_free_rules(c->rules);
   fc_free_targets(c->targets);
+  fc_free_cache(c->cache);
 
   if (c->next != NULL)
     fc_free_chains(c->next);
@@ -452,6 +532,51 @@ static int fc_config_add_rule(fc_chain_t *chain, /* {{{ */
   return 0;
 } /* }}} int fc_config_add_rule */
 
+/* Decides which rules' results are cached: those with at least one match,
+ * all of which only depend on the identifier. */
+static int fc_chain_compile(fc_chain_t *chain) /* {{{ */
+{
+  chain->cached_rules_num = 0;
+
+  for (fc_rule_t *rule = chain->rules; rule != NULL; rule = rule->next) {
+    rule->cached = (rule->matches != NULL) &&
+                   (chain->cached_rules_num < FC_CACHE_RULES_MAX);
+
+    for (fc_match_t *m = rule->matches; (m != NULL) && rule->cached;
+         m = m->next) {
+      if ((m->proc.identifier_only == NULL) ||
+          !m->proc.identifier_only(m->user_data))
+        rule->cached = false;
+    }
+
+    if (rule->cached) {
+      rule->cache_index = chain->cached_rules_num;
+      chain->cached_rules_num++;
+    }
+  }
+
+  /* Rules may have been added to an existing chain. */
+  if (chain->cache != NULL) {
+    for (size_t i = 0; i < FC_CACHE_SHARDS_NUM; i++)
+      fc_cache_shard_clear(&chain->cache[i]);
+  }
+
+  if ((chain->cached_rules_num == 0) || (chain->cache != NULL))
+    return 0;
+
+  chain->cache = calloc(FC_CACHE_SHARDS_NUM, sizeof(*chain->cache));
+  if (chain->cache == NULL) {
+    ERROR("fc_chain_compile: calloc failed.");
+    return -1;
+  }
+  for (size_t i = 0; i < FC_CACHE_SHARDS_NUM; i++)
+    pthread_rwlock_init(&chain->cache[i].lock, /* attr = */ NULL);
+
+  DEBUG("fc_chain_compile (%s): Caching the results of %" PRIsz " rules.",
+        chain->name, chain->cached_rules_num);
+  return 0;
+} /* }}} int fc_chain_compile */
+
 static int fc_config_add_chain(const oconfig_item_t *ci) /* {{{ */
 {
   fc_chain_t *chain = NULL;
@@ -485,7 +610,18 @@ static int fc_config_add_chain(const oconfig_item_t *ci) /* {{{ */
       status = fc_config_add_rule(chain, option);
     else if (strcasecmp("Target", option->key) == 0)
       status = fc_config_add_target(&chain->targets, option);
-    else {
+    else if (strcasecmp("CacheSize", option->key) == 0) {
+      int size = 0;
+      status = cf_util_get_int(option, &size);
+      if ((status == 0) && (size <= 0)) {
+        WARNING("Filter subsystem: Chain %s: `CacheSize' must be a positive "
+                "number.",
+                chain->name);
+        status = -1;
+      }
+      if (status == 0)
+        chain->cache_size = (size_t)size;
+    } else {
       WARNING("Filter subsystem: Chain %s: Option `%s' not allowed "
               "inside a <Chain> block.",
               chain->name, option->key);
@@ -501,6 +637,12 @@ static int fc_config_add_chain(const oconfig_item_t *ci) /* {{{ */
     return -1;
   }
 
+  if (fc_chain_compile(chain) != 0) {
+    if (new_chain)
+      fc_free_chains(chain);
+    return -1;
+  }
+
   if (chain_list_head != NULL) {
     if (!new_chain)
       return 0;
@@ -654,6 +796,12 @@ static int fc_bit_write_create(const oconfig_item_t *ci, /* {{{ */
         ERROR("fc_bit_write_create: fc_strdup failed.");
         continue;
       }
+      if (plugin_write_target_id(plugin, &plugin_list[plugin_list_len].id) !=
+          0) {
+        ERROR("fc_bit_write_create: plugin_write_target_id failed.");
+        sfree(plugin_list[plugin_list_len].plugin);
+        continue;
+      }
       C_COMPLAIN_INIT(&plugin_list[plugin_list_len].complaint);
       plugin_list_len++;
       plugin_list[plugin_list_len].plugin = NULL;
@@ -725,7 +873,7 @@ static int fc_bit_write_invoke(const data_set_t *ds, /* {{{ */
     }
   } else {
     for (size_t i = 0; plugin_list[i].plugin != NULL; i++) {
-      status = plugin_write(plugin_list[i].plugin, ds, vl);
+      status = plugin_write_by_id(plugin_list[i].id, ds, vl);
       if (status != 0) {
         c_complain(
             LOG_INFO, &plugin_list[i].complaint,
@@ -782,6 +930,235 @@ static int fc_init_once(void) /* {{{ */
   return 0;
 } /* }}} int fc_init_once */
 
+/* Returns FC_MATCH_MATCHES if all matches of `rule' match, FC_MATCH_NO_MATCH
+ * if one does not and a negative value if one failed. */
+static int fc_rule_match(fc_chain_t const *chain, /* {{{ */
+                         fc_rule_t *rule, const data_set_t *ds,
+                         const value_list_t *vl) {
+  /* N. B.: rule->matches may be NULL. */
+  for (fc_match_t *match = rule->matches; match != NULL; match = match->next) {
+    /* FIXME: Pass the meta-data to match targets here (when implemented). */
+    int status =
+        (*match->proc.match)(ds, vl, /* meta = */ NULL, &match->user_data);
+    if (status < 0) {
+      WARNING("fc_process_chain (%s): A match failed.", chain->name);
+      return status;
+    } else if (status != FC_MATCH_MATCHES)
+      return FC_MATCH_NO_MATCH;
+  }
+
+  return FC_MATCH_MATCHES;
+} /* }}} int fc_rule_match */
+
+/* Returns the slot holding the entry for `vl' or, if there is none, the empty
+ * slot where it would be inserted. The shard must be locked and must not be
+ * empty. */
+static size_t fc_cache_shard_find(fc_cache_shard_t const *shard, /* {{{ */
+                                  uint64_t hash, const value_list_t *vl) {
+  size_t mask = shard->slots_num - 1;
+  size_t idx = (size_t)hash & mask;
+
+  while (shard->slots[idx] != NULL) {
+    if ((shard->slots[idx]->hash == hash) &&
+        series_id_match(&shard->slots[idx]->id, vl))
+      break;
+    idx = (idx + 1) & mask;
+  }
+
+  return idx;
+} /* }}} size_t fc_cache_shard_find */
+
+static int fc_cache_shard_grow(fc_cache_shard_t *shard) /* {{{ */
+{
+  size_t slots_num = 2 * shard->slots_num;
+  if (slots_num < FC_CACHE_SHARD_MIN_SLOTS)
+    slots_num = FC_CACHE_SHARD_MIN_SLOTS;
+
+  fc_cache_entry_t **slots = calloc(slots_num, sizeof(*slots));
+  if (slots == NULL)
+    return ENOMEM;
+
+  for (size_t i = 0; i < shard->slots_num; i++) {
+    fc_cache_entry_t *entry = shard->slots[i];
+    if (entry == NULL)
+      continue;
+
+    size_t idx = (size_t)entry->hash & (slots_num - 1);
+    while (slots[idx] != NULL)
+      idx = (idx + 1) & (slots_num - 1);
+    slots[idx] = entry;
+  }
+
+  free(shard->slots);
+  shard->slots = slots;
+  shard->slots_num = slots_num;
+  return 0;
+} /* }}} int fc_cache_shard_grow */
+
+/* Removes the entry in slot `idx'. Later entries of the same probe sequence
+ * are moved up, so that fc_cache_shard_find() still finds them. */
+static void fc_cache_shard_remove(fc_cache_shard_t *shard, /* {{{ */
+                                  size_t idx) {
+  size_t mask = shard->slots_num - 1;
+
+  fc_cache_entry_free(shard->slots[idx]);
+  shard->slots[idx] = NULL;
+  shard->entries_num--;
+
+  for (size_t i = (idx + 1) & mask; shard->slots[i] != NULL;
+       i = (i + 1) & mask) {
+    size_t home = (size_t)shard->slots[i]->hash & mask;
+    /* Entries whose home slot is in (idx, i] can stay. */
+    bool stays = (idx <= i) ? ((idx < home) && (home <= i))
+                            : ((idx < home) || (home <= i));
+    if (stays)
+      continue;
+
+    shard->slots[idx] = shard->slots[i];
+    shard->slots[i] = NULL;
+    idx = i;
+  }
+} /* }}} void fc_cache_shard_remove */
+
+/* Evicts one entry, using the CLOCK algorithm: the hand advances over the
+ * slots, clearing the "referenced" flags, and stops at the first entry that
+ * has not been used since the hand last passed it. The shard must be
+ * write-locked and must not be empty. */
+static void fc_cache_shard_evict(fc_cache_shard_t *shard) /* {{{ */
+{
+  size_t mask = shard->slots_num - 1;
+
+  while (42) {
+    size_t idx = shard->hand & mask;
+    fc_cache_entry_t *entry = shard->slots[idx];
+
+    if ((entry != NULL) && !entry->referenced) {
+      /* Another entry may be moved into this slot; look at it next time. */
+      fc_cache_shard_remove(shard, idx);
+      shard->hand = idx;
+      return;
+    }
+
+    if (entry != NULL)
+      entry->referenced = false;
+    shard->hand = (idx + 1) & mask;
+  }
+} /* }}} void fc_cache_shard_evict */
+
+/* Returns the number of entries a shard of `chain' may hold. The shard must be
+ * write-locked. */
+static size_t fc_cache_shard_max(fc_chain_t const *chain, /* {{{ */
+                                 fc_cache_shard_t *shard) {
+  if (chain->cache_size > 0)
+    return (chain->cache_size + FC_CACHE_SHARDS_NUM - 1) / FC_CACHE_SHARDS_NUM;
+
+  cdtime_t now = cdtime();
+  if ((shard->entries_max == 0) ||
+      ((now - shard->entries_max_time) >= FC_CACHE_SIZE_INTERVAL)) {
+    size_t max = FC_CACHE_SIZE_FACTOR * uc_get_size() / FC_CACHE_SHARDS_NUM;
+    shard->entries_max =
+        (max > FC_CACHE_SHARD_MIN_ENTRIES) ? max : FC_CACHE_SHARD_MIN_ENTRIES;
+    shard->entries_max_time = now;
+  }
+  return shard->entries_max;
+} /* }}} size_t fc_cache_shard_max */
+
+static void fc_cache_insert(fc_chain_t const *chain, /* {{{ */
+                            fc_cache_shard_t *shard, fc_cache_entry_t *entry,
+                            const value_list_t *vl) {
+  pthread_rwlock_wrlock(&shard->lock);
+
+  /* Another thread may have been faster. */
+  if ((shard->entries_num > 0) &&
+      (shard->slots[fc_cache_shard_find(shard, entry->hash, vl)] != NULL)) {
+    pthread_rwlock_unlock(&shard->lock);
+    fc_cache_entry_free(entry);
+    return;
+  }
+
+  if ((shard->entries_num > 0) &&
+      (shard->entries_num >= fc_cache_shard_max(chain, shard)))
+    fc_cache_shard_evict(shard);
+
+  if ((2 * (shard->entries_num + 1) > shard->slots_num) &&
+      (fc_cache_shard_grow(shard) != 0)) {
+    pthread_rwlock_unlock(&shard->lock);
+    fc_cache_entry_free(entry);
+    return;
+  }
+
+  shard->slots[fc_cache_shard_find(shard, entry->hash, vl)] = entry;
+  shard->entries_num++;
+
+  pthread_rwlock_unlock(&shard->lock);
+} /* }}} void fc_cache_insert */
+
+/* Copies the results of the cached rules of `chain' for `vl' to `matches' and
+ * the interned identifier of `vl' to `ret_id', which the caller must release
+ * with series_id_release(). Results not in the cache yet are determined by
+ * running the matches of all cached rules. */
+static int fc_cache_get(fc_chain_t *chain, const data_set_t *ds, /* {{{ */
+                        const value_list_t *vl, series_id_t *ret_id,
+                        uint64_t *matches) {
+  size_t matches_size =
+      sizeof(*matches) * ((chain->cached_rules_num + 63) / 64);
+  uint64_t hash = series_vl_hash(vl);
+  fc_cache_shard_t *shard = &chain->cache[(hash >> 32) % FC_CACHE_SHARDS_NUM];
+  bool found = false;
+
+  pthread_rwlock_rdlock(&shard->lock);
+  if (shard->entries_num > 0) {
+    fc_cache_entry_t *entry =
+        shard->slots[fc_cache_shard_find(shard, hash, vl)];
+    if (entry != NULL) {
+      /* Only write if necessary, to keep the entry's cache line shared. */
+      if (!__atomic_load_n(&entry->referenced, __ATOMIC_RELAXED))
+        __atomic_store_n(&entry->referenced, true, __ATOMIC_RELAXED);
+      series_id_ref(&entry->id);
+      *ret_id = entry->id;
+      memcpy(matches, entry->matches, matches_size);
+      found = true;
+    }
+  }
+  pthread_rwlock_unlock(&shard->lock);
+
+  if (found)
+    return 0;
+
+  int status = series_id_create(vl, ret_id);
+  if (status != 0)
+    return status;
+
+  memset(matches, 0, matches_size);
+  bool failed = false;
+  for (fc_rule_t *rule = chain->rules; rule != NULL; rule = rule->next) {
+    if (!rule->cached)
+      continue;
+
+    status = fc_rule_match(chain, rule, ds, vl);
+    if (status == FC_MATCH_MATCHES)
+      matches[rule->cache_index / 64] |= 1ULL << (rule->cache_index % 64);
+    else if (status < 0)
+      failed = true;
+  }
+
+  /* Failures may be temporary, so don't remember the results. */
+  if (failed)
+    return 0;
+
+  fc_cache_entry_t *entry = malloc(sizeof(*entry) + matches_size);
+  if (entry == NULL)
+    return 0;
+  entry->hash = hash;
+  entry->id = *ret_id;
+  series_id_ref(&entry->id);
+  entry->referenced = false;
+  memcpy(entry->matches, matches, matches_size);
+
+  fc_cache_insert(chain, shard, entry, vl);
+  return 0;
+} /* }}} int fc_cache_get */
+
 /*
  * Public functions
  */
@@ -855,6 +1232,22 @@ fc_chain_t *fc_chain_get_by_name(const char *chain_name) /* {{{ */
   return NULL;
 } /* }}} int fc_chain_get_by_name */
 
+/* Invokes `target'. Targets other than the built-in ones may change `vl',
+ * which batch writers that already got `vl' from an earlier `write' target
+ * must not see, so their batches are submitted first. */
+static int fc_target_invoke(fc_target_t *target, /* {{{ */
+                            const data_set_t *ds, value_list_t *vl) {
+  target_proc_t const *proc = &target->proc;
+  if ((proc->invoke != fc_bit_write_invoke) &&
+      (proc->invoke != fc_bit_jump_invoke) &&
+      (proc->invoke != fc_bit_stop_invoke) &&
+      (proc->invoke != fc_bit_return_invoke))
+    plugin_write_batch_flush(vl);
+
+  /* FIXME: Pass the meta-data to match targets here (when implemented). */
+  return (*proc->invoke)(ds, vl, /* meta = */ NULL, &target->user_data);
+} /* }}} int fc_target_invoke */
+
 int fc_process_chain(const data_set_t *ds, value_list_t *vl, /* {{{ */
                      fc_chain_t *chain) {
   fc_target_t *target;
@@ -865,8 +1258,12 @@ int fc_process_chain(const data_set_t *ds, value_list_t *vl, /* {{{ */
 
   DEBUG("fc_process_chain (chain = %s);", chain->name);
 
+  series_id_t id;
+  uint64_t matches[FC_CACHE_WORDS];
+  bool use_cache = (chain->cache != NULL) &&
+                   (fc_cache_get(chain, ds, vl, &id, matches) == 0);
+
   for (fc_rule_t *rule = chain->rules; rule != NULL; rule = rule->next) {
-    fc_match_t *match;
     status = FC_TARGET_CONTINUE;
 
     if (rule->name[0] != 0) {
@@ -874,23 +1271,15 @@ int fc_process_chain(const data_set_t *ds, value_list_t *vl, /* {{{ */
             rule->name);
     }
 
-    /* N. B.: rule->matches may be NULL. */
-    for (match = rule->matches; match != NULL; match = match->next) {
-      /* FIXME: Pass the meta-data to match targets here (when implemented). */
-      status =
-          (*match->proc.match)(ds, vl, /* meta = */ NULL, &match->user_data);
-      if (status < 0) {
-        WARNING("fc_process_chain (%s): A match failed.", chain->name);
-        break;
-      } else if (status != FC_MATCH_MATCHES)
-        break;
-    }
+    bool matched;
+    if (use_cache && rule->cached)
+      matched = (matches[rule->cache_index / 64] >> (rule->cache_index % 64)) &
+                1;
+    else
+      matched = (fc_rule_match(chain, rule, ds, vl) == FC_MATCH_MATCHES);
 
-    /* for-loop has been aborted: Either error or no match. */
-    if (match != NULL) {
-      status = FC_TARGET_CONTINUE;
+    if (!matched)
       continue;
-    }
 
     if (rule->name[0] != 0) {
       DEBUG("fc_process_chain (%s): Rule `%s' matches.", chain->name,
@@ -900,9 +1289,7 @@ int fc_process_chain(const data_set_t *ds, value_list_t *vl, /* {{{ */
     for (target = rule->targets; target != NULL; target = target->next) {
       /* If we get here, all matches have matched the value. Execute the
        * target. */
-      /* FIXME: Pass the meta-data to match targets here (when implemented). */
-      status =
-          (*target->proc.invoke)(ds, vl, /* meta = */ NULL, &target->user_data);
+      status = fc_target_invoke(target, ds, vl);
       if (status < 0) {
         WARNING("fc_process_chain (%s): A target failed.", chain->name);
         continue;
@@ -919,6 +1306,13 @@ int fc_process_chain(const data_set_t *ds, value_list_t *vl, /* {{{ */
       }
     }
 
+    /* The targets may have changed the identifier, in which case the cached
+     * results don't apply to the remaining rules. */
+    if (use_cache && !series_id_match(&id, vl)) {
+      series_id_release(&id);
+      use_cache = false;
+    }
+
     if ((status == FC_TARGET_STOP) || (status == FC_TARGET_RETURN)) {
       if (rule->name[0] != 0) {
         DEBUG("fc_process_chain (%s): Rule `%s' signaled "
@@ -930,6 +1324,9 @@ int fc_process_chain(const data_set_t *ds, value_list_t *vl, /* {{{ */
     }
   } /* for (rule) */
 
+  if (use_cache)
+    series_id_release(&id);
+
   if ((status == FC_TARGET_STOP) || (status == FC_TARGET_RETURN))
     return status;
 
@@ -939,9 +1336,7 @@ int fc_process_chain(const data_set_t *ds, value_list_t *vl, /* {{{ */
   for (target = chain->targets; target != NULL; target = target->next) {
     /* If we get here, all matches have matched the value. Execute the
      * target. */
-    /* FIXME: Pass the meta-data to match targets here (when implemented). */
-    status =
-        (*target->proc.invoke)(ds, vl, /* meta = */ NULL, &target->user_data);
+    status = fc_target_invoke(target, ds, vl);
     if (status < 0) {
       WARNING("fc_process_chain (%s): The default target failed.", chain->name);
     } else if (status == FC_TARGET_CONTINUE)
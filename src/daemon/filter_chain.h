@@ -46,6 +46,11 @@ struct match_proc_s {
   int (*destroy)(void **user_data);
   int (*match)(const data_set_t *ds, const value_list_t *vl,
                notification_meta_t **meta, void **user_data);
+  /* Optional. Returns true if the result of `match' depends on nothing but
+   * the identifier of the value list, i.e. host, plugin, plugin instance,
+   * type and type instance. The results of such matches are cached per
+   * identifier, so `match' is called only once for each of them. */
+  bool (*identifier_only)(void *user_data);
 };
 typedef struct match_proc_s match_proc_t;
 
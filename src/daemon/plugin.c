@@ -31,11 +31,14 @@
 #include "collectd.h"
 
 #include "configfile.h"
+#include "distribution.h"
 #include "filter_chain.h"
 #include "plugin.h"
 #include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
 #include "utils/heap/heap.h"
+#include "utils/ring/ring.h"
+#include "utils/spill/spill.h"
 #include "utils_cache.h"
 #include "utils_complain.h"
 #include "utils_llist.h"
@@ -56,25 +59,56 @@
 
 #include <dlfcn.h>
 
+#if HAVE_PTHREAD_SETAFFINITY_NP
+#include <sched.h>
+#endif
+
 /*
  * Private structures
  */
+/* Run time statistics of a read, write or flush callback. Only allocated if
+ * `CollectInternalStats' is enabled. Callbacks update `latency', `max',
+ * `values' and `errors' atomically and never take a lock. `previous' is the
+ * snapshot of `latency' taken by the last dispatch and is only used by the
+ * statistics thread. */
+struct callback_stats_s {
+  distribution_t *latency;
+  distribution_t *previous;
+  cdtime_t max;
+  derive_t values;
+  derive_t errors;
+};
+typedef struct callback_stats_s callback_stats_t;
+
+/* Layout of the latency histograms, the same as the one of
+ * latency_counter_t: every power of two between about one microsecond and 18
+ * hours is split into 32 buckets. */
+#define CALLBACK_STATS_LOWEST 1024.0
+#define CALLBACK_STATS_HIGHEST 70368744177664.0
+#define CALLBACK_STATS_SUB_BUCKETS 32
+
 struct callback_func_s {
   void *cf_callback;
   user_data_t cf_udata;
   plugin_ctx_t cf_ctx;
+  callback_stats_t *cf_stats;
 };
 typedef struct callback_func_s callback_func_t;
 
 #define RF_SIMPLE 0
 #define RF_COMPLEX 1
 #define RF_REMOVE 65535
+
+struct read_group_s;
+typedef struct read_group_s read_group_t;
+
 struct read_func_s {
 /* `read_func_t' "inherits" from `callback_func_t'.
  * The `rf_super' member MUST be the first one in this structure! */
 #define rf_callback rf_super.cf_callback
 #define rf_udata rf_super.cf_udata
 #define rf_ctx rf_super.cf_ctx
+#define rf_stats rf_super.cf_stats
   callback_func_t rf_super;
   char rf_group[DATA_MAX_NAME_LEN];
   char *rf_name;
@@ -82,9 +116,117 @@ struct read_func_s {
   cdtime_t rf_interval;
   cdtime_t rf_effective_interval;
   cdtime_t rf_next_read;
+  read_group_t *rf_read_group;
 };
 typedef struct read_func_s read_func_t;
 
+/* Read functions are handled by groups of read threads. Each group has its
+ * own heap of read functions, ordered by the time they are due next. One
+ * idle thread per group waits on `timer_cond' for the root of the heap to
+ * become due; all other idle threads wait on `cond'. This way only one
+ * thread is woken up per due read function. Read functions of plugins not
+ * listed in a <ReadThreadGroup> block belong to the default group. All
+ * members are protected by `read_lock'. */
+struct read_group_s {
+  char *name;
+  char **plugins;
+  size_t plugins_num;
+  unsigned int *cpus;
+  size_t cpus_num;
+  size_t threads_wanted;
+
+  c_heap_t *heap;
+  pthread_cond_t cond;
+  pthread_cond_t timer_cond;
+  bool timer_waiting;
+  pthread_t *threads;
+  size_t threads_num;
+
+  /* Scheduling statistics. Jitter is the time between the scheduled and the
+   * actual start of a read, and is reset by
+   * plugin_update_internal_statistics(). */
+  cdtime_t jitter_sum;
+  cdtime_t jitter_max;
+  uint64_t jitter_num;
+  derive_t skipped;
+
+  read_group_t *next;
+};
+
+struct write_spill_s;
+typedef struct write_spill_s write_spill_t;
+
+struct write_func_s {
+/* `write_func_t' "inherits" from `callback_func_t'.
+ * The `wf_super' member MUST be the first one in this structure! */
+#define wf_callback wf_super.cf_callback
+#define wf_udata wf_super.cf_udata
+#define wf_ctx wf_super.cf_ctx
+#define wf_stats wf_super.cf_stats
+  callback_func_t wf_super;
+  /* If true, `wf_callback' is a `plugin_write_batch_cb'. */
+  bool wf_batch;
+  c_complain_t wf_complaint;
+  /* Spill queue configured for this function or NULL. Set when the write
+   * vector is updated, while other threads may be writing through the current
+   * vector, so it is accessed atomically. */
+  write_spill_t *wf_spill;
+};
+typedef struct write_func_s write_func_t;
+
+/* Flat copy of `list_write'. A new vector is built whenever write functions
+ * are registered or unregistered, so that writing neither walks the list nor
+ * compares names. Replaced vectors may still be in use by other threads and
+ * are only freed on shutdown. The same holds for the write functions they
+ * point to: functions removed from `list_write' are moved to
+ * `list_write_retired' instead of being freed. */
+struct write_vector_s;
+typedef struct write_vector_s write_vector_t;
+struct write_vector_s {
+  write_func_t **funcs;
+  char **names;
+  size_t num;
+  /* Write functions by the IDs handed out by plugin_write_target_id(). NULL
+   * if no function is registered under the name of an ID. */
+  write_func_t **targets;
+  size_t targets_num;
+  write_vector_t *replaced;
+};
+
+/* Disk-backed queue of one write function, configured with a <WriteSpill>
+ * block. Value lists the function fails to write are appended to the queue
+ * and written again by a replay thread at a limited rate. While the function
+ * is "down", only the replay thread checks whether the backend is back. From
+ * the first failure until the queue has been drained ("spilling"), new value
+ * lists are appended to the queue without calling the function, so that they
+ * are written in order. */
+struct write_spill_s {
+  char *name;
+  char *directory;
+  uint64_t max_size;
+  uint64_t segment_size;
+  double replay_rate;
+  cdtime_t retry_interval;
+
+  spill_queue_t *queue;
+  size_t target_id;
+  bool down;
+  bool spilling; /* modified with "lock" held */
+  uint64_t spilled;
+  uint64_t replayed;
+  uint64_t dropped;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  pthread_t thread;
+  bool thread_running;
+  bool loop;
+  cdtime_t retry_time;
+  c_complain_t complaint;
+
+  write_spill_t *next;
+};
+
 struct cache_event_func_s {
   plugin_cache_event_cb callback;
   char *name;
@@ -93,14 +235,53 @@ struct cache_event_func_s {
 };
 typedef struct cache_event_func_s cache_event_func_t;
 
+/* Compact copy of a value list waiting in the write queue. The values and
+ * the name fields are allocated together with the structure, the latter as
+ * packed null terminated strings instead of five DATA_MAX_NAME_LEN arrays.
+ * If `pooled' is set, the allocation is WRITE_VALUE_BLOCK_SIZE bytes long and
+ * is returned to `write_value_pool' when freed. */
+struct write_value_s {
+  cdtime_t time;
+  cdtime_t interval;
+  meta_data_t *meta;
+  bool pooled;
+  size_t values_len;
+  value_t values[];
+  /* followed by host, plugin, plugin_instance, type and type_instance */
+};
+typedef struct write_value_s write_value_t;
+
 struct write_queue_s;
 typedef struct write_queue_s write_queue_t;
 struct write_queue_s {
-  value_list_t *vl;
+  write_value_t *value;
   plugin_ctx_t ctx;
   write_queue_t *next;
 };
 
+/* Value lists handed to batch writers by one write thread. The value lists
+ * are owned by the write thread and stay valid until the batch has been
+ * submitted. */
+struct write_batch_entry_s {
+  write_func_t *wf;
+  data_set_t const *ds;
+  value_list_t const *vl;
+};
+typedef struct write_batch_entry_s write_batch_entry_t;
+
+struct write_batch_s {
+  write_batch_entry_t *entries;
+  size_t num;
+  size_t size;
+  /* Scratch space for passing one writer's share of the batch. */
+  data_set_t const **ds;
+  value_list_t const **vl;
+  /* The value list currently being dispatched by the write thread. Only
+   * this value list may be added to the batch. */
+  value_list_t const *current;
+};
+typedef struct write_batch_s write_batch_t;
+
 struct flush_callback_s {
   char *name;
   cdtime_t timeout;
@@ -123,6 +304,15 @@ static llist_t *list_notification;
 static size_t list_cache_event_num;
 static cache_event_func_t list_cache_event[32];
 
+static write_vector_t *write_vector;
+static pthread_mutex_t write_vector_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Write functions which were unregistered or replaced. Protected by
+ * `write_vector_lock'. */
+static llist_t *list_write_retired;
+/* Names of the IDs handed out by plugin_write_target_id(). */
+static char **write_target_names;
+static size_t write_target_names_num;
+
 static fc_chain_t *pre_cache_chain;
 static fc_chain_t *post_cache_chain;
 
@@ -133,38 +323,238 @@ static char *plugindir;
 #ifndef DEFAULT_MAX_READ_INTERVAL
 #define DEFAULT_MAX_READ_INTERVAL TIME_T_TO_CDTIME_T_STATIC(86400)
 #endif
-static c_heap_t *read_heap;
+static read_group_t read_group_default = {
+    .name = "default",
+    .cond = PTHREAD_COND_INITIALIZER,
+    .timer_cond = PTHREAD_COND_INITIALIZER,
+};
+/* List of all read groups; groups configured with <ReadThreadGroup> are
+ * appended to the default group. */
+static read_group_t *read_groups = &read_group_default;
 static llist_t *read_list;
 static int read_loop = 1;
 static pthread_mutex_t read_lock = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t read_cond = PTHREAD_COND_INITIALIZER;
-static pthread_t *read_threads;
-static size_t read_threads_num;
 static cdtime_t max_read_interval = DEFAULT_MAX_READ_INTERVAL;
 
+#ifndef DEFAULT_WRITE_RING_SIZE
+#define DEFAULT_WRITE_RING_SIZE 1048576
+#endif
 static write_queue_t *write_queue_head;
 static write_queue_t *write_queue_tail;
 static long write_queue_length;
+/* If non-NULL, the write queue is a lock-free ring of `write_queue_t'
+ * entries instead of the linked list above. `write_lock' and `write_cond'
+ * are then only used to put idle write threads to sleep. */
+static c_ring_t *write_ring;
+static long write_ring_sleepers;
+/* Blocks for write values that are not in use, so that queueing a value list
+ * usually does not allocate memory. Only used together with `write_ring';
+ * value lists that do not fit into a block are allocated individually. */
+#ifndef WRITE_VALUE_BLOCK_SIZE
+#define WRITE_VALUE_BLOCK_SIZE 256
+#endif
+#ifndef WRITE_VALUE_POOL_SIZE
+#define WRITE_VALUE_POOL_SIZE 65536
+#endif
+#define WRITE_VALUE_POOL_PREALLOC 1024
+static c_ring_t *write_value_pool;
+#ifndef WRITE_BATCH_SIZE
+#define WRITE_BATCH_SIZE 64
+#endif
+static pthread_key_t write_batch_key;
+static bool write_batch_key_initialized;
+static size_t write_threads_wanted;
 static bool write_loop = true;
 static pthread_mutex_t write_lock = PTHREAD_MUTEX_INITIALIZER;
 static pthread_cond_t write_cond = PTHREAD_COND_INITIALIZER;
 static pthread_t *write_threads;
 static size_t write_threads_num;
 
+#ifndef DEFAULT_WRITE_SPILL_MAX_SIZE
+#define DEFAULT_WRITE_SPILL_MAX_SIZE 1073741824
+#endif
+#ifndef DEFAULT_WRITE_SPILL_SEGMENT_SIZE
+#define DEFAULT_WRITE_SPILL_SEGMENT_SIZE 16777216
+#endif
+#ifndef DEFAULT_WRITE_SPILL_REPLAY_RATE
+#define DEFAULT_WRITE_SPILL_REPLAY_RATE 1000.0
+#endif
+#ifndef DEFAULT_WRITE_SPILL_RETRY_INTERVAL
+#define DEFAULT_WRITE_SPILL_RETRY_INTERVAL TIME_T_TO_CDTIME_T_STATIC(10)
+#endif
+#ifndef WRITE_SPILL_BATCH_SIZE
+#define WRITE_SPILL_BATCH_SIZE 64
+#endif
+/* Maximum size of one encoded value list in a spill queue. A multiple of
+ * eight, so that the values of records read into consecutive slots of a
+ * buffer are aligned. */
+#define WRITE_SPILL_RECORD_MAX 4096
+/* Spill queues are only added while the configuration is read. */
+static write_spill_t *write_spills;
+
 static pthread_key_t plugin_ctx_key;
 static bool plugin_ctx_key_initialized;
 
+/* Statistics of the read callback currently running in this thread. Used to
+ * count the values it dispatches. */
+static pthread_key_t read_stats_key;
+
 static long write_limit_high;
 static long write_limit_low;
 
 static pthread_mutex_t statistics_lock = PTHREAD_MUTEX_INITIALIZER;
 static derive_t stats_values_dropped;
 static bool record_statistics;
+static callback_stats_t *pre_cache_stats;
+static callback_stats_t *post_cache_stats;
 
 /*
  * Static functions
  */
 static int plugin_dispatch_values_internal(value_list_t *vl);
+static bool check_drop_value(void);
+static int plugin_compare_read_func(const void *arg0, const void *arg1);
+
+/* Counts one value list as dropped in the internal statistics. */
+static void plugin_record_value_dropped(void) /* {{{ */
+{
+  if (!record_statistics)
+    return;
+
+  pthread_mutex_lock(&statistics_lock);
+  stats_values_dropped++;
+  pthread_mutex_unlock(&statistics_lock);
+} /* }}} void plugin_record_value_dropped */
+
+static callback_stats_t *callback_stats_create(void) /* {{{ */
+{
+  callback_stats_t *cs = calloc(1, sizeof(*cs));
+  if (cs == NULL)
+    return NULL;
+
+  cs->latency = distribution_new_log_linear(CALLBACK_STATS_LOWEST,
+                                            CALLBACK_STATS_HIGHEST,
+                                            CALLBACK_STATS_SUB_BUCKETS);
+  if (cs->latency != NULL)
+    cs->previous = distribution_clone(cs->latency);
+  if (cs->previous == NULL) {
+    distribution_destroy(cs->latency);
+    sfree(cs);
+    return NULL;
+  }
+
+  return cs;
+} /* }}} callback_stats_t *callback_stats_create */
+
+static void callback_stats_destroy(callback_stats_t *cs) /* {{{ */
+{
+  if (cs == NULL)
+    return;
+
+  distribution_destroy(cs->latency);
+  distribution_destroy(cs->previous);
+  sfree(cs);
+} /* }}} void callback_stats_destroy */
+
+/* Allocates the statistics of `cf' if internal statistics are collected.
+ * Must be called before `cf' is visible to other threads. */
+static void callback_stats_enable(callback_func_t *cf) /* {{{ */
+{
+  if (!record_statistics || (cf == NULL) || (cf->cf_stats != NULL))
+    return;
+
+  cf->cf_stats = callback_stats_create();
+} /* }}} void callback_stats_enable */
+
+static void callback_stats_record(callback_stats_t *cs, /* {{{ */
+                                  cdtime_t latency, size_t values,
+                                  int status) {
+  if (cs == NULL)
+    return;
+
+  distribution_update(cs->latency, (double)latency);
+
+  cdtime_t max = __atomic_load_n(&cs->max, __ATOMIC_RELAXED);
+  while ((latency > max) &&
+         !__atomic_compare_exchange_n(&cs->max, &max, latency,
+                                      /* weak = */ true, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED))
+    ;
+
+  if (values > 0)
+    __atomic_fetch_add(&cs->values, (derive_t)values, __ATOMIC_RELAXED);
+  if (status != 0)
+    __atomic_fetch_add(&cs->errors, 1, __ATOMIC_RELAXED);
+} /* }}} void callback_stats_record */
+
+/* Counts values dispatched by the read callback running in this thread. */
+static void plugin_record_values_dispatched(size_t num) /* {{{ */
+{
+  if (!record_statistics || (num == 0))
+    return;
+
+  callback_stats_t *cs = pthread_getspecific(read_stats_key);
+  if (cs != NULL)
+    __atomic_fetch_add(&cs->values, (derive_t)num, __ATOMIC_RELAXED);
+} /* }}} void plugin_record_values_dispatched */
+
+/* Dispatches the statistics of one callback, using `kind' as prefix of the
+ * type instances. The latencies are those recorded since the last dispatch:
+ * the difference between a snapshot of `latency' and the previous one. */
+static void callback_stats_dispatch(value_list_t *vl, /* {{{ */
+                                    callback_stats_t *cs, char const *kind) {
+  gauge_t average = NAN;
+  gauge_t maximum = NAN;
+  gauge_t p99 = NAN;
+
+  if (cs == NULL)
+    return;
+
+  /* Callbacks update `latency' before `max', so taking the maximum before the
+   * snapshot ensures that it is one of the latencies in the snapshot. */
+  cdtime_t max = __atomic_exchange_n(&cs->max, 0, __ATOMIC_RELAXED);
+  distribution_t *current = distribution_clone(cs->latency);
+  distribution_t *delta = NULL;
+  if (current != NULL)
+    delta = distribution_delta(current, cs->previous);
+
+  if ((delta != NULL) && (distribution_count(delta) > 0)) {
+    average = CDTIME_T_TO_DOUBLE((cdtime_t)distribution_average(delta));
+    maximum = CDTIME_T_TO_DOUBLE(max);
+    double percentile = distribution_percentile(delta, /* percent = */ 99.0);
+    if (!isnan(percentile))
+      p99 = CDTIME_T_TO_DOUBLE((cdtime_t)percentile);
+  }
+  distribution_destroy(delta);
+
+  if (current != NULL) {
+    distribution_destroy(cs->previous);
+    cs->previous = current;
+  }
+
+  struct {
+    char const *type;
+    char const *name;
+    value_t value;
+  } stats[] = {
+      {"duration", "average", {.gauge = average}},
+      {"duration", "max", {.gauge = maximum}},
+      {"duration", "p99", {.gauge = p99}},
+      {"derive", "values",
+       {.derive = __atomic_load_n(&cs->values, __ATOMIC_RELAXED)}},
+      {"derive", "errors",
+       {.derive = __atomic_load_n(&cs->errors, __ATOMIC_RELAXED)}},
+  };
+
+  vl->values_len = 1;
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(stats); i++) {
+    vl->values = &stats[i].value;
+    sstrncpy(vl->type, stats[i].type, sizeof(vl->type));
+    ssnprintf(vl->type_instance, sizeof(vl->type_instance), "%s-%s", kind,
+              stats[i].name);
+    plugin_dispatch_values(vl);
+  }
+} /* }}} void callback_stats_dispatch */
 
 static const char *plugin_get_dir(void) {
   if (plugindir == NULL)
@@ -173,8 +563,21 @@ static const char *plugin_get_dir(void) {
     return plugindir;
 }
 
+static long plugin_write_queue_length(void) /* {{{ */
+{
+  long wql;
+
+  if (write_ring != NULL)
+    return (long)c_ring_length(write_ring);
+
+  pthread_mutex_lock(&write_lock);
+  wql = write_queue_length;
+  pthread_mutex_unlock(&write_lock);
+  return wql;
+} /* }}} long plugin_write_queue_length */
+
 static int plugin_update_internal_statistics(void) { /* {{{ */
-  gauge_t copy_write_queue_length = (gauge_t)write_queue_length;
+  gauge_t copy_write_queue_length = (gauge_t)plugin_write_queue_length();
 
   /* Initialize `vl' */
   value_list_t vl = VALUE_LIST_INIT;
@@ -208,6 +611,103 @@ static int plugin_update_internal_statistics(void) { /* {{{ */
   vl.type_instance[0] = 0;
   plugin_dispatch_values(&vl);
 
+  /* Read thread groups : scheduling jitter and skipped intervals */
+  for (read_group_t *rg = read_groups; rg != NULL; rg = rg->next) {
+    pthread_mutex_lock(&read_lock);
+    gauge_t jitter_avg =
+        (rg->jitter_num > 0)
+            ? CDTIME_T_TO_DOUBLE(rg->jitter_sum) / (gauge_t)rg->jitter_num
+            : NAN;
+    gauge_t jitter_max =
+        (rg->jitter_num > 0) ? CDTIME_T_TO_DOUBLE(rg->jitter_max) : NAN;
+    derive_t skipped = rg->skipped;
+    rg->jitter_sum = 0;
+    rg->jitter_max = 0;
+    rg->jitter_num = 0;
+    pthread_mutex_unlock(&read_lock);
+
+    ssnprintf(vl.plugin_instance, sizeof(vl.plugin_instance), "read-%s",
+              rg->name);
+
+    sstrncpy(vl.type, "duration", sizeof(vl.type));
+    vl.values = &(value_t){.gauge = jitter_avg};
+    sstrncpy(vl.type_instance, "jitter_average", sizeof(vl.type_instance));
+    plugin_dispatch_values(&vl);
+
+    vl.values = &(value_t){.gauge = jitter_max};
+    sstrncpy(vl.type_instance, "jitter_max", sizeof(vl.type_instance));
+    plugin_dispatch_values(&vl);
+
+    sstrncpy(vl.type, "derive", sizeof(vl.type));
+    vl.values = &(value_t){.derive = skipped};
+    sstrncpy(vl.type_instance, "skipped", sizeof(vl.type_instance));
+    plugin_dispatch_values(&vl);
+  }
+
+  /* Callbacks : run time, values and errors per plugin. Read functions are
+   * freed by the read threads after being removed from `read_list', so hold
+   * `read_lock' while looking at them. */
+  pthread_mutex_lock(&read_lock);
+  for (llentry_t *le = llist_head(read_list); le != NULL; le = le->next) {
+    read_func_t *rf = le->value;
+    ssnprintf(vl.plugin_instance, sizeof(vl.plugin_instance), "plugin-%s",
+              le->key);
+    callback_stats_dispatch(&vl, rf->rf_stats, "read");
+  }
+  pthread_mutex_unlock(&read_lock);
+
+  /* The write vector and the functions it points to are never freed while
+   * the daemon is running, unlike the entries of `list_write'. */
+  write_vector_t *wv = __atomic_load_n(&write_vector, __ATOMIC_ACQUIRE);
+  for (size_t i = 0; (wv != NULL) && (i < wv->num); i++) {
+    ssnprintf(vl.plugin_instance, sizeof(vl.plugin_instance), "plugin-%s",
+              wv->names[i]);
+    callback_stats_dispatch(&vl, wv->funcs[i]->wf_stats, "write");
+  }
+
+  /* Spill queues : size and value lists spilled, replayed and dropped */
+  for (write_spill_t *ws = write_spills; ws != NULL; ws = ws->next) {
+    spill_queue_t *q = __atomic_load_n(&ws->queue, __ATOMIC_ACQUIRE);
+    if (q == NULL)
+      continue;
+
+    ssnprintf(vl.plugin_instance, sizeof(vl.plugin_instance), "spill-%s",
+              ws->name);
+
+    sstrncpy(vl.type, "bytes", sizeof(vl.type));
+    vl.values = &(value_t){.gauge = (gauge_t)spill_queue_size(q)};
+    vl.type_instance[0] = 0;
+    plugin_dispatch_values(&vl);
+
+    sstrncpy(vl.type, "derive", sizeof(vl.type));
+    vl.values = &(value_t){
+        .derive = (derive_t)__atomic_load_n(&ws->spilled, __ATOMIC_RELAXED)};
+    sstrncpy(vl.type_instance, "spilled", sizeof(vl.type_instance));
+    plugin_dispatch_values(&vl);
+
+    vl.values = &(value_t){
+        .derive = (derive_t)__atomic_load_n(&ws->replayed, __ATOMIC_RELAXED)};
+    sstrncpy(vl.type_instance, "replayed", sizeof(vl.type_instance));
+    plugin_dispatch_values(&vl);
+
+    vl.values = &(value_t){
+        .derive = (derive_t)__atomic_load_n(&ws->dropped, __ATOMIC_RELAXED)};
+    sstrncpy(vl.type_instance, "dropped", sizeof(vl.type_instance));
+    plugin_dispatch_values(&vl);
+  }
+
+  for (llentry_t *le = llist_head(list_flush); le != NULL; le = le->next) {
+    callback_func_t *cf = le->value;
+    ssnprintf(vl.plugin_instance, sizeof(vl.plugin_instance), "plugin-%s",
+              le->key);
+    callback_stats_dispatch(&vl, cf->cf_stats, "flush");
+  }
+
+  /* Filter chains */
+  sstrncpy(vl.plugin_instance, "filter_chain", sizeof(vl.plugin_instance));
+  callback_stats_dispatch(&vl, pre_cache_stats, "pre_cache");
+  callback_stats_dispatch(&vl, post_cache_stats, "post_cache");
+
   return 0;
 } /* }}} int plugin_update_internal_statistics */
 
@@ -226,6 +726,7 @@ static void destroy_callback(callback_func_t *cf) /* {{{ */
   if (cf == NULL)
     return;
   free_userdata(&cf->cf_udata);
+  callback_stats_destroy(cf->cf_stats);
   sfree(cf);
 } /* }}} void destroy_callback */
 
@@ -253,24 +754,73 @@ static void destroy_all_callbacks(llist_t **list) /* {{{ */
   *list = NULL;
 } /* }}} void destroy_all_callbacks */
 
-static void destroy_read_heap(void) /* {{{ */
+static void read_group_free(read_group_t *rg) /* {{{ */
 {
-  if (read_heap == NULL)
+  if (rg == NULL)
     return;
 
-  while (42) {
-    read_func_t *rf;
+  for (size_t i = 0; i < rg->plugins_num; i++)
+    sfree(rg->plugins[i]);
+  sfree(rg->plugins);
+  sfree(rg->cpus);
+  sfree(rg->name);
+  sfree(rg);
+} /* }}} void read_group_free */
 
-    rf = c_heap_get_root(read_heap);
-    if (rf == NULL)
-      break;
-    sfree(rf->rf_name);
-    destroy_callback((callback_func_t *)rf);
+static void destroy_read_groups(void) /* {{{ */
+{
+  read_group_t *rg = read_groups;
+
+  while (rg != NULL) {
+    read_group_t *next = rg->next;
+
+    if (rg->heap != NULL) {
+      read_func_t *rf;
+      while ((rf = c_heap_get_root(rg->heap)) != NULL) {
+        sfree(rf->rf_name);
+        destroy_callback((callback_func_t *)rf);
+      }
+      c_heap_destroy(rg->heap);
+      rg->heap = NULL;
+    }
+
+    if (rg != &read_group_default) {
+      pthread_cond_destroy(&rg->cond);
+      pthread_cond_destroy(&rg->timer_cond);
+      read_group_free(rg);
+    }
+
+    rg = next;
+  }
+
+  read_group_default.next = NULL;
+  read_groups = &read_group_default;
+} /* }}} void destroy_read_groups */
+
+/* Moves `cf', which has been removed from `list_write', to
+ * `list_write_retired'. */
+static void write_func_retire(char const *name, /* {{{ */
+                              callback_func_t *cf) {
+  pthread_mutex_lock(&write_vector_lock);
+
+  if (list_write_retired == NULL)
+    list_write_retired = llist_create();
+
+  char *key = strdup(name);
+  llentry_t *le = NULL;
+  if ((list_write_retired != NULL) && (key != NULL))
+    le = llentry_create(key, cf);
+
+  if (le == NULL) {
+    /* Leaking the function is the only safe option left. */
+    ERROR("plugin: Retiring the write function `%s' failed.", name);
+    sfree(key);
+  } else {
+    llist_append(list_write_retired, le);
   }
 
-  c_heap_destroy(read_heap);
-  read_heap = NULL;
-} /* }}} void destroy_read_heap */
+  pthread_mutex_unlock(&write_vector_lock);
+} /* }}} void write_func_retire */
 
 static int register_callback(llist_t **list, /* {{{ */
                              const char *name, callback_func_t *cf) {
@@ -313,7 +863,11 @@ static int register_callback(llist_t **list, /* {{{ */
               "overwriting the old entry!",
               name);
 
-    destroy_callback(old_cf);
+    /* Write functions may still be in use by a write vector. */
+    if (list == &list_write)
+      write_func_retire(name, old_cf);
+    else
+      destroy_callback(old_cf);
     sfree(key);
   }
 
@@ -381,6 +935,8 @@ static int create_register_callback(llist_t **list, /* {{{ */
   }
 
   cf->cf_ctx = plugin_get_ctx();
+  if (list == &list_flush)
+    callback_stats_enable(cf);
 
   return register_callback(list, name, cf);
 } /* }}} int create_register_callback */
@@ -406,6 +962,87 @@ static int plugin_unregister(llist_t *list, const char *name) /* {{{ */
   return 0;
 } /* }}} int plugin_unregister */
 
+static write_spill_t *write_spill_find(char const *name) /* {{{ */
+{
+  for (write_spill_t *ws = write_spills; ws != NULL; ws = ws->next) {
+    if (strcasecmp(name, ws->name) == 0)
+      return ws;
+  }
+  return NULL;
+} /* }}} write_spill_t *write_spill_find */
+
+/* Frees `v' and all vectors it replaced. */
+static void write_vector_free(write_vector_t *v) /* {{{ */
+{
+  while (v != NULL) {
+    write_vector_t *replaced = v->replaced;
+
+    for (size_t i = 0; i < v->num; i++)
+      free(v->names[i]);
+    free(v->names);
+    free(v->funcs);
+    free(v->targets);
+    free(v);
+
+    v = replaced;
+  }
+} /* }}} void write_vector_free */
+
+/* Replaces `write_vector' with a copy of `list_write'. The caller must hold
+ * `write_vector_lock'. */
+static int write_vector_update(void) /* {{{ */
+{
+  size_t num = (list_write != NULL) ? (size_t)llist_size(list_write) : 0;
+
+  write_vector_t *v = calloc(1, sizeof(*v));
+  if (v == NULL)
+    return ENOMEM;
+  v->funcs = calloc(num + 1, sizeof(*v->funcs));
+  v->names = calloc(num + 1, sizeof(*v->names));
+  v->targets = calloc(write_target_names_num + 1, sizeof(*v->targets));
+  if ((v->funcs == NULL) || (v->names == NULL) || (v->targets == NULL)) {
+    write_vector_free(v);
+    return ENOMEM;
+  }
+
+  for (llentry_t *le = llist_head(list_write); le != NULL; le = le->next) {
+    v->names[v->num] = strdup(le->key);
+    if (v->names[v->num] == NULL) {
+      write_vector_free(v);
+      return ENOMEM;
+    }
+    v->funcs[v->num] = le->value;
+    __atomic_store_n(&v->funcs[v->num]->wf_spill, write_spill_find(le->key),
+                     __ATOMIC_RELEASE);
+    v->num++;
+  }
+
+  for (size_t i = 0; i < write_target_names_num; i++) {
+    for (size_t j = 0; j < v->num; j++) {
+      if (strcasecmp(write_target_names[i], v->names[j]) == 0) {
+        v->targets[i] = v->funcs[j];
+        break;
+      }
+    }
+  }
+  v->targets_num = write_target_names_num;
+
+  v->replaced = write_vector;
+  __atomic_store_n(&write_vector, v, __ATOMIC_RELEASE);
+  return 0;
+} /* }}} int write_vector_update */
+
+static void write_vector_changed(void) /* {{{ */
+{
+  pthread_mutex_lock(&write_vector_lock);
+  int status = write_vector_update();
+  pthread_mutex_unlock(&write_vector_lock);
+
+  if (status != 0)
+    ERROR("plugin: Updating the list of write functions failed: %s",
+          STRERROR(status));
+} /* }}} void write_vector_changed */
+
 /* plugin_load_file loads the shared object "file" and calls its
  * "module_register" function. Returns zero on success, non-zero otherwise. */
 static int plugin_load_file(char const *file, bool global) {
@@ -447,29 +1084,80 @@ static int plugin_load_file(char const *file, bool global) {
   return 0;
 }
 
-static void *plugin_read_thread(void __attribute__((unused)) * args) {
+/* Returns the group responsible for `rf'. */
+static read_group_t *read_group_find(read_func_t const *rf) /* {{{ */
+{
+  for (read_group_t *rg = read_group_default.next; rg != NULL; rg = rg->next) {
+    for (size_t i = 0; i < rg->plugins_num; i++) {
+      if ((strcasecmp(rg->plugins[i], rf->rf_name) == 0) ||
+          ((rf->rf_ctx.name != NULL) &&
+           (strcasecmp(rg->plugins[i], rf->rf_ctx.name) == 0)))
+        return rg;
+    }
+  }
+
+  return &read_group_default;
+} /* }}} read_group_t *read_group_find */
+
+/* Adds `rf' to the heap of its group and wakes up one thread of the group.
+ * Must be called with `read_lock' held. */
+static int read_group_insert(read_func_t *rf) /* {{{ */
+{
+  read_group_t *rg = rf->rf_read_group;
+
+  if (rg->heap == NULL) {
+    rg->heap = c_heap_create(plugin_compare_read_func);
+    if (rg->heap == NULL)
+      return ENOMEM;
+  }
+
+  int status = c_heap_insert(rg->heap, rf);
+  if (status != 0)
+    return status;
+
+  /* `rf' may be due before the read function the timer thread is waiting
+   * for. If there is no timer thread, let an idle thread become one. */
+  if (rg->timer_waiting)
+    pthread_cond_signal(&rg->timer_cond);
+  else
+    pthread_cond_signal(&rg->cond);
+  return 0;
+} /* }}} int read_group_insert */
+
+static void *plugin_read_thread(void *args) {
+  read_group_t *rg = args;
+
+  pthread_mutex_lock(&read_lock);
   while (read_loop != 0) {
     read_func_t *rf;
     plugin_ctx_t old_ctx;
     cdtime_t start;
     cdtime_t now;
     cdtime_t elapsed;
+    derive_t skipped = 0;
     int status;
     int rf_type;
-    int rc;
 
-    /* Get the read function that needs to be read next.
-     * We don't need to hold "read_lock" for the heap, but we need
-     * to call c_heap_get_root() and pthread_cond_wait() in the
-     * same protected block. */
-    pthread_mutex_lock(&read_lock);
-    rf = c_heap_get_root(read_heap);
+    rf = (rg->heap != NULL) ? c_heap_get_root(rg->heap) : NULL;
     if (rf == NULL) {
-      pthread_cond_wait(&read_cond, &read_lock);
+      pthread_cond_wait(&rg->cond, &read_lock);
+      continue;
+    }
+
+    /* The entry has been marked for deletion. The linked list
+     * entry has already been removed by `plugin_unregister_read'.
+     * All we have to do here is free the `read_func_t' and
+     * continue. */
+    if (rf->rf_type == RF_REMOVE) {
       pthread_mutex_unlock(&read_lock);
+      DEBUG("plugin_read_thread: Destroying the `%s' "
+            "callback.",
+            rf->rf_name);
+      sfree(rf->rf_name);
+      destroy_callback((callback_func_t *)rf);
+      pthread_mutex_lock(&read_lock);
       continue;
     }
-    pthread_mutex_unlock(&read_lock);
 
     if (rf->rf_interval == 0) {
       /* this should not happen, because the interval is set
@@ -481,50 +1169,44 @@ static void *plugin_read_thread(void __attribute__((unused)) * args) {
       rf->rf_next_read = cdtime();
     }
 
-    /* sleep until this entry is due,
-     * using pthread_cond_timedwait */
-    pthread_mutex_lock(&read_lock);
-    /* In pthread_cond_timedwait, spurious wakeups are possible
-     * (and really happen, at least on NetBSD with > 1 CPU), thus
-     * we need to re-evaluate the condition every time
-     * pthread_cond_timedwait returns. */
-    rc = 0;
-    while ((read_loop != 0) && (cdtime() < rf->rf_next_read) && rc == 0) {
-      rc = pthread_cond_timedwait(&read_cond, &read_lock,
-                                  &CDTIME_T_TO_TIMESPEC(rf->rf_next_read));
+    now = cdtime();
+    if (now < rf->rf_next_read) {
+      c_heap_insert(rg->heap, rf);
+
+      /* Only one thread per group waits for the next read function to
+       * become due. Spurious wakeups are handled by re-evaluating the root
+       * of the heap. */
+      if (rg->timer_waiting) {
+        pthread_cond_wait(&rg->cond, &read_lock);
+      } else {
+        rg->timer_waiting = true;
+        pthread_cond_timedwait(&rg->timer_cond, &read_lock,
+                               &CDTIME_T_TO_TIMESPEC(rf->rf_next_read));
+        rg->timer_waiting = false;
+      }
+      continue;
     }
 
+    /* Let another idle thread wait for the next read function. */
+    if (!rg->timer_waiting)
+      pthread_cond_signal(&rg->cond);
+
+    rg->jitter_sum += now - rf->rf_next_read;
+    if (rg->jitter_max < (now - rf->rf_next_read))
+      rg->jitter_max = now - rf->rf_next_read;
+    rg->jitter_num++;
+
     /* Must hold `read_lock' when accessing `rf->rf_type'. */
     rf_type = rf->rf_type;
     pthread_mutex_unlock(&read_lock);
 
-    /* Check if we're supposed to stop.. This may have interrupted
-     * the sleep, too. */
-    if (read_loop == 0) {
-      /* Insert `rf' again, so it can be free'd correctly */
-      c_heap_insert(read_heap, rf);
-      break;
-    }
-
-    /* The entry has been marked for deletion. The linked list
-     * entry has already been removed by `plugin_unregister_read'.
-     * All we have to do here is free the `read_func_t' and
-     * continue. */
-    if (rf_type == RF_REMOVE) {
-      DEBUG("plugin_read_thread: Destroying the `%s' "
-            "callback.",
-            rf->rf_name);
-      sfree(rf->rf_name);
-      destroy_callback((callback_func_t *)rf);
-      rf = NULL;
-      continue;
-    }
-
     DEBUG("plugin_read_thread: Handling `%s'.", rf->rf_name);
 
     start = cdtime();
 
     old_ctx = plugin_set_ctx(rf->rf_ctx);
+    if (rf->rf_stats != NULL)
+      pthread_setspecific(read_stats_key, rf->rf_stats);
 
     if (rf_type == RF_SIMPLE) {
       int (*callback)(void);
@@ -540,6 +1222,8 @@ static void *plugin_read_thread(void __attribute__((unused)) * args) {
       status = (*callback)(&rf->rf_udata);
     }
 
+    if (rf->rf_stats != NULL)
+      pthread_setspecific(read_stats_key, NULL);
     plugin_set_ctx(old_ctx);
 
     /* If the function signals failure, we will increase the
@@ -562,6 +1246,7 @@ static void *plugin_read_thread(void __attribute__((unused)) * args) {
 
     /* calculate the time spent in the read function */
     elapsed = (now - start);
+    callback_stats_record(rf->rf_stats, elapsed, /* values = */ 0, status);
 
     if (elapsed > rf->rf_effective_interval)
       WARNING(
@@ -587,7 +1272,9 @@ static void *plugin_read_thread(void __attribute__((unused)) * args) {
     if (rf->rf_next_read < now) {
       /* `rf_next_read' is in the past. Insert `now'
        * so this value doesn't trail off into the
-       * past too much. */
+       * past too much. Every full interval in between is a skipped read. */
+      skipped = (derive_t)((now - rf->rf_next_read) /
+                           rf->rf_effective_interval);
       rf->rf_next_read = now;
     }
 
@@ -595,8 +1282,11 @@ static void *plugin_read_thread(void __attribute__((unused)) * args) {
           rf->rf_name, CDTIME_T_TO_DOUBLE(rf->rf_next_read));
 
     /* Re-insert this read function into the heap again. */
-    c_heap_insert(read_heap, rf);
+    pthread_mutex_lock(&read_lock);
+    rg->skipped += skipped;
+    read_group_insert(rf);
   } /* while (read_loop) */
+  pthread_mutex_unlock(&read_lock);
 
   pthread_exit(NULL);
   return (void *)0;
@@ -630,22 +1320,41 @@ static void set_thread_name(pthread_t tid, char const *name) {
 #endif
 }
 
-static void start_read_threads(size_t num) /* {{{ */
+static void read_group_set_affinity(read_group_t const *rg, /* {{{ */
+                                    pthread_t tid) {
+#if HAVE_PTHREAD_SETAFFINITY_NP
+  if (rg->cpus_num == 0)
+    return;
+
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (size_t i = 0; i < rg->cpus_num; i++)
+    CPU_SET(rg->cpus[i], &set);
+
+  int status = pthread_setaffinity_np(tid, sizeof(set), &set);
+  if (status != 0)
+    ERROR("plugin: Setting the CPU affinity of read thread group \"%s\" "
+          "failed: %s",
+          rg->name, STRERROR(status));
+#endif
+} /* }}} void read_group_set_affinity */
+
+static void read_group_start_threads(read_group_t *rg) /* {{{ */
 {
-  if (read_threads != NULL)
+  if ((rg->threads != NULL) || (rg->threads_wanted == 0))
     return;
 
-  read_threads = calloc(num, sizeof(*read_threads));
-  if (read_threads == NULL) {
+  rg->threads = calloc(rg->threads_wanted, sizeof(*rg->threads));
+  if (rg->threads == NULL) {
     ERROR("plugin: start_read_threads: calloc failed.");
     return;
   }
 
-  read_threads_num = 0;
-  for (size_t i = 0; i < num; i++) {
-    int status = pthread_create(read_threads + read_threads_num,
+  rg->threads_num = 0;
+  for (size_t i = 0; i < rg->threads_wanted; i++) {
+    int status = pthread_create(rg->threads + rg->threads_num,
                                 /* attr = */ NULL, plugin_read_thread,
-                                /* arg = */ NULL);
+                                /* arg = */ rg);
     if (status != 0) {
       ERROR("plugin: start_read_threads: pthread_create failed with status %i "
             "(%s).",
@@ -654,34 +1363,77 @@ static void start_read_threads(size_t num) /* {{{ */
     }
 
     char name[THREAD_NAME_MAX];
-    ssnprintf(name, sizeof(name), "reader#%" PRIu64,
-              (uint64_t)read_threads_num);
-    set_thread_name(read_threads[read_threads_num], name);
+    if (rg == &read_group_default)
+      ssnprintf(name, sizeof(name), "reader#%" PRIu64,
+                (uint64_t)rg->threads_num);
+    else
+      ssnprintf(name, sizeof(name), "rd-%s#%" PRIu64, rg->name,
+                (uint64_t)rg->threads_num);
+    set_thread_name(rg->threads[rg->threads_num], name);
+    read_group_set_affinity(rg, rg->threads[rg->threads_num]);
 
-    read_threads_num++;
+    rg->threads_num++;
   } /* for (i) */
+} /* }}} void read_group_start_threads */
+
+static void start_read_threads(size_t num) /* {{{ */
+{
+  pthread_mutex_lock(&read_lock);
+
+  /* Read functions registered before all <ReadThreadGroup> blocks had been
+   * parsed ended up in the default group. Move them to their group now. */
+  if (read_group_default.heap != NULL) {
+    c_heap_t *heap = read_group_default.heap;
+    read_func_t *rf;
+
+    read_group_default.heap = c_heap_create(plugin_compare_read_func);
+    if (read_group_default.heap == NULL) {
+      read_group_default.heap = heap;
+    } else {
+      while ((rf = c_heap_get_root(heap)) != NULL) {
+        rf->rf_read_group = read_group_find(rf);
+        read_group_insert(rf);
+      }
+      c_heap_destroy(heap);
+    }
+  }
+
+  read_group_default.threads_wanted = num;
+  for (read_group_t *rg = read_groups; rg != NULL; rg = rg->next)
+    read_group_start_threads(rg);
+
+  pthread_mutex_unlock(&read_lock);
 } /* }}} void start_read_threads */
 
 static void stop_read_threads(void) {
-  if (read_threads == NULL)
+  size_t threads_num = 0;
+
+  for (read_group_t *rg = read_groups; rg != NULL; rg = rg->next)
+    threads_num += rg->threads_num;
+  if (threads_num == 0)
     return;
 
-  INFO("collectd: Stopping %" PRIsz " read threads.", read_threads_num);
+  INFO("collectd: Stopping %" PRIsz " read threads.", threads_num);
 
   pthread_mutex_lock(&read_lock);
   read_loop = 0;
-  DEBUG("plugin: stop_read_threads: Signalling `read_cond'");
-  pthread_cond_broadcast(&read_cond);
+  DEBUG("plugin: stop_read_threads: Signalling all read threads");
+  for (read_group_t *rg = read_groups; rg != NULL; rg = rg->next) {
+    pthread_cond_broadcast(&rg->cond);
+    pthread_cond_broadcast(&rg->timer_cond);
+  }
   pthread_mutex_unlock(&read_lock);
 
-  for (size_t i = 0; i < read_threads_num; i++) {
-    if (pthread_join(read_threads[i], NULL) != 0) {
-      ERROR("plugin: stop_read_threads: pthread_join failed.");
+  for (read_group_t *rg = read_groups; rg != NULL; rg = rg->next) {
+    for (size_t i = 0; i < rg->threads_num; i++) {
+      if (pthread_join(rg->threads[i], NULL) != 0) {
+        ERROR("plugin: stop_read_threads: pthread_join failed.");
+      }
+      rg->threads[i] = (pthread_t)0;
     }
-    read_threads[i] = (pthread_t)0;
+    sfree(rg->threads);
+    rg->threads_num = 0;
   }
-  sfree(read_threads);
-  read_threads_num = 0;
 } /* void stop_read_threads */
 
 static void plugin_value_list_free(value_list_t *vl) /* {{{ */
@@ -734,17 +1486,750 @@ plugin_value_list_clone(value_list_t const *vl_orig) /* {{{ */
   return vl;
 } /* }}} value_list_t *plugin_value_list_clone */
 
+/* Creates a pool holding up to `size' unused blocks and fills it with the
+ * first few. */
+static c_ring_t *write_value_pool_create(size_t size) /* {{{ */
+{
+  c_ring_t *pool = c_ring_create(size, sizeof(write_value_t *));
+  if (pool == NULL)
+    return NULL;
+
+  for (size_t i = 0; i < WRITE_VALUE_POOL_PREALLOC; i++) {
+    write_value_t *v = malloc(WRITE_VALUE_BLOCK_SIZE);
+    if (v == NULL)
+      break;
+    if (c_ring_push(pool, &v) != 0) {
+      free(v);
+      break;
+    }
+  }
+
+  return pool;
+} /* }}} c_ring_t *write_value_pool_create */
+
+static void write_value_pool_destroy(c_ring_t *pool) /* {{{ */
+{
+  write_value_t *v;
+
+  if (pool == NULL)
+    return;
+
+  while (c_ring_pop(pool, &v) == 0)
+    free(v);
+  c_ring_destroy(pool);
+} /* }}} void write_value_pool_destroy */
+
+static void plugin_write_value_free(write_value_t *v) /* {{{ */
+{
+  if (v == NULL)
+    return;
+
+  meta_data_destroy(v->meta);
+  v->meta = NULL;
+
+  /* If the pool is full, the block is freed after all. */
+  if (v->pooled && (write_value_pool != NULL) &&
+      (c_ring_push(write_value_pool, &v) == 0))
+    return;
+
+  free(v);
+} /* }}} void plugin_write_value_free */
+
+/* Like plugin_value_list_clone(), but creates the compact form used by the
+ * write queue. */
+static write_value_t *
+plugin_write_value_create(value_list_t const *vl) /* {{{ */
+{
+  char const *names[] = {
+      (vl->host[0] != 0) ? vl->host : hostname_g,
+      vl->plugin,
+      vl->plugin_instance,
+      vl->type,
+      vl->type_instance,
+  };
+  size_t names_len[STATIC_ARRAY_SIZE(names)];
+  size_t names_size = 0;
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(names); i++) {
+    names_len[i] = strnlen(names[i], DATA_MAX_NAME_LEN - 1);
+    names_size += names_len[i] + 1;
+  }
+
+  size_t size =
+      sizeof(write_value_t) + vl->values_len * sizeof(value_t) + names_size;
+  write_value_t *v = NULL;
+  bool pooled = (write_value_pool != NULL) && (size <= WRITE_VALUE_BLOCK_SIZE);
+  if (pooled) {
+    if (c_ring_pop(write_value_pool, &v) != 0)
+      v = malloc(WRITE_VALUE_BLOCK_SIZE);
+  } else {
+    v = malloc(size);
+  }
+  if (v == NULL)
+    return NULL;
+
+  v->pooled = pooled;
+  v->values_len = vl->values_len;
+  memcpy(v->values, vl->values, vl->values_len * sizeof(v->values[0]));
+
+  char *ptr = (char *)(v->values + v->values_len);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(names); i++) {
+    memcpy(ptr, names[i], names_len[i]);
+    ptr[names_len[i]] = 0;
+    ptr += names_len[i] + 1;
+  }
+
+  v->meta = meta_data_clone(vl->meta);
+  if ((vl->meta != NULL) && (v->meta == NULL)) {
+    plugin_write_value_free(v);
+    return NULL;
+  }
+
+  v->time = (vl->time != 0) ? vl->time : cdtime();
+  /* Fill in the interval from the thread context, if it is zero. */
+  v->interval = (vl->interval != 0) ? vl->interval : plugin_get_interval();
+
+  return v;
+} /* }}} write_value_t *plugin_write_value_create */
+
+/* Expands `v' into `vl'. The values stay owned by `v', while ownership of the
+ * meta data moves to `vl'. */
+static void plugin_write_value_to_vl(write_value_t *v, /* {{{ */
+                                     value_list_t *vl) {
+  *vl = (value_list_t){
+      .values = v->values,
+      .values_len = v->values_len,
+      .time = v->time,
+      .interval = v->interval,
+      .meta = v->meta,
+  };
+  v->meta = NULL;
+
+  char *names[] = {
+      vl->host, vl->plugin, vl->plugin_instance, vl->type, vl->type_instance,
+  };
+  char const *ptr = (char const *)(v->values + v->values_len);
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(names); i++) {
+    size_t len = strlen(ptr);
+    memcpy(names[i], ptr, len + 1);
+    ptr += len + 1;
+  }
+} /* }}} void plugin_write_value_to_vl */
+
+static int write_batch_append(write_batch_t *b, write_func_t *wf, /* {{{ */
+                              data_set_t const *ds, value_list_t const *vl) {
+  if (b->num >= b->size) {
+    size_t size = (b->size == 0) ? WRITE_BATCH_SIZE : 2 * b->size;
+
+    write_batch_entry_t *entries =
+        realloc(b->entries, size * sizeof(*b->entries));
+    if (entries == NULL)
+      return ENOMEM;
+    b->entries = entries;
+
+    data_set_t const **ds_tmp = realloc(b->ds, size * sizeof(*b->ds));
+    if (ds_tmp == NULL)
+      return ENOMEM;
+    b->ds = ds_tmp;
+
+    value_list_t const **vl_tmp = realloc(b->vl, size * sizeof(*b->vl));
+    if (vl_tmp == NULL)
+      return ENOMEM;
+    b->vl = vl_tmp;
+
+    b->size = size;
+  }
+
+  b->entries[b->num] = (write_batch_entry_t){
+      .wf = wf,
+      .ds = ds,
+      .vl = vl,
+  };
+  b->num++;
+  return 0;
+} /* }}} int write_batch_append */
+
+static void write_batch_free(write_batch_t *b) /* {{{ */
+{
+  sfree(b->entries);
+  sfree(b->ds);
+  sfree(b->vl);
+  b->num = 0;
+  b->size = 0;
+} /* }}} void write_batch_free */
+
+static int plugin_write_batch_call(write_func_t *wf, /* {{{ */
+                                   data_set_t const *const *ds,
+                                   value_list_t const *const *vl, size_t num) {
+  plugin_write_batch_cb callback = wf->wf_callback;
+  cdtime_t start = (wf->wf_stats != NULL) ? cdtime() : 0;
+
+  plugin_ctx_t old_ctx = plugin_set_ctx(wf->wf_ctx);
+  int status = (*callback)(ds, vl, num, &wf->wf_udata);
+  plugin_set_ctx(old_ctx);
+
+  if (wf->wf_stats != NULL)
+    callback_stats_record(wf->wf_stats, cdtime() - start, num, status);
+
+  return status;
+} /* }}} int plugin_write_batch_call */
+
+static int plugin_write_call(write_func_t *wf, /* {{{ */
+                             data_set_t const *ds, value_list_t const *vl) {
+  plugin_write_cb callback = wf->wf_callback;
+
+  if (wf->wf_stats == NULL)
+    return (*callback)(ds, vl, &wf->wf_udata);
+
+  cdtime_t start = cdtime();
+  int status = (*callback)(ds, vl, &wf->wf_udata);
+  callback_stats_record(wf->wf_stats, cdtime() - start, /* values = */ 1,
+                        status);
+  return status;
+} /* }}} int plugin_write_call */
+
+/* Encodes a value list for a spill queue: time, interval and the number of
+ * values as uint64_t, followed by the values and the five identifier fields
+ * as null-terminated strings. Meta data is not preserved. Returns the size of
+ * the record or zero if it does not fit into `buffer'. */
+static size_t write_spill_encode(value_list_t const *vl, /* {{{ */
+                                 uint8_t *buffer, size_t buffer_size) {
+  uint64_t header[3] = {vl->time, vl->interval, vl->values_len};
+  size_t len = sizeof(header) + vl->values_len * sizeof(*vl->values);
+  if (len > buffer_size)
+    return 0;
+
+  memcpy(buffer, header, sizeof(header));
+  memcpy(buffer + sizeof(header), vl->values,
+         vl->values_len * sizeof(*vl->values));
+
+  char const *fields[] = {vl->host, vl->plugin, vl->plugin_instance, vl->type,
+                          vl->type_instance};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(fields); i++) {
+    size_t field_len = strlen(fields[i]) + 1;
+    if (len + field_len > buffer_size)
+      return 0;
+    memcpy(buffer + len, fields[i], field_len);
+    len += field_len;
+  }
+
+  return len;
+} /* }}} size_t write_spill_encode */
+
+/* Decodes a record created by write_spill_encode(). The values of `vl' point
+ * into `buffer', which must be aligned for value_t. */
+static int write_spill_decode(uint8_t *buffer, size_t size, /* {{{ */
+                              value_list_t *vl) {
+  uint64_t header[3];
+  if (size < sizeof(header))
+    return EINVAL;
+  memcpy(header, buffer, sizeof(header));
+
+  if ((header[2] == 0) ||
+      (header[2] > (size - sizeof(header)) / sizeof(value_t)))
+    return EINVAL;
+  size_t len = sizeof(header) + (size_t)header[2] * sizeof(value_t);
+
+  *vl = (value_list_t){
+      .values = (value_t *)(buffer + sizeof(header)),
+      .values_len = (size_t)header[2],
+      .time = (cdtime_t)header[0],
+      .interval = (cdtime_t)header[1],
+  };
+
+  char *fields[] = {vl->host, vl->plugin, vl->plugin_instance, vl->type,
+                    vl->type_instance};
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(fields); i++) {
+    char const *field = (char const *)buffer + len;
+    size_t field_len = strnlen(field, size - len);
+    if ((field_len == size - len) || (field_len >= DATA_MAX_NAME_LEN))
+      return EINVAL;
+    memcpy(fields[i], field, field_len + 1);
+    len += field_len + 1;
+  }
+
+  return 0;
+} /* }}} int write_spill_decode */
+
+/* Appends value lists to the spill queue. Returns zero if all of them have
+ * been stored. Must hold ws->lock when calling. */
+static int write_spill_append_locked(write_spill_t *ws, /* {{{ */
+                                     value_list_t const *const *vl,
+                                     size_t num) {
+  spill_queue_t *q = __atomic_load_n(&ws->queue, __ATOMIC_ACQUIRE);
+  if (q == NULL)
+    return ENOENT;
+
+  int status = 0;
+  size_t spilled = 0;
+  for (size_t i = 0; i < num; i++) {
+    uint8_t buffer[WRITE_SPILL_RECORD_MAX];
+    size_t size = write_spill_encode(vl[i], buffer, sizeof(buffer));
+
+    int tmp = (size > 0) ? spill_queue_append(q, buffer, size) : EMSGSIZE;
+    if (tmp != 0) {
+      status = tmp;
+      __atomic_fetch_add(&ws->dropped, 1, __ATOMIC_RELAXED);
+      plugin_record_value_dropped();
+      continue;
+    }
+    spilled++;
+  }
+  __atomic_fetch_add(&ws->spilled, spilled, __ATOMIC_RELAXED);
+
+  if (spilled > 0)
+    pthread_cond_signal(&ws->cond);
+
+  if (status != 0)
+    c_complain(LOG_ERR, &ws->complaint,
+               "WriteSpill \"%s\": Storing value lists on disk failed: %s. "
+               "Value lists are being dropped.",
+               ws->name, STRERROR(status));
+  return status;
+} /* }}} int write_spill_append_locked */
+
+/* Must hold ws->lock when calling. */
+static void write_spill_set_down_locked(write_spill_t *ws) /* {{{ */
+{
+  ws->retry_time = cdtime() + ws->retry_interval;
+  __atomic_store_n(&ws->spilling, true, __ATOMIC_RELAXED);
+  if (__atomic_exchange_n(&ws->down, true, __ATOMIC_RELAXED))
+    return;
+
+  WARNING("WriteSpill \"%s\": Writing failed. Storing value lists in \"%s\" "
+          "until writing succeeds again.",
+          ws->name, ws->directory);
+} /* }}} void write_spill_set_down_locked */
+
+/* Called when writing `vl' failed with `status': marks the write function as
+ * down and appends the value lists to the spill queue. Returns zero if all
+ * value lists have been stored. */
+static int write_spill_failed(write_spill_t *ws, /* {{{ */
+                              value_list_t const *const *vl, size_t num,
+                              int status) {
+  /* The queue is opened when collectd starts writing. */
+  if (__atomic_load_n(&ws->queue, __ATOMIC_ACQUIRE) == NULL)
+    return status;
+
+  pthread_mutex_lock(&ws->lock);
+  write_spill_set_down_locked(ws);
+  status = write_spill_append_locked(ws, vl, num);
+  pthread_mutex_unlock(&ws->lock);
+
+  return status;
+} /* }}} int write_spill_failed */
+
+/* Appends the value lists to the spill queue instead of writing them while
+ * older value lists are still waiting there. Returns true if the value lists
+ * have been handled, storing the result in `ret_status'. */
+static bool write_spill_divert(write_spill_t *ws, /* {{{ */
+                               value_list_t const *const *vl, size_t num,
+                               int *ret_status) {
+  if ((ws == NULL) || !__atomic_load_n(&ws->spilling, __ATOMIC_RELAXED))
+    return false;
+
+  /* Re-check under the lock: the replay thread may have drained the queue
+   * meanwhile, and appending now would put these after newer value lists. */
+  pthread_mutex_lock(&ws->lock);
+  bool spilling = ws->spilling;
+  if (spilling)
+    *ret_status = write_spill_append_locked(ws, vl, num);
+  pthread_mutex_unlock(&ws->lock);
+
+  return spilling;
+} /* }}} bool write_spill_divert */
+
+/* Reads up to `max' value lists from the spill queue and writes them. The
+ * value lists are removed from the queue if writing succeeded. The number of
+ * value lists written is stored in `ret_num'. */
+static int write_spill_replay(write_spill_t *ws, uint8_t *records, /* {{{ */
+                              size_t max, size_t *ret_num) {
+  *ret_num = 0;
+
+  write_vector_t *v = __atomic_load_n(&write_vector, __ATOMIC_ACQUIRE);
+  write_func_t *wf = NULL;
+  if ((v != NULL) && (ws->target_id < v->targets_num))
+    wf = v->targets[ws->target_id];
+  if (wf == NULL)
+    return ENOENT;
+  if (!wf->wf_batch)
+    max = 1;
+
+  value_list_t vl[WRITE_SPILL_BATCH_SIZE];
+  data_set_t const *ds_ptr[WRITE_SPILL_BATCH_SIZE];
+  value_list_t const *vl_ptr[WRITE_SPILL_BATCH_SIZE];
+  size_t num = 0;
+
+  while (num < max) {
+    uint8_t *record = records + num * WRITE_SPILL_RECORD_MAX;
+    size_t size = 0;
+    int status =
+        spill_queue_read(ws->queue, record, WRITE_SPILL_RECORD_MAX, &size);
+    if (status == ENOENT)
+      break;
+    if ((status != 0) || (write_spill_decode(record, size, vl + num) != 0)) {
+      ERROR("WriteSpill \"%s\": Skipping an invalid record.", ws->name);
+      continue;
+    }
+
+    ds_ptr[num] = plugin_get_ds(vl[num].type);
+    if (ds_ptr[num] == NULL) {
+      ERROR("WriteSpill \"%s\": Skipping a value list of unknown type \"%s\".",
+            ws->name, vl[num].type);
+      continue;
+    }
+    vl_ptr[num] = vl + num;
+    num++;
+  }
+
+  int status = 0;
+  if (num > 0) {
+    plugin_ctx_t old_ctx = plugin_set_ctx(wf->wf_ctx);
+    if (wf->wf_batch)
+      status = plugin_write_batch_call(wf, ds_ptr, vl_ptr, num);
+    else
+      status = plugin_write_call(wf, ds_ptr[0], vl_ptr[0]);
+    plugin_set_ctx(old_ctx);
+  }
+
+  if (status != 0) {
+    spill_queue_rewind(ws->queue);
+    return status;
+  }
+
+  spill_queue_commit(ws->queue);
+  __atomic_fetch_add(&ws->replayed, num, __ATOMIC_RELAXED);
+  *ret_num = num;
+  return 0;
+} /* }}} int write_spill_replay */
+
+/* Called when the queue is empty: value lists are written directly again.
+ * Value lists are only appended with ws->lock held while spilling, so none
+ * can end up in the queue behind newer ones written directly. If the queue is
+ * empty because storing failed, the next write checks whether the backend is
+ * back. Must hold ws->lock when calling. */
+static void write_spill_drained_locked(write_spill_t *ws) /* {{{ */
+{
+  if (!ws->spilling)
+    return;
+
+  __atomic_store_n(&ws->down, false, __ATOMIC_RELAXED);
+  __atomic_store_n(&ws->spilling, false, __ATOMIC_RELAXED);
+  INFO("WriteSpill \"%s\": The queue has been replayed. Writing value lists "
+       "directly again.",
+       ws->name);
+} /* }}} void write_spill_drained_locked */
+
+static void *write_spill_thread(void *arg) /* {{{ */
+{
+  write_spill_t *ws = arg;
+
+  /* Writing `max' value lists at once takes at most one second at the
+   * configured rate. */
+  size_t max = WRITE_SPILL_BATCH_SIZE;
+  if (ws->replay_rate < (double)max)
+    max = (ws->replay_rate >= 1.0) ? (size_t)ws->replay_rate : 1;
+
+  uint8_t *records = malloc(max * WRITE_SPILL_RECORD_MAX);
+  if (records == NULL) {
+    ERROR("WriteSpill \"%s\": malloc failed.", ws->name);
+    return NULL;
+  }
+
+  pthread_mutex_lock(&ws->lock);
+  while (ws->loop) {
+    if (spill_queue_empty(ws->queue)) {
+      write_spill_drained_locked(ws);
+      pthread_cond_wait(&ws->cond, &ws->lock);
+      continue;
+    }
+
+    if (__atomic_load_n(&ws->down, __ATOMIC_RELAXED) &&
+        (cdtime() < ws->retry_time)) {
+      struct timespec ts = CDTIME_T_TO_TIMESPEC(ws->retry_time);
+      pthread_cond_timedwait(&ws->cond, &ws->lock, &ts);
+      continue;
+    }
+    pthread_mutex_unlock(&ws->lock);
+
+    size_t num = 0;
+    int status = write_spill_replay(ws, records, max, &num);
+
+    pthread_mutex_lock(&ws->lock);
+    if (status != 0) {
+      write_spill_set_down_locked(ws);
+      continue;
+    }
+
+    if (__atomic_exchange_n(&ws->down, false, __ATOMIC_RELAXED))
+      INFO("WriteSpill \"%s\": Writing succeeded again. %" PRIu64
+           " bytes of value lists left to replay.",
+           ws->name, spill_queue_size(ws->queue));
+
+    if (num > 0) {
+      cdtime_t until =
+          cdtime() + DOUBLE_TO_CDTIME_T((double)num / ws->replay_rate);
+      struct timespec ts = CDTIME_T_TO_TIMESPEC(until);
+      while (ws->loop && (cdtime() < until)) {
+        if (pthread_cond_timedwait(&ws->cond, &ws->lock, &ts) == ETIMEDOUT)
+          break;
+      }
+    }
+  }
+  pthread_mutex_unlock(&ws->lock);
+
+  free(records);
+  return NULL;
+} /* }}} void *write_spill_thread */
+
+/* Calls the batch writers with all value lists collected since the last
+ * call, grouped by writer. */
+static void write_batch_submit(write_batch_t *b) /* {{{ */
+{
+  for (size_t i = 0; i < b->num; i++) {
+    write_func_t *wf = b->entries[i].wf;
+    size_t num = 0;
+
+    if (wf == NULL)
+      continue;
+
+    for (size_t j = i; j < b->num; j++) {
+      if (b->entries[j].wf != wf)
+        continue;
+
+      b->ds[num] = b->entries[j].ds;
+      b->vl[num] = b->entries[j].vl;
+      b->entries[j].wf = NULL;
+      num++;
+    }
+
+    write_spill_t *ws = __atomic_load_n(&wf->wf_spill, __ATOMIC_ACQUIRE);
+    int status = 0;
+    if (!write_spill_divert(ws, b->vl, num, &status)) {
+      status = plugin_write_batch_call(wf, b->ds, b->vl, num);
+      if ((status != 0) && (ws != NULL))
+        status = write_spill_failed(ws, b->vl, num, status);
+    }
+    if (status != 0) {
+      c_complain(LOG_INFO, &wf->wf_complaint,
+                 "plugin: Writing %" PRIsz " value lists via `%s' failed "
+                 "with status %i.",
+                 num, wf->wf_ctx.name, status);
+    } else {
+      c_release(LOG_INFO, &wf->wf_complaint,
+                "plugin: Writing via `%s' succeeded again.", wf->wf_ctx.name);
+    }
+  }
+
+  b->num = 0;
+} /* }}} void write_batch_submit */
+
+static write_batch_t *write_batch_get(void) /* {{{ */
+{
+  if (!write_batch_key_initialized)
+    return NULL;
+
+  return pthread_getspecific(write_batch_key);
+} /* }}} write_batch_t *write_batch_get */
+
+EXPORT void plugin_write_batch_flush(const value_list_t *vl) /* {{{ */
+{
+  write_batch_t *batch = write_batch_get();
+  if ((batch == NULL) || (batch->current != vl) || (batch->num == 0))
+    return;
+
+  write_batch_submit(batch);
+} /* }}} void plugin_write_batch_flush */
+
+static void plugin_write_ring_wakeup(bool all) /* {{{ */
+{
+  /* Only take the lock if a write thread may be sleeping. The fence pairs
+   * with the one in plugin_write_ring_dequeue(), so either the sleeper sees
+   * our entry or we see the sleeper. */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&write_ring_sleepers, __ATOMIC_RELAXED) > 0) {
+    pthread_mutex_lock(&write_lock);
+    if (all)
+      pthread_cond_broadcast(&write_cond);
+    else
+      pthread_cond_signal(&write_cond);
+    pthread_mutex_unlock(&write_lock);
+  }
+} /* }}} void plugin_write_ring_wakeup */
+
+static int plugin_write_ring_push(value_list_t const *vl, /* {{{ */
+                                  plugin_ctx_t ctx) {
+  write_queue_t q = {
+      .value = plugin_write_value_create(vl),
+      .ctx = ctx,
+  };
+  if (q.value == NULL)
+    return ENOMEM;
+
+  int status = c_ring_push(write_ring, &q);
+  if (status == EAGAIN) {
+    /* The ring is full: treat this like exceeding WriteQueueLimitHigh. */
+    static c_complain_t ring_full_complaint = C_COMPLAIN_INIT_STATIC;
+
+    plugin_write_value_free(q.value);
+    c_complain(LOG_ERR, &ring_full_complaint,
+               "plugin_dispatch_values: The write queue ring is full "
+               "(%" PRIsz " entries). Dropping metrics.",
+               c_ring_capacity(write_ring));
+    plugin_record_value_dropped();
+    return 0;
+  } else if (status != 0) {
+    plugin_write_value_free(q.value);
+    return status;
+  }
+
+  return 0;
+} /* }}} int plugin_write_ring_push */
+
+/* Returns the number of entries a write thread should take from a queue of
+ * length `len' so that the queue is shared among all write threads. */
+static size_t plugin_write_dequeue_share(size_t len, size_t max) /* {{{ */
+{
+  size_t num = len;
+
+  if (write_threads_wanted > 1)
+    num = len / write_threads_wanted;
+  if (num < 1)
+    num = 1;
+  if (num > max)
+    num = max;
+
+  return num;
+} /* }}} size_t plugin_write_dequeue_share */
+
+static size_t plugin_write_ring_dequeue(write_queue_t *entries, /* {{{ */
+                                        size_t max) {
+  while (c_ring_pop(write_ring, &entries[0]) != 0) {
+    pthread_mutex_lock(&write_lock);
+    __atomic_add_fetch(&write_ring_sleepers, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    int status = c_ring_pop(write_ring, &entries[0]);
+    if ((status != 0) && write_loop)
+      pthread_cond_wait(&write_cond, &write_lock);
+
+    __atomic_sub_fetch(&write_ring_sleepers, 1, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&write_lock);
+
+    if (status == 0)
+      break;
+    if (!write_loop)
+      return 0;
+  }
+
+  size_t num = plugin_write_dequeue_share(c_ring_length(write_ring) + 1, max);
+  size_t i = 1;
+  while ((i < num) && (c_ring_pop(write_ring, &entries[i]) == 0))
+    i++;
+
+  return i;
+} /* }}} size_t plugin_write_ring_dequeue */
+
+static int plugin_write_enqueue_batch(value_list_t const *vls, /* {{{ */
+                                      size_t num) {
+  /* Store context of caller (read plugin); otherwise, it would not be
+   * available to the write plugins when actually dispatching the
+   * value-list later on. */
+  plugin_ctx_t ctx = plugin_get_ctx();
+  int status = 0;
+
+  if (write_ring != NULL) {
+    size_t pushed = 0;
+
+    for (size_t i = 0; i < num; i++) {
+      if (check_drop_value()) {
+        plugin_record_value_dropped();
+        continue;
+      }
+
+      status = plugin_write_ring_push(vls + i, ctx);
+      if (status != 0)
+        break;
+      pushed++;
+    }
+
+    if (pushed > 0)
+      plugin_write_ring_wakeup(/* all = */ pushed > 1);
+    return status;
+  }
+
+  write_queue_t *head = NULL;
+  write_queue_t *tail = NULL;
+  long len = 0;
+
+  for (size_t i = 0; i < num; i++) {
+    if (check_drop_value()) {
+      plugin_record_value_dropped();
+      continue;
+    }
+
+    write_queue_t *q = malloc(sizeof(*q));
+    if (q == NULL) {
+      status = ENOMEM;
+      break;
+    }
+    q->next = NULL;
+    q->ctx = ctx;
+
+    q->value = plugin_write_value_create(vls + i);
+    if (q->value == NULL) {
+      sfree(q);
+      status = ENOMEM;
+      break;
+    }
+
+    if (tail == NULL)
+      head = q;
+    else
+      tail->next = q;
+    tail = q;
+    len++;
+  }
+
+  if (head == NULL)
+    return status;
+
+  pthread_mutex_lock(&write_lock);
+
+  if (write_queue_tail == NULL)
+    write_queue_head = head;
+  else
+    write_queue_tail->next = head;
+  write_queue_tail = tail;
+  write_queue_length += len;
+
+  if (len > 1)
+    pthread_cond_broadcast(&write_cond);
+  else
+    pthread_cond_signal(&write_cond);
+  pthread_mutex_unlock(&write_lock);
+
+  return status;
+} /* }}} int plugin_write_enqueue_batch */
+
 static int plugin_write_enqueue(value_list_t const *vl) /* {{{ */
 {
   write_queue_t *q;
 
+  if (write_ring != NULL) {
+    int status = plugin_write_ring_push(vl, plugin_get_ctx());
+    if (status == 0)
+      plugin_write_ring_wakeup(/* all = */ false);
+    return status;
+  }
+
   q = malloc(sizeof(*q));
   if (q == NULL)
     return ENOMEM;
   q->next = NULL;
 
-  q->vl = plugin_value_list_clone(vl);
-  if (q->vl == NULL) {
+  q->value = plugin_write_value_create(vl);
+  if (q->value == NULL) {
     sfree(q);
     return ENOMEM;
   }
@@ -772,10 +2257,14 @@ static int plugin_write_enqueue(value_list_t const *vl) /* {{{ */
   return 0;
 } /* }}} int plugin_write_enqueue */
 
-static value_list_t *plugin_write_dequeue(void) /* {{{ */
-{
-  write_queue_t *q;
-  value_list_t *vl;
+/* Removes up to `max' entries from the write queue, blocking until at least
+ * one is available. Returns zero if the write threads are shutting down. */
+static size_t plugin_write_dequeue(write_queue_t *entries, /* {{{ */
+                                   size_t max) {
+  size_t num;
+
+  if (write_ring != NULL)
+    return plugin_write_ring_dequeue(entries, max);
 
   pthread_mutex_lock(&write_lock);
 
@@ -784,12 +2273,19 @@ static value_list_t *plugin_write_dequeue(void) /* {{{ */
 
   if (write_queue_head == NULL) {
     pthread_mutex_unlock(&write_lock);
-    return NULL;
+    return 0;
+  }
+
+  max = plugin_write_dequeue_share((size_t)write_queue_length, max);
+  for (num = 0; (num < max) && (write_queue_head != NULL); num++) {
+    write_queue_t *q = write_queue_head;
+
+    write_queue_head = q->next;
+    write_queue_length -= 1;
+    entries[num] = *q;
+    sfree(q);
   }
 
-  q = write_queue_head;
-  write_queue_head = q->next;
-  write_queue_length -= 1;
   if (write_queue_head == NULL) {
     write_queue_tail = NULL;
     assert(0 == write_queue_length);
@@ -797,25 +2293,49 @@ static value_list_t *plugin_write_dequeue(void) /* {{{ */
 
   pthread_mutex_unlock(&write_lock);
 
-  (void)plugin_set_ctx(q->ctx);
-
-  vl = q->vl;
-  sfree(q);
-  return vl;
-} /* }}} value_list_t *plugin_write_dequeue */
+  return num;
+} /* }}} size_t plugin_write_dequeue */
 
 static void *plugin_write_thread(void __attribute__((unused)) * args) /* {{{ */
 {
+  write_batch_t batch = {0};
+  value_list_t *vls = calloc(WRITE_BATCH_SIZE, sizeof(*vls));
+
+  if (vls == NULL) {
+    ERROR("plugin_write_thread: calloc failed.");
+    pthread_exit(NULL);
+    return (void *)0;
+  }
+
+  pthread_setspecific(write_batch_key, &batch);
+
   while (write_loop) {
-    value_list_t *vl = plugin_write_dequeue();
-    if (vl == NULL)
-      continue;
+    write_queue_t entries[WRITE_BATCH_SIZE];
+    size_t num = plugin_write_dequeue(entries, STATIC_ARRAY_SIZE(entries));
 
-    plugin_dispatch_values_internal(vl);
+    for (size_t i = 0; i < num; i++) {
+      (void)plugin_set_ctx(entries[i].ctx);
 
-    plugin_value_list_free(vl);
+      plugin_write_value_to_vl(entries[i].value, vls + i);
+      batch.current = vls + i;
+      plugin_dispatch_values_internal(vls + i);
+      batch.current = NULL;
+    }
+
+    /* Batch writers may still reference the value lists, so free them only
+     * after the batch has been submitted. */
+    write_batch_submit(&batch);
+
+    for (size_t i = 0; i < num; i++) {
+      meta_data_destroy(vls[i].meta);
+      plugin_write_value_free(entries[i].value);
+    }
   }
 
+  pthread_setspecific(write_batch_key, NULL);
+  write_batch_free(&batch);
+  free(vls);
+
   pthread_exit(NULL);
   return (void *)0;
 } /* }}} void *plugin_write_thread */
@@ -825,6 +2345,17 @@ static void start_write_threads(size_t num) /* {{{ */
   if (write_threads != NULL)
     return;
 
+  if (!write_batch_key_initialized) {
+    int status = pthread_key_create(&write_batch_key, /* destructor = */ NULL);
+    if (status != 0) {
+      ERROR("plugin: start_write_threads: pthread_key_create failed with "
+            "status %i (%s).",
+            status, STRERROR(status));
+      return;
+    }
+    write_batch_key_initialized = true;
+  }
+
   write_threads = calloc(num, sizeof(*write_threads));
   if (write_threads == NULL) {
     ERROR("plugin: start_write_threads: calloc failed.");
@@ -832,6 +2363,7 @@ static void start_write_threads(size_t num) /* {{{ */
   }
 
   write_threads_num = 0;
+  write_threads_wanted = num;
   for (size_t i = 0; i < num; i++) {
     int status = pthread_create(write_threads + write_threads_num,
                                 /* attr = */ NULL, plugin_write_thread,
@@ -881,7 +2413,7 @@ static void stop_write_threads(void) /* {{{ */
   i = 0;
   for (q = write_queue_head; q != NULL;) {
     write_queue_t *q1 = q;
-    plugin_value_list_free(q->vl);
+    plugin_write_value_free(q->value);
     q = q->next;
     sfree(q1);
     i++;
@@ -889,6 +2421,14 @@ static void stop_write_threads(void) /* {{{ */
   write_queue_head = NULL;
   write_queue_tail = NULL;
   write_queue_length = 0;
+
+  if (write_ring != NULL) {
+    write_queue_t entry;
+    while (c_ring_pop(write_ring, &entry) == 0) {
+      plugin_write_value_free(entry.value);
+      i++;
+    }
+  }
   pthread_mutex_unlock(&write_lock);
 
   if (i > 0) {
@@ -898,6 +2438,106 @@ static void stop_write_threads(void) /* {{{ */
   }
 } /* }}} void stop_write_threads */
 
+/* Frees the write ring and the write value pool. Receiving threads of
+ * plugins push to the ring without a lock until their shutdown callback has
+ * stopped them, so this must only be called after all shutdown callbacks. */
+static void destroy_write_ring(void) /* {{{ */
+{
+  if (write_ring != NULL) {
+    write_queue_t entry;
+    while (c_ring_pop(write_ring, &entry) == 0)
+      plugin_write_value_free(entry.value);
+    c_ring_destroy(write_ring);
+    write_ring = NULL;
+  }
+
+  write_value_pool_destroy(write_value_pool);
+  write_value_pool = NULL;
+} /* }}} void destroy_write_ring */
+
+static void start_spill_threads(void) /* {{{ */
+{
+  for (write_spill_t *ws = write_spills; ws != NULL; ws = ws->next) {
+    if (plugin_write_target_id(ws->name, &ws->target_id) != 0)
+      continue;
+
+    write_vector_t *v = __atomic_load_n(&write_vector, __ATOMIC_ACQUIRE);
+    if ((v == NULL) || (ws->target_id >= v->targets_num) ||
+        (v->targets[ws->target_id] == NULL)) {
+      WARNING("WriteSpill \"%s\": No write callback with this name has been "
+              "registered.",
+              ws->name);
+      continue;
+    }
+
+    spill_queue_t *q =
+        spill_queue_open(ws->directory, ws->max_size, ws->segment_size);
+    if (q == NULL) {
+      ERROR("WriteSpill \"%s\": Opening the queue in \"%s\" failed.",
+            ws->name, ws->directory);
+      continue;
+    }
+    if (!spill_queue_empty(q))
+      INFO("WriteSpill \"%s\": Replaying %" PRIu64 " bytes of value lists "
+           "from \"%s\".",
+           ws->name, spill_queue_size(q), ws->directory);
+    __atomic_store_n(&ws->queue, q, __ATOMIC_RELEASE);
+
+    ws->loop = true;
+    int status = pthread_create(&ws->thread, /* attr = */ NULL,
+                                write_spill_thread, /* arg = */ ws);
+    if (status != 0) {
+      ERROR("WriteSpill \"%s\": pthread_create failed with status %i (%s).",
+            ws->name, status, STRERROR(status));
+      continue;
+    }
+    set_thread_name(ws->thread, "spill replay");
+    ws->thread_running = true;
+
+    /* Value lists left from the last run are written first. */
+    pthread_mutex_lock(&ws->lock);
+    if (!spill_queue_empty(q))
+      __atomic_store_n(&ws->spilling, true, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&ws->lock);
+  }
+} /* }}} void start_spill_threads */
+
+/* Stops the replay threads and closes the spill queues. Value lists still in
+ * a queue are replayed after the next start. */
+static void stop_spill_threads(void) /* {{{ */
+{
+  for (write_spill_t *ws = write_spills; ws != NULL; ws = ws->next) {
+    if (ws->thread_running) {
+      pthread_mutex_lock(&ws->lock);
+      ws->loop = false;
+      pthread_cond_broadcast(&ws->cond);
+      pthread_mutex_unlock(&ws->lock);
+
+      pthread_join(ws->thread, NULL);
+      ws->thread_running = false;
+    }
+
+    spill_queue_t *q = __atomic_exchange_n(&ws->queue, NULL, __ATOMIC_ACQ_REL);
+    if ((q != NULL) && !spill_queue_empty(q))
+      INFO("WriteSpill \"%s\": %" PRIu64 " bytes of value lists remain in "
+           "\"%s\".",
+           ws->name, spill_queue_size(q), ws->directory);
+    spill_queue_close(q);
+  }
+} /* }}} void stop_spill_threads */
+
+static void write_spill_free(write_spill_t *ws) /* {{{ */
+{
+  if (ws == NULL)
+    return;
+
+  pthread_cond_destroy(&ws->cond);
+  pthread_mutex_destroy(&ws->lock);
+  sfree(ws->name);
+  sfree(ws->directory);
+  sfree(ws);
+} /* }}} void write_spill_free */
+
 /*
  * Public functions
  */
@@ -1085,15 +2725,16 @@ static int plugin_compare_read_func(const void *arg0, const void *arg1) {
     return 0;
 } /* int plugin_compare_read_func */
 
-/* Add a read function to both, the heap and a linked list. The linked list if
- * used to look-up read functions, especially for the remove function. The heap
- * is used to determine which plugin to read next. */
+/* Add a read function to both, the heap of its read group and a linked list.
+ * The linked list if used to look-up read functions, especially for the remove
+ * function. The heap is used to determine which plugin to read next. */
 static int plugin_insert_read(read_func_t *rf) {
   int status;
   llentry_t *le;
 
   rf->rf_next_read = cdtime();
   rf->rf_effective_interval = rf->rf_interval;
+  callback_stats_enable(&rf->rf_super);
 
   pthread_mutex_lock(&read_lock);
 
@@ -1106,15 +2747,6 @@ static int plugin_insert_read(read_func_t *rf) {
     }
   }
 
-  if (read_heap == NULL) {
-    read_heap = c_heap_create(plugin_compare_read_func);
-    if (read_heap == NULL) {
-      pthread_mutex_unlock(&read_lock);
-      ERROR("plugin_insert_read: c_heap_create failed.");
-      return -1;
-    }
-  }
-
   le = llist_search(read_list, rf->rf_name);
   if (le != NULL) {
     pthread_mutex_unlock(&read_lock);
@@ -1131,10 +2763,11 @@ static int plugin_insert_read(read_func_t *rf) {
     return -1;
   }
 
-  status = c_heap_insert(read_heap, rf);
+  rf->rf_read_group = read_group_find(rf);
+  status = read_group_insert(rf);
   if (status != 0) {
     pthread_mutex_unlock(&read_lock);
-    ERROR("plugin_insert_read: c_heap_insert failed.");
+    ERROR("plugin_insert_read: read_group_insert failed.");
     llentry_destroy(le);
     return -1;
   }
@@ -1142,8 +2775,6 @@ static int plugin_insert_read(read_func_t *rf) {
   /* This does not fail. */
   llist_append(read_list, le);
 
-  /* Wake up all the read threads. */
-  pthread_cond_broadcast(&read_cond);
   pthread_mutex_unlock(&read_lock);
   return 0;
 } /* int plugin_insert_read */
@@ -1221,11 +2852,51 @@ EXPORT int plugin_register_complex_read(const char *group, const char *name,
   return status;
 } /* int plugin_register_complex_read */
 
+static int create_register_write(const char *name, void *callback, /* {{{ */
+                                 bool batch, user_data_t const *ud) {
+  if (name == NULL || callback == NULL)
+    return EINVAL;
+
+  write_func_t *wf = calloc(1, sizeof(*wf));
+  if (wf == NULL) {
+    free_userdata(ud);
+    ERROR("plugin: create_register_write: calloc failed.");
+    return ENOMEM;
+  }
+
+  wf->wf_callback = callback;
+  if (ud == NULL) {
+    wf->wf_udata = (user_data_t){
+        .data = NULL,
+        .free_func = NULL,
+    };
+  } else {
+    wf->wf_udata = *ud;
+  }
+  wf->wf_ctx = plugin_get_ctx();
+  wf->wf_batch = batch;
+  C_COMPLAIN_INIT(&wf->wf_complaint);
+  callback_stats_enable((callback_func_t *)wf);
+
+  int status = register_callback(&list_write, name, (callback_func_t *)wf);
+  if (status == 0)
+    write_vector_changed();
+  return status;
+} /* }}} int create_register_write */
+
 EXPORT int plugin_register_write(const char *name, plugin_write_cb callback,
                                  user_data_t const *ud) {
-  return create_register_callback(&list_write, name, (void *)callback, ud);
+  return create_register_write(name, (void *)callback, /* batch = */ false,
+                               ud);
 } /* int plugin_register_write */
 
+EXPORT int plugin_register_write_batch(const char *name,
+                                       plugin_write_batch_cb callback,
+                                       user_data_t const *ud) {
+  return create_register_write(name, (void *)callback, /* batch = */ true,
+                               ud);
+} /* int plugin_register_write_batch */
+
 static int plugin_flush_timeout_callback(user_data_t *ud) {
   flush_callback_t *cb = ud->data;
 
@@ -1552,7 +3223,21 @@ EXPORT int plugin_unregister_read_group(const char *group) /* {{{ */
 } /* }}} int plugin_unregister_read_group */
 
 EXPORT int plugin_unregister_write(const char *name) {
-  return plugin_unregister(list_write, name);
+  if (list_write == NULL)
+    return -1;
+
+  llentry_t *le = llist_search(list_write, name);
+  if (le == NULL)
+    return -1;
+
+  llist_remove(list_write, le);
+  write_vector_changed();
+
+  /* The function is freed on shutdown, after the write threads are gone. */
+  write_func_retire(le->key, le->value);
+  sfree(le->key);
+  llentry_destroy(le);
+  return 0;
 }
 
 EXPORT int plugin_unregister_flush(const char *name) {
@@ -1628,6 +3313,228 @@ EXPORT int plugin_unregister_notification(const char *name) {
   return plugin_unregister(list_notification, name);
 }
 
+static int read_group_config_cpus(oconfig_item_t const *ci, /* {{{ */
+                                  read_group_t *rg) {
+  for (int i = 0; i < ci->values_num; i++) {
+    unsigned int first;
+    unsigned int last;
+
+    if (ci->values[i].type == OCONFIG_TYPE_NUMBER) {
+      first = last = (unsigned int)ci->values[i].value.number;
+    } else {
+      char const *str = ci->values[i].value.string;
+      int n = sscanf(str, "%u-%u", &first, &last);
+      if (n == 1)
+        last = first;
+      else if (n != 2) {
+        ERROR("ReadThreadGroup \"%s\": Invalid CPU or CPU range \"%s\".",
+              rg->name, str);
+        return EINVAL;
+      }
+    }
+
+#if HAVE_PTHREAD_SETAFFINITY_NP
+    if ((last < first) || (last >= CPU_SETSIZE)) {
+      ERROR("ReadThreadGroup \"%s\": Invalid CPU range %u-%u.", rg->name,
+            first, last);
+      return EINVAL;
+    }
+#endif
+
+    for (unsigned int cpu = first; cpu <= last; cpu++) {
+      unsigned int *tmp =
+          realloc(rg->cpus, (rg->cpus_num + 1) * sizeof(*rg->cpus));
+      if (tmp == NULL)
+        return ENOMEM;
+      rg->cpus = tmp;
+      rg->cpus[rg->cpus_num++] = cpu;
+    }
+  }
+
+#if !HAVE_PTHREAD_SETAFFINITY_NP
+  WARNING("ReadThreadGroup \"%s\": Setting the CPU affinity is not supported "
+          "on this platform. The \"CPUs\" option will be ignored.",
+          rg->name);
+#endif
+  return 0;
+} /* }}} int read_group_config_cpus */
+
+EXPORT int plugin_configure_read_thread_group(oconfig_item_t const *ci) {
+  read_group_t *rg = calloc(1, sizeof(*rg));
+  if (rg == NULL)
+    return ENOMEM;
+  rg->threads_wanted = 1;
+
+  int status = cf_util_get_string(ci, &rg->name);
+  if (status != 0) {
+    sfree(rg);
+    return status;
+  }
+
+  if (strcasecmp(rg->name, read_group_default.name) == 0) {
+    ERROR("ReadThreadGroup: The name \"%s\" is reserved.", rg->name);
+    read_group_free(rg);
+    return EINVAL;
+  }
+
+  for (int i = 0; (i < ci->children_num) && (status == 0); i++) {
+    oconfig_item_t *child = ci->children + i;
+
+    if (strcasecmp("Threads", child->key) == 0) {
+      int threads = 0;
+      status = cf_util_get_int(child, &threads);
+      if ((status == 0) && (threads < 1)) {
+        ERROR("ReadThreadGroup \"%s\": Threads must be at least 1.",
+              rg->name);
+        status = EINVAL;
+      }
+      rg->threads_wanted = (size_t)threads;
+    } else if (strcasecmp("Plugin", child->key) == 0) {
+      char *plugin = NULL;
+      status = cf_util_get_string(child, &plugin);
+      if (status != 0)
+        break;
+
+      char **tmp =
+          realloc(rg->plugins, (rg->plugins_num + 1) * sizeof(*rg->plugins));
+      if (tmp == NULL) {
+        sfree(plugin);
+        status = ENOMEM;
+        break;
+      }
+      rg->plugins = tmp;
+      rg->plugins[rg->plugins_num++] = plugin;
+    } else if (strcasecmp("CPUs", child->key) == 0) {
+      status = read_group_config_cpus(child, rg);
+    } else {
+      ERROR("ReadThreadGroup \"%s\": Unknown option \"%s\".", rg->name,
+            child->key);
+      status = EINVAL;
+    }
+  }
+
+  if (status != 0) {
+    read_group_free(rg);
+    return status;
+  }
+
+  pthread_mutex_lock(&read_lock);
+
+  read_group_t *last = read_groups;
+  while (42) {
+    if (strcasecmp(last->name, rg->name) == 0) {
+      pthread_mutex_unlock(&read_lock);
+      ERROR("ReadThreadGroup: The group \"%s\" is defined more than once.",
+            rg->name);
+      read_group_free(rg);
+      return EINVAL;
+    }
+    if (last->next == NULL)
+      break;
+    last = last->next;
+  }
+
+  pthread_cond_init(&rg->cond, /* attr = */ NULL);
+  pthread_cond_init(&rg->timer_cond, /* attr = */ NULL);
+  last->next = rg;
+
+  pthread_mutex_unlock(&read_lock);
+  return 0;
+} /* int plugin_configure_read_thread_group */
+
+static int write_spill_config_size(oconfig_item_t const *ci, /* {{{ */
+                                   char const *name, uint64_t *ret) {
+  double size = 0;
+  int status = cf_util_get_double(ci, &size);
+  if (status != 0)
+    return status;
+
+  if (!(size >= 1.0) || (size > (double)INT64_MAX)) {
+    ERROR("WriteSpill \"%s\": %s must be a positive number of bytes.", name,
+          ci->key);
+    return EINVAL;
+  }
+
+  *ret = (uint64_t)size;
+  return 0;
+} /* }}} int write_spill_config_size */
+
+EXPORT int plugin_configure_write_spill(oconfig_item_t const *ci) {
+  write_spill_t *ws = calloc(1, sizeof(*ws));
+  if (ws == NULL)
+    return ENOMEM;
+  ws->max_size = DEFAULT_WRITE_SPILL_MAX_SIZE;
+  ws->segment_size = DEFAULT_WRITE_SPILL_SEGMENT_SIZE;
+  ws->replay_rate = DEFAULT_WRITE_SPILL_REPLAY_RATE;
+  ws->retry_interval = DEFAULT_WRITE_SPILL_RETRY_INTERVAL;
+  pthread_mutex_init(&ws->lock, /* attr = */ NULL);
+  pthread_cond_init(&ws->cond, /* attr = */ NULL);
+  C_COMPLAIN_INIT(&ws->complaint);
+
+  int status = cf_util_get_string(ci, &ws->name);
+  if (status != 0) {
+    write_spill_free(ws);
+    return status;
+  }
+
+  for (int i = 0; (i < ci->children_num) && (status == 0); i++) {
+    oconfig_item_t *child = ci->children + i;
+
+    if (strcasecmp("Directory", child->key) == 0)
+      status = cf_util_get_string(child, &ws->directory);
+    else if (strcasecmp("MaxSize", child->key) == 0)
+      status = write_spill_config_size(child, ws->name, &ws->max_size);
+    else if (strcasecmp("SegmentSize", child->key) == 0)
+      status = write_spill_config_size(child, ws->name, &ws->segment_size);
+    else if (strcasecmp("ReplayRate", child->key) == 0) {
+      status = cf_util_get_double(child, &ws->replay_rate);
+      if ((status == 0) && !(ws->replay_rate > 0.0)) {
+        ERROR("WriteSpill \"%s\": ReplayRate must be positive.", ws->name);
+        status = EINVAL;
+      }
+    } else if (strcasecmp("RetryInterval", child->key) == 0) {
+      status = cf_util_get_cdtime(child, &ws->retry_interval);
+    } else {
+      ERROR("WriteSpill \"%s\": Unknown option \"%s\".", ws->name,
+            child->key);
+      status = EINVAL;
+    }
+  }
+
+  if ((status == 0) && (ws->directory == NULL)) {
+    /* Relative to BaseDir. Write callback names often contain slashes. */
+    char directory[PATH_MAX];
+    ssnprintf(directory, sizeof(directory), "spill/%s", ws->name);
+    for (char *c = directory + strlen("spill/"); *c != 0; c++) {
+      if (*c == '/')
+        *c = '-';
+    }
+    ws->directory = strdup(directory);
+    if (ws->directory == NULL)
+      status = ENOMEM;
+  }
+
+  if ((status == 0) && (write_spill_find(ws->name) != NULL)) {
+    ERROR("WriteSpill \"%s\": Configured more than once.", ws->name);
+    status = EINVAL;
+  }
+
+  if (status != 0) {
+    write_spill_free(ws);
+    return status;
+  }
+
+  write_spill_t **last = &write_spills;
+  while (*last != NULL)
+    last = &(*last)->next;
+  *last = ws;
+
+  /* Attach the queue to the write function if it has already been
+   * registered. */
+  write_vector_changed();
+  return 0;
+} /* int plugin_configure_write_spill */
+
 EXPORT int plugin_init_all(void) {
   char const *chain_name;
   llentry_t *le;
@@ -1639,14 +3546,30 @@ EXPORT int plugin_init_all(void) {
 
   if (IS_TRUE(global_option_get("CollectInternalStats"))) {
     record_statistics = true;
+
+    /* Callbacks registered from now on get their statistics allocated when
+     * they are registered. */
+    pthread_mutex_lock(&read_lock);
+    for (le = llist_head(read_list); le != NULL; le = le->next)
+      callback_stats_enable(le->value);
+    pthread_mutex_unlock(&read_lock);
+    for (le = llist_head(list_write); le != NULL; le = le->next)
+      callback_stats_enable(le->value);
+    for (le = llist_head(list_flush); le != NULL; le = le->next)
+      callback_stats_enable(le->value);
+
     plugin_register_read("collectd", plugin_update_internal_statistics);
   }
 
   chain_name = global_option_get("PreCacheChain");
   pre_cache_chain = fc_chain_get_by_name(chain_name);
+  if (record_statistics && (pre_cache_chain != NULL))
+    pre_cache_stats = callback_stats_create();
 
   chain_name = global_option_get("PostCacheChain");
   post_cache_chain = fc_chain_get_by_name(chain_name);
+  if (record_statistics && (post_cache_chain != NULL))
+    post_cache_stats = callback_stats_create();
 
   write_limit_high = global_option_get_long("WriteQueueLimitHigh",
                                             /* default = */ 0);
@@ -1674,7 +3597,30 @@ EXPORT int plugin_init_all(void) {
     write_threads_num = 5;
   }
 
-  if ((list_init == NULL) && (read_heap == NULL))
+  char const *queue_impl = global_option_get("WriteQueueImplementation");
+  if ((queue_impl != NULL) && (strcasecmp("Ring", queue_impl) == 0)) {
+    /* The ring is bounded; size it so that the configured high water mark
+     * is reached before it fills up. */
+    size_t ring_size = DEFAULT_WRITE_RING_SIZE;
+    if (write_limit_high > 0)
+      ring_size = (size_t)write_limit_high;
+
+    if (write_ring == NULL)
+      write_ring = c_ring_create(ring_size, sizeof(write_queue_t));
+    if (write_ring == NULL)
+      ERROR("plugin_init_all: Creating the write queue ring failed. "
+            "Falling back to the list implementation.");
+
+    /* Without a pool, every write value is allocated individually. */
+    if ((write_ring != NULL) && (write_value_pool == NULL))
+      write_value_pool = write_value_pool_create(
+          (ring_size < WRITE_VALUE_POOL_SIZE) ? ring_size
+                                              : WRITE_VALUE_POOL_SIZE);
+  } else if ((queue_impl != NULL) && (strcasecmp("List", queue_impl) != 0)) {
+    ERROR("WriteQueueImplementation must be either \"List\" or \"Ring\".");
+  }
+
+  if ((list_init == NULL) && (read_list == NULL))
     return ret;
 
   /* Calling all init callbacks before checking if read callbacks
@@ -1708,13 +3654,14 @@ EXPORT int plugin_init_all(void) {
     le = le->next;
   }
 
+  start_spill_threads();
   start_write_threads((size_t)write_threads_num);
 
   max_read_interval =
       global_option_get_time("MaxReadInterval", DEFAULT_MAX_READ_INTERVAL);
 
   /* Start read-threads */
-  if (read_heap != NULL) {
+  if (read_list != NULL) {
     const char *rt;
     int num;
 
@@ -1738,18 +3685,21 @@ EXPORT int plugin_read_all_once(void) {
   int status;
   int return_status = 0;
 
-  if (read_heap == NULL) {
+  if (read_list == NULL) {
     NOTICE("No read-functions are registered.");
     return 0;
   }
 
-  while (42) {
+  read_group_t *rg = read_groups;
+  while (rg != NULL) {
     read_func_t *rf;
     plugin_ctx_t old_ctx;
 
-    rf = c_heap_get_root(read_heap);
-    if (rf == NULL)
-      break;
+    rf = (rg->heap != NULL) ? c_heap_get_root(rg->heap) : NULL;
+    if (rf == NULL) {
+      rg = rg->next;
+      continue;
+    }
 
     old_ctx = plugin_set_ctx(rf->rf_ctx);
 
@@ -1779,15 +3729,40 @@ EXPORT int plugin_read_all_once(void) {
   return return_status;
 } /* int plugin_read_all_once */
 
+/* Calls a single write callback. Batch writers called from a write thread
+ * get the value list appended to the thread's batch instead. */
+static int plugin_write_invoke(write_func_t *wf, /* {{{ */
+                               data_set_t const *ds, value_list_t const *vl) {
+  write_spill_t *ws = __atomic_load_n(&wf->wf_spill, __ATOMIC_ACQUIRE);
+  int status = 0;
+  if (write_spill_divert(ws, &vl, 1, &status))
+    return status;
+
+  if (!wf->wf_batch) {
+    status = plugin_write_call(wf, ds, vl);
+  } else {
+    write_batch_t *batch = write_batch_get();
+    if ((batch != NULL) && (batch->current == vl) &&
+        (write_batch_append(batch, wf, ds, vl) == 0))
+      return 0;
+
+    status = plugin_write_batch_call(wf, &ds, &vl, 1);
+  }
+
+  if ((status != 0) && (ws != NULL))
+    return write_spill_failed(ws, &vl, 1, status);
+  return status;
+} /* }}} int plugin_write_invoke */
+
 EXPORT int plugin_write(const char *plugin, /* {{{ */
                         const data_set_t *ds, const value_list_t *vl) {
-  llentry_t *le;
   int status;
 
   if (vl == NULL)
     return EINVAL;
 
-  if (list_write == NULL)
+  write_vector_t *v = __atomic_load_n(&write_vector, __ATOMIC_ACQUIRE);
+  if ((v == NULL) || (v->num == 0))
     return ENOENT;
 
   if (ds == NULL) {
@@ -1802,28 +3777,24 @@ EXPORT int plugin_write(const char *plugin, /* {{{ */
     int success = 0;
     int failure = 0;
 
-    le = llist_head(list_write);
-    while (le != NULL) {
-      callback_func_t *cf = le->value;
-      plugin_write_cb callback;
+    for (size_t i = 0; i < v->num; i++) {
+      write_func_t *wf = v->funcs[i];
 
       /* Keep the read plugin's interval and flush information but update the
        * plugin name. */
       plugin_ctx_t old_ctx = plugin_get_ctx();
       plugin_ctx_t ctx = old_ctx;
-      ctx.name = cf->cf_ctx.name;
+      ctx.name = wf->wf_ctx.name;
       plugin_set_ctx(ctx);
 
-      DEBUG("plugin: plugin_write: Writing values via %s.", le->key);
-      callback = cf->cf_callback;
-      status = (*callback)(ds, vl, &cf->cf_udata);
+      DEBUG("plugin: plugin_write: Writing values via %s.", v->names[i]);
+      status = plugin_write_invoke(wf, ds, vl);
       if (status != 0)
         failure++;
       else
         success++;
 
       plugin_set_ctx(old_ctx);
-      le = le->next;
     }
 
     if ((success == 0) && (failure != 0))
@@ -1832,33 +3803,90 @@ EXPORT int plugin_write(const char *plugin, /* {{{ */
       status = 0;
   } else /* plugin != NULL */
   {
-    callback_func_t *cf;
-    plugin_write_cb callback;
-
-    le = llist_head(list_write);
-    while (le != NULL) {
-      if (strcasecmp(plugin, le->key) == 0)
+    size_t i;
+    for (i = 0; i < v->num; i++) {
+      if (strcasecmp(plugin, v->names[i]) == 0)
         break;
-
-      le = le->next;
     }
 
-    if (le == NULL)
+    if (i >= v->num)
       return ENOENT;
 
-    cf = le->value;
-
     /* do not switch plugin context; rather keep the context (interval)
      * information of the calling read plugin */
 
-    DEBUG("plugin: plugin_write: Writing values via %s.", le->key);
-    callback = cf->cf_callback;
-    status = (*callback)(ds, vl, &cf->cf_udata);
+    DEBUG("plugin: plugin_write: Writing values via %s.", v->names[i]);
+    status = plugin_write_invoke(v->funcs[i], ds, vl);
   }
 
   return status;
 } /* }}} int plugin_write */
 
+EXPORT int plugin_write_target_id(const char *name, /* {{{ */
+                                  size_t *ret_id) {
+  if ((name == NULL) || (ret_id == NULL))
+    return EINVAL;
+
+  pthread_mutex_lock(&write_vector_lock);
+
+  for (size_t i = 0; i < write_target_names_num; i++) {
+    if (strcasecmp(name, write_target_names[i]) == 0) {
+      pthread_mutex_unlock(&write_vector_lock);
+      *ret_id = i;
+      return 0;
+    }
+  }
+
+  char **tmp = realloc(write_target_names, sizeof(*write_target_names) *
+                                               (write_target_names_num + 1));
+  if (tmp == NULL) {
+    pthread_mutex_unlock(&write_vector_lock);
+    return ENOMEM;
+  }
+  write_target_names = tmp;
+
+  write_target_names[write_target_names_num] = strdup(name);
+  if (write_target_names[write_target_names_num] == NULL) {
+    pthread_mutex_unlock(&write_vector_lock);
+    return ENOMEM;
+  }
+  write_target_names_num++;
+
+  /* Resolve the new ID right away. */
+  int status = write_vector_update();
+  if (status != 0) {
+    write_target_names_num--;
+    sfree(write_target_names[write_target_names_num]);
+    pthread_mutex_unlock(&write_vector_lock);
+    return status;
+  }
+
+  *ret_id = write_target_names_num - 1;
+  pthread_mutex_unlock(&write_vector_lock);
+  return 0;
+} /* }}} int plugin_write_target_id */
+
+EXPORT int plugin_write_by_id(size_t id, const data_set_t *ds, /* {{{ */
+                              const value_list_t *vl) {
+  if (vl == NULL)
+    return EINVAL;
+
+  write_vector_t *v = __atomic_load_n(&write_vector, __ATOMIC_ACQUIRE);
+  if ((v == NULL) || (id >= v->targets_num) || (v->targets[id] == NULL))
+    return ENOENT;
+
+  if (ds == NULL) {
+    ds = plugin_get_ds(vl->type);
+    if (ds == NULL) {
+      ERROR("plugin_write_by_id: Unable to lookup type `%s'.", vl->type);
+      return ENOENT;
+    }
+  }
+
+  /* Like plugin_write(), keep the context of the calling plugin. */
+  return plugin_write_invoke(v->targets[id], ds, vl);
+} /* }}} int plugin_write_by_id */
+
 EXPORT int plugin_flush(const char *plugin, cdtime_t timeout,
                         const char *identifier) {
   llentry_t *le;
@@ -1881,7 +3909,10 @@ EXPORT int plugin_flush(const char *plugin, cdtime_t timeout,
     old_ctx = plugin_set_ctx(cf->cf_ctx);
     callback = cf->cf_callback;
 
-    (*callback)(timeout, identifier, &cf->cf_udata);
+    cdtime_t start = cdtime();
+    int status = (*callback)(timeout, identifier, &cf->cf_udata);
+    callback_stats_record(cf->cf_stats, cdtime() - start, /* values = */ 0,
+                          status);
 
     plugin_set_ctx(old_ctx);
 
@@ -1903,10 +3934,11 @@ EXPORT int plugin_shutdown_all(void) {
   read_list = NULL;
   pthread_mutex_unlock(&read_lock);
 
-  destroy_read_heap();
+  destroy_read_groups();
 
   /* blocks until all write threads have shut down. */
   stop_write_threads();
+  stop_spill_threads();
 
   /* ask all plugins to write out the state they kept. */
   plugin_flush(/* plugin = */ NULL,
@@ -1948,10 +3980,29 @@ EXPORT int plugin_shutdown_all(void) {
   destroy_cache_event_callbacks();
   destroy_all_callbacks(&list_write);
 
+  pthread_mutex_lock(&write_vector_lock);
+  write_vector_free(write_vector);
+  write_vector = NULL;
+  destroy_all_callbacks(&list_write_retired);
+  pthread_mutex_unlock(&write_vector_lock);
+
+  while (write_spills != NULL) {
+    write_spill_t *next = write_spills->next;
+    write_spill_free(write_spills);
+    write_spills = next;
+  }
+
+  callback_stats_destroy(pre_cache_stats);
+  pre_cache_stats = NULL;
+  callback_stats_destroy(post_cache_stats);
+  post_cache_stats = NULL;
+
   destroy_all_callbacks(&list_notification);
   destroy_all_callbacks(&list_shutdown);
   destroy_all_callbacks(&list_log);
 
+  destroy_write_ring();
+
   plugin_free_loaded();
   plugin_free_data_sets();
   return ret;
@@ -2148,7 +4199,11 @@ static int plugin_dispatch_values_internal(value_list_t *vl) {
   escape_slashes(vl->type_instance, sizeof(vl->type_instance));
 
   if (pre_cache_chain != NULL) {
+    cdtime_t start = (pre_cache_stats != NULL) ? cdtime() : 0;
     status = fc_process_chain(ds, vl, pre_cache_chain);
+    if (pre_cache_stats != NULL)
+      callback_stats_record(pre_cache_stats, cdtime() - start,
+                            /* values = */ 1, (status < 0) ? status : 0);
     if (status < 0) {
       WARNING("plugin_dispatch_values: Running the "
               "pre-cache chain failed with "
@@ -2162,7 +4217,11 @@ static int plugin_dispatch_values_internal(value_list_t *vl) {
   uc_update(ds, vl);
 
   if (post_cache_chain != NULL) {
+    cdtime_t start = (post_cache_stats != NULL) ? cdtime() : 0;
     status = fc_process_chain(ds, vl, post_cache_chain);
+    if (post_cache_stats != NULL)
+      callback_stats_record(post_cache_stats, cdtime() - start,
+                            /* values = */ 1, (status < 0) ? status : 0);
     if (status < 0) {
       WARNING("plugin_dispatch_values: Running the "
               "post-cache chain failed with "
@@ -2172,6 +4231,12 @@ static int plugin_dispatch_values_internal(value_list_t *vl) {
   } else
     fc_default_action(ds, vl);
 
+  /* Value lists handled by a write thread may still be referenced by batch
+   * writers. Their meta data is freed with the value list itself. */
+  write_batch_t *batch = write_batch_get();
+  if ((batch != NULL) && (batch->current == vl))
+    free_meta_data = false;
+
   if ((free_meta_data == true) && (vl->meta != NULL)) {
     meta_data_destroy(vl->meta);
     vl->meta = NULL;
@@ -2184,11 +4249,7 @@ static double get_drop_probability(void) /* {{{ */
 {
   long pos;
   long size;
-  long wql;
-
-  pthread_mutex_lock(&write_lock);
-  wql = write_queue_length;
-  pthread_mutex_unlock(&write_lock);
+  long wql = plugin_write_queue_length();
 
   if (wql < write_limit_low)
     return 0.0;
@@ -2245,11 +4306,7 @@ EXPORT int plugin_dispatch_values(value_list_t const *vl) {
   int status;
 
   if (check_drop_value()) {
-    if (record_statistics) {
-      pthread_mutex_lock(&statistics_lock);
-      stats_values_dropped++;
-      pthread_mutex_unlock(&statistics_lock);
-    }
+    plugin_record_value_dropped();
     return 0;
   }
 
@@ -2261,9 +4318,27 @@ EXPORT int plugin_dispatch_values(value_list_t const *vl) {
     return status;
   }
 
+  plugin_record_values_dispatched(1);
   return 0;
 }
 
+EXPORT int plugin_dispatch_values_batch(value_list_t const *vls, /* {{{ */
+                                       size_t num) {
+  if ((vls == NULL) && (num > 0))
+    return EINVAL;
+
+  int status = plugin_write_enqueue_batch(vls, num);
+  if (status != 0) {
+    ERROR("plugin_dispatch_values_batch: plugin_write_enqueue_batch failed "
+          "with status %i (%s).",
+          status, STRERROR(status));
+    return status;
+  }
+
+  plugin_record_values_dispatched(num);
+  return 0;
+} /* }}} int plugin_dispatch_values_batch */
+
 __attribute__((sentinel)) int
 plugin_dispatch_multivalue(value_list_t const *template, /* {{{ */
                            bool store_percentage, int store_type, ...) {
@@ -2273,11 +4348,7 @@ plugin_dispatch_multivalue(value_list_t const *template, /* {{{ */
   va_list ap;
 
   if (check_drop_value()) {
-    if (record_statistics) {
-      pthread_mutex_lock(&statistics_lock);
-      stats_values_dropped++;
-      pthread_mutex_unlock(&statistics_lock);
-    }
+    plugin_record_value_dropped();
     return 0;
   }
 
@@ -2341,6 +4412,8 @@ plugin_dispatch_multivalue(value_list_t const *template, /* {{{ */
     status = plugin_write_enqueue(vl);
     if (status != 0)
       failed++;
+    else
+      plugin_record_values_dispatched(1);
   }
   va_end(ap);
 
@@ -2662,6 +4735,7 @@ static plugin_ctx_t *plugin_ctx_create(void) {
 EXPORT void plugin_init_ctx(void) {
   pthread_key_create(&plugin_ctx_key, plugin_ctx_destructor);
   plugin_ctx_key_initialized = true;
+  pthread_key_create(&read_stats_key, /* destructor = */ NULL);
 } /* void plugin_init_ctx */
 
 EXPORT plugin_ctx_t plugin_get_ctx(void) {
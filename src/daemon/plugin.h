@@ -195,6 +195,11 @@ typedef int (*plugin_init_cb)(void);
 typedef int (*plugin_read_cb)(user_data_t *);
 typedef int (*plugin_write_cb)(const data_set_t *, const value_list_t *,
                                user_data_t *);
+/* "write batch" callback. Receives `num' value lists and their data sets at
+ * once. Called with the writer's own plugin context. */
+typedef int (*plugin_write_batch_cb)(const data_set_t *const *ds,
+                                     const value_list_t *const *vl, size_t num,
+                                     user_data_t *);
 typedef int (*plugin_flush_cb)(cdtime_t timeout, const char *identifier,
                                user_data_t *);
 /* "missing" callback. Returns less than zero on failure, zero if other
@@ -254,6 +259,34 @@ void plugin_read_all(void);
 int plugin_read_all_once(void);
 int plugin_shutdown_all(void);
 
+/*
+ * NAME
+ *  plugin_configure_read_thread_group
+ *
+ * DESCRIPTION
+ *  Handles a <ReadThreadGroup> block of the global configuration. Read
+ *  functions of the plugins listed in the block are handled by a dedicated
+ *  set of read threads, which may be pinned to a set of CPUs.
+ *
+ * RETURN VALUE
+ *  Zero upon success, an errno value otherwise.
+ */
+int plugin_configure_read_thread_group(oconfig_item_t const *ci);
+
+/*
+ * NAME
+ *  plugin_configure_write_spill
+ *
+ * DESCRIPTION
+ *  Handles a <WriteSpill> block of the global configuration. Value lists the
+ *  named write function fails to write are stored in a queue on disk and
+ *  written again once writing succeeds.
+ *
+ * RETURN VALUE
+ *  Zero upon success, an errno value otherwise.
+ */
+int plugin_configure_write_spill(oconfig_item_t const *ci);
+
 /*
  * NAME
  *  plugin_write
@@ -284,6 +317,50 @@ int plugin_shutdown_all(void);
 int plugin_write(const char *plugin, const data_set_t *ds,
                  const value_list_t *vl);
 
+/*
+ * NAME
+ *  plugin_write_target_id
+ *
+ * DESCRIPTION
+ *  Returns an ID for the write function registered under `name', to be used
+ *  with `plugin_write_by_id'. The function does not need to be registered
+ *  yet. IDs are resolved whenever write functions are registered or
+ *  unregistered, so that writing via an ID does not involve looking up the
+ *  name. Equal names (ignoring case) get the same ID.
+ *
+ * RETURN VALUE
+ *  Zero upon success, an errno value otherwise.
+ */
+int plugin_write_target_id(const char *name, size_t *ret_id);
+
+/*
+ * NAME
+ *  plugin_write_by_id
+ *
+ * DESCRIPTION
+ *  Like `plugin_write' for a single plugin, with the plugin identified by an
+ *  ID returned by `plugin_write_target_id'.
+ *
+ * RETURN VALUE
+ *  Returns zero upon success, ENOENT if no write function is registered under
+ *  the name the ID belongs to and the status of the write function otherwise.
+ */
+int plugin_write_by_id(size_t id, const data_set_t *ds,
+                       const value_list_t *vl);
+
+/*
+ * NAME
+ *  plugin_write_batch_flush
+ *
+ * DESCRIPTION
+ *  Batch writers called from a write thread get the value lists appended to
+ *  a batch, which keeps pointers to the value lists until it is submitted.
+ *  This submits the batch if `vl' may be part of it, so that `vl' can be
+ *  changed afterwards. Called by the filter chain before targets that may
+ *  change value lists.
+ */
+void plugin_write_batch_flush(const value_list_t *vl);
+
 int plugin_flush(const char *plugin, cdtime_t timeout, const char *identifier);
 
 /*
@@ -305,6 +382,12 @@ int plugin_register_complex_read(const char *group, const char *name,
                                  user_data_t const *user_data);
 int plugin_register_write(const char *name, plugin_write_cb callback,
                           user_data_t const *user_data);
+/* Like "plugin_register_write", but value lists handled by one write thread
+ * in one go are collected and passed to "callback" together. Unregister with
+ * "plugin_unregister_write". */
+int plugin_register_write_batch(const char *name,
+                                plugin_write_batch_cb callback,
+                                user_data_t const *user_data);
 int plugin_register_flush(const char *name, plugin_flush_cb callback,
                           user_data_t const *user_data);
 int plugin_register_missing(const char *name, plugin_missing_cb callback,
@@ -362,6 +445,25 @@ void plugin_log_available_writers(void);
  */
 int plugin_dispatch_values(value_list_t const *vl);
 
+/*
+ * NAME
+ *  plugin_dispatch_values_batch
+ *
+ * DESCRIPTION
+ *  Dispatches `num' value lists at once. This is equivalent to calling
+ *  `plugin_dispatch_values' for each element of `vls', but the whole batch is
+ *  put into the write queue with a single lock acquisition and wakeup.
+ *
+ * ARGUMENTS
+ *  `vls'       Array of value lists.
+ *  `num'       Number of elements in `vls'.
+ *
+ * RETURN VALUE
+ *  Zero upon success or an error code if enqueuing failed. Value lists
+ *  dropped because of the write queue limits do not count as errors.
+ */
+int plugin_dispatch_values_batch(value_list_t const *vls, size_t num);
+
 /*
  * NAME
  *  plugin_dispatch_multivalue
@@ -69,6 +69,13 @@ int plugin_register_write(__attribute__((unused)) const char *name,
   return ENOTSUP;
 }
 
+int plugin_register_write_batch(__attribute__((unused)) const char *name,
+                                __attribute__((unused))
+                                plugin_write_batch_cb callback,
+                                __attribute__((unused)) user_data_t const *ud) {
+  return ENOTSUP;
+}
+
 int plugin_register_flush(__attribute__((unused)) const char *name,
                           __attribute__((unused)) plugin_flush_cb callback,
                           __attribute__((unused))
@@ -121,6 +128,23 @@ DECLARE_UNREGISTER(notification)
 
 int plugin_dispatch_values(value_list_t const *vl) { return ENOTSUP; }
 
+int plugin_dispatch_values_batch(__attribute__((unused))
+                                 value_list_t const *vls,
+                                 __attribute__((unused)) size_t num) {
+  return ENOTSUP;
+}
+
+int plugin_dispatch_missing(__attribute__((unused)) const value_list_t *vl) {
+  return 0;
+}
+
+void plugin_dispatch_cache_event(
+    __attribute__((unused)) enum cache_event_type_e event_type,
+    __attribute__((unused)) unsigned long callbacks_mask,
+    __attribute__((unused)) const char *name,
+    __attribute__((unused)) const value_list_t *vl) { /* nop */
+}
+
 int plugin_dispatch_notification(__attribute__((unused))
                                  const notification_t *notif) {
   return ENOTSUP;
@@ -185,12 +209,25 @@ int plugin_flush(const char *plugin, cdtime_t timeout, const char *identifier) {
 }
 
 static data_source_t magic_ds[] = {{"value", DS_TYPE_DERIVE, 0.0, NAN}};
-static data_set_t magic = {"MAGIC", 1, magic_ds};
+static data_source_t magic_gauge_ds[] = {{"value", DS_TYPE_GAUGE, NAN, NAN}};
+static data_source_t magic_multi_ds[] = {
+    {"counter", DS_TYPE_COUNTER, 0.0, NAN},
+    {"gauge", DS_TYPE_GAUGE, NAN, NAN},
+    {"derive", DS_TYPE_DERIVE, NAN, NAN},
+    {"absolute", DS_TYPE_ABSOLUTE, 0.0, NAN},
+};
+static data_set_t magic_data_sets[] = {
+    {"MAGIC", 1, magic_ds},
+    {"MAGIC_GAUGE", 1, magic_gauge_ds},
+    {"MAGIC_MULTI", 4, magic_multi_ds},
+};
 const data_set_t *plugin_get_ds(const char *name) {
-  if (strcmp(name, "MAGIC"))
-    return NULL;
+  for (size_t i = 0; i < sizeof(magic_data_sets) / sizeof(*magic_data_sets);
+       i++)
+    if (strcmp(name, magic_data_sets[i].type) == 0)
+      return &magic_data_sets[i];
 
-  return &magic;
+  return NULL;
 }
 
 void plugin_log(int level, char const *format, ...) {
@@ -244,3 +281,13 @@ int plugin_thread_create(__attribute__((unused)) pthread_t *thread,
  * would be to hard-code the top-level config keys in daemon/collectd.c to avoid
  * having these references in daemon/configfile.c. */
 int fc_configure(const oconfig_item_t *ci) { return ENOTSUP; }
+
+int plugin_configure_read_thread_group(
+    __attribute__((unused)) oconfig_item_t const *ci) {
+  return ENOTSUP;
+}
+
+int plugin_configure_write_spill(
+    __attribute__((unused)) oconfig_item_t const *ci) {
+  return ENOTSUP;
+}
@@ -29,15 +29,18 @@
 #include "collectd.h"
 
 #include "plugin.h"
-#include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
 #include "utils/metadata/meta_data.h"
 #include "utils_cache.h"
+#include "utils_series.h"
 
 #include <assert.h>
 
 typedef struct cache_entry_s {
-  char name[6 * DATA_MAX_NAME_LEN];
+  /* The identifier is stored in interned form; use series_id_format() to get
+   * the name. */
+  series_id_t id;
+  uint64_t hash;
   size_t values_num;
   gauge_t *values_gauge;
   value_t *values_raw;
@@ -70,22 +73,223 @@ typedef struct cache_entry_s {
   unsigned long callbacks_mask;
 } cache_entry_t;
 
+typedef struct {
+  char *name;
+  cache_entry_t *entry;
+} uc_iter_entry_t;
+
 struct uc_iter_s {
-  c_avl_iterator_t *iter;
+  /* Snapshot of all entries, sorted by name. */
+  uc_iter_entry_t *entries;
+  size_t entries_num;
+  size_t index;
 
   char *name;
   cache_entry_t *entry;
 };
 
-static c_avl_tree_t *cache_tree;
-static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
-
-static int cache_compare(const cache_entry_t *a, const cache_entry_t *b) {
-#if COLLECT_DEBUG
-  assert((a != NULL) && (b != NULL));
+/* The cache is split into shards, each of which is an open addressing hash
+ * table with linear probing and its own lock. Entries are located by the
+ * 64 bit hash of their name: the upper bits select the shard, the lower bits
+ * the slot within the shard. */
+#ifndef UC_SHARDS_NUM
+#define UC_SHARDS_NUM 64
 #endif
-  return strcmp(a->name, b->name);
-} /* int cache_compare */
+#define UC_SHARD_MIN_SLOTS 64
+
+typedef struct {
+  uint64_t hash;
+  cache_entry_t *entry; /* NULL if the slot is empty. */
+} cache_slot_t;
+
+typedef struct {
+  pthread_mutex_t lock;
+  cache_slot_t *slots;
+  size_t slots_num; /* zero or a power of two */
+  size_t entries_num;
+} cache_shard_t;
+
+/* Entries can be looked up by series ID, by value list or by name. Exactly
+ * one of `id', `vl' and `name' is set. */
+typedef struct {
+  uint64_t hash;
+  series_id_t const *id;
+  value_list_t const *vl;
+  char const *name;
+} cache_key_t;
+
+static cache_shard_t cache_shards[UC_SHARDS_NUM];
+static pthread_once_t cache_shards_once = PTHREAD_ONCE_INIT;
+
+static void cache_shards_init(void) {
+  for (size_t i = 0; i < UC_SHARDS_NUM; i++)
+    pthread_mutex_init(&cache_shards[i].lock, /* attr = */ NULL);
+} /* void cache_shards_init */
+
+static cache_shard_t *cache_shard(uint64_t hash) {
+  return &cache_shards[(hash >> 32) % UC_SHARDS_NUM];
+} /* cache_shard_t *cache_shard */
+
+static bool cache_entry_match(cache_entry_t const *ce, cache_key_t const *key) {
+  if (key->id != NULL)
+    return memcmp(&ce->id, key->id, sizeof(ce->id)) == 0;
+  if (key->vl != NULL)
+    return series_id_match(&ce->id, key->vl);
+
+  char name[6 * DATA_MAX_NAME_LEN];
+  if (series_id_format(name, sizeof(name), &ce->id) != 0)
+    return false;
+  return strcmp(name, key->name) == 0;
+} /* bool cache_entry_match */
+
+/* Returns the index of the slot holding `key' or, if `key' is not in the
+ * shard, the index of the empty slot where it would be inserted. The shard
+ * must be locked and have at least one slot. */
+static size_t cache_shard_find(cache_shard_t *shard, cache_key_t const *key) {
+  size_t mask = shard->slots_num - 1;
+  size_t idx = (size_t)key->hash & mask;
+
+  while (shard->slots[idx].entry != NULL) {
+    if ((shard->slots[idx].hash == key->hash) &&
+        cache_entry_match(shard->slots[idx].entry, key))
+      break;
+    idx = (idx + 1) & mask;
+  }
+
+  return idx;
+} /* size_t cache_shard_find */
+
+static cache_entry_t *cache_shard_get(cache_shard_t *shard,
+                                      cache_key_t const *key) {
+  if (shard->entries_num == 0)
+    return NULL;
+
+  return shard->slots[cache_shard_find(shard, key)].entry;
+} /* cache_entry_t *cache_shard_get */
+
+static int cache_shard_grow(cache_shard_t *shard) {
+  size_t slots_num = 2 * shard->slots_num;
+  if (slots_num < UC_SHARD_MIN_SLOTS)
+    slots_num = UC_SHARD_MIN_SLOTS;
+
+  cache_slot_t *slots = calloc(slots_num, sizeof(*slots));
+  if (slots == NULL)
+    return ENOMEM;
+
+  for (size_t i = 0; i < shard->slots_num; i++) {
+    if (shard->slots[i].entry == NULL)
+      continue;
+
+    size_t idx = (size_t)shard->slots[i].hash & (slots_num - 1);
+    while (slots[idx].entry != NULL)
+      idx = (idx + 1) & (slots_num - 1);
+    slots[idx] = shard->slots[i];
+  }
+
+  free(shard->slots);
+  shard->slots = slots;
+  shard->slots_num = slots_num;
+  return 0;
+} /* int cache_shard_grow */
+
+/* The entry must not yet be stored in the shard. */
+static int cache_shard_insert(cache_shard_t *shard, cache_entry_t *ce) {
+  /* Keep the load factor at or below 3/4. */
+  if (4 * (shard->entries_num + 1) > 3 * shard->slots_num) {
+    int status = cache_shard_grow(shard);
+    if (status != 0)
+      return status;
+  }
+
+  size_t idx = cache_shard_find(shard, &(cache_key_t){
+                                           .hash = ce->hash,
+                                           .id = &ce->id,
+                                       });
+  assert(shard->slots[idx].entry == NULL);
+
+  shard->slots[idx] = (cache_slot_t){
+      .hash = ce->hash,
+      .entry = ce,
+  };
+  shard->entries_num++;
+  return 0;
+} /* int cache_shard_insert */
+
+/* Removes and returns the entry, or returns NULL if it does not exist. */
+static cache_entry_t *cache_shard_remove(cache_shard_t *shard,
+                                         cache_key_t const *key) {
+  if (shard->entries_num == 0)
+    return NULL;
+
+  size_t mask = shard->slots_num - 1;
+  size_t hole = cache_shard_find(shard, key);
+  cache_entry_t *ce = shard->slots[hole].entry;
+  if (ce == NULL)
+    return NULL;
+
+  /* Backward shift deletion: move following entries of the same probe
+   * sequence into the hole, so lookups never stop at a stale empty slot. */
+  shard->slots[hole].entry = NULL;
+  for (size_t idx = (hole + 1) & mask; shard->slots[idx].entry != NULL;
+       idx = (idx + 1) & mask) {
+    size_t home = (size_t)shard->slots[idx].hash & mask;
+
+    /* Leave the entry alone if its home slot lies cyclically in
+     * (hole, idx]. */
+    if ((hole <= idx) ? ((hole < home) && (home <= idx))
+                      : ((hole < home) || (home <= idx)))
+      continue;
+
+    shard->slots[hole] = shard->slots[idx];
+    shard->slots[idx].entry = NULL;
+    hole = idx;
+  }
+
+  shard->entries_num--;
+  return ce;
+} /* cache_entry_t *cache_shard_remove */
+
+/* Looks up `key' and returns the entry, or NULL if it does not exist. In
+ * either case the shard responsible for `key' is locked and returned in
+ * `ret_shard'; the caller must unlock it. */
+static cache_entry_t *cache_lookup_key(cache_key_t const *key,
+                                       cache_shard_t **ret_shard) {
+  cache_shard_t *shard = cache_shard(key->hash);
+
+  pthread_mutex_lock(&shard->lock);
+  *ret_shard = shard;
+  return cache_shard_get(shard, key);
+} /* cache_entry_t *cache_lookup_key */
+
+static cache_entry_t *cache_lookup(const char *name,
+                                   cache_shard_t **ret_shard) {
+  return cache_lookup_key(
+      &(cache_key_t){
+          .hash = series_name_hash(name),
+          .name = name,
+      },
+      ret_shard);
+} /* cache_entry_t *cache_lookup */
+
+static cache_entry_t *cache_lookup_vl(const value_list_t *vl,
+                                      cache_shard_t **ret_shard) {
+  return cache_lookup_key(
+      &(cache_key_t){
+          .hash = series_vl_hash(vl),
+          .vl = vl,
+      },
+      ret_shard);
+} /* cache_entry_t *cache_lookup_vl */
+
+static void cache_lock_all(void) {
+  for (size_t i = 0; i < UC_SHARDS_NUM; i++)
+    pthread_mutex_lock(&cache_shards[i].lock);
+} /* void cache_lock_all */
+
+static void cache_unlock_all(void) {
+  for (size_t i = UC_SHARDS_NUM; i > 0; i--)
+    pthread_mutex_unlock(&cache_shards[i - 1].lock);
+} /* void cache_unlock_all */
 
 static cache_entry_t *cache_alloc(size_t values_num) {
   cache_entry_t *ce;
@@ -118,6 +322,7 @@ static void cache_free(cache_entry_t *ce) {
   if (ce == NULL)
     return;
 
+  series_id_release(&ce->id);
   sfree(ce->values_gauge);
   sfree(ce->values_raw);
   sfree(ce->history);
@@ -139,24 +344,22 @@ static void uc_check_range(const data_set_t *ds, cache_entry_t *ce) {
   }
 } /* void uc_check_range */
 
-static int uc_insert(const data_set_t *ds, const value_list_t *vl,
-                     const char *key) {
-  /* `cache_lock' has been locked by `uc_update' */
-
-  char *key_copy = strdup(key);
-  if (key_copy == NULL) {
-    ERROR("uc_insert: strdup failed.");
-    return -1;
-  }
+static int uc_insert(cache_shard_t *shard, const data_set_t *ds,
+                     const value_list_t *vl, uint64_t hash) {
+  /* `shard->lock' has been locked by `uc_update' */
 
   cache_entry_t *ce = cache_alloc(ds->ds_num);
   if (ce == NULL) {
-    sfree(key_copy);
     ERROR("uc_insert: cache_alloc (%" PRIsz ") failed.", ds->ds_num);
     return -1;
   }
 
-  sstrncpy(ce->name, key, sizeof(ce->name));
+  if (series_id_create(vl, &ce->id) != 0) {
+    ERROR("uc_insert: series_id_create failed.");
+    cache_free(ce);
+    return -1;
+  }
+  ce->hash = hash;
 
   for (size_t i = 0; i < ds->ds_num; i++) {
     switch (ds->ds[i].type) {
@@ -187,7 +390,6 @@ static int uc_insert(const data_set_t *ds, const value_list_t *vl,
       /* This shouldn't happen. */
       ERROR("uc_insert: Don't know how to handle data source type %i.",
             ds->ds[i].type);
-      sfree(key_copy);
       cache_free(ce);
       return -1;
     } /* switch (ds->ds[i].type) */
@@ -205,67 +407,66 @@ static int uc_insert(const data_set_t *ds, const value_list_t *vl,
     ce->meta = meta_data_clone(vl->meta);
   }
 
-  if (c_avl_insert(cache_tree, key_copy, ce) != 0) {
-    sfree(key_copy);
-    ERROR("uc_insert: c_avl_insert failed.");
+  if (cache_shard_insert(shard, ce) != 0) {
+    cache_free(ce);
+    ERROR("uc_insert: cache_shard_insert failed.");
     return -1;
   }
 
-  DEBUG("uc_insert: Added %s to the cache.", key);
+  DEBUG("uc_insert: Added %s/%s/%s to the cache.", vl->host, vl->plugin,
+        vl->type);
   return 0;
 } /* int uc_insert */
 
 int uc_init(void) {
-  if (cache_tree == NULL)
-    cache_tree =
-        c_avl_create((int (*)(const void *, const void *))cache_compare);
+  pthread_once(&cache_shards_once, cache_shards_init);
 
   return 0;
 } /* int uc_init */
 
 int uc_check_timeout(void) {
   struct {
-    char *key;
+    series_id_t id;
+    uint64_t hash;
     cdtime_t time;
     cdtime_t interval;
     unsigned long callbacks_mask;
   } *expired = NULL;
   size_t expired_num = 0;
 
-  pthread_mutex_lock(&cache_lock);
   cdtime_t now = cdtime();
 
-  /* Build a list of entries to be flushed */
-  c_avl_iterator_t *iter = c_avl_get_iterator(cache_tree);
-  char *key = NULL;
-  cache_entry_t *ce = NULL;
-  while (c_avl_iterator_next(iter, (void *)&key, (void *)&ce) == 0) {
-    /* If the entry is fresh enough, continue. */
-    if ((now - ce->last_update) < (ce->interval * timeout_g))
-      continue;
-
-    void *tmp = realloc(expired, (expired_num + 1) * sizeof(*expired));
-    if (tmp == NULL) {
-      ERROR("uc_check_timeout: realloc failed.");
-      continue;
-    }
-    expired = tmp;
-
-    expired[expired_num].key = strdup(key);
-    expired[expired_num].time = ce->last_time;
-    expired[expired_num].interval = ce->interval;
-    expired[expired_num].callbacks_mask = ce->callbacks_mask;
+  /* Build a list of entries to be flushed. Shards are scanned one at a time
+   * so that updates of other shards can proceed meanwhile. */
+  for (size_t i = 0; i < UC_SHARDS_NUM; i++) {
+    cache_shard_t *shard = cache_shards + i;
 
-    if (expired[expired_num].key == NULL) {
-      ERROR("uc_check_timeout: strdup failed.");
-      continue;
-    }
+    pthread_mutex_lock(&shard->lock);
+    for (size_t j = 0; j < shard->slots_num; j++) {
+      cache_entry_t *ce = shard->slots[j].entry;
 
-    expired_num++;
-  } /* while (c_avl_iterator_next) */
+      /* If the entry is fresh enough, continue. */
+      if ((ce == NULL) || ((now - ce->last_update) < (ce->interval * timeout_g)))
+        continue;
 
-  c_avl_iterator_destroy(iter);
-  pthread_mutex_unlock(&cache_lock);
+      void *tmp = realloc(expired, (expired_num + 1) * sizeof(*expired));
+      if (tmp == NULL) {
+        ERROR("uc_check_timeout: realloc failed.");
+        continue;
+      }
+      expired = tmp;
+
+      /* The entry may be freed once the lock is released. */
+      series_id_ref(&ce->id);
+      expired[expired_num].id = ce->id;
+      expired[expired_num].hash = ce->hash;
+      expired[expired_num].time = ce->last_time;
+      expired[expired_num].interval = ce->interval;
+      expired[expired_num].callbacks_mask = ce->callbacks_mask;
+      expired_num++;
+    } /* for (j) */
+    pthread_mutex_unlock(&shard->lock);
+  } /* for (i) */
 
   if (expired_num == 0) {
     sfree(expired);
@@ -282,63 +483,63 @@ int uc_check_timeout(void) {
         .time = expired[i].time,
         .interval = expired[i].interval,
     };
-
-    if (parse_identifier_vl(expired[i].key, &vl) != 0) {
-      ERROR("uc_check_timeout: parse_identifier_vl (\"%s\") failed.",
-            expired[i].key);
-      continue;
-    }
+    series_id_to_vl(&expired[i].id, &vl);
 
     plugin_dispatch_missing(&vl);
 
-    if (expired[i].callbacks_mask)
-      plugin_dispatch_cache_event(CE_VALUE_EXPIRED, expired[i].callbacks_mask,
-                                  expired[i].key, &vl);
+    if (expired[i].callbacks_mask) {
+      char name[6 * DATA_MAX_NAME_LEN];
+      if (series_id_format(name, sizeof(name), &expired[i].id) == 0)
+        plugin_dispatch_cache_event(CE_VALUE_EXPIRED,
+                                    expired[i].callbacks_mask, name, &vl);
+    }
   } /* for (i = 0; i < expired_num; i++) */
 
   /* Now actually remove all the values from the cache. We don't re-evaluate
    * the timestamp again, so in theory it is possible we remove a value after
    * it is updated here. */
-  pthread_mutex_lock(&cache_lock);
   for (size_t i = 0; i < expired_num; i++) {
-    char *key = NULL;
-    cache_entry_t *value = NULL;
+    cache_shard_t *shard = cache_shard(expired[i].hash);
+
+    pthread_mutex_lock(&shard->lock);
+    cache_entry_t *value = cache_shard_remove(shard, &(cache_key_t){
+                                                         .hash =
+                                                             expired[i].hash,
+                                                         .id = &expired[i].id,
+                                                     });
+    pthread_mutex_unlock(&shard->lock);
 
-    if (c_avl_remove(cache_tree, expired[i].key, (void *)&key,
-                     (void *)&value) != 0) {
-      ERROR("uc_check_timeout: c_avl_remove (\"%s\") failed.", expired[i].key);
-      sfree(expired[i].key);
+    series_id_release(&expired[i].id);
+
+    if (value == NULL) {
+      ERROR("uc_check_timeout: cache_shard_remove failed.");
       continue;
     }
-    sfree(key);
     cache_free(value);
-
-    sfree(expired[i].key);
   } /* for (i = 0; i < expired_num; i++) */
-  pthread_mutex_unlock(&cache_lock);
 
   sfree(expired);
   return 0;
 } /* int uc_check_timeout */
 
 int uc_update(const data_set_t *ds, const value_list_t *vl) {
+  /* The name is only formatted if it is actually needed. */
   char name[6 * DATA_MAX_NAME_LEN];
 
-  if (FORMAT_VL(name, sizeof(name), vl) != 0) {
-    ERROR("uc_update: FORMAT_VL failed.");
-    return -1;
-  }
-
-  pthread_mutex_lock(&cache_lock);
+  uint64_t hash = series_vl_hash(vl);
+  cache_shard_t *shard = cache_shard(hash);
+  pthread_mutex_lock(&shard->lock);
 
-  cache_entry_t *ce = NULL;
-  int status = c_avl_get(cache_tree, name, (void *)&ce);
-  if (status != 0) /* entry does not yet exist */
+  cache_entry_t *ce = cache_shard_get(shard, &(cache_key_t){
+                                                 .hash = hash,
+                                                 .vl = vl,
+                                             });
+  if (ce == NULL) /* entry does not yet exist */
   {
-    status = uc_insert(ds, vl, name);
-    pthread_mutex_unlock(&cache_lock);
+    int status = uc_insert(shard, ds, vl, hash);
+    pthread_mutex_unlock(&shard->lock);
 
-    if (status == 0)
+    if ((status == 0) && (FORMAT_VL(name, sizeof(name), vl) == 0))
       plugin_dispatch_cache_event(CE_VALUE_NEW, 0 /* mask */, name, vl);
 
     return status;
@@ -348,7 +549,8 @@ int uc_update(const data_set_t *ds, const value_list_t *vl) {
   assert(ce->values_num == ds->ds_num);
 
   if (ce->last_time >= vl->time) {
-    pthread_mutex_unlock(&cache_lock);
+    pthread_mutex_unlock(&shard->lock);
+    FORMAT_VL(name, sizeof(name), vl);
     NOTICE("uc_update: Value too old: name = %s; value time = %.3f; "
            "last cache update = %.3f;",
            name, CDTIME_T_TO_DOUBLE(vl->time),
@@ -387,13 +589,14 @@ int uc_update(const data_set_t *ds, const value_list_t *vl) {
 
     default:
       /* This shouldn't happen. */
-      pthread_mutex_unlock(&cache_lock);
+      pthread_mutex_unlock(&shard->lock);
       ERROR("uc_update: Don't know how to handle data source type %i.",
             ds->ds[i].type);
       return -1;
     } /* switch (ds->ds[i].type) */
 
-    DEBUG("uc_update: %s: ds[%" PRIsz "] = %lf", name, i, ce->values_gauge[i]);
+    DEBUG("uc_update: %s/%s/%s: ds[%" PRIsz "] = %lf", vl->host, vl->plugin,
+          vl->type, i, ce->values_gauge[i]);
   } /* for (i) */
 
   /* Update the history if it exists. */
@@ -418,84 +621,102 @@ int uc_update(const data_set_t *ds, const value_list_t *vl) {
   /* Check if cache entry has registered callbacks */
   unsigned long callbacks_mask = ce->callbacks_mask;
 
-  pthread_mutex_unlock(&cache_lock);
+  pthread_mutex_unlock(&shard->lock);
 
-  if (callbacks_mask)
+  if (callbacks_mask && (FORMAT_VL(name, sizeof(name), vl) == 0))
     plugin_dispatch_cache_event(CE_VALUE_UPDATE, callbacks_mask, name, vl);
 
   return 0;
 } /* int uc_update */
 
 int uc_set_callbacks_mask(const char *name, unsigned long mask) {
-  pthread_mutex_lock(&cache_lock);
-  cache_entry_t *ce = NULL;
-  int status = c_avl_get(cache_tree, name, (void *)&ce);
-  if (status != 0) { /* Ouch, just created entry disappeared ?! */
+  cache_shard_t *shard;
+  cache_entry_t *ce = cache_lookup(name, &shard);
+  if (ce == NULL) { /* Ouch, just created entry disappeared ?! */
     ERROR("uc_set_callbacks_mask: Couldn't find %s entry!", name);
-    pthread_mutex_unlock(&cache_lock);
+    pthread_mutex_unlock(&shard->lock);
     return -1;
   }
   DEBUG("uc_set_callbacks_mask: set mask for \"%s\" to %lu.", name, mask);
   ce->callbacks_mask = mask;
-  pthread_mutex_unlock(&cache_lock);
+  pthread_mutex_unlock(&shard->lock);
   return 0;
 }
 
-int uc_get_rate_by_name(const char *name, gauge_t **ret_values,
+/* Copies the rates of `ce' to a newly allocated array. The shard holding
+ * `ce' must be locked. */
+static int uc_copy_rate(cache_entry_t const *ce, gauge_t **ret_values,
                         size_t *ret_values_num) {
-  gauge_t *ret = NULL;
-  size_t ret_num = 0;
-  cache_entry_t *ce = NULL;
-  int status = 0;
+  /* remove missing values from getval */
+  if (ce->state == STATE_MISSING)
+    return -1;
+
+  gauge_t *ret = malloc(ce->values_num * sizeof(*ret));
+  if (ret == NULL) {
+    ERROR("utils_cache: uc_get_rate: malloc failed.");
+    return -1;
+  }
+  memcpy(ret, ce->values_gauge, ce->values_num * sizeof(*ret));
+
+  *ret_values = ret;
+  *ret_values_num = ce->values_num;
+  return 0;
+} /* int uc_copy_rate */
+
+/* Copies the raw values of `ce' to a newly allocated array. The shard
+ * holding `ce' must be locked. */
+static int uc_copy_value(cache_entry_t const *ce, value_t **ret_values,
+                         size_t *ret_values_num) {
+  /* remove missing values from getval */
+  if (ce->state == STATE_MISSING)
+    return -1;
+
+  value_t *ret = malloc(ce->values_num * sizeof(*ret));
+  if (ret == NULL) {
+    ERROR("utils_cache: uc_get_value: malloc failed.");
+    return -1;
+  }
+  memcpy(ret, ce->values_raw, ce->values_num * sizeof(*ret));
 
-  pthread_mutex_lock(&cache_lock);
+  *ret_values = ret;
+  *ret_values_num = ce->values_num;
+  return 0;
+} /* int uc_copy_value */
 
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+int uc_get_rate_by_name(const char *name, gauge_t **ret_values,
+                        size_t *ret_values_num) {
+  cache_shard_t *shard;
+  int status = -1;
 
-    /* remove missing values from getval */
-    if (ce->state == STATE_MISSING) {
+  cache_entry_t *ce = cache_lookup(name, &shard);
+  if (ce != NULL) {
+    status = uc_copy_rate(ce, ret_values, ret_values_num);
+    if (ce->state == STATE_MISSING)
       DEBUG("utils_cache: uc_get_rate_by_name: requested metric \"%s\" is in "
             "state \"missing\".",
             name);
-      status = -1;
-    } else {
-      ret_num = ce->values_num;
-      ret = malloc(ret_num * sizeof(*ret));
-      if (ret == NULL) {
-        ERROR("utils_cache: uc_get_rate_by_name: malloc failed.");
-        status = -1;
-      } else {
-        memcpy(ret, ce->values_gauge, ret_num * sizeof(gauge_t));
-      }
-    }
   } else {
     DEBUG("utils_cache: uc_get_rate_by_name: No such value: %s", name);
-    status = -1;
   }
 
-  pthread_mutex_unlock(&cache_lock);
-
-  if (status == 0) {
-    *ret_values = ret;
-    *ret_values_num = ret_num;
-  }
+  pthread_mutex_unlock(&shard->lock);
 
   return status;
 } /* gauge_t *uc_get_rate_by_name */
 
 gauge_t *uc_get_rate(const data_set_t *ds, const value_list_t *vl) {
-  char name[6 * DATA_MAX_NAME_LEN];
   gauge_t *ret = NULL;
   size_t ret_num = 0;
-  int status;
+  cache_shard_t *shard;
+  int status = -1;
 
-  if (FORMAT_VL(name, sizeof(name), vl) != 0) {
-    ERROR("utils_cache: uc_get_rate: FORMAT_VL failed.");
-    return NULL;
-  }
+  /* Look the entry up by value list, like uc_update does, rather than
+   * formatting its name first. */
+  cache_entry_t *ce = cache_lookup_vl(vl, &shard);
+  if (ce != NULL)
+    status = uc_copy_rate(ce, &ret, &ret_num);
+  pthread_mutex_unlock(&shard->lock);
 
-  status = uc_get_rate_by_name(name, &ret, &ret_num);
   if (status != 0)
     return NULL;
 
@@ -503,7 +724,7 @@ gauge_t *uc_get_rate(const data_set_t *ds, const value_list_t *vl) {
    * values are returned. */
   if (ret_num != ds->ds_num) {
     ERROR("utils_cache: uc_get_rate: ds[%s] has %" PRIsz " values, "
-          "but uc_get_rate_by_name returned %" PRIsz ".",
+          "but the cache entry has %" PRIsz ".",
           ds->type, ds->ds_num, ret_num);
     sfree(ret);
     return NULL;
@@ -514,56 +735,31 @@ gauge_t *uc_get_rate(const data_set_t *ds, const value_list_t *vl) {
 
 int uc_get_value_by_name(const char *name, value_t **ret_values,
                          size_t *ret_values_num) {
-  value_t *ret = NULL;
-  size_t ret_num = 0;
-  cache_entry_t *ce = NULL;
-  int status = 0;
-
-  pthread_mutex_lock(&cache_lock);
+  cache_shard_t *shard;
+  int status = -1;
 
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
-
-    /* remove missing values from getval */
-    if (ce->state == STATE_MISSING) {
-      status = -1;
-    } else {
-      ret_num = ce->values_num;
-      ret = malloc(ret_num * sizeof(*ret));
-      if (ret == NULL) {
-        ERROR("utils_cache: uc_get_value_by_name: malloc failed.");
-        status = -1;
-      } else {
-        memcpy(ret, ce->values_raw, ret_num * sizeof(value_t));
-      }
-    }
-  } else {
+  cache_entry_t *ce = cache_lookup(name, &shard);
+  if (ce != NULL)
+    status = uc_copy_value(ce, ret_values, ret_values_num);
+  else
     DEBUG("utils_cache: uc_get_value_by_name: No such value: %s", name);
-    status = -1;
-  }
 
-  pthread_mutex_unlock(&cache_lock);
-
-  if (status == 0) {
-    *ret_values = ret;
-    *ret_values_num = ret_num;
-  }
+  pthread_mutex_unlock(&shard->lock);
 
   return (status);
 } /* int uc_get_value_by_name */
 
 value_t *uc_get_value(const data_set_t *ds, const value_list_t *vl) {
-  char name[6 * DATA_MAX_NAME_LEN];
   value_t *ret = NULL;
   size_t ret_num = 0;
-  int status;
+  cache_shard_t *shard;
+  int status = -1;
 
-  if (FORMAT_VL(name, sizeof(name), vl) != 0) {
-    ERROR("utils_cache: uc_get_value: FORMAT_VL failed.");
-    return (NULL);
-  }
+  cache_entry_t *ce = cache_lookup_vl(vl, &shard);
+  if (ce != NULL)
+    status = uc_copy_value(ce, &ret, &ret_num);
+  pthread_mutex_unlock(&shard->lock);
 
-  status = uc_get_value_by_name(name, &ret, &ret_num);
   if (status != 0)
     return (NULL);
 
@@ -571,7 +767,7 @@ value_t *uc_get_value(const data_set_t *ds, const value_list_t *vl) {
    * values are returned. */
   if (ret_num != (size_t)ds->ds_num) {
     ERROR("utils_cache: uc_get_value: ds[%s] has %" PRIsz " values, "
-          "but uc_get_value_by_name returned %" PRIsz ".",
+          "but the cache entry has %" PRIsz ".",
           ds->type, ds->ds_num, ret_num);
     sfree(ret);
     return (NULL);
@@ -583,18 +779,26 @@ value_t *uc_get_value(const data_set_t *ds, const value_list_t *vl) {
 size_t uc_get_size(void) {
   size_t size_arrays = 0;
 
-  pthread_mutex_lock(&cache_lock);
-  size_arrays = (size_t)c_avl_size(cache_tree);
-  pthread_mutex_unlock(&cache_lock);
+  for (size_t i = 0; i < UC_SHARDS_NUM; i++) {
+    pthread_mutex_lock(&cache_shards[i].lock);
+    size_arrays += cache_shards[i].entries_num;
+    pthread_mutex_unlock(&cache_shards[i].lock);
+  }
 
   return size_arrays;
 }
 
-int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number) {
-  c_avl_iterator_t *iter;
-  char *key;
-  cache_entry_t *value;
+typedef struct {
+  char *name;
+  cdtime_t time;
+} uc_name_t;
 
+static int uc_name_compare(const void *a, const void *b) {
+  return strcmp(((uc_name_t const *)a)->name, ((uc_name_t const *)b)->name);
+} /* int uc_name_compare */
+
+int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number) {
+  uc_name_t *entries = NULL;
   char **names = NULL;
   cdtime_t *times = NULL;
   size_t number = 0;
@@ -605,61 +809,81 @@ int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number) {
   if ((ret_names == NULL) || (ret_number == NULL))
     return -1;
 
-  pthread_mutex_lock(&cache_lock);
+  cache_lock_all();
 
-  size_arrays = (size_t)c_avl_size(cache_tree);
+  for (size_t i = 0; i < UC_SHARDS_NUM; i++)
+    size_arrays += cache_shards[i].entries_num;
   if (size_arrays < 1) {
     /* Handle the "no values" case here, to avoid the error message when
      * calloc() returns NULL. */
-    pthread_mutex_unlock(&cache_lock);
+    cache_unlock_all();
     return 0;
   }
 
-  names = calloc(size_arrays, sizeof(*names));
-  times = calloc(size_arrays, sizeof(*times));
-  if ((names == NULL) || (times == NULL)) {
+  entries = calloc(size_arrays, sizeof(*entries));
+  if (entries == NULL) {
     ERROR("uc_get_names: calloc failed.");
-    sfree(names);
-    sfree(times);
-    pthread_mutex_unlock(&cache_lock);
+    cache_unlock_all();
     return ENOMEM;
   }
 
-  iter = c_avl_get_iterator(cache_tree);
-  while (c_avl_iterator_next(iter, (void *)&key, (void *)&value) == 0) {
-    /* remove missing values when list values */
-    if (value->state == STATE_MISSING)
-      continue;
+  for (size_t i = 0; (i < UC_SHARDS_NUM) && (status == 0); i++) {
+    cache_shard_t *shard = cache_shards + i;
 
-    /* c_avl_size does not return a number smaller than the number of elements
-     * returned by c_avl_iterator_next. */
-    assert(number < size_arrays);
+    for (size_t j = 0; j < shard->slots_num; j++) {
+      cache_entry_t *value = shard->slots[j].entry;
 
-    if (ret_times != NULL)
-      times[number] = value->last_time;
+      /* remove missing values when list values */
+      if ((value == NULL) || (value->state == STATE_MISSING))
+        continue;
 
-    names[number] = strdup(key);
-    if (names[number] == NULL) {
-      status = -1;
-      break;
-    }
+      assert(number < size_arrays);
+
+      char name[6 * DATA_MAX_NAME_LEN];
+      if (series_id_format(name, sizeof(name), &value->id) != 0)
+        continue;
+
+      entries[number].time = value->last_time;
+      entries[number].name = strdup(name);
+      if (entries[number].name == NULL) {
+        status = -1;
+        break;
+      }
+
+      number++;
+    } /* for (j) */
+  }   /* for (i) */
 
-    number++;
-  } /* while (c_avl_iterator_next) */
+  cache_unlock_all();
 
-  c_avl_iterator_destroy(iter);
-  pthread_mutex_unlock(&cache_lock);
+  if (status == 0) {
+    names = calloc(size_arrays, sizeof(*names));
+    times = calloc(size_arrays, sizeof(*times));
+    if ((names == NULL) || (times == NULL)) {
+      ERROR("uc_get_names: calloc failed.");
+      status = ENOMEM;
+    }
+  }
 
   if (status != 0) {
     for (size_t i = 0; i < number; i++) {
-      sfree(names[i]);
+      sfree(entries[i].name);
     }
+    sfree(entries);
     sfree(names);
     sfree(times);
 
-    return -1;
+    return status;
   }
 
+  /* The hash table has no order; sort by name like callers expect. */
+  qsort(entries, number, sizeof(*entries), uc_name_compare);
+  for (size_t i = 0; i < number; i++) {
+    names[i] = entries[i].name;
+    times[i] = entries[i].time;
+  }
+  sfree(entries);
+
   *ret_names = names;
   if (ret_times != NULL)
     *ret_times = times;
@@ -671,67 +895,42 @@ int uc_get_names(char ***ret_names, cdtime_t **ret_times, size_t *ret_number) {
 } /* int uc_get_names */
 
 int uc_get_state(const data_set_t *ds, const value_list_t *vl) {
-  char name[6 * DATA_MAX_NAME_LEN];
-  cache_entry_t *ce = NULL;
+  cache_shard_t *shard;
+  cache_entry_t *ce;
   int ret = STATE_ERROR;
 
-  if (FORMAT_VL(name, sizeof(name), vl) != 0) {
-    ERROR("uc_get_state: FORMAT_VL failed.");
-    return STATE_ERROR;
-  }
-
-  pthread_mutex_lock(&cache_lock);
-
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  ce = cache_lookup_vl(vl, &shard);
+  if (ce != NULL) {
     ret = ce->state;
   }
 
-  pthread_mutex_unlock(&cache_lock);
+  pthread_mutex_unlock(&shard->lock);
 
   return ret;
 } /* int uc_get_state */
 
 int uc_set_state(const data_set_t *ds, const value_list_t *vl, int state) {
-  char name[6 * DATA_MAX_NAME_LEN];
-  cache_entry_t *ce = NULL;
+  cache_shard_t *shard;
+  cache_entry_t *ce;
   int ret = -1;
 
-  if (FORMAT_VL(name, sizeof(name), vl) != 0) {
-    ERROR("uc_set_state: FORMAT_VL failed.");
-    return STATE_ERROR;
-  }
-
-  pthread_mutex_lock(&cache_lock);
-
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  ce = cache_lookup_vl(vl, &shard);
+  if (ce != NULL) {
     ret = ce->state;
     ce->state = state;
   }
 
-  pthread_mutex_unlock(&cache_lock);
+  pthread_mutex_unlock(&shard->lock);
 
   return ret;
 } /* int uc_set_state */
 
-int uc_get_history_by_name(const char *name, gauge_t *ret_history,
+/* Copies the last `num_steps' rates of `ce' to `ret_history'. The shard
+ * holding `ce' must be locked. */
+static int uc_copy_history(cache_entry_t *ce, gauge_t *ret_history,
                            size_t num_steps, size_t num_ds) {
-  cache_entry_t *ce = NULL;
-  int status = 0;
-
-  pthread_mutex_lock(&cache_lock);
-
-  status = c_avl_get(cache_tree, name, (void *)&ce);
-  if (status != 0) {
-    pthread_mutex_unlock(&cache_lock);
-    return -ENOENT;
-  }
-
-  if (((size_t)ce->values_num) != num_ds) {
-    pthread_mutex_unlock(&cache_lock);
+  if (((size_t)ce->values_num) != num_ds)
     return -EINVAL;
-  }
 
   /* Check if there are enough values available. If not, increase the buffer
    * size. */
@@ -740,10 +939,8 @@ int uc_get_history_by_name(const char *name, gauge_t *ret_history,
 
     tmp =
         realloc(ce->history, sizeof(*ce->history) * num_steps * ce->values_num);
-    if (tmp == NULL) {
-      pthread_mutex_unlock(&cache_lock);
+    if (tmp == NULL)
       return -ENOMEM;
-    }
 
     for (size_t i = ce->history_length * ce->values_num;
          i < (num_steps * ce->values_num); i++)
@@ -770,87 +967,78 @@ int uc_get_history_by_name(const char *name, gauge_t *ret_history,
            sizeof(*ret_history) * num_ds);
   }
 
-  pthread_mutex_unlock(&cache_lock);
-
   return 0;
+} /* int uc_copy_history */
+
+int uc_get_history_by_name(const char *name, gauge_t *ret_history,
+                           size_t num_steps, size_t num_ds) {
+  cache_shard_t *shard;
+  int status = -ENOENT;
+
+  cache_entry_t *ce = cache_lookup(name, &shard);
+  if (ce != NULL)
+    status = uc_copy_history(ce, ret_history, num_steps, num_ds);
+  pthread_mutex_unlock(&shard->lock);
+
+  return status;
 } /* int uc_get_history_by_name */
 
 int uc_get_history(const data_set_t *ds, const value_list_t *vl,
                    gauge_t *ret_history, size_t num_steps, size_t num_ds) {
-  char name[6 * DATA_MAX_NAME_LEN];
+  cache_shard_t *shard;
+  int status = -ENOENT;
 
-  if (FORMAT_VL(name, sizeof(name), vl) != 0) {
-    ERROR("utils_cache: uc_get_history: FORMAT_VL failed.");
-    return -1;
-  }
+  cache_entry_t *ce = cache_lookup_vl(vl, &shard);
+  if (ce != NULL)
+    status = uc_copy_history(ce, ret_history, num_steps, num_ds);
+  pthread_mutex_unlock(&shard->lock);
 
-  return uc_get_history_by_name(name, ret_history, num_steps, num_ds);
+  return status;
 } /* int uc_get_history */
 
 int uc_get_hits(const data_set_t *ds, const value_list_t *vl) {
-  char name[6 * DATA_MAX_NAME_LEN];
-  cache_entry_t *ce = NULL;
+  cache_shard_t *shard;
+  cache_entry_t *ce;
   int ret = STATE_ERROR;
 
-  if (FORMAT_VL(name, sizeof(name), vl) != 0) {
-    ERROR("uc_get_hits: FORMAT_VL failed.");
-    return STATE_ERROR;
-  }
-
-  pthread_mutex_lock(&cache_lock);
-
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  ce = cache_lookup_vl(vl, &shard);
+  if (ce != NULL) {
     ret = ce->hits;
   }
 
-  pthread_mutex_unlock(&cache_lock);
+  pthread_mutex_unlock(&shard->lock);
 
   return ret;
 } /* int uc_get_hits */
 
 int uc_set_hits(const data_set_t *ds, const value_list_t *vl, int hits) {
-  char name[6 * DATA_MAX_NAME_LEN];
-  cache_entry_t *ce = NULL;
+  cache_shard_t *shard;
+  cache_entry_t *ce;
   int ret = -1;
 
-  if (FORMAT_VL(name, sizeof(name), vl) != 0) {
-    ERROR("uc_set_hits: FORMAT_VL failed.");
-    return STATE_ERROR;
-  }
-
-  pthread_mutex_lock(&cache_lock);
-
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  ce = cache_lookup_vl(vl, &shard);
+  if (ce != NULL) {
     ret = ce->hits;
     ce->hits = hits;
   }
 
-  pthread_mutex_unlock(&cache_lock);
+  pthread_mutex_unlock(&shard->lock);
 
   return ret;
 } /* int uc_set_hits */
 
 int uc_inc_hits(const data_set_t *ds, const value_list_t *vl, int step) {
-  char name[6 * DATA_MAX_NAME_LEN];
-  cache_entry_t *ce = NULL;
+  cache_shard_t *shard;
+  cache_entry_t *ce;
   int ret = -1;
 
-  if (FORMAT_VL(name, sizeof(name), vl) != 0) {
-    ERROR("uc_inc_hits: FORMAT_VL failed.");
-    return STATE_ERROR;
-  }
-
-  pthread_mutex_lock(&cache_lock);
-
-  if (c_avl_get(cache_tree, name, (void *)&ce) == 0) {
-    assert(ce != NULL);
+  ce = cache_lookup_vl(vl, &shard);
+  if (ce != NULL) {
     ret = ce->hits;
     ce->hits = ret + step;
   }
 
-  pthread_mutex_unlock(&cache_lock);
+  pthread_mutex_unlock(&shard->lock);
 
   return ret;
 } /* int uc_inc_hits */
@@ -858,54 +1046,93 @@ int uc_inc_hits(const data_set_t *ds, const value_list_t *vl, int step) {
 /*
  * Iterator interface
  */
+static int uc_iter_entry_compare(const void *a, const void *b) {
+  return strcmp(((uc_iter_entry_t const *)a)->name,
+                ((uc_iter_entry_t const *)b)->name);
+} /* int uc_iter_entry_compare */
+
 uc_iter_t *uc_get_iterator(void) {
   uc_iter_t *iter = calloc(1, sizeof(*iter));
   if (iter == NULL)
     return NULL;
 
-  pthread_mutex_lock(&cache_lock);
+  cache_lock_all();
 
-  iter->iter = c_avl_get_iterator(cache_tree);
-  if (iter->iter == NULL) {
-    free(iter);
-    return NULL;
+  size_t entries_num = 0;
+  for (size_t i = 0; i < UC_SHARDS_NUM; i++)
+    entries_num += cache_shards[i].entries_num;
+
+  if (entries_num > 0) {
+    iter->entries = calloc(entries_num, sizeof(*iter->entries));
+    if (iter->entries == NULL) {
+      cache_unlock_all();
+      free(iter);
+      return NULL;
+    }
   }
 
+  for (size_t i = 0; i < UC_SHARDS_NUM; i++) {
+    cache_shard_t *shard = cache_shards + i;
+    for (size_t j = 0; j < shard->slots_num; j++) {
+      cache_entry_t *ce = shard->slots[j].entry;
+      char name[6 * DATA_MAX_NAME_LEN];
+
+      if ((ce == NULL) || (series_id_format(name, sizeof(name), &ce->id) != 0))
+        continue;
+
+      uc_iter_entry_t *e = iter->entries + iter->entries_num;
+      e->name = strdup(name);
+      if (e->name == NULL) {
+        ERROR("uc_get_iterator: strdup failed.");
+        uc_iterator_destroy(iter);
+        return NULL;
+      }
+      e->entry = ce;
+      iter->entries_num++;
+    }
+  }
+  assert(iter->entries_num <= entries_num);
+
+  /* Iterate in name order, like the tree-based cache used to. */
+  if (iter->entries_num > 1)
+    qsort(iter->entries, iter->entries_num, sizeof(*iter->entries),
+          uc_iter_entry_compare);
+
   return iter;
 } /* uc_iter_t *uc_get_iterator */
 
 int uc_iterator_next(uc_iter_t *iter, char **ret_name) {
-  int status;
-
   if (iter == NULL)
     return -1;
 
-  while ((status = c_avl_iterator_next(iter->iter, (void *)&iter->name,
-                                       (void *)&iter->entry)) == 0) {
+  while (iter->index < iter->entries_num) {
+    iter->entry = iter->entries[iter->index].entry;
+    iter->name = iter->entries[iter->index].name;
+    iter->index++;
+
     if (iter->entry->state == STATE_MISSING)
       continue;
 
-    break;
-  }
-  if (status != 0) {
-    iter->name = NULL;
-    iter->entry = NULL;
-    return -1;
-  }
+    if (ret_name != NULL)
+      *ret_name = iter->name;
 
-  if (ret_name != NULL)
-    *ret_name = iter->name;
+    return 0;
+  }
 
-  return 0;
+  iter->name = NULL;
+  iter->entry = NULL;
+  return -1;
 } /* int uc_iterator_next */
 
 void uc_iterator_destroy(uc_iter_t *iter) {
   if (iter == NULL)
     return;
 
-  c_avl_iterator_destroy(iter->iter);
-  pthread_mutex_unlock(&cache_lock);
+  cache_unlock_all();
 
+  for (size_t i = 0; i < iter->entries_num; i++)
+    free(iter->entries[i].name);
+  free(iter->entries);
   free(iter);
 } /* void uc_iterator_destroy */
 
@@ -954,33 +1181,25 @@ int uc_iterator_get_meta(uc_iter_t *iter, meta_data_t **ret_meta) {
 /*
  * Meta data interface
  */
-/* XXX: This function will acquire `cache_lock' but will not free it! */
-static meta_data_t *uc_get_meta(const value_list_t *vl) /* {{{ */
-{
-  char name[6 * DATA_MAX_NAME_LEN];
-  cache_entry_t *ce = NULL;
-  int status;
-
-  status = FORMAT_VL(name, sizeof(name), vl);
-  if (status != 0) {
-    ERROR("utils_cache: uc_get_meta: FORMAT_VL failed.");
-    return NULL;
-  }
-
-  pthread_mutex_lock(&cache_lock);
+/* XXX: This function will acquire the lock of the shard returned in
+ * `ret_shard' but will not free it! */
+static meta_data_t *uc_get_meta(const value_list_t *vl, /* {{{ */
+                                cache_shard_t **ret_shard) {
+  cache_shard_t *shard;
 
-  status = c_avl_get(cache_tree, name, (void *)&ce);
-  if (status != 0) {
-    pthread_mutex_unlock(&cache_lock);
+  cache_entry_t *ce = cache_lookup_vl(vl, &shard);
+  if (ce == NULL) {
+    pthread_mutex_unlock(&shard->lock);
     return NULL;
   }
-  assert(ce != NULL);
 
   if (ce->meta == NULL)
     ce->meta = meta_data_create();
 
   if (ce->meta == NULL)
-    pthread_mutex_unlock(&cache_lock);
+    pthread_mutex_unlock(&shard->lock);
+  else
+    *ret_shard = shard;
 
   return ce->meta;
 } /* }}} meta_data_t *uc_get_meta */
@@ -990,12 +1209,13 @@ static meta_data_t *uc_get_meta(const value_list_t *vl) /* {{{ */
 #define UC_WRAP(wrap_function)                                                 \
   {                                                                            \
     meta_data_t *meta;                                                         \
+    cache_shard_t *shard;                                                      \
     int status;                                                                \
-    meta = uc_get_meta(vl);                                                    \
+    meta = uc_get_meta(vl, &shard);                                            \
     if (meta == NULL)                                                          \
       return -1;                                                               \
     status = wrap_function(meta, key);                                         \
-    pthread_mutex_unlock(&cache_lock);                                         \
+    pthread_mutex_unlock(&shard->lock);                                        \
     return status;                                                             \
   }
 int uc_meta_data_exists(const value_list_t *vl, const char *key)
@@ -1016,12 +1236,13 @@ int uc_meta_data_exists(const value_list_t *vl, const char *key)
 #define UC_WRAP(wrap_function)                                                 \
   {                                                                            \
     meta_data_t *meta;                                                         \
+    cache_shard_t *shard;                                                      \
     int status;                                                                \
-    meta = uc_get_meta(vl);                                                    \
+    meta = uc_get_meta(vl, &shard);                                            \
     if (meta == NULL)                                                          \
       return -1;                                                               \
     status = wrap_function(meta, key, value);                                  \
-    pthread_mutex_unlock(&cache_lock);                                         \
+    pthread_mutex_unlock(&shard->lock);                                        \
     return status;                                                             \
   }
         int uc_meta_data_add_string(const value_list_t *vl, const char *key,
@@ -0,0 +1,178 @@
+/**
+ * collectd - src/daemon/utils_cache_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/common/common.h"
+#include "utils_cache.h"
+
+/* Enough entries to force every shard to grow a few times. */
+#define ENTRIES_NUM 10000
+
+int timeout_g = 2;
+
+static data_source_t dsrc_gauge = {"value", DS_TYPE_GAUGE, NAN, NAN};
+static data_set_t ds_gauge = {"gauge", 1, &dsrc_gauge};
+
+static void make_vl(value_list_t *vl, value_t *v, int i) {
+  *vl = (value_list_t){
+      .values = v,
+      .values_len = 1,
+      .time = cdtime(),
+      /* Every odd entry expires on the first call to uc_check_timeout. */
+      .interval = (i % 2) ? 0 : TIME_T_TO_CDTIME_T(10),
+  };
+  v->gauge = (gauge_t)i;
+  sstrncpy(vl->host, "example.com", sizeof(vl->host));
+  sstrncpy(vl->plugin, "test", sizeof(vl->plugin));
+  snprintf(vl->plugin_instance, sizeof(vl->plugin_instance), "%d", i);
+  sstrncpy(vl->type, "gauge", sizeof(vl->type));
+}
+
+static gauge_t lookup(int i) {
+  char name[6 * DATA_MAX_NAME_LEN];
+  gauge_t *values = NULL;
+  size_t values_num = 0;
+
+  snprintf(name, sizeof(name), "example.com/test-%d/gauge", i);
+  if (uc_get_rate_by_name(name, &values, &values_num) != 0)
+    return NAN;
+
+  gauge_t ret = values[0];
+  free(values);
+  return ret;
+}
+
+DEF_TEST(insert_and_lookup) {
+  int failed = 0;
+  for (int i = 0; i < ENTRIES_NUM; i++) {
+    value_list_t vl;
+    value_t v;
+    make_vl(&vl, &v, i);
+    if (uc_update(&ds_gauge, &vl) != 0)
+      failed++;
+  }
+  EXPECT_EQ_INT(0, failed);
+  EXPECT_EQ_UINT64(ENTRIES_NUM, uc_get_size());
+
+  for (int i = 0; i < ENTRIES_NUM; i += 97)
+    EXPECT_EQ_DOUBLE((gauge_t)i, lookup(i));
+  EXPECT_EQ_DOUBLE(NAN, lookup(ENTRIES_NUM));
+
+  return 0;
+}
+
+DEF_TEST(lookup_by_value_list) {
+  for (int i = 0; i < ENTRIES_NUM; i += 97) {
+    value_list_t vl;
+    value_t v;
+    make_vl(&vl, &v, i);
+
+    gauge_t *rate = uc_get_rate(&ds_gauge, &vl);
+    CHECK_NOT_NULL(rate);
+    EXPECT_EQ_DOUBLE((gauge_t)i, rate[0]);
+    free(rate);
+
+    value_t *value = uc_get_value(&ds_gauge, &vl);
+    CHECK_NOT_NULL(value);
+    EXPECT_EQ_DOUBLE((gauge_t)i, value[0].gauge);
+    free(value);
+  }
+
+  value_list_t vl;
+  value_t v;
+  make_vl(&vl, &v, ENTRIES_NUM);
+  EXPECT_EQ_PTR(NULL, uc_get_rate(&ds_gauge, &vl));
+  EXPECT_EQ_PTR(NULL, uc_get_value(&ds_gauge, &vl));
+
+  return 0;
+}
+
+DEF_TEST(names_are_sorted) {
+  char **names = NULL;
+  cdtime_t *times = NULL;
+  size_t names_num = 0;
+
+  CHECK_ZERO(uc_get_names(&names, &times, &names_num));
+  EXPECT_EQ_UINT64(uc_get_size(), names_num);
+  size_t unsorted = 0;
+  for (size_t i = 1; i < names_num; i++)
+    if (strcmp(names[i - 1], names[i]) >= 0)
+      unsorted++;
+  EXPECT_EQ_UINT64(0, unsorted);
+
+  for (size_t i = 0; i < names_num; i++)
+    free(names[i]);
+  free(names);
+  free(times);
+
+  uc_iter_t *iter = uc_get_iterator();
+  CHECK_NOT_NULL(iter);
+  char *prev = NULL;
+  char *name = NULL;
+  size_t iter_num = 0;
+  while (uc_iterator_next(iter, &name) == 0) {
+    if ((prev != NULL) && (strcmp(prev, name) >= 0))
+      unsorted++;
+    prev = name;
+    iter_num++;
+  }
+  uc_iterator_destroy(iter);
+  EXPECT_EQ_UINT64(names_num, iter_num);
+  EXPECT_EQ_UINT64(0, unsorted);
+
+  return 0;
+}
+
+DEF_TEST(timeout) {
+  CHECK_ZERO(uc_check_timeout());
+  EXPECT_EQ_UINT64(ENTRIES_NUM / 2, uc_get_size());
+
+  /* Removing entries shifts others within their shard; all remaining entries
+   * must still be found. */
+  int missing = 0;
+  int stale = 0;
+  for (int i = 0; i < ENTRIES_NUM; i++) {
+    gauge_t v = lookup(i);
+    if ((i % 2) && !isnan(v))
+      stale++;
+    else if (!(i % 2) && (v != (gauge_t)i))
+      missing++;
+  }
+  EXPECT_EQ_INT(0, missing);
+  EXPECT_EQ_INT(0, stale);
+
+  return 0;
+}
+
+int main(void) {
+  CHECK_ZERO(uc_init());
+
+  RUN_TEST(insert_and_lookup);
+  RUN_TEST(lookup_by_value_list);
+  RUN_TEST(names_are_sorted);
+  RUN_TEST(timeout);
+
+  END_TEST;
+}
@@ -0,0 +1,127 @@
+/**
+ * collectd - src/daemon/utils_series.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/common/common.h"
+#include "utils/intern/intern.h"
+#include "utils_series.h"
+
+int series_id_create(value_list_t const *vl, series_id_t *ret_id) {
+  /* Fields not interned yet stay zero, which is safe to release. */
+  series_id_t id = {0};
+  int status;
+
+  if ((status = c_intern(vl->host, &id.host)) != 0 ||
+      (status = c_intern(vl->plugin, &id.plugin)) != 0 ||
+      (status = c_intern(vl->plugin_instance, &id.plugin_instance)) != 0 ||
+      (status = c_intern(vl->type, &id.type)) != 0 ||
+      (status = c_intern(vl->type_instance, &id.type_instance)) != 0) {
+    series_id_release(&id);
+    return status;
+  }
+
+  *ret_id = id;
+  return 0;
+} /* int series_id_create */
+
+void series_id_ref(series_id_t const *id) {
+  c_intern_ref(id->host);
+  c_intern_ref(id->plugin);
+  c_intern_ref(id->plugin_instance);
+  c_intern_ref(id->type);
+  c_intern_ref(id->type_instance);
+} /* void series_id_ref */
+
+void series_id_release(series_id_t const *id) {
+  c_intern_release(id->host);
+  c_intern_release(id->plugin);
+  c_intern_release(id->plugin_instance);
+  c_intern_release(id->type);
+  c_intern_release(id->type_instance);
+} /* void series_id_release */
+
+void series_id_to_vl(series_id_t const *id, value_list_t *vl) {
+  sstrncpy(vl->host, c_intern_string(id->host), sizeof(vl->host));
+  sstrncpy(vl->plugin, c_intern_string(id->plugin), sizeof(vl->plugin));
+  sstrncpy(vl->plugin_instance, c_intern_string(id->plugin_instance),
+           sizeof(vl->plugin_instance));
+  sstrncpy(vl->type, c_intern_string(id->type), sizeof(vl->type));
+  sstrncpy(vl->type_instance, c_intern_string(id->type_instance),
+           sizeof(vl->type_instance));
+} /* void series_id_to_vl */
+
+bool series_id_match(series_id_t const *id, value_list_t const *vl) {
+  /* Compare the fields most likely to differ first. */
+  return (strcmp(c_intern_string(id->type_instance), vl->type_instance) ==
+          0) &&
+         (strcmp(c_intern_string(id->plugin_instance), vl->plugin_instance) ==
+          0) &&
+         (strcmp(c_intern_string(id->type), vl->type) == 0) &&
+         (strcmp(c_intern_string(id->plugin), vl->plugin) == 0) &&
+         (strcmp(c_intern_string(id->host), vl->host) == 0);
+} /* bool series_id_match */
+
+int series_id_format(char *buffer, size_t buffer_size, series_id_t const *id) {
+  return format_name(buffer, (int)buffer_size, c_intern_string(id->host),
+                     c_intern_string(id->plugin),
+                     c_intern_string(id->plugin_instance),
+                     c_intern_string(id->type),
+                     c_intern_string(id->type_instance));
+} /* int series_id_format */
+
+/* 64 bit FNV-1a */
+#define SERIES_HASH_INIT 14695981039346656037ULL
+
+static uint64_t series_hash_append(uint64_t hash, char const *str) {
+  for (unsigned char const *c = (unsigned char const *)str; *c != 0; c++) {
+    hash ^= (uint64_t)*c;
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+} /* uint64_t series_hash_append */
+
+uint64_t series_name_hash(char const *name) {
+  return series_hash_append(SERIES_HASH_INIT, name);
+} /* uint64_t series_name_hash */
+
+uint64_t series_vl_hash(value_list_t const *vl) {
+  uint64_t hash = SERIES_HASH_INIT;
+
+  /* Must match the format used by format_name(). */
+  hash = series_hash_append(hash, vl->host);
+  hash = series_hash_append(hash, "/");
+  hash = series_hash_append(hash, vl->plugin);
+  if (vl->plugin_instance[0] != 0) {
+    hash = series_hash_append(hash, "-");
+    hash = series_hash_append(hash, vl->plugin_instance);
+  }
+  hash = series_hash_append(hash, "/");
+  hash = series_hash_append(hash, vl->type);
+  if (vl->type_instance[0] != 0) {
+    hash = series_hash_append(hash, "-");
+    hash = series_hash_append(hash, vl->type_instance);
+  }
+
+  return hash;
+} /* uint64_t series_vl_hash */
@@ -0,0 +1,123 @@
+/**
+ * collectd - src/daemon/utils_series.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_SERIES_H
+#define UTILS_SERIES_H 1
+
+#include "plugin.h"
+
+/*
+ * Compact form of the identifier of a value list: each of the five name
+ * fields is replaced by its ID in the interned string table (see
+ * "utils/intern/intern.h"). Two series IDs are equal if and only if all
+ * fields of the value lists they were created from are equal, so they can be
+ * compared with memcmp(3). A series ID holds a reference to each of its
+ * strings, which must be released with series_id_release().
+ */
+struct series_id_s {
+  uint32_t host;
+  uint32_t plugin;
+  uint32_t plugin_instance;
+  uint32_t type;
+  uint32_t type_instance;
+};
+typedef struct series_id_s series_id_t;
+
+/*
+ * NAME
+ *   series_id_create
+ *
+ * DESCRIPTION
+ *   Interns the identifier of `vl' and stores it in `ret_id'.
+ *
+ * RETURN VALUE
+ *   Zero upon success, an errno value otherwise.
+ */
+int series_id_create(value_list_t const *vl, series_id_t *ret_id);
+
+/*
+ * NAME
+ *   series_id_ref
+ *
+ * DESCRIPTION
+ *   Acquires another reference to the strings of `id', which the caller must
+ *   already hold, e.g. before storing a copy of `id'.
+ */
+void series_id_ref(series_id_t const *id);
+
+/*
+ * NAME
+ *   series_id_release
+ *
+ * DESCRIPTION
+ *   Releases the references acquired by series_id_create() or
+ *   series_id_ref(). `id' must not be used afterwards.
+ */
+void series_id_release(series_id_t const *id);
+
+/*
+ * NAME
+ *   series_id_to_vl
+ *
+ * DESCRIPTION
+ *   Copies the name fields identified by `id' to `vl'. Other fields of `vl'
+ *   are not touched.
+ */
+void series_id_to_vl(series_id_t const *id, value_list_t *vl);
+
+/*
+ * NAME
+ *   series_id_match
+ *
+ * DESCRIPTION
+ *   Returns true if the name fields of `vl' are equal to the ones identified
+ *   by `id'. Unlike series_id_create(), this does not need to look up the
+ *   fields of `vl' in the string table.
+ */
+bool series_id_match(series_id_t const *id, value_list_t const *vl);
+
+/*
+ * NAME
+ *   series_id_format
+ *
+ * DESCRIPTION
+ *   Formats the identifier like FORMAT_VL() does.
+ *
+ * RETURN VALUE
+ *   Zero upon success, ENOBUFS if `buffer' is too small.
+ */
+int series_id_format(char *buffer, size_t buffer_size, series_id_t const *id);
+
+/*
+ * NAME
+ *   series_name_hash, series_vl_hash
+ *
+ * DESCRIPTION
+ *   Return a 64 bit hash of an identifier. series_vl_hash(vl) returns the
+ *   same hash as series_name_hash() for the FORMAT_VL() string of `vl',
+ *   without actually formatting it.
+ */
+uint64_t series_name_hash(char const *name);
+uint64_t series_vl_hash(value_list_t const *vl);
+
+#endif /* UTILS_SERIES_H */
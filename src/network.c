@@ -24,6 +24,7 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE /* For struct ip_mreq */
+#define _GNU_SOURCE /* For recvmmsg(2) and sendmmsg(2) */
 
 #include "collectd.h"
 
@@ -100,6 +101,23 @@ GCRY_THREAD_OPTION_PTHREAD_IMPL;
 #define SECURITY_LEVEL_SIGN 1
 #define SECURITY_LEVEL_ENCRYPT 2
 #endif
+
+/* A packet waiting to be sent. One packet is shared by the send queues of all
+ * servers and freed when the last reference is dropped. */
+struct send_packet_s {
+  size_t refcount;
+  size_t size;
+  char data[];
+};
+typedef struct send_packet_s send_packet_t;
+
+#ifndef NETWORK_SEND_BATCH_SIZE
+#define NETWORK_SEND_BATCH_SIZE 32
+#endif
+#ifndef NETWORK_SEND_QUEUE_SIZE
+#define NETWORK_SEND_QUEUE_SIZE 1024
+#endif
+
 struct sockent_client {
   int fd;
   struct sockaddr_storage *addr;
@@ -114,16 +132,29 @@ struct sockent_client {
   cdtime_t next_resolve_reconnect;
   cdtime_t resolve_interval;
   struct sockaddr_storage *bind_addr;
+  /* Ring buffer of packets waiting for the send thread, protected by the
+   * sockent's lock. Only used if `SendThreads' is enabled. */
+  send_packet_t **queue;
+  size_t queue_head;
+  size_t queue_len;
+  pthread_cond_t queue_cond;
+  /* Room for NETWORK_SEND_BATCH_SIZE signed or encrypted packets. */
+  char *seal_buffer;
+  pthread_t send_thread_id;
+  bool send_thread_running;
+  bool send_thread_stop;
 };
 
 struct sockent_server {
   int *fd;
+  /* Index of the receive thread handling `fd[i]'. Only used if
+   * `ReceiveThreads' is set. */
+  size_t *fd_thread;
   size_t fd_num;
 #if HAVE_GCRYPT_H
   int security_level;
   char *auth_file;
   fbhash_t *userdb;
-  gcry_cipher_hd_t cypher;
 #endif
 };
 
@@ -261,6 +292,51 @@ struct receive_list_entry_s {
 };
 typedef struct receive_list_entry_s receive_list_entry_t;
 
+/* A thread receiving and parsing packets from its own set of sockets. Used
+ * instead of the receive and dispatch thread if `ReceiveThreads' is set. */
+struct receive_thread_s {
+  pthread_t id;
+  bool running;
+  struct pollfd *pollfd;
+  sockent_t **sockent;
+  size_t fd_num;
+};
+typedef struct receive_thread_s receive_thread_t;
+
+#ifndef NETWORK_RECEIVE_BATCH_SIZE
+#define NETWORK_RECEIVE_BATCH_SIZE 32
+#endif
+
+/* Identifier of the value lists and notifications being parsed. The strings
+ * point into the packet and are only copied when a value list is added to
+ * the parse batch. */
+struct parse_ident_s {
+  char const *host;
+  char const *plugin;
+  char const *plugin_instance;
+  char const *type;
+  char const *type_instance;
+};
+typedef struct parse_ident_s parse_ident_t;
+
+/* Value lists parsed from one packet. They are dispatched together when the
+ * packet has been parsed or the batch is full. */
+#ifndef NETWORK_PARSE_BATCH_SIZE
+#define NETWORK_PARSE_BATCH_SIZE 32
+#endif
+#ifndef NETWORK_PARSE_VALUES_SIZE
+#define NETWORK_PARSE_VALUES_SIZE 256
+#endif
+struct parse_batch_s {
+  value_list_t vl[NETWORK_PARSE_BATCH_SIZE];
+  size_t vl_num;
+  value_t values[NETWORK_PARSE_VALUES_SIZE];
+  size_t values_num;
+  const char *username;
+  struct sockaddr_storage *address;
+};
+typedef struct parse_batch_s parse_batch_t;
+
 /*
  * Private variables
  */
@@ -269,6 +345,8 @@ static int network_config_ttl;
 static size_t network_config_packet_size = 1452;
 static bool network_config_forward;
 static bool network_config_stats;
+static size_t network_config_receive_threads;
+static bool network_config_send_threads;
 
 static sockent_t *sending_sockets;
 
@@ -289,6 +367,8 @@ static int receive_thread_running;
 static pthread_t receive_thread_id;
 static int dispatch_thread_running;
 static pthread_t dispatch_thread_id;
+static receive_thread_t *receive_threads;
+static size_t receive_threads_num;
 
 /* Buffer in which to-be-sent network packets are constructed. */
 static char *send_buffer;
@@ -302,8 +382,10 @@ static pthread_mutex_t send_buffer_lock = PTHREAD_MUTEX_INITIALIZER;
  * the values are incremented is either only reachable by one thread (the
  * dispatch thread, for example) or locked by some lock (send_buffer_lock for
  * example). Only if neither is true, the stats_lock is acquired. The counters
- * are always read without holding a lock in the hope that writing 8 bytes to
- * memory is an atomic operation. */
+ * of the receive path are updated atomically, because with `ReceiveThreads'
+ * several threads parse packets concurrently. The counters are always read
+ * without holding a lock in the hope that writing 8 bytes to memory is an
+ * atomic operation. */
 static derive_t stats_octets_rx;
 static derive_t stats_octets_tx;
 static derive_t stats_packets_rx;
@@ -393,51 +475,29 @@ static bool check_send_notify_okay(const notification_t *n) /* {{{ */
   return !received;
 } /* }}} bool check_send_notify_okay */
 
-static int network_dispatch_values(value_list_t *vl, /* {{{ */
-                                   const char *username,
-                                   struct sockaddr_storage *address) {
-  int status;
-
-  if ((vl->time == 0) || (strlen(vl->host) == 0) || (strlen(vl->plugin) == 0) ||
-      (strlen(vl->type) == 0))
-    return -EINVAL;
-
-  if (!check_receive_okay(vl)) {
-#if COLLECT_DEBUG
-    char name[6 * DATA_MAX_NAME_LEN];
-    FORMAT_VL(name, sizeof(name), vl);
-    name[sizeof(name) - 1] = '\0';
-    DEBUG("network plugin: network_dispatch_values: "
-          "NOT dispatching %s.",
-          name);
-#endif
-    stats_values_not_dispatched++;
-    return 0;
-  }
-
-  assert(vl->meta == NULL);
-
-  vl->meta = meta_data_create();
-  if (vl->meta == NULL) {
+/* Creates the meta data attached to all value lists received in one packet.
+ * Returns NULL on failure. */
+static meta_data_t *network_receive_meta(const char *username, /* {{{ */
+                                         struct sockaddr_storage *address) {
+  meta_data_t *meta = meta_data_create();
+  if (meta == NULL) {
     ERROR("network plugin: meta_data_create failed.");
-    return -ENOMEM;
+    return NULL;
   }
 
-  status = meta_data_add_boolean(vl->meta, "network:received", 1);
+  int status = meta_data_add_boolean(meta, "network:received", 1);
   if (status != 0) {
     ERROR("network plugin: meta_data_add_boolean failed.");
-    meta_data_destroy(vl->meta);
-    vl->meta = NULL;
-    return status;
+    meta_data_destroy(meta);
+    return NULL;
   }
 
   if (username != NULL) {
-    status = meta_data_add_string(vl->meta, "network:username", username);
+    status = meta_data_add_string(meta, "network:username", username);
     if (status != 0) {
       ERROR("network plugin: meta_data_add_string failed.");
-      meta_data_destroy(vl->meta);
-      vl->meta = NULL;
-      return status;
+      meta_data_destroy(meta);
+      return NULL;
     }
   }
 
@@ -448,28 +508,20 @@ static int network_dispatch_values(value_list_t *vl, /* {{{ */
                          NULL, 0, NI_NUMERICHOST | NI_NUMERICSERV);
     if (status != 0) {
       ERROR("network plugin: getnameinfo failed: %s", gai_strerror(status));
-      meta_data_destroy(vl->meta);
-      vl->meta = NULL;
-      return status;
+      meta_data_destroy(meta);
+      return NULL;
     }
 
-    status = meta_data_add_string(vl->meta, "network:ip_address", host);
+    status = meta_data_add_string(meta, "network:ip_address", host);
     if (status != 0) {
       ERROR("network plugin: meta_data_add_string failed.");
-      meta_data_destroy(vl->meta);
-      vl->meta = NULL;
-      return status;
+      meta_data_destroy(meta);
+      return NULL;
     }
   }
 
-  plugin_dispatch_values(vl);
-  stats_values_dispatched++;
-
-  meta_data_destroy(vl->meta);
-  vl->meta = NULL;
-
-  return 0;
-} /* }}} int network_dispatch_values */
+  return meta;
+} /* }}} meta_data_t *network_receive_meta */
 
 static int network_dispatch_notification(notification_t *n) /* {{{ */
 {
@@ -533,6 +585,59 @@ static int network_init_gcrypt(void) /* {{{ */
   return 0;
 } /* }}} int network_init_gcrypt */
 
+/* Servers decrypt with a cypher handle owned by the receiving thread, so that
+ * threads receiving on the same socket do not have to serialize. The handle
+ * remembers the key it was set up with, so that consecutive packets of the
+ * same user only need a new IV. */
+typedef struct {
+  gcry_cipher_hd_t cypher;
+  unsigned char password_hash[32];
+} network_cypher_t;
+
+static pthread_key_t network_cypher_key;
+static pthread_once_t network_cypher_once = PTHREAD_ONCE_INIT;
+
+static void network_cypher_free(void *arg) /* {{{ */
+{
+  network_cypher_t *nc = arg;
+
+  if (nc == NULL)
+    return;
+
+  if (nc->cypher != NULL)
+    gcry_cipher_close(nc->cypher);
+  sfree(nc);
+} /* }}} void network_cypher_free */
+
+static void network_cypher_key_create(void) /* {{{ */
+{
+  pthread_key_create(&network_cypher_key, network_cypher_free);
+} /* }}} void network_cypher_key_create */
+
+static network_cypher_t *network_cypher_get(void) /* {{{ */
+{
+  pthread_once(&network_cypher_once, network_cypher_key_create);
+
+  network_cypher_t *nc = pthread_getspecific(network_cypher_key);
+  if (nc != NULL)
+    return nc;
+
+  nc = calloc(1, sizeof(*nc));
+  if (nc == NULL)
+    return NULL;
+
+  if (pthread_setspecific(network_cypher_key, nc) != 0) {
+    sfree(nc);
+    return NULL;
+  }
+
+  return nc;
+} /* }}} network_cypher_t *network_cypher_get */
+
+/* Returns a cypher handle keyed with the password of the client or of
+ * `username' and initialized with `iv'. Clients use the handle of the sockent,
+ * which must be locked by the caller; servers use the handle of the calling
+ * thread. */
 static gcry_cipher_hd_t network_get_aes256_cypher(sockent_t *se, /* {{{ */
                                                   const void *iv,
                                                   size_t iv_size,
@@ -540,6 +645,8 @@ static gcry_cipher_hd_t network_get_aes256_cypher(sockent_t *se, /* {{{ */
   gcry_error_t err;
   gcry_cipher_hd_t *cyper_ptr;
   unsigned char password_hash[32];
+  unsigned char *key_ptr = NULL;
+  bool need_key = true;
 
   if (se->type == SOCKENT_TYPE_CLIENT) {
     cyper_ptr = &se->data.client.cypher;
@@ -547,11 +654,15 @@ static gcry_cipher_hd_t network_get_aes256_cypher(sockent_t *se, /* {{{ */
   } else {
     char *secret;
 
-    cyper_ptr = &se->data.server.cypher;
-
     if (username == NULL)
       return NULL;
 
+    network_cypher_t *nc = network_cypher_get();
+    if (nc == NULL)
+      return NULL;
+    cyper_ptr = &nc->cypher;
+    key_ptr = nc->password_hash;
+
     secret = fbh_get(se->data.server.userdb, username);
     if (secret == NULL)
       return NULL;
@@ -572,16 +683,25 @@ static gcry_cipher_hd_t network_get_aes256_cypher(sockent_t *se, /* {{{ */
     }
   } else {
     gcry_cipher_reset(*cyper_ptr);
+    /* Resetting keeps the key, so it only needs to be set again if the
+     * packet is from a different user. */
+    if ((key_ptr != NULL) &&
+        (memcmp(key_ptr, password_hash, sizeof(password_hash)) == 0))
+      need_key = false;
   }
   assert(*cyper_ptr != NULL);
 
-  err = gcry_cipher_setkey(*cyper_ptr, password_hash, sizeof(password_hash));
-  if (err != 0) {
-    ERROR("network plugin: gcry_cipher_setkey returned: %s",
-          gcry_strerror(err));
-    gcry_cipher_close(*cyper_ptr);
-    *cyper_ptr = NULL;
-    return NULL;
+  if (need_key) {
+    err = gcry_cipher_setkey(*cyper_ptr, password_hash, sizeof(password_hash));
+    if (err != 0) {
+      ERROR("network plugin: gcry_cipher_setkey returned: %s",
+            gcry_strerror(err));
+      gcry_cipher_close(*cyper_ptr);
+      *cyper_ptr = NULL;
+      return NULL;
+    }
+    if (key_ptr != NULL)
+      memcpy(key_ptr, password_hash, sizeof(password_hash));
   }
 
   err = gcry_cipher_setiv(*cyper_ptr, iv, iv_size);
@@ -761,42 +881,29 @@ static int write_part_string(char **ret_buffer, size_t *ret_buffer_len,
   return 0;
 } /* int write_part_string */
 
-static int parse_part_values(void **ret_buffer, size_t *ret_buffer_len,
-                             value_t **ret_values, size_t *ret_num_values) {
-  char *buffer = *ret_buffer;
-  size_t buffer_len = *ret_buffer_len;
-
+/* Returns the number of values in the values part at `buffer', or zero if
+ * the part is invalid. */
+static size_t parse_part_values_num(void const *buffer, /* {{{ */
+                                    size_t buffer_len) {
   uint16_t tmp16;
   size_t exp_size;
 
   uint16_t pkg_length;
-  uint16_t pkg_type;
   size_t pkg_numval;
 
-  uint8_t *pkg_types;
-  value_t *pkg_values;
-
   if (buffer_len < 15) {
     NOTICE("network plugin: packet is too short: "
            "buffer_len = %" PRIsz,
            buffer_len);
-    return -1;
+    return 0;
   }
 
-  memcpy((void *)&tmp16, buffer, sizeof(tmp16));
-  buffer += sizeof(tmp16);
-  pkg_type = ntohs(tmp16);
-
-  memcpy((void *)&tmp16, buffer, sizeof(tmp16));
-  buffer += sizeof(tmp16);
+  memcpy((void *)&tmp16, (char const *)buffer + 2, sizeof(tmp16));
   pkg_length = ntohs(tmp16);
 
-  memcpy((void *)&tmp16, buffer, sizeof(tmp16));
-  buffer += sizeof(tmp16);
+  memcpy((void *)&tmp16, (char const *)buffer + 4, sizeof(tmp16));
   pkg_numval = (size_t)ntohs(tmp16);
 
-  assert(pkg_type == TYPE_VALUES);
-
   exp_size =
       3 * sizeof(uint16_t) + pkg_numval * (sizeof(uint8_t) + sizeof(value_t));
   if (buffer_len < exp_size) {
@@ -805,7 +912,7 @@ static int parse_part_values(void **ret_buffer, size_t *ret_buffer_len,
             "Chunk of size %" PRIsz " expected, "
             "but buffer has only %" PRIsz " bytes left.",
             exp_size, buffer_len);
-    return -1;
+    return 0;
   }
   assert(pkg_numval <= ((buffer_len - 6) / 9));
 
@@ -813,57 +920,61 @@ static int parse_part_values(void **ret_buffer, size_t *ret_buffer_len,
     WARNING("network plugin: parse_part_values: "
             "Length and number of values "
             "in the packet don't match.");
-    return -1;
+    return 0;
   }
 
-  pkg_types = calloc(pkg_numval, sizeof(*pkg_types));
-  pkg_values = calloc(pkg_numval, sizeof(*pkg_values));
-  if ((pkg_types == NULL) || (pkg_values == NULL)) {
-    sfree(pkg_types);
-    sfree(pkg_values);
-    ERROR("network plugin: parse_part_values: calloc failed.");
+  return pkg_numval;
+} /* }}} size_t parse_part_values_num */
+
+/* Decodes the values part at `*ret_buffer' directly into `values', which must
+ * have room for parse_part_values_num() values. */
+static int parse_part_values(void **ret_buffer, size_t *ret_buffer_len,
+                             value_t *values, size_t *ret_num_values) {
+  char *buffer = *ret_buffer;
+  size_t buffer_len = *ret_buffer_len;
+
+  size_t pkg_numval = parse_part_values_num(buffer, buffer_len);
+  if (pkg_numval == 0)
     return -1;
-  }
 
-  memcpy(pkg_types, buffer, pkg_numval * sizeof(*pkg_types));
-  buffer += pkg_numval * sizeof(*pkg_types);
-  memcpy(pkg_values, buffer, pkg_numval * sizeof(*pkg_values));
-  buffer += pkg_numval * sizeof(*pkg_values);
+  size_t pkg_length = 3 * sizeof(uint16_t) +
+                      pkg_numval * (sizeof(uint8_t) + sizeof(value_t));
+  uint8_t const *pkg_types = (uint8_t *)(buffer + 3 * sizeof(uint16_t));
+  char const *pkg_values = (char *)pkg_types + pkg_numval;
 
   for (size_t i = 0; i < pkg_numval; i++) {
+    uint64_t tmp64;
+    memcpy(&tmp64, pkg_values + i * sizeof(tmp64), sizeof(tmp64));
+
     switch (pkg_types[i]) {
     case DS_TYPE_COUNTER:
-      pkg_values[i].counter = (counter_t)ntohll(pkg_values[i].counter);
+      values[i].counter = (counter_t)ntohll(tmp64);
       break;
 
     case DS_TYPE_GAUGE:
-      pkg_values[i].gauge = (gauge_t)ntohd(pkg_values[i].gauge);
+      memcpy(&values[i].gauge, &tmp64, sizeof(tmp64));
+      values[i].gauge = (gauge_t)ntohd(values[i].gauge);
       break;
 
     case DS_TYPE_DERIVE:
-      pkg_values[i].derive = (derive_t)ntohll(pkg_values[i].derive);
+      values[i].derive = (derive_t)ntohll(tmp64);
       break;
 
     case DS_TYPE_ABSOLUTE:
-      pkg_values[i].absolute = (absolute_t)ntohll(pkg_values[i].absolute);
+      values[i].absolute = (absolute_t)ntohll(tmp64);
       break;
 
     default:
       NOTICE("network plugin: parse_part_values: "
              "Don't know how to handle data source type %" PRIu8,
              pkg_types[i]);
-      sfree(pkg_types);
-      sfree(pkg_values);
       return -1;
     } /* switch (pkg_types[i]) */
   }
 
-  *ret_buffer = buffer;
+  *ret_buffer = buffer + pkg_length;
   *ret_buffer_len = buffer_len - pkg_length;
   *ret_num_values = pkg_numval;
-  *ret_values = pkg_values;
-
-  sfree(pkg_types);
 
   return 0;
 } /* int parse_part_values */
@@ -906,8 +1017,11 @@ static int parse_part_number(void **ret_buffer, size_t *ret_buffer_len,
   return 0;
 } /* int parse_part_number */
 
+/* Validates the string part at `*ret_buffer' and stores a pointer to the
+ * null-terminated string inside the packet in `output'. `output_len' is the
+ * maximum size of the string, including the null-byte. */
 static int parse_part_string(void **ret_buffer, size_t *ret_buffer_len,
-                             char *output, size_t const output_len) {
+                             char const **output, size_t const output_len) {
   char *buffer = *ret_buffer;
   size_t buffer_len = *ret_buffer_len;
 
@@ -971,19 +1085,19 @@ static int parse_part_string(void **ret_buffer, size_t *ret_buffer_len,
     return -1;
   }
 
-  /* All sanity checks successfull, let's copy the data over */
-  memcpy((void *)output, (void *)buffer, payload_size);
-  buffer += payload_size;
-
   /* For some very weird reason '\0' doesn't do the trick on SPARC in
    * this statement. */
-  if (output[payload_size - 1] != 0) {
+  if (buffer[payload_size - 1] != 0) {
     WARNING("network plugin: parse_part_string: "
             "Received string does not end "
             "with a NULL-byte.");
     return -1;
   }
 
+  /* All sanity checks successfull, the string can be used in place. */
+  *output = buffer;
+  buffer += payload_size;
+
   *ret_buffer = buffer;
   *ret_buffer_len = buffer_len - pkg_length;
 
@@ -1241,6 +1355,7 @@ static int parse_part_encr_aes256(sockent_t *se, /* {{{ */
   assert(buffer_offset ==
          (username_len + PART_ENCRYPTION_AES256_SIZE - sizeof(pea.hash)));
 
+  /* The cypher handle belongs to this thread, so no lock is needed. */
   cypher = network_get_aes256_cypher(se, pea.iv, sizeof(pea.iv), pea.username);
   if (cypher == NULL) {
     ERROR("network plugin: Failed to get cypher. Username: %s", pea.username);
@@ -1336,14 +1451,133 @@ static int parse_part_encr_aes256(sockent_t *se, /* {{{ */
 
 #undef BUFFER_READ
 
+static void parse_batch_flush(parse_batch_t *b) /* {{{ */
+{
+  if (b->vl_num == 0)
+    return;
+
+  /* All value lists of a packet share the same meta data. The write queue
+   * makes its own copy. */
+  meta_data_t *meta = network_receive_meta(b->username, b->address);
+  if (meta != NULL) {
+    for (size_t i = 0; i < b->vl_num; i++)
+      b->vl[i].meta = meta;
+
+    plugin_dispatch_values_batch(b->vl, b->vl_num);
+    __atomic_fetch_add(&stats_values_dispatched, (derive_t)b->vl_num,
+                       __ATOMIC_RELAXED);
+
+    for (size_t i = 0; i < b->vl_num; i++)
+      b->vl[i].meta = NULL;
+    meta_data_destroy(meta);
+  }
+
+  b->vl_num = 0;
+  b->values_num = 0;
+} /* }}} void parse_batch_flush */
+
+/* Decodes the values part at `*buffer' and adds a value list with the current
+ * identifier to the batch. */
+static int parse_batch_add_values(parse_batch_t *b, /* {{{ */
+                                  parse_ident_t const *id, cdtime_t time,
+                                  cdtime_t interval, void **buffer,
+                                  size_t *buffer_size) {
+  size_t num = parse_part_values_num(*buffer, *buffer_size);
+  if (num == 0)
+    return -1;
+
+  if ((b->vl_num >= NETWORK_PARSE_BATCH_SIZE) ||
+      ((b->values_num + num) > NETWORK_PARSE_VALUES_SIZE))
+    parse_batch_flush(b);
+
+  /* Parts with more values than fit into the batch are dispatched on their
+   * own. */
+  value_t *values = b->values + b->values_num;
+  value_t *values_alloc = NULL;
+  if (num > NETWORK_PARSE_VALUES_SIZE) {
+    values_alloc = calloc(num, sizeof(*values_alloc));
+    if (values_alloc == NULL) {
+      ERROR("network plugin: parse_batch_add_values: calloc failed.");
+      return -1;
+    }
+    values = values_alloc;
+  }
+
+  size_t values_len = 0;
+  int status = parse_part_values(buffer, buffer_size, values, &values_len);
+  if (status != 0) {
+    sfree(values_alloc);
+    return status;
+  }
+
+  /* Ignore value lists with incomplete identifiers. */
+  if ((time == 0) || (id->host[0] == 0) || (id->plugin[0] == 0) ||
+      (id->type[0] == 0)) {
+    sfree(values_alloc);
+    return 0;
+  }
+
+  value_list_t *vl = b->vl + b->vl_num;
+  *vl = (value_list_t){
+      .values = values,
+      .values_len = values_len,
+      .time = time,
+      .interval = interval,
+  };
+  sstrncpy(vl->host, id->host, sizeof(vl->host));
+  sstrncpy(vl->plugin, id->plugin, sizeof(vl->plugin));
+  sstrncpy(vl->plugin_instance, id->plugin_instance,
+           sizeof(vl->plugin_instance));
+  sstrncpy(vl->type, id->type, sizeof(vl->type));
+  sstrncpy(vl->type_instance, id->type_instance, sizeof(vl->type_instance));
+
+  if (!check_receive_okay(vl)) {
+#if COLLECT_DEBUG
+    char name[6 * DATA_MAX_NAME_LEN];
+    FORMAT_VL(name, sizeof(name), vl);
+    name[sizeof(name) - 1] = '\0';
+    DEBUG("network plugin: parse_batch_add_values: "
+          "NOT dispatching %s.",
+          name);
+#endif
+    __atomic_fetch_add(&stats_values_not_dispatched, 1, __ATOMIC_RELAXED);
+    sfree(values_alloc);
+    return 0;
+  }
+
+  b->vl_num++;
+  if (values_alloc != NULL) {
+    parse_batch_flush(b);
+    sfree(values_alloc);
+  } else {
+    b->values_num += values_len;
+  }
+
+  return 0;
+} /* }}} int parse_batch_add_values */
+
 static int parse_packet(sockent_t *se, /* {{{ */
                         void *buffer, size_t buffer_size, int flags,
                         const char *username,
                         struct sockaddr_storage *address) {
   int status;
 
-  value_list_t vl = VALUE_LIST_INIT;
-  notification_t n = {0};
+  parse_ident_t id = {
+      .host = "",
+      .plugin = "",
+      .plugin_instance = "",
+      .type = "",
+      .type_instance = "",
+  };
+  cdtime_t time = 0;
+  cdtime_t interval = 0;
+  int severity = 0;
+  parse_batch_t batch = {
+      .vl_num = 0,
+      .values_num = 0,
+      .username = username,
+      .address = address,
+  };
 
 #if HAVE_GCRYPT_H
   int packet_was_signed = (flags & PP_SIGNED);
@@ -1351,7 +1585,6 @@ static int parse_packet(sockent_t *se, /* {{{ */
   int printed_ignore_warning = 0;
 #endif /* HAVE_GCRYPT_H */
 
-  memset(&vl, '\0', sizeof(vl));
   status = 0;
 
   while ((status == 0) && (0 < buffer_size) &&
@@ -1421,92 +1654,86 @@ static int parse_packet(sockent_t *se, /* {{{ */
     }
 #endif /* HAVE_GCRYPT_H */
     else if (pkg_type == TYPE_VALUES) {
-      status =
-          parse_part_values(&buffer, &buffer_size, &vl.values, &vl.values_len);
-      if (status != 0)
-        break;
-
-      network_dispatch_values(&vl, username, address);
-
-      sfree(vl.values);
+      status = parse_batch_add_values(&batch, &id, time, interval, &buffer,
+                                      &buffer_size);
     } else if (pkg_type == TYPE_TIME) {
       uint64_t tmp = 0;
       status = parse_part_number(&buffer, &buffer_size, &tmp);
-      if (status == 0) {
-        vl.time = TIME_T_TO_CDTIME_T(tmp);
-        n.time = TIME_T_TO_CDTIME_T(tmp);
-      }
+      if (status == 0)
+        time = TIME_T_TO_CDTIME_T(tmp);
     } else if (pkg_type == TYPE_TIME_HR) {
       uint64_t tmp = 0;
       status = parse_part_number(&buffer, &buffer_size, &tmp);
-      if (status == 0) {
-        vl.time = (cdtime_t)tmp;
-        n.time = (cdtime_t)tmp;
-      }
+      if (status == 0)
+        time = (cdtime_t)tmp;
     } else if (pkg_type == TYPE_INTERVAL) {
       uint64_t tmp = 0;
       status = parse_part_number(&buffer, &buffer_size, &tmp);
       if (status == 0)
-        vl.interval = TIME_T_TO_CDTIME_T(tmp);
+        interval = TIME_T_TO_CDTIME_T(tmp);
     } else if (pkg_type == TYPE_INTERVAL_HR) {
       uint64_t tmp = 0;
       status = parse_part_number(&buffer, &buffer_size, &tmp);
       if (status == 0)
-        vl.interval = (cdtime_t)tmp;
+        interval = (cdtime_t)tmp;
     } else if (pkg_type == TYPE_HOST) {
-      status =
-          parse_part_string(&buffer, &buffer_size, vl.host, sizeof(vl.host));
-      if (status == 0)
-        sstrncpy(n.host, vl.host, sizeof(n.host));
+      status = parse_part_string(&buffer, &buffer_size, &id.host,
+                                 DATA_MAX_NAME_LEN);
     } else if (pkg_type == TYPE_PLUGIN) {
-      status = parse_part_string(&buffer, &buffer_size, vl.plugin,
-                                 sizeof(vl.plugin));
-      if (status == 0)
-        sstrncpy(n.plugin, vl.plugin, sizeof(n.plugin));
+      status = parse_part_string(&buffer, &buffer_size, &id.plugin,
+                                 DATA_MAX_NAME_LEN);
     } else if (pkg_type == TYPE_PLUGIN_INSTANCE) {
-      status = parse_part_string(&buffer, &buffer_size, vl.plugin_instance,
-                                 sizeof(vl.plugin_instance));
-      if (status == 0)
-        sstrncpy(n.plugin_instance, vl.plugin_instance,
-                 sizeof(n.plugin_instance));
+      status = parse_part_string(&buffer, &buffer_size, &id.plugin_instance,
+                                 DATA_MAX_NAME_LEN);
     } else if (pkg_type == TYPE_TYPE) {
-      status =
-          parse_part_string(&buffer, &buffer_size, vl.type, sizeof(vl.type));
-      if (status == 0)
-        sstrncpy(n.type, vl.type, sizeof(n.type));
+      status = parse_part_string(&buffer, &buffer_size, &id.type,
+                                 DATA_MAX_NAME_LEN);
     } else if (pkg_type == TYPE_TYPE_INSTANCE) {
-      status = parse_part_string(&buffer, &buffer_size, vl.type_instance,
-                                 sizeof(vl.type_instance));
-      if (status == 0)
-        sstrncpy(n.type_instance, vl.type_instance, sizeof(n.type_instance));
+      status = parse_part_string(&buffer, &buffer_size, &id.type_instance,
+                                 DATA_MAX_NAME_LEN);
     } else if (pkg_type == TYPE_MESSAGE) {
-      status = parse_part_string(&buffer, &buffer_size, n.message,
-                                 sizeof(n.message));
+      char const *message = NULL;
+      status = parse_part_string(&buffer, &buffer_size, &message,
+                                 NOTIF_MAX_MSG_LEN);
 
       if (status != 0) {
         /* do nothing */
-      } else if ((n.severity != NOTIF_FAILURE) &&
-                 (n.severity != NOTIF_WARNING) && (n.severity != NOTIF_OKAY)) {
+      } else if ((severity != NOTIF_FAILURE) && (severity != NOTIF_WARNING) &&
+                 (severity != NOTIF_OKAY)) {
         INFO("network plugin: "
              "Ignoring notification with "
              "unknown severity %i.",
-             n.severity);
-      } else if (n.time == 0) {
+             severity);
+      } else if (time == 0) {
         INFO("network plugin: "
              "Ignoring notification with "
              "time == 0.");
-      } else if (strlen(n.message) == 0) {
+      } else if (strlen(message) == 0) {
         INFO("network plugin: "
              "Ignoring notification with "
              "an empty message.");
       } else {
+        notification_t n = {
+            .severity = severity,
+            .time = time,
+        };
+        sstrncpy(n.message, message, sizeof(n.message));
+        sstrncpy(n.host, id.host, sizeof(n.host));
+        sstrncpy(n.plugin, id.plugin, sizeof(n.plugin));
+        sstrncpy(n.plugin_instance, id.plugin_instance,
+                 sizeof(n.plugin_instance));
+        sstrncpy(n.type, id.type, sizeof(n.type));
+        sstrncpy(n.type_instance, id.type_instance, sizeof(n.type_instance));
+
+        /* Keep the order of values and notifications. */
+        parse_batch_flush(&batch);
         network_dispatch_notification(&n);
       }
     } else if (pkg_type == TYPE_SEVERITY) {
       uint64_t tmp = 0;
       status = parse_part_number(&buffer, &buffer_size, &tmp);
       if (status == 0)
-        n.severity = (int)tmp;
+        severity = (int)tmp;
     } else {
       DEBUG("network plugin: parse_packet: Unknown part"
             " type: 0x%04hx",
@@ -1516,6 +1743,8 @@ static int parse_packet(sockent_t *se, /* {{{ */
     }
   } /* while (buffer_size > sizeof (part_header_t)) */
 
+  parse_batch_flush(&batch);
+
   if (status == 0 && buffer_size > 0)
     WARNING("network plugin: parse_packet: Received truncated "
             "packet, try increasing `MaxPacketSize'");
@@ -1523,6 +1752,15 @@ static int parse_packet(sockent_t *se, /* {{{ */
   return status;
 } /* }}} int parse_packet */
 
+static void send_packet_unref(send_packet_t *packet) /* {{{ */
+{
+  if (packet == NULL)
+    return;
+
+  if (__atomic_sub_fetch(&packet->refcount, 1, __ATOMIC_ACQ_REL) == 0)
+    free(packet);
+} /* }}} void send_packet_unref */
+
 static void free_sockent_client(struct sockent_client *sec) /* {{{ */
 {
   if (sec->fd >= 0) {
@@ -1531,6 +1769,14 @@ static void free_sockent_client(struct sockent_client *sec) /* {{{ */
   }
   sfree(sec->addr);
   sfree(sec->bind_addr);
+  if (sec->queue != NULL) {
+    for (size_t i = 0; i < sec->queue_len; i++)
+      send_packet_unref(
+          sec->queue[(sec->queue_head + i) % NETWORK_SEND_QUEUE_SIZE]);
+    sfree(sec->queue);
+  }
+  sfree(sec->seal_buffer);
+  pthread_cond_destroy(&sec->queue_cond);
 #if HAVE_GCRYPT_H
   sfree(sec->username);
   sfree(sec->password);
@@ -1549,11 +1795,10 @@ static void free_sockent_server(struct sockent_server *ses) /* {{{ */
   }
 
   sfree(ses->fd);
+  sfree(ses->fd_thread);
 #if HAVE_GCRYPT_H
   sfree(ses->auth_file);
   fbh_destroy(ses->userdb);
-  if (ses->cypher != NULL)
-    gcry_cipher_close(ses->cypher);
 #endif
 } /* }}} void free_sockent_server */
 
@@ -1750,8 +1995,21 @@ static int network_bind_socket_to_addr(sockent_t *se,
   return 0;
 } /* int network_bind_socket_to_addr */
 
+static bool network_addr_is_multicast(const struct addrinfo *ai) /* {{{ */
+{
+  if (ai->ai_family == AF_INET) {
+    struct sockaddr_in *addr = (struct sockaddr_in *)ai->ai_addr;
+    return IN_MULTICAST(ntohl(addr->sin_addr.s_addr));
+  } else if (ai->ai_family == AF_INET6) {
+    struct sockaddr_in6 *addr = (struct sockaddr_in6 *)ai->ai_addr;
+    return IN6_IS_ADDR_MULTICAST(&addr->sin6_addr);
+  }
+
+  return false;
+} /* }}} bool network_addr_is_multicast */
+
 static int network_bind_socket(int fd, const struct addrinfo *ai,
-                               const int interface_idx) {
+                               const int interface_idx, bool reuse_port) {
 #if KERNEL_SOLARIS
   char loop = 0;
 #else
@@ -1764,6 +2022,19 @@ static int network_bind_socket(int fd, const struct addrinfo *ai,
     return -1;
   }
 
+#ifdef SO_REUSEPORT
+  /* let the kernel distribute incoming packets between the sockets of all
+   * receive threads */
+  if (reuse_port &&
+      (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &(int){1}, sizeof(int)) ==
+       -1)) {
+    ERROR("network plugin: setsockopt (reuseport): %s", STRERRNO);
+    return -1;
+  }
+#else
+  assert(!reuse_port);
+#endif
+
   DEBUG("fd = %i; calling `bind'", fd);
 
   if (bind(fd, ai->ai_addr, ai->ai_addrlen) == -1) {
@@ -1891,12 +2162,12 @@ static sockent_t *sockent_create(int type) /* {{{ */
 
   if (type == SOCKENT_TYPE_SERVER) {
     se->data.server.fd = NULL;
+    se->data.server.fd_thread = NULL;
     se->data.server.fd_num = 0;
 #if HAVE_GCRYPT_H
     se->data.server.security_level = SECURITY_LEVEL_NONE;
     se->data.server.auth_file = NULL;
     se->data.server.userdb = NULL;
-    se->data.server.cypher = NULL;
 #endif
   } else {
     se->data.client.fd = -1;
@@ -1904,6 +2175,9 @@ static sockent_t *sockent_create(int type) /* {{{ */
     se->data.client.bind_addr = NULL;
     se->data.client.resolve_interval = 0;
     se->data.client.next_resolve_reconnect = 0;
+    se->data.client.queue = NULL;
+    se->data.client.seal_buffer = NULL;
+    pthread_cond_init(&se->data.client.queue_cond, NULL);
 #if HAVE_GCRYPT_H
     se->data.client.security_level = SECURITY_LEVEL_NONE;
     se->data.client.username = NULL;
@@ -2116,32 +2390,55 @@ static int sockent_server_listen(sockent_t *se) /* {{{ */
 
   for (struct addrinfo *ai_ptr = ai_list; ai_ptr != NULL;
        ai_ptr = ai_ptr->ai_next) {
-    int *tmp;
+    /* With `ReceiveThreads', open one socket per receive thread. Multicast
+     * packets are delivered to every socket bound to the group, so only one
+     * socket is opened for multicast addresses. */
+    size_t sockets_num = 1;
+#ifdef SO_REUSEPORT
+    if ((network_config_receive_threads > 1) &&
+        !network_addr_is_multicast(ai_ptr))
+      sockets_num = network_config_receive_threads;
+#endif
 
-    tmp = realloc(se->data.server.fd,
-                  sizeof(*tmp) * (se->data.server.fd_num + 1));
-    if (tmp == NULL) {
-      ERROR("network plugin: realloc failed.");
-      continue;
-    }
-    se->data.server.fd = tmp;
-    tmp = se->data.server.fd + se->data.server.fd_num;
+    for (size_t i = 0; i < sockets_num; i++) {
+      int *tmp;
+      size_t *tmp_thread;
 
-    *tmp = socket(ai_ptr->ai_family, ai_ptr->ai_socktype, ai_ptr->ai_protocol);
-    if (*tmp < 0) {
-      ERROR("network plugin: socket(2) failed: %s", STRERRNO);
-      continue;
-    }
+      tmp = realloc(se->data.server.fd,
+                    sizeof(*tmp) * (se->data.server.fd_num + 1));
+      if (tmp == NULL) {
+        ERROR("network plugin: realloc failed.");
+        continue;
+      }
+      se->data.server.fd = tmp;
+      tmp = se->data.server.fd + se->data.server.fd_num;
 
-    status = network_bind_socket(*tmp, ai_ptr, se->interface);
-    if (status != 0) {
-      close(*tmp);
-      *tmp = -1;
-      continue;
-    }
+      tmp_thread = realloc(se->data.server.fd_thread,
+                           sizeof(*tmp_thread) * (se->data.server.fd_num + 1));
+      if (tmp_thread == NULL) {
+        ERROR("network plugin: realloc failed.");
+        continue;
+      }
+      se->data.server.fd_thread = tmp_thread;
+      se->data.server.fd_thread[se->data.server.fd_num] = i;
+
+      *tmp =
+          socket(ai_ptr->ai_family, ai_ptr->ai_socktype, ai_ptr->ai_protocol);
+      if (*tmp < 0) {
+        ERROR("network plugin: socket(2) failed: %s", STRERRNO);
+        continue;
+      }
 
-    se->data.server.fd_num++;
-    continue;
+      status = network_bind_socket(*tmp, ai_ptr, se->interface,
+                                   /* reuse_port = */ sockets_num > 1);
+      if (status != 0) {
+        close(*tmp);
+        *tmp = -1;
+        continue;
+      }
+
+      se->data.server.fd_num++;
+    }
   } /* for (ai_list) */
 
   freeaddrinfo(ai_list);
@@ -2302,8 +2599,9 @@ static int network_receive(void) /* {{{ */
         break;
       }
 
-      stats_octets_rx += ((uint64_t)buffer_len);
-      stats_packets_rx++;
+      __atomic_fetch_add(&stats_octets_rx, (derive_t)buffer_len,
+                         __ATOMIC_RELAXED);
+      __atomic_fetch_add(&stats_packets_rx, 1, __ATOMIC_RELAXED);
 
       /* TODO: Possible performance enhancement: Do not free
        * these entries in the dispatch thread but put them in
@@ -2387,6 +2685,197 @@ static void *receive_thread(void __attribute__((unused)) * arg) {
   return network_receive() ? (void *)1 : (void *)0;
 } /* void *receive_thread */
 
+/* Reads up to `num' packets from `fd' without blocking. Returns the number of
+ * packets read, zero if no packet was available, or a negative errno value. */
+static int network_receive_batch(int fd, char *buffers, /* {{{ */
+                                 int *buffers_len,
+                                 struct sockaddr_storage *senders, int num) {
+#if HAVE_RECVMMSG
+  struct mmsghdr msgs[num];
+  struct iovec iovs[num];
+
+  memset(msgs, 0, sizeof(msgs));
+  for (int i = 0; i < num; i++) {
+    iovs[i] = (struct iovec){
+        .iov_base = buffers + (i * network_config_packet_size),
+        .iov_len = network_config_packet_size,
+    };
+    msgs[i].msg_hdr = (struct msghdr){
+        .msg_name = senders + i,
+        .msg_namelen = sizeof(*senders),
+        .msg_iov = iovs + i,
+        .msg_iovlen = 1,
+    };
+  }
+
+  int status = recvmmsg(fd, msgs, (unsigned int)num, MSG_DONTWAIT,
+                        /* timeout = */ NULL);
+  if (status < 0)
+    return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? 0 : -errno;
+
+  for (int i = 0; i < status; i++)
+    buffers_len[i] = (int)msgs[i].msg_len;
+  return status;
+#else
+  socklen_t length = sizeof(*senders);
+  ssize_t status = recvfrom(fd, buffers, network_config_packet_size,
+                            MSG_DONTWAIT, (struct sockaddr *)senders, &length);
+  if (status < 0)
+    return ((errno == EAGAIN) || (errno == EWOULDBLOCK)) ? 0 : -errno;
+
+  buffers_len[0] = (int)status;
+  return 1;
+#endif
+} /* }}} int network_receive_batch */
+
+/* Receives and parses packets from the sockets assigned to one receive
+ * thread. Packets are parsed by the thread that received them, so no
+ * per-packet allocation or hand-over to another thread is needed. */
+static void *receive_parse_thread(void *arg) /* {{{ */
+{
+  receive_thread_t *rt = arg;
+  int status = 0;
+
+  char *buffers =
+      malloc(NETWORK_RECEIVE_BATCH_SIZE * network_config_packet_size);
+  int buffers_len[NETWORK_RECEIVE_BATCH_SIZE];
+  struct sockaddr_storage senders[NETWORK_RECEIVE_BATCH_SIZE];
+  if (buffers == NULL) {
+    ERROR("network plugin: malloc failed.");
+    return (void *)1;
+  }
+
+  while (listen_loop == 0) {
+    status = poll(rt->pollfd, rt->fd_num, -1);
+    if (status <= 0) {
+      if (errno == EINTR)
+        continue;
+      ERROR("network plugin: poll(2) failed: %s", STRERRNO);
+      break;
+    }
+
+    for (size_t i = 0; i < rt->fd_num; i++) {
+      if ((rt->pollfd[i].revents & (POLLIN | POLLPRI)) == 0)
+        continue;
+
+      /* Drain the socket, but give the other sockets a chance after a few
+       * batches. */
+      for (int j = 0; j < 4; j++) {
+        memset(senders, 0, sizeof(senders));
+        int num = network_receive_batch(rt->pollfd[i].fd, buffers,
+                                        buffers_len, senders,
+                                        NETWORK_RECEIVE_BATCH_SIZE);
+        if (num < 0) {
+          ERROR("network plugin: recv(2) failed: %s", STRERROR(-num));
+          break;
+        }
+
+        derive_t octets = 0;
+        for (int k = 0; k < num; k++)
+          octets += (derive_t)buffers_len[k];
+        __atomic_fetch_add(&stats_octets_rx, octets, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&stats_packets_rx, (derive_t)num, __ATOMIC_RELAXED);
+
+        for (int k = 0; k < num; k++)
+          parse_packet(rt->sockent[i],
+                       buffers + (k * network_config_packet_size),
+                       (size_t)buffers_len[k], /* flags = */ 0,
+                       /* username = */ NULL, senders + k);
+
+        if (num < NETWORK_RECEIVE_BATCH_SIZE)
+          break;
+      }
+    }
+    status = 0;
+  } /* while (listen_loop == 0) */
+
+  sfree(buffers);
+  return status ? (void *)1 : (void *)0;
+} /* }}} void *receive_parse_thread */
+
+static int start_receive_threads(void) /* {{{ */
+{
+  receive_threads = calloc(network_config_receive_threads,
+                           sizeof(*receive_threads));
+  if (receive_threads == NULL) {
+    ERROR("network plugin: calloc failed.");
+    return ENOMEM;
+  }
+  receive_threads_num = network_config_receive_threads;
+
+  /* Assign each socket to the receive thread it was opened for. */
+  for (sockent_t *se = listen_sockets; se != NULL; se = se->next) {
+    for (size_t i = 0; i < se->data.server.fd_num; i++) {
+      size_t thread = se->data.server.fd_thread[i] % receive_threads_num;
+      receive_thread_t *rt = receive_threads + thread;
+
+      struct pollfd *tmp_pollfd =
+          realloc(rt->pollfd, sizeof(*rt->pollfd) * (rt->fd_num + 1));
+      if (tmp_pollfd == NULL) {
+        ERROR("network plugin: realloc failed.");
+        return ENOMEM;
+      }
+      rt->pollfd = tmp_pollfd;
+
+      sockent_t **tmp_sockent =
+          realloc(rt->sockent, sizeof(*rt->sockent) * (rt->fd_num + 1));
+      if (tmp_sockent == NULL) {
+        ERROR("network plugin: realloc failed.");
+        return ENOMEM;
+      }
+      rt->sockent = tmp_sockent;
+
+      rt->pollfd[rt->fd_num] = (struct pollfd){
+          .fd = se->data.server.fd[i],
+          .events = POLLIN | POLLPRI,
+      };
+      rt->sockent[rt->fd_num] = se;
+      rt->fd_num++;
+    }
+  }
+
+  for (size_t i = 0; i < receive_threads_num; i++) {
+    receive_thread_t *rt = receive_threads + i;
+    char name[16];
+
+    if (rt->fd_num == 0)
+      continue;
+
+    ssnprintf(name, sizeof(name), "network recv#%" PRIsz, i);
+    int status = plugin_thread_create(&rt->id, receive_parse_thread, rt, name);
+    if (status != 0) {
+      ERROR("network: pthread_create failed: %s", STRERRNO);
+      continue;
+    }
+    rt->running = true;
+  }
+
+  return 0;
+} /* }}} int start_receive_threads */
+
+static void stop_receive_threads(void) /* {{{ */
+{
+  if (receive_threads == NULL)
+    return;
+
+  INFO("network plugin: Stopping %" PRIsz " receive threads.",
+       receive_threads_num);
+  for (size_t i = 0; i < receive_threads_num; i++) {
+    receive_thread_t *rt = receive_threads + i;
+
+    if (rt->running) {
+      pthread_kill(rt->id, SIGTERM);
+      pthread_join(rt->id, /* retval = */ NULL);
+      rt->running = false;
+    }
+    sfree(rt->pollfd);
+    sfree(rt->sockent);
+  }
+
+  sfree(receive_threads);
+  receive_threads_num = 0;
+} /* }}} void stop_receive_threads */
+
 static void network_init_buffer(void) {
   memset(send_buffer, 0, network_config_packet_size);
   send_buffer_ptr = send_buffer;
@@ -2429,10 +2918,11 @@ static void network_send_buffer_plain(sockent_t *se, /* {{{ */
     buffer_offset += (s);                                                      \
   } while (0)
 
-static void network_send_buffer_signed(sockent_t *se, /* {{{ */
-                                       const char *in_buffer,
-                                       size_t in_buffer_size) {
-  char buffer[BUFF_SIG_SIZE + in_buffer_size];
+/* Writes the signed packet to `buffer', which must be able to hold
+ * BUFF_SIG_SIZE + in_buffer_size bytes. Returns the size of the packet. */
+static ssize_t network_seal_signed(sockent_t *se, /* {{{ */
+                                   const char *in_buffer, size_t in_buffer_size,
+                                   char *buffer) {
   size_t buffer_offset;
   size_t username_len;
 
@@ -2445,7 +2935,7 @@ static void network_send_buffer_signed(sockent_t *se, /* {{{ */
   if (err != 0) {
     ERROR("network plugin: Creating HMAC object failed: %s",
           gcry_strerror(err));
-    return;
+    return -1;
   }
 
   err = gcry_md_setkey(hd, se->data.client.password,
@@ -2453,13 +2943,13 @@ static void network_send_buffer_signed(sockent_t *se, /* {{{ */
   if (err != 0) {
     ERROR("network plugin: gcry_md_setkey failed: %s", gcry_strerror(err));
     gcry_md_close(hd);
-    return;
+    return -1;
   }
 
   username_len = strlen(se->data.client.username);
   if (username_len > (BUFF_SIG_SIZE - PART_SIGNATURE_SHA256_SIZE)) {
     ERROR("network plugin: Username too long: %s", se->data.client.username);
-    return;
+    return -1;
   }
 
   memcpy(buffer + PART_SIGNATURE_SHA256_SIZE, se->data.client.username,
@@ -2479,7 +2969,7 @@ static void network_send_buffer_signed(sockent_t *se, /* {{{ */
   if (hash == NULL) {
     ERROR("network plugin: gcry_md_read failed.");
     gcry_md_close(hd);
-    return;
+    return -1;
   }
   memcpy(ps.hash, hash, sizeof(ps.hash));
 
@@ -2495,14 +2985,14 @@ static void network_send_buffer_signed(sockent_t *se, /* {{{ */
   gcry_md_close(hd);
   hd = NULL;
 
-  buffer_offset = PART_SIGNATURE_SHA256_SIZE + username_len + in_buffer_size;
-  network_send_buffer_plain(se, buffer, buffer_offset);
-} /* }}} void network_send_buffer_signed */
+  return (ssize_t)(PART_SIGNATURE_SHA256_SIZE + username_len + in_buffer_size);
+} /* }}} ssize_t network_seal_signed */
 
-static void network_send_buffer_encrypted(sockent_t *se, /* {{{ */
-                                          const char *in_buffer,
-                                          size_t in_buffer_size) {
-  char buffer[BUFF_SIG_SIZE + in_buffer_size];
+/* Writes the encrypted packet to `buffer', which must be able to hold
+ * BUFF_SIG_SIZE + in_buffer_size bytes. Returns the size of the packet. */
+static ssize_t network_seal_encrypted(sockent_t *se, /* {{{ */
+                                      const char *in_buffer,
+                                      size_t in_buffer_size, char *buffer) {
   size_t buffer_size;
   size_t buffer_offset;
   size_t header_size;
@@ -2517,14 +3007,14 @@ static void network_send_buffer_encrypted(sockent_t *se, /* {{{ */
   username_len = strlen(pea.username);
   if ((PART_ENCRYPTION_AES256_SIZE + username_len) > BUFF_SIG_SIZE) {
     ERROR("network plugin: Username too long: %s", pea.username);
-    return;
+    return -1;
   }
 
   buffer_size = PART_ENCRYPTION_AES256_SIZE + username_len + in_buffer_size;
   header_size = PART_ENCRYPTION_AES256_SIZE + username_len - sizeof(pea.hash);
 
-  assert(buffer_size <= sizeof(buffer));
-  DEBUG("network plugin: network_send_buffer_encrypted: "
+  assert(buffer_size <= BUFF_SIG_SIZE + in_buffer_size);
+  DEBUG("network plugin: network_seal_encrypted: "
         "buffer_size = %" PRIsz ";",
         buffer_size);
 
@@ -2540,7 +3030,7 @@ static void network_send_buffer_encrypted(sockent_t *se, /* {{{ */
 
   /* Initialize the buffer */
   buffer_offset = 0;
-  memset(buffer, 0, sizeof(buffer));
+  memset(buffer, 0, buffer_size);
 
   BUFFER_ADD(&pea.head.type, sizeof(pea.head.type));
   BUFFER_ADD(&pea.head.length, sizeof(pea.head.length));
@@ -2556,7 +3046,7 @@ static void network_send_buffer_encrypted(sockent_t *se, /* {{{ */
   cypher = network_get_aes256_cypher(se, pea.iv, sizeof(pea.iv),
                                      se->data.client.password);
   if (cypher == NULL)
-    return;
+    return -1;
 
   /* Encrypt the buffer in-place */
   err = gcry_cipher_encrypt(cypher, buffer + header_size,
@@ -2565,21 +3055,254 @@ static void network_send_buffer_encrypted(sockent_t *se, /* {{{ */
   if (err != 0) {
     ERROR("network plugin: gcry_cipher_encrypt returned: %s",
           gcry_strerror(err));
-    return;
+    return -1;
   }
 
-  /* Send it out without further modifications */
-  network_send_buffer_plain(se, buffer, buffer_size);
+  return (ssize_t)buffer_size;
+} /* }}} ssize_t network_seal_encrypted */
+
+static void network_send_buffer_signed(sockent_t *se, /* {{{ */
+                                       const char *in_buffer,
+                                       size_t in_buffer_size) {
+  char buffer[BUFF_SIG_SIZE + in_buffer_size];
+
+  ssize_t buffer_size =
+      network_seal_signed(se, in_buffer, in_buffer_size, buffer);
+  if (buffer_size > 0)
+    network_send_buffer_plain(se, buffer, (size_t)buffer_size);
+} /* }}} void network_send_buffer_signed */
+
+static void network_send_buffer_encrypted(sockent_t *se, /* {{{ */
+                                          const char *in_buffer,
+                                          size_t in_buffer_size) {
+  char buffer[BUFF_SIG_SIZE + in_buffer_size];
+
+  ssize_t buffer_size =
+      network_seal_encrypted(se, in_buffer, in_buffer_size, buffer);
+  if (buffer_size > 0)
+    network_send_buffer_plain(se, buffer, (size_t)buffer_size);
 } /* }}} void network_send_buffer_encrypted */
 #undef BUFFER_ADD
 #endif /* HAVE_GCRYPT_H */
 
+/* Signs or encrypts the packets as required and sends them to the server. With
+ * sendmmsg(2) all packets are sent using a single system call. */
+static void network_send_packets(sockent_t *se, /* {{{ */
+                                 send_packet_t **packets, size_t packets_num) {
+  struct sockent_client *client = &se->data.client;
+  struct iovec iov[NETWORK_SEND_BATCH_SIZE];
+  size_t iov_num = 0;
+
+  assert(packets_num <= NETWORK_SEND_BATCH_SIZE);
+
+  for (size_t i = 0; i < packets_num; i++) {
+    iov[iov_num] = (struct iovec){
+        .iov_base = packets[i]->data,
+        .iov_len = packets[i]->size,
+    };
+#if HAVE_GCRYPT_H
+    char *sealed =
+        client->seal_buffer + i * (network_config_packet_size + BUFF_SIG_SIZE);
+    ssize_t sealed_size = 0;
+
+    if (client->security_level == SECURITY_LEVEL_ENCRYPT)
+      sealed_size = network_seal_encrypted(se, packets[i]->data,
+                                           packets[i]->size, sealed);
+    else if (client->security_level == SECURITY_LEVEL_SIGN)
+      sealed_size =
+          network_seal_signed(se, packets[i]->data, packets[i]->size, sealed);
+
+    if (sealed_size < 0)
+      continue;
+    else if (sealed_size > 0)
+      iov[iov_num] = (struct iovec){
+          .iov_base = sealed,
+          .iov_len = (size_t)sealed_size,
+      };
+#endif /* HAVE_GCRYPT_H */
+    iov_num++;
+  }
+
+#if HAVE_SENDMMSG
+  if (sockent_client_connect(se) != 0)
+    return;
+
+  struct mmsghdr msgs[NETWORK_SEND_BATCH_SIZE];
+  memset(msgs, 0, sizeof(msgs));
+  for (size_t i = 0; i < iov_num; i++) {
+    msgs[i].msg_hdr.msg_name = client->addr;
+    msgs[i].msg_hdr.msg_namelen = client->addrlen;
+    msgs[i].msg_hdr.msg_iov = iov + i;
+    msgs[i].msg_hdr.msg_iovlen = 1;
+  }
+
+  size_t sent = 0;
+  while (sent < iov_num) {
+    int status = sendmmsg(client->fd, msgs + sent,
+                          (unsigned int)(iov_num - sent), /* flags = */ 0);
+    if (status < 0) {
+      if ((errno == EINTR) || (errno == EAGAIN))
+        continue;
+
+      ERROR("network plugin: sendmmsg failed: %s. Closing sending socket.",
+            STRERRNO);
+      sockent_client_disconnect(se);
+      return;
+    }
+    sent += (size_t)status;
+  }
+#else
+  for (size_t i = 0; i < iov_num; i++)
+    network_send_buffer_plain(se, iov[i].iov_base, iov[i].iov_len);
+#endif
+} /* }}} void network_send_packets */
+
+static void *send_thread(void *arg) /* {{{ */
+{
+  sockent_t *se = arg;
+  struct sockent_client *client = &se->data.client;
+  send_packet_t *packets[NETWORK_SEND_BATCH_SIZE];
+
+  pthread_mutex_lock(&se->lock);
+  while (42) {
+    while ((client->queue_len == 0) && !client->send_thread_stop)
+      pthread_cond_wait(&client->queue_cond, &se->lock);
+
+    /* Only exit once the queue has been drained. */
+    if (client->queue_len == 0)
+      break;
+
+    size_t packets_num = 0;
+    while ((packets_num < NETWORK_SEND_BATCH_SIZE) && (client->queue_len > 0)) {
+      packets[packets_num] = client->queue[client->queue_head];
+      packets_num++;
+      client->queue_head = (client->queue_head + 1) % NETWORK_SEND_QUEUE_SIZE;
+      client->queue_len--;
+    }
+
+    /* The socket and cypher are only used by this thread, so the lock is not
+     * held while sending. */
+    pthread_mutex_unlock(&se->lock);
+    network_send_packets(se, packets, packets_num);
+    for (size_t i = 0; i < packets_num; i++)
+      send_packet_unref(packets[i]);
+    pthread_mutex_lock(&se->lock);
+  }
+  pthread_mutex_unlock(&se->lock);
+
+  return NULL;
+} /* }}} void *send_thread */
+
+static int start_send_threads(void) /* {{{ */
+{
+  size_t threads_num = 0;
+
+  for (sockent_t *se = sending_sockets; se != NULL; se = se->next) {
+    struct sockent_client *client = &se->data.client;
+    char name[16];
+
+    client->queue = calloc(NETWORK_SEND_QUEUE_SIZE, sizeof(*client->queue));
+    client->seal_buffer = calloc(NETWORK_SEND_BATCH_SIZE,
+                                 network_config_packet_size + BUFF_SIG_SIZE);
+    if ((client->queue == NULL) || (client->seal_buffer == NULL)) {
+      ERROR("network plugin: calloc failed.");
+      sfree(client->queue);
+      sfree(client->seal_buffer);
+      return -1;
+    }
+    client->queue_head = 0;
+    client->queue_len = 0;
+    client->send_thread_stop = false;
+
+    ssnprintf(name, sizeof(name), "network send#%" PRIsz, threads_num);
+    int status = plugin_thread_create(&client->send_thread_id, send_thread, se,
+                                      name);
+    if (status != 0) {
+      ERROR("network: pthread_create failed: %s", STRERRNO);
+      sfree(client->queue);
+      sfree(client->seal_buffer);
+      return -1;
+    }
+    client->send_thread_running = true;
+    threads_num++;
+  }
+
+  return 0;
+} /* }}} int start_send_threads */
+
+static void stop_send_threads(void) /* {{{ */
+{
+  for (sockent_t *se = sending_sockets; se != NULL; se = se->next) {
+    struct sockent_client *client = &se->data.client;
+
+    if (!client->send_thread_running)
+      continue;
+
+    pthread_mutex_lock(&se->lock);
+    client->send_thread_stop = true;
+    pthread_cond_signal(&client->queue_cond);
+    pthread_mutex_unlock(&se->lock);
+
+    pthread_join(client->send_thread_id, /* retval = */ NULL);
+    client->send_thread_running = false;
+  }
+} /* }}} void stop_send_threads */
+
+/* Appends the packet to the send queue of the server. If the queue is full,
+ * the packet is dropped. */
+static void network_enqueue_packet(sockent_t *se, /* {{{ */
+                                   send_packet_t *packet) {
+  static c_complain_t complaint = C_COMPLAIN_INIT_STATIC;
+  struct sockent_client *client = &se->data.client;
+
+  pthread_mutex_lock(&se->lock);
+  if (client->queue_len >= NETWORK_SEND_QUEUE_SIZE) {
+    pthread_mutex_unlock(&se->lock);
+    c_complain(LOG_WARNING, &complaint,
+               "network plugin: The send queue for \"%s\" is full. "
+               "Dropping packets.",
+               se->node);
+    return;
+  }
+
+  __atomic_add_fetch(&packet->refcount, 1, __ATOMIC_RELAXED);
+  client->queue[(client->queue_head + client->queue_len) %
+                NETWORK_SEND_QUEUE_SIZE] = packet;
+  client->queue_len++;
+  pthread_cond_signal(&client->queue_cond);
+  pthread_mutex_unlock(&se->lock);
+
+  c_release(LOG_INFO, &complaint,
+            "network plugin: The send queue for \"%s\" accepts packets "
+            "again.",
+            se->node);
+} /* }}} void network_enqueue_packet */
+
 static void network_send_buffer(char *buffer, size_t buffer_len) /* {{{ */
 {
+  send_packet_t *packet = NULL;
+
   DEBUG("network plugin: network_send_buffer: buffer_len = %" PRIsz,
         buffer_len);
 
   for (sockent_t *se = sending_sockets; se != NULL; se = se->next) {
+    /* With `SendThreads', the packet is copied once and handed to the send
+     * threads of all servers. */
+    if (se->data.client.send_thread_running) {
+      if (packet == NULL) {
+        packet = malloc(sizeof(*packet) + buffer_len);
+        if (packet == NULL) {
+          ERROR("network plugin: malloc failed.");
+          return;
+        }
+        packet->refcount = 1;
+        packet->size = buffer_len;
+        memcpy(packet->data, buffer, buffer_len);
+      }
+      network_enqueue_packet(se, packet);
+      continue;
+    }
+
     pthread_mutex_lock(&se->lock);
 #if HAVE_GCRYPT_H
     if (se->data.client.security_level == SECURITY_LEVEL_ENCRYPT)
@@ -2591,6 +3314,8 @@ static void network_send_buffer(char *buffer, size_t buffer_len) /* {{{ */
       network_send_buffer_plain(se, buffer, buffer_len);
     pthread_mutex_unlock(&se->lock);
   } /* for (sending_sockets) */
+
+  send_packet_unref(packet);
 } /* }}} void network_send_buffer */
 
 static int add_to_buffer(char *buffer, size_t buffer_size, /* {{{ */
@@ -2833,6 +3558,29 @@ static int network_config_set_buffer_size(const oconfig_item_t *ci) /* {{{ */
   return 0;
 } /* }}} int network_config_set_buffer_size */
 
+static int network_config_set_receive_threads( /* {{{ */
+    const oconfig_item_t *ci) {
+  int tmp = 0;
+
+  if (cf_util_get_int(ci, &tmp) != 0)
+    return -1;
+  else if ((tmp >= 0) && (tmp <= 256))
+    network_config_receive_threads = (size_t)tmp;
+  else {
+    WARNING("network plugin: The `ReceiveThreads' must be between 0 and 256.");
+    return -1;
+  }
+
+#ifndef SO_REUSEPORT
+  if (network_config_receive_threads > 1)
+    WARNING("network plugin: The `SO_REUSEPORT' socket option is not "
+            "available on your system. All packets sent to one address will "
+            "be handled by the same receive thread.");
+#endif
+
+  return 0;
+} /* }}} int network_config_set_receive_threads */
+
 #if HAVE_GCRYPT_H
 static int network_config_set_security_level(oconfig_item_t *ci, /* {{{ */
                                              int *retval) {
@@ -3024,6 +3772,8 @@ static int network_config(oconfig_item_t *ci) /* {{{ */
     oconfig_item_t *child = ci->children + i;
     if (strcasecmp("TimeToLive", child->key) == 0)
       network_config_set_ttl(child);
+    else if (strcasecmp("ReceiveThreads", child->key) == 0)
+      network_config_set_receive_threads(child);
   }
 
   for (int i = 0; i < ci->children_num; i++) {
@@ -3033,7 +3783,8 @@ static int network_config(oconfig_item_t *ci) /* {{{ */
       network_config_add_listen(child);
     else if (strcasecmp("Server", child->key) == 0)
       network_config_add_server(child);
-    else if (strcasecmp("TimeToLive", child->key) == 0) {
+    else if ((strcasecmp("TimeToLive", child->key) == 0) ||
+             (strcasecmp("ReceiveThreads", child->key) == 0)) {
       /* Handled earlier */
     } else if (strcasecmp("MaxPacketSize", child->key) == 0)
       network_config_set_buffer_size(child);
@@ -3041,6 +3792,8 @@ static int network_config(oconfig_item_t *ci) /* {{{ */
       cf_util_get_boolean(child, &network_config_forward);
     else if (strcasecmp("ReportStats", child->key) == 0)
       cf_util_get_boolean(child, &network_config_stats);
+    else if (strcasecmp("SendThreads", child->key) == 0)
+      cf_util_get_boolean(child, &network_config_send_threads);
     else {
       WARNING("network plugin: Option `%s' is not allowed here.", child->key);
     }
@@ -3120,6 +3873,8 @@ static int network_notification(const notification_t *n,
 static int network_shutdown(void) {
   listen_loop++;
 
+  stop_receive_threads();
+
   /* Kill the listening thread */
   if (receive_thread_running != 0) {
     INFO("network plugin: Stopping receive thread.");
@@ -3146,6 +3901,8 @@ static int network_shutdown(void) {
 
   sfree(send_buffer);
 
+  stop_send_threads();
+
   for (sockent_t *se = sending_sockets; se != NULL; se = se->next)
     sockent_client_disconnect(se);
   sockent_destroy(sending_sockets);
@@ -3256,6 +4013,10 @@ static int network_init(void) {
                           /* user_data = */ NULL);
     plugin_register_notification("network", network_notification,
                                  /* user_data = */ NULL);
+
+    /* Servers without a send thread are sent to from the write threads. */
+    if (network_config_send_threads)
+      start_send_threads();
   }
 
   /* If no threads need to be started, return here. */
@@ -3263,6 +4024,9 @@ static int network_init(void) {
       ((dispatch_thread_running != 0) && (receive_thread_running != 0)))
     return 0;
 
+  if (network_config_receive_threads > 0)
+    return start_receive_threads();
+
   if (dispatch_thread_running == 0) {
     int status;
     status = plugin_thread_create(&dispatch_thread_id, dispatch_thread,
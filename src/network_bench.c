@@ -0,0 +1,174 @@
+/**
+ * collectd - src/network_bench.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/*
+ * Measures the throughput of the network plugin's packet parser. Build with
+ * "make bench_network" and run as "./bench_network [iterations]".
+ *
+ * The packets are encoded with add_to_buffer(), the function network_write()
+ * uses, from value lists of a few hosts with "interface" and "load" metrics.
+ * Each iteration parses all packets once with parse_packet(); the parsed value
+ * lists are dispatched to the mock library.
+ */
+
+#include "network.c" /* (sic) */
+
+#define VALUE_LISTS_NUM 2000
+#define PACKETS_MAX 1000
+
+static data_set_t ds_if_octets = {
+    .type = "if_octets",
+    .ds_num = 2,
+    .ds =
+        (data_source_t[]){
+            {"rx", DS_TYPE_DERIVE, 0, NAN},
+            {"tx", DS_TYPE_DERIVE, 0, NAN},
+        },
+};
+
+static data_set_t ds_load = {
+    .type = "load",
+    .ds_num = 3,
+    .ds =
+        (data_source_t[]){
+            {"shortterm", DS_TYPE_GAUGE, 0, 5000},
+            {"midterm", DS_TYPE_GAUGE, 0, 5000},
+            {"longterm", DS_TYPE_GAUGE, 0, 5000},
+        },
+};
+
+static uint8_t packets[PACKETS_MAX][1452];
+static size_t packets_size[PACKETS_MAX];
+static size_t packets_num;
+
+/* Encodes VALUE_LISTS_NUM value lists into as many packets as needed. */
+static int init_packets(void) {
+  value_list_t vl_def = {0};
+  cdtime_t t = TIME_T_TO_CDTIME_T(1480063672);
+
+  for (size_t i = 0; i < VALUE_LISTS_NUM; i++) {
+    value_t values[3];
+    value_list_t vl = {
+        .values = values,
+        .time = t + (cdtime_t)(i / 100),
+        .interval = MS_TO_CDTIME_T(10000),
+    };
+    snprintf(vl.host, sizeof(vl.host), "host%zu.example.com", i / 100);
+
+    data_set_t const *ds;
+    if (i % 2) {
+      ds = &ds_if_octets;
+      values[0].derive = 1234567890 + (derive_t)i;
+      values[1].derive = 987654321 + (derive_t)i;
+      vl.values_len = 2;
+      sstrncpy(vl.plugin, "interface", sizeof(vl.plugin));
+      snprintf(vl.plugin_instance, sizeof(vl.plugin_instance), "eth%zu",
+               (i / 2) % 8);
+    } else {
+      ds = &ds_load;
+      values[0].gauge = 0.37 * (double)i;
+      values[1].gauge = 1.0 / (double)(i + 3);
+      values[2].gauge = 2.25;
+      vl.values_len = 3;
+      sstrncpy(vl.plugin, "load", sizeof(vl.plugin));
+    }
+    sstrncpy(vl.type, ds->type, sizeof(vl.type));
+
+    while (42) {
+      if (packets_num >= PACKETS_MAX)
+        return -1;
+
+      uint8_t *packet = packets[packets_num];
+      size_t *size = packets_size + packets_num;
+      int status = add_to_buffer((char *)packet + *size,
+                                 sizeof(packets[0]) - *size, &vl_def, ds, &vl);
+      if (status > 0) {
+        *size += (size_t)status;
+        break;
+      }
+
+      /* The packet is full: start a new one, which repeats the identifier. */
+      if (*size == 0)
+        return -1;
+      packets_num++;
+      memset(&vl_def, 0, sizeof(vl_def));
+    }
+  }
+
+  packets_num++;
+  return 0;
+}
+
+static cdtime_t now(void) {
+  struct timespec ts = {0};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return TIMESPEC_TO_CDTIME_T(&ts);
+}
+
+int main(int argc, char **argv) {
+  size_t iterations = 2000;
+  if (argc > 1)
+    iterations = (size_t)strtoull(argv[1], NULL, 0);
+
+  if (init_packets() != 0) {
+    fprintf(stderr, "Encoding the packets failed.\n");
+    return 1;
+  }
+
+  sockent_t se = {
+      .data.server =
+          (struct sockent_server){
+#if HAVE_GCRYPT_H
+              .userdb = NULL,
+              .security_level = SECURITY_LEVEL_NONE,
+#endif
+          },
+  };
+
+  size_t bytes = 0;
+  derive_t values_before = stats_values_dispatched;
+  cdtime_t start = now();
+
+  for (size_t n = 0; n < iterations; n++) {
+    for (size_t i = 0; i < packets_num; i++) {
+      /* parse_packet() may modify the buffer when decrypting. */
+      uint8_t buffer[sizeof(packets[0])];
+      memcpy(buffer, packets[i], packets_size[i]);
+      parse_packet(&se, buffer, packets_size[i], 0, NULL, NULL);
+      bytes += packets_size[i];
+    }
+  }
+
+  double seconds = CDTIME_T_TO_DOUBLE(now() - start);
+  derive_t values = stats_values_dispatched - values_before;
+  if (values != (derive_t)(iterations * VALUE_LISTS_NUM)) {
+    fprintf(stderr, "Parsed %" PRIi64 " value lists, expected %zu.\n",
+            (int64_t)values, iterations * VALUE_LISTS_NUM);
+    return 1;
+  }
+
+  printf("parse_packet %10.0f value lists/s %8.1f MB/s (%zu packets)\n",
+         (double)values / seconds, (double)bytes / seconds / 1e6,
+         packets_num);
+  return 0;
+}
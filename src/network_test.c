@@ -228,7 +228,6 @@ DEF_TEST(parse_packet) {
       .data.server =
           (struct sockent_server){
 #if HAVE_GCRYPT_H
-              .cypher = NULL,
               .userdb = NULL,
               .security_level = SECURITY_LEVEL_NONE,
 #endif
@@ -28,6 +28,7 @@
 
 #include "plugin.h"
 #include "utils/common/common.h"
+#include "utils/rrdc_batch/rrdc_batch.h"
 #include "utils/rrdcreate/rrdcreate.h"
 
 #undef HAVE_CONFIG_H
@@ -41,6 +42,8 @@ static char *datadir;
 static char *daemon_address;
 static bool config_create_files = true;
 static bool config_collect_stats = true;
+static int config_batch_size = 1;
+static cdtime_t config_batch_timeout = TIME_T_TO_CDTIME_T_STATIC(1);
 static rrdcreate_config_t rrdcreate_config = {.stepsize = 0,
                                               .heartbeat = 0,
                                               .rrarows = 1200,
@@ -51,6 +54,15 @@ static rrdcreate_config_t rrdcreate_config = {.stepsize = 0,
                                               .consolidation_functions_num = 0,
                                               .async = 0};
 
+/* Used instead of rrdc_update() if "BatchSize" is greater than one. The batch
+ * thread sends batches that are older than "BatchTimeout". */
+static rrdc_batch_t *batch;
+static pthread_mutex_t batch_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t batch_cond = PTHREAD_COND_INITIALIZER;
+static pthread_t batch_thread;
+static bool batch_thread_running;
+static bool batch_shutdown;
+
 /*
  * Prototypes.
  */
@@ -230,7 +242,21 @@ static int rc_config(oconfig_item_t *ci) {
         status = rc_config_add_timespan(tmp);
     } else if (strcasecmp("XFF", key) == 0)
       status = rc_config_get_xff(child, &rrdcreate_config.xff);
-    else {
+    else if (strcasecmp("BatchSize", key) == 0) {
+      int tmp = -1;
+      status = rc_config_get_int_positive(child, &tmp);
+      if ((status == 0) && (tmp < 1))
+        status = EINVAL;
+      if (status == 0)
+        config_batch_size = tmp;
+    } else if (strcasecmp("BatchTimeout", key) == 0) {
+      cdtime_t tmp = 0;
+      status = cf_util_get_cdtime(child, &tmp);
+      if ((status == 0) && (tmp == 0))
+        status = EINVAL;
+      if (status == 0)
+        config_batch_timeout = tmp;
+    } else {
       WARNING("rrdcached plugin: Ignoring invalid option %s.", key);
       continue;
     }
@@ -362,10 +388,56 @@ static int rc_read(void) {
   return 0;
 } /* int rc_read */
 
+static void *rc_batch_thread(__attribute__((unused)) void *arg) /* {{{ */
+{
+  pthread_mutex_lock(&batch_lock);
+  while (!batch_shutdown) {
+    cdtime_t oldest = rrdc_batch_oldest(batch);
+    cdtime_t now = cdtime();
+
+    if ((oldest != 0) && ((now - oldest) >= config_batch_timeout)) {
+      rrdc_batch_send(batch);
+      continue;
+    }
+
+    /* Sleep until the oldest update times out. Updates added in the meantime
+     * are younger, so there is no need to wake up for them. */
+    cdtime_t wakeup = (oldest != 0) ? oldest + config_batch_timeout
+                                    : now + config_batch_timeout;
+    struct timespec ts = CDTIME_T_TO_TIMESPEC(wakeup);
+    pthread_cond_timedwait(&batch_cond, &batch_lock, &ts);
+  }
+
+  /* Send what is left before shutting down. */
+  rrdc_batch_send(batch);
+  pthread_mutex_unlock(&batch_lock);
+  return NULL;
+} /* }}} void *rc_batch_thread */
+
 static int rc_init(void) {
   if (config_collect_stats)
     plugin_register_read("rrdcached", rc_read);
 
+  if ((daemon_address != NULL) && (config_batch_size > 1) && (batch == NULL)) {
+    batch = rrdc_batch_create(daemon_address, (size_t)config_batch_size);
+    if (batch == NULL) {
+      ERROR("rrdcached plugin: rrdc_batch_create failed.");
+      return -1;
+    }
+
+    batch_shutdown = false;
+    int status = plugin_thread_create(&batch_thread, rc_batch_thread,
+                                      /* arg = */ NULL, "rrdcached batch");
+    if (status != 0) {
+      ERROR("rrdcached plugin: Starting the batch thread failed: %s",
+            STRERROR(status));
+      rrdc_batch_destroy(batch);
+      batch = NULL;
+      return -1;
+    }
+    batch_thread_running = true;
+  }
+
   return 0;
 } /* int rc_init */
 
@@ -416,6 +488,13 @@ static int rc_write(const data_set_t *ds, const value_list_t *vl,
     }
   }
 
+  if (batch != NULL) {
+    pthread_mutex_lock(&batch_lock);
+    status = rrdc_batch_add(batch, filename, values);
+    pthread_mutex_unlock(&batch_lock);
+    return (status == 0) ? 0 : -1;
+  }
+
   rrd_clear_error();
   status = rrdc_connect(daemon_address);
   if (status != 0) {
@@ -456,8 +535,17 @@ static int rc_write(const data_set_t *ds, const value_list_t *vl,
 static int rc_flush(__attribute__((unused)) cdtime_t timeout, /* {{{ */
                     const char *identifier,
                     __attribute__((unused)) user_data_t *ud) {
+  /* Updates must have reached the daemon before it can write them. */
+  if (batch != NULL) {
+    pthread_mutex_lock(&batch_lock);
+    int status = rrdc_batch_send(batch);
+    pthread_mutex_unlock(&batch_lock);
+    if (status != 0)
+      return -1;
+  }
+
   if (identifier == NULL)
-    return EINVAL;
+    return (batch != NULL) ? 0 : EINVAL;
 
   char filename[PATH_MAX + 1];
 
@@ -502,6 +590,18 @@ static int rc_flush(__attribute__((unused)) cdtime_t timeout, /* {{{ */
 } /* }}} int rc_flush */
 
 static int rc_shutdown(void) {
+  if (batch_thread_running) {
+    pthread_mutex_lock(&batch_lock);
+    batch_shutdown = true;
+    pthread_cond_signal(&batch_cond);
+    pthread_mutex_unlock(&batch_lock);
+
+    pthread_join(batch_thread, /* retval = */ NULL);
+    batch_thread_running = false;
+  }
+  rrdc_batch_destroy(batch);
+  batch = NULL;
+
   rrdc_disconnect();
   return 0;
 } /* int rc_shutdown */
@@ -43,6 +43,9 @@ typedef struct rrd_cache_s {
   cdtime_t last_value;
   int64_t random_variation;
   enum { FLAG_NONE = 0x00, FLAG_QUEUED = 0x01, FLAG_FLUSHQ = 0x02 } flags;
+  /* Location of the file, used to order the updates. */
+  dev_t dev;
+  ino_t ino;
 } rrd_cache_t;
 
 enum rrd_queue_dir_e { QUEUE_INSERT_FRONT, QUEUE_INSERT_BACK };
@@ -50,17 +53,49 @@ typedef enum rrd_queue_dir_e rrd_queue_dir_t;
 
 struct rrd_queue_s {
   char *filename;
+  dev_t dev;
+  ino_t ino;
+  cdtime_t queued;
   struct rrd_queue_s *next;
 };
 typedef struct rrd_queue_s rrd_queue_t;
 
+/* Files are assigned to write threads by the hash of their name, so each file
+ * is only ever updated by one thread. Every thread has its own queues and
+ * lock. */
+struct rrd_worker_s {
+  pthread_t thread;
+  bool thread_running;
+
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+  bool shutdown;
+
+  rrd_queue_t *queue_head;
+  rrd_queue_t *queue_tail;
+  size_t queue_num;
+  rrd_queue_t *flushq_head;
+  rrd_queue_t *flushq_tail;
+  size_t flushq_num;
+
+  /* Entries taken from the regular queue, sorted by their location on disk.
+   * The entries before "batch_pos" have already been handed out. */
+  rrd_queue_t **batch;
+  size_t batch_num;
+  size_t batch_pos;
+
+  uint64_t updates_num;
+};
+typedef struct rrd_worker_s rrd_worker_t;
+
 /*
  * Private variables
  */
 static const char *config_keys[] = {
-    "CacheTimeout", "CacheFlush",      "CreateFilesAsync", "DataDir",
-    "StepSize",     "HeartBeat",       "RRARows",          "RRATimespan",
-    "XFF",          "WritesPerSecond", "RandomTimeout"};
+    "CacheTimeout",  "CacheFlush",      "CreateFilesAsync", "DataDir",
+    "StepSize",      "HeartBeat",       "RRARows",          "RRATimespan",
+    "XFF",           "WritesPerSecond", "RandomTimeout",    "WriteThreads",
+    "CollectStatistics"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 /* If datadir is zero, the daemon's basedir is used. If stepsize or heartbeat
@@ -68,6 +103,8 @@ static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
  * being used. */
 static char *datadir;
 static double write_rate;
+static size_t write_threads_num = 1;
+static bool collect_statistics;
 static rrdcreate_config_t rrdcreate_config = {
     /* stepsize = */ 0,
     /* heartbeat = */ 0,
@@ -82,8 +119,8 @@ static rrdcreate_config_t rrdcreate_config = {
 
     /* async = */ 0};
 
-/* XXX: If you need to lock both, cache_lock and queue_lock, at the same time,
- * ALWAYS lock `cache_lock' first! */
+/* XXX: If you need to lock both, cache_lock and a worker's lock, at the same
+ * time, ALWAYS lock `cache_lock' first! */
 static cdtime_t cache_timeout;
 static cdtime_t cache_flush_timeout;
 static cdtime_t random_timeout;
@@ -91,14 +128,8 @@ static cdtime_t cache_flush_last;
 static c_avl_tree_t *cache;
 static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
 
-static rrd_queue_t *queue_head;
-static rrd_queue_t *queue_tail;
-static rrd_queue_t *flushq_head;
-static rrd_queue_t *flushq_tail;
-static pthread_t queue_thread;
-static int queue_thread_running = 1;
-static pthread_mutex_t queue_lock = PTHREAD_MUTEX_INITIALIZER;
-static pthread_cond_t queue_cond = PTHREAD_COND_INITIALIZER;
+static rrd_worker_t *workers;
+static size_t workers_num;
 
 #if !HAVE_THREADSAFE_LIBRRD
 static pthread_mutex_t librrd_lock = PTHREAD_MUTEX_INITIALIZER;
@@ -109,7 +140,8 @@ static int do_shutdown;
 #if HAVE_THREADSAFE_LIBRRD
 static int srrd_update(char *filename, char *template, int argc,
                        const char **argv) {
-  optind = 0; /* bug in librrd? */
+  /* Unlike rrd_update(), rrd_update_r() does not use getopt(3), so "optind"
+   * is left alone: it is shared by all write threads. */
   rrd_clear_error();
 
   int status = rrd_update_r(filename, template, argc, (void *)argv);
@@ -279,91 +311,137 @@ static int value_list_to_filename(char *buffer, size_t buffer_size,
   return 0;
 } /* int value_list_to_filename */
 
-static void *rrd_queue_thread(void __attribute__((unused)) * data) {
-  struct timeval tv_next_update;
-  struct timeval tv_now;
+/* 64 bit FNV-1a */
+static rrd_worker_t *rrd_worker_get(const char *filename) {
+  uint64_t hash = 14695981039346656037ULL;
 
-  gettimeofday(&tv_next_update, /* timezone = */ NULL);
+  for (const char *c = filename; *c != 0; c++) {
+    hash ^= (uint64_t)(unsigned char)*c;
+    hash *= 1099511628211ULL;
+  }
 
-  while (42) {
-    rrd_queue_t *queue_entry;
-    rrd_cache_t *cache_entry;
-    char **values;
-    int values_num;
-    int status;
+  return &workers[hash % workers_num];
+} /* rrd_worker_t *rrd_worker_get */
+
+/* Orders queue entries by device and inode. Inodes are allocated close to
+ * their directory on most file systems, so this approximates the order of the
+ * files on disk and reduces seeking. */
+static int rrd_queue_compare(const void *a_ptr, const void *b_ptr) {
+  rrd_queue_t const *a = *((rrd_queue_t *const *)a_ptr);
+  rrd_queue_t const *b = *((rrd_queue_t *const *)b_ptr);
+
+  if (a->dev != b->dev)
+    return (a->dev < b->dev) ? -1 : 1;
+  if (a->ino != b->ino)
+    return (a->ino < b->ino) ? -1 : 1;
+  return strcmp(a->filename, b->filename);
+} /* int rrd_queue_compare */
+
+/* Moves the regular queue to the batch of the worker and sorts it.
+ * XXX: You must hold the worker's lock when calling this function! */
+static int rrd_worker_fill_batch(rrd_worker_t *w) {
+  assert(w->batch_pos == w->batch_num);
+
+  sfree(w->batch);
+  w->batch_num = 0;
+  w->batch_pos = 0;
+
+  w->batch = calloc(w->queue_num, sizeof(*w->batch));
+  if (w->batch == NULL) {
+    ERROR("rrdtool plugin: calloc failed.");
+    return ENOMEM;
+  }
 
-    values = NULL;
-    values_num = 0;
+  while (w->queue_head != NULL) {
+    rrd_queue_t *queue_entry = w->queue_head;
+    w->queue_head = queue_entry->next;
+    queue_entry->next = NULL;
 
-    pthread_mutex_lock(&queue_lock);
-    /* Wait for values to arrive */
-    while (42) {
-      struct timespec ts_wait;
+    w->batch[w->batch_num] = queue_entry;
+    w->batch_num++;
+  }
+  assert(w->batch_num == w->queue_num);
+  w->queue_tail = NULL;
+  w->queue_num = 0;
 
-      while ((flushq_head == NULL) && (queue_head == NULL) &&
-             (do_shutdown == 0))
-        pthread_cond_wait(&queue_cond, &queue_lock);
+  qsort(w->batch, w->batch_num, sizeof(*w->batch), rrd_queue_compare);
+  return 0;
+} /* int rrd_worker_fill_batch */
 
-      if ((flushq_head == NULL) && (queue_head == NULL))
-        break;
+/* Returns the next queue entry to be written or NULL when shutting down.
+ * Flush requests are handled first and are not subject to "WritesPerSecond".
+ */
+static rrd_queue_t *rrd_worker_next(rrd_worker_t *w, cdtime_t next_update) {
+  rrd_queue_t *queue_entry = NULL;
 
-      /* Don't delay if there's something to flush */
-      if (flushq_head != NULL)
-        break;
+  pthread_mutex_lock(&w->lock);
+  /* Wait for values to arrive */
+  while (42) {
+    bool have_regular =
+        (w->batch_pos < w->batch_num) || (w->queue_head != NULL);
 
-      /* Don't delay if we're shutting down */
-      if (do_shutdown != 0)
-        break;
+    while ((w->flushq_head == NULL) && !have_regular && !w->shutdown) {
+      pthread_cond_wait(&w->cond, &w->lock);
+      have_regular = (w->batch_pos < w->batch_num) || (w->queue_head != NULL);
+    }
 
-      /* Don't delay if no delay was configured. */
-      if (write_rate <= 0.0)
-        break;
+    /* We're in the shutdown phase */
+    if ((w->flushq_head == NULL) && !have_regular)
+      break;
 
-      gettimeofday(&tv_now, /* timezone = */ NULL);
-      status = timeval_cmp(tv_next_update, tv_now, NULL);
-      /* We're good to go */
-      if (status <= 0)
-        break;
+    if (w->flushq_head != NULL) {
+      queue_entry = w->flushq_head;
+      w->flushq_head = queue_entry->next;
+      if (w->flushq_head == NULL)
+        w->flushq_tail = NULL;
+      w->flushq_num--;
+      break;
+    }
 
-      /* We're supposed to wait a bit with this update, so we'll
-       * wait for the next addition to the queue or to the end of
-       * the wait period - whichever comes first. */
-      ts_wait.tv_sec = tv_next_update.tv_sec;
-      ts_wait.tv_nsec = 1000 * tv_next_update.tv_usec;
+    /* Don't delay if we're shutting down or no delay was configured. */
+    cdtime_t now = cdtime();
+    if (!w->shutdown && (next_update > now)) {
+      /* We're supposed to wait a bit with this update, so we'll wait for the
+       * next flush request or to the end of the wait period - whichever
+       * comes first. */
+      struct timespec ts_wait = CDTIME_T_TO_TIMESPEC(next_update);
+      pthread_cond_timedwait(&w->cond, &w->lock, &ts_wait);
+      continue;
+    }
 
-      status = pthread_cond_timedwait(&queue_cond, &queue_lock, &ts_wait);
-      if (status == ETIMEDOUT)
-        break;
-    } /* while (42) */
+    if ((w->batch_pos == w->batch_num) && (rrd_worker_fill_batch(w) != 0))
+      break;
 
-    /* XXX: If you need to lock both, cache_lock and queue_lock, at
-     * the same time, ALWAYS lock `cache_lock' first! */
+    queue_entry = w->batch[w->batch_pos];
+    w->batch[w->batch_pos] = NULL;
+    w->batch_pos++;
+    break;
+  } /* while (42) */
+  pthread_mutex_unlock(&w->lock);
 
-    /* We're in the shutdown phase */
-    if ((flushq_head == NULL) && (queue_head == NULL)) {
-      pthread_mutex_unlock(&queue_lock);
-      break;
-    }
+  return queue_entry;
+} /* rrd_queue_t *rrd_worker_next */
 
-    if (flushq_head != NULL) {
-      /* Dequeue the first flush entry */
-      queue_entry = flushq_head;
-      if (flushq_head == flushq_tail)
-        flushq_head = flushq_tail = NULL;
-      else
-        flushq_head = flushq_head->next;
-    } else /* if (queue_head != NULL) */
-    {
-      /* Dequeue the first regular entry */
-      queue_entry = queue_head;
-      if (queue_head == queue_tail)
-        queue_head = queue_tail = NULL;
-      else
-        queue_head = queue_head->next;
-    }
+static void *rrd_queue_thread(void *data) {
+  rrd_worker_t *w = data;
+  cdtime_t next_update = 0;
+
+  /* "WritesPerSecond" is shared by all threads. */
+  cdtime_t write_interval = DOUBLE_TO_CDTIME_T(write_rate * workers_num);
 
-    /* Unlock the queue again */
-    pthread_mutex_unlock(&queue_lock);
+  while (42) {
+    rrd_queue_t *queue_entry;
+    rrd_cache_t *cache_entry;
+    char **values;
+    int values_num;
+    int status;
+
+    values = NULL;
+    values_num = 0;
+
+    queue_entry = rrd_worker_next(w, next_update);
+    if (queue_entry == NULL)
+      break;
 
     /* We now need the cache lock so the entry isn't updated while
      * we make a copy of its values */
@@ -382,29 +460,28 @@ static void *rrd_queue_thread(void __attribute__((unused)) * data) {
 
     pthread_mutex_unlock(&cache_lock);
 
-    if (status != 0) {
+    /* The entry may have been written already if it was flushed while
+     * being part of the batch. */
+    if ((status != 0) || (values_num == 0)) {
+      sfree(values);
       sfree(queue_entry->filename);
       sfree(queue_entry);
       continue;
     }
 
-    /* Update `tv_next_update' */
-    if (write_rate > 0.0) {
-      gettimeofday(&tv_now, /* timezone = */ NULL);
-      tv_next_update.tv_sec = tv_now.tv_sec;
-      tv_next_update.tv_usec =
-          tv_now.tv_usec + ((suseconds_t)(1000000 * write_rate));
-      while (tv_next_update.tv_usec > 1000000) {
-        tv_next_update.tv_sec++;
-        tv_next_update.tv_usec -= 1000000;
-      }
-    }
+    /* Update `next_update' */
+    if (write_interval > 0)
+      next_update = cdtime() + write_interval;
 
     /* Write the values to the RRD-file */
     srrd_update(queue_entry->filename, NULL, values_num, (const char **)values);
     DEBUG("rrdtool plugin: queue thread: Wrote %i value%s to %s", values_num,
           (values_num == 1) ? "" : "s", queue_entry->filename);
 
+    pthread_mutex_lock(&w->lock);
+    w->updates_num++;
+    pthread_mutex_unlock(&w->lock);
+
     for (int i = 0; i < values_num; i++) {
       sfree(values[i]);
     }
@@ -417,8 +494,10 @@ static void *rrd_queue_thread(void __attribute__((unused)) * data) {
   return (void *)0;
 } /* void *rrd_queue_thread */
 
-static int rrd_queue_enqueue(const char *filename, rrd_queue_t **head,
-                             rrd_queue_t **tail) {
+/* Appends filename to the regular or, if "flush" is true, the flush queue of
+ * the responsible worker. */
+static int rrd_queue_enqueue(const char *filename, rrd_cache_t const *rc,
+                             bool flush) {
   rrd_queue_t *queue_entry;
 
   queue_entry = malloc(sizeof(*queue_entry));
@@ -431,9 +510,16 @@ static int rrd_queue_enqueue(const char *filename, rrd_queue_t **head,
     return -1;
   }
 
+  queue_entry->dev = rc->dev;
+  queue_entry->ino = rc->ino;
+  queue_entry->queued = cdtime();
   queue_entry->next = NULL;
 
-  pthread_mutex_lock(&queue_lock);
+  rrd_worker_t *w = rrd_worker_get(filename);
+  rrd_queue_t **head = flush ? &w->flushq_head : &w->queue_head;
+  rrd_queue_t **tail = flush ? &w->flushq_tail : &w->queue_tail;
+
+  pthread_mutex_lock(&w->lock);
 
   if (*tail == NULL)
     *head = queue_entry;
@@ -441,21 +527,29 @@ static int rrd_queue_enqueue(const char *filename, rrd_queue_t **head,
     (*tail)->next = queue_entry;
   *tail = queue_entry;
 
-  pthread_cond_signal(&queue_cond);
-  pthread_mutex_unlock(&queue_lock);
+  if (flush)
+    w->flushq_num++;
+  else
+    w->queue_num++;
+
+  pthread_cond_signal(&w->cond);
+  pthread_mutex_unlock(&w->lock);
 
   return 0;
 } /* int rrd_queue_enqueue */
 
-static int rrd_queue_dequeue(const char *filename, rrd_queue_t **head,
-                             rrd_queue_t **tail) {
+/* Removes filename from the regular queue of the responsible worker. Returns
+ * non-zero if it is not queued, which includes entries that have been moved to
+ * the worker's batch. */
+static int rrd_queue_dequeue(const char *filename) {
   rrd_queue_t *this;
   rrd_queue_t *prev;
 
-  pthread_mutex_lock(&queue_lock);
+  rrd_worker_t *w = rrd_worker_get(filename);
+  pthread_mutex_lock(&w->lock);
 
   prev = NULL;
-  this = *head;
+  this = w->queue_head;
 
   while (this != NULL) {
     if (strcmp(this->filename, filename) == 0)
@@ -466,19 +560,20 @@ static int rrd_queue_dequeue(const char *filename, rrd_queue_t **head,
   }
 
   if (this == NULL) {
-    pthread_mutex_unlock(&queue_lock);
+    pthread_mutex_unlock(&w->lock);
     return -1;
   }
 
   if (prev == NULL)
-    *head = this->next;
+    w->queue_head = this->next;
   else
     prev->next = this->next;
 
   if (this->next == NULL)
-    *tail = prev;
+    w->queue_tail = prev;
+  w->queue_num--;
 
-  pthread_mutex_unlock(&queue_lock);
+  pthread_mutex_unlock(&w->lock);
 
   sfree(this->filename);
   sfree(this);
@@ -513,7 +608,7 @@ static void rrd_cache_flush(cdtime_t timeout) {
     else if (rc->values_num > 0) {
       int status;
 
-      status = rrd_queue_enqueue(key, &queue_head, &queue_tail);
+      status = rrd_queue_enqueue(key, rc, /* flush = */ false);
       if (status == 0)
         rc->flags = FLAG_QUEUED;
     } else /* ancient and no values -> waste of memory */
@@ -582,14 +677,14 @@ static int rrd_cache_flush_identifier(cdtime_t timeout,
   if (rc->flags == FLAG_FLUSHQ) {
     status = 0;
   } else if (rc->flags == FLAG_QUEUED) {
-    rrd_queue_dequeue(key, &queue_head, &queue_tail);
-    status = rrd_queue_enqueue(key, &flushq_head, &flushq_tail);
+    rrd_queue_dequeue(key);
+    status = rrd_queue_enqueue(key, rc, /* flush = */ true);
     if (status == 0)
       rc->flags = FLAG_FLUSHQ;
   } else if ((now - rc->first_value) < timeout) {
     status = 0;
   } else if (rc->values_num > 0) {
-    status = rrd_queue_enqueue(key, &flushq_head, &flushq_tail);
+    status = rrd_queue_enqueue(key, rc, /* flush = */ true);
     if (status == 0)
       rc->flags = FLAG_FLUSHQ;
   }
@@ -605,7 +700,7 @@ static int64_t rrd_get_random_variation(void) {
 } /* int64_t rrd_get_random_variation */
 
 static int rrd_cache_insert(const char *filename, const char *value,
-                            cdtime_t value_time) {
+                            cdtime_t value_time, struct stat const *statbuf) {
   rrd_cache_t *rc = NULL;
   int new_rc = 0;
   char **values_new;
@@ -670,6 +765,8 @@ static int rrd_cache_insert(const char *filename, const char *value,
   if (rc->values_num == 1)
     rc->first_value = value_time;
   rc->last_value = value_time;
+  rc->dev = statbuf->st_dev;
+  rc->ino = statbuf->st_ino;
 
   /* Insert if this is the first value */
   if (new_rc == 1) {
@@ -696,12 +793,12 @@ static int rrd_cache_insert(const char *filename, const char *value,
 
   if ((rc->last_value - rc->first_value) >=
       (cache_timeout + rc->random_variation)) {
-    /* XXX: If you need to lock both, cache_lock and queue_lock, at
+    /* XXX: If you need to lock both, cache_lock and a worker's lock, at
      * the same time, ALWAYS lock `cache_lock' first! */
     if (rc->flags == FLAG_NONE) {
       int status;
 
-      status = rrd_queue_enqueue(filename, &queue_head, &queue_tail);
+      status = rrd_queue_enqueue(filename, rc, /* flush = */ false);
       if (status == 0)
         rc->flags = FLAG_QUEUED;
 
@@ -820,7 +917,7 @@ static int rrd_write(const data_set_t *ds, const value_list_t *vl,
     return -1;
   }
 
-  return rrd_cache_insert(filename, values, vl->time);
+  return rrd_cache_insert(filename, values, vl->time, &statbuf);
 } /* int rrd_write */
 
 static int rrd_flush(cdtime_t timeout, const char *identifier,
@@ -966,6 +1063,18 @@ static int rrd_config(const char *key, const char *value) {
     } else {
       write_rate = 1.0 / wps;
     }
+  } else if (strcasecmp("WriteThreads", key) == 0) {
+    int tmp = atoi(value);
+    if (tmp < 1) {
+      fprintf(stderr, "rrdtool: `WriteThreads' must "
+                      "be greater than 0.\n");
+      ERROR("rrdtool: `WriteThreads' must "
+            "be greater than 0.");
+      return 1;
+    }
+    write_threads_num = (size_t)tmp;
+  } else if (strcasecmp("CollectStatistics", key) == 0) {
+    collect_statistics = IS_TRUE(value);
   } else if (strcasecmp("RandomTimeout", key) == 0) {
     double tmp;
 
@@ -984,31 +1093,100 @@ static int rrd_config(const char *key, const char *value) {
   return 0;
 } /* int rrd_config */
 
+static int rrd_read(void) {
+  size_t queue_num = 0;
+  cdtime_t oldest = 0;
+  uint64_t updates_num = 0;
+
+  for (size_t i = 0; i < workers_num; i++) {
+    rrd_worker_t *w = workers + i;
+
+    pthread_mutex_lock(&w->lock);
+    queue_num += w->queue_num + w->flushq_num + (w->batch_num - w->batch_pos);
+    updates_num += w->updates_num;
+
+    /* Both queues are in FIFO order, the batch is not. */
+    if ((w->queue_head != NULL) &&
+        ((oldest == 0) || (w->queue_head->queued < oldest)))
+      oldest = w->queue_head->queued;
+    if ((w->flushq_head != NULL) &&
+        ((oldest == 0) || (w->flushq_head->queued < oldest)))
+      oldest = w->flushq_head->queued;
+    for (size_t j = w->batch_pos; j < w->batch_num; j++) {
+      if ((oldest == 0) || (w->batch[j]->queued < oldest))
+        oldest = w->batch[j]->queued;
+    }
+    pthread_mutex_unlock(&w->lock);
+  }
+
+  cdtime_t now = cdtime();
+  value_list_t vl = VALUE_LIST_INIT;
+  vl.values = &(value_t){.gauge = (gauge_t)queue_num};
+  vl.values_len = 1;
+  vl.time = now;
+  sstrncpy(vl.plugin, "rrdtool", sizeof(vl.plugin));
+
+  sstrncpy(vl.type, "queue_length", sizeof(vl.type));
+  plugin_dispatch_values(&vl);
+
+  vl.values[0].gauge = ((oldest == 0) || (oldest > now))
+                           ? 0.0
+                           : CDTIME_T_TO_DOUBLE(now - oldest);
+  sstrncpy(vl.type, "duration", sizeof(vl.type));
+  sstrncpy(vl.type_instance, "oldest", sizeof(vl.type_instance));
+  plugin_dispatch_values(&vl);
+
+  vl.values[0].derive = (derive_t)updates_num;
+  sstrncpy(vl.type, "operations", sizeof(vl.type));
+  sstrncpy(vl.type_instance, "write-updates", sizeof(vl.type_instance));
+  plugin_dispatch_values(&vl);
+
+  return 0;
+} /* int rrd_read */
+
 static int rrd_shutdown(void) {
   pthread_mutex_lock(&cache_lock);
   rrd_cache_flush(0);
   pthread_mutex_unlock(&cache_lock);
 
-  pthread_mutex_lock(&queue_lock);
   do_shutdown = 1;
-  pthread_cond_signal(&queue_cond);
-  pthread_mutex_unlock(&queue_lock);
 
-  if ((queue_thread_running != 0) &&
-      ((queue_head != NULL) || (flushq_head != NULL))) {
-    INFO("rrdtool plugin: Shutting down the queue thread. "
+  bool have_values = false;
+  for (size_t i = 0; i < workers_num; i++) {
+    rrd_worker_t *w = workers + i;
+
+    pthread_mutex_lock(&w->lock);
+    w->shutdown = true;
+    if ((w->queue_head != NULL) || (w->flushq_head != NULL) ||
+        (w->batch_pos < w->batch_num))
+      have_values = true;
+    pthread_cond_signal(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+  }
+
+  if ((workers_num > 0) && have_values) {
+    INFO("rrdtool plugin: Shutting down the queue threads. "
          "This may take a while.");
-  } else if (queue_thread_running != 0) {
-    INFO("rrdtool plugin: Shutting down the queue thread.");
+  } else if (workers_num > 0) {
+    INFO("rrdtool plugin: Shutting down the queue threads.");
   }
 
   /* Wait for all the values to be written to disk before returning. */
-  if (queue_thread_running != 0) {
-    pthread_join(queue_thread, NULL);
-    memset(&queue_thread, 0, sizeof(queue_thread));
-    queue_thread_running = 0;
-    DEBUG("rrdtool plugin: queue_thread exited.");
+  for (size_t i = 0; i < workers_num; i++) {
+    rrd_worker_t *w = workers + i;
+
+    if (w->thread_running) {
+      pthread_join(w->thread, NULL);
+      w->thread_running = false;
+    }
+
+    sfree(w->batch);
+    pthread_mutex_destroy(&w->lock);
+    pthread_cond_destroy(&w->cond);
   }
+  sfree(workers);
+  workers_num = 0;
+  DEBUG("rrdtool plugin: queue threads exited.");
 
   rrd_cache_destroy();
 
@@ -1057,13 +1235,42 @@ static int rrd_init(void) {
 
   pthread_mutex_unlock(&cache_lock);
 
-  int status = plugin_thread_create(&queue_thread, rrd_queue_thread,
-                                    /* args = */ NULL, "rrdtool queue");
-  if (status != 0) {
-    ERROR("rrdtool plugin: Cannot create queue-thread.");
+#if !HAVE_THREADSAFE_LIBRRD
+  if (write_threads_num > 1) {
+    WARNING("rrdtool plugin: librrd is not thread-safe, using one write "
+            "thread instead of %" PRIsz ".",
+            write_threads_num);
+    write_threads_num = 1;
+  }
+#endif
+
+  workers = calloc(write_threads_num, sizeof(*workers));
+  if (workers == NULL) {
+    ERROR("rrdtool plugin: calloc failed.");
     return -1;
   }
-  queue_thread_running = 1;
+  workers_num = write_threads_num;
+
+  for (size_t i = 0; i < workers_num; i++) {
+    pthread_mutex_init(&workers[i].lock, /* attr = */ NULL);
+    pthread_cond_init(&workers[i].cond, /* attr = */ NULL);
+  }
+
+  for (size_t i = 0; i < workers_num; i++) {
+    char name[16];
+    ssnprintf(name, sizeof(name), "rrdtool queue#%" PRIsz, i);
+
+    int status = plugin_thread_create(&workers[i].thread, rrd_queue_thread,
+                                      workers + i, name);
+    if (status != 0) {
+      ERROR("rrdtool plugin: Cannot create queue-thread.");
+      return -1;
+    }
+    workers[i].thread_running = true;
+  }
+
+  if (collect_statistics)
+    plugin_register_read("rrdtool", rrd_read);
 
   DEBUG("rrdtool plugin: rrd_init: datadir = %s; stepsize = %lu;"
         " heartbeat = %i; rrarows = %i; xff = %lf;",
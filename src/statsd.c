@@ -24,16 +24,23 @@
  *   Florian octo Forster <octo at collectd.org>
  */
 
+#define _GNU_SOURCE /* For recvmmsg(2) */
+
 #include "collectd.h"
 
 #include "plugin.h"
 #include "utils/avltree/avltree.h"
 #include "utils/common/common.h"
+#include "utils/ddsketch/ddsketch.h"
 #include "utils/latency/latency.h"
 
+#include <fcntl.h>
 #include <netdb.h>
 #include <poll.h>
+#include <sched.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/un.h>
 
 /* AIX doesn't have MSG_DONTWAIT */
 #ifndef MSG_DONTWAIT
@@ -48,28 +55,137 @@
 #define STATSD_DEFAULT_SERVICE "8125"
 #endif
 
+#ifndef STATSD_DEFAULT_PACKET_SIZE
+#define STATSD_DEFAULT_PACKET_SIZE 4095
+#endif
+
+/* Number of datagrams read with one recvmmsg(2) call. */
+#ifndef STATSD_RECEIVE_BATCH_SIZE
+#define STATSD_RECEIVE_BATCH_SIZE 32
+#endif
+
 enum metric_type_e { STATSD_COUNTER, STATSD_TIMER, STATSD_GAUGE, STATSD_SET };
 typedef enum metric_type_e metric_type_t;
 
+/* Latencies of a timer. Depending on the "TimerBackend" option they are
+ * counted by a latency_counter_t or a ddsketch_t; the other one stays NULL. */
+typedef struct {
+  latency_counter_t *latency;
+  ddsketch_t *sketch;
+} statsd_timer_t;
+
 struct statsd_metric_s {
   metric_type_t type;
   double value;
   derive_t counter;
-  latency_counter_t *latency;
+  statsd_timer_t timer;
   c_avl_tree_t *set;
   unsigned long updates_num;
 };
 typedef struct statsd_metric_s statsd_metric_t;
 
+/* Updates received for one metric during the current interval. Counter
+ * increments are summed up in `value'. For gauges, `value' holds the value set
+ * last, if `value_set' is true, plus all increments received after that. */
+typedef struct {
+  uint64_t hash;
+  metric_type_t type;
+  char name[DATA_MAX_NAME_LEN];
+
+  double value;
+  bool value_set;
+  statsd_timer_t timer;
+  c_avl_tree_t *set;
+  unsigned long updates_num;
+} statsd_update_t;
+
+typedef struct {
+  uint64_t hash;
+  statsd_update_t *update; /* NULL if the slot is empty. */
+} statsd_slot_t;
+
+/* Open addressing hash table with linear probing, holding the updates of one
+ * interval. */
+#define STATSD_TABLE_MIN_SLOTS 64
+typedef struct {
+  statsd_slot_t *slots;
+  size_t slots_num; /* zero or a power of two */
+  size_t updates_num;
+} statsd_table_t;
+
+/* Every receiving thread writes to its own table without taking a lock. When
+ * the metrics are read, the table is exchanged for the spare one and merged
+ * into metrics_tree. `in_use' is set to the table a thread is writing to, so
+ * the reader can wait for the thread to let go of the exchanged table. */
+typedef struct {
+  statsd_table_t *active;
+  statsd_table_t *in_use;
+  statsd_table_t *spare;
+} statsd_ingest_t;
+
+/* Aggregated metrics, keyed by a prefixed name such as "c:name". Only accessed
+ * when reading and shutting down. */
 static c_avl_tree_t *metrics_tree;
 static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER;
 
-static pthread_t network_thread;
-static bool network_thread_running;
+/* Counters of one kind of listener, shared by all receiving threads. */
+typedef struct {
+  char const *name;
+  uint64_t received;
+  uint64_t truncated;
+  uint64_t parse_failed;
+} statsd_listener_stats_t;
+
+enum { STATSD_UDP, STATSD_TCP, STATSD_UNIX, STATSD_LISTENERS_NUM };
+static statsd_listener_stats_t listener_stats[STATSD_LISTENERS_NUM] = {
+    [STATSD_UDP] = {.name = "udp"},
+    [STATSD_TCP] = {.name = "tcp"},
+    [STATSD_UNIX] = {.name = "unix"},
+};
+
+typedef struct {
+  int fd;
+  statsd_listener_stats_t *stats;
+  bool listening; /* TCP listening socket */
+  bool shared;    /* polled by all receiving threads */
+
+  /* Partial line of a TCP connection; NULL for other sockets. */
+  char *buffer;
+  size_t fill;
+  bool discard; /* skip up to the next newline */
+} statsd_socket_t;
+
+/* A receiving thread with its sockets and update tables. `pollfd' and
+ * `sockets' are parallel arrays. */
+typedef struct {
+  pthread_t thread;
+  bool thread_running;
+  statsd_ingest_t ingest;
+
+  struct pollfd *pollfd;
+  statsd_socket_t *sockets;
+  size_t sockets_num;
+
+  char *buffers; /* STATSD_RECEIVE_BATCH_SIZE datagrams */
+} statsd_receiver_t;
+
+static statsd_receiver_t *receivers;
+static size_t receivers_num;
+
+/* Sockets polled by all receiving threads. */
+static int *shared_fds;
+static size_t shared_fds_num;
+
 static bool network_thread_shutdown;
 
 static char *conf_node;
 static char *conf_service;
+static size_t conf_receive_threads = 1;
+static size_t conf_max_packet_size = STATSD_DEFAULT_PACKET_SIZE;
+static bool conf_listen_tcp;
+static char *conf_unix_socket;
+static int conf_unix_socket_perms = S_IRWXU | S_IRWXG;
+static bool conf_collect_stats;
 
 static bool conf_delete_counters;
 static bool conf_delete_timers;
@@ -78,6 +194,8 @@ static bool conf_delete_sets;
 
 static double *conf_timer_percentile;
 static size_t conf_timer_percentile_num;
+static bool conf_timer_sketch;
+static double conf_timer_accuracy = DDSKETCH_DEFAULT_ACCURACY;
 
 static bool conf_counter_sum;
 static bool conf_timer_lower;
@@ -85,6 +203,105 @@ static bool conf_timer_upper;
 static bool conf_timer_sum;
 static bool conf_timer_count;
 
+/* The percentiles of the timer being submitted. Protected by metrics_lock. */
+static double *timer_percentile_values;
+
+static int statsd_timer_add(statsd_timer_t *t, double value_ms) /* {{{ */
+{
+  if (conf_timer_sketch) {
+    if (t->sketch == NULL)
+      t->sketch =
+          ddsketch_create(conf_timer_accuracy, DDSKETCH_DEFAULT_MAX_BUCKETS);
+    if (t->sketch == NULL)
+      return -1;
+
+    ddsketch_add(t->sketch, value_ms / 1000.0);
+    return 0;
+  }
+
+  if (t->latency == NULL)
+    t->latency = latency_counter_create();
+  if (t->latency == NULL)
+    return -1;
+
+  latency_counter_add(t->latency, MS_TO_CDTIME_T(value_ms));
+  return 0;
+} /* }}} int statsd_timer_add */
+
+static int statsd_timer_merge(statsd_timer_t *dst, /* {{{ */
+                              statsd_timer_t const *src) {
+  if (src->sketch != NULL) {
+    if (dst->sketch == NULL)
+      dst->sketch =
+          ddsketch_create(conf_timer_accuracy, DDSKETCH_DEFAULT_MAX_BUCKETS);
+    if (dst->sketch == NULL)
+      return -1;
+
+    int status = ddsketch_merge(dst->sketch, src->sketch);
+    if (status != 0)
+      return status;
+  }
+
+  if (src->latency != NULL) {
+    if (dst->latency == NULL)
+      dst->latency = latency_counter_create();
+    if (dst->latency == NULL)
+      return -1;
+
+    int status = latency_counter_merge(dst->latency, src->latency);
+    if (status != 0)
+      return status;
+  }
+
+  return 0;
+} /* }}} int statsd_timer_merge */
+
+static void statsd_timer_reset(statsd_timer_t *t) /* {{{ */
+{
+  latency_counter_reset(t->latency);
+  ddsketch_reset(t->sketch);
+} /* }}} void statsd_timer_reset */
+
+static void statsd_timer_destroy(statsd_timer_t *t) /* {{{ */
+{
+  latency_counter_destroy(t->latency);
+  t->latency = NULL;
+  ddsketch_destroy(t->sketch);
+  t->sketch = NULL;
+} /* }}} void statsd_timer_destroy */
+
+static double statsd_timer_count(statsd_timer_t const *t) /* {{{ */
+{
+  if (t->sketch != NULL)
+    return (double)ddsketch_count(t->sketch);
+  return (double)latency_counter_get_num(t->latency);
+} /* }}} double statsd_timer_count */
+
+/* Returns the average, minimum, maximum and sum of the latencies in seconds
+ * and stores the configured percentiles in timer_percentile_values. With the
+ * sketch backend, all percentiles are estimated in a single pass. */
+static void statsd_timer_summarize(statsd_timer_t const *t, /* {{{ */
+                                   double *average, double *lower,
+                                   double *upper, double *sum) {
+  if (t->sketch != NULL) {
+    *average = ddsketch_average(t->sketch);
+    *lower = ddsketch_min(t->sketch);
+    *upper = ddsketch_max(t->sketch);
+    *sum = ddsketch_sum(t->sketch);
+    ddsketch_percentiles(t->sketch, conf_timer_percentile,
+                         timer_percentile_values, conf_timer_percentile_num);
+    return;
+  }
+
+  *average = CDTIME_T_TO_DOUBLE(latency_counter_get_average(t->latency));
+  *lower = CDTIME_T_TO_DOUBLE(latency_counter_get_min(t->latency));
+  *upper = CDTIME_T_TO_DOUBLE(latency_counter_get_max(t->latency));
+  *sum = CDTIME_T_TO_DOUBLE(latency_counter_get_sum(t->latency));
+  for (size_t i = 0; i < conf_timer_percentile_num; i++)
+    timer_percentile_values[i] = CDTIME_T_TO_DOUBLE(
+        latency_counter_get_percentile(t->latency, conf_timer_percentile[i]));
+} /* }}} void statsd_timer_summarize */
+
 /* Must hold metrics_lock when calling this function. */
 static statsd_metric_t *statsd_metric_lookup_unsafe(char const *name, /* {{{ */
                                                     metric_type_t type) {
@@ -131,7 +348,6 @@ static statsd_metric_t *statsd_metric_lookup_unsafe(char const *name, /* {{{ */
   }
 
   metric->type = type;
-  metric->latency = NULL;
   metric->set = NULL;
 
   status = c_avl_insert(metrics_tree, key_copy, metric);
@@ -145,55 +361,12 @@ static statsd_metric_t *statsd_metric_lookup_unsafe(char const *name, /* {{{ */
   return metric;
 } /* }}} statsd_metric_lookup_unsafe */
 
-static int statsd_metric_set(char const *name, double value, /* {{{ */
-                             metric_type_t type) {
-  statsd_metric_t *metric;
-
-  pthread_mutex_lock(&metrics_lock);
-
-  metric = statsd_metric_lookup_unsafe(name, type);
-  if (metric == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
-    return -1;
-  }
-
-  metric->value = value;
-  metric->updates_num++;
-
-  pthread_mutex_unlock(&metrics_lock);
-
-  return 0;
-} /* }}} int statsd_metric_set */
-
-static int statsd_metric_add(char const *name, double delta, /* {{{ */
-                             metric_type_t type) {
-  statsd_metric_t *metric;
-
-  pthread_mutex_lock(&metrics_lock);
-
-  metric = statsd_metric_lookup_unsafe(name, type);
-  if (metric == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
-    return -1;
-  }
-
-  metric->value += delta;
-  metric->updates_num++;
-
-  pthread_mutex_unlock(&metrics_lock);
-
-  return 0;
-} /* }}} int statsd_metric_add */
-
 static void statsd_metric_free(statsd_metric_t *metric) /* {{{ */
 {
   if (metric == NULL)
     return;
 
-  if (metric->latency != NULL) {
-    latency_counter_destroy(metric->latency);
-    metric->latency = NULL;
-  }
+  statsd_timer_destroy(&metric->timer);
 
   if (metric->set != NULL) {
     void *key;
@@ -222,8 +395,176 @@ static int statsd_parse_value(char const *str, value_t *ret_value) /* {{{ */
   return 0;
 } /* }}} int statsd_parse_value */
 
-static int statsd_handle_counter(char const *name, /* {{{ */
-                                 char const *value_str, char const *extra) {
+static uint64_t statsd_hash(metric_type_t type, char const *name) /* {{{ */
+{
+  /* 64 bit FNV-1a over the type and the name, as stored in the update. */
+  uint64_t hash = 14695981039346656037ULL;
+
+  hash = (hash ^ (uint64_t)type) * 1099511628211ULL;
+  for (size_t i = 0; (i < DATA_MAX_NAME_LEN - 1) && (name[i] != 0); i++)
+    hash = (hash ^ (uint64_t)(unsigned char)name[i]) * 1099511628211ULL;
+
+  return hash;
+} /* }}} uint64_t statsd_hash */
+
+/* Returns the index of the slot holding the update or, if there is none, of
+ * the empty slot where it would be inserted. The table must have at least one
+ * slot. Names are compared with the same truncation applied when storing
+ * them. */
+static size_t statsd_table_find(statsd_table_t const *t, /* {{{ */
+                                uint64_t hash, metric_type_t type,
+                                char const *name) {
+  size_t mask = t->slots_num - 1;
+  size_t idx = (size_t)hash & mask;
+
+  while (t->slots[idx].update != NULL) {
+    statsd_update_t const *u = t->slots[idx].update;
+    if ((t->slots[idx].hash == hash) && (u->type == type) &&
+        (strncmp(u->name, name, sizeof(u->name) - 1) == 0))
+      break;
+    idx = (idx + 1) & mask;
+  }
+
+  return idx;
+} /* }}} size_t statsd_table_find */
+
+/* Moves all updates into a new slot array with `slots_num' slots. */
+static int statsd_table_rehash(statsd_table_t *t, size_t slots_num) /* {{{ */
+{
+  statsd_slot_t *slots = calloc(slots_num, sizeof(*slots));
+  if (slots == NULL)
+    return ENOMEM;
+
+  for (size_t i = 0; i < t->slots_num; i++) {
+    if (t->slots[i].update == NULL)
+      continue;
+
+    size_t idx = (size_t)t->slots[i].hash & (slots_num - 1);
+    while (slots[idx].update != NULL)
+      idx = (idx + 1) & (slots_num - 1);
+    slots[idx] = t->slots[i];
+  }
+
+  free(t->slots);
+  t->slots = slots;
+  t->slots_num = slots_num;
+  return 0;
+} /* }}} int statsd_table_rehash */
+
+/* Returns the update for the metric, creating it if necessary. */
+static statsd_update_t *statsd_table_get(statsd_table_t *t, /* {{{ */
+                                         char const *name,
+                                         metric_type_t type) {
+  uint64_t hash = statsd_hash(type, name);
+
+  if (t->slots_num != 0) {
+    size_t idx = statsd_table_find(t, hash, type, name);
+    if (t->slots[idx].update != NULL)
+      return t->slots[idx].update;
+  }
+
+  /* Keep the load factor at or below 3/4. */
+  if (4 * (t->updates_num + 1) > 3 * t->slots_num) {
+    size_t slots_num = 2 * t->slots_num;
+    if (slots_num < STATSD_TABLE_MIN_SLOTS)
+      slots_num = STATSD_TABLE_MIN_SLOTS;
+    if (statsd_table_rehash(t, slots_num) != 0) {
+      ERROR("statsd plugin: Growing the update table failed.");
+      return NULL;
+    }
+  }
+
+  statsd_update_t *u = calloc(1, sizeof(*u));
+  if (u == NULL) {
+    ERROR("statsd plugin: calloc failed.");
+    return NULL;
+  }
+  u->hash = hash;
+  u->type = type;
+  sstrncpy(u->name, name, sizeof(u->name));
+
+  size_t idx = statsd_table_find(t, hash, type, name);
+  t->slots[idx] = (statsd_slot_t){.hash = hash, .update = u};
+  t->updates_num++;
+
+  return u;
+} /* }}} statsd_update_t *statsd_table_get */
+
+static void statsd_update_free(statsd_update_t *u) /* {{{ */
+{
+  if (u == NULL)
+    return;
+
+  statsd_timer_destroy(&u->timer);
+
+  if (u->set != NULL) {
+    void *key;
+    void *value;
+
+    while (c_avl_pick(u->set, &key, &value) == 0)
+      sfree(key);
+    c_avl_destroy(u->set);
+  }
+
+  sfree(u);
+} /* }}} void statsd_update_free */
+
+static statsd_table_t *statsd_table_create(void) /* {{{ */
+{
+  return calloc(1, sizeof(statsd_table_t));
+} /* }}} statsd_table_t *statsd_table_create */
+
+static void statsd_table_destroy(statsd_table_t *t) /* {{{ */
+{
+  if (t == NULL)
+    return;
+
+  for (size_t i = 0; i < t->slots_num; i++)
+    statsd_update_free(t->slots[i].update);
+  sfree(t->slots);
+  sfree(t);
+} /* }}} void statsd_table_destroy */
+
+/* Returns the table the calling thread may write to until it calls
+ * statsd_ingest_release(). */
+static statsd_table_t *statsd_ingest_acquire(statsd_ingest_t *in) /* {{{ */
+{
+  statsd_table_t *t;
+
+  /* Announce the table before using it and make sure it has not been
+   * exchanged in the meantime; statsd_ingest_swap() checks `in_use' after
+   * exchanging `active'. */
+  do {
+    t = __atomic_load_n(&in->active, __ATOMIC_SEQ_CST);
+    __atomic_store_n(&in->in_use, t, __ATOMIC_SEQ_CST);
+  } while (t != __atomic_load_n(&in->active, __ATOMIC_SEQ_CST));
+
+  return t;
+} /* }}} statsd_table_t *statsd_ingest_acquire */
+
+static void statsd_ingest_release(statsd_ingest_t *in) /* {{{ */
+{
+  __atomic_store_n(&in->in_use, NULL, __ATOMIC_RELEASE);
+} /* }}} void statsd_ingest_release */
+
+/* Makes the spare table active and returns the previously active one, once no
+ * thread is writing to it any more. */
+static statsd_table_t *statsd_ingest_swap(statsd_ingest_t *in) /* {{{ */
+{
+  statsd_table_t *t =
+      __atomic_exchange_n(&in->active, in->spare, __ATOMIC_SEQ_CST);
+  in->spare = NULL;
+
+  /* Parsing a buffer takes microseconds; yield until the thread is done. */
+  while (__atomic_load_n(&in->in_use, __ATOMIC_SEQ_CST) == t)
+    sched_yield();
+
+  return t;
+} /* }}} statsd_table_t *statsd_ingest_swap */
+
+static int statsd_handle_counter(statsd_table_t *t, /* {{{ */
+                                 char const *name, char const *value_str,
+                                 char const *extra) {
   value_t value;
   value_t scale;
   int status;
@@ -246,14 +587,20 @@ static int statsd_handle_counter(char const *name, /* {{{ */
   if (status != 0)
     return status;
 
-  /* Changes to the counter are added to (statsd_metric_t*)->value. ->counter is
-   * only updated in statsd_metric_submit_unsafe(). */
-  return statsd_metric_add(name, (double)(value.gauge / scale.gauge),
-                           STATSD_COUNTER);
+  statsd_update_t *u = statsd_table_get(t, name, STATSD_COUNTER);
+  if (u == NULL)
+    return -1;
+
+  /* Changes to the counter are added to (statsd_metric_t*)->value when the
+   * update is merged. ->counter is only updated in
+   * statsd_metric_submit_unsafe(). */
+  u->value += (double)(value.gauge / scale.gauge);
+  u->updates_num++;
+  return 0;
 } /* }}} int statsd_handle_counter */
 
-static int statsd_handle_gauge(char const *name, /* {{{ */
-                               char const *value_str) {
+static int statsd_handle_gauge(statsd_table_t *t, /* {{{ */
+                               char const *name, char const *value_str) {
   value_t value;
   int status;
 
@@ -262,18 +609,25 @@ static int statsd_handle_gauge(char const *name, /* {{{ */
   if (status != 0)
     return status;
 
+  statsd_update_t *u = statsd_table_get(t, name, STATSD_GAUGE);
+  if (u == NULL)
+    return -1;
+
   if ((value_str[0] == '+') || (value_str[0] == '-'))
-    return statsd_metric_add(name, (double)value.gauge, STATSD_GAUGE);
-  else
-    return statsd_metric_set(name, (double)value.gauge, STATSD_GAUGE);
+    u->value += (double)value.gauge;
+  else {
+    u->value = (double)value.gauge;
+    u->value_set = true;
+  }
+  u->updates_num++;
+  return 0;
 } /* }}} int statsd_handle_gauge */
 
-static int statsd_handle_timer(char const *name, /* {{{ */
-                               char const *value_str, char const *extra) {
-  statsd_metric_t *metric;
+static int statsd_handle_timer(statsd_table_t *t, /* {{{ */
+                               char const *name, char const *value_str,
+                               char const *extra) {
   value_t value_ms;
   value_t scale;
-  cdtime_t value;
   int status;
 
   if ((extra != NULL) && (extra[0] != '@'))
@@ -294,64 +648,44 @@ static int statsd_handle_timer(char const *name, /* {{{ */
   if (status != 0)
     return status;
 
-  value = MS_TO_CDTIME_T(value_ms.gauge / scale.gauge);
-
-  pthread_mutex_lock(&metrics_lock);
-
-  metric = statsd_metric_lookup_unsafe(name, STATSD_TIMER);
-  if (metric == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
+  statsd_update_t *u = statsd_table_get(t, name, STATSD_TIMER);
+  if (u == NULL)
     return -1;
-  }
 
-  if (metric->latency == NULL)
-    metric->latency = latency_counter_create();
-  if (metric->latency == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
-    return -1;
-  }
-
-  latency_counter_add(metric->latency, value);
-  metric->updates_num++;
+  status = statsd_timer_add(&u->timer, value_ms.gauge / scale.gauge);
+  if (status != 0)
+    return status;
 
-  pthread_mutex_unlock(&metrics_lock);
+  u->updates_num++;
   return 0;
 } /* }}} int statsd_handle_timer */
 
-static int statsd_handle_set(char const *name, /* {{{ */
-                             char const *set_key_orig) {
-  statsd_metric_t *metric = NULL;
+static int statsd_handle_set(statsd_table_t *t, /* {{{ */
+                             char const *name, char const *set_key_orig) {
   char *set_key;
   int status;
 
-  pthread_mutex_lock(&metrics_lock);
-
-  metric = statsd_metric_lookup_unsafe(name, STATSD_SET);
-  if (metric == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
+  statsd_update_t *u = statsd_table_get(t, name, STATSD_SET);
+  if (u == NULL)
     return -1;
-  }
 
-  /* Make sure metric->set exists. */
-  if (metric->set == NULL)
-    metric->set = c_avl_create((int (*)(const void *, const void *))strcmp);
+  /* Make sure u->set exists. */
+  if (u->set == NULL)
+    u->set = c_avl_create((int (*)(const void *, const void *))strcmp);
 
-  if (metric->set == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
+  if (u->set == NULL) {
     ERROR("statsd plugin: c_avl_create failed.");
     return -1;
   }
 
   set_key = strdup(set_key_orig);
   if (set_key == NULL) {
-    pthread_mutex_unlock(&metrics_lock);
     ERROR("statsd plugin: strdup failed.");
     return -1;
   }
 
-  status = c_avl_insert(metric->set, set_key, /* value = */ NULL);
+  status = c_avl_insert(u->set, set_key, /* value = */ NULL);
   if (status < 0) {
-    pthread_mutex_unlock(&metrics_lock);
     ERROR("statsd plugin: c_avl_insert (\"%s\") failed with status %i.",
           set_key, status);
     sfree(set_key);
@@ -361,13 +695,11 @@ static int statsd_handle_set(char const *name, /* {{{ */
     sfree(set_key);
   }
 
-  metric->updates_num++;
-
-  pthread_mutex_unlock(&metrics_lock);
+  u->updates_num++;
   return 0;
 } /* }}} int statsd_handle_set */
 
-static int statsd_parse_line(char *buffer) /* {{{ */
+static int statsd_parse_line(statsd_table_t *t, char *buffer) /* {{{ */
 {
   char *name = buffer;
   char *value;
@@ -393,24 +725,28 @@ static int statsd_parse_line(char *buffer) /* {{{ */
   }
 
   if (strcmp("c", type) == 0)
-    return statsd_handle_counter(name, value, extra);
+    return statsd_handle_counter(t, name, value, extra);
   else if (strcmp("ms", type) == 0)
-    return statsd_handle_timer(name, value, extra);
+    return statsd_handle_timer(t, name, value, extra);
 
   /* extra is only valid for counters and timers */
   if (extra != NULL)
     return -1;
 
   if (strcmp("g", type) == 0)
-    return statsd_handle_gauge(name, value);
+    return statsd_handle_gauge(t, name, value);
   else if (strcmp("s", type) == 0)
-    return statsd_handle_set(name, value);
+    return statsd_handle_set(t, name, value);
   else
     return -1;
 } /* }}} void statsd_parse_line */
 
-static void statsd_parse_buffer(char *buffer) /* {{{ */
-{
+/* Parses all lines in `buffer' and adds them to the listener's counters. */
+static void statsd_parse_buffer(statsd_table_t *t, /* {{{ */
+                                statsd_listener_stats_t *stats, char *buffer) {
+  uint64_t received = 0;
+  uint64_t parse_failed = 0;
+
   while (buffer != NULL) {
     char orig[64];
     char *next;
@@ -428,42 +764,277 @@ static void statsd_parse_buffer(char *buffer) /* {{{ */
     }
 
     sstrncpy(orig, buffer, sizeof(orig));
+    received++;
 
-    status = statsd_parse_line(buffer);
-    if (status != 0)
+    status = statsd_parse_line(t, buffer);
+    if (status != 0) {
       ERROR("statsd plugin: Unable to parse line: \"%s\"", orig);
+      parse_failed++;
+    }
 
     buffer = next;
   }
+
+  __atomic_fetch_add(&stats->received, received, __ATOMIC_RELAXED);
+  if (parse_failed > 0)
+    __atomic_fetch_add(&stats->parse_failed, parse_failed, __ATOMIC_RELAXED);
 } /* }}} void statsd_parse_buffer */
 
-static void statsd_network_read(int fd) /* {{{ */
-{
-  char buffer[4096];
-  size_t buffer_size;
-  ssize_t status;
+/* Reads up to STATSD_RECEIVE_BATCH_SIZE datagrams from `fd' without blocking.
+ * Returns the number of datagrams read or a negative errno value. The lengths
+ * are stored in `lengths'; truncated datagrams are flagged in `truncated'. */
+static int statsd_receive_batch(int fd, char *buffers, /* {{{ */
+                                size_t *lengths, bool *truncated) {
+#if HAVE_RECVMMSG
+  struct mmsghdr msgs[STATSD_RECEIVE_BATCH_SIZE];
+  struct iovec iovs[STATSD_RECEIVE_BATCH_SIZE];
+
+  memset(msgs, 0, sizeof(msgs));
+  for (size_t i = 0; i < STATSD_RECEIVE_BATCH_SIZE; i++) {
+    iovs[i] = (struct iovec){
+        .iov_base = buffers + (i * (conf_max_packet_size + 1)),
+        .iov_len = conf_max_packet_size,
+    };
+    msgs[i].msg_hdr = (struct msghdr){
+        .msg_iov = iovs + i,
+        .msg_iovlen = 1,
+    };
+  }
 
-  status = recv(fd, buffer, sizeof(buffer), /* flags = */ MSG_DONTWAIT);
-  if (status < 0) {
+  int status = recvmmsg(fd, msgs, STATSD_RECEIVE_BATCH_SIZE, MSG_DONTWAIT,
+                        /* timeout = */ NULL);
+  if (status < 0)
+    return -errno;
+
+  for (int i = 0; i < status; i++) {
+    lengths[i] = (size_t)msgs[i].msg_len;
+    truncated[i] = (msgs[i].msg_hdr.msg_flags & MSG_TRUNC) != 0;
+  }
+  return status;
+#else
+  struct iovec iov = {
+      .iov_base = buffers,
+      .iov_len = conf_max_packet_size,
+  };
+  struct msghdr msg = {
+      .msg_iov = &iov,
+      .msg_iovlen = 1,
+  };
+
+  ssize_t status = recvmsg(fd, &msg, MSG_DONTWAIT);
+  if (status < 0)
+    return -errno;
+
+  lengths[0] = (size_t)status;
+  truncated[0] = (msg.msg_flags & MSG_TRUNC) != 0;
+  return 1;
+#endif
+} /* }}} int statsd_receive_batch */
+
+/* Drains a datagram socket. Up to a few batches are read at a time, so that
+ * the other sockets of the thread get a chance. */
+static void statsd_datagram_read(statsd_receiver_t *r, /* {{{ */
+                                 statsd_socket_t *s) {
+  size_t lengths[STATSD_RECEIVE_BATCH_SIZE];
+  bool truncated[STATSD_RECEIVE_BATCH_SIZE];
+
+  for (int i = 0; i < 4; i++) {
+    int num = statsd_receive_batch(s->fd, r->buffers, lengths, truncated);
+    if (num < 0) {
+      if ((num != -EAGAIN) && (num != -EWOULDBLOCK) && (num != -EINTR))
+        ERROR("statsd plugin: recvmmsg(2) failed: %s", STRERROR(-num));
+      return;
+    }
+
+    statsd_table_t *t = statsd_ingest_acquire(&r->ingest);
+    for (int j = 0; j < num; j++) {
+      char *buffer = r->buffers + (j * (conf_max_packet_size + 1));
+      buffer[lengths[j]] = 0;
+
+      /* The last line of a truncated datagram is incomplete. Drop it rather
+       * than handling a cut-off value. */
+      if (truncated[j]) {
+        __atomic_fetch_add(&s->stats->truncated, 1, __ATOMIC_RELAXED);
+        char *end = strrchr(buffer, '\n');
+        if (end == NULL)
+          continue;
+        *end = 0;
+      }
+
+      statsd_parse_buffer(t, s->stats, buffer);
+    }
+    statsd_ingest_release(&r->ingest);
 
-    if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+    if (num < STATSD_RECEIVE_BATCH_SIZE)
       return;
+  }
+} /* }}} void statsd_datagram_read */
+
+/* Reads from a TCP connection and parses all complete lines. Lines longer than
+ * MaxPacketSize are counted as truncated and skipped. Returns non-zero if the
+ * connection has been closed. */
+static int statsd_stream_read(statsd_receiver_t *r, /* {{{ */
+                              statsd_socket_t *s) {
+  ssize_t status =
+      read(s->fd, s->buffer + s->fill, conf_max_packet_size - s->fill);
+  if (status < 0) {
+    if ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR))
+      return 0;
+    NOTICE("statsd plugin: read(2) failed: %s", STRERRNO);
+    return -1;
+  }
+
+  char *start = s->buffer;
+  char *end = s->buffer + s->fill + (size_t)status;
+  s->fill = 0;
+
+  if (status == 0) {
+    /* The last line does not need to be terminated. */
+    if ((start != end) && !s->discard) {
+      *end = 0;
+      statsd_table_t *t = statsd_ingest_acquire(&r->ingest);
+      statsd_parse_buffer(t, s->stats, start);
+      statsd_ingest_release(&r->ingest);
+    }
+    return -1;
+  }
+
+  if (s->discard) {
+    char *newline = memchr(start, '\n', (size_t)(end - start));
+    if (newline == NULL)
+      return 0;
+    start = newline + 1;
+    s->discard = false;
+  }
+
+  char *last = end;
+  while ((last > start) && (last[-1] != '\n'))
+    last--;
+  if (last > start) {
+    last[-1] = 0;
+    statsd_table_t *t = statsd_ingest_acquire(&r->ingest);
+    statsd_parse_buffer(t, s->stats, start);
+    statsd_ingest_release(&r->ingest);
+    start = last;
+  }
 
-    ERROR("statsd plugin: recv(2) failed: %s", STRERRNO);
+  size_t rest = (size_t)(end - start);
+  if (rest >= conf_max_packet_size) {
+    __atomic_fetch_add(&s->stats->truncated, 1, __ATOMIC_RELAXED);
+    s->discard = true;
+    rest = 0;
+  }
+  memmove(s->buffer, start, rest);
+  s->fill = rest;
+
+  return 0;
+} /* }}} int statsd_stream_read */
+
+static int statsd_receiver_add(statsd_receiver_t *r, int fd, /* {{{ */
+                               statsd_listener_stats_t *stats, bool listening) {
+  statsd_socket_t *sockets =
+      realloc(r->sockets, (r->sockets_num + 1) * sizeof(*sockets));
+  if (sockets == NULL)
+    return ENOMEM;
+  r->sockets = sockets;
+
+  struct pollfd *pollfd =
+      realloc(r->pollfd, (r->sockets_num + 1) * sizeof(*pollfd));
+  if (pollfd == NULL)
+    return ENOMEM;
+  r->pollfd = pollfd;
+
+  r->sockets[r->sockets_num] = (statsd_socket_t){
+      .fd = fd,
+      .stats = stats,
+      .listening = listening,
+  };
+  r->pollfd[r->sockets_num] = (struct pollfd){
+      .fd = fd,
+      .events = POLLIN | POLLPRI,
+  };
+  r->sockets_num++;
+  return 0;
+} /* }}} int statsd_receiver_add */
+
+static void statsd_receiver_remove(statsd_receiver_t *r, /* {{{ */
+                                   size_t index) {
+  sfree(r->sockets[index].buffer);
+  r->sockets_num--;
+  r->sockets[index] = r->sockets[r->sockets_num];
+  r->pollfd[index] = r->pollfd[r->sockets_num];
+} /* }}} void statsd_receiver_remove */
+
+static void statsd_stream_accept(statsd_receiver_t *r, /* {{{ */
+                                 statsd_socket_t *s) {
+  /* All threads poll the listening socket; another one may have been
+   * faster. */
+  int fd = accept(s->fd, /* addr = */ NULL, /* addrlen = */ NULL);
+  if (fd < 0) {
+    if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR))
+      ERROR("statsd plugin: accept(2) failed: %s", STRERRNO);
+    return;
+  }
+
+  int flags = fcntl(fd, F_GETFL);
+  char *buffer = malloc(conf_max_packet_size + 1);
+  if ((flags == -1) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) ||
+      (buffer == NULL) || (statsd_receiver_add(r, fd, s->stats, false) != 0)) {
+    ERROR("statsd plugin: Setting up a TCP connection failed.");
+    sfree(buffer);
+    close(fd);
     return;
   }
+  r->sockets[r->sockets_num - 1].buffer = buffer;
+} /* }}} void statsd_stream_accept */
+
+static void *statsd_receive_thread(void *arg) /* {{{ */
+{
+  statsd_receiver_t *r = arg;
 
-  buffer_size = (size_t)status;
-  if (buffer_size >= sizeof(buffer))
-    buffer_size = sizeof(buffer) - 1;
-  buffer[buffer_size] = 0;
+  while (!network_thread_shutdown) {
+    int status = poll(r->pollfd, (nfds_t)r->sockets_num, /* timeout = */ -1);
+    if (status < 0) {
+
+      if ((errno == EINTR) || (errno == EAGAIN))
+        continue;
+
+      ERROR("statsd plugin: poll(2) failed: %s", STRERRNO);
+      break;
+    }
 
-  statsd_parse_buffer(buffer);
-} /* }}} void statsd_network_read */
+    /* Iterate backwards, so that removing a connection does not skip the
+     * socket moved into its place. Sockets accepted in this round are not
+     * polled yet and are left alone. */
+    for (size_t i = r->sockets_num; i > 0; i--) {
+      statsd_socket_t *s = r->sockets + (i - 1);
+      short revents = r->pollfd[i - 1].revents;
+      r->pollfd[i - 1].revents = 0;
+
+      if ((revents & (POLLIN | POLLPRI | POLLHUP | POLLERR)) == 0)
+        continue;
+
+      if (s->listening)
+        statsd_stream_accept(r, s);
+      else if (s->buffer != NULL) {
+        if (statsd_stream_read(r, s) != 0) {
+          close(s->fd);
+          statsd_receiver_remove(r, i - 1);
+        }
+      } else
+        statsd_datagram_read(r, s);
+    }
+  } /* while (!network_thread_shutdown) */
 
-static int statsd_network_init(struct pollfd **ret_fds, /* {{{ */
-                               size_t *ret_fds_num) {
-  struct pollfd *fds = NULL;
+  return (void *)0;
+} /* }}} void *statsd_receive_thread */
+
+/* Opens sockets of type `socktype' for all addresses of Host and Port. With
+ * `reuse_port', several sockets may be bound to the same address and the
+ * kernel distributes datagrams between them. */
+static int statsd_network_open(int socktype, bool reuse_port, /* {{{ */
+                               int **ret_fds, size_t *ret_fds_num) {
+  int *fds = NULL;
   size_t fds_num = 0;
 
   struct addrinfo *ai_list;
@@ -472,10 +1043,11 @@ static int statsd_network_init(struct pollfd **ret_fds, /* {{{ */
   char const *node = (conf_node != NULL) ? conf_node : STATSD_DEFAULT_NODE;
   char const *service =
       (conf_service != NULL) ? conf_service : STATSD_DEFAULT_SERVICE;
+  char const *proto = (socktype == SOCK_STREAM) ? "TCP" : "UDP";
 
   struct addrinfo ai_hints = {.ai_family = AF_UNSPEC,
                               .ai_flags = AI_PASSIVE | AI_ADDRCONFIG,
-                              .ai_socktype = SOCK_DGRAM};
+                              .ai_socktype = socktype};
 
   status = getaddrinfo(node, service, &ai_hints, &ai_list);
   if (status != 0) {
@@ -487,7 +1059,7 @@ static int statsd_network_init(struct pollfd **ret_fds, /* {{{ */
   for (struct addrinfo *ai_ptr = ai_list; ai_ptr != NULL;
        ai_ptr = ai_ptr->ai_next) {
     int fd;
-    struct pollfd *tmp;
+    int *tmp;
 
     char str_node[NI_MAXHOST];
     char str_service[NI_MAXSERV];
@@ -498,6 +1070,15 @@ static int statsd_network_init(struct pollfd **ret_fds, /* {{{ */
       continue;
     }
 
+    /* All receiving threads poll a TCP listening socket, so accept(2) must
+     * not block if another thread was faster. */
+    int flags = fcntl(fd, F_GETFL);
+    if ((flags == -1) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0)) {
+      ERROR("statsd plugin: fcntl(2) failed: %s", STRERRNO);
+      close(fd);
+      continue;
+    }
+
     /* allow multiple sockets to use the same PORT number */
     int yes = 1;
     if (setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes)) == -1) {
@@ -506,15 +1087,28 @@ static int statsd_network_init(struct pollfd **ret_fds, /* {{{ */
       continue;
     }
 
+#ifdef SO_REUSEPORT
+    if (reuse_port &&
+        (setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes)) == -1)) {
+      ERROR("statsd plugin: setsockopt (reuseport): %s", STRERRNO);
+      close(fd);
+      continue;
+    }
+#else
+    assert(!reuse_port);
+#endif
+
     getnameinfo(ai_ptr->ai_addr, ai_ptr->ai_addrlen, str_node, sizeof(str_node),
                 str_service, sizeof(str_service),
-                NI_DGRAM | NI_NUMERICHOST | NI_NUMERICSERV);
+                NI_NUMERICHOST | NI_NUMERICSERV);
     DEBUG("statsd plugin: Trying to bind to [%s]:%s ...", str_node,
           str_service);
 
     status = bind(fd, ai_ptr->ai_addr, ai_ptr->ai_addrlen);
+    if ((status == 0) && (socktype == SOCK_STREAM))
+      status = listen(fd, SOMAXCONN);
     if (status != 0) {
-      ERROR("statsd plugin: bind(2) to [%s]:%s failed: %s", str_node,
+      ERROR("statsd plugin: bind(2) to %s [%s]:%s failed: %s", proto, str_node,
             str_service, STRERRNO);
       close(fd);
       continue;
@@ -527,67 +1121,54 @@ static int statsd_network_init(struct pollfd **ret_fds, /* {{{ */
       continue;
     }
     fds = tmp;
-    tmp = fds + fds_num;
+    fds[fds_num] = fd;
     fds_num++;
 
-    memset(tmp, 0, sizeof(*tmp));
-    tmp->fd = fd;
-    tmp->events = POLLIN | POLLPRI;
-    INFO("statsd plugin: Listening on [%s]:%s.", str_node, str_service);
+    INFO("statsd plugin: Listening on %s [%s]:%s.", proto, str_node,
+         str_service);
   }
 
   freeaddrinfo(ai_list);
 
   if (fds_num == 0) {
-    ERROR("statsd plugin: Unable to create listening socket for [%s]:%s.",
-          (node != NULL) ? node : "::", service);
+    ERROR("statsd plugin: Unable to create listening socket for %s [%s]:%s.",
+          proto, (node != NULL) ? node : "::", service);
     return ENOENT;
   }
 
   *ret_fds = fds;
   *ret_fds_num = fds_num;
   return 0;
-} /* }}} int statsd_network_init */
+} /* }}} int statsd_network_open */
 
-static void *statsd_network_thread(void *args) /* {{{ */
+static int statsd_unix_open(int *ret_fd) /* {{{ */
 {
-  struct pollfd *fds = NULL;
-  size_t fds_num = 0;
-  int status;
+  struct sockaddr_un sa = {.sun_family = AF_UNIX};
+  sstrncpy(sa.sun_path, conf_unix_socket, sizeof(sa.sun_path));
 
-  status = statsd_network_init(&fds, &fds_num);
-  if (status != 0) {
-    ERROR("statsd plugin: Unable to open listening sockets.");
-    pthread_exit((void *)0);
+  int fd = socket(PF_UNIX, SOCK_DGRAM, 0);
+  if (fd < 0) {
+    ERROR("statsd plugin: socket(2) failed: %s", STRERRNO);
+    return -1;
   }
 
-  while (!network_thread_shutdown) {
-    status = poll(fds, (nfds_t)fds_num, /* timeout = */ -1);
-    if (status < 0) {
-
-      if ((errno == EINTR) || (errno == EAGAIN))
-        continue;
-
-      ERROR("statsd plugin: poll(2) failed: %s", STRERRNO);
-      break;
-    }
-
-    for (size_t i = 0; i < fds_num; i++) {
-      if ((fds[i].revents & (POLLIN | POLLPRI)) == 0)
-        continue;
+  /* Remove a socket left over by a previous instance. */
+  if ((unlink(sa.sun_path) != 0) && (errno != ENOENT))
+    NOTICE("statsd plugin: unlink (%s) failed: %s", sa.sun_path, STRERRNO);
 
-      statsd_network_read(fds[i].fd);
-      fds[i].revents = 0;
-    }
-  } /* while (!network_thread_shutdown) */
+  if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+    ERROR("statsd plugin: bind(2) to %s failed: %s", sa.sun_path, STRERRNO);
+    close(fd);
+    return -1;
+  }
 
-  /* Clean up */
-  for (size_t i = 0; i < fds_num; i++)
-    close(fds[i].fd);
-  sfree(fds);
+  if (chmod(sa.sun_path, conf_unix_socket_perms) != 0)
+    ERROR("statsd plugin: chmod (%s) failed: %s", sa.sun_path, STRERRNO);
 
-  return (void *)0;
-} /* }}} void *statsd_network_thread */
+  INFO("statsd plugin: Listening on %s.", sa.sun_path);
+  *ret_fd = fd;
+  return 0;
+} /* }}} int statsd_unix_open */
 
 static int statsd_config_timer_percentile(oconfig_item_t *ci) /* {{{ */
 {
@@ -619,6 +1200,86 @@ static int statsd_config_timer_percentile(oconfig_item_t *ci) /* {{{ */
   return 0;
 } /* }}} int statsd_config_timer_percentile */
 
+static int statsd_config_timer_backend(oconfig_item_t *ci) /* {{{ */
+{
+  char *backend = NULL;
+  int status = cf_util_get_string(ci, &backend);
+  if (status != 0)
+    return status;
+
+  if (strcasecmp("Histogram", backend) == 0)
+    conf_timer_sketch = false;
+  else if (strcasecmp("Sketch", backend) == 0)
+    conf_timer_sketch = true;
+  else {
+    ERROR("statsd plugin: Invalid value for \"%s\": %s. Valid values are "
+          "\"Histogram\" and \"Sketch\".",
+          ci->key, backend);
+    status = EINVAL;
+  }
+
+  sfree(backend);
+  return status;
+} /* }}} int statsd_config_timer_backend */
+
+static int statsd_config_timer_accuracy(oconfig_item_t *ci) /* {{{ */
+{
+  double accuracy = NAN;
+  int status = cf_util_get_double(ci, &accuracy);
+  if (status != 0)
+    return status;
+
+  if (!(accuracy >= 0.000001) || !(accuracy <= 0.5)) {
+    ERROR("statsd plugin: The value for \"%s\" must be between 0.000001 and "
+          "0.5.",
+          ci->key);
+    return ERANGE;
+  }
+
+  conf_timer_accuracy = accuracy;
+  return 0;
+} /* }}} int statsd_config_timer_accuracy */
+
+static int statsd_config_size(oconfig_item_t *ci, size_t *ret, /* {{{ */
+                              int min, int max) {
+  int tmp = 0;
+  int status = cf_util_get_int(ci, &tmp);
+  if (status != 0)
+    return status;
+
+  if ((tmp < min) || (tmp > max)) {
+    ERROR("statsd plugin: The value for \"%s\" must be between %d and %d.",
+          ci->key, min, max);
+    return ERANGE;
+  }
+
+  *ret = (size_t)tmp;
+  return 0;
+} /* }}} int statsd_config_size */
+
+static int statsd_config_perms(oconfig_item_t *ci) /* {{{ */
+{
+  char *perms = NULL;
+  int status = cf_util_get_string(ci, &perms);
+  if (status != 0)
+    return status;
+
+  char *endptr = NULL;
+  errno = 0;
+  long tmp = strtol(perms, &endptr, 8);
+  if ((errno != 0) || (endptr == perms) || (*endptr != 0) || (tmp < 0) ||
+      (tmp > 07777)) {
+    ERROR("statsd plugin: Invalid permissions for \"%s\": %s", ci->key,
+          perms);
+    sfree(perms);
+    return EINVAL;
+  }
+
+  conf_unix_socket_perms = (int)tmp;
+  sfree(perms);
+  return 0;
+} /* }}} int statsd_config_perms */
+
 static int statsd_config(oconfig_item_t *ci) /* {{{ */
 {
   for (int i = 0; i < ci->children_num; i++) {
@@ -628,6 +1289,18 @@ static int statsd_config(oconfig_item_t *ci) /* {{{ */
       cf_util_get_string(child, &conf_node);
     else if (strcasecmp("Port", child->key) == 0)
       cf_util_get_service(child, &conf_service);
+    else if (strcasecmp("ReceiveThreads", child->key) == 0)
+      statsd_config_size(child, &conf_receive_threads, 1, 256);
+    else if (strcasecmp("MaxPacketSize", child->key) == 0)
+      statsd_config_size(child, &conf_max_packet_size, 64, 65535);
+    else if (strcasecmp("ListenTCP", child->key) == 0)
+      cf_util_get_boolean(child, &conf_listen_tcp);
+    else if (strcasecmp("UnixSocket", child->key) == 0)
+      cf_util_get_string(child, &conf_unix_socket);
+    else if (strcasecmp("UnixSocketPerms", child->key) == 0)
+      statsd_config_perms(child);
+    else if (strcasecmp("CollectStatistics", child->key) == 0)
+      cf_util_get_boolean(child, &conf_collect_stats);
     else if (strcasecmp("DeleteCounters", child->key) == 0)
       cf_util_get_boolean(child, &conf_delete_counters);
     else if (strcasecmp("DeleteTimers", child->key) == 0)
@@ -648,37 +1321,221 @@ static int statsd_config(oconfig_item_t *ci) /* {{{ */
       cf_util_get_boolean(child, &conf_timer_count);
     else if (strcasecmp("TimerPercentile", child->key) == 0)
       statsd_config_timer_percentile(child);
+    else if (strcasecmp("TimerBackend", child->key) == 0)
+      statsd_config_timer_backend(child);
+    else if (strcasecmp("TimerRelativeAccuracy", child->key) == 0)
+      statsd_config_timer_accuracy(child);
     else
       ERROR("statsd plugin: The \"%s\" config option is not valid.",
             child->key);
   }
 
+#ifndef SO_REUSEPORT
+  if (conf_receive_threads > 1)
+    WARNING("statsd plugin: The `SO_REUSEPORT' socket option is not "
+            "available on your system. All receive threads will read from the "
+            "same UDP sockets.");
+#endif
+
   return 0;
 } /* }}} int statsd_config */
 
+static int statsd_shared_add(int fd, statsd_listener_stats_t *stats, /* {{{ */
+                             bool listening) {
+  int *tmp = realloc(shared_fds, (shared_fds_num + 1) * sizeof(*shared_fds));
+  if (tmp == NULL) {
+    close(fd);
+    return ENOMEM;
+  }
+  shared_fds = tmp;
+  shared_fds[shared_fds_num] = fd;
+  shared_fds_num++;
+
+  for (size_t i = 0; i < receivers_num; i++) {
+    int status = statsd_receiver_add(receivers + i, fd, stats, listening);
+    if (status != 0)
+      return status;
+    receivers[i].sockets[receivers[i].sockets_num - 1].shared = true;
+  }
+
+  return 0;
+} /* }}} int statsd_shared_add */
+
+/* Creates the receiving threads' state and opens all sockets. */
+static int statsd_receivers_init(void) /* {{{ */
+{
+  receivers = calloc(conf_receive_threads, sizeof(*receivers));
+  if (receivers == NULL)
+    return ENOMEM;
+  receivers_num = conf_receive_threads;
+
+  for (size_t i = 0; i < receivers_num; i++) {
+    statsd_receiver_t *r = receivers + i;
+
+    r->ingest.active = statsd_table_create();
+    r->ingest.spare = statsd_table_create();
+    r->buffers = malloc(STATSD_RECEIVE_BATCH_SIZE * (conf_max_packet_size + 1));
+    if ((r->ingest.active == NULL) || (r->ingest.spare == NULL) ||
+        (r->buffers == NULL))
+      return ENOMEM;
+  }
+
+  /* With several threads, every thread gets its own UDP sockets and the
+   * kernel distributes the datagrams. Otherwise the sockets are shared. */
+  bool reuse_port = false;
+#ifdef SO_REUSEPORT
+  reuse_port = (receivers_num > 1);
+#endif
+
+  for (size_t i = 0; i < receivers_num; i++) {
+    int *fds = NULL;
+    size_t fds_num = 0;
+
+    int status = statsd_network_open(SOCK_DGRAM, reuse_port, &fds, &fds_num);
+    if (status != 0)
+      return status;
+
+    size_t j;
+    for (j = 0; j < fds_num; j++) {
+      if (reuse_port) {
+        status = statsd_receiver_add(receivers + i, fds[j],
+                                     &listener_stats[STATSD_UDP], false);
+        if (status != 0)
+          close(fds[j]);
+      } else
+        status =
+            statsd_shared_add(fds[j], &listener_stats[STATSD_UDP], false);
+      if (status != 0)
+        break;
+    }
+    /* Close the sockets that have not been handed over. */
+    for (j++; j < fds_num; j++)
+      close(fds[j]);
+    sfree(fds);
+    if (status != 0)
+      return status;
+
+    if (!reuse_port)
+      break;
+  }
+
+  if (conf_listen_tcp) {
+    int *fds = NULL;
+    size_t fds_num = 0;
+
+    int status = statsd_network_open(SOCK_STREAM, false, &fds, &fds_num);
+    if (status != 0)
+      return status;
+
+    for (size_t j = 0; j < fds_num; j++) {
+      if (status == 0)
+        status = statsd_shared_add(fds[j], &listener_stats[STATSD_TCP], true);
+      else
+        close(fds[j]);
+    }
+    sfree(fds);
+    if (status != 0)
+      return status;
+  }
+
+  if (conf_unix_socket != NULL) {
+    int fd = -1;
+    int status = statsd_unix_open(&fd);
+    if (status == 0)
+      status = statsd_shared_add(fd, &listener_stats[STATSD_UNIX], false);
+    if (status != 0)
+      return status;
+  }
+
+  return 0;
+} /* }}} int statsd_receivers_init */
+
+/* Stops the receiving threads and closes all sockets. */
+static void statsd_receivers_destroy(void) /* {{{ */
+{
+  network_thread_shutdown = true;
+  for (size_t i = 0; i < receivers_num; i++) {
+    if (!receivers[i].thread_running)
+      continue;
+    pthread_kill(receivers[i].thread, SIGTERM);
+    pthread_join(receivers[i].thread, /* retval = */ NULL);
+    receivers[i].thread_running = false;
+  }
+
+  for (size_t i = 0; i < receivers_num; i++) {
+    statsd_receiver_t *r = receivers + i;
+
+    for (size_t j = 0; j < r->sockets_num; j++) {
+      if (!r->sockets[j].shared)
+        close(r->sockets[j].fd);
+      sfree(r->sockets[j].buffer);
+    }
+    sfree(r->sockets);
+    sfree(r->pollfd);
+    sfree(r->buffers);
+    statsd_table_destroy(r->ingest.active);
+    statsd_table_destroy(r->ingest.spare);
+  }
+  sfree(receivers);
+  receivers_num = 0;
+
+  for (size_t i = 0; i < shared_fds_num; i++)
+    close(shared_fds[i]);
+  sfree(shared_fds);
+  shared_fds_num = 0;
+
+  if (conf_unix_socket != NULL)
+    unlink(conf_unix_socket);
+} /* }}} void statsd_receivers_destroy */
+
 static int statsd_init(void) /* {{{ */
 {
   pthread_mutex_lock(&metrics_lock);
   if (metrics_tree == NULL)
     metrics_tree = c_avl_create((int (*)(const void *, const void *))strcmp);
 
-  if (!network_thread_running) {
-    int status;
+  if ((timer_percentile_values == NULL) && (conf_timer_percentile_num > 0)) {
+    timer_percentile_values =
+        calloc(conf_timer_percentile_num, sizeof(*timer_percentile_values));
+    if (timer_percentile_values == NULL) {
+      ERROR("statsd plugin: calloc failed.");
+      pthread_mutex_unlock(&metrics_lock);
+      return ENOMEM;
+    }
+  }
+
+  if (receivers != NULL) {
+    pthread_mutex_unlock(&metrics_lock);
+    return 0;
+  }
+
+  int status = statsd_receivers_init();
+  if (status != 0) {
+    ERROR("statsd plugin: Unable to open listening sockets.");
+    statsd_receivers_destroy();
+    pthread_mutex_unlock(&metrics_lock);
+    return status;
+  }
 
-    status = pthread_create(&network_thread,
-                            /* attr = */ NULL, statsd_network_thread,
-                            /* args = */ NULL);
+  for (size_t i = 0; i < receivers_num; i++) {
+    statsd_receiver_t *r = receivers + i;
+
+    status = plugin_thread_create(&r->thread, statsd_receive_thread, r,
+                                  "statsd recv");
     if (status != 0) {
-      pthread_mutex_unlock(&metrics_lock);
-      ERROR("statsd plugin: pthread_create failed: %s", STRERRNO);
-      return status;
+      ERROR("statsd plugin: pthread_create failed: %s", STRERROR(status));
+      break;
     }
+    r->thread_running = true;
   }
-  network_thread_running = true;
 
-  pthread_mutex_unlock(&metrics_lock);
+  if (status != 0) {
+    statsd_receivers_destroy();
+    network_thread_shutdown = false;
+  }
 
-  return 0;
+  pthread_mutex_unlock(&metrics_lock);
+  return status;
 } /* }}} int statsd_init */
 
 /* Must hold metrics_lock when calling this function. */
@@ -725,52 +1582,47 @@ static int statsd_metric_submit_unsafe(char const *name,
   if (metric->type == STATSD_GAUGE)
     vl.values[0].gauge = (gauge_t)metric->value;
   else if (metric->type == STATSD_TIMER) {
-    bool have_events = (metric->updates_num > 0);
+    double average = NAN;
+    double lower = NAN;
+    double upper = NAN;
+    double sum = NAN;
+
+    if (metric->updates_num > 0) {
+      statsd_timer_summarize(&metric->timer, &average, &lower, &upper, &sum);
+    } else {
+      for (size_t i = 0; i < conf_timer_percentile_num; i++)
+        timer_percentile_values[i] = NAN;
+    }
 
     /* Make sure all timer metrics share the *same* timestamp. */
     vl.time = cdtime();
 
     snprintf(vl.type_instance, sizeof(vl.type_instance), "%s-average", name);
-    vl.values[0].gauge =
-        have_events
-            ? CDTIME_T_TO_DOUBLE(latency_counter_get_average(metric->latency))
-            : NAN;
+    vl.values[0].gauge = average;
     plugin_dispatch_values(&vl);
 
     if (conf_timer_lower) {
       snprintf(vl.type_instance, sizeof(vl.type_instance), "%s-lower", name);
-      vl.values[0].gauge =
-          have_events
-              ? CDTIME_T_TO_DOUBLE(latency_counter_get_min(metric->latency))
-              : NAN;
+      vl.values[0].gauge = lower;
       plugin_dispatch_values(&vl);
     }
 
     if (conf_timer_upper) {
       snprintf(vl.type_instance, sizeof(vl.type_instance), "%s-upper", name);
-      vl.values[0].gauge =
-          have_events
-              ? CDTIME_T_TO_DOUBLE(latency_counter_get_max(metric->latency))
-              : NAN;
+      vl.values[0].gauge = upper;
       plugin_dispatch_values(&vl);
     }
 
     if (conf_timer_sum) {
       snprintf(vl.type_instance, sizeof(vl.type_instance), "%s-sum", name);
-      vl.values[0].gauge =
-          have_events
-              ? CDTIME_T_TO_DOUBLE(latency_counter_get_sum(metric->latency))
-              : NAN;
+      vl.values[0].gauge = sum;
       plugin_dispatch_values(&vl);
     }
 
     for (size_t i = 0; i < conf_timer_percentile_num; i++) {
       snprintf(vl.type_instance, sizeof(vl.type_instance), "%s-percentile-%.0f",
                name, conf_timer_percentile[i]);
-      vl.values[0].gauge =
-          have_events ? CDTIME_T_TO_DOUBLE(latency_counter_get_percentile(
-                            metric->latency, conf_timer_percentile[i]))
-                      : NAN;
+      vl.values[0].gauge = timer_percentile_values[i];
       plugin_dispatch_values(&vl);
     }
 
@@ -779,11 +1631,11 @@ static int statsd_metric_submit_unsafe(char const *name,
     if (conf_timer_count) {
       sstrncpy(vl.type, "gauge", sizeof(vl.type));
       snprintf(vl.type_instance, sizeof(vl.type_instance), "%s-count", name);
-      vl.values[0].gauge = latency_counter_get_num(metric->latency);
+      vl.values[0].gauge = statsd_timer_count(&metric->timer);
       plugin_dispatch_values(&vl);
     }
 
-    latency_counter_reset(metric->latency);
+    statsd_timer_reset(&metric->timer);
     return 0;
   } else if (metric->type == STATSD_SET) {
     if (metric->set == NULL)
@@ -817,6 +1669,135 @@ static int statsd_metric_submit_unsafe(char const *name,
   return plugin_dispatch_values(&vl);
 } /* }}} int statsd_metric_submit_unsafe */
 
+/* Adds an update to the aggregated metric. Must hold metrics_lock when calling
+ * this function. */
+static int statsd_update_merge_unsafe(statsd_update_t *u) /* {{{ */
+{
+  statsd_metric_t *metric = statsd_metric_lookup_unsafe(u->name, u->type);
+  if (metric == NULL)
+    return -1;
+
+  if (u->type == STATSD_COUNTER) {
+    metric->value += u->value;
+  } else if (u->type == STATSD_GAUGE) {
+    if (u->value_set)
+      metric->value = u->value;
+    else
+      metric->value += u->value;
+  } else if (u->type == STATSD_TIMER) {
+    if (statsd_timer_merge(&metric->timer, &u->timer) != 0)
+      return -1;
+  } else if ((u->type == STATSD_SET) && (u->set != NULL)) {
+    if (metric->set == NULL)
+      metric->set = c_avl_create((int (*)(const void *, const void *))strcmp);
+    if (metric->set == NULL) {
+      ERROR("statsd plugin: c_avl_create failed.");
+      return -1;
+    }
+
+    /* Move the keys over; duplicates are freed. */
+    void *key;
+    void *value;
+    while (c_avl_pick(u->set, &key, &value) == 0) {
+      if (c_avl_insert(metric->set, key, /* value = */ NULL) != 0)
+        sfree(key);
+    }
+  }
+
+  metric->updates_num += u->updates_num;
+  return 0;
+} /* }}} int statsd_update_merge_unsafe */
+
+/* Merges all updates of the table into metrics_tree and resets them. Updates
+ * that have not been used for a whole interval are removed from the table.
+ * Must hold metrics_lock when calling this function. */
+static void statsd_table_merge_unsafe(statsd_table_t *t) /* {{{ */
+{
+  size_t idle_num = 0;
+  for (size_t i = 0; i < t->slots_num; i++) {
+    if ((t->slots[i].update != NULL) && (t->slots[i].update->updates_num == 0))
+      idle_num++;
+  }
+
+  /* Removing updates requires moving the remaining ones into a new slot
+   * array. If that can not be allocated, idle updates are kept. */
+  statsd_slot_t *slots = NULL;
+  size_t slots_num = STATSD_TABLE_MIN_SLOTS;
+  if (idle_num > 0) {
+    while (4 * (t->updates_num - idle_num) > 3 * slots_num)
+      slots_num *= 2;
+    slots = calloc(slots_num, sizeof(*slots));
+  }
+
+  for (size_t i = 0; i < t->slots_num; i++) {
+    statsd_update_t *u = t->slots[i].update;
+    if (u == NULL)
+      continue;
+
+    if (u->updates_num == 0) {
+      if (slots != NULL) {
+        statsd_update_free(u);
+        t->updates_num--;
+        continue;
+      }
+    } else {
+      statsd_update_merge_unsafe(u);
+
+      u->value = 0.0;
+      u->value_set = false;
+      statsd_timer_reset(&u->timer);
+      u->updates_num = 0;
+    }
+
+    if (slots != NULL) {
+      size_t idx = (size_t)u->hash & (slots_num - 1);
+      while (slots[idx].update != NULL)
+        idx = (idx + 1) & (slots_num - 1);
+      slots[idx] = t->slots[i];
+    }
+  }
+
+  if (slots != NULL) {
+    free(t->slots);
+    t->slots = slots;
+    t->slots_num = slots_num;
+  }
+} /* }}} void statsd_table_merge_unsafe */
+
+static void statsd_submit_stats(void) /* {{{ */
+{
+  value_list_t vl = VALUE_LIST_INIT;
+  sstrncpy(vl.plugin, "statsd", sizeof(vl.plugin));
+  sstrncpy(vl.type, "derive", sizeof(vl.type));
+
+  for (size_t i = 0; i < STATSD_LISTENERS_NUM; i++) {
+    if (((i == STATSD_TCP) && !conf_listen_tcp) ||
+        ((i == STATSD_UNIX) && (conf_unix_socket == NULL)))
+      continue;
+
+    statsd_listener_stats_t *stats = listener_stats + i;
+    sstrncpy(vl.plugin_instance, stats->name, sizeof(vl.plugin_instance));
+
+    struct {
+      char const *name;
+      uint64_t *counter;
+    } counters[] = {
+        {"received", &stats->received},
+        {"truncated", &stats->truncated},
+        {"parse_failed", &stats->parse_failed},
+    };
+    for (size_t j = 0; j < STATIC_ARRAY_SIZE(counters); j++) {
+      sstrncpy(vl.type_instance, counters[j].name, sizeof(vl.type_instance));
+      vl.values = &(value_t){
+          .derive = (derive_t)__atomic_load_n(counters[j].counter,
+                                              __ATOMIC_RELAXED),
+      };
+      vl.values_len = 1;
+      plugin_dispatch_values(&vl);
+    }
+  }
+} /* }}} void statsd_submit_stats */
+
 static int statsd_read(void) /* {{{ */
 {
   c_avl_iterator_t *iter;
@@ -833,6 +1814,18 @@ static int statsd_read(void) /* {{{ */
     return 0;
   }
 
+  /* Take the updates of the last interval away from the receiving
+   * threads. */
+  for (size_t i = 0; i < receivers_num; i++) {
+    statsd_ingest_t *in = &receivers[i].ingest;
+    statsd_table_t *t = statsd_ingest_swap(in);
+    statsd_table_merge_unsafe(t);
+    in->spare = t;
+  }
+
+  if (conf_collect_stats)
+    statsd_submit_stats();
+
   iter = c_avl_get_iterator(metrics_tree);
   while (c_avl_iterator_next(iter, (void *)&name, (void *)&metric) == 0) {
     if ((metric->updates_num == 0) &&
@@ -883,15 +1876,10 @@ static int statsd_shutdown(void) /* {{{ */
   void *key;
   void *value;
 
-  if (network_thread_running) {
-    network_thread_shutdown = true;
-    pthread_kill(network_thread, SIGTERM);
-    pthread_join(network_thread, /* retval = */ NULL);
-  }
-  network_thread_running = false;
-
   pthread_mutex_lock(&metrics_lock);
 
+  statsd_receivers_destroy();
+
   while (c_avl_pick(metrics_tree, &key, &value) == 0) {
     sfree(key);
     statsd_metric_free(value);
@@ -901,6 +1889,8 @@ static int statsd_shutdown(void) /* {{{ */
 
   sfree(conf_node);
   sfree(conf_service);
+  sfree(conf_unix_socket);
+  sfree(timer_percentile_values);
 
   pthread_mutex_unlock(&metrics_lock);
 
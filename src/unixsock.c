@@ -33,6 +33,7 @@
 #include "utils/cmds/getthreshold.h"
 #include "utils/cmds/getval.h"
 #include "utils/cmds/listval.h"
+#include "utils/cmds/putbin.h"
 #include "utils/cmds/putnotif.h"
 #include "utils/cmds/putval.h"
 
@@ -41,18 +42,67 @@
 
 #include <grp.h>
 
+#if HAVE_SYS_EPOLL_H
+#include <fcntl.h>
+#include <sys/epoll.h>
+#endif
+
 #ifndef UNIX_PATH_MAX
 #define UNIX_PATH_MAX sizeof(((struct sockaddr_un *)0)->sun_path)
 #endif
 
 #define US_DEFAULT_PATH LOCALSTATEDIR "/run/" PACKAGE_NAME "-unixsock"
 
+/* The input buffer holds a complete PUTBIN command. */
+#define US_BUFFER_SIZE (CMD_PUTBIN_MAX_SIZE + 128)
+/* Number of value lists dispatched at once. */
+#define US_BATCH_SIZE 256
+/* Number of values stored for a batch. */
+#define US_VALUES_SIZE (8 * US_BATCH_SIZE)
+/* Number of values reserved for parsing a PUTVAL command in place. */
+#define US_PUTVAL_VALUES 64
+/* Number of reads before a worker moves on to other connections. */
+#define US_READS_MAX 16
+#define US_DEFAULT_WORKERS 4
+
+/* State of one client connection. Commands may be pipelined: all complete
+ * commands in the input buffer are handled before the responses are sent
+ * with one write. If the client does not read its responses fast enough, the
+ * rest is kept and no more input is read until it has been sent. */
+typedef struct us_conn_s us_conn_t;
+struct us_conn_s {
+  int fd;
+
+  char *buffer;
+  size_t fill;
+  /* Set while the rest of an overlong line is skipped. */
+  bool discard;
+
+  /* Responses are buffered in memory. `out_sent' bytes of `out_buffer' have
+   * been sent already. */
+  FILE *out;
+  char *out_buffer;
+  size_t out_size;
+  size_t out_sent;
+  bool out_pending;
+
+  /* Value lists received with PUTVAL and PUTBIN, not yet dispatched. Their
+   * values are stored in `values'. */
+  value_list_t *vls;
+  size_t vls_num;
+  value_t *values;
+  size_t values_num;
+
+  us_conn_t *prev;
+  us_conn_t *next;
+};
+
 /*
  * Private variables
  */
 /* valid configuration file keys */
 static const char *config_keys[] = {"SocketFile", "SocketGroup", "SocketPerms",
-                                    "DeleteSocket"};
+                                    "DeleteSocket", "WorkerThreads"};
 static int config_keys_num = STATIC_ARRAY_SIZE(config_keys);
 
 static int loop;
@@ -64,7 +114,19 @@ static char *sock_group;
 static int sock_perms = S_IRWXU | S_IRWXG;
 static bool delete_socket;
 
+static size_t workers_num = US_DEFAULT_WORKERS;
+
+#if HAVE_SYS_EPOLL_H
+static int epoll_fd = -1;
+static int shutdown_pipe[2] = {-1, -1};
+static pthread_t *workers;
+
+/* Open connections, closed on shutdown. */
+static us_conn_t *conns;
+static pthread_mutex_t conns_lock = PTHREAD_MUTEX_INITIALIZER;
+#else
 static pthread_t listen_thread = (pthread_t)0;
+#endif
 
 /*
  * Functions
@@ -158,173 +220,646 @@ static int us_open_socket(void) {
   return 0;
 } /* int us_open_socket */
 
-static void *us_handle_client(void *arg) {
-  int fdin;
-  int fdout;
-  FILE *fhin, *fhout;
+static us_conn_t *us_conn_create(int fd) /* {{{ */
+{
+  us_conn_t *c = calloc(1, sizeof(*c));
+  if (c == NULL)
+    return NULL;
+
+  c->fd = fd;
+  c->buffer = malloc(US_BUFFER_SIZE);
+  c->vls = calloc(US_BATCH_SIZE, sizeof(*c->vls));
+  c->values = calloc(US_VALUES_SIZE, sizeof(*c->values));
+  c->out = open_memstream(&c->out_buffer, &c->out_size);
+  if ((c->buffer == NULL) || (c->vls == NULL) || (c->values == NULL) ||
+      (c->out == NULL)) {
+    ERROR("unixsock plugin: Allocating the connection state failed.");
+    if (c->out != NULL)
+      fclose(c->out);
+    sfree(c->out_buffer);
+    sfree(c->values);
+    sfree(c->vls);
+    sfree(c->buffer);
+    sfree(c);
+    return NULL;
+  }
 
-  fdin = *((int *)arg);
-  free(arg);
-  arg = NULL;
+  return c;
+} /* }}} us_conn_t *us_conn_create */
 
-  DEBUG("unixsock plugin: us_handle_client: Reading from fd #%i", fdin);
+static void us_conn_clear(us_conn_t *c) /* {{{ */
+{
+  for (size_t i = 0; i < c->vls_num; i++) {
+    meta_data_destroy(c->vls[i].meta);
+    c->vls[i].meta = NULL;
+  }
+  c->vls_num = 0;
+  c->values_num = 0;
+} /* }}} void us_conn_clear */
+
+/* Closes the socket and frees `c'. */
+static void us_conn_destroy(us_conn_t *c) /* {{{ */
+{
+  if (c == NULL)
+    return;
+
+  us_conn_clear(c);
+  close(c->fd);
+  fclose(c->out);
+  sfree(c->out_buffer);
+  sfree(c->values);
+  sfree(c->vls);
+  sfree(c->buffer);
+  sfree(c);
+} /* }}} void us_conn_destroy */
+
+/* Dispatches the value lists received with PUTVAL and PUTBIN since the last
+ * call. */
+static void us_conn_dispatch(us_conn_t *c) /* {{{ */
+{
+  if (c->vls_num == 0)
+    return;
+
+  plugin_dispatch_values_batch(c->vls, c->vls_num);
+  us_conn_clear(c);
+} /* }}} void us_conn_dispatch */
+
+/* Dispatches pending value lists and sends the responses buffered since the
+ * last call. Returns zero if all responses have been sent, EAGAIN if the
+ * socket does not take more data right now, in which case the rest is sent
+ * by the next call, and -1 on error. */
+static int us_conn_flush(us_conn_t *c) /* {{{ */
+{
+  us_conn_dispatch(c);
+
+  if (fflush(c->out) != 0) {
+    ERROR("unixsock plugin: Buffering the responses failed: %s", STRERRNO);
+    return -1;
+  }
 
-  fdout = dup(fdin);
-  if (fdout < 0) {
-    ERROR("unixsock plugin: dup failed: %s", STRERRNO);
-    close(fdin);
-    pthread_exit((void *)1);
+  while (c->out_sent < c->out_size) {
+    ssize_t status = write(c->fd, c->out_buffer + c->out_sent,
+                           c->out_size - c->out_sent);
+    if (status < 0) {
+      if (errno == EINTR)
+        continue;
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK)) {
+        c->out_pending = true;
+        return EAGAIN;
+      }
+
+      WARNING("unixsock plugin: failed to write to socket #%i: %s", c->fd,
+              STRERRNO);
+      return -1;
+    }
+    c->out_sent += (size_t)status;
   }
 
-  fhin = fdopen(fdin, "r");
-  if (fhin == NULL) {
-    ERROR("unixsock plugin: fdopen failed: %s", STRERRNO);
-    close(fdin);
-    close(fdout);
-    pthread_exit((void *)1);
-    return (void *)1;
+  rewind(c->out);
+  c->out_sent = 0;
+  c->out_pending = false;
+  return 0;
+} /* }}} int us_conn_flush */
+
+/* Makes room for one more value list with `values_num' values in the batch.
+ * Returns false if the values do not fit into an empty batch either. */
+static bool us_conn_reserve(us_conn_t *c, size_t values_num) /* {{{ */
+{
+  if ((c->vls_num >= US_BATCH_SIZE) ||
+      (c->values_num + values_num > US_VALUES_SIZE))
+    us_conn_dispatch(c);
+
+  return values_num <= US_VALUES_SIZE;
+} /* }}} bool us_conn_reserve */
+
+/* Copies the values of `vl' into the batch and takes ownership of its meta
+ * data. */
+static void us_conn_append(us_conn_t *c, value_list_t const *vl) /* {{{ */
+{
+  if (!us_conn_reserve(c, vl->values_len)) {
+    plugin_dispatch_values(vl);
+    meta_data_destroy(vl->meta);
+    return;
   }
 
-  fhout = fdopen(fdout, "w");
-  if (fhout == NULL) {
-    ERROR("unixsock plugin: fdopen failed: %s", STRERRNO);
-    fclose(fhin); /* this closes fdin as well */
-    close(fdout);
-    pthread_exit((void *)1);
-    return (void *)1;
+  value_list_t *dst = c->vls + c->vls_num;
+  *dst = *vl;
+  dst->values = c->values + c->values_num;
+  memcpy(dst->values, vl->values, vl->values_len * sizeof(*dst->values));
+
+  c->vls_num++;
+  c->values_num += vl->values_len;
+} /* }}} void us_conn_append */
+
+static int us_putbin_callback(value_list_t const *vl, void *ud) /* {{{ */
+{
+  us_conn_append(ud, vl);
+  return 0;
+} /* }}} int us_putbin_callback */
+
+static void us_handle_putval(us_conn_t *c, char *buffer) /* {{{ */
+{
+  cmd_error_handler_t err = {cmd_error_fh, c->out};
+  cmd_t cmd;
+
+  /* Most commands are parsed directly into the batch. */
+  us_conn_reserve(c, US_PUTVAL_VALUES);
+  value_list_t *vl = c->vls + c->vls_num;
+  vl->values = c->values + c->values_num;
+  if (cmd_parse_putval_fast(buffer, vl, US_VALUES_SIZE - c->values_num,
+                            NULL) == CMD_OK) {
+    c->vls_num++;
+    c->values_num += vl->values_len;
+    cmd_error(CMD_OK, &err, "Success: 1 value has been dispatched.");
+    return;
   }
 
-  /* change output buffer to line buffered mode */
-  if (setvbuf(fhout, NULL, _IOLBF, 0) != 0) {
-    ERROR("unixsock plugin: setvbuf failed: %s", STRERRNO);
-    fclose(fhin);
-    fclose(fhout);
-    pthread_exit((void *)1);
-    return (void *)0;
+  if (cmd_parse(buffer, &cmd, NULL, &err) != CMD_OK)
+    return;
+  if (cmd.type != CMD_PUTVAL) {
+    cmd_error(CMD_UNKNOWN_COMMAND, &err, "Unexpected command: `%s'.",
+              CMD_TO_STRING(cmd.type));
+    cmd_destroy(&cmd);
+    return;
   }
 
-  while (42) {
-    char buffer[1024];
-    char buffer_copy[1024];
-    char *fields[128];
-    int fields_num;
+  cmd_putval_t *putval = &cmd.cmd.putval;
+  for (size_t i = 0; i < putval->vl_num; i++) {
+    us_conn_append(c, putval->vl + i);
+    putval->vl[i].meta = NULL;
+  }
 
-    errno = 0;
-    if (fgets(buffer, sizeof(buffer), fhin) == NULL) {
-      if ((errno == EINTR) || (errno == EAGAIN))
+  cmd_error(CMD_OK, &err, "Success: %i %s been dispatched.",
+            (int)putval->vl_num,
+            (putval->vl_num == 1) ? "value has" : "values have");
+
+  cmd_destroy(&cmd);
+} /* }}} void us_handle_putval */
+
+static void us_handle_putbin(us_conn_t *c, char const *data, /* {{{ */
+                             size_t size) {
+  cmd_error_handler_t err = {cmd_error_fh, c->out};
+  size_t num = 0;
+
+  if (cmd_parse_putbin(data, size, us_putbin_callback, c, &num, &err) !=
+      CMD_OK)
+    return;
+
+  cmd_error(CMD_OK, &err, "Success: %" PRIsz " %s been dispatched.", num,
+            (num == 1) ? "value has" : "values have");
+} /* }}} void us_handle_putbin */
+
+/* Returns true if the first word of `line', `len' bytes long, is `name'. */
+static bool us_is_command(char const *line, size_t len, /* {{{ */
+                          char const *name) {
+  return (len == strlen(name)) && (strncasecmp(line, name, len) == 0);
+} /* }}} bool us_is_command */
+
+/* Handles one line of the text protocol. */
+static void us_handle_command(us_conn_t *c, char *line) /* {{{ */
+{
+  size_t len = strlen(line);
+  while ((len > 0) && ((line[len - 1] == '\n') || (line[len - 1] == '\r')))
+    line[--len] = '\0';
+
+  char const *cmd = line + strspn(line, " \t");
+  size_t cmd_len = strcspn(cmd, " \t");
+  if (cmd_len == 0)
+    return;
+
+  if (us_is_command(cmd, cmd_len, "putval")) {
+    us_handle_putval(c, line);
+    return;
+  }
+
+  /* Other commands may depend on the values received before. */
+  us_conn_dispatch(c);
+
+  if (us_is_command(cmd, cmd_len, "getval")) {
+    cmd_handle_getval(c->out, line);
+  } else if (us_is_command(cmd, cmd_len, "getthreshold")) {
+    handle_getthreshold(c->out, line);
+  } else if (us_is_command(cmd, cmd_len, "listval")) {
+    cmd_handle_listval(c->out, line);
+  } else if (us_is_command(cmd, cmd_len, "putnotif")) {
+    handle_putnotif(c->out, line);
+  } else if (us_is_command(cmd, cmd_len, "flush")) {
+    cmd_handle_flush(c->out, line);
+  } else {
+    fprintf(c->out, "-1 Unknown command: %.*s\n", (int)cmd_len, cmd);
+  }
+} /* }}} void us_handle_command */
+
+/* Parses the size of a "PUTBIN <size>" line. Returns -1 if `line' is not a
+ * PUTBIN command and -2 if the size is invalid. */
+static ssize_t us_putbin_size(char const *line, size_t len) /* {{{ */
+{
+  size_t prefix_len = strlen("PUTBIN ");
+  if ((len <= prefix_len) || (strncasecmp(line, "PUTBIN ", prefix_len) != 0))
+    return -1;
+
+  size_t size = 0;
+  for (size_t i = prefix_len; i < len; i++) {
+    if ((line[i] == '\r') && (i == len - 1))
+      break;
+    if ((line[i] < '0') || (line[i] > '9'))
+      return -2;
+    size = 10 * size + (size_t)(line[i] - '0');
+    if (size > CMD_PUTBIN_MAX_SIZE)
+      return -2;
+  }
+
+  return (ssize_t)size;
+} /* }}} ssize_t us_putbin_size */
+
+/* Handles all complete commands in the input buffer. Returns non-zero if the
+ * connection has to be closed. */
+static int us_conn_process(us_conn_t *c) /* {{{ */
+{
+  size_t pos = 0;
+
+  while (pos < c->fill) {
+    char *line = c->buffer + pos;
+    char *end = memchr(line, '\n', c->fill - pos);
+    if (end == NULL)
+      break;
+
+    size_t len = (size_t)(end - line);
+    if (c->discard) {
+      c->discard = false;
+      pos += len + 1;
+      continue;
+    }
+
+    ssize_t size = us_putbin_size(line, len);
+    if (size == -2) {
+      /* The data following the line can not be skipped reliably. */
+      fprintf(c->out, "-1 Invalid PUTBIN size, the maximum is %d bytes.\n",
+              CMD_PUTBIN_MAX_SIZE);
+      return -1;
+    } else if (size >= 0) {
+      if (c->fill - (pos + len + 1) < (size_t)size)
+        break; /* Wait for the rest of the data. */
+
+      us_conn_dispatch(c);
+      us_handle_putbin(c, end + 1, (size_t)size);
+      pos += len + 1 + (size_t)size;
+      continue;
+    }
+
+    *end = 0;
+    us_handle_command(c, line);
+    pos += len + 1;
+  }
+
+  if (pos > 0) {
+    memmove(c->buffer, c->buffer + pos, c->fill - pos);
+    c->fill -= pos;
+  }
+
+  /* The buffer holds the largest PUTBIN command, so only text lines can
+   * fill it up. */
+  if (c->fill == US_BUFFER_SIZE) {
+    if (!c->discard)
+      fprintf(c->out, "-1 Command too long.\n");
+    c->discard = true;
+    c->fill = 0;
+  }
+
+  return 0;
+} /* }}} int us_conn_process */
+
+/* Reads and handles commands and sends the responses. With `nonblocking',
+ * reads until no more data is available, but at most US_READS_MAX times, else
+ * reads once. Returns EAGAIN if responses are left to be sent, and -1 if the
+ * connection has been closed or has to be closed. */
+static int us_conn_handle(us_conn_t *c, bool nonblocking) /* {{{ */
+{
+  /* Input is only read once the previous responses have been sent, which
+   * limits the memory a client that does not read can tie up. */
+  if (c->out_pending) {
+    int status = us_conn_flush(c);
+    if (status != 0)
+      return status;
+  }
+
+  int status = 0;
+
+  for (int i = 0; i < US_READS_MAX; i++) {
+    ssize_t len = recv(c->fd, c->buffer + c->fill, US_BUFFER_SIZE - c->fill,
+                       nonblocking ? MSG_DONTWAIT : 0);
+    if (len < 0) {
+      if (errno == EINTR)
         continue;
+      if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+        break;
 
-      if (errno != 0) {
-        WARNING("unixsock plugin: failed to read from socket #%i: %s",
-                fileno(fhin), STRERRNO);
-      }
+      WARNING("unixsock plugin: failed to read from socket #%i: %s", c->fd,
+              STRERRNO);
+      status = -1;
+      break;
+    } else if (len == 0) {
+      status = -1;
       break;
     }
 
-    size_t len = strlen(buffer);
-    while ((len > 0) &&
-           ((buffer[len - 1] == '\n') || (buffer[len - 1] == '\r')))
-      buffer[--len] = '\0';
+    size_t available = US_BUFFER_SIZE - c->fill;
+    c->fill += (size_t)len;
+    if (us_conn_process(c) != 0) {
+      status = -1;
+      break;
+    }
 
-    if (len == 0)
+    /* A short read has most likely drained the socket, which saves the read
+     * failing with EAGAIN. Remaining data is reported by epoll again. */
+    if (!nonblocking || ((size_t)len < available))
+      break;
+  }
+
+  /* Responses are sent even if the connection is about to be closed. */
+  int flush_status = us_conn_flush(c);
+  if (status == 0)
+    status = flush_status;
+
+  return status;
+} /* }}} int us_conn_handle */
+
+#if HAVE_SYS_EPOLL_H
+static void us_conn_register(us_conn_t *c) /* {{{ */
+{
+  pthread_mutex_lock(&conns_lock);
+  c->next = conns;
+  if (conns != NULL)
+    conns->prev = c;
+  conns = c;
+  pthread_mutex_unlock(&conns_lock);
+} /* }}} void us_conn_register */
+
+static void us_conn_unregister(us_conn_t *c) /* {{{ */
+{
+  pthread_mutex_lock(&conns_lock);
+  if (c->prev != NULL)
+    c->prev->next = c->next;
+  else
+    conns = c->next;
+  if (c->next != NULL)
+    c->next->prev = c->prev;
+  c->prev = c->next = NULL;
+  pthread_mutex_unlock(&conns_lock);
+} /* }}} void us_conn_unregister */
+
+static int us_set_nonblocking(int fd) /* {{{ */
+{
+  int flags = fcntl(fd, F_GETFL);
+  if ((flags == -1) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0)) {
+    ERROR("unixsock plugin: fcntl failed: %s", STRERRNO);
+    return -1;
+  }
+  return 0;
+} /* }}} int us_set_nonblocking */
+
+/* Connections are handled by a pool of worker threads waiting on one epoll
+ * instance. All descriptors but the shutdown pipe are registered with
+ * EPOLLONESHOT, so that a ready connection is handled by exactly one worker,
+ * which re-arms it once it has handled the available commands. Sockets are
+ * non-blocking, so a client which does not read its responses never blocks a
+ * worker; its connection waits for EPOLLOUT instead. */
+static int us_epoll_arm(int fd, void *ptr, int op, uint32_t events) /* {{{ */
+{
+  struct epoll_event ev = {
+      .events = events | EPOLLONESHOT,
+      .data.ptr = ptr,
+  };
+
+  if (epoll_ctl(epoll_fd, op, fd, &ev) != 0) {
+    ERROR("unixsock plugin: epoll_ctl failed: %s", STRERRNO);
+    return -1;
+  }
+  return 0;
+} /* }}} int us_epoll_arm */
+
+static void us_epoll_accept(void) /* {{{ */
+{
+  while (42) {
+    int fd = accept(sock_fd, NULL, NULL);
+    if (fd < 0) {
+      if (errno == EINTR)
+        continue;
+      if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+        ERROR("unixsock plugin: accept failed: %s", STRERRNO);
+      break;
+    }
+
+    us_conn_t *c = NULL;
+    if (us_set_nonblocking(fd) == 0)
+      c = us_conn_create(fd);
+    if (c == NULL) {
+      close(fd);
       continue;
+    }
 
-    sstrncpy(buffer_copy, buffer, sizeof(buffer_copy));
+    us_conn_register(c);
+    if (us_epoll_arm(fd, c, EPOLL_CTL_ADD, EPOLLIN) != 0) {
+      us_conn_unregister(c);
+      us_conn_destroy(c);
+    }
+  }
+
+  us_epoll_arm(sock_fd, &sock_fd, EPOLL_CTL_MOD, EPOLLIN);
+} /* }}} void us_epoll_accept */
 
-    fields_num =
-        strsplit(buffer_copy, fields, sizeof(fields) / sizeof(fields[0]));
-    if (fields_num < 1) {
-      fprintf(fhout, "-1 Internal error\n");
-      fclose(fhin);
-      fclose(fhout);
-      pthread_exit((void *)1);
-      return (void *)1;
+static void *us_worker_thread(void __attribute__((unused)) * arg) /* {{{ */
+{
+  while (loop != 0) {
+    struct epoll_event ev;
+    int status = epoll_wait(epoll_fd, &ev, 1, -1);
+    if (status < 0) {
+      if (errno == EINTR)
+        continue;
+      ERROR("unixsock plugin: epoll_wait failed: %s", STRERRNO);
+      break;
+    } else if (status == 0) {
+      continue;
     }
 
-    if (strcasecmp(fields[0], "getval") == 0) {
-      cmd_handle_getval(fhout, buffer);
-    } else if (strcasecmp(fields[0], "getthreshold") == 0) {
-      handle_getthreshold(fhout, buffer);
-    } else if (strcasecmp(fields[0], "putval") == 0) {
-      cmd_handle_putval(fhout, buffer);
-    } else if (strcasecmp(fields[0], "listval") == 0) {
-      cmd_handle_listval(fhout, buffer);
-    } else if (strcasecmp(fields[0], "putnotif") == 0) {
-      handle_putnotif(fhout, buffer);
-    } else if (strcasecmp(fields[0], "flush") == 0) {
-      cmd_handle_flush(fhout, buffer);
-    } else {
-      if (fprintf(fhout, "-1 Unknown command: %s\n", fields[0]) < 0) {
-        WARNING("unixsock plugin: failed to write to socket #%i: %s",
-                fileno(fhout), STRERRNO);
-        break;
-      }
+    if (ev.data.ptr == &shutdown_pipe) {
+      break;
+    } else if (ev.data.ptr == &sock_fd) {
+      us_epoll_accept();
+      continue;
     }
-  } /* while (fgets) */
 
-  DEBUG("unixsock plugin: us_handle_client: Exiting..");
-  fclose(fhin);
-  fclose(fhout);
+    us_conn_t *c = ev.data.ptr;
+    status = us_conn_handle(c, /* nonblocking = */ true);
+    if (status == EAGAIN)
+      status = us_epoll_arm(c->fd, c, EPOLL_CTL_MOD, EPOLLOUT);
+    else if (status == 0)
+      status = us_epoll_arm(c->fd, c, EPOLL_CTL_MOD, EPOLLIN);
+    if (status != 0) {
+      epoll_ctl(epoll_fd, EPOLL_CTL_DEL, c->fd, NULL);
+      us_conn_unregister(c);
+      us_conn_destroy(c);
+    }
+  }
 
-  pthread_exit((void *)0);
   return (void *)0;
-} /* void *us_handle_client */
-
-static void *us_server_thread(void __attribute__((unused)) * arg) {
-  int status;
-  int *remote_fd;
-  pthread_t th;
+} /* }}} void *us_worker_thread */
 
+static int us_server_start(void) /* {{{ */
+{
   if (us_open_socket() != 0)
-    pthread_exit((void *)1);
+    return -1;
+
+  if (us_set_nonblocking(sock_fd) != 0)
+    return -1;
+
+  epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+  if (epoll_fd < 0) {
+    ERROR("unixsock plugin: epoll_create1 failed: %s", STRERRNO);
+    return -1;
+  }
+
+  if (pipe(shutdown_pipe) != 0) {
+    ERROR("unixsock plugin: pipe failed: %s", STRERRNO);
+    return -1;
+  }
+
+  /* The shutdown pipe stays readable and wakes up all workers. */
+  struct epoll_event ev = {
+      .events = EPOLLIN,
+      .data.ptr = &shutdown_pipe,
+  };
+  if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, shutdown_pipe[0], &ev) != 0) {
+    ERROR("unixsock plugin: epoll_ctl failed: %s", STRERRNO);
+    return -1;
+  }
+
+  if (us_epoll_arm(sock_fd, &sock_fd, EPOLL_CTL_ADD, EPOLLIN) != 0)
+    return -1;
+
+  workers = calloc(workers_num, sizeof(*workers));
+  if (workers == NULL) {
+    ERROR("unixsock plugin: calloc failed.");
+    return -1;
+  }
+
+  for (size_t i = 0; i < workers_num; i++) {
+    int status = plugin_thread_create(&workers[i], us_worker_thread, NULL,
+                                      "unixsock worker");
+    if (status != 0) {
+      ERROR("unixsock plugin: pthread_create failed: %s", STRERROR(status));
+      workers_num = i;
+      return -1;
+    }
+  }
+
+  return 0;
+} /* }}} int us_server_start */
+
+static void us_server_stop(void) /* {{{ */
+{
+  if (shutdown_pipe[1] >= 0) {
+    if (write(shutdown_pipe[1], "", 1) != 1)
+      ERROR("unixsock plugin: write failed: %s", STRERRNO);
+  }
 
+  for (size_t i = 0; i < workers_num; i++)
+    pthread_join(workers[i], NULL);
+  sfree(workers);
+  workers_num = 0;
+
+  /* No worker is running, so the remaining connections can be closed. */
+  while (conns != NULL) {
+    us_conn_t *c = conns;
+    us_conn_unregister(c);
+    us_conn_destroy(c);
+  }
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(shutdown_pipe); i++) {
+    if (shutdown_pipe[i] >= 0)
+      close(shutdown_pipe[i]);
+    shutdown_pipe[i] = -1;
+  }
+  if (epoll_fd >= 0)
+    close(epoll_fd);
+  epoll_fd = -1;
+} /* }}} void us_server_stop */
+
+#else /* !HAVE_SYS_EPOLL_H */
+/* Without epoll, every connection is handled by its own thread. */
+static void *us_handle_client(void *arg) /* {{{ */
+{
+  us_conn_t *c = arg;
+
+  DEBUG("unixsock plugin: us_handle_client: Reading from fd #%i", c->fd);
+
+  while (us_conn_handle(c, /* nonblocking = */ false) == 0)
+    ;
+
+  DEBUG("unixsock plugin: us_handle_client: Exiting..");
+  us_conn_destroy(c);
+  return (void *)0;
+} /* }}} void *us_handle_client */
+
+static void *us_server_thread(void __attribute__((unused)) * arg) /* {{{ */
+{
   while (loop != 0) {
     DEBUG("unixsock plugin: Calling accept..");
-    status = accept(sock_fd, NULL, NULL);
-    if (status < 0) {
-
+    int fd = accept(sock_fd, NULL, NULL);
+    if (fd < 0) {
       if (errno == EINTR)
         continue;
 
       ERROR("unixsock plugin: accept failed: %s", STRERRNO);
-      close(sock_fd);
-      sock_fd = -1;
-      pthread_exit((void *)1);
+      break;
     }
 
-    remote_fd = malloc(sizeof(*remote_fd));
-    if (remote_fd == NULL) {
-      WARNING("unixsock plugin: malloc failed: %s", STRERRNO);
-      close(status);
+    us_conn_t *c = us_conn_create(fd);
+    if (c == NULL) {
+      close(fd);
       continue;
     }
-    *remote_fd = status;
 
-    DEBUG("Spawning child to handle connection on fd #%i", *remote_fd);
+    DEBUG("Spawning child to handle connection on fd #%i", fd);
 
-    status = plugin_thread_create(&th, us_handle_client, (void *)remote_fd,
-                                  "unixsock conn");
+    pthread_t th;
+    int status =
+        plugin_thread_create(&th, us_handle_client, c, "unixsock conn");
     if (status == 0) {
       pthread_detach(th);
     } else {
-      WARNING("unixsock plugin: pthread_create failed: %s", STRERRNO);
-      close(*remote_fd);
-      free(remote_fd);
-      continue;
+      WARNING("unixsock plugin: pthread_create failed: %s", STRERROR(status));
+      us_conn_destroy(c);
     }
   } /* while (loop) */
 
-  close(sock_fd);
-  sock_fd = -1;
+  return (void *)0;
+} /* }}} void *us_server_thread */
+
+static int us_server_start(void) /* {{{ */
+{
+  if (us_open_socket() != 0)
+    return -1;
 
-  status = unlink((sock_file != NULL) ? sock_file : US_DEFAULT_PATH);
+  int status = plugin_thread_create(&listen_thread, us_server_thread, NULL,
+                                    "unixsock listen");
   if (status != 0) {
-    NOTICE("unixsock plugin: unlink (%s) failed: %s",
-           (sock_file != NULL) ? sock_file : US_DEFAULT_PATH, STRERRNO);
+    ERROR("unixsock plugin: pthread_create failed: %s", STRERROR(status));
+    return -1;
   }
 
-  return (void *)0;
-} /* void *us_server_thread */
+  return 0;
+} /* }}} int us_server_start */
+
+static void us_server_stop(void) /* {{{ */
+{
+  if (listen_thread != (pthread_t)0) {
+    pthread_kill(listen_thread, SIGTERM);
+    pthread_join(listen_thread, NULL);
+    listen_thread = (pthread_t)0;
+  }
+} /* }}} void us_server_stop */
+#endif /* HAVE_SYS_EPOLL_H */
 
 static int us_config(const char *key, const char *val) {
   if (strcasecmp(key, "SocketFile") == 0) {
@@ -348,6 +883,18 @@ static int us_config(const char *key, const char *val) {
       delete_socket = true;
     else
       delete_socket = false;
+  } else if (strcasecmp(key, "WorkerThreads") == 0) {
+    int tmp = atoi(val);
+    if ((tmp < 1) || (tmp > 256)) {
+      ERROR("unixsock plugin: The value for \"WorkerThreads\" must be between "
+            "1 and 256.");
+      return 1;
+    }
+#if !HAVE_SYS_EPOLL_H
+    WARNING("unixsock plugin: The \"WorkerThreads\" option requires epoll "
+            "and is ignored on this system.");
+#endif
+    workers_num = (size_t)tmp;
   } else {
     return -1;
   }
@@ -358,8 +905,6 @@ static int us_config(const char *key, const char *val) {
 static int us_init(void) {
   static int have_init;
 
-  int status;
-
   /* Initialize only once. */
   if (have_init != 0)
     return 0;
@@ -367,10 +912,8 @@ static int us_init(void) {
 
   loop = 1;
 
-  status = plugin_thread_create(&listen_thread, us_server_thread, NULL,
-                                "unixsock listen");
-  if (status != 0) {
-    ERROR("unixsock plugin: pthread_create failed: %s", STRERRNO);
+  if (us_server_start() != 0) {
+    us_server_stop();
     return -1;
   }
 
@@ -378,14 +921,17 @@ static int us_init(void) {
 } /* int us_init */
 
 static int us_shutdown(void) {
-  void *ret;
-
   loop = 0;
 
-  if (listen_thread != (pthread_t)0) {
-    pthread_kill(listen_thread, SIGTERM);
-    pthread_join(listen_thread, &ret);
-    listen_thread = (pthread_t)0;
+  us_server_stop();
+
+  if (sock_fd >= 0) {
+    close(sock_fd);
+    sock_fd = -1;
+
+    char const *path = (sock_file != NULL) ? sock_file : US_DEFAULT_PATH;
+    if (unlink(path) != 0)
+      NOTICE("unixsock plugin: unlink (%s) failed: %s", path, STRERRNO);
   }
 
   plugin_unregister_init("unixsock");
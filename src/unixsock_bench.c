@@ -0,0 +1,308 @@
+/**
+ * collectd - src/unixsock_bench.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/*
+ * Measures how many values per second the unixsock plugin accepts. Build with
+ * "make bench_unixsock" and run against a running daemon as
+ * "./bench_unixsock <socket> [clients] [values per client]".
+ *
+ * "putval" sends one PUTVAL command at a time with lcc_putval() and waits
+ * for each response, like collectdctl does. "pipelined" sends BATCH_SIZE
+ * PUTVAL commands with one write before reading the responses. "putbin"
+ * sends the values in the binary network format with one PUTBIN command per
+ * BATCH_SIZE values, created with lcc_network_buffer_t.
+ */
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "collectd/client.h"
+#include "collectd/network_buffer.h"
+
+#define BATCH_SIZE 200
+#define BUFFER_SIZE 65536
+
+typedef enum { MODE_PUTVAL, MODE_PIPELINED, MODE_PUTBIN } bench_mode_t;
+
+static char const *socket_path;
+static long values_per_client = 100000;
+
+typedef struct {
+  bench_mode_t mode;
+  int id;
+  int status;
+} client_t;
+
+static double now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (double)ts.tv_sec + (double)ts.tv_nsec / 1e9;
+}
+
+static int raw_connect(void) {
+  struct sockaddr_un sa = {.sun_family = AF_UNIX};
+  snprintf(sa.sun_path, sizeof(sa.sun_path), "%s", socket_path);
+
+  int fd = socket(PF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return -1;
+  if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+static int write_all(int fd, char const *buffer, size_t size) {
+  while (size > 0) {
+    ssize_t status = write(fd, buffer, size);
+    if (status < 0) {
+      if (errno == EINTR)
+        continue;
+      return -1;
+    }
+    buffer += status;
+    size -= (size_t)status;
+  }
+  return 0;
+}
+
+/* Reads `num' response lines and fails if one is not successful. */
+static int read_responses(int fd, size_t num) {
+  char buffer[4096];
+  bool line_start = true;
+
+  while (num > 0) {
+    ssize_t len = read(fd, buffer, sizeof(buffer));
+    if (len <= 0)
+      return -1;
+
+    for (ssize_t i = 0; i < len; i++) {
+      if (line_start && (buffer[i] == '-')) {
+        fprintf(stderr, "error response: %.*s\n", (int)(len - i), buffer + i);
+        return -1;
+      }
+      line_start = (buffer[i] == '\n');
+      if (line_start)
+        num--;
+    }
+  }
+  return 0;
+}
+
+static int run_putval(client_t *c) {
+  lcc_connection_t *con = NULL;
+  if (lcc_connect(socket_path, &con) != 0)
+    return -1;
+
+  value_t value;
+  int type = LCC_TYPE_GAUGE;
+  lcc_value_list_t vl = LCC_VALUE_LIST_INIT;
+  vl.values = &value;
+  vl.values_types = &type;
+  vl.values_len = 1;
+  snprintf(vl.identifier.plugin, sizeof(vl.identifier.plugin), "bench");
+  snprintf(vl.identifier.type, sizeof(vl.identifier.type), "gauge");
+
+  for (long i = 0; i < values_per_client; i++) {
+    value.gauge = (double)i;
+    snprintf(vl.identifier.type_instance, sizeof(vl.identifier.type_instance),
+             "%d-%ld", c->id, i % 100);
+    if (lcc_putval(con, &vl) != 0) {
+      fprintf(stderr, "lcc_putval failed: %s\n", lcc_strerror(con));
+      lcc_disconnect(con);
+      return -1;
+    }
+  }
+
+  lcc_disconnect(con);
+  return 0;
+}
+
+static int run_pipelined(client_t *c) {
+  int fd = raw_connect();
+  if (fd < 0)
+    return -1;
+
+  char *buffer = malloc(BUFFER_SIZE);
+  if (buffer == NULL) {
+    close(fd);
+    return -1;
+  }
+
+  int status = 0;
+  for (long i = 0; (status == 0) && (i < values_per_client);) {
+    size_t size = 0;
+    size_t num = 0;
+    for (; (num < BATCH_SIZE) && (i < values_per_client); num++, i++)
+      size += (size_t)snprintf(buffer + size, BUFFER_SIZE - size,
+                               "PUTVAL localhost/bench/gauge-%d-%ld N:%ld\n",
+                               c->id, i % 100, i);
+
+    status = write_all(fd, buffer, size);
+    if (status == 0)
+      status = read_responses(fd, num);
+  }
+
+  free(buffer);
+  close(fd);
+  return status;
+}
+
+static int run_putbin(client_t *c) {
+  int fd = raw_connect();
+  if (fd < 0)
+    return -1;
+
+  lcc_network_buffer_t *nb = lcc_network_buffer_create(BUFFER_SIZE - 64);
+  char *buffer = malloc(BUFFER_SIZE);
+  if ((nb == NULL) || (buffer == NULL)) {
+    lcc_network_buffer_destroy(nb);
+    free(buffer);
+    close(fd);
+    return -1;
+  }
+
+  value_t value;
+  int type = LCC_TYPE_GAUGE;
+  lcc_value_list_t vl = LCC_VALUE_LIST_INIT;
+  vl.values = &value;
+  vl.values_types = &type;
+  vl.values_len = 1;
+  snprintf(vl.identifier.plugin, sizeof(vl.identifier.plugin), "bench");
+  snprintf(vl.identifier.type, sizeof(vl.identifier.type), "gauge");
+
+  int status = 0;
+  for (long i = 0; (status == 0) && (i < values_per_client);) {
+    lcc_network_buffer_initialize(nb);
+    for (size_t num = 0; (num < BATCH_SIZE) && (i < values_per_client);
+         num++, i++) {
+      value.gauge = (double)i;
+      snprintf(vl.identifier.type_instance,
+               sizeof(vl.identifier.type_instance), "%d-%ld", c->id, i % 100);
+      if (lcc_network_buffer_add_value(nb, &vl) != 0) {
+        status = -1;
+        break;
+      }
+    }
+    lcc_network_buffer_finalize(nb);
+
+    size_t data_size = 0;
+    lcc_network_buffer_get(nb, NULL, &data_size);
+    int header_size = snprintf(buffer, BUFFER_SIZE, "PUTBIN %zu\n", data_size);
+    size_t size = BUFFER_SIZE - (size_t)header_size;
+    lcc_network_buffer_get(nb, buffer + header_size, &size);
+
+    if (status == 0)
+      status = write_all(fd, buffer, (size_t)header_size + data_size);
+    if (status == 0)
+      status = read_responses(fd, 1);
+  }
+
+  lcc_network_buffer_destroy(nb);
+  free(buffer);
+  close(fd);
+  return status;
+}
+
+static void *client_thread(void *arg) {
+  client_t *c = arg;
+
+  switch (c->mode) {
+  case MODE_PUTVAL:
+    c->status = run_putval(c);
+    break;
+  case MODE_PIPELINED:
+    c->status = run_pipelined(c);
+    break;
+  case MODE_PUTBIN:
+    c->status = run_putbin(c);
+    break;
+  }
+  return NULL;
+}
+
+static int run(char const *name, bench_mode_t mode, int clients_num) {
+  client_t clients[clients_num];
+  pthread_t threads[clients_num];
+
+  double start = now();
+  for (int i = 0; i < clients_num; i++) {
+    clients[i] = (client_t){.mode = mode, .id = i};
+    pthread_create(&threads[i], NULL, client_thread, &clients[i]);
+  }
+
+  int status = 0;
+  for (int i = 0; i < clients_num; i++) {
+    pthread_join(threads[i], NULL);
+    if (clients[i].status != 0)
+      status = -1;
+  }
+  double elapsed = now() - start;
+
+  if (status != 0) {
+    printf("%-10s failed\n", name);
+    return -1;
+  }
+
+  double total = (double)clients_num * (double)values_per_client;
+  printf("%-10s %2d clients %10.0f values/s\n", name, clients_num,
+         total / elapsed);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <socket> [clients] [values per client]\n",
+            argv[0]);
+    return 1;
+  }
+
+  socket_path = argv[1];
+  int clients_num = (argc > 2) ? atoi(argv[2]) : 4;
+  if (argc > 3)
+    values_per_client = atol(argv[3]);
+  if ((clients_num < 1) || (values_per_client < 1)) {
+    fprintf(stderr, "Invalid arguments.\n");
+    return 1;
+  }
+
+  int status = 0;
+  status |= run("putval", MODE_PUTVAL, clients_num);
+  status |= run("pipelined", MODE_PIPELINED, clients_num);
+  status |= run("putbin", MODE_PUTBIN, clients_num);
+
+  return (status == 0) ? 0 : 1;
+}
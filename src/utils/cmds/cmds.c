@@ -57,8 +57,12 @@ static cmd_status_t cmd_split(char *buffer, size_t *ret_len, char ***ret_fields,
   in_field = false;
   for (char *string = buffer; *string != '\0'; ++string) {
     /* Make a quick worst-case estimate of the number of fields by
-     * counting spaces and ignoring quotation marks. */
-    if (!isspace((int)*string)) {
+     * counting spaces. A quotation mark may start a new field even without
+     * a space in front of it, as in `"a""b"'. */
+    if (*string == '"') {
+      estimate++;
+      in_field = true;
+    } else if (!isspace((int)*string)) {
       if (!in_field) {
         estimate++;
         in_field = true;
@@ -115,6 +115,8 @@ typedef enum {
 
   /* Not necessarily fatal errors. */
   CMD_NO_OPTION = 1,
+  /* A fast path parser can not handle the command. */
+  CMD_UNSUPPORTED = 2,
 } cmd_status_t;
 
 /*
@@ -0,0 +1,153 @@
+/**
+ * collectd - src/utils/cmds/cmds_bench.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/*
+ * Measures the throughput of the PUTVAL parsers. Build with "make bench_cmds"
+ * and run as "./bench_cmds [iterations]".
+ *
+ * "cmd_parse" parses typical PUTVAL commands, as created by
+ * cmds_fuzz_putval(), with cmd_parse(). As cmd_parse() modifies its input,
+ * every command is copied first. "putval_fast" parses the same commands with
+ * cmd_parse_putval_fast(), which is used by cmd_handle_putval() and the
+ * unixsock plugin. "strtod" and "cmd_strtod" compare the number scanners on
+ * the values of the commands.
+ *
+ * cdtime() returns a fixed time when linked against the mock library, so the
+ * elapsed time is measured with clock_gettime().
+ */
+
+#include "collectd.h"
+
+#include "utils/cmds/cmds.h"
+#include "utils/cmds/cmds_fuzz.h"
+#include "utils/cmds/parse_number.h"
+#include "utils/cmds/putval.h"
+#include "utils/common/common.h"
+#include "utils_time.h"
+
+#define CORPUS_SIZE 1000
+#define LINE_SIZE 256
+
+static char lines[CORPUS_SIZE][LINE_SIZE];
+static char numbers[CORPUS_SIZE][64];
+
+static void init_corpus(void) {
+  unsigned int seed = 1;
+
+  for (size_t i = 0; i < CORPUS_SIZE; i++) {
+    cmds_fuzz_putval(lines[i], LINE_SIZE, &seed, /* fuzz = */ false);
+
+    char const *value = strrchr(lines[i], ':');
+    sstrncpy(numbers[i], value + 1, sizeof(numbers[i]));
+  }
+}
+
+static cdtime_t now(void) {
+  struct timespec ts = {0};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return TIMESPEC_TO_CDTIME_T(&ts);
+}
+
+static void report(char const *name, cdtime_t start, size_t num) {
+  double seconds = CDTIME_T_TO_DOUBLE(now() - start);
+  printf("%-12s %10.0f per second\n", name, num / seconds);
+}
+
+static int bench_cmd_parse(size_t iterations) {
+  cmd_error_handler_t err = {NULL, NULL};
+  char buffer[LINE_SIZE];
+  cdtime_t start = now();
+
+  for (size_t n = 0; n < iterations; n++) {
+    for (size_t i = 0; i < CORPUS_SIZE; i++) {
+      cmd_t cmd;
+
+      memcpy(buffer, lines[i], sizeof(buffer));
+      if (cmd_parse(buffer, &cmd, NULL, &err) != CMD_OK)
+        return -1;
+      cmd_destroy(&cmd);
+    }
+  }
+
+  report("cmd_parse", start, iterations * CORPUS_SIZE);
+  return 0;
+}
+
+static int bench_putval_fast(size_t iterations) {
+  value_t values[8];
+  value_list_t vl = {.values = values};
+  cdtime_t start = now();
+
+  for (size_t n = 0; n < iterations; n++) {
+    for (size_t i = 0; i < CORPUS_SIZE; i++) {
+      if (cmd_parse_putval_fast(lines[i], &vl, STATIC_ARRAY_SIZE(values),
+                                NULL) != CMD_OK)
+        return -1;
+      meta_data_destroy(vl.meta);
+    }
+  }
+
+  report("putval_fast", start, iterations * CORPUS_SIZE);
+  return 0;
+}
+
+static double bench_strtod(size_t iterations,
+                           double (*scan)(char const *, char **),
+                           char const *name) {
+  double sum = 0.0;
+  cdtime_t start = now();
+
+  for (size_t n = 0; n < iterations; n++)
+    for (size_t i = 0; i < CORPUS_SIZE; i++)
+      sum += scan(numbers[i], NULL);
+
+  report(name, start, iterations * CORPUS_SIZE);
+  return sum;
+}
+
+static double libc_strtod(char const *str, char **endptr) {
+  return strtod(str, endptr);
+}
+
+int main(int argc, char **argv) {
+  size_t iterations = 1000;
+  if (argc > 1)
+    iterations = (size_t)strtoull(argv[1], NULL, 0);
+
+  init_corpus();
+
+  if ((bench_cmd_parse(iterations) != 0) ||
+      (bench_putval_fast(iterations) != 0)) {
+    fprintf(stderr, "Parsing failed.\n");
+    return 1;
+  }
+
+  /* Compare the sums, so the compiler can not drop the calls. */
+  double want = bench_strtod(iterations, libc_strtod, "strtod");
+  double got = bench_strtod(iterations, cmd_strtod, "cmd_strtod");
+  if (want != got) {
+    fprintf(stderr, "The scanners disagree.\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,273 @@
+/**
+ * collectd - src/utils/cmds/cmds_fuzz.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/*
+ * Generates PUTVAL commands for test_utils_cmds and bench_cmds. The commands
+ * use the types of the mock plugin library: "MAGIC" (one derive),
+ * "MAGIC_GAUGE" (one gauge) and "MAGIC_MULTI" (counter, gauge, derive and
+ * absolute).
+ *
+ * Typical commands look like the ones sent by exec scripts and
+ * libcollectdclient. Fuzzed commands additionally contain every quirk the
+ * text protocol accepts, such as quoting, hexadecimal and octal numbers, a
+ * missing or repeated value, several value lists and unknown options, and
+ * are then mutated randomly.
+ */
+
+#ifndef UTILS_CMDS_FUZZ_H
+#define UTILS_CMDS_FUZZ_H 1
+
+#include "collectd.h"
+
+#include "utils/common/common.h"
+
+static unsigned int cmds_fuzz_rand(unsigned int *seed) /* {{{ */
+{
+  /* A linear congruential generator, which is good enough here and gives the
+   * same sequence everywhere. */
+  *seed = *seed * 1103515245 + 12345;
+  return (*seed >> 16) & 0x7fff;
+} /* }}} unsigned int cmds_fuzz_rand */
+
+#define CMDS_FUZZ_PICK(seed, array)                                            \
+  (array)[cmds_fuzz_rand(seed) % (sizeof(array) / sizeof((array)[0]))]
+
+static void cmds_fuzz_append(char *buffer, size_t size, /* {{{ */
+                             char const *format, ...) {
+  size_t len = strlen(buffer);
+  if (len >= size - 1)
+    return;
+
+  va_list ap;
+  va_start(ap, format);
+  vsnprintf(buffer + len, size - len, format, ap);
+  va_end(ap);
+} /* }}} void cmds_fuzz_append */
+
+/* Appends a value for a data source of type `ds_type'. */
+static void cmds_fuzz_value(char *buffer, size_t size, /* {{{ */
+                            unsigned int *seed, int ds_type, bool fuzz) {
+  static char const *special[] = {
+      "U",
+      "0",
+      "-0",
+      "+3",
+      "-3",
+      "0x1F",
+      "017",
+      ".5",
+      "5.",
+      "0.1",
+      "4.35",
+      "1e3",
+      "1E-3",
+      "-.5e+2",
+      "1e",
+      "1x",
+      " 7",
+      "",
+      "nan",
+      "-inf",
+      "1e400",
+      "1e-400",
+      "0.000000000000000000000001",
+      "9007199254740993",
+      "123456789012345678901234",
+      "18446744073709551615",
+      "-9223372036854775808",
+  };
+
+  if (fuzz && (cmds_fuzz_rand(seed) % 4 == 0)) {
+    cmds_fuzz_append(buffer, size, "%s", CMDS_FUZZ_PICK(seed, special));
+    return;
+  }
+
+  unsigned int r = cmds_fuzz_rand(seed);
+  if (ds_type == DS_TYPE_GAUGE)
+    cmds_fuzz_append(buffer, size, "%s%u.%0*u", (r % 3 == 0) ? "-" : "",
+                     cmds_fuzz_rand(seed) % 100000, (int)(r % 7),
+                     cmds_fuzz_rand(seed) % 10000);
+  else if (ds_type == DS_TYPE_DERIVE)
+    cmds_fuzz_append(buffer, size, "%s%u%04u", (r % 5 == 0) ? "-" : "",
+                     cmds_fuzz_rand(seed), cmds_fuzz_rand(seed) % 10000);
+  else
+    cmds_fuzz_append(buffer, size, "%u", cmds_fuzz_rand(seed) * r);
+} /* }}} void cmds_fuzz_value */
+
+static void cmds_fuzz_value_list(char *buffer, size_t size, /* {{{ */
+                                 unsigned int *seed, char const *type,
+                                 bool fuzz) {
+  static int const magic[] = {DS_TYPE_DERIVE};
+  static int const magic_gauge[] = {DS_TYPE_GAUGE};
+  static int const magic_multi[] = {DS_TYPE_COUNTER, DS_TYPE_GAUGE,
+                                    DS_TYPE_DERIVE, DS_TYPE_ABSOLUTE};
+  static char const *times[] = {"N", "1500000000", "1500000000.25", "0",
+                                "1.5e9", "-1", "x", ""};
+
+  int const *ds_types = magic_multi;
+  size_t ds_num = 4;
+  if (strcmp("MAGIC", type) == 0) {
+    ds_types = magic;
+    ds_num = 1;
+  } else if (strcmp("MAGIC_GAUGE", type) == 0) {
+    ds_types = magic_gauge;
+    ds_num = 1;
+  }
+
+  if (fuzz && (cmds_fuzz_rand(seed) % 8 == 0))
+    cmds_fuzz_append(buffer, size, "%s", CMDS_FUZZ_PICK(seed, times));
+  else if (cmds_fuzz_rand(seed) % 2 == 0)
+    cmds_fuzz_append(buffer, size, "N");
+  else
+    cmds_fuzz_append(buffer, size, "%u", 1500000000 + cmds_fuzz_rand(seed));
+
+  /* Sometimes one value too few or too many. */
+  size_t num = ds_num;
+  if (fuzz && (cmds_fuzz_rand(seed) % 10 == 0))
+    num = ds_num - 1 + cmds_fuzz_rand(seed) % 3;
+
+  for (size_t i = 0; i < num; i++) {
+    cmds_fuzz_append(buffer, size, (fuzz && (cmds_fuzz_rand(seed) % 30 == 0))
+                                       ? "::"
+                                       : ":");
+    cmds_fuzz_value(buffer, size, seed, ds_types[i % ds_num], fuzz);
+  }
+
+  if (fuzz && (cmds_fuzz_rand(seed) % 30 == 0))
+    cmds_fuzz_append(buffer, size, ":");
+} /* }}} void cmds_fuzz_value_list */
+
+/* Replaces, inserts or removes a few random characters. */
+static void cmds_fuzz_mutate(char *buffer, size_t size, /* {{{ */
+                             unsigned int *seed) {
+  static char const alphabet[] = " \t\"\\:=/-.eUNx0123456789aZ";
+
+  int mutations = 1 + cmds_fuzz_rand(seed) % 3;
+  for (int i = 0; i < mutations; i++) {
+    size_t len = strlen(buffer);
+    if (len == 0)
+      return;
+    size_t pos = cmds_fuzz_rand(seed) % len;
+    char c = alphabet[cmds_fuzz_rand(seed) % (sizeof(alphabet) - 1)];
+
+    switch (cmds_fuzz_rand(seed) % 3) {
+    case 0:
+      buffer[pos] = c;
+      break;
+    case 1:
+      if (len + 1 < size) {
+        memmove(buffer + pos + 1, buffer + pos, len - pos + 1);
+        buffer[pos] = c;
+      }
+      break;
+    case 2:
+      memmove(buffer + pos, buffer + pos + 1, len - pos);
+      break;
+    }
+  }
+} /* }}} void cmds_fuzz_mutate */
+
+/*
+ * NAME
+ *   cmds_fuzz_putval
+ *
+ * DESCRIPTION
+ *   Writes a PUTVAL command to `buffer', which is `size' bytes long. With
+ *   `fuzz' set to false, the command is typical and valid. `seed' is the state
+ *   of the random number generator.
+ */
+static void cmds_fuzz_putval(char *buffer, size_t size, /* {{{ */
+                             unsigned int *seed, bool fuzz) {
+  static char const *commands[] = {"PUTVAL", "putval", "\"PUTVAL\"",
+                                   "PUTVALX"};
+  static char const *hosts[] = {"localhost", "example.com", "host-1", ""};
+  static char const *plugins[] = {"exec", "app-main", "app-with-dash-es",
+                                  "\"quoted plugin\"", "a\\b"};
+  static char const *types[] = {"MAGIC", "MAGIC_GAUGE", "MAGIC_MULTI",
+                                "MAGIC_GAUGE-requests", "MAGIC-with-dash",
+                                "UNKNOWN"};
+  static char const *options[] = {
+      "interval=10",       "interval=0.5",      "interval=-1",
+      "interval=x",        "interval=",         "INTERVAL=2e1",
+      "meta:key=\"\\\"string\\\"\"", "meta:other=\"\\\"a b\\\"\"",
+      "meta:key=unquoted", "unknown=1",         "=1",
+  };
+
+  buffer[0] = '\0';
+
+  char const *type = "MAGIC_GAUGE";
+  if (!fuzz) {
+    type = CMDS_FUZZ_PICK(seed, types);
+    if (strcmp("UNKNOWN", type) == 0)
+      type = "MAGIC_MULTI";
+    cmds_fuzz_append(buffer, size, "PUTVAL %s/%s/%s",
+                     (cmds_fuzz_rand(seed) % 2) ? "localhost" : "host-1",
+                     (cmds_fuzz_rand(seed) % 2) ? "exec" : "app-main", type);
+    if (cmds_fuzz_rand(seed) % 2 == 0)
+      cmds_fuzz_append(buffer, size, " interval=10");
+    cmds_fuzz_append(buffer, size, " ");
+    /* Strip the type instance for the value list. */
+    char base_type[32];
+    sstrncpy(base_type, type, sizeof(base_type));
+    char *dash = strchr(base_type, '-');
+    if (dash != NULL)
+      *dash = '\0';
+    cmds_fuzz_value_list(buffer, size, seed, base_type, false);
+    return;
+  }
+
+  cmds_fuzz_append(buffer, size, "%s ", CMDS_FUZZ_PICK(seed, commands));
+
+  type = CMDS_FUZZ_PICK(seed, types);
+  bool quote = (cmds_fuzz_rand(seed) % 5 == 0);
+  cmds_fuzz_append(buffer, size, "%s%s/%s/%s-i%u%s", quote ? "\"" : "",
+                   CMDS_FUZZ_PICK(seed, hosts), CMDS_FUZZ_PICK(seed, plugins),
+                   type, cmds_fuzz_rand(seed) % 10, quote ? "\"" : "");
+
+  char base_type[32];
+  sstrncpy(base_type, type, sizeof(base_type));
+  char *dash = strchr(base_type, '-');
+  if (dash != NULL)
+    *dash = '\0';
+
+  int fields = 1 + cmds_fuzz_rand(seed) % 4;
+  for (int i = 0; i < fields; i++) {
+    cmds_fuzz_append(buffer, size, (cmds_fuzz_rand(seed) % 8) ? " " : "\t ");
+    if (cmds_fuzz_rand(seed) % 3 == 0) {
+      cmds_fuzz_append(buffer, size, "%s", CMDS_FUZZ_PICK(seed, options));
+      continue;
+    }
+
+    quote = (cmds_fuzz_rand(seed) % 8 == 0);
+    if (quote)
+      cmds_fuzz_append(buffer, size, "\"");
+    cmds_fuzz_value_list(buffer, size, seed, base_type, true);
+    if (quote)
+      cmds_fuzz_append(buffer, size, "\"");
+  }
+
+  if (cmds_fuzz_rand(seed) % 4 == 0)
+    cmds_fuzz_mutate(buffer, size, seed);
+} /* }}} void cmds_fuzz_putval */
+
+#endif /* UTILS_CMDS_FUZZ_H */
@@ -32,8 +32,18 @@
 #include "utils/common/common.h"
 #include "testing.h"
 #include "utils/cmds/cmds.h"
+#include "utils/cmds/cmds_fuzz.h"
+#include "utils/cmds/parse_number.h"
+#include "utils/cmds/putbin.h"
+#include "utils/cmds/putnotif.h"
+#include "utils/cmds/putval.h"
+#include "network.h"
 // clang-format on
 
+#if HAVE_ARPA_INET_H
+#include <arpa/inet.h>
+#endif
+
 static void error_cb(void *ud, cmd_status_t status, const char *format,
                      va_list ap) {
   if (status == CMD_OK)
@@ -217,6 +227,20 @@ static struct {
         CMD_PUTVAL,
     },
 
+    {
+        /* Adjacent quoted strings are separate fields. */
+        "PUTVAL \"myhost/magic/MAGIC\"\"N:42\"",
+        NULL,
+        CMD_OK,
+        CMD_PUTVAL,
+    },
+    {
+        /* Every value list owns its meta data. */
+        "PUTVAL myhost/magic/MAGIC meta:key=\"\\\"value\\\"\" N:1 N:2",
+        NULL,
+        CMD_OK,
+        CMD_PUTVAL,
+    },
     /* Invalid PUTVAL commands. */
     {
         "PUTVAL magic/MAGIC N:42",
@@ -330,7 +354,389 @@ DEF_TEST(parse) {
   return test_result;
 }
 
+/* Appends a part of the network protocol to `buffer'. */
+static size_t putbin_part(char *buffer, size_t offset, uint16_t type,
+                          void const *payload, size_t payload_size) {
+  uint16_t tmp16 = htons(type);
+  memcpy(buffer + offset, &tmp16, sizeof(tmp16));
+  tmp16 = htons((uint16_t)(2 * sizeof(tmp16) + payload_size));
+  memcpy(buffer + offset + sizeof(tmp16), &tmp16, sizeof(tmp16));
+  memcpy(buffer + offset + 2 * sizeof(tmp16), payload, payload_size);
+  return offset + 2 * sizeof(tmp16) + payload_size;
+}
+
+static size_t putbin_derive(char *buffer, size_t offset, derive_t value) {
+  char payload[sizeof(uint16_t) + sizeof(uint8_t) + sizeof(uint64_t)];
+  uint16_t num = htons(1);
+  uint64_t tmp64 = htonll((uint64_t)value);
+  memcpy(payload, &num, sizeof(num));
+  payload[sizeof(num)] = DS_TYPE_DERIVE;
+  memcpy(payload + sizeof(num) + 1, &tmp64, sizeof(tmp64));
+  return putbin_part(buffer, offset, TYPE_VALUES, payload, sizeof(payload));
+}
+
+static derive_t putbin_sum;
+
+static int putbin_cb(value_list_t const *vl, void *ud) {
+  size_t *num = ud;
+  if ((strcmp("example.com", vl->host) != 0) ||
+      (strcmp("MAGIC", vl->type) != 0) || (vl->values_len != 1))
+    return -1;
+  if (vl->time != TIME_T_TO_CDTIME_T(1500000000))
+    return -1;
+
+  putbin_sum += vl->values[0].derive;
+  (*num)++;
+  return 0;
+}
+
+DEF_TEST(putbin) {
+  cmd_error_handler_t err = {error_cb, NULL};
+  char buffer[1024];
+  size_t size = 0;
+  uint64_t time = htonll(1500000000);
+
+  size = putbin_part(buffer, size, TYPE_HOST, "example.com", 12);
+  size = putbin_part(buffer, size, TYPE_TIME, &time, sizeof(time));
+  size = putbin_part(buffer, size, TYPE_PLUGIN, "test", 5);
+  size = putbin_part(buffer, size, TYPE_TYPE, "MAGIC", 6);
+  size = putbin_derive(buffer, size, 40);
+  /* Unknown parts, e.g. signatures, are skipped. */
+  size = putbin_part(buffer, size, TYPE_SIGN_SHA256, "xxxx", 4);
+  size = putbin_derive(buffer, size, 2);
+  size_t valid_size = size;
+
+  size_t num = 0;
+  size_t calls = 0;
+  EXPECT_EQ_INT(CMD_OK,
+                cmd_parse_putbin(buffer, size, putbin_cb, &calls, &num, &err));
+  EXPECT_EQ_INT(2, (int)num);
+  EXPECT_EQ_INT(2, (int)calls);
+  EXPECT_EQ_INT(42, (int)putbin_sum);
+
+  /* Truncated data. */
+  EXPECT_EQ_INT(CMD_PARSE_ERROR, cmd_parse_putbin(buffer, valid_size - 1,
+                                                  putbin_cb, &calls, &num,
+                                                  &err));
+  EXPECT_EQ_INT(1, (int)num);
+
+  /* Unknown type. */
+  size = putbin_part(buffer, valid_size, TYPE_TYPE, "unknown", 8);
+  size = putbin_derive(buffer, size, 1);
+  EXPECT_EQ_INT(CMD_PARSE_ERROR,
+                cmd_parse_putbin(buffer, size, putbin_cb, &calls, &num, &err));
+  EXPECT_EQ_INT(2, (int)num);
+
+  /* Strings must be null terminated. */
+  size = putbin_part(buffer, 0, TYPE_HOST, "example.com", 11);
+  EXPECT_EQ_INT(CMD_PARSE_ERROR,
+                cmd_parse_putbin(buffer, size, putbin_cb, &calls, &num, &err));
+
+  /* Errors of the callback are passed on. */
+  size = putbin_part(buffer, 0, TYPE_HOST, "other", 6);
+  size = putbin_part(buffer, size, TYPE_TYPE, "MAGIC", 6);
+  size = putbin_derive(buffer, size, 1);
+  EXPECT_EQ_INT(CMD_ERROR,
+                cmd_parse_putbin(buffer, size, putbin_cb, &calls, &num, &err));
+  EXPECT_EQ_INT(0, (int)num);
+
+  return 0;
+}
+
+static char const *number_data[] = {
+    "0",        "-0",        "+0",     "1",         "-1",       "42",
+    "007",      "08",        "0x1F",   "0X1f",      "-0x10",    "1.5",
+    "-1.5",     ".5",        "5.",     ".",         "-.",       "1e3",
+    "1E-3",     "1e+22",     "1e22",   "1e23",      "1e-22",    "1e-23",
+    "1e",       "1e+",       "1x",     "1.5:2",     "  7",      "\t-7",
+    "",         "-",         "+",      "nan",       "-inf",     "infinity",
+    "0.1",      "4.35",      "9007199254740992",    "9007199254740993",
+    "123456789012345678",    "1234567890123456789", "12345678901234567890",
+    "18446744073709551615",  "18446744073709551616",
+    "9223372036854775807",   "9223372036854775808",
+    "-9223372036854775808",  "-9223372036854775809",
+    "1e400",    "1e-400",    "0.000000000000000000000001",
+    "1.7976931348623157e308", "4.9e-324", "00000000000000000000001",
+};
+
+/* Checks that the scanners of parse_number.h return exactly the results of
+ * the C library, including `endptr' and errno. */
+static int check_number(char const *str) {
+  char *want_end;
+  char *got_end;
+
+  errno = 0;
+  double want_d = strtod(str, &want_end);
+  int want_errno = errno;
+  errno = 0;
+  double got_d = cmd_strtod(str, &got_end);
+  if ((memcmp(&want_d, &got_d, sizeof(want_d)) != 0) ||
+      (want_end != got_end) || (want_errno != errno)) {
+    printf("cmd_strtod(\"%s\") = %.17g (end %td, errno %d); want %.17g (end "
+           "%td, errno %d)\n",
+           str, got_d, got_end - str, errno, want_d, want_end - str,
+           want_errno);
+    return -1;
+  }
+
+  errno = 0;
+  long long want_ll = strtoll(str, &want_end, 0);
+  want_errno = errno;
+  errno = 0;
+  int64_t got_ll = cmd_strtoll(str, &got_end);
+  if (((int64_t)want_ll != got_ll) || (want_end != got_end) ||
+      (want_errno != errno)) {
+    printf("cmd_strtoll(\"%s\") = %" PRIi64 "; want %lld\n", str, got_ll,
+           want_ll);
+    return -1;
+  }
+
+  errno = 0;
+  unsigned long long want_ull = strtoull(str, &want_end, 0);
+  want_errno = errno;
+  errno = 0;
+  uint64_t got_ull = cmd_strtoull(str, &got_end);
+  if (((uint64_t)want_ull != got_ull) || (want_end != got_end) ||
+      (want_errno != errno)) {
+    printf("cmd_strtoull(\"%s\") = %" PRIu64 "; want %llu\n", str, got_ull,
+           want_ull);
+    return -1;
+  }
+
+  return 0;
+}
+
+DEF_TEST(parse_number) {
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(number_data); i++)
+    EXPECT_EQ_INT(0, check_number(number_data[i]));
+
+  /* Random decimal numbers around the limits of the fast paths. */
+  unsigned int seed = 1;
+  for (int i = 0; i < 100000; i++) {
+    char str[64];
+    int digits = 1 + (int)(cmds_fuzz_rand(&seed) % 20);
+    size_t len = 0;
+    if (cmds_fuzz_rand(&seed) % 3 == 0)
+      str[len++] = '-';
+    int point = (int)(cmds_fuzz_rand(&seed) % (unsigned int)(digits + 2));
+    for (int j = 0; j < digits; j++) {
+      if (j == point)
+        str[len++] = '.';
+      str[len++] = (char)('0' + cmds_fuzz_rand(&seed) % 10);
+    }
+    if (cmds_fuzz_rand(&seed) % 2 == 0)
+      len += (size_t)snprintf(str + len, sizeof(str) - len, "e%d",
+                              (int)(cmds_fuzz_rand(&seed) % 61) - 30);
+    str[len] = '\0';
+
+    if (check_number(str) != 0)
+      return -1;
+  }
+
+  return 0;
+}
+
+/* Commands which have to be handled by cmd_parse_putval_fast(). */
+static char const *putval_fast_data[] = {
+    "PUTVAL example.com/test/MAGIC N:42",
+    "putval example.com/test/MAGIC_GAUGE N:-4.35",
+    "PUTVAL example.com/test/MAGIC_GAUGE 1500000000.5:U",
+    "PUTVAL example.com/test-inst/MAGIC_MULTI-inst 1500000000:1:2.5:-3:4",
+    "PUTVAL example.com/test/MAGIC interval=10 N:1",
+    "PUTVAL \"example.com/test/MAGIC_GAUGE\" \"N:1\"",
+    "PUTVAL example.com/test/MAGIC meta:key=\"\\\"value\\\"\" N:1",
+    "PUTVAL   example.com/test/MAGIC_GAUGE  \t N:nan  ",
+    "PUTVAL example.com/test/MAGIC_GAUGE N:0x1p3",
+};
+
+/* Commands which have to be passed to cmd_parse(), which may accept them. */
+static char const *putval_slow_data[] = {
+    "PUTVAL example.com/test/MAGIC N:1 N:2",
+    "PUTVAL example.com/test/MAGIC N:1 interval=10",
+    "PUTVAL example.com/test/MAGIC 0:1500000000:1",
+    "PUTVAL example.com/test/MAGIC N::1",
+    "PUTVAL example.com/test/MAGIC N:1:2",
+    "PUTVAL example.com/test/MAGIC_MULTI N:1:2",
+    "PUTVAL example.com/test/MAGIC N:1x",
+    "PUTVAL example.com/test/MAGIC N:U",
+    "PUTVAL example.com/test/MAGIC meta:key=value N:1",
+    "PUTVAL example.com/test/MAGIC unknown=1 N:1",
+    "PUTVAL example.com/test/UNKNOWN N:1",
+    "PUTVAL test/MAGIC N:1",
+    "PUTVAL example.com/test/MAGIC",
+    "PUTVAL example.com/test/MAGIC N:1 \"",
+    "LISTVAL",
+    "",
+};
+
+/* Compares the meta data of two value lists; both hold strings only. */
+static int putval_meta_cmp(meta_data_t *a, meta_data_t *b) {
+  if ((a == NULL) || (b == NULL))
+    return (a == b) ? 0 : -1;
+
+  char **toc = NULL;
+  int num = meta_data_toc(a, &toc);
+  char **other_toc = NULL;
+  int status = (num == meta_data_toc(b, &other_toc)) ? 0 : -1;
+
+  for (int i = 0; i < num; i++) {
+    char *value = NULL;
+    char *other_value = NULL;
+    if ((status == 0) &&
+        ((meta_data_get_string(a, toc[i], &value) != 0) ||
+         (meta_data_get_string(b, toc[i], &other_value) != 0) ||
+         (strcmp(value, other_value) != 0)))
+      status = -1;
+    free(value);
+    free(other_value);
+    free(toc[i]);
+  }
+  for (int i = 0; (other_toc != NULL) && (i < num); i++)
+    free(other_toc[i]);
+  free(toc);
+  free(other_toc);
+  return status;
+}
+
+/* Parses `line' with both parsers. Returns -1 if the fast parser accepted
+ * `line' with a different result than cmd_parse(), or modified it. */
+static int putval_compare(char const *line, cmd_status_t *ret_status) {
+  value_t values[64];
+  value_list_t vl;
+
+  memset(values, 0, sizeof(values));
+  vl.values = values;
+
+  char *copy = strdup(line);
+  cmd_status_t status =
+      cmd_parse_putval_fast(line, &vl, STATIC_ARRAY_SIZE(values), NULL);
+  *ret_status = status;
+  if (strcmp(copy, line) != 0) {
+    printf("cmd_parse_putval_fast(\"%s\") modified its input\n", copy);
+    meta_data_destroy(vl.meta);
+    free(copy);
+    return -1;
+  }
+  if (status == CMD_UNSUPPORTED) {
+    free(copy);
+    return 0;
+  }
+
+  cmd_t cmd = {0};
+  cmd_error_handler_t err = {NULL, NULL};
+  cmd_status_t want = cmd_parse(copy, &cmd, NULL, &err);
+
+  int result = -1;
+  if ((status == CMD_OK) && (want == CMD_OK) && (cmd.type == CMD_PUTVAL) &&
+      (cmd.cmd.putval.vl_num == 1)) {
+    value_list_t *want_vl = cmd.cmd.putval.vl;
+    if ((strcmp(want_vl->host, vl.host) == 0) &&
+        (strcmp(want_vl->plugin, vl.plugin) == 0) &&
+        (strcmp(want_vl->plugin_instance, vl.plugin_instance) == 0) &&
+        (strcmp(want_vl->type, vl.type) == 0) &&
+        (strcmp(want_vl->type_instance, vl.type_instance) == 0) &&
+        (want_vl->time == vl.time) && (want_vl->interval == vl.interval) &&
+        (want_vl->values_len == vl.values_len) &&
+        (memcmp(want_vl->values, vl.values,
+                vl.values_len * sizeof(*vl.values)) == 0) &&
+        (putval_meta_cmp(want_vl->meta, vl.meta) == 0))
+      result = 0;
+  }
+
+  if (result != 0)
+    printf("cmd_parse_putval_fast(\"%s\") differs from cmd_parse() = %d\n",
+           line, want);
+
+  meta_data_destroy(vl.meta);
+  cmd_destroy(&cmd);
+  free(copy);
+  return result;
+}
+
+DEF_TEST(putval_fast) {
+  cmd_status_t status;
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(putval_fast_data); i++) {
+    EXPECT_EQ_INT(0, putval_compare(putval_fast_data[i], &status));
+    EXPECT_EQ_INT(CMD_OK, status);
+  }
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(putval_slow_data); i++) {
+    EXPECT_EQ_INT(0, putval_compare(putval_slow_data[i], &status));
+    EXPECT_EQ_INT(CMD_UNSUPPORTED, status);
+  }
+
+  /* Too many values for the buffer. */
+  value_t values[2];
+  value_list_t vl = {.values = values};
+  EXPECT_EQ_INT(CMD_UNSUPPORTED,
+                cmd_parse_putval_fast(
+                    "PUTVAL example.com/test/MAGIC_MULTI N:1:2:3:4", &vl,
+                    STATIC_ARRAY_SIZE(values), NULL));
+
+  /* Whenever the fast parser accepts a random command, the result has to be
+   * the same as the one of cmd_parse(). */
+  unsigned int seed = 1;
+  int handled = 0;
+  int total = 0;
+  for (bool fuzz = false;; fuzz = true) {
+    for (int i = 0; i < 50000; i++) {
+      char line[1024];
+      cmds_fuzz_putval(line, sizeof(line), &seed, fuzz);
+      if (putval_compare(line, &status) != 0)
+        return -1;
+      if (status == CMD_OK)
+        handled++;
+      total++;
+    }
+    if (fuzz)
+      break;
+    /* All typical commands use the fast path. */
+    EXPECT_EQ_INT(total, handled);
+  }
+  printf("ok - %d of %d random commands were handled by the fast path\n",
+         handled, total);
+
+  return 0;
+}
+
+DEF_TEST(putnotif) {
+  cmd_error_handler_t err = {error_cb, NULL};
+  notification_t n;
+  char buffer[256];
+
+  sstrncpy(buffer,
+           "PUTNOTIF severity=warning time=1500000000.5 host=example.com "
+           "plugin=test type=MAGIC message=\"Hello, World\"",
+           sizeof(buffer));
+  EXPECT_EQ_INT(CMD_OK, cmd_parse_putnotif(buffer, &n, &err));
+  EXPECT_EQ_INT(NOTIF_WARNING, n.severity);
+  EXPECT_EQ_UINT64(DOUBLE_TO_CDTIME_T(1500000000.5), n.time);
+  EXPECT_EQ_STR("example.com", n.host);
+  EXPECT_EQ_STR("test", n.plugin);
+  EXPECT_EQ_STR("MAGIC", n.type);
+  EXPECT_EQ_STR("Hello, World", n.message);
+  EXPECT_EQ_PTR(NULL, n.meta);
+
+  sstrncpy(buffer, "PUTVAL example.com/test/MAGIC N:1", sizeof(buffer));
+  EXPECT_EQ_INT(CMD_UNKNOWN_COMMAND, cmd_parse_putnotif(buffer, &n, &err));
+
+  sstrncpy(buffer, "PUTNOTIF time=1 message=x", sizeof(buffer));
+  EXPECT_EQ_INT(CMD_PARSE_ERROR, cmd_parse_putnotif(buffer, &n, &err));
+
+  sstrncpy(buffer, "PUTNOTIF severity=okay time=x message=x", sizeof(buffer));
+  EXPECT_EQ_INT(CMD_PARSE_ERROR, cmd_parse_putnotif(buffer, &n, &err));
+
+  sstrncpy(buffer, "PUTNOTIF severity=okay time=1 message=", sizeof(buffer));
+  EXPECT_EQ_INT(CMD_PARSE_ERROR, cmd_parse_putnotif(buffer, &n, &err));
+
+  return 0;
+}
+
 int main(int argc, char **argv) {
   RUN_TEST(parse);
+  RUN_TEST(putbin);
+  RUN_TEST(parse_number);
+  RUN_TEST(putval_fast);
+  RUN_TEST(putnotif);
   END_TEST;
 }
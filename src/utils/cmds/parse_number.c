@@ -0,0 +1,169 @@
+/**
+ * collectd - src/utils/cmds/parse_number.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/cmds/parse_number.h"
+
+/* 2^53, the largest integer up to which all integers are exact doubles. */
+#define MANTISSA_MAX UINT64_C(9007199254740992)
+#define EXPONENT_MAX 22
+
+static double const powers_of_ten[EXPONENT_MAX + 1] = {
+    1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+static inline bool is_digit(char c) { return (c >= '0') && (c <= '9'); }
+
+double cmd_strtod(char const *str, char **endptr) /* {{{ */
+{
+  char const *ptr = str;
+  bool negative = false;
+  if ((*ptr == '-') || (*ptr == '+')) {
+    negative = (*ptr == '-');
+    ptr++;
+  }
+
+  /* Leave hexadecimal numbers to strtod(3). */
+  if ((ptr[0] == '0') && ((ptr[1] == 'x') || (ptr[1] == 'X')))
+    return strtod(str, endptr);
+
+  uint64_t mantissa = 0;
+  int exponent = 0;
+  bool have_digits = false;
+
+  for (; is_digit(*ptr); ptr++) {
+    mantissa = 10 * mantissa + (uint64_t)(*ptr - '0');
+    if (mantissa > MANTISSA_MAX)
+      return strtod(str, endptr);
+    have_digits = true;
+  }
+  if (*ptr == '.') {
+    ptr++;
+    for (; is_digit(*ptr); ptr++) {
+      mantissa = 10 * mantissa + (uint64_t)(*ptr - '0');
+      if ((mantissa > MANTISSA_MAX) || (exponent <= -EXPONENT_MAX))
+        return strtod(str, endptr);
+      exponent--;
+      have_digits = true;
+    }
+  }
+
+  /* Infinity, NaN, white space and invalid strings. */
+  if (!have_digits)
+    return strtod(str, endptr);
+
+  if ((*ptr == 'e') || (*ptr == 'E')) {
+    char const *exp_ptr = ptr + 1;
+    bool exp_negative = false;
+    if ((*exp_ptr == '-') || (*exp_ptr == '+')) {
+      exp_negative = (*exp_ptr == '-');
+      exp_ptr++;
+    }
+
+    /* Without digits, the 'e' is not part of the number. */
+    if (is_digit(*exp_ptr)) {
+      int exp_value = 0;
+      for (; is_digit(*exp_ptr); exp_ptr++) {
+        exp_value = 10 * exp_value + (*exp_ptr - '0');
+        if (exp_value > 2 * EXPONENT_MAX)
+          return strtod(str, endptr);
+      }
+      exponent += exp_negative ? -exp_value : exp_value;
+      ptr = exp_ptr;
+    }
+  }
+
+  if ((exponent < -EXPONENT_MAX) || (exponent > EXPONENT_MAX))
+    return strtod(str, endptr);
+
+  double value = (double)mantissa;
+  if (exponent < 0)
+    value /= powers_of_ten[-exponent];
+  else
+    value *= powers_of_ten[exponent];
+
+  if (endptr != NULL)
+    *endptr = (char *)ptr;
+  return negative ? -value : value;
+} /* }}} double cmd_strtod */
+
+/* Scans up to 18 decimal digits, which always fit into an int64_t. Returns
+ * false if strto(u)ll(3) has to be used instead. */
+static bool scan_decimal(char const **ret_ptr, uint64_t *ret_value) /* {{{ */
+{
+  char const *ptr = *ret_ptr;
+
+  /* Leave octal and hexadecimal numbers to the C library. */
+  if (!is_digit(*ptr) || ((ptr[0] == '0') && (is_digit(ptr[1]) ||
+                                              (ptr[1] == 'x') ||
+                                              (ptr[1] == 'X'))))
+    return false;
+
+  uint64_t value = 0;
+  int digits = 0;
+  for (; is_digit(*ptr); ptr++) {
+    if (++digits > 18)
+      return false;
+    value = 10 * value + (uint64_t)(*ptr - '0');
+  }
+
+  *ret_ptr = ptr;
+  *ret_value = value;
+  return true;
+} /* }}} bool scan_decimal */
+
+int64_t cmd_strtoll(char const *str, char **endptr) /* {{{ */
+{
+  char const *ptr = str;
+  bool negative = false;
+  if ((*ptr == '-') || (*ptr == '+')) {
+    negative = (*ptr == '-');
+    ptr++;
+  }
+
+  uint64_t value;
+  if (!scan_decimal(&ptr, &value))
+    return (int64_t)strtoll(str, endptr, 0);
+
+  if (endptr != NULL)
+    *endptr = (char *)ptr;
+  return negative ? -(int64_t)value : (int64_t)value;
+} /* }}} int64_t cmd_strtoll */
+
+uint64_t cmd_strtoull(char const *str, char **endptr) /* {{{ */
+{
+  char const *ptr = str;
+  /* strtoull(3) negates negative numbers in unsigned arithmetic. */
+  if (*ptr == '+')
+    ptr++;
+
+  uint64_t value;
+  if (!scan_decimal(&ptr, &value))
+    return (uint64_t)strtoull(str, endptr, 0);
+
+  if (endptr != NULL)
+    *endptr = (char *)ptr;
+  return value;
+} /* }}} uint64_t cmd_strtoull */
@@ -0,0 +1,48 @@
+/**
+ * collectd - src/utils/cmds/parse_number.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_CMD_PARSE_NUMBER_H
+#define UTILS_CMD_PARSE_NUMBER_H 1
+
+#include "collectd.h"
+
+/*
+ * NAME
+ *   cmd_strtod, cmd_strtoll, cmd_strtoull
+ *
+ * DESCRIPTION
+ *   Drop-in replacements for strtod(3), and strtoll(3) and strtoull(3) with
+ *   a base of zero, which return exactly the same results. Plain decimal
+ *   numbers, which make up nearly all input of the text protocol, are
+ *   scanned in one pass. If the digits of a double fit into 53 bits and its
+ *   decimal exponent is within +/-22, both are exact doubles and the result
+ *   of one multiplication or division is correctly rounded, like strtod(3)
+ *   rounds it.
+ *   Anything else, such as leading white space, hexadecimal numbers,
+ *   "nan" or out of range values, is passed to the C library.
+ */
+double cmd_strtod(char const *str, char **endptr);
+int64_t cmd_strtoll(char const *str, char **endptr);
+uint64_t cmd_strtoull(char const *str, char **endptr);
+
+#endif /* UTILS_CMD_PARSE_NUMBER_H */
@@ -0,0 +1,252 @@
+/**
+ * collectd - src/utils/cmds/putbin.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "network.h"
+#include "utils/cmds/putbin.h"
+#include "utils/common/common.h"
+
+#if HAVE_ARPA_INET_H
+#include <arpa/inet.h>
+#endif
+
+#define PART_HEADER_SIZE (2 * sizeof(uint16_t))
+
+/* Copies the string part `payload' into `ret', which has room for `ret_size'
+ * bytes including the null byte. */
+static int putbin_string(char const *payload, size_t payload_size, /* {{{ */
+                         char *ret, size_t ret_size) {
+  if ((payload_size == 0) || (payload_size > ret_size) ||
+      (payload[payload_size - 1] != 0) ||
+      (strlen(payload) != payload_size - 1))
+    return EINVAL;
+
+  memcpy(ret, payload, payload_size);
+  return 0;
+} /* }}} int putbin_string */
+
+static int putbin_number(char const *payload, size_t payload_size, /* {{{ */
+                         uint64_t *ret) {
+  uint64_t tmp;
+  if (payload_size != sizeof(tmp))
+    return EINVAL;
+
+  memcpy(&tmp, payload, sizeof(tmp));
+  *ret = ntohll(tmp);
+  return 0;
+} /* }}} int putbin_number */
+
+/* Decodes the values part `payload' into `vl->values', which has room for
+ * `ds->ds_num' values. */
+static int putbin_values(char const *payload, size_t payload_size, /* {{{ */
+                         data_set_t const *ds, value_list_t *vl,
+                         cmd_error_handler_t *err) {
+  uint16_t tmp16;
+  if (payload_size < sizeof(tmp16)) {
+    cmd_error(CMD_PARSE_ERROR, err, "Values part is too short.");
+    return EINVAL;
+  }
+  memcpy(&tmp16, payload, sizeof(tmp16));
+  size_t num = (size_t)ntohs(tmp16);
+
+  if (payload_size !=
+      sizeof(tmp16) + num * (sizeof(uint8_t) + sizeof(uint64_t))) {
+    cmd_error(CMD_PARSE_ERROR, err,
+              "Length and number of values in the values part don't match.");
+    return EINVAL;
+  }
+
+  if (num != ds->ds_num) {
+    cmd_error(CMD_PARSE_ERROR, err,
+              "Type `%s' has %" PRIsz " data sources, got %" PRIsz " values.",
+              ds->type, ds->ds_num, num);
+    return EINVAL;
+  }
+
+  uint8_t const *types = (uint8_t const *)payload + sizeof(tmp16);
+  char const *values = (char const *)types + num;
+
+  for (size_t i = 0; i < num; i++) {
+    if (types[i] != ds->ds[i].type) {
+      cmd_error(CMD_PARSE_ERROR, err,
+                "Value %" PRIsz " of type `%s' has the wrong data source type.",
+                i, ds->type);
+      return EINVAL;
+    }
+
+    uint64_t tmp64;
+    memcpy(&tmp64, values + i * sizeof(tmp64), sizeof(tmp64));
+
+    switch (types[i]) {
+    case DS_TYPE_COUNTER:
+      vl->values[i].counter = (counter_t)ntohll(tmp64);
+      break;
+    case DS_TYPE_GAUGE:
+      memcpy(&vl->values[i].gauge, &tmp64, sizeof(tmp64));
+      vl->values[i].gauge = (gauge_t)ntohd(vl->values[i].gauge);
+      break;
+    case DS_TYPE_DERIVE:
+      vl->values[i].derive = (derive_t)ntohll(tmp64);
+      break;
+    case DS_TYPE_ABSOLUTE:
+      vl->values[i].absolute = (absolute_t)ntohll(tmp64);
+      break;
+    }
+  }
+
+  vl->values_len = num;
+  return 0;
+} /* }}} int putbin_values */
+
+cmd_status_t cmd_parse_putbin(void const *data, size_t size, /* {{{ */
+                              cmd_putbin_callback_t callback, void *user_data,
+                              size_t *ret_num, cmd_error_handler_t *err) {
+  char const *buffer = data;
+  value_list_t vl = VALUE_LIST_INIT;
+  value_t *values = NULL;
+  size_t values_size = 0;
+  size_t num = 0;
+  cmd_status_t status = CMD_OK;
+
+  while ((size > 0) && (status == CMD_OK)) {
+    uint16_t tmp16;
+    if (size < PART_HEADER_SIZE) {
+      cmd_error(CMD_PARSE_ERROR, err, "Truncated part header.");
+      status = CMD_PARSE_ERROR;
+      break;
+    }
+
+    memcpy(&tmp16, buffer, sizeof(tmp16));
+    uint16_t part_type = ntohs(tmp16);
+    memcpy(&tmp16, buffer + sizeof(tmp16), sizeof(tmp16));
+    size_t part_size = (size_t)ntohs(tmp16);
+
+    if ((part_size < PART_HEADER_SIZE) || (part_size > size)) {
+      cmd_error(CMD_PARSE_ERROR, err,
+                "Invalid part size %" PRIsz " with %" PRIsz " bytes left.",
+                part_size, size);
+      status = CMD_PARSE_ERROR;
+      break;
+    }
+
+    char const *payload = buffer + PART_HEADER_SIZE;
+    size_t payload_size = part_size - PART_HEADER_SIZE;
+    uint64_t number = 0;
+    int part_status = 0;
+
+    switch (part_type) {
+    case TYPE_HOST:
+      part_status =
+          putbin_string(payload, payload_size, vl.host, sizeof(vl.host));
+      break;
+    case TYPE_PLUGIN:
+      part_status =
+          putbin_string(payload, payload_size, vl.plugin, sizeof(vl.plugin));
+      break;
+    case TYPE_PLUGIN_INSTANCE:
+      part_status = putbin_string(payload, payload_size, vl.plugin_instance,
+                                  sizeof(vl.plugin_instance));
+      break;
+    case TYPE_TYPE:
+      part_status =
+          putbin_string(payload, payload_size, vl.type, sizeof(vl.type));
+      break;
+    case TYPE_TYPE_INSTANCE:
+      part_status = putbin_string(payload, payload_size, vl.type_instance,
+                                  sizeof(vl.type_instance));
+      break;
+    case TYPE_TIME:
+      part_status = putbin_number(payload, payload_size, &number);
+      vl.time = TIME_T_TO_CDTIME_T(number);
+      break;
+    case TYPE_TIME_HR:
+      part_status = putbin_number(payload, payload_size, &number);
+      vl.time = (cdtime_t)number;
+      break;
+    case TYPE_INTERVAL:
+      part_status = putbin_number(payload, payload_size, &number);
+      vl.interval = TIME_T_TO_CDTIME_T(number);
+      break;
+    case TYPE_INTERVAL_HR:
+      part_status = putbin_number(payload, payload_size, &number);
+      vl.interval = (cdtime_t)number;
+      break;
+    case TYPE_ENCR_AES256:
+      cmd_error(CMD_PARSE_ERROR, err, "Encrypted data is not supported.");
+      status = CMD_PARSE_ERROR;
+      continue;
+    case TYPE_VALUES: {
+      data_set_t const *ds = plugin_get_ds(vl.type);
+      if (ds == NULL) {
+        cmd_error(CMD_PARSE_ERROR, err, "Type `%s' isn't defined.", vl.type);
+        status = CMD_PARSE_ERROR;
+        continue;
+      }
+
+      if (ds->ds_num > values_size) {
+        value_t *tmp = realloc(values, ds->ds_num * sizeof(*values));
+        if (tmp == NULL) {
+          cmd_error(CMD_ERROR, err, "realloc failed.");
+          status = CMD_ERROR;
+          continue;
+        }
+        values = tmp;
+        values_size = ds->ds_num;
+      }
+      vl.values = values;
+
+      if (putbin_values(payload, payload_size, ds, &vl, err) != 0) {
+        status = CMD_PARSE_ERROR;
+        continue;
+      }
+
+      if (callback(&vl, user_data) != 0) {
+        cmd_error(CMD_ERROR, err, "Dispatching the values failed.");
+        status = CMD_ERROR;
+        continue;
+      }
+      num++;
+      break;
+    }
+    default:
+      /* Signatures, notifications and unknown parts are skipped. */
+      break;
+    }
+
+    if (part_status != 0) {
+      cmd_error(CMD_PARSE_ERROR, err, "Invalid part of type 0x%04" PRIx16 ".",
+                part_type);
+      status = CMD_PARSE_ERROR;
+      break;
+    }
+
+    buffer += part_size;
+    size -= part_size;
+  }
+
+  free(values);
+  if (ret_num != NULL)
+    *ret_num = num;
+  return status;
+} /* }}} cmd_status_t cmd_parse_putbin */
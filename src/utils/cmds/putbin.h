@@ -0,0 +1,60 @@
+/**
+ * collectd - src/utils/cmds/putbin.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_CMD_PUTBIN_H
+#define UTILS_CMD_PUTBIN_H 1
+
+#include "plugin.h"
+#include "utils/cmds/cmds.h"
+
+/* Largest payload accepted by the PUTBIN command. */
+#define CMD_PUTBIN_MAX_SIZE 65536
+
+typedef int (*cmd_putbin_callback_t)(value_list_t const *vl, void *user_data);
+
+/*
+ * NAME
+ *   cmd_parse_putbin
+ *
+ * DESCRIPTION
+ *   Parses the payload of a "PUTBIN <size>" command: `size' bytes of value
+ *   lists in the binary format of the network plugin, as created by
+ *   lcc_network_buffer_t of libcollectdclient. `callback' is called for each
+ *   value list; the value list is only valid during the call. Parts other than
+ *   identifiers, times, intervals and values, such as signatures, are
+ *   skipped. Encrypted data is not supported.
+ *
+ *   Value lists are checked against their data set like PUTVAL does. Parsing
+ *   stops at the first error; value lists passed to `callback' before are not
+ *   undone.
+ *
+ * RETURN VALUE
+ *   CMD_OK on success, CMD_PARSE_ERROR if the data is malformed and CMD_ERROR
+ *   if `callback' failed. `ret_num', if not NULL, is set to the number of value
+ *   lists passed to `callback' successfully.
+ */
+cmd_status_t cmd_parse_putbin(void const *data, size_t size,
+                              cmd_putbin_callback_t callback, void *user_data,
+                              size_t *ret_num, cmd_error_handler_t *err);
+
+#endif /* UTILS_CMD_PUTBIN_H */
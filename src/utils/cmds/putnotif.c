@@ -29,6 +29,7 @@
 #include "plugin.h"
 #include "utils/common/common.h"
 
+#include "utils/cmds/parse_number.h"
 #include "utils/cmds/parse_option.h"
 #include "utils/cmds/putnotif.h"
 
@@ -60,7 +61,7 @@ static int set_option_time(notification_t *n, const char *value) {
   double tmp;
 
   errno = 0;
-  tmp = strtod(value, &endptr);
+  tmp = cmd_strtod(value, &endptr);
   if ((errno != 0)         /* Overflow */
       || (endptr == value) /* Invalid string */
       || (endptr == NULL)  /* This should not happen */
@@ -114,68 +115,80 @@ static int set_option(notification_t *n, const char *option,
   return 0;
 } /* int set_option */
 
-int handle_putnotif(FILE *fh, char *buffer) {
-  char *command;
-  notification_t n = {0};
-  int status;
-
-  if ((fh == NULL) || (buffer == NULL))
-    return -1;
+cmd_status_t cmd_parse_putnotif(char *buffer, notification_t *n, /* {{{ */
+                                cmd_error_handler_t *err) {
+  char *command = NULL;
+  cmd_status_t status = CMD_OK;
 
-  DEBUG("utils_cmd_putnotif: handle_putnotif (fh = %p, buffer = %s);",
-        (void *)fh, buffer);
+  memset(n, 0, sizeof(*n));
 
-  command = NULL;
-  status = parse_string(&buffer, &command);
-  if (status != 0) {
-    print_to_socket(fh, "-1 Cannot parse command.\n");
-    return -1;
+  if (parse_string(&buffer, &command) != 0) {
+    cmd_error(CMD_UNKNOWN_COMMAND, err, "Cannot parse command.");
+    return CMD_UNKNOWN_COMMAND;
   }
   assert(command != NULL);
 
   if (strcasecmp("PUTNOTIF", command) != 0) {
-    print_to_socket(fh, "-1 Unexpected command: `%s'.\n", command);
-    return -1;
+    cmd_error(CMD_UNKNOWN_COMMAND, err, "Unexpected command: `%s'.", command);
+    return CMD_UNKNOWN_COMMAND;
   }
 
-  status = 0;
-  while (*buffer != 0) {
+  while ((status == CMD_OK) && (*buffer != 0)) {
     char *key;
     char *value;
 
-    status = parse_option(&buffer, &key, &value);
-    if (status != 0) {
-      print_to_socket(fh, "-1 Malformed option.\n");
-      break;
-    }
-
-    status = set_option(&n, key, value);
-    if (status != 0) {
-      print_to_socket(fh, "-1 Error parsing option `%s'\n", key);
-      break;
+    if (parse_option(&buffer, &key, &value) != 0) {
+      cmd_error(CMD_PARSE_ERROR, err, "Malformed option.");
+      status = CMD_PARSE_ERROR;
+    } else if (set_option(n, key, value) != 0) {
+      cmd_error(CMD_PARSE_ERROR, err, "Error parsing option `%s'", key);
+      status = CMD_PARSE_ERROR;
     }
-  } /* for (i) */
+  }
 
   /* Check for required fields and complain if anything is missing. */
-  if ((status == 0) && (n.severity == 0)) {
-    print_to_socket(fh, "-1 Option `severity' missing.\n");
-    status = -1;
+  if ((status == CMD_OK) && (n->severity == 0)) {
+    cmd_error(CMD_PARSE_ERROR, err, "Option `severity' missing.");
+    status = CMD_PARSE_ERROR;
   }
-  if ((status == 0) && (n.time == 0)) {
-    print_to_socket(fh, "-1 Option `time' missing.\n");
-    status = -1;
+  if ((status == CMD_OK) && (n->time == 0)) {
+    cmd_error(CMD_PARSE_ERROR, err, "Option `time' missing.");
+    status = CMD_PARSE_ERROR;
   }
-  if ((status == 0) && (strlen(n.message) == 0)) {
-    print_to_socket(fh, "-1 No message or message of length 0 given.\n");
-    status = -1;
+  if ((status == CMD_OK) && (strlen(n->message) == 0)) {
+    cmd_error(CMD_PARSE_ERROR, err,
+              "No message or message of length 0 given.");
+    status = CMD_PARSE_ERROR;
   }
 
-  /* If status is still zero the notification is fine and we can finally
-   * dispatch it. */
-  if (status == 0) {
-    plugin_dispatch_notification(&n);
-    print_to_socket(fh, "0 Success\n");
+  if ((status != CMD_OK) && (n->meta != NULL)) {
+    plugin_notification_meta_free(n->meta);
+    n->meta = NULL;
   }
 
+  return status;
+} /* }}} cmd_status_t cmd_parse_putnotif */
+
+int handle_putnotif(FILE *fh, char *buffer) {
+  cmd_error_handler_t err = {cmd_error_fh, fh};
+  notification_t n;
+
+  if ((fh == NULL) || (buffer == NULL))
+    return -1;
+
+  DEBUG("utils_cmd_putnotif: handle_putnotif (fh = %p, buffer = %s);",
+        (void *)fh, buffer);
+
+  cmd_status_t status = cmd_parse_putnotif(buffer, &n, &err);
+  if (status == CMD_UNKNOWN_COMMAND)
+    return -1;
+  if (status != CMD_OK)
+    return 0;
+
+  plugin_dispatch_notification(&n);
+  if (n.meta != NULL)
+    plugin_notification_meta_free(n.meta);
+
+  print_to_socket(fh, "0 Success\n");
   return 0;
 } /* int handle_putnotif */
@@ -27,8 +27,28 @@
 #ifndef UTILS_CMD_PUTNOTIF_H
 #define UTILS_CMD_PUTNOTIF_H 1
 
+#include "plugin.h"
+#include "utils/cmds/cmds.h"
+
 #include <stdio.h>
 
+/*
+ * NAME
+ *   cmd_parse_putnotif
+ *
+ * DESCRIPTION
+ *   Parses a PUTNOTIF command line into `n' in a single pass. `buffer' is
+ *   modified. Notification meta data is the only memory allocated.
+ *
+ * RETURN VALUE
+ *   CMD_OK on success, in which case the caller has to free the meta data of
+ *   `n' with plugin_notification_meta_free(), CMD_UNKNOWN_COMMAND if
+ *   `buffer' is not a PUTNOTIF command and CMD_PARSE_ERROR if the command is
+ *   malformed.
+ */
+cmd_status_t cmd_parse_putnotif(char *buffer, notification_t *n,
+                                cmd_error_handler_t *err);
+
 int handle_putnotif(FILE *fh, char *buffer);
 
 #endif /* UTILS_CMD_PUTNOTIF_H */
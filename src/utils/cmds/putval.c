@@ -28,9 +28,17 @@
 
 #include "collectd.h"
 
+#include "utils/cmds/parse_number.h"
 #include "utils/cmds/putval.h"
 #include "utils/common/common.h"
 
+/* Size of the buffer holding one field of the command line in
+ * cmd_parse_putval_fast(). Longer fields are left to cmd_parse(). */
+#define PUTVAL_FIELD_SIZE 4096
+
+/* Number of values cmd_handle_putval() parses on the stack. */
+#define PUTVAL_VALUES_MAX 64
+
 /*
  * private helper functions
  */
@@ -91,6 +99,155 @@ static int set_option(value_list_t *vl, const char *key, const char *value,
   return CMD_OK;
 } /* int set_option */
 
+/* Copies the next field of the command line `*ret_ptr' into `buffer' and
+ * advances `*ret_ptr'. Quotes and backslash escapes are removed exactly like
+ * cmd_split() does. Returns zero on success, one at the end of the line and
+ * -1 if the rest of the line is malformed or the field is too long. */
+static int putval_next_field(char const **ret_ptr, char *buffer, /* {{{ */
+                             size_t buffer_size) {
+  char const *ptr = *ret_ptr;
+  bool in_field = false;
+  bool in_quotes = false;
+  size_t len = 0;
+
+  for (; *ptr != '\0'; ptr++) {
+    char c = *ptr;
+
+    if (isspace((int)c)) {
+      if (!in_quotes) {
+        if (in_field)
+          break;
+        continue;
+      }
+    } else if (c == '"') {
+      if (in_quotes) {
+        /* The end of a quoted string ends the field, which may be empty. */
+        in_field = true;
+        in_quotes = false;
+        ptr++;
+        break;
+      }
+      in_quotes = true;
+      continue;
+    } else if ((c == '\\') && in_quotes) {
+      if (ptr[1] == '\0')
+        return -1;
+      ptr++;
+      c = *ptr;
+    }
+
+    if (len >= buffer_size - 1)
+      return -1;
+    buffer[len] = c;
+    len++;
+    in_field = true;
+  }
+
+  if (in_quotes)
+    return -1;
+  if (!in_field)
+    return 1;
+
+  buffer[len] = '\0';
+  *ret_ptr = ptr;
+  return 0;
+} /* }}} int putval_next_field */
+
+/* Returns the value of `field' if it is an option like cmd_parse_option()
+ * recognizes it, terminating the key in place, or NULL. */
+static char *putval_option(char *field) /* {{{ */
+{
+  char *value = field;
+  while (isalnum((int)value[0]) || (value[0] == '_') || (value[0] == ':'))
+    value++;
+  if ((value[0] != '=') || (value == field))
+    return NULL;
+
+  *value = '\0';
+  return value + 1;
+} /* }}} char *putval_option */
+
+/* Handles the options set_option() handles without reporting an error. */
+static int putval_set_option(value_list_t *vl, char const *key, /* {{{ */
+                             char *value) {
+  if (strcasecmp("interval", key) == 0) {
+    char *endptr = NULL;
+    errno = 0;
+    double tmp = cmd_strtod(value, &endptr);
+    if ((errno == 0) && (endptr != NULL) && (endptr != value) && (tmp > 0.0))
+      vl->interval = DOUBLE_TO_CDTIME_T(tmp);
+    return 0;
+  } else if (strncasecmp("meta:", key, 5) == 0) {
+    size_t value_len = strlen(value);
+    if (!is_quoted(value, value_len))
+      return -1;
+
+    if (vl->meta == NULL) {
+      vl->meta = meta_data_create();
+      if (vl->meta == NULL)
+        return -1;
+    }
+
+    value[value_len - 1] = '\0';
+    return meta_data_add_string(vl->meta, key + 5, value + 1);
+  }
+
+  return -1;
+} /* }}} int putval_set_option */
+
+/* Parses the value list `field' like parse_values() does, but fails instead of
+ * accepting empty fields, trailing garbage, a time of zero or too few values.
+ */
+static int putval_values(char const *field, value_list_t *vl, /* {{{ */
+                         data_set_t const *ds) {
+  char const *ptr = field;
+  char *endptr = NULL;
+
+  if ((ptr[0] == 'N') && (ptr[1] == ':')) {
+    vl->time = cdtime();
+    ptr++;
+  } else {
+    errno = 0;
+    double tmp = cmd_strtod(ptr, &endptr);
+    if ((errno != 0) || (endptr == ptr) || (*endptr != ':'))
+      return -1;
+    vl->time = DOUBLE_TO_CDTIME_T(tmp);
+    if (vl->time == 0)
+      return -1;
+    ptr = endptr;
+  }
+
+  for (size_t i = 0; i < ds->ds_num; i++) {
+    /* Skip the colon in front of the value. */
+    ptr++;
+
+    int type = ds->ds[i].type;
+    if ((type == DS_TYPE_GAUGE) && (ptr[0] == 'U') &&
+        ((ptr[1] == ':') || (ptr[1] == '\0'))) {
+      vl->values[i].gauge = NAN;
+      endptr = (char *)ptr + 1;
+    } else if (type == DS_TYPE_GAUGE) {
+      vl->values[i].gauge = (gauge_t)cmd_strtod(ptr, &endptr);
+    } else if (type == DS_TYPE_DERIVE) {
+      vl->values[i].derive = (derive_t)cmd_strtoll(ptr, &endptr);
+    } else if (type == DS_TYPE_COUNTER) {
+      vl->values[i].counter = (counter_t)cmd_strtoull(ptr, &endptr);
+    } else if (type == DS_TYPE_ABSOLUTE) {
+      vl->values[i].absolute = (absolute_t)cmd_strtoull(ptr, &endptr);
+    } else {
+      return -1;
+    }
+
+    bool last = (i == ds->ds_num - 1);
+    if ((endptr == ptr) || (*endptr != (last ? '\0' : ':')))
+      return -1;
+    ptr = endptr;
+  }
+
+  vl->values_len = ds->ds_num;
+  return 0;
+} /* }}} int putval_values */
+
 /*
  * public API
  */
@@ -243,11 +400,21 @@ cmd_status_t cmd_parse_putval(size_t argc, char **argv,
     ret_putval->vl_num++;
     memcpy(&ret_putval->vl[ret_putval->vl_num - 1], &vl, sizeof(vl));
 
-    /* pointer is now owned by ret_putval->vl[] */
+    /* pointers are now owned by ret_putval->vl[]; following value lists get
+     * their own copy of the meta data. */
     vl.values_len = 0;
     vl.values = NULL;
+    if (vl.meta != NULL) {
+      vl.meta = meta_data_clone(vl.meta);
+      if (vl.meta == NULL) {
+        cmd_error(CMD_ERROR, err, "meta_data_clone failed.");
+        result = CMD_ERROR;
+        break;
+      }
+    }
   } /* while (*buffer != 0) */
   /* Done parsing the options. */
+  meta_data_destroy(vl.meta);
 
   if (result != CMD_OK)
     cmd_destroy_putval(ret_putval);
@@ -255,6 +422,85 @@ cmd_status_t cmd_parse_putval(size_t argc, char **argv,
   return result;
 } /* cmd_status_t cmd_parse_putval */
 
+cmd_status_t cmd_parse_putval_fast(char const *buffer, /* {{{ */
+                                   value_list_t *vl, size_t values_size,
+                                   const cmd_options_t *opts) {
+  char field[PUTVAL_FIELD_SIZE];
+
+  if ((buffer == NULL) || (vl == NULL) || (vl->values == NULL))
+    return CMD_UNSUPPORTED;
+
+  if ((putval_next_field(&buffer, field, sizeof(field)) != 0) ||
+      (strcasecmp("PUTVAL", field) != 0))
+    return CMD_UNSUPPORTED;
+
+  if (putval_next_field(&buffer, field, sizeof(field)) != 0)
+    return CMD_UNSUPPORTED;
+
+  char *host = NULL;
+  char *plugin = NULL;
+  char *plugin_instance = NULL;
+  char *type = NULL;
+  char *type_instance = NULL;
+  if (parse_identifier(field, &host, &plugin, &plugin_instance, &type,
+                       &type_instance,
+                       (opts != NULL) ? opts->identifier_default_host : NULL) !=
+      0)
+    return CMD_UNSUPPORTED;
+
+  if ((strlen(host) >= sizeof(vl->host)) ||
+      (strlen(plugin) >= sizeof(vl->plugin)) ||
+      ((plugin_instance != NULL) &&
+       (strlen(plugin_instance) >= sizeof(vl->plugin_instance))) ||
+      ((type_instance != NULL) &&
+       (strlen(type_instance) >= sizeof(vl->type_instance))))
+    return CMD_UNSUPPORTED;
+
+  data_set_t const *ds = plugin_get_ds(type);
+  if ((ds == NULL) || (ds->ds_num > values_size))
+    return CMD_UNSUPPORTED;
+
+  sstrncpy(vl->host, host, sizeof(vl->host));
+  sstrncpy(vl->plugin, plugin, sizeof(vl->plugin));
+  sstrncpy(vl->plugin_instance,
+           (plugin_instance != NULL) ? plugin_instance : "",
+           sizeof(vl->plugin_instance));
+  sstrncpy(vl->type, type, sizeof(vl->type));
+  sstrncpy(vl->type_instance, (type_instance != NULL) ? type_instance : "",
+           sizeof(vl->type_instance));
+  vl->values_len = 0;
+  vl->time = 0;
+  vl->interval = 0;
+  vl->meta = NULL;
+
+  /* Options, followed by exactly one value list. */
+  bool have_values = false;
+  int status;
+  while ((status = putval_next_field(&buffer, field, sizeof(field))) == 0) {
+    if (have_values)
+      break;
+
+    char *value = putval_option(field);
+    if (value != NULL) {
+      if (putval_set_option(vl, field, value) != 0)
+        break;
+      continue;
+    }
+
+    if (putval_values(field, vl, ds) != 0)
+      break;
+    have_values = true;
+  }
+
+  if ((status != 1) || !have_values) {
+    meta_data_destroy(vl->meta);
+    vl->meta = NULL;
+    return CMD_UNSUPPORTED;
+  }
+
+  return CMD_OK;
+} /* }}} cmd_status_t cmd_parse_putval_fast */
+
 void cmd_destroy_putval(cmd_putval_t *putval) {
   if (putval == NULL)
     return;
@@ -280,6 +526,18 @@ cmd_status_t cmd_handle_putval(FILE *fh, char *buffer) {
   DEBUG("utils_cmd_putval: cmd_handle_putval (fh = %p, buffer = %s);",
         (void *)fh, buffer);
 
+  value_t values[PUTVAL_VALUES_MAX];
+  value_list_t vl = {.values = values};
+  if (cmd_parse_putval_fast(buffer, &vl, STATIC_ARRAY_SIZE(values), NULL) ==
+      CMD_OK) {
+    plugin_dispatch_values(&vl);
+    meta_data_destroy(vl.meta);
+
+    if (fh != stdout)
+      cmd_error(CMD_OK, &err, "Success: 1 value has been dispatched.");
+    return CMD_OK;
+  }
+
   if ((status = cmd_parse(buffer, &cmd, NULL, &err)) != CMD_OK)
     return status;
   if (cmd.type != CMD_PUTVAL) {
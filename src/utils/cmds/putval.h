@@ -37,6 +37,31 @@ cmd_status_t cmd_parse_putval(size_t argc, char **argv,
                               const cmd_options_t *opts,
                               cmd_error_handler_t *err);
 
+/*
+ * NAME
+ *   cmd_parse_putval_fast
+ *
+ * DESCRIPTION
+ *   Parses a PUTVAL command line into `vl' in a single pass, without
+ *   modifying `buffer' and without allocating memory unless meta data is
+ *   given. The values are stored in `vl->values', which must point to
+ *   `values_size' values; all other fields of `vl' are overwritten.
+ *
+ *   Only the common form of the command is handled: one value list, which
+ *   may be preceded by "interval" and string meta data options. Everything
+ *   else, including all malformed commands, is left to cmd_parse(), which
+ *   handles the command the same way and reports errors. For commands
+ *   handled by this function, `vl' is the same as the value list returned by
+ *   cmd_parse().
+ *
+ * RETURN VALUE
+ *   CMD_OK on success, in which case the caller has to free `vl->meta', and
+ *   CMD_UNSUPPORTED if the command has to be passed to cmd_parse().
+ */
+cmd_status_t cmd_parse_putval_fast(char const *buffer, value_list_t *vl,
+                                   size_t values_size,
+                                   const cmd_options_t *opts);
+
 cmd_status_t cmd_handle_putval(FILE *fh, char *buffer);
 
 void cmd_destroy_putval(cmd_putval_t *putval);
@@ -0,0 +1,326 @@
+/**
+ * collectd - src/utils/ddsketch/ddsketch.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/ddsketch/ddsketch.h"
+
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+
+/* Buckets are allocated in multiples of this. */
+#define DDSKETCH_CHUNK 64
+
+struct ddsketch_s {
+  double relative_accuracy;
+  double gamma;
+  double multiplier; /* 1 / ln(gamma) */
+  double min_indexable;
+  size_t max_buckets;
+
+  /* counts[i] holds the values of bucket offset + i. Only the buckets
+   * min_key ... max_key are in use; both are invalid while `buckets_used' is
+   * false. */
+  uint64_t *counts;
+  size_t counts_size;
+  int offset;
+  int min_key;
+  int max_key;
+  bool buckets_used;
+
+  uint64_t zero_count;
+  uint64_t count;
+  double sum;
+  double min;
+  double max;
+};
+
+static inline int ddsketch_key(ddsketch_t const *s, double value) /* {{{ */
+{
+  return (int)ceil(log(value) * s->multiplier);
+} /* }}} int ddsketch_key */
+
+/* Returns the estimate for the values in bucket `key', which is off by at
+ * most the relative accuracy for all values of the bucket. */
+static inline double ddsketch_value(ddsketch_t const *s, int key) /* {{{ */
+{
+  return 2.0 * pow(s->gamma, (double)key) / (1.0 + s->gamma);
+} /* }}} double ddsketch_value */
+
+/* Moves the buckets into a new array covering min_key ... max_key. Buckets
+ * below min_key are added to min_key. */
+static int ddsketch_rebuild(ddsketch_t *s, int min_key, int max_key) /* {{{ */
+{
+  size_t span = (size_t)(max_key - min_key) + 1;
+  size_t size = DDSKETCH_CHUNK * ((span + DDSKETCH_CHUNK - 1) / DDSKETCH_CHUNK);
+  if (size > s->max_buckets)
+    size = s->max_buckets;
+  if (size < s->counts_size)
+    size = s->counts_size;
+
+  uint64_t *counts = calloc(size, sizeof(*counts));
+  if (counts == NULL)
+    return ENOMEM;
+
+  /* Leave the same number of spare buckets on both sides. */
+  int offset = min_key - (int)((size - span) / 2);
+
+  if (s->buckets_used) {
+    for (int key = s->min_key; key <= s->max_key; key++) {
+      uint64_t c = s->counts[key - s->offset];
+      if (c == 0)
+        continue;
+      int new_key = (key < min_key) ? min_key : key;
+      counts[new_key - offset] += c;
+    }
+  }
+
+  free(s->counts);
+  s->counts = counts;
+  s->counts_size = size;
+  s->offset = offset;
+  return 0;
+} /* }}} int ddsketch_rebuild */
+
+/* Makes sure bucket `key' exists and returns its index into `counts', or -1
+ * if buckets could not be allocated. If the buckets would exceed
+ * `max_buckets', the lowest buckets are collapsed and the returned index may
+ * refer to a higher bucket. */
+static ssize_t ddsketch_index(ddsketch_t *s, int key) /* {{{ */
+{
+  if (s->buckets_used && (key >= s->min_key) && (key <= s->max_key))
+    return (ssize_t)(key - s->offset);
+
+  int min_key = key;
+  int max_key = key;
+  if (s->buckets_used) {
+    min_key = (key < s->min_key) ? key : s->min_key;
+    max_key = (key > s->max_key) ? key : s->max_key;
+  }
+
+  if ((size_t)(max_key - min_key) >= s->max_buckets) {
+    min_key = max_key - (int)s->max_buckets + 1;
+    if (key < min_key)
+      key = min_key;
+  }
+
+  /* Buckets below min_key that are in use need to be collapsed. */
+  bool collapse = s->buckets_used && (min_key > s->min_key);
+
+  if (collapse || (min_key < s->offset) ||
+      (max_key >= s->offset + (int)s->counts_size)) {
+    if (ddsketch_rebuild(s, min_key, max_key) != 0)
+      return -1;
+  }
+
+  s->min_key = min_key;
+  s->max_key = max_key;
+  s->buckets_used = true;
+  return (ssize_t)(key - s->offset);
+} /* }}} ssize_t ddsketch_index */
+
+ddsketch_t *ddsketch_create(double relative_accuracy, /* {{{ */
+                            size_t max_buckets) {
+  if (!(relative_accuracy >= 1e-6) || !(relative_accuracy <= 0.5) ||
+      (max_buckets < 1) || (max_buckets > INT_MAX / 2)) {
+    errno = EINVAL;
+    return NULL;
+  }
+
+  ddsketch_t *s = calloc(1, sizeof(*s));
+  if (s == NULL)
+    return NULL;
+
+  s->relative_accuracy = relative_accuracy;
+  s->gamma = (1.0 + relative_accuracy) / (1.0 - relative_accuracy);
+  s->multiplier = 1.0 / log(s->gamma);
+  /* Keeps the keys well within the range of an int. */
+  s->min_indexable = DBL_MIN * s->gamma;
+  s->max_buckets = max_buckets;
+
+  ddsketch_reset(s);
+  return s;
+} /* }}} ddsketch_t *ddsketch_create */
+
+void ddsketch_destroy(ddsketch_t *s) /* {{{ */
+{
+  if (s == NULL)
+    return;
+
+  free(s->counts);
+  free(s);
+} /* }}} void ddsketch_destroy */
+
+void ddsketch_add(ddsketch_t *s, double value) /* {{{ */
+{
+  if ((s == NULL) || isnan(value))
+    return;
+
+  if (value > s->min_indexable) {
+    ssize_t index = ddsketch_index(s, ddsketch_key(s, value));
+    if (index < 0)
+      return;
+    s->counts[index]++;
+  } else {
+    s->zero_count++;
+  }
+
+  if ((s->count == 0) || (s->min > value))
+    s->min = value;
+  if ((s->count == 0) || (s->max < value))
+    s->max = value;
+  s->sum += value;
+  s->count++;
+} /* }}} void ddsketch_add */
+
+void ddsketch_reset(ddsketch_t *s) /* {{{ */
+{
+  if (s == NULL)
+    return;
+
+  if (s->buckets_used)
+    memset(s->counts + (s->min_key - s->offset), 0,
+           sizeof(*s->counts) * (size_t)(s->max_key - s->min_key + 1));
+  s->buckets_used = false;
+
+  s->zero_count = 0;
+  s->count = 0;
+  s->sum = 0.0;
+  s->min = NAN;
+  s->max = NAN;
+} /* }}} void ddsketch_reset */
+
+int ddsketch_merge(ddsketch_t *dst, ddsketch_t const *src) /* {{{ */
+{
+  if ((dst == NULL) || (src == NULL) ||
+      (dst->relative_accuracy != src->relative_accuracy))
+    return EINVAL;
+
+  if (src->count == 0)
+    return 0;
+
+  if (src->buckets_used) {
+    /* Extend the buckets once for the whole range of `src'. */
+    if ((ddsketch_index(dst, src->min_key) < 0) ||
+        (ddsketch_index(dst, src->max_key) < 0))
+      return ENOMEM;
+
+    for (int key = src->min_key; key <= src->max_key; key++) {
+      uint64_t c = src->counts[key - src->offset];
+      if (c != 0)
+        dst->counts[ddsketch_index(dst, key)] += c;
+    }
+  }
+
+  if ((dst->count == 0) || (dst->min > src->min))
+    dst->min = src->min;
+  if ((dst->count == 0) || (dst->max < src->max))
+    dst->max = src->max;
+  dst->zero_count += src->zero_count;
+  dst->sum += src->sum;
+  dst->count += src->count;
+
+  return 0;
+} /* }}} int ddsketch_merge */
+
+uint64_t ddsketch_count(ddsketch_t const *s) /* {{{ */
+{
+  return (s != NULL) ? s->count : 0;
+} /* }}} uint64_t ddsketch_count */
+
+double ddsketch_sum(ddsketch_t const *s) /* {{{ */
+{
+  return (s != NULL) ? s->sum : 0.0;
+} /* }}} double ddsketch_sum */
+
+double ddsketch_min(ddsketch_t const *s) /* {{{ */
+{
+  return (s != NULL) ? s->min : NAN;
+} /* }}} double ddsketch_min */
+
+double ddsketch_max(ddsketch_t const *s) /* {{{ */
+{
+  return (s != NULL) ? s->max : NAN;
+} /* }}} double ddsketch_max */
+
+double ddsketch_average(ddsketch_t const *s) /* {{{ */
+{
+  if ((s == NULL) || (s->count == 0))
+    return NAN;
+  return s->sum / (double)s->count;
+} /* }}} double ddsketch_average */
+
+void ddsketch_percentiles(ddsketch_t const *s, /* {{{ */
+                          double const *percent, double *ret, size_t num) {
+  /* Position of the walk through the buckets: `cumulative' values are in the
+   * zero bucket and in the buckets below `key'. */
+  int key = 0;
+  uint64_t cumulative = 0;
+  bool started = false;
+
+  for (size_t i = 0; i < num; i++) {
+    ret[i] = NAN;
+    if ((s == NULL) || (s->count == 0) ||
+        !((percent[i] > 0.0) && (percent[i] <= 100.0)))
+      continue;
+
+    if (percent[i] == 100.0) {
+      ret[i] = s->max;
+      continue;
+    }
+
+    /* The zero based rank of the value to estimate. */
+    double rank = percent[i] / 100.0 * (double)(s->count - 1);
+
+    if (rank < (double)s->zero_count) {
+      ret[i] = 0.0;
+    } else {
+      /* Start over if the percentiles are not sorted. */
+      if (!started || ((double)cumulative > rank)) {
+        key = s->min_key;
+        cumulative = s->zero_count;
+        started = true;
+      }
+
+      while ((key < s->max_key) &&
+             ((double)(cumulative + s->counts[key - s->offset]) <= rank)) {
+        cumulative += s->counts[key - s->offset];
+        key++;
+      }
+      ret[i] = ddsketch_value(s, key);
+    }
+
+    if (ret[i] < s->min)
+      ret[i] = s->min;
+    if (ret[i] > s->max)
+      ret[i] = s->max;
+  }
+} /* }}} void ddsketch_percentiles */
+
+double ddsketch_percentile(ddsketch_t const *s, double percent) /* {{{ */
+{
+  double ret = NAN;
+  ddsketch_percentiles(s, &percent, &ret, 1);
+  return ret;
+} /* }}} double ddsketch_percentile */
@@ -0,0 +1,123 @@
+/**
+ * collectd - src/utils/ddsketch/ddsketch.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_DDSKETCH_H
+#define UTILS_DDSKETCH_H 1
+
+#include "collectd.h"
+
+/*
+ * Quantile sketch after Masson, Rim and Lee, "DDSketch: A Fast and
+ * Fully-Mergeable Quantile Sketch with Relative-Error Guarantees" (2019).
+ *
+ * Positive values are counted in logarithmic buckets: bucket k holds the
+ * values in (gamma^(k-1), gamma^k] with gamma = (1 + a) / (1 - a), so every
+ * percentile is estimated with a relative error of at most `a'. Buckets are
+ * allocated for the range of values actually seen. If more than
+ * `max_buckets' buckets would be needed, the lowest buckets are collapsed
+ * into one, which keeps the memory bounded and only affects the accuracy of
+ * the lowest percentiles. Zero, negative and very small values are counted in
+ * a separate zero bucket and estimated as zero.
+ *
+ * Sketches with the same relative accuracy can be merged without losing
+ * accuracy, e.g. to combine sketches filled by different threads or over
+ * several intervals. A sketch is not thread-safe.
+ */
+struct ddsketch_s;
+typedef struct ddsketch_s ddsketch_t;
+
+#define DDSKETCH_DEFAULT_ACCURACY 0.01
+#define DDSKETCH_DEFAULT_MAX_BUCKETS 2048
+
+/*
+ * NAME
+ *   ddsketch_create
+ *
+ * DESCRIPTION
+ *   Creates an empty sketch with the relative accuracy `relative_accuracy',
+ *   which must be in the [0.000001, 0.5] range, using at most `max_buckets'
+ *   buckets. With the default accuracy of 1%, the default number of buckets
+ *   covers values over 17 orders of magnitude.
+ *
+ * RETURN VALUE
+ *   The new sketch or NULL on error.
+ */
+ddsketch_t *ddsketch_create(double relative_accuracy, size_t max_buckets);
+void ddsketch_destroy(ddsketch_t *s);
+
+/* Adds `value' to the sketch. NaN is ignored. */
+void ddsketch_add(ddsketch_t *s, double value);
+
+/* Removes all values, keeping the allocated buckets. */
+void ddsketch_reset(ddsketch_t *s);
+
+/*
+ * NAME
+ *   ddsketch_merge
+ *
+ * DESCRIPTION
+ *   Adds the values counted by `src' to `dst', as if they had been added to
+ *   `dst' directly. Both sketches must have the same relative accuracy.
+ *   `src' is not changed.
+ *
+ * RETURN VALUE
+ *   Zero on success, EINVAL if the accuracies differ and ENOMEM if buckets
+ *   could not be allocated.
+ */
+int ddsketch_merge(ddsketch_t *dst, ddsketch_t const *src);
+
+uint64_t ddsketch_count(ddsketch_t const *s);
+double ddsketch_sum(ddsketch_t const *s);
+/* The following return NaN if the sketch is empty. */
+double ddsketch_min(ddsketch_t const *s);
+double ddsketch_max(ddsketch_t const *s);
+double ddsketch_average(ddsketch_t const *s);
+
+/*
+ * NAME
+ *   ddsketch_percentile
+ *
+ * DESCRIPTION
+ *   Estimates the value below which `percent' percent of the values fall. The
+ *   estimate is clamped to the smallest and largest value added, so the 100th
+ *   percentile is exact.
+ *
+ * RETURN VALUE
+ *   The estimate or NaN if the sketch is empty or `percent' is not in the
+ *   (0, 100] range.
+ */
+double ddsketch_percentile(ddsketch_t const *s, double percent);
+
+/*
+ * NAME
+ *   ddsketch_percentiles
+ *
+ * DESCRIPTION
+ *   Like ddsketch_percentile(), but estimates `num' percentiles at once and
+ *   stores them in `ret'. If `percent' is sorted in ascending order, the
+ *   buckets are only walked once.
+ */
+void ddsketch_percentiles(ddsketch_t const *s, double const *percent,
+                          double *ret, size_t num);
+
+#endif /* UTILS_DDSKETCH_H */
@@ -0,0 +1,218 @@
+/**
+ * collectd - src/utils/ddsketch/ddsketch_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+#include "utils/common/common.h" /* for STATIC_ARRAY_SIZE */
+
+#include "testing.h"
+#include "utils/ddsketch/ddsketch.h"
+
+/* Returns true if `got' is within the relative error `accuracy' of `want'. */
+static bool within(double want, double got, double accuracy) {
+  return fabs(got - want) <= accuracy * fabs(want) * (1.0 + 1e-9);
+}
+
+DEF_TEST(simple) {
+  ddsketch_t *s;
+  CHECK_NOT_NULL(s = ddsketch_create(DDSKETCH_DEFAULT_ACCURACY,
+                                     DDSKETCH_DEFAULT_MAX_BUCKETS));
+
+  OK(isnan(ddsketch_percentile(s, 50.0)));
+  OK(isnan(ddsketch_average(s)));
+  OK(isnan(ddsketch_min(s)));
+
+  for (int i = 1; i <= 100; i++)
+    ddsketch_add(s, (double)i);
+  ddsketch_add(s, NAN);
+
+  EXPECT_EQ_UINT64(100, ddsketch_count(s));
+  EXPECT_EQ_DOUBLE(1.0, ddsketch_min(s));
+  EXPECT_EQ_DOUBLE(100.0, ddsketch_max(s));
+  EXPECT_EQ_DOUBLE(5050.0, ddsketch_sum(s));
+  EXPECT_EQ_DOUBLE(50.5, ddsketch_average(s));
+
+  double percent[] = {1.0, 50.0, 80.0, 95.0, 99.0, 100.0};
+  double want[] = {1.0, 50.0, 80.0, 95.0, 99.0, 100.0};
+  double got[STATIC_ARRAY_SIZE(percent)];
+  ddsketch_percentiles(s, percent, got, STATIC_ARRAY_SIZE(percent));
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(percent); i++) {
+    printf("# percentile %g = %g\n", percent[i], got[i]);
+    OK(within(want[i], got[i], DDSKETCH_DEFAULT_ACCURACY));
+    EXPECT_EQ_DOUBLE(got[i], ddsketch_percentile(s, percent[i]));
+  }
+
+  /* Unsorted percentiles give the same results. */
+  double reverse[STATIC_ARRAY_SIZE(percent)];
+  double got_reverse[STATIC_ARRAY_SIZE(percent)];
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(percent); i++)
+    reverse[i] = percent[STATIC_ARRAY_SIZE(percent) - 1 - i];
+  ddsketch_percentiles(s, reverse, got_reverse, STATIC_ARRAY_SIZE(percent));
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(percent); i++)
+    EXPECT_EQ_DOUBLE(got[STATIC_ARRAY_SIZE(percent) - 1 - i], got_reverse[i]);
+
+  OK(isnan(ddsketch_percentile(s, 0.0)));
+  OK(isnan(ddsketch_percentile(s, 101.0)));
+
+  ddsketch_reset(s);
+  EXPECT_EQ_UINT64(0, ddsketch_count(s));
+  OK(isnan(ddsketch_percentile(s, 50.0)));
+
+  /* Zero and negative values are estimated as zero. */
+  ddsketch_add(s, 0.0);
+  ddsketch_add(s, -1.0);
+  ddsketch_add(s, 2.0);
+  ddsketch_add(s, 2.0);
+  EXPECT_EQ_DOUBLE(0.0, ddsketch_percentile(s, 50.0));
+  OK(within(2.0, ddsketch_percentile(s, 99.0), DDSKETCH_DEFAULT_ACCURACY));
+  EXPECT_EQ_DOUBLE(-1.0, ddsketch_min(s));
+
+  ddsketch_destroy(s);
+  return 0;
+}
+
+DEF_TEST(accuracy) {
+  double accuracy[] = {0.05, 0.01, 0.001};
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(accuracy); i++) {
+    ddsketch_t *s;
+    CHECK_NOT_NULL(s = ddsketch_create(accuracy[i], 1 << 16));
+
+    /* Values spread over eight orders of magnitude, added in an order that
+     * makes the buckets grow in both directions. */
+    size_t num = 100000;
+    for (size_t j = 0; j < num; j++) {
+      size_t k = (j * 7919) % num;
+      ddsketch_add(s, 1e-4 * pow(1e8, (double)k / (double)(num - 1)));
+    }
+
+    for (double p = 1.0; p < 100.0; p += 1.0) {
+      /* The value with the zero based rank p/100 * (num - 1). */
+      size_t rank = (size_t)(p / 100.0 * (double)(num - 1));
+      double want = 1e-4 * pow(1e8, (double)rank / (double)(num - 1));
+      double got = ddsketch_percentile(s, p);
+      if (!within(want, got, accuracy[i])) {
+        printf("not ok - accuracy %g: percentile %g = %g, want %g\n",
+               accuracy[i], p, got, want);
+        ddsketch_destroy(s);
+        return -1;
+      }
+    }
+    OK1(true, "percentiles are within the relative accuracy");
+
+    ddsketch_destroy(s);
+  }
+
+  return 0;
+}
+
+DEF_TEST(merge) {
+  ddsketch_t *a;
+  ddsketch_t *b;
+  ddsketch_t *all;
+  CHECK_NOT_NULL(a = ddsketch_create(0.01, 2048));
+  CHECK_NOT_NULL(b = ddsketch_create(0.01, 2048));
+  CHECK_NOT_NULL(all = ddsketch_create(0.01, 2048));
+
+  /* Merging an empty sketch changes nothing. */
+  CHECK_ZERO(ddsketch_merge(a, b));
+  EXPECT_EQ_UINT64(0, ddsketch_count(a));
+
+  /* The sketches cover different ranges, so that merging has to extend the
+   * buckets of `a'. */
+  for (int i = 1; i <= 1000; i++) {
+    double value = (i % 2) ? (double)i : 1000.0 * (double)i;
+    ddsketch_add((i % 2) ? a : b, value);
+    ddsketch_add(all, value);
+  }
+  CHECK_ZERO(ddsketch_merge(a, b));
+
+  EXPECT_EQ_UINT64(1000, ddsketch_count(a));
+  EXPECT_EQ_DOUBLE(ddsketch_min(all), ddsketch_min(a));
+  EXPECT_EQ_DOUBLE(ddsketch_max(all), ddsketch_max(a));
+  EXPECT_EQ_DOUBLE(ddsketch_sum(all), ddsketch_sum(a));
+  for (double p = 5.0; p <= 100.0; p += 5.0)
+    EXPECT_EQ_DOUBLE(ddsketch_percentile(all, p), ddsketch_percentile(a, p));
+
+  /* The source is not changed. */
+  EXPECT_EQ_UINT64(500, ddsketch_count(b));
+
+  /* Sketches with a different accuracy can not be merged. */
+  ddsketch_t *other;
+  CHECK_NOT_NULL(other = ddsketch_create(0.02, 2048));
+  ddsketch_add(other, 1.0);
+  EXPECT_EQ_INT(EINVAL, ddsketch_merge(a, other));
+  EXPECT_EQ_UINT64(1000, ddsketch_count(a));
+
+  ddsketch_destroy(other);
+  ddsketch_destroy(all);
+  ddsketch_destroy(b);
+  ddsketch_destroy(a);
+  return 0;
+}
+
+DEF_TEST(collapse) {
+  ddsketch_t *s;
+  /* With 1% accuracy, 300 buckets cover a range of about 1:400. */
+  CHECK_NOT_NULL(s = ddsketch_create(0.01, 300));
+
+  for (int i = 0; i < 10; i++)
+    ddsketch_add(s, 1e-6);
+  for (int i = 0; i < 90; i++)
+    ddsketch_add(s, 1.0 + (double)i);
+
+  /* The small values are collapsed into the lowest bucket, high percentiles
+   * are not affected. */
+  EXPECT_EQ_UINT64(100, ddsketch_count(s));
+  EXPECT_EQ_DOUBLE(1e-6, ddsketch_min(s));
+  OK(ddsketch_percentile(s, 5.0) > 1e-6);
+  OK(within(86.0, ddsketch_percentile(s, 96.0), 0.01));
+
+  /* Values below the collapsed range are added to the lowest bucket. */
+  ddsketch_add(s, 1e-9);
+  EXPECT_EQ_UINT64(101, ddsketch_count(s));
+  OK(within(86.0, ddsketch_percentile(s, 96.0), 0.015));
+
+  ddsketch_destroy(s);
+  return 0;
+}
+
+DEF_TEST(invalid) {
+  OK(ddsketch_create(0.0, 2048) == NULL);
+  OK(ddsketch_create(1.0, 2048) == NULL);
+  OK(ddsketch_create(NAN, 2048) == NULL);
+  OK(ddsketch_create(0.01, 0) == NULL);
+
+  EXPECT_EQ_UINT64(0, ddsketch_count(NULL));
+  OK(isnan(ddsketch_percentile(NULL, 50.0)));
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(simple);
+  RUN_TEST(accuracy);
+  RUN_TEST(merge);
+  RUN_TEST(collapse);
+  RUN_TEST(invalid);
+
+  END_TEST;
+}
@@ -43,359 +43,251 @@
 #endif
 #endif
 
-static int json_escape_string(char *buffer, size_t buffer_size, /* {{{ */
-                              const char *string) {
-  size_t dst_pos;
-
-  if ((buffer == NULL) || (string == NULL))
-    return -EINVAL;
-
-  if (buffer_size < 3)
-    return -ENOMEM;
-
-  dst_pos = 0;
-
-#define BUFFER_ADD(c)                                                          \
-  do {                                                                         \
-    if (dst_pos >= (buffer_size - 1)) {                                        \
-      buffer[buffer_size - 1] = '\0';                                          \
-      return -ENOMEM;                                                          \
-    }                                                                          \
-    buffer[dst_pos] = (c);                                                     \
-    dst_pos++;                                                                 \
-  } while (0)
-
-  /* Escape special characters */
-  BUFFER_ADD('"');
-  for (size_t src_pos = 0; string[src_pos] != 0; src_pos++) {
-    if ((string[src_pos] == '"') || (string[src_pos] == '\\')) {
-      BUFFER_ADD('\\');
-      BUFFER_ADD(string[src_pos]);
-    } else if (string[src_pos] <= 0x001F)
-      BUFFER_ADD('?');
-    else
-      BUFFER_ADD(string[src_pos]);
-  } /* for */
-  BUFFER_ADD('"');
-  buffer[dst_pos] = 0;
+/* Number of data sets for which the "dstypes" and "dsnames" members are cached
+ * per thread. */
+#ifndef FORMAT_JSON_DS_CACHE_SIZE
+#define FORMAT_JSON_DS_CACHE_SIZE 64
+#endif
 
-#undef BUFFER_ADD
+/* The encoded "dstypes" and "dsnames" members of a data set. Data sets are
+ * registered once and used for many value lists, so the members are encoded
+ * once per thread and copied into the output. The type name and number of
+ * data sources guard against a data set that has been freed and another one
+ * allocated at the same address. */
+typedef struct {
+  data_set_t const *ds;
+  char type[DATA_MAX_NAME_LEN];
+  size_t ds_num;
+  char *json;
+  size_t json_len;
+} ds_fragment_t;
+
+static pthread_key_t ds_cache_key;
+static pthread_once_t ds_cache_once = PTHREAD_ONCE_INIT;
+static bool ds_cache_available;
+
+static void ds_cache_free(void *arg) /* {{{ */
+{
+  ds_fragment_t *cache = arg;
 
-  return 0;
-} /* }}} int json_escape_string */
+  for (size_t i = 0; i < FORMAT_JSON_DS_CACHE_SIZE; i++)
+    free(cache[i].json);
+  free(cache);
+} /* }}} void ds_cache_free */
 
-static int values_to_json(char *buffer, size_t buffer_size, /* {{{ */
-                          const data_set_t *ds, const value_list_t *vl,
-                          int store_rates) {
-  size_t offset = 0;
-  gauge_t *rates = NULL;
+static void ds_cache_init(void) /* {{{ */
+{
+  ds_cache_available = (pthread_key_create(&ds_cache_key, ds_cache_free) == 0);
+} /* }}} void ds_cache_init */
 
-  memset(buffer, 0, buffer_size);
+static void ds_to_json(json_encoder_t *e, data_set_t const *ds) /* {{{ */
+{
+  json_encoder_key(e, "dstypes");
+  json_encoder_array_open(e);
+  for (size_t i = 0; i < ds->ds_num; i++)
+    json_encoder_string(e, DS_TYPE_TO_STRING(ds->ds[i].type));
+  json_encoder_array_close(e);
+
+  json_encoder_key(e, "dsnames");
+  json_encoder_array_open(e);
+  for (size_t i = 0; i < ds->ds_num; i++)
+    json_encoder_string(e, ds->ds[i].name);
+  json_encoder_array_close(e);
+} /* }}} void ds_to_json */
+
+/* Returns the cached members of `ds', encoding them if necessary, or NULL if
+ * caching is not possible. */
+static ds_fragment_t const *ds_fragment(data_set_t const *ds) /* {{{ */
+{
+  pthread_once(&ds_cache_once, ds_cache_init);
+  if (!ds_cache_available)
+    return NULL;
+
+  ds_fragment_t *cache = pthread_getspecific(ds_cache_key);
+  if (cache == NULL) {
+    cache = calloc(FORMAT_JSON_DS_CACHE_SIZE, sizeof(*cache));
+    if (cache == NULL)
+      return NULL;
+    if (pthread_setspecific(ds_cache_key, cache) != 0) {
+      free(cache);
+      return NULL;
+    }
+  }
 
-#define BUFFER_ADD(...)                                                        \
-  do {                                                                         \
-    int status;                                                                \
-    status = snprintf(buffer + offset, buffer_size - offset, __VA_ARGS__);     \
-    if (status < 1) {                                                          \
-      sfree(rates);                                                            \
-      return -1;                                                               \
-    } else if (((size_t)status) >= (buffer_size - offset)) {                   \
-      sfree(rates);                                                            \
-      return -ENOMEM;                                                          \
-    } else                                                                     \
-      offset += ((size_t)status);                                              \
-  } while (0)
+  ds_fragment_t *f =
+      cache + (((uintptr_t)ds / sizeof(void *)) % FORMAT_JSON_DS_CACHE_SIZE);
+  if ((f->ds == ds) && (f->ds_num == ds->ds_num) &&
+      (strcmp(f->type, ds->type) == 0))
+    return f;
+
+  json_encoder_t e;
+  json_encoder_init(&e);
+  ds_to_json(&e, ds);
+  if (json_encoder_status(&e) != 0) {
+    json_encoder_destroy(&e);
+    return NULL;
+  }
 
-  BUFFER_ADD("[");
+  free(f->json);
+  *f = (ds_fragment_t){
+      .ds = ds,
+      .ds_num = ds->ds_num,
+      .json = e.buffer,
+      .json_len = json_encoder_len(&e),
+  };
+  sstrncpy(f->type, ds->type, sizeof(f->type));
+  return f;
+} /* }}} ds_fragment_t const *ds_fragment */
+
+static void values_to_json(json_encoder_t *e, /* {{{ */
+                           const data_set_t *ds, const value_list_t *vl,
+                           gauge_t const *rates) {
+  json_encoder_array_open(e);
   for (size_t i = 0; i < ds->ds_num; i++) {
-    if (i > 0)
-      BUFFER_ADD(",");
-
-    if (ds->ds[i].type == DS_TYPE_GAUGE) {
-      if (isfinite(vl->values[i].gauge))
-        BUFFER_ADD(JSON_GAUGE_FORMAT, vl->values[i].gauge);
-      else
-        BUFFER_ADD("null");
-    } else if (store_rates) {
-      if (rates == NULL)
-        rates = uc_get_rate(ds, vl);
-      if (rates == NULL) {
-        WARNING("utils_format_json: uc_get_rate failed.");
-        sfree(rates);
-        return -1;
-      }
-
-      if (isfinite(rates[i]))
-        BUFFER_ADD(JSON_GAUGE_FORMAT, rates[i]);
-      else
-        BUFFER_ADD("null");
-    } else if (ds->ds[i].type == DS_TYPE_COUNTER)
-      BUFFER_ADD("%" PRIu64, (uint64_t)vl->values[i].counter);
+    if (ds->ds[i].type == DS_TYPE_GAUGE)
+      json_encoder_double(e, vl->values[i].gauge);
+    else if (rates != NULL)
+      json_encoder_double(e, rates[i]);
+    else if (ds->ds[i].type == DS_TYPE_COUNTER)
+      json_encoder_uint64(e, (uint64_t)vl->values[i].counter);
     else if (ds->ds[i].type == DS_TYPE_DERIVE)
-      BUFFER_ADD("%" PRIi64, vl->values[i].derive);
+      json_encoder_int64(e, vl->values[i].derive);
     else if (ds->ds[i].type == DS_TYPE_ABSOLUTE)
-      BUFFER_ADD("%" PRIu64, vl->values[i].absolute);
+      json_encoder_uint64(e, vl->values[i].absolute);
     else {
       ERROR("format_json: Unknown data source type: %i", ds->ds[i].type);
-      sfree(rates);
-      return -1;
+      json_encoder_null(e);
     }
   } /* for ds->ds_num */
-  BUFFER_ADD("]");
-
-#undef BUFFER_ADD
-
-  sfree(rates);
-  return 0;
-} /* }}} int values_to_json */
-
-static int dstypes_to_json(char *buffer, size_t buffer_size, /* {{{ */
-                           const data_set_t *ds) {
-  size_t offset = 0;
-
-  memset(buffer, 0, buffer_size);
-
-#define BUFFER_ADD(...)                                                        \
-  do {                                                                         \
-    int status;                                                                \
-    status = snprintf(buffer + offset, buffer_size - offset, __VA_ARGS__);     \
-    if (status < 1)                                                            \
-      return -1;                                                               \
-    else if (((size_t)status) >= (buffer_size - offset))                       \
-      return -ENOMEM;                                                          \
-    else                                                                       \
-      offset += ((size_t)status);                                              \
-  } while (0)
-
-  BUFFER_ADD("[");
-  for (size_t i = 0; i < ds->ds_num; i++) {
-    if (i > 0)
-      BUFFER_ADD(",");
-
-    BUFFER_ADD("\"%s\"", DS_TYPE_TO_STRING(ds->ds[i].type));
-  } /* for ds->ds_num */
-  BUFFER_ADD("]");
-
-#undef BUFFER_ADD
-
-  return 0;
-} /* }}} int dstypes_to_json */
-
-static int dsnames_to_json(char *buffer, size_t buffer_size, /* {{{ */
-                           const data_set_t *ds) {
-  size_t offset = 0;
-
-  memset(buffer, 0, buffer_size);
-
-#define BUFFER_ADD(...)                                                        \
-  do {                                                                         \
-    int status;                                                                \
-    status = snprintf(buffer + offset, buffer_size - offset, __VA_ARGS__);     \
-    if (status < 1)                                                            \
-      return -1;                                                               \
-    else if (((size_t)status) >= (buffer_size - offset))                       \
-      return -ENOMEM;                                                          \
-    else                                                                       \
-      offset += ((size_t)status);                                              \
-  } while (0)
-
-  BUFFER_ADD("[");
-  for (size_t i = 0; i < ds->ds_num; i++) {
-    if (i > 0)
-      BUFFER_ADD(",");
-
-    BUFFER_ADD("\"%s\"", ds->ds[i].name);
-  } /* for ds->ds_num */
-  BUFFER_ADD("]");
-
-#undef BUFFER_ADD
-
-  return 0;
-} /* }}} int dsnames_to_json */
-
-static int meta_data_keys_to_json(char *buffer, size_t buffer_size, /* {{{ */
-                                  meta_data_t *meta, char **keys,
-                                  size_t keys_num) {
-  size_t offset = 0;
-  int status;
+  json_encoder_array_close(e);
+} /* }}} void values_to_json */
 
-  buffer[0] = 0;
-
-#define BUFFER_ADD(...)                                                        \
-  do {                                                                         \
-    status = snprintf(buffer + offset, buffer_size - offset, __VA_ARGS__);     \
-    if (status < 1)                                                            \
-      return -1;                                                               \
-    else if (((size_t)status) >= (buffer_size - offset))                       \
-      return -ENOMEM;                                                          \
-    else                                                                       \
-      offset += ((size_t)status);                                              \
-  } while (0)
+static void meta_data_to_json(json_encoder_t *e, /* {{{ */
+                              meta_data_t *meta) {
+  char **keys = NULL;
+  int status = meta_data_toc(meta, &keys);
+  if (status <= 0)
+    return;
+  size_t keys_num = (size_t)status;
 
+  json_encoder_key(e, "meta");
+  json_encoder_object_open(e);
   for (size_t i = 0; i < keys_num; ++i) {
-    int type;
     char *key = keys[i];
+    int type = meta_data_type(meta, key);
 
-    type = meta_data_type(meta, key);
     if (type == MD_TYPE_STRING) {
       char *value = NULL;
       if (meta_data_get_string(meta, key, &value) == 0) {
-        char temp[512] = "";
-
-        status = json_escape_string(temp, sizeof(temp), value);
+        json_encoder_key(e, key);
+        json_encoder_string(e, value);
         sfree(value);
-        if (status != 0)
-          return status;
-
-        BUFFER_ADD(",\"%s\":%s", key, temp);
       }
     } else if (type == MD_TYPE_SIGNED_INT) {
       int64_t value = 0;
-      if (meta_data_get_signed_int(meta, key, &value) == 0)
-        BUFFER_ADD(",\"%s\":%" PRIi64, key, value);
+      if (meta_data_get_signed_int(meta, key, &value) == 0) {
+        json_encoder_key(e, key);
+        json_encoder_int64(e, value);
+      }
     } else if (type == MD_TYPE_UNSIGNED_INT) {
       uint64_t value = 0;
-      if (meta_data_get_unsigned_int(meta, key, &value) == 0)
-        BUFFER_ADD(",\"%s\":%" PRIu64, key, value);
+      if (meta_data_get_unsigned_int(meta, key, &value) == 0) {
+        json_encoder_key(e, key);
+        json_encoder_uint64(e, value);
+      }
     } else if (type == MD_TYPE_DOUBLE) {
       double value = 0.0;
-      if (meta_data_get_double(meta, key, &value) == 0)
-        BUFFER_ADD(",\"%s\":%f", key, value);
+      if (meta_data_get_double(meta, key, &value) == 0) {
+        json_encoder_key(e, key);
+        json_encoder_double(e, value);
+      }
     } else if (type == MD_TYPE_BOOLEAN) {
       bool value = false;
-      if (meta_data_get_boolean(meta, key, &value) == 0)
-        BUFFER_ADD(",\"%s\":%s", key, value ? "true" : "false");
+      if (meta_data_get_boolean(meta, key, &value) == 0) {
+        json_encoder_key(e, key);
+        json_encoder_bool(e, value);
+      }
     }
   } /* for (keys) */
-
-  if (offset == 0)
-    return ENOENT;
-
-  buffer[0] = '{'; /* replace leading ',' */
-  BUFFER_ADD("}");
-
-#undef BUFFER_ADD
-
-  return 0;
-} /* }}} int meta_data_keys_to_json */
-
-static int meta_data_to_json(char *buffer, size_t buffer_size, /* {{{ */
-                             meta_data_t *meta) {
-  char **keys = NULL;
-  size_t keys_num;
-  int status;
-
-  if ((buffer == NULL) || (buffer_size == 0) || (meta == NULL))
-    return EINVAL;
-
-  status = meta_data_toc(meta, &keys);
-  if (status <= 0)
-    return status;
-  keys_num = (size_t)status;
-
-  status = meta_data_keys_to_json(buffer, buffer_size, meta, keys, keys_num);
+  json_encoder_object_close(e);
 
   for (size_t i = 0; i < keys_num; ++i)
     sfree(keys[i]);
   sfree(keys);
+} /* }}} void meta_data_to_json */
 
-  return status;
-} /* }}} int meta_data_to_json */
-
-static int value_list_to_json(char *buffer, size_t buffer_size, /* {{{ */
-                              const data_set_t *ds, const value_list_t *vl,
-                              int store_rates) {
-  char temp[512];
-  size_t offset = 0;
-  int status;
-
-  memset(buffer, 0, buffer_size);
-
-#define BUFFER_ADD(...)                                                        \
-  do {                                                                         \
-    status = snprintf(buffer + offset, buffer_size - offset, __VA_ARGS__);     \
-    if (status < 1)                                                            \
-      return -1;                                                               \
-    else if (((size_t)status) >= (buffer_size - offset))                       \
-      return -ENOMEM;                                                          \
-    else                                                                       \
-      offset += ((size_t)status);                                              \
-  } while (0)
-
-  /* All value lists have a leading comma. The first one will be replaced with
-   * a square bracket in `format_json_finalize'. */
-  BUFFER_ADD(",{");
-
-  status = values_to_json(temp, sizeof(temp), ds, vl, store_rates);
-  if (status != 0)
-    return status;
-  BUFFER_ADD("\"values\":%s", temp);
-
-  status = dstypes_to_json(temp, sizeof(temp), ds);
-  if (status != 0)
-    return status;
-  BUFFER_ADD(",\"dstypes\":%s", temp);
-
-  status = dsnames_to_json(temp, sizeof(temp), ds);
-  if (status != 0)
-    return status;
-  BUFFER_ADD(",\"dsnames\":%s", temp);
-
-  BUFFER_ADD(",\"time\":%.3f", CDTIME_T_TO_DOUBLE(vl->time));
-  BUFFER_ADD(",\"interval\":%.3f", CDTIME_T_TO_DOUBLE(vl->interval));
-
-#define BUFFER_ADD_KEYVAL(key, value)                                          \
-  do {                                                                         \
-    status = json_escape_string(temp, sizeof(temp), (value));                  \
-    if (status != 0)                                                           \
-      return status;                                                           \
-    BUFFER_ADD(",\"%s\":%s", (key), temp);                                     \
-  } while (0)
+int format_json_encode_value_list(json_encoder_t *e, /* {{{ */
+                                  const data_set_t *ds, const value_list_t *vl,
+                                  int store_rates) {
+  if ((e == NULL) || (ds == NULL) || (vl == NULL))
+    return EINVAL;
 
-  BUFFER_ADD_KEYVAL("host", vl->host);
-  BUFFER_ADD_KEYVAL("plugin", vl->plugin);
-  BUFFER_ADD_KEYVAL("plugin_instance", vl->plugin_instance);
-  BUFFER_ADD_KEYVAL("type", vl->type);
-  BUFFER_ADD_KEYVAL("type_instance", vl->type_instance);
+  /* Get the rates first, so that nothing has been written if this fails. */
+  gauge_t *rates = NULL;
+  for (size_t i = 0; store_rates && (i < ds->ds_num); i++) {
+    if (ds->ds[i].type == DS_TYPE_GAUGE)
+      continue;
 
-  if (vl->meta != NULL) {
-    char meta_buffer[buffer_size];
-    memset(meta_buffer, 0, sizeof(meta_buffer));
-    status = meta_data_to_json(meta_buffer, sizeof(meta_buffer), vl->meta);
-    if (status != 0)
-      return status;
+    rates = uc_get_rate(ds, vl);
+    if (rates == NULL) {
+      WARNING("utils_format_json: uc_get_rate failed.");
+      return -1;
+    }
+    break;
+  }
 
-    BUFFER_ADD(",\"meta\":%s", meta_buffer);
-  } /* if (vl->meta != NULL) */
+  json_encoder_object_open(e);
 
-  BUFFER_ADD("}");
+  json_encoder_key(e, "values");
+  values_to_json(e, ds, vl, rates);
+  sfree(rates);
 
-#undef BUFFER_ADD_KEYVAL
-#undef BUFFER_ADD
+  ds_fragment_t const *f = ds_fragment(ds);
+  if (f != NULL)
+    json_encoder_raw(e, f->json, f->json_len);
+  else
+    ds_to_json(e, ds);
+
+  json_encoder_key(e, "time");
+  json_encoder_cdtime(e, vl->time);
+  json_encoder_key(e, "interval");
+  json_encoder_cdtime(e, vl->interval);
+
+  json_encoder_key(e, "host");
+  json_encoder_string(e, vl->host);
+  json_encoder_key(e, "plugin");
+  json_encoder_string(e, vl->plugin);
+  json_encoder_key(e, "plugin_instance");
+  json_encoder_string(e, vl->plugin_instance);
+  json_encoder_key(e, "type");
+  json_encoder_string(e, vl->type);
+  json_encoder_key(e, "type_instance");
+  json_encoder_string(e, vl->type_instance);
+
+  if (vl->meta != NULL)
+    meta_data_to_json(e, vl->meta);
+
+  json_encoder_object_close(e);
+
+  return json_encoder_status(e);
+} /* }}} int format_json_encode_value_list */
+
+int format_json_value_lists(json_encoder_t *e, /* {{{ */
+                            const data_set_t *const *ds,
+                            const value_list_t *const *vl, size_t num,
+                            int store_rates) {
+  if ((e == NULL) || ((num > 0) && ((ds == NULL) || (vl == NULL))))
+    return EINVAL;
 
-  return 0;
-} /* }}} int value_list_to_json */
-
-static int format_json_value_list_nocheck(char *buffer, /* {{{ */
-                                          size_t *ret_buffer_fill,
-                                          size_t *ret_buffer_free,
-                                          const data_set_t *ds,
-                                          const value_list_t *vl,
-                                          int store_rates, size_t temp_size) {
-  char temp[temp_size];
-  int status;
-
-  status = value_list_to_json(temp, sizeof(temp), ds, vl, store_rates);
-  if (status != 0)
-    return status;
-  temp_size = strlen(temp);
-
-  memcpy(buffer + (*ret_buffer_fill), temp, temp_size + 1);
-  (*ret_buffer_fill) += temp_size;
-  (*ret_buffer_free) -= temp_size;
+  json_encoder_array_open(e);
+  for (size_t i = 0; i < num; i++) {
+    /* Value lists without rates are left out. */
+    format_json_encode_value_list(e, ds[i], vl[i], store_rates);
+  }
+  json_encoder_array_close(e);
 
-  return 0;
-} /* }}} int format_json_value_list_nocheck */
+  return json_encoder_status(e);
+} /* }}} int format_json_value_lists */
 
 int format_json_initialize(char *buffer, /* {{{ */
                            size_t *ret_buffer_fill, size_t *ret_buffer_free) {
@@ -433,7 +325,7 @@ int format_json_finalize(char *buffer, /* {{{ */
   if (*ret_buffer_free < 2)
     return -ENOMEM;
 
-  /* Replace the leading comma added in `value_list_to_json' with a square
+  /* Replace the leading comma added in `format_json_value_list' with a square
    * bracket. */
   if (buffer[0] != ',')
     return -EINVAL;
@@ -457,12 +349,28 @@ int format_json_value_list(char *buffer, /* {{{ */
       (ret_buffer_free == NULL) || (ds == NULL) || (vl == NULL))
     return -EINVAL;
 
-  if (*ret_buffer_free < 3)
+  /* Room for the leading comma and for the closing bracket added by
+   * `format_json_finalize'. */
+  if (*ret_buffer_free < 4)
     return -ENOMEM;
 
-  return format_json_value_list_nocheck(buffer, ret_buffer_fill,
-                                        ret_buffer_free, ds, vl, store_rates,
-                                        (*ret_buffer_free) - 2);
+  /* All value lists have a leading comma. The first one will be replaced with
+   * a square bracket in `format_json_finalize'. */
+  char *start = buffer + *ret_buffer_fill;
+  json_encoder_t e;
+  json_encoder_init_fixed(&e, start + 1, *ret_buffer_free - 3);
+
+  int status = format_json_encode_value_list(&e, ds, vl, store_rates);
+  if (status != 0) {
+    start[0] = 0;
+    return (status == ENOMEM) ? -ENOMEM : -1;
+  }
+
+  start[0] = ',';
+  (*ret_buffer_fill) += json_encoder_len(&e) + 1;
+  (*ret_buffer_free) -= json_encoder_len(&e) + 1;
+
+  return 0;
 } /* }}} int format_json_value_list */
 
 #if HAVE_LIBYAJL
@@ -30,11 +30,48 @@
 #include "collectd.h"
 
 #include "plugin.h"
+#include "utils/format_json/json_encoder.h"
 
 #ifndef JSON_GAUGE_FORMAT
 #define JSON_GAUGE_FORMAT GAUGE_FORMAT
 #endif
 
+/*
+ * NAME
+ *   format_json_encode_value_list
+ *
+ * DESCRIPTION
+ *   Adds `vl' as a JSON object to the encoder `e'. If `store_rates' is true,
+ *   counter, derive and absolute values are converted to rates. Nothing is
+ *   added if the rates can not be determined.
+ *
+ * RETURN VALUE
+ *   Zero on success, the error of the encoder, e.g. ENOMEM, or -1 if the rates
+ *   can not be determined.
+ */
+int format_json_encode_value_list(json_encoder_t *e, const data_set_t *ds,
+                                  const value_list_t *vl, int store_rates);
+
+/*
+ * NAME
+ *   format_json_value_lists
+ *
+ * DESCRIPTION
+ *   Adds a JSON array holding the `num' value lists `vl' to the encoder `e'.
+ *   `ds[i]' is the data set of `vl[i]'. Value lists for which rates can not be
+ *   determined are left out.
+ *
+ * RETURN VALUE
+ *   Zero on success or the error of the encoder.
+ */
+int format_json_value_lists(json_encoder_t *e, const data_set_t *const *ds,
+                            const value_list_t *const *vl, size_t num,
+                            int store_rates);
+
+/* Interface writing to a caller-provided buffer: format_json_initialize()
+ * prepares the buffer, each format_json_value_list() call appends a value list
+ * and format_json_finalize() closes the array. The functions return -ENOMEM if
+ * the buffer is full; the buffer then holds the value lists added so far. */
 int format_json_initialize(char *buffer, size_t *ret_buffer_fill,
                            size_t *ret_buffer_free);
 int format_json_value_list(char *buffer, size_t *ret_buffer_fill,
@@ -0,0 +1,176 @@
+/**
+ * collectd - src/utils/format_json/format_json_bench.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/*
+ * Measures the throughput of the JSON value list encoding. Build with
+ * "make bench_format_json" and run as "./bench_format_json [iterations]".
+ *
+ * "value_list" formats every value list into its own buffer with
+ * format_json_initialize(), format_json_value_list() and
+ * format_json_finalize(), as most writers do. "value_lists" encodes batches of
+ * BATCH_SIZE value lists into one array with format_json_value_lists(),
+ * reusing the buffer.
+ *
+ * cdtime() returns a fixed time when linked against the mock library, so the
+ * elapsed time is measured with clock_gettime().
+ */
+
+#include "collectd.h"
+
+#include "utils/common/common.h"
+#include "utils/format_json/format_json.h"
+#include "utils_time.h"
+
+#define BATCH_SIZE 100
+
+static data_set_t ds_if_octets = {
+    .type = "if_octets",
+    .ds_num = 2,
+    .ds =
+        (data_source_t[]){
+            {"rx", DS_TYPE_DERIVE, 0, NAN},
+            {"tx", DS_TYPE_DERIVE, 0, NAN},
+        },
+};
+
+static data_set_t ds_load = {
+    .type = "load",
+    .ds_num = 3,
+    .ds =
+        (data_source_t[]){
+            {"shortterm", DS_TYPE_GAUGE, 0, 5000},
+            {"midterm", DS_TYPE_GAUGE, 0, 5000},
+            {"longterm", DS_TYPE_GAUGE, 0, 5000},
+        },
+};
+
+static value_t values[BATCH_SIZE][3];
+static value_list_t vl[BATCH_SIZE];
+static data_set_t const *ds[BATCH_SIZE];
+
+static void init_value_lists(void) {
+  cdtime_t t = TIME_T_TO_CDTIME_T(1480063672);
+
+  for (size_t i = 0; i < BATCH_SIZE; i++) {
+    vl[i] = (value_list_t){
+        .values = values[i],
+        .time = t,
+        .interval = MS_TO_CDTIME_T(10000),
+        .host = "host.example.com",
+    };
+
+    if (i % 2) {
+      ds[i] = &ds_if_octets;
+      values[i][0].derive = 1234567890 + i;
+      values[i][1].derive = 987654321 + i;
+      vl[i].values_len = 2;
+      sstrncpy(vl[i].plugin, "interface", sizeof(vl[i].plugin));
+      snprintf(vl[i].plugin_instance, sizeof(vl[i].plugin_instance), "eth%zu",
+               i);
+    } else {
+      ds[i] = &ds_load;
+      values[i][0].gauge = 0.37 * i;
+      values[i][1].gauge = 1.0 / (i + 3);
+      values[i][2].gauge = 2.25;
+      vl[i].values_len = 3;
+      sstrncpy(vl[i].plugin, "load", sizeof(vl[i].plugin));
+    }
+    sstrncpy(vl[i].type, ds[i]->type, sizeof(vl[i].type));
+  }
+}
+
+static cdtime_t now(void) {
+  struct timespec ts = {0};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return TIMESPEC_TO_CDTIME_T(&ts);
+}
+
+static void report(char const *name, cdtime_t start, size_t num,
+                   size_t bytes) {
+  double seconds = CDTIME_T_TO_DOUBLE(now() - start);
+  printf("%-12s %10.0f value lists/s %8.1f MB/s\n", name, num / seconds,
+         bytes / seconds / 1e6);
+}
+
+static int bench_value_list(size_t iterations) {
+  char buffer[8192];
+  size_t bytes = 0;
+  cdtime_t start = now();
+
+  for (size_t n = 0; n < iterations; n++) {
+    for (size_t i = 0; i < BATCH_SIZE; i++) {
+      size_t bfill = 0;
+      size_t bfree = sizeof(buffer);
+
+      format_json_initialize(buffer, &bfill, &bfree);
+      if (format_json_value_list(buffer, &bfill, &bfree, ds[i], vl + i, 0) !=
+          0)
+        return -1;
+      format_json_finalize(buffer, &bfill, &bfree);
+      bytes += bfill;
+    }
+  }
+
+  report("value_list", start, iterations * BATCH_SIZE, bytes);
+  return 0;
+}
+
+static int bench_value_lists(size_t iterations) {
+  value_list_t const *vl_ptr[BATCH_SIZE];
+  for (size_t i = 0; i < BATCH_SIZE; i++)
+    vl_ptr[i] = vl + i;
+
+  json_encoder_t e;
+  json_encoder_init(&e);
+
+  size_t bytes = 0;
+  cdtime_t start = now();
+
+  for (size_t n = 0; n < iterations; n++) {
+    json_encoder_reset(&e);
+    if (format_json_value_lists(&e, ds, vl_ptr, BATCH_SIZE, 0) != 0) {
+      json_encoder_destroy(&e);
+      return -1;
+    }
+    bytes += json_encoder_len(&e);
+  }
+
+  report("value_lists", start, iterations * BATCH_SIZE, bytes);
+  json_encoder_destroy(&e);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  size_t iterations = 20000;
+  if (argc > 1)
+    iterations = (size_t)strtoull(argv[1], NULL, 0);
+
+  init_value_lists();
+
+  if ((bench_value_list(iterations) != 0) ||
+      (bench_value_lists(iterations) != 0)) {
+    fprintf(stderr, "Encoding failed.\n");
+    return 1;
+  }
+  return 0;
+}
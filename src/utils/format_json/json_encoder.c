@@ -0,0 +1,747 @@
+/**
+ * collectd - src/utils/format_json/json_encoder.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "utils/format_json/json_encoder.h"
+#include "utils_time.h"
+
+#include <math.h>
+
+#ifndef JSON_ENCODER_INITIAL_SIZE
+#define JSON_ENCODER_INITIAL_SIZE 1024
+#endif
+
+/*
+ * Buffer management
+ */
+void json_encoder_init(json_encoder_t *e) /* {{{ */
+{
+  *e = (json_encoder_t){0};
+} /* }}} void json_encoder_init */
+
+void json_encoder_init_fixed(json_encoder_t *e, char *buffer, /* {{{ */
+                             size_t size) {
+  *e = (json_encoder_t){
+      .buffer = buffer,
+      .size = size,
+      .fixed = true,
+  };
+
+  if ((buffer == NULL) || (size == 0)) {
+    e->buffer = NULL;
+    e->size = 0;
+    e->status = ENOMEM;
+    return;
+  }
+  buffer[0] = 0;
+} /* }}} void json_encoder_init_fixed */
+
+void json_encoder_reset(json_encoder_t *e) /* {{{ */
+{
+  e->len = 0;
+  e->status = ((e->buffer == NULL) && e->fixed) ? ENOMEM : 0;
+  e->have_element = 0;
+  e->depth = 0;
+  e->after_key = false;
+  if (e->buffer != NULL)
+    e->buffer[0] = 0;
+} /* }}} void json_encoder_reset */
+
+void json_encoder_destroy(json_encoder_t *e) /* {{{ */
+{
+  if (e == NULL)
+    return;
+
+  if (!e->fixed)
+    free(e->buffer);
+  *e = (json_encoder_t){0};
+} /* }}} void json_encoder_destroy */
+
+/* Makes room for `n' more bytes and the terminating null byte. */
+static bool json_reserve(json_encoder_t *e, size_t n) /* {{{ */
+{
+  if (e->status != 0)
+    return false;
+
+  size_t need = e->len + n + 1;
+  if (need <= e->size)
+    return true;
+
+  if (e->fixed) {
+    e->status = ENOMEM;
+    return false;
+  }
+
+  size_t size = (e->size == 0) ? JSON_ENCODER_INITIAL_SIZE : e->size;
+  while (size < need)
+    size *= 2;
+
+  char *tmp = realloc(e->buffer, size);
+  if (tmp == NULL) {
+    e->status = ENOMEM;
+    return false;
+  }
+  e->buffer = tmp;
+  e->size = size;
+  return true;
+} /* }}} bool json_reserve */
+
+/* Starts an element of `n' bytes: reserves room for it and writes the comma
+ * separating it from the previous element, if any. */
+static bool json_begin_element(json_encoder_t *e, size_t n) /* {{{ */
+{
+  uint32_t bit = ((uint32_t)1) << e->depth;
+  bool comma = !e->after_key && ((e->have_element & bit) != 0);
+
+  if (!json_reserve(e, n + (comma ? 1 : 0)))
+    return false;
+
+  if (comma)
+    e->buffer[e->len++] = ',';
+  e->have_element |= bit;
+  e->after_key = false;
+  return true;
+} /* }}} bool json_begin_element */
+
+static void json_append(json_encoder_t *e, char const *data, /* {{{ */
+                        size_t len) {
+  memcpy(e->buffer + e->len, data, len);
+  e->len += len;
+  e->buffer[e->len] = 0;
+} /* }}} void json_append */
+
+/*
+ * Structure
+ */
+static void json_open(json_encoder_t *e, char c) /* {{{ */
+{
+  if ((e->status == 0) && (e->depth + 1 >= JSON_ENCODER_MAX_DEPTH)) {
+    e->status = EOVERFLOW;
+    return;
+  }
+  if (!json_begin_element(e, 1))
+    return;
+
+  json_append(e, &c, 1);
+  e->depth++;
+  e->have_element &= ~(((uint32_t)1) << e->depth);
+} /* }}} void json_open */
+
+static void json_close(json_encoder_t *e, char c) /* {{{ */
+{
+  if ((e->status == 0) && (e->depth == 0)) {
+    e->status = EINVAL;
+    return;
+  }
+  if (!json_reserve(e, 1))
+    return;
+
+  json_append(e, &c, 1);
+  e->depth--;
+} /* }}} void json_close */
+
+void json_encoder_object_open(json_encoder_t *e) { json_open(e, '{'); }
+void json_encoder_object_close(json_encoder_t *e) { json_close(e, '}'); }
+void json_encoder_array_open(json_encoder_t *e) { json_open(e, '['); }
+void json_encoder_array_close(json_encoder_t *e) { json_close(e, ']'); }
+
+/*
+ * Strings
+ */
+static size_t json_escaped_char_len(unsigned char c) /* {{{ */
+{
+  if (c >= 0x20)
+    return ((c == '"') || (c == '\\')) ? 2 : 1;
+
+  switch (c) {
+  case '\b':
+  case '\f':
+  case '\n':
+  case '\r':
+  case '\t':
+    return 2;
+  default:
+    return 6; /* \u00XX */
+  }
+} /* }}} size_t json_escaped_char_len */
+
+/* Returns the length of `str' quoted and escaped and sets `plain' if no
+ * character needs to be escaped. */
+static size_t json_escaped_len(char const *str, size_t len, /* {{{ */
+                               bool *plain) {
+  size_t escaped_len = len + 2;
+
+  for (size_t i = 0; i < len; i++)
+    escaped_len += json_escaped_char_len((unsigned char)str[i]) - 1;
+
+  *plain = (escaped_len == len + 2);
+  return escaped_len;
+} /* }}} size_t json_escaped_len */
+
+/* Writes `str' quoted and escaped. Room must have been reserved. */
+static void json_append_escaped(json_encoder_t *e, char const *str, /* {{{ */
+                                size_t len, bool plain) {
+  static char const hex[] = "0123456789abcdef";
+  char *out = e->buffer + e->len;
+
+  *(out++) = '"';
+  if (plain) {
+    memcpy(out, str, len);
+    out += len;
+  } else {
+    for (size_t i = 0; i < len; i++) {
+      unsigned char c = (unsigned char)str[i];
+      size_t n = json_escaped_char_len(c);
+
+      if (n == 1) {
+        *(out++) = (char)c;
+        continue;
+      }
+
+      *(out++) = '\\';
+      switch (c) {
+      case '"':
+      case '\\':
+        *(out++) = (char)c;
+        break;
+      case '\b':
+        *(out++) = 'b';
+        break;
+      case '\f':
+        *(out++) = 'f';
+        break;
+      case '\n':
+        *(out++) = 'n';
+        break;
+      case '\r':
+        *(out++) = 'r';
+        break;
+      case '\t':
+        *(out++) = 't';
+        break;
+      default:
+        memcpy(out, "u00", 3);
+        out[3] = hex[c >> 4];
+        out[4] = hex[c & 0x0f];
+        out += 5;
+      }
+    }
+  }
+  *(out++) = '"';
+  *out = 0;
+
+  e->len = (size_t)(out - e->buffer);
+} /* }}} void json_append_escaped */
+
+void json_encoder_key(json_encoder_t *e, char const *key) /* {{{ */
+{
+  if (key == NULL)
+    key = "";
+
+  size_t len = strlen(key);
+  bool plain;
+  size_t escaped_len = json_escaped_len(key, len, &plain);
+
+  if (!json_begin_element(e, escaped_len + 1))
+    return;
+
+  json_append_escaped(e, key, len, plain);
+  json_append(e, ":", 1);
+  e->after_key = true;
+} /* }}} void json_encoder_key */
+
+void json_encoder_string(json_encoder_t *e, char const *str) /* {{{ */
+{
+  if (str == NULL) {
+    json_encoder_null(e);
+    return;
+  }
+
+  size_t len = strlen(str);
+  bool plain;
+  size_t escaped_len = json_escaped_len(str, len, &plain);
+
+  if (!json_begin_element(e, escaped_len))
+    return;
+
+  json_append_escaped(e, str, len, plain);
+} /* }}} void json_encoder_string */
+
+int json_escape(char *buffer, size_t buffer_size, char const *str) /* {{{ */
+{
+  json_encoder_t e;
+
+  json_encoder_init_fixed(&e, buffer, buffer_size);
+  json_encoder_string(&e, str);
+  return json_encoder_status(&e);
+} /* }}} int json_escape */
+
+void json_encoder_raw(json_encoder_t *e, char const *json, /* {{{ */
+                      size_t json_len) {
+  if (!json_begin_element(e, json_len))
+    return;
+
+  json_append(e, json, json_len);
+} /* }}} void json_encoder_raw */
+
+/*
+ * Numbers
+ */
+
+/* Writes the decimal digits of `value' to the end of `buffer', which must
+ * hold at least 20 bytes, and returns the first digit. */
+static char *json_format_digits(char *end, uint64_t value) /* {{{ */
+{
+  char *p = end;
+
+  do {
+    *(--p) = (char)('0' + (value % 10));
+    value /= 10;
+  } while (value != 0);
+
+  return p;
+} /* }}} char *json_format_digits */
+
+void json_encoder_uint64(json_encoder_t *e, uint64_t value) /* {{{ */
+{
+  char buffer[24];
+  char *end = buffer + sizeof(buffer);
+  char *p = json_format_digits(end, value);
+
+  json_encoder_raw(e, p, (size_t)(end - p));
+} /* }}} void json_encoder_uint64 */
+
+void json_encoder_int64(json_encoder_t *e, int64_t value) /* {{{ */
+{
+  char buffer[24];
+  char *end = buffer + sizeof(buffer);
+  /* Negating INT64_MIN is undefined, negating its unsigned value is not. */
+  char *p = json_format_digits(
+      end, (value < 0) ? -((uint64_t)value) : (uint64_t)value);
+
+  if (value < 0)
+    *(--p) = '-';
+  json_encoder_raw(e, p, (size_t)(end - p));
+} /* }}} void json_encoder_int64 */
+
+void json_encoder_bool(json_encoder_t *e, bool value) /* {{{ */
+{
+  if (value)
+    json_encoder_raw(e, "true", strlen("true"));
+  else
+    json_encoder_raw(e, "false", strlen("false"));
+} /* }}} void json_encoder_bool */
+
+void json_encoder_null(json_encoder_t *e) /* {{{ */
+{
+  json_encoder_raw(e, "null", strlen("null"));
+} /* }}} void json_encoder_null */
+
+void json_encoder_cdtime(json_encoder_t *e, cdtime_t t) /* {{{ */
+{
+  uint64_t ms = CDTIME_T_TO_MS(t);
+  char buffer[32];
+  char *end = buffer + sizeof(buffer);
+
+  end[-1] = (char)('0' + (ms % 10));
+  end[-2] = (char)('0' + ((ms / 10) % 10));
+  end[-3] = (char)('0' + ((ms / 100) % 10));
+  end[-4] = '.';
+  char *p = json_format_digits(end - 4, ms / 1000);
+
+  json_encoder_raw(e, p, (size_t)(end - p));
+} /* }}} void json_encoder_cdtime */
+
+void json_encoder_double(json_encoder_t *e, double value) /* {{{ */
+{
+  if (!isfinite(value)) {
+    json_encoder_null(e);
+    return;
+  }
+
+  char buffer[JSON_DOUBLE_SIZE];
+  size_t len = json_format_double(buffer, value);
+  json_encoder_raw(e, buffer, len);
+} /* }}} void json_encoder_double */
+
+/*
+ * Grisu2, as described in Florian Loitsch, "Printing Floating-Point Numbers
+ * Quickly and Accurately with Integers", PLDI 2010. The result always reads
+ * back to the same double and is the shortest such representation in all but
+ * very few cases, without the cost of printf(3)'s arbitrary precision
+ * arithmetic.
+ */
+typedef struct {
+  uint64_t f;
+  int e;
+} diy_fp_t;
+
+/* Normalized powers of ten 10^-348, 10^-340, ..., 10^340. */
+static diy_fp_t const cached_powers[] = {
+    {0xfa8fd5a0081c0288, -1220}, /* 1e-348 */
+    {0xbaaee17fa23ebf76, -1193}, /* 1e-340 */
+    {0x8b16fb203055ac76, -1166}, /* 1e-332 */
+    {0xcf42894a5dce35ea, -1140}, /* 1e-324 */
+    {0x9a6bb0aa55653b2d, -1113}, /* 1e-316 */
+    {0xe61acf033d1a45df, -1087}, /* 1e-308 */
+    {0xab70fe17c79ac6ca, -1060}, /* 1e-300 */
+    {0xff77b1fcbebcdc4f, -1034}, /* 1e-292 */
+    {0xbe5691ef416bd60c, -1007}, /* 1e-284 */
+    {0x8dd01fad907ffc3c, -980}, /* 1e-276 */
+    {0xd3515c2831559a83, -954}, /* 1e-268 */
+    {0x9d71ac8fada6c9b5, -927}, /* 1e-260 */
+    {0xea9c227723ee8bcb, -901}, /* 1e-252 */
+    {0xaecc49914078536d, -874}, /* 1e-244 */
+    {0x823c12795db6ce57, -847}, /* 1e-236 */
+    {0xc21094364dfb5637, -821}, /* 1e-228 */
+    {0x9096ea6f3848984f, -794}, /* 1e-220 */
+    {0xd77485cb25823ac7, -768}, /* 1e-212 */
+    {0xa086cfcd97bf97f4, -741}, /* 1e-204 */
+    {0xef340a98172aace5, -715}, /* 1e-196 */
+    {0xb23867fb2a35b28e, -688}, /* 1e-188 */
+    {0x84c8d4dfd2c63f3b, -661}, /* 1e-180 */
+    {0xc5dd44271ad3cdba, -635}, /* 1e-172 */
+    {0x936b9fcebb25c996, -608}, /* 1e-164 */
+    {0xdbac6c247d62a584, -582}, /* 1e-156 */
+    {0xa3ab66580d5fdaf6, -555}, /* 1e-148 */
+    {0xf3e2f893dec3f126, -529}, /* 1e-140 */
+    {0xb5b5ada8aaff80b8, -502}, /* 1e-132 */
+    {0x87625f056c7c4a8b, -475}, /* 1e-124 */
+    {0xc9bcff6034c13053, -449}, /* 1e-116 */
+    {0x964e858c91ba2655, -422}, /* 1e-108 */
+    {0xdff9772470297ebd, -396}, /* 1e-100 */
+    {0xa6dfbd9fb8e5b88f, -369}, /* 1e-92 */
+    {0xf8a95fcf88747d94, -343}, /* 1e-84 */
+    {0xb94470938fa89bcf, -316}, /* 1e-76 */
+    {0x8a08f0f8bf0f156b, -289}, /* 1e-68 */
+    {0xcdb02555653131b6, -263}, /* 1e-60 */
+    {0x993fe2c6d07b7fac, -236}, /* 1e-52 */
+    {0xe45c10c42a2b3b06, -210}, /* 1e-44 */
+    {0xaa242499697392d3, -183}, /* 1e-36 */
+    {0xfd87b5f28300ca0e, -157}, /* 1e-28 */
+    {0xbce5086492111aeb, -130}, /* 1e-20 */
+    {0x8cbccc096f5088cc, -103}, /* 1e-12 */
+    {0xd1b71758e219652c, -77}, /* 1e-4 */
+    {0x9c40000000000000, -50}, /* 1e4 */
+    {0xe8d4a51000000000, -24}, /* 1e12 */
+    {0xad78ebc5ac620000, 3}, /* 1e20 */
+    {0x813f3978f8940984, 30}, /* 1e28 */
+    {0xc097ce7bc90715b3, 56}, /* 1e36 */
+    {0x8f7e32ce7bea5c70, 83}, /* 1e44 */
+    {0xd5d238a4abe98068, 109}, /* 1e52 */
+    {0x9f4f2726179a2245, 136}, /* 1e60 */
+    {0xed63a231d4c4fb27, 162}, /* 1e68 */
+    {0xb0de65388cc8ada8, 189}, /* 1e76 */
+    {0x83c7088e1aab65db, 216}, /* 1e84 */
+    {0xc45d1df942711d9a, 242}, /* 1e92 */
+    {0x924d692ca61be758, 269}, /* 1e100 */
+    {0xda01ee641a708dea, 295}, /* 1e108 */
+    {0xa26da3999aef774a, 322}, /* 1e116 */
+    {0xf209787bb47d6b85, 348}, /* 1e124 */
+    {0xb454e4a179dd1877, 375}, /* 1e132 */
+    {0x865b86925b9bc5c2, 402}, /* 1e140 */
+    {0xc83553c5c8965d3d, 428}, /* 1e148 */
+    {0x952ab45cfa97a0b3, 455}, /* 1e156 */
+    {0xde469fbd99a05fe3, 481}, /* 1e164 */
+    {0xa59bc234db398c25, 508}, /* 1e172 */
+    {0xf6c69a72a3989f5c, 534}, /* 1e180 */
+    {0xb7dcbf5354e9bece, 561}, /* 1e188 */
+    {0x88fcf317f22241e2, 588}, /* 1e196 */
+    {0xcc20ce9bd35c78a5, 614}, /* 1e204 */
+    {0x98165af37b2153df, 641}, /* 1e212 */
+    {0xe2a0b5dc971f303a, 667}, /* 1e220 */
+    {0xa8d9d1535ce3b396, 694}, /* 1e228 */
+    {0xfb9b7cd9a4a7443c, 720}, /* 1e236 */
+    {0xbb764c4ca7a44410, 747}, /* 1e244 */
+    {0x8bab8eefb6409c1a, 774}, /* 1e252 */
+    {0xd01fef10a657842c, 800}, /* 1e260 */
+    {0x9b10a4e5e9913129, 827}, /* 1e268 */
+    {0xe7109bfba19c0c9d, 853}, /* 1e276 */
+    {0xac2820d9623bf429, 880}, /* 1e284 */
+    {0x80444b5e7aa7cf85, 907}, /* 1e292 */
+    {0xbf21e44003acdd2d, 933}, /* 1e300 */
+    {0x8e679c2f5e44ff8f, 960}, /* 1e308 */
+    {0xd433179d9c8cb841, 986}, /* 1e316 */
+    {0x9e19db92b4e31ba9, 1013}, /* 1e324 */
+    {0xeb96bf6ebadf77d9, 1039}, /* 1e332 */
+    {0xaf87023b9bf0ee6b, 1066}, /* 1e340 */
+};
+
+static uint64_t const pow10_table[] = {1ULL,
+                                       10ULL,
+                                       100ULL,
+                                       1000ULL,
+                                       10000ULL,
+                                       100000ULL,
+                                       1000000ULL,
+                                       10000000ULL,
+                                       100000000ULL,
+                                       1000000000ULL,
+                                       10000000000ULL,
+                                       100000000000ULL,
+                                       1000000000000ULL,
+                                       10000000000000ULL,
+                                       100000000000000ULL,
+                                       1000000000000000ULL,
+                                       10000000000000000ULL,
+                                       100000000000000000ULL,
+                                       1000000000000000000ULL,
+                                       10000000000000000000ULL};
+
+#define DP_SIGNIFICAND_MASK 0x000FFFFFFFFFFFFFULL
+#define DP_HIDDEN_BIT 0x0010000000000000ULL
+#define DP_EXPONENT_BIAS (0x3FF + 52)
+
+static diy_fp_t diy_fp_from_double(double d) /* {{{ */
+{
+  uint64_t bits;
+  memcpy(&bits, &d, sizeof(bits));
+
+  int biased_e = (int)((bits >> 52) & 0x7FF);
+  uint64_t significand = bits & DP_SIGNIFICAND_MASK;
+
+  if (biased_e != 0)
+    return (diy_fp_t){significand + DP_HIDDEN_BIT,
+                      biased_e - DP_EXPONENT_BIAS};
+  /* subnormal */
+  return (diy_fp_t){significand, 1 - DP_EXPONENT_BIAS};
+} /* }}} diy_fp_t diy_fp_from_double */
+
+/* Multiplies the significands, rounding the lower 64 bits of the product. */
+static diy_fp_t diy_fp_mul(diy_fp_t x, diy_fp_t y) /* {{{ */
+{
+  uint64_t const m32 = 0xFFFFFFFFULL;
+  uint64_t a = x.f >> 32;
+  uint64_t b = x.f & m32;
+  uint64_t c = y.f >> 32;
+  uint64_t d = y.f & m32;
+
+  uint64_t ac = a * c;
+  uint64_t bc = b * c;
+  uint64_t ad = a * d;
+  uint64_t bd = b * d;
+
+  uint64_t tmp = (bd >> 32) + (ad & m32) + (bc & m32);
+  tmp += 1ULL << 31;
+
+  return (diy_fp_t){ac + (ad >> 32) + (bc >> 32) + (tmp >> 32),
+                    x.e + y.e + 64};
+} /* }}} diy_fp_t diy_fp_mul */
+
+static diy_fp_t diy_fp_normalize(diy_fp_t x) /* {{{ */
+{
+  while ((x.f & (1ULL << 63)) == 0) {
+    x.f <<= 1;
+    x.e--;
+  }
+  return x;
+} /* }}} diy_fp_t diy_fp_normalize */
+
+/* Computes the boundaries m- and m+ halfway to the neighboring doubles,
+ * normalized to the same exponent. */
+static void diy_fp_boundaries(diy_fp_t v, diy_fp_t *minus, /* {{{ */
+                              diy_fp_t *plus) {
+  diy_fp_t pl = {(v.f << 1) + 1, v.e - 1};
+  while ((pl.f & (DP_HIDDEN_BIT << 1)) == 0) {
+    pl.f <<= 1;
+    pl.e--;
+  }
+  pl.f <<= 64 - 52 - 2;
+  pl.e -= 64 - 52 - 2;
+
+  /* The lower boundary is closer if v is a power of two. */
+  diy_fp_t mi = (v.f == DP_HIDDEN_BIT) ? (diy_fp_t){(v.f << 2) - 1, v.e - 2}
+                                       : (diy_fp_t){(v.f << 1) - 1, v.e - 1};
+  mi.f <<= mi.e - pl.e;
+  mi.e = pl.e;
+
+  *minus = mi;
+  *plus = pl;
+} /* }}} void diy_fp_boundaries */
+
+/* Returns a cached power of ten c_k = 10^-k such that the exponent of the
+ * product with a number of binary exponent `e' is in [-60, -32]. */
+static diy_fp_t cached_power(int e, int *k) /* {{{ */
+{
+  /* 0.30102999566398114 = log10(2) */
+  double dk = (-61 - e) * 0.30102999566398114 + 347;
+  int ik = (int)dk;
+  if (dk - ik > 0.0)
+    ik++;
+
+  unsigned int index = (unsigned int)((ik >> 3) + 1);
+  *k = -(-348 + (int)(index * 8));
+  return cached_powers[index];
+} /* }}} diy_fp_t cached_power */
+
+static void grisu_round(char *buffer, size_t len, uint64_t delta, /* {{{ */
+                        uint64_t rest, uint64_t ten_kappa, uint64_t wp_w) {
+  while ((rest < wp_w) && (delta - rest >= ten_kappa) &&
+         ((rest + ten_kappa < wp_w) ||
+          (wp_w - rest > rest + ten_kappa - wp_w))) {
+    buffer[len - 1]--;
+    rest += ten_kappa;
+  }
+} /* }}} void grisu_round */
+
+/* Generates the shortest digits of a number in [Mp - delta, Mp], as close as
+ * possible to W. */
+static size_t grisu_digits(diy_fp_t W, diy_fp_t Mp, /* {{{ */
+                           uint64_t delta, char *buffer, int *k) {
+  diy_fp_t one = {1ULL << -Mp.e, Mp.e};
+  uint64_t wp_w = Mp.f - W.f;
+  uint32_t p1 = (uint32_t)(Mp.f >> -one.e);
+  uint64_t p2 = Mp.f & (one.f - 1);
+  size_t len = 0;
+
+  int kappa = 1;
+  while ((kappa < 10) && (p1 >= pow10_table[kappa]))
+    kappa++;
+
+  while (kappa > 0) {
+    uint32_t div = (uint32_t)pow10_table[kappa - 1];
+    uint32_t d = p1 / div;
+    p1 %= div;
+    if ((d != 0) || (len != 0))
+      buffer[len++] = (char)('0' + d);
+    kappa--;
+
+    uint64_t tmp = (((uint64_t)p1) << -one.e) + p2;
+    if (tmp <= delta) {
+      *k += kappa;
+      grisu_round(buffer, len, delta, tmp, pow10_table[kappa] << -one.e, wp_w);
+      return len;
+    }
+  }
+
+  while (42) {
+    p2 *= 10;
+    delta *= 10;
+    char d = (char)(p2 >> -one.e);
+    if ((d != 0) || (len != 0))
+      buffer[len++] = (char)('0' + d);
+    p2 &= one.f - 1;
+    kappa--;
+
+    if (p2 < delta) {
+      *k += kappa;
+      int index = -kappa;
+      grisu_round(buffer, len, delta, p2, one.f,
+                  wp_w * ((index < 20) ? pow10_table[index] : 0));
+      return len;
+    }
+  }
+} /* }}} size_t grisu_digits */
+
+/* Writes the digits of a positive `value' to `buffer' and returns their
+ * number. The value is digits * 10^k. */
+static size_t grisu2(double value, char *buffer, int *k) /* {{{ */
+{
+  diy_fp_t v = diy_fp_from_double(value);
+  diy_fp_t w_m, w_p;
+  diy_fp_boundaries(v, &w_m, &w_p);
+
+  diy_fp_t c_mk = cached_power(w_p.e, k);
+  diy_fp_t W = diy_fp_mul(diy_fp_normalize(v), c_mk);
+  diy_fp_t Wp = diy_fp_mul(w_p, c_mk);
+  diy_fp_t Wm = diy_fp_mul(w_m, c_mk);
+  Wm.f++;
+  Wp.f--;
+
+  return grisu_digits(W, Wp, Wp.f - Wm.f, buffer, k);
+} /* }}} size_t grisu2 */
+
+/* Formats the digits, len of them, times 10^k. */
+static size_t json_prettify(char *buffer, size_t len, int k) /* {{{ */
+{
+  int n = (int)len;
+  int kk = n + k; /* 10^(kk-1) <= v < 10^kk */
+
+  if ((k >= 0) && (kk <= 21)) {
+    /* 1234e7 -> 12340000000 */
+    memset(buffer + n, '0', (size_t)k);
+    buffer[kk] = 0;
+    return (size_t)kk;
+  } else if ((kk > 0) && (kk <= 21)) {
+    /* 1234e-2 -> 12.34 */
+    memmove(buffer + kk + 1, buffer + kk, (size_t)(n - kk));
+    buffer[kk] = '.';
+    buffer[n + 1] = 0;
+    return len + 1;
+  } else if ((kk > -6) && (kk <= 0)) {
+    /* 1234e-6 -> 0.001234 */
+    int offset = 2 - kk;
+    memmove(buffer + offset, buffer, len);
+    buffer[0] = '0';
+    buffer[1] = '.';
+    memset(buffer + 2, '0', (size_t)(offset - 2));
+    buffer[n + offset] = 0;
+    return len + (size_t)offset;
+  }
+
+  /* 1e30, 1234e30 -> 1.234e33 */
+  size_t pos = 1;
+  if (n > 1) {
+    memmove(buffer + 2, buffer + 1, len - 1);
+    buffer[1] = '.';
+    pos = len + 1;
+  }
+  buffer[pos++] = 'e';
+
+  int exp = kk - 1;
+  if (exp < 0) {
+    buffer[pos++] = '-';
+    exp = -exp;
+  }
+  if (exp >= 100) {
+    buffer[pos++] = (char)('0' + exp / 100);
+    exp %= 100;
+    buffer[pos++] = (char)('0' + exp / 10);
+  } else if (exp >= 10) {
+    buffer[pos++] = (char)('0' + exp / 10);
+  }
+  buffer[pos++] = (char)('0' + exp % 10);
+  buffer[pos] = 0;
+  return pos;
+} /* }}} size_t json_prettify */
+
+size_t json_format_double(char *buffer, double value) /* {{{ */
+{
+  char *p = buffer;
+
+  if (signbit(value)) {
+    *(p++) = '-';
+    value = -value;
+  }
+
+  if (value == 0.0) {
+    *(p++) = '0';
+    *p = 0;
+    return (size_t)(p - buffer);
+  }
+
+  int k = 0;
+  size_t len = grisu2(value, p, &k);
+  return (size_t)(p - buffer) + json_prettify(p, len, k);
+} /* }}} size_t json_format_double */
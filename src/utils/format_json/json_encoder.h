@@ -0,0 +1,160 @@
+/**
+ * collectd - src/utils/format_json/json_encoder.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_JSON_ENCODER_H
+#define UTILS_JSON_ENCODER_H 1
+
+#include "collectd.h"
+
+/*
+ * Streaming JSON encoder. Values are appended to a buffer as they are added;
+ * commas between array elements and object members are inserted
+ * automatically. The buffer is either grown on the heap as needed or provided
+ * by the caller with a fixed size.
+ *
+ * Errors are sticky: once adding a value failed, for example because a fixed
+ * buffer is full, all further calls are ignored and json_encoder_status()
+ * returns the error. Callers therefore only need to check the status once,
+ * after the last value has been added. The output is always null-terminated.
+ *
+ * The encoder does not validate the structure; e.g. adding a key outside of an
+ * object produces invalid JSON.
+ */
+
+/* Maximum nesting depth of arrays and objects. */
+#define JSON_ENCODER_MAX_DEPTH 32
+
+/* Buffer size sufficient for json_format_double(). */
+#define JSON_DOUBLE_SIZE 32
+
+typedef struct {
+  char *buffer;
+  size_t size;
+  size_t len;
+  bool fixed;
+  int status;
+
+  /* Bit n is set if level n of the nesting already has an element. */
+  uint32_t have_element;
+  unsigned int depth;
+  bool after_key;
+} json_encoder_t;
+
+/* Initializes an encoder that allocates and grows its buffer as needed. The
+ * buffer must be freed with json_encoder_destroy(). */
+void json_encoder_init(json_encoder_t *e);
+
+/* Initializes an encoder writing to `buffer'. Adding values fails with ENOMEM
+ * if they do not fit into `size' bytes, including the terminating null
+ * byte. */
+void json_encoder_init_fixed(json_encoder_t *e, char *buffer, size_t size);
+
+/* Clears the output and the error, keeping the allocated buffer. */
+void json_encoder_reset(json_encoder_t *e);
+
+/* Frees the buffer of an encoder created with json_encoder_init(). */
+void json_encoder_destroy(json_encoder_t *e);
+
+/* Returns zero or the first error that occurred. */
+static inline int json_encoder_status(json_encoder_t const *e) {
+  return e->status;
+}
+
+/* Returns the null-terminated output. */
+static inline char const *json_encoder_buffer(json_encoder_t const *e) {
+  return (e->buffer != NULL) ? e->buffer : "";
+}
+
+/* Returns the length of the output, excluding the terminating null byte. */
+static inline size_t json_encoder_len(json_encoder_t const *e) {
+  return e->len;
+}
+
+void json_encoder_object_open(json_encoder_t *e);
+void json_encoder_object_close(json_encoder_t *e);
+void json_encoder_array_open(json_encoder_t *e);
+void json_encoder_array_close(json_encoder_t *e);
+
+/* Adds the key of an object member. The next value added is its value. */
+void json_encoder_key(json_encoder_t *e, char const *key);
+
+/* Adds a string, escaping it as needed. NULL is encoded as null. */
+void json_encoder_string(json_encoder_t *e, char const *str);
+
+/* Adds a number in a short form that reads back to the same double, see
+ * json_format_double(). NaN and infinity, which JSON can not represent, are
+ * encoded as null. */
+void json_encoder_double(json_encoder_t *e, double value);
+
+void json_encoder_int64(json_encoder_t *e, int64_t value);
+void json_encoder_uint64(json_encoder_t *e, uint64_t value);
+void json_encoder_bool(json_encoder_t *e, bool value);
+void json_encoder_null(json_encoder_t *e);
+
+/* Adds a time as seconds since the epoch with millisecond precision. */
+void json_encoder_cdtime(json_encoder_t *e, cdtime_t t);
+
+/*
+ * NAME
+ *   json_encoder_raw
+ *
+ * DESCRIPTION
+ *   Adds `json_len' bytes of already encoded JSON, such as fragments that are
+ *   encoded once and used many times. `json' is either a complete value or,
+ *   when used in place of a key, one or more complete object members. A comma
+ *   is inserted before it if needed.
+ */
+void json_encoder_raw(json_encoder_t *e, char const *json, size_t json_len);
+
+/*
+ * NAME
+ *   json_escape
+ *
+ * DESCRIPTION
+ *   Writes `str' as a quoted JSON string to `buffer', like
+ *   json_encoder_string() does. Used to encode fragments for
+ *   json_encoder_raw().
+ *
+ * RETURN VALUE
+ *   Zero on success, ENOMEM if `buffer' is too small.
+ */
+int json_escape(char *buffer, size_t buffer_size, char const *str);
+
+/*
+ * NAME
+ *   json_format_double
+ *
+ * DESCRIPTION
+ *   Formats a finite `value' so that it reads back to the same double, using
+ *   the Grisu2 algorithm. The result has the fewest possible digits for
+ *   about 99.9% of all values; the others get up to three digits more than
+ *   necessary, but never more than 17 in total. Integral values up to 1e21 are
+ *   written without a decimal point, very small and very large values in
+ *   exponential notation. `buffer' must hold at least JSON_DOUBLE_SIZE bytes.
+ *
+ * RETURN VALUE
+ *   The number of characters written, excluding the terminating null byte.
+ */
+size_t json_format_double(char *buffer, double value);
+
+#endif /* UTILS_JSON_ENCODER_H */
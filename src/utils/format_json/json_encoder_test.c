@@ -0,0 +1,285 @@
+/**
+ * collectd - src/utils/format_json/json_encoder_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/common/common.h" /* for STATIC_ARRAY_SIZE */
+#include "utils/format_json/format_json.h"
+#include "utils/format_json/json_encoder.h"
+
+static data_set_t ds_double = {
+    .type = "double",
+    .ds_num = 2,
+    .ds =
+        (data_source_t[]){
+            {"one", DS_TYPE_GAUGE, NAN, NAN},
+            {"two", DS_TYPE_DERIVE, 0, NAN},
+        },
+};
+
+static void init_value_list(value_list_t *vl, value_t *values) {
+  values[0].gauge = 42.5;
+  values[1].derive = -7;
+  *vl = (value_list_t){
+      .values = values,
+      .values_len = 2,
+      .time = TIME_T_TO_CDTIME_T(1480063672),
+      .interval = MS_TO_CDTIME_T(10500),
+      .host = "example.com",
+      .plugin = "test",
+      .type = "double",
+      .type_instance = "a\"b",
+  };
+}
+
+#define VALUE_LIST_JSON                                                        \
+  "{\"values\":[42.5,-7],\"dstypes\":[\"gauge\",\"derive\"],"                  \
+  "\"dsnames\":[\"one\",\"two\"],\"time\":1480063672.000,"                     \
+  "\"interval\":10.500,\"host\":\"example.com\",\"plugin\":\"test\","          \
+  "\"plugin_instance\":\"\",\"type\":\"double\",\"type_instance\":\"a\\\"b\"}"
+
+DEF_TEST(format_double) {
+  struct {
+    double value;
+    char const *want;
+  } cases[] = {
+      {0.0, "0"},
+      {-0.0, "-0"},
+      {1.0, "1"},
+      {-42.0, "-42"},
+      {0.1, "0.1"},
+      {0.3, "0.3"},
+      {1.5, "1.5"},
+      {123.456, "123.456"},
+      {0.001, "0.001"},
+      {1e-6, "0.000001"},
+      {1e-7, "1e-7"},
+      {1.5e-10, "1.5e-10"},
+      {1e20, "100000000000000000000"},
+      {1e21, "1e21"},
+      {1.7976931348623157e308, "1.7976931348623157e308"},
+      {5e-324, "5e-324"},
+      {2.2250738585072014e-308, "2.2250738585072014e-308"},
+      {18446744073709551616.0, "18446744073709552000"},
+      {1.0 / 3.0, "0.3333333333333333"},
+  };
+
+  for (size_t i = 0; i < STATIC_ARRAY_SIZE(cases); i++) {
+    char buffer[JSON_DOUBLE_SIZE];
+    size_t len = json_format_double(buffer, cases[i].value);
+    EXPECT_EQ_STR(cases[i].want, buffer);
+    EXPECT_EQ_INT((int)strlen(cases[i].want), (int)len);
+  }
+
+  /* Every double reads back to the same value. */
+  uint64_t state = 0x853c49e6748fea9bULL;
+  for (int i = 0; i < 100000; i++) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    double value;
+    memcpy(&value, &state, sizeof(value));
+    if (!isfinite(value))
+      continue;
+
+    char buffer[JSON_DOUBLE_SIZE];
+    json_format_double(buffer, value);
+    if (strtod(buffer, NULL) != value) {
+      printf("not ok - %s does not read back as %.17g\n", buffer, value);
+      return -1;
+    }
+  }
+  OK(1);
+
+  return 0;
+}
+
+DEF_TEST(structure) {
+  json_encoder_t e;
+  json_encoder_init(&e);
+
+  json_encoder_object_open(&e);
+  json_encoder_key(&e, "a");
+  json_encoder_array_open(&e);
+  json_encoder_int64(&e, -1);
+  json_encoder_uint64(&e, UINT64_MAX);
+  json_encoder_bool(&e, true);
+  json_encoder_null(&e);
+  json_encoder_double(&e, NAN);
+  json_encoder_double(&e, 0.25);
+  json_encoder_array_open(&e);
+  json_encoder_array_close(&e);
+  json_encoder_object_open(&e);
+  json_encoder_object_close(&e);
+  json_encoder_array_close(&e);
+  json_encoder_key(&e, "b\n");
+  json_encoder_string(&e, "\"\\/\b\f\n\r\t\x01\x1f\xc3\xa4");
+  json_encoder_raw(&e, "\"c\":1", strlen("\"c\":1"));
+  json_encoder_key(&e, "d");
+  json_encoder_string(&e, NULL);
+  json_encoder_object_close(&e);
+
+  EXPECT_EQ_INT(0, json_encoder_status(&e));
+  EXPECT_EQ_STR("{\"a\":[-1,18446744073709551615,true,null,null,0.25,[],{}],"
+                "\"b\\n\":\"\\\"\\\\/\\b\\f\\n\\r\\t\\u0001\\u001f\xc3\xa4\","
+                "\"c\":1,\"d\":null}",
+                json_encoder_buffer(&e));
+  EXPECT_EQ_INT((int)strlen(json_encoder_buffer(&e)),
+                (int)json_encoder_len(&e));
+
+  /* Resetting keeps the buffer but starts a new document. */
+  json_encoder_reset(&e);
+  EXPECT_EQ_STR("", json_encoder_buffer(&e));
+  json_encoder_array_open(&e);
+  json_encoder_cdtime(&e, MS_TO_CDTIME_T(1500));
+  json_encoder_cdtime(&e, 0);
+  json_encoder_array_close(&e);
+  EXPECT_EQ_STR("[1.500,0.000]", json_encoder_buffer(&e));
+
+  /* Growing the buffer keeps the content. */
+  json_encoder_reset(&e);
+  json_encoder_array_open(&e);
+  for (int i = 0; i < 1000; i++)
+    json_encoder_string(&e, "0123456789");
+  json_encoder_array_close(&e);
+  EXPECT_EQ_INT(0, json_encoder_status(&e));
+  EXPECT_EQ_INT(2 + 1000 * 12 + 999, (int)json_encoder_len(&e));
+
+  json_encoder_destroy(&e);
+
+  char buffer[32];
+  EXPECT_EQ_INT(0, json_escape(buffer, sizeof(buffer), "x\ty"));
+  EXPECT_EQ_STR("\"x\\ty\"", buffer);
+  EXPECT_EQ_INT(ENOMEM, json_escape(buffer, 6, "x\ty"));
+
+  return 0;
+}
+
+DEF_TEST(fixed_buffer) {
+  char buffer[16];
+  json_encoder_t e;
+  json_encoder_init_fixed(&e, buffer, sizeof(buffer));
+
+  json_encoder_array_open(&e);
+  json_encoder_string(&e, "0123456789");
+  json_encoder_array_close(&e);
+  EXPECT_EQ_INT(0, json_encoder_status(&e));
+  EXPECT_EQ_STR("[\"0123456789\"]", buffer);
+
+  /* Errors are sticky. */
+  json_encoder_reset(&e);
+  json_encoder_array_open(&e);
+  json_encoder_string(&e, "0123456789abcdef");
+  json_encoder_int64(&e, 1);
+  json_encoder_array_close(&e);
+  EXPECT_EQ_INT(ENOMEM, json_encoder_status(&e));
+  EXPECT_EQ_INT((int)strlen(buffer), (int)json_encoder_len(&e));
+
+  return 0;
+}
+
+DEF_TEST(value_list) {
+  value_t values[2];
+  value_list_t vl;
+  init_value_list(&vl, values);
+
+  char buffer[1024];
+  size_t fill = 0;
+  size_t free = sizeof(buffer);
+  CHECK_ZERO(format_json_initialize(buffer, &fill, &free));
+  CHECK_ZERO(format_json_value_list(buffer, &fill, &free, &ds_double, &vl, 0));
+  CHECK_ZERO(format_json_value_list(buffer, &fill, &free, &ds_double, &vl, 0));
+  CHECK_ZERO(format_json_finalize(buffer, &fill, &free));
+  EXPECT_EQ_STR("[" VALUE_LIST_JSON "," VALUE_LIST_JSON "]", buffer);
+  EXPECT_EQ_INT((int)strlen(buffer), (int)fill);
+  EXPECT_EQ_INT(sizeof(buffer), fill + free);
+
+  /* Rates are not available from the mock cache. */
+  EXPECT_EQ_INT(-1, format_json_value_list(buffer, &fill, &free, &ds_double,
+                                           &vl, 1));
+
+  /* A value list that does not fit leaves the buffer as it was. */
+  fill = 0;
+  free = sizeof(VALUE_LIST_JSON) + 4;
+  CHECK_ZERO(format_json_initialize(buffer, &fill, &free));
+  CHECK_ZERO(format_json_value_list(buffer, &fill, &free, &ds_double, &vl, 0));
+  EXPECT_EQ_INT(-ENOMEM, format_json_value_list(buffer, &fill, &free,
+                                                &ds_double, &vl, 0));
+  CHECK_ZERO(format_json_finalize(buffer, &fill, &free));
+  EXPECT_EQ_STR("[" VALUE_LIST_JSON "]", buffer);
+
+  /* Meta data is added as an object. */
+  vl.meta = meta_data_create();
+  CHECK_NOT_NULL(vl.meta);
+  meta_data_add_string(vl.meta, "s", "x");
+  meta_data_add_double(vl.meta, "d", INFINITY);
+
+  json_encoder_t e;
+  json_encoder_init(&e);
+  CHECK_ZERO(format_json_encode_value_list(&e, &ds_double, &vl, 0));
+  OK(strstr(json_encoder_buffer(&e), ",\"meta\":{") != NULL);
+  OK(strstr(json_encoder_buffer(&e), "\"s\":\"x\"") != NULL);
+  OK(strstr(json_encoder_buffer(&e), "\"d\":null") != NULL);
+  json_encoder_destroy(&e);
+  meta_data_destroy(vl.meta);
+
+  return 0;
+}
+
+DEF_TEST(value_lists) {
+  value_t values[2];
+  value_list_t vl;
+  init_value_list(&vl, values);
+
+  data_set_t const *ds[] = {&ds_double, &ds_double, &ds_double};
+  value_list_t const *vls[] = {&vl, &vl, &vl};
+
+  json_encoder_t e;
+  json_encoder_init(&e);
+
+  CHECK_ZERO(format_json_value_lists(&e, ds, vls, 0, 0));
+  EXPECT_EQ_STR("[]", json_encoder_buffer(&e));
+
+  json_encoder_reset(&e);
+  CHECK_ZERO(format_json_value_lists(&e, ds, vls, 3, 0));
+  EXPECT_EQ_STR("[" VALUE_LIST_JSON "," VALUE_LIST_JSON "," VALUE_LIST_JSON
+                "]",
+                json_encoder_buffer(&e));
+
+  /* Value lists without rates are left out. */
+  json_encoder_reset(&e);
+  CHECK_ZERO(format_json_value_lists(&e, ds, vls, 3, 1));
+  EXPECT_EQ_STR("[]", json_encoder_buffer(&e));
+
+  json_encoder_destroy(&e);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(format_double);
+  RUN_TEST(structure);
+  RUN_TEST(fixed_buffer);
+  RUN_TEST(value_list);
+  RUN_TEST(value_lists);
+
+  END_TEST;
+}
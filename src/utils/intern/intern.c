@@ -0,0 +1,406 @@
+/**
+ * collectd - src/utils/intern/intern.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/* Strings are found by their hash in one of several shards, each of which is
+ * an open addressing hash table protected by a read/write lock. The strings
+ * themselves are stored in an array of chunks indexed by ID. Chunks are
+ * never moved or freed, so resolving an ID only needs two atomic loads.
+ *
+ * Every entry counts its references. A reference is only added while the
+ * shard is locked, or by a caller already holding one, so the count can only
+ * drop to zero for good. The thread dropping it removes the entry under the
+ * shard's write lock, unless the string has been looked up again meanwhile,
+ * and puts the ID on a free list for reuse. */
+
+#include "collectd.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils/intern/intern.h"
+
+#ifndef INTERN_SHARDS_NUM
+#define INTERN_SHARDS_NUM 16
+#endif
+#define INTERN_SHARD_MIN_SLOTS 64
+
+#define INTERN_CHUNK_SIZE 4096
+#define INTERN_CHUNKS_NUM 4096
+#define INTERN_ID_MAX ((size_t)INTERN_CHUNK_SIZE * INTERN_CHUNKS_NUM)
+
+typedef struct {
+  uint64_t hash;
+  uint32_t id; /* zero if the slot is empty */
+} intern_slot_t;
+
+typedef struct {
+  pthread_rwlock_t lock;
+  intern_slot_t *slots;
+  size_t slots_num; /* zero or a power of two */
+  size_t entries_num;
+} intern_shard_t;
+
+typedef struct {
+  char const *str; /* NULL if the ID is not in use */
+  uint64_t hash;
+  uint32_t refs;
+  uint32_t next_free; /* next ID on the free list if `str' is NULL */
+} intern_entry_t;
+
+static intern_shard_t intern_shards[INTERN_SHARDS_NUM];
+static pthread_once_t intern_shards_once = PTHREAD_ONCE_INIT;
+
+static intern_entry_t *intern_chunks[INTERN_CHUNKS_NUM];
+/* ID zero is reserved for the empty string. */
+static size_t intern_next_id = 1;
+static size_t intern_num = 1;
+
+/* IDs of released strings, linked through `next_free'. Zero if empty. */
+static uint32_t intern_free_head;
+static pthread_mutex_t intern_free_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void intern_shards_init(void) {
+  for (size_t i = 0; i < INTERN_SHARDS_NUM; i++)
+    pthread_rwlock_init(&intern_shards[i].lock, /* attr = */ NULL);
+} /* void intern_shards_init */
+
+/* 64 bit FNV-1a */
+static uint64_t intern_hash(char const *str) {
+  uint64_t hash = 14695981039346656037ULL;
+
+  for (unsigned char const *c = (unsigned char const *)str; *c != 0; c++) {
+    hash ^= (uint64_t)*c;
+    hash *= 1099511628211ULL;
+  }
+
+  return hash;
+} /* uint64_t intern_hash */
+
+static intern_shard_t *intern_shard(uint64_t hash) {
+  return &intern_shards[(hash >> 32) % INTERN_SHARDS_NUM];
+} /* intern_shard_t *intern_shard */
+
+static intern_entry_t *intern_entry(uint32_t id) {
+  if ((id == 0) || ((size_t)id >= INTERN_ID_MAX))
+    return NULL;
+
+  intern_entry_t *chunk = __atomic_load_n(
+      &intern_chunks[id / INTERN_CHUNK_SIZE], __ATOMIC_ACQUIRE);
+  if (chunk == NULL)
+    return NULL;
+
+  return &chunk[id % INTERN_CHUNK_SIZE];
+} /* intern_entry_t *intern_entry */
+
+char const *c_intern_string(uint32_t id) {
+  if (id == 0)
+    return "";
+
+  intern_entry_t *entry = intern_entry(id);
+  if (entry == NULL)
+    return NULL;
+
+  return __atomic_load_n(&entry->str, __ATOMIC_ACQUIRE);
+} /* char const *c_intern_string */
+
+/* Returns the index of the slot holding `str' or, if `str' is not in the
+ * shard, the index of the empty slot where it would be inserted. The shard
+ * must be locked and have at least one slot. */
+static size_t intern_shard_find(intern_shard_t *shard, uint64_t hash,
+                                char const *str) {
+  size_t mask = shard->slots_num - 1;
+  size_t idx = (size_t)hash & mask;
+
+  while (shard->slots[idx].id != 0) {
+    if ((shard->slots[idx].hash == hash) &&
+        (strcmp(c_intern_string(shard->slots[idx].id), str) == 0))
+      break;
+    idx = (idx + 1) & mask;
+  }
+
+  return idx;
+} /* size_t intern_shard_find */
+
+/* Returns the ID of `str' and adds a reference to it, or returns zero if
+ * `str' is not in the shard. The shard must be locked. */
+static uint32_t intern_shard_get(intern_shard_t *shard, uint64_t hash,
+                                 char const *str) {
+  if (shard->entries_num == 0)
+    return 0;
+
+  uint32_t id = shard->slots[intern_shard_find(shard, hash, str)].id;
+  if (id != 0)
+    __atomic_add_fetch(&intern_entry(id)->refs, 1, __ATOMIC_RELAXED);
+
+  return id;
+} /* uint32_t intern_shard_get */
+
+static int intern_shard_grow(intern_shard_t *shard) {
+  size_t slots_num = 2 * shard->slots_num;
+  if (slots_num < INTERN_SHARD_MIN_SLOTS)
+    slots_num = INTERN_SHARD_MIN_SLOTS;
+
+  intern_slot_t *slots = calloc(slots_num, sizeof(*slots));
+  if (slots == NULL)
+    return ENOMEM;
+
+  for (size_t i = 0; i < shard->slots_num; i++) {
+    if (shard->slots[i].id == 0)
+      continue;
+
+    size_t idx = (size_t)shard->slots[i].hash & (slots_num - 1);
+    while (slots[idx].id != 0)
+      idx = (idx + 1) & (slots_num - 1);
+    slots[idx] = shard->slots[i];
+  }
+
+  free(shard->slots);
+  shard->slots = slots;
+  shard->slots_num = slots_num;
+  return 0;
+} /* int intern_shard_grow */
+
+/* Empties the slot at `idx', moving following entries of the same probe
+ * sequence back, so that lookups do not stop early. The shard must be
+ * locked for writing. */
+static void intern_shard_remove(intern_shard_t *shard, size_t idx) {
+  size_t mask = shard->slots_num - 1;
+  size_t hole = idx;
+
+  for (size_t i = (idx + 1) & mask; shard->slots[i].id != 0;
+       i = (i + 1) & mask) {
+    /* The entry may fill the hole if the hole is not before its home slot. */
+    size_t home = (size_t)shard->slots[i].hash & mask;
+    if (((i - home) & mask) >= ((i - hole) & mask)) {
+      shard->slots[hole] = shard->slots[i];
+      hole = i;
+    }
+  }
+
+  shard->slots[hole] = (intern_slot_t){0};
+  shard->entries_num--;
+} /* void intern_shard_remove */
+
+static void intern_free_push(uint32_t id) {
+  pthread_mutex_lock(&intern_free_lock);
+  intern_entry(id)->next_free = intern_free_head;
+  intern_free_head = id;
+  pthread_mutex_unlock(&intern_free_lock);
+} /* void intern_free_push */
+
+/* Returns a released ID or allocates a new one. */
+static int intern_alloc_id(uint32_t *ret_id) {
+  pthread_mutex_lock(&intern_free_lock);
+  uint32_t id = intern_free_head;
+  if (id != 0)
+    intern_free_head = intern_entry(id)->next_free;
+  pthread_mutex_unlock(&intern_free_lock);
+
+  if (id != 0) {
+    *ret_id = id;
+    return 0;
+  }
+
+  size_t next = __atomic_fetch_add(&intern_next_id, 1, __ATOMIC_RELAXED);
+  if (next >= INTERN_ID_MAX)
+    return ENOSPC;
+
+  intern_entry_t **chunk_ptr = &intern_chunks[next / INTERN_CHUNK_SIZE];
+  intern_entry_t *chunk = __atomic_load_n(chunk_ptr, __ATOMIC_ACQUIRE);
+  if (chunk == NULL) {
+    intern_entry_t *new_chunk = calloc(INTERN_CHUNK_SIZE, sizeof(*new_chunk));
+    if (new_chunk == NULL)
+      return ENOMEM;
+
+    /* Another thread may have allocated the chunk meanwhile. */
+    if (!__atomic_compare_exchange_n(chunk_ptr, &chunk, new_chunk,
+                                     /* weak = */ false, __ATOMIC_ACQ_REL,
+                                     __ATOMIC_ACQUIRE))
+      free(new_chunk);
+  }
+
+  *ret_id = (uint32_t)next;
+  return 0;
+} /* int intern_alloc_id */
+
+/* Stores a copy of `str' under a new ID with one reference. */
+static int intern_store(char const *str, uint64_t hash, uint32_t *ret_id) {
+  uint32_t id;
+  int status = intern_alloc_id(&id);
+  if (status != 0)
+    return status;
+
+  char *copy = strdup(str);
+  if (copy == NULL) {
+    intern_free_push(id);
+    return ENOMEM;
+  }
+
+  intern_entry_t *entry = intern_entry(id);
+  entry->hash = hash;
+  __atomic_store_n(&entry->refs, 1, __ATOMIC_RELAXED);
+  __atomic_store_n(&entry->str, copy, __ATOMIC_RELEASE);
+  __atomic_add_fetch(&intern_num, 1, __ATOMIC_RELAXED);
+
+  *ret_id = id;
+  return 0;
+} /* int intern_store */
+
+int c_intern_lookup(char const *str, uint32_t *ret_id) {
+  if ((str == NULL) || (ret_id == NULL))
+    return EINVAL;
+
+  if (str[0] == 0) {
+    *ret_id = 0;
+    return 0;
+  }
+
+  pthread_once(&intern_shards_once, intern_shards_init);
+
+  uint64_t hash = intern_hash(str);
+  intern_shard_t *shard = intern_shard(hash);
+
+  uint32_t id = 0;
+  pthread_rwlock_rdlock(&shard->lock);
+  if (shard->entries_num > 0)
+    id = shard->slots[intern_shard_find(shard, hash, str)].id;
+  pthread_rwlock_unlock(&shard->lock);
+
+  if (id == 0)
+    return ENOENT;
+
+  *ret_id = id;
+  return 0;
+} /* int c_intern_lookup */
+
+int c_intern(char const *str, uint32_t *ret_id) {
+  if ((str == NULL) || (ret_id == NULL))
+    return EINVAL;
+
+  if (str[0] == 0) {
+    *ret_id = 0;
+    return 0;
+  }
+
+  pthread_once(&intern_shards_once, intern_shards_init);
+
+  uint64_t hash = intern_hash(str);
+  intern_shard_t *shard = intern_shard(hash);
+
+  pthread_rwlock_rdlock(&shard->lock);
+  uint32_t id = intern_shard_get(shard, hash, str);
+  pthread_rwlock_unlock(&shard->lock);
+
+  if (id != 0) {
+    *ret_id = id;
+    return 0;
+  }
+
+  pthread_rwlock_wrlock(&shard->lock);
+
+  /* Check again: another thread may have added the string meanwhile. */
+  id = intern_shard_get(shard, hash, str);
+  if (id != 0) {
+    pthread_rwlock_unlock(&shard->lock);
+    *ret_id = id;
+    return 0;
+  }
+
+  /* Keep the load factor at or below 3/4. */
+  if (4 * (shard->entries_num + 1) > 3 * shard->slots_num) {
+    int status = intern_shard_grow(shard);
+    if (status != 0) {
+      pthread_rwlock_unlock(&shard->lock);
+      return status;
+    }
+  }
+
+  int status = intern_store(str, hash, &id);
+  if (status != 0) {
+    pthread_rwlock_unlock(&shard->lock);
+    return status;
+  }
+
+  size_t idx = intern_shard_find(shard, hash, str);
+  shard->slots[idx] = (intern_slot_t){
+      .hash = hash,
+      .id = id,
+  };
+  shard->entries_num++;
+
+  pthread_rwlock_unlock(&shard->lock);
+
+  *ret_id = id;
+  return 0;
+} /* int c_intern */
+
+void c_intern_ref(uint32_t id) {
+  intern_entry_t *entry = intern_entry(id);
+  if (entry != NULL)
+    __atomic_add_fetch(&entry->refs, 1, __ATOMIC_RELAXED);
+} /* void c_intern_ref */
+
+void c_intern_release(uint32_t id) {
+  intern_entry_t *entry = intern_entry(id);
+  if (entry == NULL)
+    return;
+
+  /* The entry can not be reused before the reference is dropped. */
+  uint64_t hash = entry->hash;
+  if (__atomic_sub_fetch(&entry->refs, 1, __ATOMIC_ACQ_REL) != 0)
+    return;
+
+  intern_shard_t *shard = intern_shard(hash);
+  pthread_rwlock_wrlock(&shard->lock);
+
+  /* The string may have been looked up again, or already been removed by
+   * another thread which dropped the count to zero before. */
+  if (__atomic_load_n(&entry->refs, __ATOMIC_ACQUIRE) != 0) {
+    pthread_rwlock_unlock(&shard->lock);
+    return;
+  }
+
+  size_t mask = shard->slots_num - 1;
+  for (size_t idx = (size_t)hash & mask;
+       (shard->slots_num > 0) && (shard->slots[idx].id != 0);
+       idx = (idx + 1) & mask) {
+    if (shard->slots[idx].id != id)
+      continue;
+
+    intern_shard_remove(shard, idx);
+    char *str = (char *)entry->str;
+    __atomic_store_n(&entry->str, NULL, __ATOMIC_RELEASE);
+    free(str);
+    __atomic_sub_fetch(&intern_num, 1, __ATOMIC_RELAXED);
+    intern_free_push(id);
+    break;
+  }
+
+  pthread_rwlock_unlock(&shard->lock);
+} /* void c_intern_release */
+
+size_t c_intern_size(void) {
+  return __atomic_load_n(&intern_num, __ATOMIC_RELAXED);
+} /* size_t c_intern_size */
@@ -0,0 +1,113 @@
+/**
+ * collectd - src/utils/intern/intern.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_INTERN_H
+#define UTILS_INTERN_H 1
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Process wide table of interned strings. Every distinct string is stored
+ * once and identified by a 32 bit ID, so that equal strings have equal IDs.
+ * The ID zero always refers to the empty string. Strings are reference
+ * counted: every successful `c_intern' must be balanced by a call to
+ * `c_intern_release', after which the string is freed and its ID may be
+ * handed out again once no references are left. All functions are thread
+ * safe; looking up the string of an ID does not take a lock.
+ */
+
+/*
+ * NAME
+ *   c_intern
+ *
+ * DESCRIPTION
+ *   Returns the ID of `str' in `ret_id', adding `str' to the table if it is
+ *   not yet known, and acquires a reference to it.
+ *
+ * RETURN VALUE
+ *   Zero upon success, ENOMEM if memory allocation failed, ENOSPC if the
+ *   table is full and EINVAL if an argument is invalid.
+ */
+int c_intern(char const *str, uint32_t *ret_id);
+
+/*
+ * NAME
+ *   c_intern_lookup
+ *
+ * DESCRIPTION
+ *   Like `c_intern', but never adds `str' to the table and does not acquire
+ *   a reference. The ID may be reused as soon as the last reference to the
+ *   string is released.
+ *
+ * RETURN VALUE
+ *   Zero upon success, ENOENT if `str' has not been interned and EINVAL if
+ *   an argument is invalid.
+ */
+int c_intern_lookup(char const *str, uint32_t *ret_id);
+
+/*
+ * NAME
+ *   c_intern_string
+ *
+ * DESCRIPTION
+ *   Returns the string identified by `id'. The returned pointer stays valid
+ *   as long as the caller holds a reference to `id'.
+ *
+ * RETURN VALUE
+ *   The interned string or NULL if `id' is not in use.
+ */
+char const *c_intern_string(uint32_t id);
+
+/*
+ * NAME
+ *   c_intern_ref
+ *
+ * DESCRIPTION
+ *   Acquires another reference to `id'. The caller must already hold one,
+ *   for example to hand a copy of the ID to another owner.
+ */
+void c_intern_ref(uint32_t id);
+
+/*
+ * NAME
+ *   c_intern_release
+ *
+ * DESCRIPTION
+ *   Releases a reference acquired by `c_intern' or `c_intern_ref'. The
+ *   string is freed when its last reference is released. Releasing the ID
+ *   zero has no effect.
+ */
+void c_intern_release(uint32_t id);
+
+/*
+ * NAME
+ *   c_intern_size
+ *
+ * DESCRIPTION
+ *   Returns the number of strings in the table, including the empty string.
+ *   Released strings are not counted.
+ */
+size_t c_intern_size(void);
+
+#endif /* UTILS_INTERN_H */
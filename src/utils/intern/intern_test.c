@@ -0,0 +1,214 @@
+/**
+ * collectd - src/utils/intern/intern_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/intern/intern.h"
+
+#include <pthread.h>
+
+#define THREADS_NUM 4
+#define STRINGS_NUM 20000
+#define PROBE_NUM 512
+
+DEF_TEST(simple) {
+  uint32_t id = 42;
+  uint32_t id2 = 0;
+
+  CHECK_ZERO(c_intern("", &id));
+  EXPECT_EQ_INT(0, id);
+  EXPECT_EQ_STR("", c_intern_string(0));
+
+  EXPECT_EQ_INT(ENOENT, c_intern_lookup("foo", &id));
+  CHECK_ZERO(c_intern("foo", &id));
+  OK(id != 0);
+  EXPECT_EQ_STR("foo", c_intern_string(id));
+
+  CHECK_ZERO(c_intern("foo", &id2));
+  EXPECT_EQ_INT(id, id2);
+  CHECK_ZERO(c_intern_lookup("foo", &id2));
+  EXPECT_EQ_INT(id, id2);
+
+  CHECK_ZERO(c_intern("bar", &id2));
+  OK(id != id2);
+  EXPECT_EQ_STR("bar", c_intern_string(id2));
+
+  EXPECT_EQ_UINT64(3, c_intern_size());
+  OK(c_intern_string(12345) == NULL);
+  EXPECT_EQ_INT(EINVAL, c_intern(NULL, &id));
+
+  return 0;
+}
+
+DEF_TEST(release) {
+  uint32_t id = 0;
+  uint32_t id2 = 0;
+  size_t size = c_intern_size();
+
+  CHECK_ZERO(c_intern("release-me", &id));
+  CHECK_ZERO(c_intern("release-me", &id2));
+  EXPECT_EQ_INT(id, id2);
+  c_intern_ref(id);
+  EXPECT_EQ_UINT64(size + 1, c_intern_size());
+
+  /* Three references: the string stays until the last one is released. */
+  c_intern_release(id);
+  c_intern_release(id);
+  EXPECT_EQ_STR("release-me", c_intern_string(id));
+  CHECK_ZERO(c_intern_lookup("release-me", &id2));
+  EXPECT_EQ_INT(id, id2);
+
+  c_intern_release(id);
+  EXPECT_EQ_UINT64(size, c_intern_size());
+  EXPECT_EQ_INT(ENOENT, c_intern_lookup("release-me", &id2));
+  OK(c_intern_string(id) == NULL);
+
+  /* The ID is handed out again. */
+  CHECK_ZERO(c_intern("reuse-me", &id2));
+  EXPECT_EQ_INT(id, id2);
+  EXPECT_EQ_STR("reuse-me", c_intern_string(id2));
+  c_intern_release(id2);
+
+  /* Strings sharing a probe sequence are still found after a removal. */
+  uint32_t ids[PROBE_NUM];
+  for (size_t i = 0; i < PROBE_NUM; i++) {
+    char str[32];
+    snprintf(str, sizeof(str), "probe-%zu", i);
+    CHECK_ZERO(c_intern(str, &ids[i]));
+  }
+  for (size_t i = 0; i < PROBE_NUM; i += 2)
+    c_intern_release(ids[i]);
+  for (size_t i = 1; i < PROBE_NUM; i += 2) {
+    char str[32];
+    snprintf(str, sizeof(str), "probe-%zu", i);
+    CHECK_ZERO(c_intern_lookup(str, &id));
+    EXPECT_EQ_INT(ids[i], id);
+    c_intern_release(ids[i]);
+  }
+  EXPECT_EQ_UINT64(size, c_intern_size());
+
+  c_intern_release(0);
+  EXPECT_EQ_STR("", c_intern_string(0));
+
+  return 0;
+}
+
+static uint32_t thread_ids[THREADS_NUM][STRINGS_NUM];
+
+static void *intern_thread(void *arg) {
+  uint32_t *ids = arg;
+
+  /* Every thread interns the same strings, in a different order. */
+  size_t offset = (size_t)(ids - thread_ids[0]) / STRINGS_NUM;
+  for (size_t i = 0; i < STRINGS_NUM; i++) {
+    size_t n = (i + offset * 997) % STRINGS_NUM;
+    char str[32];
+
+    snprintf(str, sizeof(str), "string-%zu", n);
+    if (c_intern(str, &ids[n]) != 0)
+      ids[n] = 0;
+  }
+  return NULL;
+}
+
+DEF_TEST(threaded) {
+  pthread_t threads[THREADS_NUM];
+  size_t size = c_intern_size();
+
+  for (size_t i = 0; i < THREADS_NUM; i++)
+    CHECK_ZERO(pthread_create(&threads[i], NULL, intern_thread, thread_ids[i]));
+  for (size_t i = 0; i < THREADS_NUM; i++)
+    pthread_join(threads[i], NULL);
+
+  EXPECT_EQ_UINT64(size + STRINGS_NUM, c_intern_size());
+
+  int mismatch = 0;
+  for (size_t n = 0; n < STRINGS_NUM; n++) {
+    char str[32];
+    snprintf(str, sizeof(str), "string-%zu", n);
+
+    char const *got = c_intern_string(thread_ids[0][n]);
+    if ((thread_ids[0][n] == 0) || (got == NULL) || (strcmp(str, got) != 0))
+      mismatch++;
+    for (size_t i = 1; i < THREADS_NUM; i++)
+      if (thread_ids[i][n] != thread_ids[0][n])
+        mismatch++;
+  }
+  EXPECT_EQ_INT(0, mismatch);
+
+  for (size_t i = 0; i < THREADS_NUM; i++)
+    for (size_t n = 0; n < STRINGS_NUM; n++)
+      c_intern_release(thread_ids[i][n]);
+  EXPECT_EQ_UINT64(size, c_intern_size());
+
+  return 0;
+}
+
+static void *churn_thread(void *arg) {
+  size_t *failed = arg;
+
+  /* Intern and release a small set of strings over and over again, so that
+   * entries are removed while other threads look them up. */
+  for (size_t i = 0; i < STRINGS_NUM; i++) {
+    char str[32];
+    snprintf(str, sizeof(str), "churn-%zu", i % 64);
+
+    uint32_t id;
+    if (c_intern(str, &id) != 0) {
+      (*failed)++;
+      continue;
+    }
+    char const *got = c_intern_string(id);
+    if ((got == NULL) || (strcmp(str, got) != 0))
+      (*failed)++;
+    c_intern_release(id);
+  }
+  return NULL;
+}
+
+DEF_TEST(churn) {
+  pthread_t threads[THREADS_NUM];
+  size_t failed[THREADS_NUM] = {0};
+  size_t size = c_intern_size();
+
+  for (size_t i = 0; i < THREADS_NUM; i++)
+    CHECK_ZERO(pthread_create(&threads[i], NULL, churn_thread, &failed[i]));
+  for (size_t i = 0; i < THREADS_NUM; i++) {
+    pthread_join(threads[i], NULL);
+    EXPECT_EQ_UINT64(0, failed[i]);
+  }
+
+  EXPECT_EQ_UINT64(size, c_intern_size());
+
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(simple);
+  RUN_TEST(release);
+  RUN_TEST(threaded);
+  RUN_TEST(churn);
+
+  END_TEST;
+}
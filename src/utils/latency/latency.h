@@ -31,10 +31,6 @@
 
 #include "utils_time.h"
 
-#ifndef HISTOGRAM_NUM_BINS
-#define HISTOGRAM_NUM_BINS 1000
-#endif
-
 struct latency_counter_s;
 typedef struct latency_counter_s latency_counter_t;
 
@@ -44,6 +40,19 @@ void latency_counter_destroy(latency_counter_t *lc);
 void latency_counter_add(latency_counter_t *lc, cdtime_t latency);
 void latency_counter_reset(latency_counter_t *lc);
 
+/*
+ * NAME
+ *  latency_counter_merge(dst,src)
+ *
+ * DESCRIPTION
+ *   Adds the latencies counted by `src' to `dst', as if they had been added to
+ *   `dst' directly. `src' is not changed.
+ *
+ * RETURN VALUE
+ *   Zero on success, EINVAL on error.
+ */
+int latency_counter_merge(latency_counter_t *dst, latency_counter_t const *src);
+
 cdtime_t latency_counter_get_min(latency_counter_t *lc);
 cdtime_t latency_counter_get_max(latency_counter_t *lc);
 cdtime_t latency_counter_get_sum(latency_counter_t *lc);
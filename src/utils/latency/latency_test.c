@@ -101,16 +101,46 @@ DEF_TEST(percentile) {
   return 0;
 }
 
+DEF_TEST(merge) {
+  latency_counter_t *a;
+  latency_counter_t *b;
+
+  CHECK_NOT_NULL(a = latency_counter_create());
+  CHECK_NOT_NULL(b = latency_counter_create());
+
+  /* Merging an empty counter changes nothing. */
+  CHECK_ZERO(latency_counter_merge(a, b));
+  EXPECT_EQ_INT(0, (int)latency_counter_get_num(a));
+  EXPECT_EQ_DOUBLE(0.0, CDTIME_T_TO_DOUBLE(latency_counter_get_min(a)));
+
+  for (size_t i = 0; i < 100; i++) {
+    latency_counter_t *l = (i % 2) ? a : b;
+    latency_counter_add(l, TIME_T_TO_CDTIME_T(((time_t)i) + 1));
+  }
+  CHECK_ZERO(latency_counter_merge(a, b));
+
+  EXPECT_EQ_INT(100, (int)latency_counter_get_num(a));
+  EXPECT_EQ_DOUBLE(1.0, CDTIME_T_TO_DOUBLE(latency_counter_get_min(a)));
+  EXPECT_EQ_DOUBLE(100.0, CDTIME_T_TO_DOUBLE(latency_counter_get_max(a)));
+  EXPECT_EQ_DOUBLE(50.5, CDTIME_T_TO_DOUBLE(latency_counter_get_average(a)));
+  EXPECT_EQ_DOUBLE(50.0,
+                   CDTIME_T_TO_DOUBLE(latency_counter_get_percentile(a, 50.0)));
+  EXPECT_EQ_DOUBLE(99.0,
+                   CDTIME_T_TO_DOUBLE(latency_counter_get_percentile(a, 99.0)));
+
+  /* The source is not changed. */
+  EXPECT_EQ_INT(50, (int)latency_counter_get_num(b));
+
+  latency_counter_destroy(a);
+  latency_counter_destroy(b);
+  return 0;
+}
+
 DEF_TEST(get_rate) {
-  /* We re-declare the struct here so we can inspect its content. */
+  /* We re-declare the start of the struct here so we can inspect its
+   * content. */
   struct {
     cdtime_t start_time;
-    cdtime_t sum;
-    size_t num;
-    cdtime_t min;
-    cdtime_t max;
-    cdtime_t bin_width;
-    int histogram[HISTOGRAM_NUM_BINS];
   } * peek;
   latency_counter_t *l;
 
@@ -121,76 +151,47 @@ DEF_TEST(get_rate) {
     latency_counter_add(l, TIME_T_TO_CDTIME_T(i));
   }
 
-  /* We expect a bucket width of 125ms. */
-  EXPECT_EQ_UINT64(DOUBLE_TO_CDTIME_T(0.125), peek->bin_width);
-
-  struct {
-    size_t index;
-    int want;
-  } bucket_cases[] = {
-      {0, 0},  /* (0.000-0.125] */
-      {1, 0},  /* (0.125-0.250] */
-      {2, 0},  /* (0.250-0.375] */
-      {3, 0},  /* (0.375-0.500] */
-      {4, 0},  /* (0.500-0.625] */
-      {5, 0},  /* (0.625-0.750] */
-      {6, 0},  /* (0.750-0.875] */
-      {7, 1},  /* (0.875-1.000] */
-      {8, 0},  /* (1.000-1.125] */
-      {9, 0},  /* (1.125-1.250] */
-      {10, 0}, /* (1.250-1.375] */
-      {11, 0}, /* (1.375-1.500] */
-      {12, 0}, /* (1.500-1.625] */
-      {13, 0}, /* (1.625-1.750] */
-      {14, 0}, /* (1.750-1.875] */
-      {15, 1}, /* (1.875-2.000] */
-      {16, 0}, /* (2.000-2.125] */
-  };
-
-  for (size_t i = 0; i < STATIC_ARRAY_SIZE(bucket_cases); i++) {
-    size_t index = bucket_cases[i].index;
-    EXPECT_EQ_INT(bucket_cases[i].want, peek->histogram[index]);
-  }
-
+  /* Between 0.5 and 1 seconds the buckets are 1/64 seconds wide, between 1
+   * and 2 seconds 1/32 seconds. */
   struct {
     cdtime_t lower_bound;
     cdtime_t upper_bound;
     double want;
   } cases[] = {
       {
-          // bucket 6 is zero
+          // no updates in this range
           DOUBLE_TO_CDTIME_T_STATIC(0.750),
           DOUBLE_TO_CDTIME_T_STATIC(0.875),
           0.00,
       },
       {
-          // bucket 7 contains the t=1 update
+          // contains the t=1 update
           DOUBLE_TO_CDTIME_T_STATIC(0.875),
           DOUBLE_TO_CDTIME_T_STATIC(1.000),
           1.00,
       },
       {
-          // range: bucket 7 - bucket 15; contains the t=1 and t=2 updates
+          // contains the t=1 and t=2 updates
           DOUBLE_TO_CDTIME_T_STATIC(0.875),
           DOUBLE_TO_CDTIME_T_STATIC(2.000),
           2.00,
       },
       {
-          // lower bucket is only partially applied
-          DOUBLE_TO_CDTIME_T_STATIC(0.875 + (0.125 / 4)),
+          // lower bucket (63/64-1] is only partially applied
+          DOUBLE_TO_CDTIME_T_STATIC(1.000 - (3.0 / 256)),
           DOUBLE_TO_CDTIME_T_STATIC(2.000),
           1.75,
       },
       {
-          // upper bucket is only partially applied
+          // upper bucket (63/32-2] is only partially applied
           DOUBLE_TO_CDTIME_T_STATIC(0.875),
-          DOUBLE_TO_CDTIME_T_STATIC(2.000 - (0.125 / 4)),
+          DOUBLE_TO_CDTIME_T_STATIC(2.000 - (1.0 / 128)),
           1.75,
       },
       {
           // both buckets are only partially applied
-          DOUBLE_TO_CDTIME_T_STATIC(0.875 + (0.125 / 4)),
-          DOUBLE_TO_CDTIME_T_STATIC(2.000 - (0.125 / 4)),
+          DOUBLE_TO_CDTIME_T_STATIC(1.000 - (3.0 / 256)),
+          DOUBLE_TO_CDTIME_T_STATIC(2.000 - (1.0 / 128)),
           1.50,
       },
       {
@@ -201,7 +202,7 @@ DEF_TEST(get_rate) {
       },
       {
           // upper bound is unspecified
-          DOUBLE_TO_CDTIME_T_STATIC(125.000 - 0.125),
+          DOUBLE_TO_CDTIME_T_STATIC(124.000),
           0,
           1.00,
       },
@@ -245,6 +246,7 @@ DEF_TEST(get_rate) {
 int main(void) {
   RUN_TEST(simple);
   RUN_TEST(percentile);
+  RUN_TEST(merge);
   RUN_TEST(get_rate);
 
   END_TEST;
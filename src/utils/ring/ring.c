@@ -0,0 +1,174 @@
+/**
+ * collectd - src/utils/ring/ring.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/* The algorithm is Dmitry Vyukov's bounded MPMC queue: every cell carries a
+ * sequence number which tells producers and consumers whether the cell is
+ * ready for them. Producers and consumers only contend on their own position
+ * counter, which are kept on separate cache lines. */
+
+#include "collectd.h"
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "utils/ring/ring.h"
+
+#ifndef RING_CACHE_LINE_SIZE
+#define RING_CACHE_LINE_SIZE 64
+#endif
+
+struct c_ring_s {
+  size_t mask;
+  size_t elem_size;
+  size_t cell_size;
+  unsigned char *cells;
+
+  char pad0[RING_CACHE_LINE_SIZE];
+  size_t enqueue_pos;
+  char pad1[RING_CACHE_LINE_SIZE - sizeof(size_t)];
+  size_t dequeue_pos;
+  char pad2[RING_CACHE_LINE_SIZE - sizeof(size_t)];
+};
+
+/* Each cell is a sequence number followed by the element data. */
+#define CELL(r, pos) ((r)->cells + ((pos) & (r)->mask) * (r)->cell_size)
+#define CELL_SEQ(c) ((size_t *)(c))
+#define CELL_DATA(c) ((c) + sizeof(size_t))
+
+c_ring_t *c_ring_create(size_t capacity, size_t elem_size) {
+  if ((capacity == 0) || (elem_size == 0) || (capacity > (SIZE_MAX / 2)))
+    return NULL;
+
+  size_t size = 2;
+  while (size < capacity)
+    size *= 2;
+
+  c_ring_t *r = calloc(1, sizeof(*r));
+  if (r == NULL)
+    return NULL;
+
+  r->mask = size - 1;
+  r->elem_size = elem_size;
+  /* Round up so the sequence number of every cell is properly aligned. */
+  r->cell_size = sizeof(size_t) + elem_size;
+  r->cell_size = (r->cell_size + sizeof(size_t) - 1) & ~(sizeof(size_t) - 1);
+
+  r->cells = calloc(size, r->cell_size);
+  if (r->cells == NULL) {
+    free(r);
+    return NULL;
+  }
+
+  for (size_t i = 0; i < size; i++)
+    *CELL_SEQ(CELL(r, i)) = i;
+
+  return r;
+} /* c_ring_t *c_ring_create */
+
+void c_ring_destroy(c_ring_t *r) {
+  if (r == NULL)
+    return;
+
+  free(r->cells);
+  free(r);
+} /* void c_ring_destroy */
+
+int c_ring_push(c_ring_t *r, void const *elem) {
+  if ((r == NULL) || (elem == NULL))
+    return EINVAL;
+
+  size_t pos = __atomic_load_n(&r->enqueue_pos, __ATOMIC_RELAXED);
+  unsigned char *cell;
+  while (42) {
+    cell = CELL(r, pos);
+    size_t seq = __atomic_load_n(CELL_SEQ(cell), __ATOMIC_ACQUIRE);
+    intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&r->enqueue_pos, &pos, pos + 1,
+                                      /* weak = */ true, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED))
+        break;
+    } else if (diff < 0) {
+      return EAGAIN;
+    } else {
+      pos = __atomic_load_n(&r->enqueue_pos, __ATOMIC_RELAXED);
+    }
+  }
+
+  memcpy(CELL_DATA(cell), elem, r->elem_size);
+  __atomic_store_n(CELL_SEQ(cell), pos + 1, __ATOMIC_RELEASE);
+  return 0;
+} /* int c_ring_push */
+
+int c_ring_pop(c_ring_t *r, void *elem) {
+  if ((r == NULL) || (elem == NULL))
+    return EINVAL;
+
+  size_t pos = __atomic_load_n(&r->dequeue_pos, __ATOMIC_RELAXED);
+  unsigned char *cell;
+  while (42) {
+    cell = CELL(r, pos);
+    size_t seq = __atomic_load_n(CELL_SEQ(cell), __ATOMIC_ACQUIRE);
+    intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+    if (diff == 0) {
+      if (__atomic_compare_exchange_n(&r->dequeue_pos, &pos, pos + 1,
+                                      /* weak = */ true, __ATOMIC_RELAXED,
+                                      __ATOMIC_RELAXED))
+        break;
+    } else if (diff < 0) {
+      return EAGAIN;
+    } else {
+      pos = __atomic_load_n(&r->dequeue_pos, __ATOMIC_RELAXED);
+    }
+  }
+
+  memcpy(elem, CELL_DATA(cell), r->elem_size);
+  __atomic_store_n(CELL_SEQ(cell), pos + r->mask + 1, __ATOMIC_RELEASE);
+  return 0;
+} /* int c_ring_pop */
+
+size_t c_ring_length(c_ring_t *r) {
+  if (r == NULL)
+    return 0;
+
+  size_t deq = __atomic_load_n(&r->dequeue_pos, __ATOMIC_RELAXED);
+  size_t enq = __atomic_load_n(&r->enqueue_pos, __ATOMIC_RELAXED);
+
+  /* The two loads are not atomic with respect to each other, so the
+   * difference may briefly be out of range. */
+  if (enq <= deq)
+    return 0;
+  if ((enq - deq) > (r->mask + 1))
+    return r->mask + 1;
+  return enq - deq;
+} /* size_t c_ring_length */
+
+size_t c_ring_capacity(c_ring_t const *r) {
+  if (r == NULL)
+    return 0;
+  return r->mask + 1;
+} /* size_t c_ring_capacity */
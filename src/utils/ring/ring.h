@@ -0,0 +1,109 @@
+/**
+ * collectd - src/utils/ring/ring.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_RING_H
+#define UTILS_RING_H 1
+
+#include <stddef.h>
+
+/*
+ * Bounded multi-producer / multi-consumer queue. All storage is allocated by
+ * `c_ring_create'; `c_ring_push' and `c_ring_pop' neither allocate memory nor
+ * take a lock. Elements are copied in and out by value.
+ */
+struct c_ring_s;
+typedef struct c_ring_s c_ring_t;
+
+/*
+ * NAME
+ *   c_ring_create
+ *
+ * DESCRIPTION
+ *   Allocates a new ring.
+ *
+ * PARAMETERS
+ *   `capacity'   Minimum number of elements the ring can hold. This is
+ *                rounded up to the next power of two.
+ *   `elem_size'  Size of one element in bytes.
+ *
+ * RETURN VALUE
+ *   A c_ring_t-pointer upon success or NULL upon failure.
+ */
+c_ring_t *c_ring_create(size_t capacity, size_t elem_size);
+
+/*
+ * NAME
+ *   c_ring_destroy
+ *
+ * DESCRIPTION
+ *   Deallocates a ring. Elements still stored in the ring are lost. Must not
+ *   be called while other threads are still using the ring.
+ */
+void c_ring_destroy(c_ring_t *r);
+
+/*
+ * NAME
+ *   c_ring_push
+ *
+ * DESCRIPTION
+ *   Copies `elem_size' bytes from `elem' to the tail of the ring.
+ *
+ * RETURN VALUE
+ *   Zero upon success, EAGAIN if the ring is full and EINVAL if an argument
+ *   is invalid.
+ */
+int c_ring_push(c_ring_t *r, void const *elem);
+
+/*
+ * NAME
+ *   c_ring_pop
+ *
+ * DESCRIPTION
+ *   Removes the element at the head of the ring and copies it to `elem'.
+ *
+ * RETURN VALUE
+ *   Zero upon success, EAGAIN if the ring is empty and EINVAL if an argument
+ *   is invalid.
+ */
+int c_ring_pop(c_ring_t *r, void *elem);
+
+/*
+ * NAME
+ *   c_ring_length
+ *
+ * DESCRIPTION
+ *   Returns the number of elements currently stored in the ring. Since other
+ *   threads may modify the ring concurrently, the value is a snapshot only.
+ */
+size_t c_ring_length(c_ring_t *r);
+
+/*
+ * NAME
+ *   c_ring_capacity
+ *
+ * DESCRIPTION
+ *   Returns the number of elements the ring can hold.
+ */
+size_t c_ring_capacity(c_ring_t const *r);
+
+#endif /* UTILS_RING_H */
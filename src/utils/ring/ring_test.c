@@ -0,0 +1,131 @@
+/**
+ * collectd - src/utils/ring/ring_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "testing.h"
+#include "utils/ring/ring.h"
+
+#include <pthread.h>
+
+#define PRODUCERS 4
+#define CONSUMERS 4
+#define ITEMS_PER_PRODUCER 100000
+
+DEF_TEST(simple) {
+  c_ring_t *r;
+  int v;
+
+  CHECK_NOT_NULL(r = c_ring_create(5, sizeof(int)));
+  EXPECT_EQ_UINT64(8, c_ring_capacity(r));
+  EXPECT_EQ_UINT64(0, c_ring_length(r));
+  EXPECT_EQ_INT(EAGAIN, c_ring_pop(r, &v));
+
+  for (int i = 0; i < 8; i++)
+    CHECK_ZERO(c_ring_push(r, &i));
+  EXPECT_EQ_UINT64(8, c_ring_length(r));
+  v = 8;
+  EXPECT_EQ_INT(EAGAIN, c_ring_push(r, &v));
+
+  /* Wrap around a few times to make sure sequence numbers are reused. */
+  for (int i = 0; i < 100; i++) {
+    CHECK_ZERO(c_ring_pop(r, &v));
+    EXPECT_EQ_INT(i, v);
+    v = i + 8;
+    CHECK_ZERO(c_ring_push(r, &v));
+  }
+
+  for (int i = 100; i < 108; i++) {
+    CHECK_ZERO(c_ring_pop(r, &v));
+    EXPECT_EQ_INT(i, v);
+  }
+  EXPECT_EQ_UINT64(0, c_ring_length(r));
+  EXPECT_EQ_INT(EAGAIN, c_ring_pop(r, &v));
+
+  c_ring_destroy(r);
+  return 0;
+}
+
+static c_ring_t *threaded_ring;
+static uint64_t consumed_sum;
+static uint64_t consumed_count;
+
+static void *producer(void *arg) {
+  uint64_t base = (uint64_t)(uintptr_t)arg * ITEMS_PER_PRODUCER;
+
+  for (uint64_t i = 0; i < ITEMS_PER_PRODUCER; i++) {
+    uint64_t v = base + i + 1;
+    while (c_ring_push(threaded_ring, &v) == EAGAIN)
+      sched_yield();
+  }
+  return NULL;
+}
+
+static void *consumer(__attribute__((unused)) void *arg) {
+  uint64_t total = (uint64_t)PRODUCERS * ITEMS_PER_PRODUCER;
+
+  while (__atomic_load_n(&consumed_count, __ATOMIC_RELAXED) < total) {
+    uint64_t v;
+    if (c_ring_pop(threaded_ring, &v) != 0) {
+      sched_yield();
+      continue;
+    }
+    __atomic_add_fetch(&consumed_sum, v, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&consumed_count, 1, __ATOMIC_RELAXED);
+  }
+  return NULL;
+}
+
+DEF_TEST(threaded) {
+  pthread_t producers[PRODUCERS];
+  pthread_t consumers[CONSUMERS];
+  uint64_t n = (uint64_t)PRODUCERS * ITEMS_PER_PRODUCER;
+
+  CHECK_NOT_NULL(threaded_ring = c_ring_create(1024, sizeof(uint64_t)));
+
+  for (size_t i = 0; i < CONSUMERS; i++)
+    CHECK_ZERO(pthread_create(&consumers[i], NULL, consumer, NULL));
+  for (size_t i = 0; i < PRODUCERS; i++)
+    CHECK_ZERO(
+        pthread_create(&producers[i], NULL, producer, (void *)(uintptr_t)i));
+
+  for (size_t i = 0; i < PRODUCERS; i++)
+    pthread_join(producers[i], NULL);
+  for (size_t i = 0; i < CONSUMERS; i++)
+    pthread_join(consumers[i], NULL);
+
+  /* Count and sum of the consumed values must match what was produced. */
+  EXPECT_EQ_UINT64(n, consumed_count);
+  EXPECT_EQ_UINT64(n * (n + 1) / 2, consumed_sum);
+  EXPECT_EQ_UINT64(0, c_ring_length(threaded_ring));
+
+  c_ring_destroy(threaded_ring);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(simple);
+  RUN_TEST(threaded);
+
+  END_TEST;
+}
@@ -0,0 +1,458 @@
+/**
+ * collectd - src/utils/rrdc_batch/rrdc_batch.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "utils/common/common.h"
+#include "utils/rrdc_batch/rrdc_batch.h"
+
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+#define RRDC_DEFAULT_PORT "42217"
+
+/* The buffer always starts with the BATCH command, so that a batch can be sent
+ * with a single write. A single update is sent without it. */
+#define RRDC_BATCH_HEADER "BATCH\n"
+#define RRDC_BATCH_FOOTER ".\n"
+
+struct rrdc_batch_s {
+  char *address;
+  bool is_unix;
+  int fd;
+
+  size_t batch_size;
+  size_t pending;
+  cdtime_t oldest;
+
+  char *buffer;
+  size_t buffer_len;
+  size_t buffer_size;
+
+  /* Data received but not yet returned by rrdc_read_line(). */
+  char recv_buffer[4096];
+  size_t recv_len;
+};
+
+static void rrdc_disconnect(rrdc_batch_t *b) /* {{{ */
+{
+  if (b->fd >= 0)
+    close(b->fd);
+  b->fd = -1;
+  b->recv_len = 0;
+} /* }}} void rrdc_disconnect */
+
+static int rrdc_connect_unix(rrdc_batch_t *b, char const *path) /* {{{ */
+{
+  struct sockaddr_un sa = {.sun_family = AF_UNIX};
+  if (strlen(path) >= sizeof(sa.sun_path))
+    return ENAMETOOLONG;
+  sstrncpy(sa.sun_path, path, sizeof(sa.sun_path));
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return errno;
+
+  if (connect(fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) {
+    int status = errno;
+    close(fd);
+    return status;
+  }
+
+  b->fd = fd;
+  return 0;
+} /* }}} int rrdc_connect_unix */
+
+static int rrdc_connect_tcp(rrdc_batch_t *b, char const *address) /* {{{ */
+{
+  char host[NI_MAXHOST];
+  char const *port = RRDC_DEFAULT_PORT;
+
+  /* "[v6addr]:port", "[v6addr]", "host:port" or "host" */
+  if (address[0] == '[') {
+    char const *end = strchr(address, ']');
+    if ((end == NULL) || ((size_t)(end - address) > sizeof(host)))
+      return EINVAL;
+    sstrncpy(host, address + 1, (size_t)(end - address));
+    if (end[1] == ':')
+      port = end + 2;
+  } else {
+    sstrncpy(host, address, sizeof(host));
+    char *colon = strchr(host, ':');
+    /* More than one colon: an IPv6 address without a port. */
+    if ((colon != NULL) && (strchr(colon + 1, ':') == NULL)) {
+      *colon = 0;
+      port = address + (colon - host) + 1;
+    }
+  }
+
+  struct addrinfo ai_hints = {.ai_family = AF_UNSPEC,
+                              .ai_socktype = SOCK_STREAM,
+                              .ai_flags = AI_ADDRCONFIG};
+  struct addrinfo *ai_list;
+  int status = getaddrinfo(host, port, &ai_hints, &ai_list);
+  if (status != 0) {
+    ERROR("rrdc_batch: getaddrinfo(%s, %s) failed: %s", host, port,
+          gai_strerror(status));
+    return EHOSTUNREACH;
+  }
+
+  status = ECONNREFUSED;
+  for (struct addrinfo *ai = ai_list; ai != NULL; ai = ai->ai_next) {
+    int fd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd < 0) {
+      status = errno;
+      continue;
+    }
+
+    if (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+      status = errno;
+      close(fd);
+      continue;
+    }
+
+    b->fd = fd;
+    status = 0;
+    break;
+  }
+
+  freeaddrinfo(ai_list);
+  return status;
+} /* }}} int rrdc_connect_tcp */
+
+static int rrdc_connect(rrdc_batch_t *b) /* {{{ */
+{
+  if (b->fd >= 0)
+    return 0;
+
+  b->recv_len = 0;
+
+  int status;
+  if (strncmp("unix:", b->address, strlen("unix:")) == 0)
+    status = rrdc_connect_unix(b, b->address + strlen("unix:"));
+  else if (b->is_unix)
+    status = rrdc_connect_unix(b, b->address);
+  else
+    status = rrdc_connect_tcp(b, b->address);
+
+  if (status != 0)
+    ERROR("rrdc_batch: Connecting to %s failed: %s", b->address,
+          STRERROR(status));
+  return status;
+} /* }}} int rrdc_connect */
+
+static int rrdc_send_all(rrdc_batch_t *b, char const *data, /* {{{ */
+                         size_t data_len) {
+  while (data_len > 0) {
+    ssize_t status = send(b->fd, data, data_len, MSG_NOSIGNAL);
+    if (status < 0) {
+      if (errno == EINTR)
+        continue;
+      return errno;
+    }
+
+    data += status;
+    data_len -= (size_t)status;
+  }
+
+  return 0;
+} /* }}} int rrdc_send_all */
+
+/* Reads one line from the daemon into `line', without the newline. Overly long
+ * lines are truncated. */
+static int rrdc_read_line(rrdc_batch_t *b, char *line, /* {{{ */
+                          size_t line_size) {
+  while (42) {
+    char *newline = memchr(b->recv_buffer, '\n', b->recv_len);
+    if (newline != NULL) {
+      size_t len = (size_t)(newline - b->recv_buffer);
+      size_t copy_len = (len < line_size - 1) ? len : line_size - 1;
+      memcpy(line, b->recv_buffer, copy_len);
+      line[copy_len] = 0;
+
+      b->recv_len -= len + 1;
+      memmove(b->recv_buffer, newline + 1, b->recv_len);
+      return 0;
+    }
+
+    /* No newline in a full buffer: drop the beginning of the line. */
+    if (b->recv_len == sizeof(b->recv_buffer))
+      b->recv_len = 0;
+
+    ssize_t status = recv(b->fd, b->recv_buffer + b->recv_len,
+                          sizeof(b->recv_buffer) - b->recv_len, 0);
+    if (status < 0) {
+      if (errno == EINTR)
+        continue;
+      return errno;
+    } else if (status == 0) {
+      return ECONNRESET;
+    }
+    b->recv_len += (size_t)status;
+  }
+} /* }}} int rrdc_read_line */
+
+/* Reads the "<status> <message>" line RRDCacheD answers every command with.
+ * Negative status codes indicate an error. */
+static int rrdc_read_status(rrdc_batch_t *b, int *ret_status, /* {{{ */
+                            char *message, size_t message_size) {
+  char line[1024];
+  int status = rrdc_read_line(b, line, sizeof(line));
+  if (status != 0)
+    return status;
+
+  char *endptr = NULL;
+  errno = 0;
+  long value = strtol(line, &endptr, 10);
+  if ((errno != 0) || (endptr == line)) {
+    ERROR("rrdc_batch: Unexpected response from %s: \"%s\"", b->address, line);
+    return EPROTO;
+  }
+
+  while (isspace((unsigned char)*endptr))
+    endptr++;
+  sstrncpy(message, endptr, message_size);
+
+  *ret_status = (int)value;
+  return 0;
+} /* }}} int rrdc_read_status */
+
+/* Writes the buffered updates and reads the responses. Returns an errno value
+ * if the connection failed. */
+static int rrdc_batch_transmit(rrdc_batch_t *b) /* {{{ */
+{
+  int status = rrdc_connect(b);
+  if (status != 0)
+    return status;
+
+  char message[1024];
+  int response;
+
+  if (b->pending == 1) {
+    char const *data = b->buffer + strlen(RRDC_BATCH_HEADER);
+    status = rrdc_send_all(b, data, b->buffer_len - strlen(RRDC_BATCH_HEADER));
+    if (status == 0)
+      status = rrdc_read_status(b, &response, message, sizeof(message));
+    if (status != 0)
+      return status;
+
+    if (response < 0)
+      WARNING("rrdc_batch: Update rejected by %s: %s", b->address, message);
+    return 0;
+  }
+
+  /* The footer fits because rrdc_batch_add() reserves room for it. */
+  memcpy(b->buffer + b->buffer_len, RRDC_BATCH_FOOTER,
+         strlen(RRDC_BATCH_FOOTER));
+  status = rrdc_send_all(b, b->buffer,
+                         b->buffer_len + strlen(RRDC_BATCH_FOOTER));
+  if (status != 0)
+    return status;
+
+  /* "0 Go ahead.  End with dot '.' on its own line." */
+  status = rrdc_read_status(b, &response, message, sizeof(message));
+  if (status != 0)
+    return status;
+  if (response != 0) {
+    ERROR("rrdc_batch: %s refused the BATCH command: %s", b->address, message);
+    return EPROTO;
+  }
+
+  /* "<n> errors", followed by "<command number> <message>" lines. */
+  status = rrdc_read_status(b, &response, message, sizeof(message));
+  if (status != 0)
+    return status;
+
+  for (int i = 0; i < response; i++) {
+    char line[1024];
+    status = rrdc_read_line(b, line, sizeof(line));
+    if (status != 0)
+      return status;
+    WARNING("rrdc_batch: Update rejected by %s: command %s", b->address, line);
+  }
+
+  return 0;
+} /* }}} int rrdc_batch_transmit */
+
+static void rrdc_batch_clear(rrdc_batch_t *b) /* {{{ */
+{
+  b->buffer_len = strlen(RRDC_BATCH_HEADER);
+  b->pending = 0;
+  b->oldest = 0;
+} /* }}} void rrdc_batch_clear */
+
+rrdc_batch_t *rrdc_batch_create(char const *address, /* {{{ */
+                                size_t batch_size) {
+  if ((address == NULL) || (batch_size == 0))
+    return NULL;
+
+  rrdc_batch_t *b = calloc(1, sizeof(*b));
+  if (b == NULL)
+    return NULL;
+
+  b->fd = -1;
+  b->is_unix = (address[0] == '/') ||
+               (strncmp("unix:", address, strlen("unix:")) == 0);
+  b->batch_size = batch_size;
+  b->address = strdup(address);
+  b->buffer_size = 4096;
+  b->buffer = malloc(b->buffer_size);
+  if ((b->address == NULL) || (b->buffer == NULL)) {
+    rrdc_batch_destroy(b);
+    return NULL;
+  }
+
+  memcpy(b->buffer, RRDC_BATCH_HEADER, strlen(RRDC_BATCH_HEADER));
+  rrdc_batch_clear(b);
+  return b;
+} /* }}} rrdc_batch_t *rrdc_batch_create */
+
+void rrdc_batch_destroy(rrdc_batch_t *b) /* {{{ */
+{
+  if (b == NULL)
+    return;
+
+  rrdc_disconnect(b);
+  sfree(b->address);
+  sfree(b->buffer);
+  sfree(b);
+} /* }}} void rrdc_batch_destroy */
+
+/* Normalizes `filename' the way librrd's client does before sending it: the
+ * daemon resolves relative names against its own working directory, so they
+ * are made absolute when talking to a local daemon, and absolute names are
+ * refused for a remote one. */
+static int rrdc_batch_path(rrdc_batch_t const *b, /* {{{ */
+                           char const *filename,
+                           char buffer[static PATH_MAX],
+                           char const **ret_path) {
+  if (!b->is_unix) {
+    if (filename[0] == '/') {
+      ERROR("rrdc_batch: Absolute file names are not allowed when talking "
+            "to the remote daemon %s: %s",
+            b->address, filename);
+      return EINVAL;
+    }
+    *ret_path = filename;
+    return 0;
+  }
+
+  if (realpath(filename, buffer) == NULL) {
+    int status = errno;
+    ERROR("rrdc_batch: realpath (%s) failed: %s", filename, STRERROR(status));
+    return status;
+  }
+  *ret_path = buffer;
+  return 0;
+} /* }}} int rrdc_batch_path */
+
+int rrdc_batch_add(rrdc_batch_t *b, char const *filename, /* {{{ */
+                   char const *values) {
+  if ((b == NULL) || (filename == NULL) || (values == NULL))
+    return EINVAL;
+
+  char path_buffer[PATH_MAX];
+  int status = rrdc_batch_path(b, filename, path_buffer, &filename);
+  if (status != 0)
+    return status;
+
+  /* "UPDATE <filename> <values>\n", with spaces and backslashes in the file
+   * name escaped. Room for the batch footer is kept at the end. */
+  size_t need = strlen("UPDATE ") + 2 * strlen(filename) + 1 + strlen(values) +
+                1 + strlen(RRDC_BATCH_FOOTER);
+  if (b->buffer_len + need > b->buffer_size) {
+    size_t size = b->buffer_size;
+    while (b->buffer_len + need > size)
+      size *= 2;
+
+    char *tmp = realloc(b->buffer, size);
+    if (tmp == NULL)
+      return ENOMEM;
+    b->buffer = tmp;
+    b->buffer_size = size;
+  }
+
+  char *ptr = b->buffer + b->buffer_len;
+  memcpy(ptr, "UPDATE ", strlen("UPDATE "));
+  ptr += strlen("UPDATE ");
+  for (char const *c = filename; *c != 0; c++) {
+    if ((*c == ' ') || (*c == '\\'))
+      *(ptr++) = '\\';
+    *(ptr++) = *c;
+  }
+  *(ptr++) = ' ';
+  memcpy(ptr, values, strlen(values));
+  ptr += strlen(values);
+  *(ptr++) = '\n';
+  b->buffer_len = (size_t)(ptr - b->buffer);
+
+  if (b->pending == 0)
+    b->oldest = cdtime();
+  b->pending++;
+
+  if (b->pending >= b->batch_size)
+    return rrdc_batch_send(b);
+  return 0;
+} /* }}} int rrdc_batch_add */
+
+int rrdc_batch_send(rrdc_batch_t *b) /* {{{ */
+{
+  if (b == NULL)
+    return EINVAL;
+  if (b->pending == 0)
+    return 0;
+
+  int status = rrdc_batch_transmit(b);
+  if (status != 0) {
+    /* The daemon may have closed an idle connection. Try once more with a
+     * new connection. */
+    rrdc_disconnect(b);
+    status = rrdc_batch_transmit(b);
+  }
+
+  if (status != 0) {
+    ERROR("rrdc_batch: Sending %" PRIsz " update%s to %s failed: %s",
+          b->pending, (b->pending == 1) ? "" : "s", b->address,
+          STRERROR(status));
+    rrdc_disconnect(b);
+  }
+
+  rrdc_batch_clear(b);
+  return status;
+} /* }}} int rrdc_batch_send */
+
+size_t rrdc_batch_pending(rrdc_batch_t const *b) /* {{{ */
+{
+  return (b != NULL) ? b->pending : 0;
+} /* }}} size_t rrdc_batch_pending */
+
+cdtime_t rrdc_batch_oldest(rrdc_batch_t const *b) /* {{{ */
+{
+  return (b != NULL) ? b->oldest : 0;
+} /* }}} cdtime_t rrdc_batch_oldest */
@@ -0,0 +1,105 @@
+/**
+ * collectd - src/utils/rrdc_batch/rrdc_batch.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_RRDC_BATCH_H
+#define UTILS_RRDC_BATCH_H 1
+
+#include "collectd.h"
+
+/*
+ * Client for the update commands of RRDCacheD's text protocol. Updates are
+ * buffered and sent using the "BATCH" command, which lets the daemon process
+ * any number of updates with a single round trip: the whole batch, including
+ * the terminating dot, is written at once and both responses are read
+ * afterwards. A single buffered update is sent as a plain "UPDATE" command.
+ *
+ * Functions of one rrdc_batch_t must not be called concurrently.
+ */
+struct rrdc_batch_s;
+typedef struct rrdc_batch_s rrdc_batch_t;
+
+/*
+ * NAME
+ *   rrdc_batch_create
+ *
+ * DESCRIPTION
+ *   Creates a new batch for the daemon at `address', which uses the same
+ *   syntax as librrd: "unix:<path>" or an absolute path for a UNIX socket,
+ *   "<host>[:<port>]" for TCP. The connection is established when the first
+ *   batch is sent.
+ *
+ * PARAMETERS
+ *   `address'      Address of the daemon.
+ *   `batch_size'   Number of updates after which rrdc_batch_add() sends the
+ *                  batch. Must be at least one.
+ *
+ * RETURN VALUE
+ *   The new batch or NULL on error.
+ */
+rrdc_batch_t *rrdc_batch_create(char const *address, size_t batch_size);
+
+/* Frees the batch and closes the connection. Pending updates are lost. */
+void rrdc_batch_destroy(rrdc_batch_t *b);
+
+/*
+ * NAME
+ *   rrdc_batch_add
+ *
+ * DESCRIPTION
+ *   Buffers an update of `filename' with `values' ("<time>:<value>[:...]").
+ *   If the batch is full afterwards, it is sent with rrdc_batch_send().
+ *
+ *   Like librrd's rrdc_update(), the file name is resolved with realpath(3)
+ *   if the daemon is reached via a UNIX socket, so it must exist; absolute
+ *   file names are refused if it is reached via TCP.
+ *
+ * RETURN VALUE
+ *   Zero on success, an errno value if the update could not be buffered or
+ *   sending the batch failed.
+ */
+int rrdc_batch_add(rrdc_batch_t *b, char const *filename, char const *values);
+
+/*
+ * NAME
+ *   rrdc_batch_send
+ *
+ * DESCRIPTION
+ *   Sends all buffered updates and waits for the daemon's response. Updates
+ *   the daemon rejects are logged and dropped. If the connection fails, it is
+ *   re-established once and the batch is sent again; if that fails too, the
+ *   updates are dropped.
+ *
+ * RETURN VALUE
+ *   Zero on success (including batches with rejected updates and empty
+ *   batches), an errno value if the batch could not be sent.
+ */
+int rrdc_batch_send(rrdc_batch_t *b);
+
+/* Returns the number of buffered updates. */
+size_t rrdc_batch_pending(rrdc_batch_t const *b);
+
+/* Returns the time the oldest buffered update was added or zero if there are
+ * none. */
+cdtime_t rrdc_batch_oldest(rrdc_batch_t const *b);
+
+#endif /* UTILS_RRDC_BATCH_H */
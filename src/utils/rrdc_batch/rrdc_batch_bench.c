@@ -0,0 +1,105 @@
+/**
+ * collectd - src/utils/rrdc_batch/rrdc_batch_bench.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/*
+ * Measures how many updates per second RRDCacheD accepts from rrdc_batch.
+ * Build with "make bench_rrdc_batch" and run against a running daemon as
+ * "./bench_rrdc_batch <address> <file> [<file> ...]".
+ *
+ * The files must be existing RRD files with a single data source. The updates
+ * cycle through them with increasing timestamps, so that the daemon accepts
+ * all of them. "update" sends every update as its own UPDATE command and waits
+ * for the response, as rrdc_update() does; "batch" sends BATCH_SIZE updates
+ * per BATCH command.
+ */
+
+#include "collectd.h"
+
+#include "utils/common/common.h"
+#include "utils/rrdc_batch/rrdc_batch.h"
+
+#define BATCH_SIZE 100
+#define UPDATES_NUM 20000
+
+static char const *address;
+static char **files;
+static int files_num;
+
+/* The last timestamp used for the files, shared by both runs. */
+static time_t last_time;
+
+static int run(char const *name, size_t batch_size) {
+  rrdc_batch_t *b = rrdc_batch_create(address, batch_size);
+  if (b == NULL) {
+    fprintf(stderr, "rrdc_batch_create failed.\n");
+    return -1;
+  }
+
+  struct timespec start;
+  struct timespec end;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  int failed = 0;
+  for (int i = 0; i < UPDATES_NUM; i++) {
+    if ((i % files_num) == 0)
+      last_time++;
+
+    char values[64];
+    snprintf(values, sizeof(values), "%lld:%d", (long long)last_time, i);
+    if (rrdc_batch_add(b, files[i % files_num], values) != 0)
+      failed++;
+  }
+  if (rrdc_batch_send(b) != 0)
+    failed++;
+
+  clock_gettime(CLOCK_MONOTONIC, &end);
+  rrdc_batch_destroy(b);
+
+  if (failed != 0) {
+    fprintf(stderr, "%s: %d updates failed.\n", name, failed);
+    return -1;
+  }
+
+  double elapsed = (double)(end.tv_sec - start.tv_sec) +
+                   (double)(end.tv_nsec - start.tv_nsec) / 1e9;
+  printf("%-8s %10.0f updates/s\n", name, UPDATES_NUM / elapsed);
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s <address> <file> [<file> ...]\n", argv[0]);
+    return 1;
+  }
+
+  address = argv[1];
+  files = argv + 2;
+  files_num = argc - 2;
+  last_time = time(NULL);
+
+  int status = 0;
+  status |= run("update", 1);
+  status |= run("batch", BATCH_SIZE);
+
+  return (status == 0) ? 0 : 1;
+}
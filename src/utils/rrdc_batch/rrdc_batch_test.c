@@ -0,0 +1,340 @@
+/**
+ * collectd - src/utils/rrdc_batch/rrdc_batch_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "testing.h"
+#include "utils/rrdc_batch/rrdc_batch.h"
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+/*
+ * A minimal RRDCacheD: accepts one connection at a time and answers the
+ * UPDATE and BATCH commands like the real daemon does. Updates of files whose
+ * name contains "missing" are rejected. After `close_after' commands the
+ * connection is closed, to test reconnecting.
+ */
+typedef struct {
+  char dir[PATH_MAX];
+  char path[PATH_MAX + 16];
+  int listen_fd;
+  pthread_t thread;
+
+  int close_after;
+  int commands;
+
+  /* Accepted updates and the last one, with escapes removed. */
+  int updates;
+  char last_update[1024];
+} fake_rrdcached_t;
+
+static fake_rrdcached_t server;
+
+static int read_line(FILE *fh, char *buffer, size_t buffer_size) {
+  if (fgets(buffer, (int)buffer_size, fh) == NULL)
+    return -1;
+  buffer[strcspn(buffer, "\n")] = 0;
+  return 0;
+}
+
+/* Handles "UPDATE <file> <values>". Returns zero if the update was accepted
+ * and writes the error message to `error' otherwise. */
+static int handle_update(char const *line, char *error, size_t error_size) {
+  if (strncmp("UPDATE ", line, strlen("UPDATE ")) != 0) {
+    snprintf(error, error_size, "Unknown command: %s", line);
+    return -1;
+  }
+
+  char update[1024];
+  size_t len = 0;
+  for (char const *c = line + strlen("UPDATE "); *c != 0; c++) {
+    if ((*c == '\\') && (c[1] != 0))
+      c++;
+    if (len < sizeof(update) - 1)
+      update[len++] = *c;
+  }
+  update[len] = 0;
+
+  if (strstr(update, "missing") != NULL) {
+    /* The update is cut short if it does not fit. */
+    if (snprintf(error, error_size, "No such file: %s", update) < 0)
+      error[0] = 0;
+    return -1;
+  }
+
+  server.updates++;
+  memcpy(server.last_update, update, len + 1);
+  return 0;
+}
+
+static void handle_connection(int fd) {
+  /* A single "r+" stream can not switch between reading and writing on a
+   * socket. */
+  FILE *in = fdopen(fd, "r");
+  FILE *fh = fdopen(dup(fd), "w");
+  if ((in == NULL) || (fh == NULL)) {
+    if (in != NULL)
+      fclose(in);
+    else
+      close(fd);
+    if (fh != NULL)
+      fclose(fh);
+    return;
+  }
+
+  char line[1024];
+  char error[1024];
+  while (read_line(in, line, sizeof(line)) == 0) {
+    server.commands++;
+
+    if (strcmp("BATCH", line) == 0) {
+      fprintf(fh, "0 Go ahead.  End with dot '.' on its own line.\n");
+      fflush(fh);
+
+      char errors[4096] = "";
+      size_t errors_len = 0;
+      int errors_num = 0;
+      int command = 0;
+      while ((read_line(in, line, sizeof(line)) == 0) &&
+             (strcmp(".", line) != 0)) {
+        command++;
+        if (handle_update(line, error, sizeof(error)) != 0) {
+          errors_num++;
+          errors_len +=
+              (size_t)snprintf(errors + errors_len, sizeof(errors) - errors_len,
+                               "%d %s\n", command, error);
+        }
+      }
+      fprintf(fh, "%d errors\n%s", errors_num, errors);
+    } else if (handle_update(line, error, sizeof(error)) == 0) {
+      fprintf(fh, "0 errors, enqueued 1 value(s).\n");
+    } else {
+      fprintf(fh, "-1 %s\n", error);
+    }
+    fflush(fh);
+
+    if ((server.close_after > 0) && (server.commands >= server.close_after))
+      break;
+  }
+
+  fclose(fh);
+  fclose(in);
+}
+
+static void *server_thread(void *arg) {
+  (void)arg;
+
+  while (42) {
+    int fd = accept(server.listen_fd, NULL, NULL);
+    if (fd < 0)
+      break;
+    handle_connection(fd);
+  }
+
+  return NULL;
+}
+
+static int server_start(void) {
+  memset(&server, 0, sizeof(server));
+
+  /* File names are compared with the resolved names sent by the client. */
+  char tmpl[] = "/tmp/rrdc_batch_test.XXXXXX";
+  if ((mkdtemp(tmpl) == NULL) || (realpath(tmpl, server.dir) == NULL))
+    return -1;
+  snprintf(server.path, sizeof(server.path), "%s/rrdcached.sock", server.dir);
+
+  struct sockaddr_un sa = {.sun_family = AF_UNIX};
+  if (snprintf(sa.sun_path, sizeof(sa.sun_path), "%s", server.path) >=
+      (int)sizeof(sa.sun_path))
+    return -1;
+
+  server.listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if ((server.listen_fd < 0) ||
+      (bind(server.listen_fd, (struct sockaddr *)&sa, sizeof(sa)) != 0) ||
+      (listen(server.listen_fd, 4) != 0))
+    return -1;
+
+  return pthread_create(&server.thread, NULL, server_thread, NULL);
+}
+
+static void server_stop(void) {
+  shutdown(server.listen_fd, SHUT_RDWR);
+  close(server.listen_fd);
+  pthread_join(server.thread, NULL);
+  unlink(server.path);
+}
+
+/* Removes the server's directory and the files created in it. */
+static void server_remove(void) {
+  DIR *dh = opendir(server.dir);
+  if (dh != NULL) {
+    struct dirent *de;
+    while ((de = readdir(dh)) != NULL) {
+      if (de->d_name[0] == '.')
+        continue;
+      char path[PATH_MAX * 2];
+      snprintf(path, sizeof(path), "%s/%s", server.dir, de->d_name);
+      unlink(path);
+    }
+    closedir(dh);
+  }
+  rmdir(server.dir);
+}
+
+/* Creates the file `name' in the server's directory and returns its path. */
+static char *data_file(char const *name) {
+  static char path[PATH_MAX * 2];
+  snprintf(path, sizeof(path), "%s/%s", server.dir, name);
+
+  FILE *fh = fopen(path, "a");
+  if (fh == NULL)
+    return NULL;
+  fclose(fh);
+  return path;
+}
+
+/* Returns the update of `name' with `values', as received by the server. */
+static char *update_of(char const *name, char const *values) {
+  static char update[PATH_MAX * 2];
+  snprintf(update, sizeof(update), "%s/%s %s", server.dir, name, values);
+  return update;
+}
+
+/* The server thread updates its counters before it responds, so they can be
+ * read once rrdc_batch_send() returned. */
+DEF_TEST(batch) {
+  CHECK_ZERO(server_start());
+
+  char address[sizeof(server.path) + 8];
+  snprintf(address, sizeof(address), "unix:%s", server.path);
+
+  rrdc_batch_t *b;
+  CHECK_NOT_NULL(b = rrdc_batch_create(address, 3));
+  EXPECT_EQ_INT(0, rrdc_batch_pending(b));
+  EXPECT_EQ_UINT64(0, rrdc_batch_oldest(b));
+
+  /* Updates are buffered until the batch is full. */
+  CHECK_ZERO(rrdc_batch_add(b, data_file("a.rrd"), "1:1"));
+  CHECK_ZERO(rrdc_batch_add(b, data_file("b.rrd"), "1:2"));
+  EXPECT_EQ_INT(2, rrdc_batch_pending(b));
+  OK(rrdc_batch_oldest(b) != 0);
+  EXPECT_EQ_INT(0, server.updates);
+
+  CHECK_ZERO(rrdc_batch_add(b, data_file("with space.rrd"), "1:3"));
+  EXPECT_EQ_INT(0, rrdc_batch_pending(b));
+  EXPECT_EQ_UINT64(0, rrdc_batch_oldest(b));
+  EXPECT_EQ_INT(3, server.updates);
+  EXPECT_EQ_INT(1, server.commands);
+  EXPECT_EQ_STR(update_of("with space.rrd", "1:3"), server.last_update);
+
+  /* Rejected updates are dropped, the others are still written. */
+  CHECK_ZERO(rrdc_batch_add(b, data_file("missing.rrd"), "1:4"));
+  CHECK_ZERO(rrdc_batch_add(b, data_file("c.rrd"), "1:5"));
+  CHECK_ZERO(rrdc_batch_send(b));
+  EXPECT_EQ_INT(4, server.updates);
+  EXPECT_EQ_STR(update_of("c.rrd", "1:5"), server.last_update);
+
+  /* A single update is sent without BATCH. */
+  CHECK_ZERO(rrdc_batch_add(b, data_file("d.rrd"), "1:6"));
+  CHECK_ZERO(rrdc_batch_send(b));
+  EXPECT_EQ_INT(5, server.updates);
+  EXPECT_EQ_INT(3, server.commands);
+  CHECK_ZERO(rrdc_batch_add(b, data_file("missing.rrd"), "1:7"));
+  CHECK_ZERO(rrdc_batch_send(b));
+  EXPECT_EQ_INT(5, server.updates);
+
+  /* Sending an empty batch is a no-op. */
+  CHECK_ZERO(rrdc_batch_send(b));
+  EXPECT_EQ_INT(4, server.commands);
+
+  /* The batch is sent again if the daemon closed the connection. */
+  server.close_after = server.commands + 1;
+  CHECK_ZERO(rrdc_batch_add(b, data_file("e.rrd"), "1:8"));
+  CHECK_ZERO(rrdc_batch_send(b));
+  CHECK_ZERO(rrdc_batch_add(b, data_file("f.rrd"), "1:9"));
+  CHECK_ZERO(rrdc_batch_send(b));
+  EXPECT_EQ_INT(7, server.updates);
+  EXPECT_EQ_STR(update_of("f.rrd", "1:9"), server.last_update);
+
+  rrdc_batch_destroy(b);
+
+  /* Without a daemon, sending fails and the updates are dropped. */
+  server_stop();
+  CHECK_NOT_NULL(b = rrdc_batch_create(address, 10));
+  CHECK_ZERO(rrdc_batch_add(b, data_file("a.rrd"), "1:1"));
+  OK(rrdc_batch_send(b) != 0);
+  EXPECT_EQ_INT(0, rrdc_batch_pending(b));
+  rrdc_batch_destroy(b);
+
+  server_remove();
+  return 0;
+}
+
+/* File names are normalized like librrd's client does. */
+DEF_TEST(path) {
+  CHECK_ZERO(server_start());
+
+  rrdc_batch_t *b;
+  CHECK_NOT_NULL(b = rrdc_batch_create(server.path, 1));
+
+  /* Relative names are resolved for a local daemon ... */
+  char cwd[PATH_MAX];
+  CHECK_NOT_NULL(getcwd(cwd, sizeof(cwd)));
+  CHECK_NOT_NULL(data_file("relative.rrd"));
+  CHECK_ZERO(chdir(server.dir));
+  CHECK_ZERO(rrdc_batch_add(b, "relative.rrd", "1:1"));
+  EXPECT_EQ_STR(update_of("relative.rrd", "1:1"), server.last_update);
+  CHECK_ZERO(rrdc_batch_add(b, "./relative.rrd", "1:2"));
+  EXPECT_EQ_STR(update_of("relative.rrd", "1:2"), server.last_update);
+  CHECK_ZERO(chdir(cwd));
+
+  /* ... and have to exist. */
+  char missing[PATH_MAX * 2];
+  snprintf(missing, sizeof(missing), "%s/nonexistent.rrd", server.dir);
+  EXPECT_EQ_INT(ENOENT, rrdc_batch_add(b, missing, "1:3"));
+  EXPECT_EQ_INT(0, rrdc_batch_pending(b));
+  EXPECT_EQ_INT(2, server.updates);
+
+  rrdc_batch_destroy(b);
+  server_stop();
+  server_remove();
+
+  /* Absolute names are refused for a remote daemon. Nothing is sent before the
+   * batch is full. */
+  CHECK_NOT_NULL(b = rrdc_batch_create("localhost:42217", 10));
+  EXPECT_EQ_INT(EINVAL, rrdc_batch_add(b, "/var/lib/collectd/a.rrd", "1:1"));
+  EXPECT_EQ_INT(0, rrdc_batch_pending(b));
+  CHECK_ZERO(rrdc_batch_add(b, "example.com/load/load.rrd", "1:1"));
+  EXPECT_EQ_INT(1, rrdc_batch_pending(b));
+  rrdc_batch_destroy(b);
+
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(batch);
+  RUN_TEST(path);
+
+  END_TEST;
+}
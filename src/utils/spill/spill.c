@@ -0,0 +1,501 @@
+/**
+ * collectd - src/utils/spill/spill.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "collectd.h"
+
+#include "plugin.h"
+#include "utils/common/common.h"
+#include "utils/spill/spill.h"
+
+#include <dirent.h>
+#include <sys/uio.h>
+
+/* Segment files are named after their sequence number, e.g.
+ * "000000000000002a.spill". */
+#define SPILL_SEGMENT_SUFFIX ".spill"
+#define SPILL_POSITION_FILE "position"
+
+/* Each record is prefixed with its size and a checksum of its data, both as
+ * uint32_t in host byte order. */
+#define SPILL_HEADER_SIZE (2 * sizeof(uint32_t))
+
+typedef struct {
+  uint64_t segment;
+  uint64_t offset;
+} spill_pos_t;
+
+struct spill_queue_s {
+  char *directory;
+  uint64_t max_size;
+  uint64_t segment_size;
+
+  pthread_mutex_t lock;
+
+  /* Segments head..tail exist on disk, except for the tail segment, which is
+   * created with the first record appended to it. */
+  uint64_t head;
+  uint64_t tail;
+  int tail_fd;
+  uint64_t tail_size;
+
+  spill_pos_t committed;
+  spill_pos_t cursor;
+
+  /* Read descriptor of the segment at the cursor. */
+  int read_fd;
+  uint64_t read_segment;
+
+  uint64_t size;
+  uint64_t dropped;
+};
+
+static uint32_t spill_checksum(void const *data, size_t size) /* {{{ */
+{
+  /* 32 bit FNV-1a */
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < size; i++) {
+    hash ^= ((uint8_t const *)data)[i];
+    hash *= 16777619u;
+  }
+  return hash;
+} /* }}} uint32_t spill_checksum */
+
+static void spill_segment_path(spill_queue_t const *q, /* {{{ */
+                               uint64_t segment, char *buffer,
+                               size_t buffer_size) {
+  snprintf(buffer, buffer_size, "%s/%016" PRIx64 SPILL_SEGMENT_SUFFIX,
+           q->directory, segment);
+} /* }}} void spill_segment_path */
+
+static void spill_close_read_fd(spill_queue_t *q) /* {{{ */
+{
+  if (q->read_fd < 0)
+    return;
+
+  close(q->read_fd);
+  q->read_fd = -1;
+} /* }}} void spill_close_read_fd */
+
+/* Removes a segment file and updates the size of the queue. Does not touch
+ * `head', `committed' or `cursor'. */
+static void spill_remove_segment(spill_queue_t *q, uint64_t segment) /* {{{ */
+{
+  char path[PATH_MAX];
+  spill_segment_path(q, segment, path, sizeof(path));
+
+  if (q->read_segment == segment)
+    spill_close_read_fd(q);
+
+  if (segment == q->tail) {
+    if (q->tail_fd >= 0) {
+      close(q->tail_fd);
+      q->tail_fd = -1;
+    }
+    q->size -= q->tail_size;
+    q->tail_size = 0;
+  } else {
+    struct stat statbuf = {0};
+    if (stat(path, &statbuf) == 0)
+      q->size -= ((uint64_t)statbuf.st_size < q->size)
+                     ? (uint64_t)statbuf.st_size
+                     : q->size;
+  }
+
+  if ((unlink(path) != 0) && (errno != ENOENT))
+    WARNING("spill queue: Removing \"%s\" failed: %s", path, STRERRNO);
+} /* }}} void spill_remove_segment */
+
+/* Removes the oldest segment, which must not be the tail segment. */
+static void spill_drop_head(spill_queue_t *q) /* {{{ */
+{
+  uint64_t size = q->size;
+  spill_remove_segment(q, q->head);
+  q->dropped += size - q->size;
+  q->head++;
+
+  if (q->committed.segment < q->head)
+    q->committed = (spill_pos_t){.segment = q->head};
+  if (q->cursor.segment < q->head)
+    q->cursor = q->committed;
+} /* }}} void spill_drop_head */
+
+static int spill_scan(spill_queue_t *q) /* {{{ */
+{
+  DIR *dh = opendir(q->directory);
+  if (dh == NULL) {
+    int status = errno;
+    ERROR("spill queue: Opening directory \"%s\" failed: %s", q->directory,
+          STRERRNO);
+    return status;
+  }
+
+  bool found = false;
+  uint64_t min = 0;
+  uint64_t max = 0;
+
+  struct dirent *de;
+  while ((de = readdir(dh)) != NULL) {
+    uint64_t segment;
+    int len = 0;
+    if ((sscanf(de->d_name, "%16" SCNx64 SPILL_SEGMENT_SUFFIX "%n", &segment,
+                &len) != 1) ||
+        ((size_t)len != strlen(de->d_name)))
+      continue;
+
+    char path[PATH_MAX];
+    spill_segment_path(q, segment, path, sizeof(path));
+    struct stat statbuf = {0};
+    if (stat(path, &statbuf) != 0)
+      continue;
+    q->size += (uint64_t)statbuf.st_size;
+
+    if (!found || (segment < min))
+      min = segment;
+    if (!found || (segment > max))
+      max = segment;
+    found = true;
+  }
+  closedir(dh);
+
+  /* Never append to segments of a previous instance: their last record may
+   * be incomplete. */
+  q->head = found ? min : 0;
+  q->tail = found ? max + 1 : 0;
+  q->committed = (spill_pos_t){.segment = q->head};
+
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/" SPILL_POSITION_FILE, q->directory);
+  FILE *fh = fopen(path, "r");
+  if (fh != NULL) {
+    spill_pos_t pos = {0};
+    if ((fscanf(fh, "%" SCNu64 " %" SCNu64, &pos.segment, &pos.offset) == 2) &&
+        (pos.segment >= q->head) && (pos.segment < q->tail))
+      q->committed = pos;
+    fclose(fh);
+    unlink(path);
+  }
+  q->cursor = q->committed;
+
+  return 0;
+} /* }}} int spill_scan */
+
+spill_queue_t *spill_queue_open(char const *directory, /* {{{ */
+                                uint64_t max_size, uint64_t segment_size) {
+  if ((directory == NULL) || (segment_size == 0))
+    return NULL;
+
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/", directory);
+  if (check_create_dir(path) != 0) {
+    ERROR("spill queue: Creating directory \"%s\" failed.", directory);
+    return NULL;
+  }
+
+  spill_queue_t *q = calloc(1, sizeof(*q));
+  if (q == NULL)
+    return NULL;
+
+  q->directory = strdup(directory);
+  if (q->directory == NULL) {
+    sfree(q);
+    return NULL;
+  }
+  q->max_size = max_size;
+  q->segment_size = segment_size;
+  q->tail_fd = -1;
+  q->read_fd = -1;
+  pthread_mutex_init(&q->lock, /* attr = */ NULL);
+
+  if (spill_scan(q) != 0) {
+    spill_queue_close(q);
+    return NULL;
+  }
+
+  return q;
+} /* }}} spill_queue_t *spill_queue_open */
+
+void spill_queue_close(spill_queue_t *q) /* {{{ */
+{
+  if (q == NULL)
+    return;
+
+  if (q->tail_fd >= 0)
+    close(q->tail_fd);
+  spill_close_read_fd(q);
+
+  if ((q->committed.offset > 0) && (q->committed.segment <= q->tail)) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/" SPILL_POSITION_FILE, q->directory);
+    FILE *fh = fopen(path, "w");
+    if (fh != NULL) {
+      fprintf(fh, "%" PRIu64 " %" PRIu64 "\n", q->committed.segment,
+              q->committed.offset);
+      fclose(fh);
+    } else {
+      WARNING("spill queue: Saving the read position to \"%s\" failed: %s",
+              path, STRERRNO);
+    }
+  }
+
+  pthread_mutex_destroy(&q->lock);
+  sfree(q->directory);
+  sfree(q);
+} /* }}} void spill_queue_close */
+
+int spill_queue_append(spill_queue_t *q, void const *data, /* {{{ */
+                       size_t size) {
+  if ((q == NULL) || (data == NULL) || (size > UINT32_MAX))
+    return EINVAL;
+
+  uint64_t record_size = SPILL_HEADER_SIZE + size;
+
+  pthread_mutex_lock(&q->lock);
+
+  if (q->max_size > 0) {
+    while ((q->size + record_size > q->max_size) && (q->head < q->tail))
+      spill_drop_head(q);
+
+    if (q->size + record_size > q->max_size) {
+      q->dropped += record_size;
+      pthread_mutex_unlock(&q->lock);
+      return ENOSPC;
+    }
+  }
+
+  if ((q->tail_fd >= 0) && (q->tail_size > 0) &&
+      (q->tail_size + record_size > q->segment_size)) {
+    close(q->tail_fd);
+    q->tail_fd = -1;
+    q->tail++;
+    q->tail_size = 0;
+  }
+
+  if (q->tail_fd < 0) {
+    char path[PATH_MAX];
+    spill_segment_path(q, q->tail, path, sizeof(path));
+    q->tail_fd =
+        open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0600);
+    if (q->tail_fd < 0) {
+      int status = errno;
+      ERROR("spill queue: Creating \"%s\" failed: %s", path, STRERRNO);
+      pthread_mutex_unlock(&q->lock);
+      return status;
+    }
+  }
+
+  uint32_t header[2] = {(uint32_t)size, spill_checksum(data, size)};
+  struct iovec iov[2] = {
+      {.iov_base = header, .iov_len = sizeof(header)},
+      {.iov_base = (void *)data, .iov_len = size},
+  };
+
+  ssize_t status = writev(q->tail_fd, iov, STATIC_ARRAY_SIZE(iov));
+  if ((status < 0) || ((uint64_t)status != record_size)) {
+    int err = (status < 0) ? errno : EIO;
+    ERROR("spill queue: Writing to \"%s\" failed: %s", q->directory,
+          STRERROR(err));
+    /* Remove a partially written record. */
+    if (ftruncate(q->tail_fd, (off_t)q->tail_size) != 0) {
+      close(q->tail_fd);
+      q->tail_fd = -1;
+      q->tail++;
+      q->tail_size = 0;
+    }
+    pthread_mutex_unlock(&q->lock);
+    return err;
+  }
+
+  q->tail_size += record_size;
+  q->size += record_size;
+
+  pthread_mutex_unlock(&q->lock);
+  return 0;
+} /* }}} int spill_queue_append */
+
+/* Moves the cursor to the start of the next segment. */
+static void spill_skip_segment(spill_queue_t *q) /* {{{ */
+{
+  spill_close_read_fd(q);
+  q->cursor = (spill_pos_t){.segment = q->cursor.segment + 1};
+} /* }}} void spill_skip_segment */
+
+int spill_queue_read(spill_queue_t *q, void *buffer, /* {{{ */
+                     size_t buffer_size, size_t *ret_size) {
+  if ((q == NULL) || (buffer == NULL) || (ret_size == NULL))
+    return EINVAL;
+
+  pthread_mutex_lock(&q->lock);
+
+  while (42) {
+    if (q->cursor.segment > q->tail) {
+      pthread_mutex_unlock(&q->lock);
+      return ENOENT;
+    }
+
+    bool is_tail = (q->cursor.segment == q->tail);
+    if (is_tail && (q->cursor.offset >= q->tail_size)) {
+      pthread_mutex_unlock(&q->lock);
+      return ENOENT;
+    }
+
+    char path[PATH_MAX];
+    spill_segment_path(q, q->cursor.segment, path, sizeof(path));
+
+    if ((q->read_fd < 0) || (q->read_segment != q->cursor.segment)) {
+      spill_close_read_fd(q);
+      q->read_fd = open(path, O_RDONLY | O_CLOEXEC);
+      if (q->read_fd < 0) {
+        if (errno != ENOENT)
+          ERROR("spill queue: Opening \"%s\" failed: %s", path, STRERRNO);
+        spill_skip_segment(q);
+        continue;
+      }
+      q->read_segment = q->cursor.segment;
+    }
+
+    uint64_t segment_size = q->tail_size;
+    if (!is_tail) {
+      struct stat statbuf = {0};
+      if (fstat(q->read_fd, &statbuf) != 0) {
+        spill_skip_segment(q);
+        continue;
+      }
+      segment_size = (uint64_t)statbuf.st_size;
+    }
+
+    if (q->cursor.offset >= segment_size) {
+      spill_skip_segment(q);
+      continue;
+    }
+
+    uint32_t header[2];
+    uint64_t available = segment_size - q->cursor.offset;
+    if ((available < sizeof(header)) ||
+        (pread(q->read_fd, header, sizeof(header), (off_t)q->cursor.offset) !=
+         (ssize_t)sizeof(header)) ||
+        (header[0] > available - sizeof(header))) {
+      WARNING("spill queue: \"%s\" is truncated at offset %" PRIu64
+              ". Skipping the rest of the file.",
+              path, q->cursor.offset);
+      spill_skip_segment(q);
+      continue;
+    }
+
+    size_t size = (size_t)header[0];
+    uint64_t next = q->cursor.offset + sizeof(header) + size;
+    if (size > buffer_size) {
+      q->cursor.offset = next;
+      *ret_size = size;
+      pthread_mutex_unlock(&q->lock);
+      return EMSGSIZE;
+    }
+
+    if ((pread(q->read_fd, buffer, size,
+               (off_t)(q->cursor.offset + sizeof(header))) != (ssize_t)size) ||
+        (spill_checksum(buffer, size) != header[1])) {
+      WARNING("spill queue: \"%s\" is corrupted at offset %" PRIu64
+              ". Skipping the rest of the file.",
+              path, q->cursor.offset);
+      spill_skip_segment(q);
+      continue;
+    }
+
+    q->cursor.offset = next;
+    *ret_size = size;
+    pthread_mutex_unlock(&q->lock);
+    return 0;
+  }
+} /* }}} int spill_queue_read */
+
+void spill_queue_commit(spill_queue_t *q) /* {{{ */
+{
+  if (q == NULL)
+    return;
+
+  pthread_mutex_lock(&q->lock);
+
+  uint64_t end = (q->cursor.segment < q->tail) ? q->cursor.segment : q->tail;
+  while (q->head < end) {
+    spill_remove_segment(q, q->head);
+    q->head++;
+  }
+  q->committed = q->cursor;
+
+  /* Everything has been read: start over with an empty segment. */
+  if ((q->committed.segment >= q->tail) &&
+      (q->committed.offset >= q->tail_size)) {
+    if (q->tail_size > 0) {
+      spill_remove_segment(q, q->tail);
+      q->tail++;
+    }
+    q->head = q->tail;
+    q->committed = (spill_pos_t){.segment = q->tail};
+    q->cursor = q->committed;
+  }
+
+  pthread_mutex_unlock(&q->lock);
+} /* }}} void spill_queue_commit */
+
+void spill_queue_rewind(spill_queue_t *q) /* {{{ */
+{
+  if (q == NULL)
+    return;
+
+  pthread_mutex_lock(&q->lock);
+  q->cursor = q->committed;
+  pthread_mutex_unlock(&q->lock);
+} /* }}} void spill_queue_rewind */
+
+bool spill_queue_empty(spill_queue_t *q) /* {{{ */
+{
+  if (q == NULL)
+    return true;
+
+  pthread_mutex_lock(&q->lock);
+  bool empty =
+      (q->committed.segment >= q->tail) && (q->committed.offset >= q->tail_size);
+  pthread_mutex_unlock(&q->lock);
+  return empty;
+} /* }}} bool spill_queue_empty */
+
+uint64_t spill_queue_size(spill_queue_t *q) /* {{{ */
+{
+  if (q == NULL)
+    return 0;
+
+  pthread_mutex_lock(&q->lock);
+  uint64_t size = q->size;
+  pthread_mutex_unlock(&q->lock);
+  return size;
+} /* }}} uint64_t spill_queue_size */
+
+uint64_t spill_queue_dropped(spill_queue_t *q) /* {{{ */
+{
+  if (q == NULL)
+    return 0;
+
+  pthread_mutex_lock(&q->lock);
+  uint64_t dropped = q->dropped;
+  pthread_mutex_unlock(&q->lock);
+  return dropped;
+} /* }}} uint64_t spill_queue_dropped */
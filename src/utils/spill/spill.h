@@ -0,0 +1,120 @@
+/**
+ * collectd - src/utils/spill/spill.h
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#ifndef UTILS_SPILL_H
+#define UTILS_SPILL_H 1
+
+#include "collectd.h"
+
+/*
+ * First-in first-out queue of records stored in a directory on local disk.
+ * The queue is an append-only log split into segment files; a segment is
+ * removed once all of its records have been read and committed. If the queue
+ * exceeds its size limit, the oldest segments are removed.
+ *
+ * Records are read with a cursor: spill_queue_read() advances the cursor,
+ * spill_queue_commit() removes all records before the cursor and
+ * spill_queue_rewind() moves the cursor back to the first uncommitted record,
+ * so that records can be handed out again if processing them failed.
+ *
+ * The position of the first uncommitted record is saved when the queue is
+ * closed and restored when it is opened again. After an unclean shutdown,
+ * records of the oldest segment may be returned a second time. Data is not
+ * synced to disk explicitly.
+ *
+ * All functions are thread-safe.
+ */
+struct spill_queue_s;
+typedef struct spill_queue_s spill_queue_t;
+
+/*
+ * NAME
+ *   spill_queue_open
+ *
+ * DESCRIPTION
+ *   Opens the queue stored in `directory', creating the directory if
+ *   necessary. Records left by a previous instance are kept.
+ *
+ * PARAMETERS
+ *   `directory'     Directory holding the segment files. It must not be used
+ *                   by another queue.
+ *   `max_size'      Maximum number of bytes stored on disk. Zero means no
+ *                   limit.
+ *   `segment_size'  Size after which a new segment file is started.
+ *
+ * RETURN VALUE
+ *   The queue or NULL on error.
+ */
+spill_queue_t *spill_queue_open(char const *directory, uint64_t max_size,
+                                uint64_t segment_size);
+
+/* Saves the read position and frees the queue. Records are kept on disk. */
+void spill_queue_close(spill_queue_t *q);
+
+/*
+ * NAME
+ *   spill_queue_append
+ *
+ * DESCRIPTION
+ *   Appends a record of `size' bytes. If the queue would exceed its size
+ *   limit, the oldest segments are removed first.
+ *
+ * RETURN VALUE
+ *   Zero on success, ENOSPC if the record does not fit into the queue even
+ *   after removing old segments, or another errno value on error.
+ */
+int spill_queue_append(spill_queue_t *q, void const *data, size_t size);
+
+/*
+ * NAME
+ *   spill_queue_read
+ *
+ * DESCRIPTION
+ *   Copies the record at the cursor to `buffer' and advances the cursor.
+ *   Corrupted records are skipped together with the rest of their segment.
+ *
+ * RETURN VALUE
+ *   Zero on success, ENOENT if there are no more records, EMSGSIZE if the
+ *   record does not fit into `buffer' (the cursor is advanced anyway), or
+ *   another errno value on error. The size of the record is stored in
+ *   `ret_size' on success and for EMSGSIZE.
+ */
+int spill_queue_read(spill_queue_t *q, void *buffer, size_t buffer_size,
+                     size_t *ret_size);
+
+/* Removes all records before the cursor. */
+void spill_queue_commit(spill_queue_t *q);
+
+/* Moves the cursor back to the first uncommitted record. */
+void spill_queue_rewind(spill_queue_t *q);
+
+/* Returns true if there are no uncommitted records. */
+bool spill_queue_empty(spill_queue_t *q);
+
+/* Returns the number of bytes stored on disk. */
+uint64_t spill_queue_size(spill_queue_t *q);
+
+/* Returns the number of bytes removed because of the size limit. */
+uint64_t spill_queue_dropped(spill_queue_t *q);
+
+#endif /* UTILS_SPILL_H */
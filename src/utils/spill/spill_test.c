@@ -0,0 +1,246 @@
+/**
+ * collectd - src/utils/spill/spill_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "testing.h"
+#include "utils/spill/spill.h"
+
+#include <dirent.h>
+
+/* Each record is "record <n>" with an 8 byte header. */
+#define RECORD_SIZE(n) (8 + strlen("record ") + (((n) < 10) ? 1 : 2))
+
+static char directory[] = "/tmp/spill_test.XXXXXX";
+
+static int append(spill_queue_t *q, int n) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "record %d", n);
+  return spill_queue_append(q, buffer, strlen(buffer));
+}
+
+/* Reads the next record and returns its number, or -1 if there is none. */
+static int read_record(spill_queue_t *q) {
+  char buffer[32] = {0};
+  size_t size = 0;
+  if (spill_queue_read(q, buffer, sizeof(buffer) - 1, &size) != 0)
+    return -1;
+  buffer[size] = 0;
+
+  int n = -1;
+  if (sscanf(buffer, "record %d", &n) != 1)
+    return -1;
+  return n;
+}
+
+static int count_files(void) {
+  DIR *dh = opendir(directory);
+  if (dh == NULL)
+    return -1;
+
+  int num = 0;
+  struct dirent *de;
+  while ((de = readdir(dh)) != NULL) {
+    if (de->d_name[0] != '.')
+      num++;
+  }
+  closedir(dh);
+  return num;
+}
+
+static void remove_files(void) {
+  DIR *dh = opendir(directory);
+  if (dh == NULL)
+    return;
+
+  struct dirent *de;
+  while ((de = readdir(dh)) != NULL) {
+    if (de->d_name[0] == '.')
+      continue;
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", directory, de->d_name);
+    unlink(path);
+  }
+  closedir(dh);
+}
+
+DEF_TEST(fifo) {
+  spill_queue_t *q;
+  CHECK_NOT_NULL(q = spill_queue_open(directory, 0, 1024));
+  OK(spill_queue_empty(q));
+  EXPECT_EQ_INT(-1, read_record(q));
+
+  for (int i = 0; i < 3; i++)
+    CHECK_ZERO(append(q, i));
+  OK(!spill_queue_empty(q));
+  EXPECT_EQ_UINT64(3 * RECORD_SIZE(0), spill_queue_size(q));
+
+  /* Records read without committing them are returned again. */
+  EXPECT_EQ_INT(0, read_record(q));
+  EXPECT_EQ_INT(1, read_record(q));
+  spill_queue_rewind(q);
+  EXPECT_EQ_INT(0, read_record(q));
+  spill_queue_commit(q);
+  OK(!spill_queue_empty(q));
+
+  /* Records can be appended while others are being read. */
+  CHECK_ZERO(append(q, 3));
+  EXPECT_EQ_INT(1, read_record(q));
+  EXPECT_EQ_INT(2, read_record(q));
+  EXPECT_EQ_INT(3, read_record(q));
+  EXPECT_EQ_INT(-1, read_record(q));
+  spill_queue_commit(q);
+
+  /* Once everything has been committed, the segment is removed. */
+  OK(spill_queue_empty(q));
+  EXPECT_EQ_UINT64(0, spill_queue_size(q));
+  EXPECT_EQ_INT(0, count_files());
+
+  /* A record larger than the buffer is reported and skipped. */
+  char large[64];
+  memset(large, 'x', sizeof(large));
+  CHECK_ZERO(spill_queue_append(q, large, sizeof(large)));
+  CHECK_ZERO(append(q, 4));
+  char buffer[32];
+  size_t size = 0;
+  EXPECT_EQ_INT(EMSGSIZE, spill_queue_read(q, buffer, sizeof(buffer), &size));
+  EXPECT_EQ_INT(sizeof(large), size);
+  EXPECT_EQ_INT(4, read_record(q));
+  spill_queue_commit(q);
+  OK(spill_queue_empty(q));
+
+  spill_queue_close(q);
+  remove_files();
+  return 0;
+}
+
+DEF_TEST(segments) {
+  spill_queue_t *q;
+  /* Four records per segment, at most three segments. */
+  CHECK_NOT_NULL(q = spill_queue_open(directory, 12 * RECORD_SIZE(10),
+                                      4 * RECORD_SIZE(10)));
+
+  for (int i = 10; i < 22; i++)
+    CHECK_ZERO(append(q, i));
+  EXPECT_EQ_INT(3, count_files());
+  EXPECT_EQ_UINT64(0, spill_queue_dropped(q));
+
+  /* Reading the first segment completely removes it on commit. */
+  for (int i = 10; i < 15; i++)
+    EXPECT_EQ_INT(i, read_record(q));
+  spill_queue_commit(q);
+  EXPECT_EQ_INT(2, count_files());
+
+  /* Exceeding the size limit removes the oldest segment, including records
+   * that have been read but not committed. */
+  for (int i = 22; i < 30; i++)
+    CHECK_ZERO(append(q, i));
+  EXPECT_EQ_INT(3, count_files());
+  EXPECT_EQ_UINT64(4 * RECORD_SIZE(10), spill_queue_dropped(q));
+  OK(spill_queue_size(q) <= 12 * RECORD_SIZE(10));
+
+  spill_queue_rewind(q);
+  for (int i = 18; i < 30; i++)
+    EXPECT_EQ_INT(i, read_record(q));
+  EXPECT_EQ_INT(-1, read_record(q));
+  spill_queue_commit(q);
+  OK(spill_queue_empty(q));
+  EXPECT_EQ_INT(0, count_files());
+
+  /* A record that is larger than the limit is rejected. */
+  char large[256] = {0};
+  EXPECT_EQ_INT(ENOSPC, spill_queue_append(q, large, sizeof(large)));
+
+  spill_queue_close(q);
+  remove_files();
+  return 0;
+}
+
+DEF_TEST(reopen) {
+  spill_queue_t *q;
+  CHECK_NOT_NULL(q = spill_queue_open(directory, 0, 1024));
+  for (int i = 0; i < 5; i++)
+    CHECK_ZERO(append(q, i));
+  EXPECT_EQ_INT(0, read_record(q));
+  EXPECT_EQ_INT(1, read_record(q));
+  spill_queue_commit(q);
+  EXPECT_EQ_INT(2, read_record(q));
+  spill_queue_close(q);
+
+  /* Uncommitted records are returned after reopening the queue and new
+   * records are appended after the old ones. */
+  CHECK_NOT_NULL(q = spill_queue_open(directory, 0, 1024));
+  OK(!spill_queue_empty(q));
+  CHECK_ZERO(append(q, 5));
+  for (int i = 2; i < 6; i++)
+    EXPECT_EQ_INT(i, read_record(q));
+  EXPECT_EQ_INT(-1, read_record(q));
+  spill_queue_commit(q);
+  OK(spill_queue_empty(q));
+  spill_queue_close(q);
+
+  EXPECT_EQ_INT(0, count_files());
+  return 0;
+}
+
+DEF_TEST(corruption) {
+  spill_queue_t *q;
+  CHECK_NOT_NULL(q = spill_queue_open(directory, 0, 3 * RECORD_SIZE(0)));
+  for (int i = 0; i < 6; i++)
+    CHECK_ZERO(append(q, i));
+  spill_queue_close(q);
+
+  /* Damage the second record of the first segment. */
+  char path[PATH_MAX];
+  snprintf(path, sizeof(path), "%s/%016x.spill", directory, 0);
+  int fd = open(path, O_WRONLY);
+  OK(fd >= 0);
+  EXPECT_EQ_INT(1, (int)pwrite(fd, "X", 1, (off_t)(2 * RECORD_SIZE(0) - 1)));
+  close(fd);
+
+  /* The rest of the damaged segment is skipped. */
+  CHECK_NOT_NULL(q = spill_queue_open(directory, 0, 3 * RECORD_SIZE(0)));
+  EXPECT_EQ_INT(0, read_record(q));
+  for (int i = 3; i < 6; i++)
+    EXPECT_EQ_INT(i, read_record(q));
+  EXPECT_EQ_INT(-1, read_record(q));
+  spill_queue_commit(q);
+  OK(spill_queue_empty(q));
+  spill_queue_close(q);
+
+  EXPECT_EQ_INT(0, count_files());
+  return 0;
+}
+
+int main(void) {
+  if (mkdtemp(directory) == NULL)
+    return 1;
+
+  RUN_TEST(fifo);
+  RUN_TEST(segments);
+  RUN_TEST(reopen);
+  RUN_TEST(corruption);
+
+  remove_files();
+  rmdir(directory);
+
+  END_TEST;
+}
@@ -53,6 +53,8 @@
 #include "utils_complain.h"
 
 #include <netdb.h>
+#include <poll.h>
+#include <sys/uio.h>
 
 #ifndef WG_DEFAULT_NODE
 #define WG_DEFAULT_NODE "localhost"
@@ -74,6 +76,10 @@
 #define WG_DEFAULT_ESCAPE '_'
 #endif
 
+#ifndef WG_DEFAULT_QUEUE_LIMIT
+#define WG_DEFAULT_QUEUE_LIMIT 64
+#endif
+
 /* Ethernet - (IPv6 + TCP) = 1500 - (40 + 32) = 1428 */
 #ifndef WG_SEND_BUF_SIZE
 #define WG_SEND_BUF_SIZE 1428
@@ -83,10 +89,30 @@
 #define WG_MIN_RECONNECT_INTERVAL TIME_T_TO_CDTIME_T(1)
 #endif
 
+#ifndef WG_DEFAULT_MAX_RECONNECT_INTERVAL
+#define WG_DEFAULT_MAX_RECONNECT_INTERVAL TIME_T_TO_CDTIME_T(60)
+#endif
+
+/* Maximum number of buffers passed to a single writev(2) call. */
+#ifndef WG_MAX_IOV
+#define WG_MAX_IOV 64
+#endif
+
+/* Time to wait for a stalled connection before giving up on shutdown. */
+#ifndef WG_SHUTDOWN_TIMEOUT_MS
+#define WG_SHUTDOWN_TIMEOUT_MS 1000
+#endif
+
 /*
  * Private variables
  */
+typedef struct {
+  char data[WG_SEND_BUF_SIZE];
+  size_t fill;
+} wg_buffer_t;
+
 struct wg_callback {
+  /* Only used by the sender thread. */
   int sock_fd;
 
   char *name;
@@ -98,125 +124,62 @@ struct wg_callback {
   char *prefix;
   char *postfix;
   char escape_char;
+  bool collect_stats;
 
   unsigned int format_flags;
 
-  char send_buf[WG_SEND_BUF_SIZE];
-  size_t send_buf_free;
-  size_t send_buf_fill;
+  /* Ring of send buffers. Writers append to ring[ring_head]; a full or
+   * flushed buffer is handed to the sender thread by advancing ring_head.
+   * The sender thread writes the buffers from ring_tail up to, but not
+   * including, ring_head. ring_offset bytes of ring[ring_tail] have already
+   * been sent. The ring has one more buffer than "QueueLimit". */
+  wg_buffer_t *ring;
+  size_t ring_size;
+  size_t ring_head;
+  size_t ring_tail;
+  size_t ring_offset;
+  int queue_limit;
   cdtime_t send_buf_init_time;
 
   pthread_mutex_t send_lock;
+  pthread_cond_t send_cond;
+  pthread_t sender;
+  bool sender_running;
+  bool shutdown;
+
+  /* Set while connecting fails. Writes are rejected until the sender thread
+   * has reconnected. */
+  bool down;
   c_complain_t init_complaint;
+  c_complain_t queue_complaint;
   cdtime_t last_connect_time;
+  cdtime_t next_connect_time;
+  cdtime_t reconnect_delay;
+  cdtime_t max_reconnect_delay;
 
   /* Force reconnect useful for load balanced environments */
   cdtime_t last_reconnect_time;
   cdtime_t reconnect_interval;
-  bool reconnect_interval_reached;
-};
-
-/* wg_force_reconnect_check closes cb->sock_fd when it was open for longer
- * than cb->reconnect_interval. Must hold cb->send_lock when calling. */
-static void wg_force_reconnect_check(struct wg_callback *cb) {
-  cdtime_t now;
-
-  if (cb->reconnect_interval == 0)
-    return;
 
-  /* check if address changes if addr_timeout */
-  now = cdtime();
-  if ((now - cb->last_reconnect_time) < cb->reconnect_interval)
-    return;
-
-  /* here we should close connection on next */
-  close(cb->sock_fd);
-  cb->sock_fd = -1;
-  cb->last_reconnect_time = now;
-  cb->reconnect_interval_reached = true;
-
-  INFO("write_graphite plugin: Connection closed after %.3f seconds.",
-       CDTIME_T_TO_DOUBLE(now - cb->last_reconnect_time));
-}
+  uint64_t bytes_sent;
+  uint64_t dropped;
+};
 
 /*
  * Functions
  */
-static void wg_reset_buffer(struct wg_callback *cb) {
-  memset(cb->send_buf, 0, sizeof(cb->send_buf));
-  cb->send_buf_free = sizeof(cb->send_buf);
-  cb->send_buf_fill = 0;
-  cb->send_buf_init_time = cdtime();
-}
-
-static int wg_send_buffer(struct wg_callback *cb) {
-  ssize_t status;
-
-  if (cb->sock_fd < 0)
-    return -1;
-
-  status = swrite(cb->sock_fd, cb->send_buf, strlen(cb->send_buf));
-  if (status != 0) {
-    if (cb->log_send_errors) {
-      ERROR("write_graphite plugin: send to %s:%s (%s) failed with status %zi "
-            "(%s)",
-            cb->node, cb->service, cb->protocol, status, STRERRNO);
-    }
-
-    close(cb->sock_fd);
-    cb->sock_fd = -1;
-
-    return -1;
-  }
-
-  return 0;
+static bool wg_is_udp(struct wg_callback const *cb) {
+  return strcasecmp("udp", cb->protocol) == 0;
 }
 
-/* NOTE: You must hold cb->send_lock when calling this function! */
-static int wg_flush_nolock(cdtime_t timeout, struct wg_callback *cb) {
-  int status;
-
-  DEBUG("write_graphite plugin: wg_flush_nolock: timeout = %.3f; "
-        "send_buf_fill = %" PRIsz ";",
-        (double)timeout, cb->send_buf_fill);
-
-  /* timeout == 0  => flush unconditionally */
-  if (timeout > 0) {
-    cdtime_t now;
-
-    now = cdtime();
-    if ((cb->send_buf_init_time + timeout) > now)
-      return 0;
-  }
-
-  if (cb->send_buf_fill == 0) {
-    cb->send_buf_init_time = cdtime();
-    return 0;
-  }
-
-  status = wg_send_buffer(cb);
-  wg_reset_buffer(cb);
-
-  return status;
-}
-
-static int wg_callback_init(struct wg_callback *cb) {
+/* Opens cb->sock_fd. Called by the sender thread without holding
+ * cb->send_lock. */
+static int wg_connect(struct wg_callback *cb) {
   struct addrinfo *ai_list;
-  cdtime_t now;
   int status;
 
   char connerr[1024] = "";
 
-  if (cb->sock_fd > 0)
-    return 0;
-
-  /* Don't try to reconnect too often. By default, one reconnection attempt
-   * is made per second. */
-  now = cdtime();
-  if ((now - cb->last_connect_time) < WG_MIN_RECONNECT_INTERVAL)
-    return EAGAIN;
-  cb->last_connect_time = now;
-
   struct addrinfo ai_hints = {.ai_family = AF_UNSPEC,
                               .ai_flags = AI_ADDRCONFIG};
 
@@ -227,8 +190,9 @@ static int wg_callback_init(struct wg_callback *cb) {
 
   status = getaddrinfo(cb->node, cb->service, &ai_hints, &ai_list);
   if (status != 0) {
-    ERROR("write_graphite plugin: getaddrinfo (%s, %s, %s) failed: %s",
-          cb->node, cb->service, cb->protocol, gai_strerror(status));
+    c_complain(LOG_ERR, &cb->init_complaint,
+               "write_graphite plugin: getaddrinfo (%s, %s, %s) failed: %s",
+               cb->node, cb->service, cb->protocol, gai_strerror(status));
     return -1;
   }
 
@@ -264,19 +228,277 @@ static int wg_callback_init(struct wg_callback *cb) {
                "The last error was: %s",
                cb->node, cb->service, cb->protocol, connerr);
     return -1;
-  } else {
-    c_release(LOG_INFO, &cb->init_complaint,
-              "write_graphite plugin: Successfully connected to %s:%s via %s.",
-              cb->node, cb->service, cb->protocol);
   }
 
-  /* wg_force_reconnect_check does not flush the buffer before closing a
-   * sending socket, so only call wg_reset_buffer() if the socket was closed
-   * for a different reason (tracked in cb->reconnect_interval_reached). */
-  if (!cb->reconnect_interval_reached || (cb->send_buf_free == 0))
-    wg_reset_buffer(cb);
-  else
-    cb->reconnect_interval_reached = false;
+  c_release(LOG_INFO, &cb->init_complaint,
+            "write_graphite plugin: Successfully connected to %s:%s via %s.",
+            cb->node, cb->service, cb->protocol);
+
+  /* A slow server must not keep the sender thread from noticing a
+   * shutdown. */
+  int flags = fcntl(cb->sock_fd, F_GETFL);
+  if (flags != -1)
+    fcntl(cb->sock_fd, F_SETFL, flags | O_NONBLOCK);
+
+  return 0;
+}
+
+static void wg_disconnect(struct wg_callback *cb) {
+  if (cb->sock_fd < 0)
+    return;
+
+  close(cb->sock_fd);
+  cb->sock_fd = -1;
+}
+
+/* Removes `len' sent bytes from the ring. Must hold cb->send_lock when
+ * calling. */
+static void wg_ring_consume_nolock(struct wg_callback *cb, size_t len) {
+  cb->bytes_sent += len;
+
+  while ((len > 0) && (cb->ring_tail != cb->ring_head)) {
+    size_t avail = cb->ring[cb->ring_tail].fill - cb->ring_offset;
+    if (len < avail) {
+      cb->ring_offset += len;
+      return;
+    }
+
+    len -= avail;
+    cb->ring_tail = (cb->ring_tail + 1) % cb->ring_size;
+    cb->ring_offset = 0;
+  }
+}
+
+/* Drops the buffer at the tail of the ring, e.g. when it has only been sent
+ * partially, and counts the lines that have not been sent completely. Must
+ * hold cb->send_lock when calling. */
+static void wg_ring_drop_tail_nolock(struct wg_callback *cb) {
+  if (cb->ring_tail == cb->ring_head)
+    return;
+
+  wg_buffer_t *buf = cb->ring + cb->ring_tail;
+  for (size_t i = cb->ring_offset; i < buf->fill; i++) {
+    if (buf->data[i] == '\n')
+      cb->dropped++;
+  }
+
+  cb->ring_tail = (cb->ring_tail + 1) % cb->ring_size;
+  cb->ring_offset = 0;
+}
+
+/* Connects cb->sock_fd, backing off exponentially while connecting fails.
+ * Must hold cb->send_lock when calling; the lock is released while
+ * connecting and waiting. Returns zero if the socket is connected. */
+static int wg_sender_connect_nolock(struct wg_callback *cb) {
+  cdtime_t now = cdtime();
+  if (now < cb->next_connect_time) {
+    struct timespec ts = CDTIME_T_TO_TIMESPEC(cb->next_connect_time);
+    pthread_cond_timedwait(&cb->send_cond, &cb->send_lock, &ts);
+    return EAGAIN;
+  }
+
+  cb->last_connect_time = now;
+  pthread_mutex_unlock(&cb->send_lock);
+  int status = wg_connect(cb);
+  pthread_mutex_lock(&cb->send_lock);
+
+  if (status != 0) {
+    cb->down = true;
+    cb->next_connect_time = cdtime() + cb->reconnect_delay;
+    cb->reconnect_delay *= 2;
+    if (cb->reconnect_delay > cb->max_reconnect_delay)
+      cb->reconnect_delay = cb->max_reconnect_delay;
+    return status;
+  }
+
+  cb->down = false;
+  cb->reconnect_delay = WG_MIN_RECONNECT_INTERVAL;
+  cb->last_reconnect_time = cdtime();
+  return 0;
+}
+
+/* Writes as many queued buffers as possible with a single writev(2) call.
+ * Must hold cb->send_lock when calling; the lock is released while sending.
+ * The buffers between ring_tail and ring_head are not modified by writers,
+ * so they can be sent without holding the lock. */
+static void wg_sender_send_nolock(struct wg_callback *cb) {
+  struct iovec iov[WG_MAX_IOV];
+  int iov_num = 0;
+
+  for (size_t i = cb->ring_tail; (i != cb->ring_head) && (iov_num < WG_MAX_IOV);
+       i = (i + 1) % cb->ring_size) {
+    iov[iov_num] = (struct iovec){
+        .iov_base = cb->ring[i].data,
+        .iov_len = cb->ring[i].fill,
+    };
+    iov_num++;
+
+    /* Each buffer is sent as one datagram. */
+    if (wg_is_udp(cb))
+      break;
+  }
+  iov[0].iov_base = (char *)iov[0].iov_base + cb->ring_offset;
+  iov[0].iov_len -= cb->ring_offset;
+
+  bool shutdown = cb->shutdown;
+  pthread_mutex_unlock(&cb->send_lock);
+
+  ssize_t status = writev(cb->sock_fd, iov, iov_num);
+  int errno_save = errno;
+  if ((status < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK))) {
+    struct pollfd pfd = {.fd = cb->sock_fd, .events = POLLOUT};
+    int timeout = shutdown ? WG_SHUTDOWN_TIMEOUT_MS : 1000;
+    if ((poll(&pfd, 1, timeout) == 0) && shutdown) {
+      errno_save = ETIMEDOUT;
+    } else {
+      pthread_mutex_lock(&cb->send_lock);
+      return;
+    }
+  } else if ((status < 0) && (errno == EINTR)) {
+    pthread_mutex_lock(&cb->send_lock);
+    return;
+  }
+
+  if (status < 0) {
+    if (cb->log_send_errors) {
+      ERROR("write_graphite plugin: send to %s:%s (%s) failed with status %zi "
+            "(%s)",
+            cb->node, cb->service, cb->protocol, status,
+            STRERROR(errno_save));
+    }
+    wg_disconnect(cb);
+  }
+
+  pthread_mutex_lock(&cb->send_lock);
+  if (status >= 0) {
+    wg_ring_consume_nolock(cb, (size_t)status);
+    return;
+  }
+
+  /* A partially sent line must not be continued on a new connection and a
+   * datagram that failed is not retried. */
+  if ((cb->ring_offset > 0) || wg_is_udp(cb))
+    wg_ring_drop_tail_nolock(cb);
+  while (shutdown && (cb->ring_tail != cb->ring_head))
+    wg_ring_drop_tail_nolock(cb);
+  cb->next_connect_time = cb->last_connect_time + WG_MIN_RECONNECT_INTERVAL;
+}
+
+/* wg_force_reconnect_check closes cb->sock_fd when it was open for longer
+ * than cb->reconnect_interval. Called by the sender thread between two
+ * lines. */
+static void wg_force_reconnect_check(struct wg_callback *cb) {
+  cdtime_t now;
+
+  if ((cb->reconnect_interval == 0) || (cb->ring_offset > 0))
+    return;
+
+  /* check if address changes if addr_timeout */
+  now = cdtime();
+  if ((now - cb->last_reconnect_time) < cb->reconnect_interval)
+    return;
+
+  /* here we should close connection on next */
+  wg_disconnect(cb);
+  cb->next_connect_time = 0;
+
+  INFO("write_graphite plugin: Connection closed after %.3f seconds.",
+       CDTIME_T_TO_DOUBLE(now - cb->last_reconnect_time));
+}
+
+static void *wg_sender_thread(void *arg) {
+  struct wg_callback *cb = arg;
+
+  pthread_mutex_lock(&cb->send_lock);
+  while (42) {
+    bool empty = (cb->ring_tail == cb->ring_head);
+
+    /* While down, keep probing the server so that writes are accepted
+     * again as soon as it is back. */
+    if ((cb->sock_fd < 0) && (!empty || cb->down) &&
+        !(cb->shutdown && cb->down)) {
+      if (wg_sender_connect_nolock(cb) != 0)
+        continue;
+      empty = (cb->ring_tail == cb->ring_head);
+    }
+
+    if (empty) {
+      if (cb->shutdown)
+        break;
+      pthread_cond_wait(&cb->send_cond, &cb->send_lock);
+      continue;
+    }
+
+    if (cb->sock_fd < 0) {
+      /* Shutting down without a connection. */
+      while (cb->ring_tail != cb->ring_head)
+        wg_ring_drop_tail_nolock(cb);
+      break;
+    }
+
+    wg_force_reconnect_check(cb);
+    if (cb->sock_fd < 0)
+      continue;
+
+    wg_sender_send_nolock(cb);
+  }
+  pthread_mutex_unlock(&cb->send_lock);
+
+  wg_disconnect(cb);
+  return NULL;
+}
+
+/* Starts the sender thread. Must hold cb->send_lock when calling. */
+static int wg_callback_init(struct wg_callback *cb) {
+  if (cb->sender_running)
+    return 0;
+
+  int status =
+      plugin_thread_create(&cb->sender, wg_sender_thread, cb, "wg send");
+  if (status != 0) {
+    ERROR("write_graphite plugin: Starting the sender thread failed: %s",
+          STRERROR(status));
+    return -1;
+  }
+  cb->sender_running = true;
+
+  return 0;
+}
+
+/* Hands the buffer being filled to the sender thread. Must hold
+ * cb->send_lock when calling. */
+static int wg_flush_nolock(cdtime_t timeout, struct wg_callback *cb) {
+  wg_buffer_t *buf = cb->ring + cb->ring_head;
+
+  DEBUG("write_graphite plugin: wg_flush_nolock: timeout = %.3f; "
+        "send_buf_fill = %" PRIsz ";",
+        (double)timeout, buf->fill);
+
+  /* timeout == 0  => flush unconditionally */
+  if (timeout > 0) {
+    cdtime_t now;
+
+    now = cdtime();
+    if ((cb->send_buf_init_time + timeout) > now)
+      return 0;
+  }
+
+  if (buf->fill == 0) {
+    cb->send_buf_init_time = cdtime();
+    return 0;
+  }
+
+  size_t next = (cb->ring_head + 1) % cb->ring_size;
+  if (next == cb->ring_tail)
+    return ENOBUFS;
+  c_release(LOG_INFO, &cb->queue_complaint,
+            "write_graphite plugin: The queue of %s:%s is no longer full.",
+            cb->node, cb->service);
+
+  cb->ring_head = next;
+  cb->ring[next].fill = 0;
+  cb->send_buf_init_time = cdtime();
+  pthread_cond_signal(&cb->send_cond);
 
   return 0;
 }
@@ -289,15 +511,23 @@ static void wg_callback_free(void *data) {
 
   cb = data;
 
-  pthread_mutex_lock(&cb->send_lock);
+  if (cb->sender_running) {
+    pthread_mutex_lock(&cb->send_lock);
+    wg_flush_nolock(/* timeout = */ 0, cb);
 
-  wg_flush_nolock(/* timeout = */ 0, cb);
+    /* The sender thread sends everything that has been queued before it
+     * exits. */
+    cb->shutdown = true;
+    pthread_cond_broadcast(&cb->send_cond);
+    pthread_mutex_unlock(&cb->send_lock);
 
-  if (cb->sock_fd >= 0) {
-    close(cb->sock_fd);
-    cb->sock_fd = -1;
+    pthread_join(cb->sender, NULL);
+    cb->sender_running = false;
   }
 
+  wg_disconnect(cb);
+
+  sfree(cb->ring);
   sfree(cb->name);
   sfree(cb->node);
   sfree(cb->protocol);
@@ -305,7 +535,7 @@ static void wg_callback_free(void *data) {
   sfree(cb->prefix);
   sfree(cb->postfix);
 
-  pthread_mutex_unlock(&cb->send_lock);
+  pthread_cond_destroy(&cb->send_cond);
   pthread_mutex_destroy(&cb->send_lock);
 
   sfree(cb);
@@ -324,13 +554,11 @@ static int wg_flush(cdtime_t timeout,
 
   pthread_mutex_lock(&cb->send_lock);
 
-  if (cb->sock_fd < 0) {
-    status = wg_callback_init(cb);
-    if (status != 0) {
-      /* An error message has already been printed. */
-      pthread_mutex_unlock(&cb->send_lock);
-      return -1;
-    }
+  status = wg_callback_init(cb);
+  if (status != 0) {
+    /* An error message has already been printed. */
+    pthread_mutex_unlock(&cb->send_lock);
+    return -1;
   }
 
   status = wg_flush_nolock(timeout, cb);
@@ -339,56 +567,58 @@ static int wg_flush(cdtime_t timeout,
   return status;
 }
 
-static int wg_send_message(char const *message, struct wg_callback *cb) {
+/* NOTE: You must hold cb->send_lock when calling this function! */
+static int wg_send_message_nolock(char const *message,
+                                  struct wg_callback *cb) {
   int status;
   size_t message_len;
 
   message_len = strlen(message);
 
-  pthread_mutex_lock(&cb->send_lock);
-
-  wg_force_reconnect_check(cb);
-
-  if (cb->sock_fd < 0) {
-    status = wg_callback_init(cb);
-    if (status != 0) {
-      /* An error message has already been printed. */
-      pthread_mutex_unlock(&cb->send_lock);
-      return -1;
-    }
+  status = wg_callback_init(cb);
+  if (status != 0) {
+    /* An error message has already been printed. */
+    return -1;
   }
 
-  if (message_len >= cb->send_buf_free) {
+  /* The sender thread can not connect to the server. Fail, so that the
+   * daemon can handle the values, e.g. by spilling them to disk. */
+  if (cb->down)
+    return -1;
+
+  wg_buffer_t *buf = cb->ring + cb->ring_head;
+  if (message_len > sizeof(buf->data) - buf->fill) {
     status = wg_flush_nolock(/* timeout = */ 0, cb);
     if (status != 0) {
-      pthread_mutex_unlock(&cb->send_lock);
+      cb->dropped++;
+      c_complain(LOG_WARNING, &cb->queue_complaint,
+                 "write_graphite plugin: The queue of %s:%s is full, "
+                 "dropping values. %" PRIu64 " lines have been dropped so "
+                 "far.",
+                 cb->node, cb->service, cb->dropped);
       return status;
     }
+    buf = cb->ring + cb->ring_head;
   }
 
   /* Assert that we have enough space for this message. */
-  assert(message_len < cb->send_buf_free);
+  assert(message_len <= sizeof(buf->data) - buf->fill);
 
-  /* `message_len + 1' because `message_len' does not include the
-   * trailing null byte. Neither does `send_buffer_fill'. */
-  memcpy(cb->send_buf + cb->send_buf_fill, message, message_len + 1);
-  cb->send_buf_fill += message_len;
-  cb->send_buf_free -= message_len;
+  memcpy(buf->data + buf->fill, message, message_len);
+  buf->fill += message_len;
 
   DEBUG("write_graphite plugin: [%s]:%s (%s) buf %" PRIsz "/%" PRIsz
         " (%.1f %%) \"%s\"",
-        cb->node, cb->service, cb->protocol, cb->send_buf_fill,
-        sizeof(cb->send_buf),
-        100.0 * ((double)cb->send_buf_fill) / ((double)sizeof(cb->send_buf)),
-        message);
-
-  pthread_mutex_unlock(&cb->send_lock);
+        cb->node, cb->service, cb->protocol, buf->fill, sizeof(buf->data),
+        100.0 * ((double)buf->fill) / ((double)sizeof(buf->data)), message);
 
   return 0;
 }
 
-static int wg_write_messages(const data_set_t *ds, const value_list_t *vl,
-                             struct wg_callback *cb) {
+/* NOTE: You must hold cb->send_lock when calling this function! */
+static int wg_write_messages_nolock(const data_set_t *ds,
+                                    const value_list_t *vl,
+                                    struct wg_callback *cb) {
   char buffer[WG_SEND_BUF_SIZE] = {0};
   int status;
 
@@ -404,28 +634,69 @@ static int wg_write_messages(const data_set_t *ds, const value_list_t *vl,
     return status;
 
   /* Send the message to graphite */
-  status = wg_send_message(buffer, cb);
+  status = wg_send_message_nolock(buffer, cb);
   if (status != 0) /* error message has been printed already. */
     return status;
 
   return 0;
-} /* int wg_write_messages */
+} /* int wg_write_messages_nolock */
 
-static int wg_write(const data_set_t *ds, const value_list_t *vl,
-                    user_data_t *user_data) {
+static int wg_write_batch(const data_set_t *const *ds,
+                          const value_list_t *const *vl, size_t num,
+                          user_data_t *user_data) {
   struct wg_callback *cb;
-  int status;
+  int status = 0;
 
   if (user_data == NULL)
     return EINVAL;
 
   cb = user_data->data;
 
-  status = wg_write_messages(ds, vl, cb);
+  /* Format the whole batch into the send buffer under a single lock. */
+  pthread_mutex_lock(&cb->send_lock);
+  for (size_t i = 0; i < num; i++) {
+    int tmp = wg_write_messages_nolock(ds[i], vl[i], cb);
+    if (tmp != 0)
+      status = tmp;
+  }
+  pthread_mutex_unlock(&cb->send_lock);
 
   return status;
 }
 
+static int wg_read(user_data_t *user_data) {
+  struct wg_callback *cb = user_data->data;
+
+  pthread_mutex_lock(&cb->send_lock);
+  size_t queue_length =
+      (cb->ring_head + cb->ring_size - cb->ring_tail) % cb->ring_size;
+  uint64_t bytes_sent = cb->bytes_sent;
+  uint64_t dropped = cb->dropped;
+  pthread_mutex_unlock(&cb->send_lock);
+
+  value_list_t vl = VALUE_LIST_INIT;
+  vl.values = &(value_t){.gauge = (gauge_t)queue_length};
+  vl.values_len = 1;
+  sstrncpy(vl.plugin, "write_graphite", sizeof(vl.plugin));
+  sstrncpy(vl.plugin_instance, (cb->name != NULL) ? cb->name : cb->node,
+           sizeof(vl.plugin_instance));
+
+  sstrncpy(vl.type, "queue_length", sizeof(vl.type));
+  plugin_dispatch_values(&vl);
+
+  vl.values[0].derive = (derive_t)bytes_sent;
+  sstrncpy(vl.type, "total_bytes", sizeof(vl.type));
+  sstrncpy(vl.type_instance, "sent", sizeof(vl.type_instance));
+  plugin_dispatch_values(&vl);
+
+  vl.values[0].derive = (derive_t)dropped;
+  sstrncpy(vl.type, "derive", sizeof(vl.type));
+  sstrncpy(vl.type_instance, "dropped", sizeof(vl.type_instance));
+  plugin_dispatch_values(&vl);
+
+  return 0;
+}
+
 static int config_set_char(char *dest, oconfig_item_t *ci) {
   char buffer[4] = {0};
   int status;
@@ -468,7 +739,9 @@ static int wg_config_node(oconfig_item_t *ci) {
   cb->protocol = strdup(WG_DEFAULT_PROTOCOL);
   cb->last_reconnect_time = cdtime();
   cb->reconnect_interval = 0;
-  cb->reconnect_interval_reached = false;
+  cb->reconnect_delay = WG_MIN_RECONNECT_INTERVAL;
+  cb->max_reconnect_delay = WG_DEFAULT_MAX_RECONNECT_INTERVAL;
+  cb->queue_limit = WG_DEFAULT_QUEUE_LIMIT;
   cb->log_send_errors = WG_DEFAULT_LOG_SEND_ERRORS;
   cb->prefix = NULL;
   cb->postfix = NULL;
@@ -485,7 +758,9 @@ static int wg_config_node(oconfig_item_t *ci) {
   }
 
   pthread_mutex_init(&cb->send_lock, /* attr = */ NULL);
+  pthread_cond_init(&cb->send_cond, /* attr = */ NULL);
   C_COMPLAIN_INIT(&cb->init_complaint);
+  C_COMPLAIN_INIT(&cb->queue_complaint);
 
   for (int i = 0; i < ci->children_num; i++) {
     oconfig_item_t *child = ci->children + i;
@@ -504,6 +779,22 @@ static int wg_config_node(oconfig_item_t *ci) {
       }
     } else if (strcasecmp("ReconnectInterval", child->key) == 0)
       cf_util_get_cdtime(child, &cb->reconnect_interval);
+    else if (strcasecmp("MaxReconnectInterval", child->key) == 0) {
+      status = cf_util_get_cdtime(child, &cb->max_reconnect_delay);
+      if ((status == 0) &&
+          (cb->max_reconnect_delay < WG_MIN_RECONNECT_INTERVAL)) {
+        WARNING("write_graphite plugin: MaxReconnectInterval must be at "
+                "least one second.");
+        cb->max_reconnect_delay = WG_MIN_RECONNECT_INTERVAL;
+      }
+    } else if (strcasecmp("QueueLimit", child->key) == 0) {
+      status = cf_util_get_int(child, &cb->queue_limit);
+      if ((status == 0) && (cb->queue_limit < 1)) {
+        ERROR("write_graphite plugin: QueueLimit must be positive.");
+        status = -1;
+      }
+    } else if (strcasecmp("CollectStatistics", child->key) == 0)
+      cf_util_get_boolean(child, &cb->collect_stats);
     else if (strcasecmp("LogSendErrors", child->key) == 0)
       cf_util_get_boolean(child, &cb->log_send_errors);
     else if (strcasecmp("Prefix", child->key) == 0)
@@ -537,10 +828,20 @@ static int wg_config_node(oconfig_item_t *ci) {
       break;
   }
 
+  if (status == 0) {
+    cb->ring_size = (size_t)cb->queue_limit + 1;
+    cb->ring = calloc(cb->ring_size, sizeof(*cb->ring));
+    if (cb->ring == NULL) {
+      ERROR("write_graphite plugin: calloc failed.");
+      status = ENOMEM;
+    }
+  }
+
   if (status != 0) {
     wg_callback_free(cb);
     return status;
   }
+  cb->send_buf_init_time = cdtime();
 
   /* FIXME: Legacy configuration syntax. */
   if (cb->name == NULL)
@@ -550,14 +851,19 @@ static int wg_config_node(oconfig_item_t *ci) {
     snprintf(callback_name, sizeof(callback_name), "write_graphite/%s",
              cb->name);
 
-  plugin_register_write(callback_name, wg_write,
-                        &(user_data_t){
-                            .data = cb,
-                            .free_func = wg_callback_free,
-                        });
+  plugin_register_write_batch(callback_name, wg_write_batch,
+                              &(user_data_t){
+                                  .data = cb,
+                                  .free_func = wg_callback_free,
+                              });
 
   plugin_register_flush(callback_name, wg_flush, &(user_data_t){.data = cb});
 
+  if (cb->collect_stats)
+    plugin_register_complex_read(/* group = */ NULL, callback_name, wg_read,
+                                 /* interval = */ 0,
+                                 &(user_data_t){.data = cb});
+
   return 0;
 }
 
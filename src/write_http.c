@@ -30,9 +30,14 @@
 #include "utils/curl_stats/curl_stats.h"
 #include "utils/format_json/format_json.h"
 #include "utils/format_kairosdb/format_kairosdb.h"
+#include "utils_complain.h"
 
 #include <curl/curl.h>
 
+#if HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #ifndef WRITE_HTTP_DEFAULT_BUFFER_SIZE
 #define WRITE_HTTP_DEFAULT_BUFFER_SIZE 4096
 #endif
@@ -45,9 +50,50 @@
 #define WRITE_HTTP_RESPONSE_BUFFER_SIZE 1024
 #endif
 
+#ifndef WRITE_HTTP_DEFAULT_QUEUE_LIMIT
+#define WRITE_HTTP_DEFAULT_QUEUE_LIMIT 16
+#endif
+
+/* While the server is unreachable, a failed request is sent again after this
+ * time. */
+#ifndef WRITE_HTTP_RETRY_INTERVAL
+#define WRITE_HTTP_RETRY_INTERVAL TIME_T_TO_CDTIME_T_STATIC(1)
+#endif
+
+/* curl_multi_poll() and curl_multi_wakeup() were added in libcurl 7.68.0. */
+#if LIBCURL_VERSION_NUM >= 0x074400
+#define HAVE_CURL_MULTI_POLL 1
+#endif
+
 /*
  * Private variables
  */
+
+/* A request body: a sealed send buffer or a notification. */
+struct wh_body_s {
+  char *data;
+  size_t size;
+  size_t len;
+  struct wh_body_s *next;
+};
+typedef struct wh_body_s wh_body_t;
+
+/* One slot of the in-flight window. Each slot has its own easy handle; all of
+ * them share the connection cache of the node's multi handle. */
+struct wh_request_s {
+  CURL *curl;
+  wh_body_t *body;
+  bool running;
+
+  char *gzip_buffer;
+  size_t gzip_buffer_size;
+
+  char curl_errbuf[CURL_ERROR_SIZE];
+  char response_buffer[WRITE_HTTP_RESPONSE_BUFFER_SIZE];
+  unsigned int response_buffer_pos;
+};
+typedef struct wh_request_s wh_request_t;
+
 struct wh_callback_s {
   char *name;
 
@@ -76,21 +122,55 @@ struct wh_callback_s {
   bool send_metrics;
   bool send_notifications;
 
-  CURL *curl;
+#define WH_COMPRESSION_NONE 0
+#define WH_COMPRESSION_GZIP 1
+  int compression;
+
+#define WH_QUEUE_FULL_BLOCK 0
+#define WH_QUEUE_FULL_DROP 1
+#define WH_QUEUE_FULL_FAIL 2
+  int queue_full_action;
+  int queue_limit;
+  int max_requests;
+
+  CURLM *multi;
+  wh_request_t *requests;
+  size_t requests_num;
   curl_stats_t *curl_stats;
   struct curl_slist *headers;
-  char curl_errbuf[CURL_ERROR_SIZE];
 
+  /* Writers append to send_buffer. When it is full or flushed, it is swapped
+   * with a spare buffer and queued for the sender thread. */
   char *send_buffer;
   size_t send_buffer_size;
   size_t send_buffer_free;
   size_t send_buffer_fill;
   cdtime_t send_buffer_init_time;
 
-  pthread_mutex_t send_lock;
+  wh_body_t *queue_head;
+  wh_body_t *queue_tail;
+  size_t queue_num;
+  wh_body_t *spare;
+  uint64_t dropped;
 
-  char response_buffer[WRITE_HTTP_RESPONSE_BUFFER_SIZE];
-  unsigned int response_buffer_pos;
+  /* While a batch is appended, full send buffers are collected here instead
+   * of being queued, so that a failed batch can be taken back. */
+  bool batch_active;
+  wh_body_t *batch_head;
+  wh_body_t *batch_tail;
+  c_complain_t complaint;
+
+  /* Set when sending a request failed. The failed body is put back at the
+   * head of the queue and sent again at "retry_time". */
+  bool down;
+  cdtime_t retry_time;
+
+  pthread_mutex_t send_lock;
+  pthread_cond_t queue_cond;
+  pthread_cond_t space_cond;
+  pthread_t sender;
+  bool sender_running;
+  bool shutdown;
 
   int data_ttl;
   char *metrics_prefix;
@@ -106,21 +186,21 @@ static size_t http_attrs_num;
 static size_t wh_curl_write_callback(char *ptr, size_t size, size_t nmemb,
                                      void *userdata) {
 
-  wh_callback_t *cb = (wh_callback_t *)userdata;
+  wh_request_t *req = (wh_request_t *)userdata;
   unsigned int len = 0;
 
-  if ((cb->response_buffer_pos + nmemb) > sizeof(cb->response_buffer))
-    len = sizeof(cb->response_buffer) - cb->response_buffer_pos;
+  if ((req->response_buffer_pos + nmemb) > sizeof(req->response_buffer))
+    len = sizeof(req->response_buffer) - req->response_buffer_pos;
   else
     len = nmemb;
 
   DEBUG(
       "write_http plugin: curl callback nmemb=%zu buffer_pos=%u write_len=%u ",
-      nmemb, cb->response_buffer_pos, len);
+      nmemb, req->response_buffer_pos, len);
 
-  memcpy(cb->response_buffer + cb->response_buffer_pos, ptr, len);
-  cb->response_buffer_pos += len;
-  cb->response_buffer[sizeof(cb->response_buffer) - 1] = '\0';
+  memcpy(req->response_buffer + req->response_buffer_pos, ptr, len);
+  req->response_buffer_pos += len;
+  req->response_buffer[sizeof(req->response_buffer) - 1] = '\0';
 
   /* Always return nmemb even if we write less so libcurl won't throw an error
    */
@@ -128,13 +208,13 @@ static size_t wh_curl_write_callback(char *ptr, size_t size, size_t nmemb,
 
 } /* }}} wh_curl_write_callback */
 
-static void wh_log_http_error(wh_callback_t *cb) {
+static void wh_log_http_error(wh_callback_t *cb, CURL *curl) {
   if (!cb->log_http_error)
     return;
 
   long http_code = 0;
 
-  curl_easy_getinfo(cb->curl, CURLINFO_RESPONSE_CODE, &http_code);
+  curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
 
   if (http_code != 200)
     INFO("write_http plugin: HTTP Error code: %lu", http_code);
@@ -154,73 +234,502 @@ static void wh_reset_buffer(wh_callback_t *cb) /* {{{ */
     format_json_initialize(cb->send_buffer, &cb->send_buffer_fill,
                            &cb->send_buffer_free);
   }
+} /* }}} wh_reset_buffer */
 
-  memset(cb->response_buffer, 0, sizeof(cb->response_buffer));
-  cb->response_buffer_pos = 0;
+static void wh_body_free(wh_body_t *body) /* {{{ */
+{
+  if (body == NULL)
+    return;
 
-} /* }}} wh_reset_buffer */
+  sfree(body->data);
+  sfree(body);
+} /* }}} void wh_body_free */
 
-/* must hold cb->send_lock when calling */
-static int wh_post_nolock(wh_callback_t *cb, char const *data) /* {{{ */
+/* Returns a body to the spare list if it can be used as send buffer and frees
+ * it otherwise. Must hold cb->send_lock when calling. */
+static void wh_body_recycle_nolock(wh_callback_t *cb, /* {{{ */
+                                   wh_body_t *body) {
+  if (body->size != cb->send_buffer_size) {
+    wh_body_free(body);
+    return;
+  }
+
+  body->len = 0;
+  body->next = cb->spare;
+  cb->spare = body;
+} /* }}} void wh_body_recycle_nolock */
+
+static bool wh_queue_full_nolock(wh_callback_t const *cb) /* {{{ */
 {
-  int status = 0;
+  return (cb->queue_limit > 0) && (cb->queue_num >= (size_t)cb->queue_limit);
+} /* }}} bool wh_queue_full_nolock */
+
+/* Appends a body to the queue and wakes up the sender thread. With QueueFull
+ * "Drop", the oldest body is dropped if the queue is full. Must hold
+ * cb->send_lock when calling. */
+static void wh_queue_append_nolock(wh_callback_t *cb, /* {{{ */
+                                   wh_body_t *body) {
+  if ((cb->queue_full_action == WH_QUEUE_FULL_DROP) &&
+      wh_queue_full_nolock(cb)) {
+    wh_body_t *oldest = cb->queue_head;
+    cb->queue_head = oldest->next;
+    if (cb->queue_head == NULL)
+      cb->queue_tail = NULL;
+    cb->queue_num--;
+    wh_body_recycle_nolock(cb, oldest);
+
+    cb->dropped++;
+    c_complain(LOG_WARNING, &cb->complaint,
+               "write_http plugin: The queue of \"%s\" is full, dropping the "
+               "oldest request. %" PRIu64 " requests have been dropped so "
+               "far.",
+               cb->name, cb->dropped);
+  } else if (cb->queue_num == 0) {
+    c_release(LOG_INFO, &cb->complaint,
+              "write_http plugin: The queue of \"%s\" is no longer full.",
+              cb->name);
+  }
+
+  body->next = NULL;
+  if (cb->queue_tail == NULL)
+    cb->queue_head = body;
+  else
+    cb->queue_tail->next = body;
+  cb->queue_tail = body;
+  cb->queue_num++;
+
+  pthread_cond_signal(&cb->queue_cond);
+#if HAVE_CURL_MULTI_POLL
+  curl_multi_wakeup(cb->multi);
+#endif
+} /* }}} void wh_queue_append_nolock */
+
+/* With QueueFull "Block", waits until the queue has room for another body.
+ * Releases cb->send_lock while waiting, so the send buffer may have been
+ * flushed by another thread when this returns. */
+static void wh_queue_wait_nolock(wh_callback_t *cb) /* {{{ */
+{
+  /* A batch is appended without releasing the lock. */
+  if ((cb->queue_full_action != WH_QUEUE_FULL_BLOCK) || cb->batch_active)
+    return;
+
+  while (cb->sender_running && !cb->shutdown && !cb->down &&
+         wh_queue_full_nolock(cb))
+    pthread_cond_wait(&cb->space_cond, &cb->send_lock);
+} /* }}} void wh_queue_wait_nolock */
+
+/* Returns an error if new data is not accepted: while the server is
+ * unreachable and, with QueueFull "Fail", while the queue is full. Writes
+ * failing this way are stored by a WriteSpill configured for the callback.
+ * Must hold cb->send_lock when calling. */
+static int wh_check_writable_nolock(wh_callback_t *cb) /* {{{ */
+{
+  if (cb->down)
+    return ENOTCONN;
+
+  if ((cb->queue_full_action == WH_QUEUE_FULL_FAIL) &&
+      wh_queue_full_nolock(cb)) {
+    c_complain(LOG_WARNING, &cb->complaint,
+               "write_http plugin: The queue of \"%s\" is full, failing "
+               "writes until the server catches up.",
+               cb->name);
+    return EAGAIN;
+  }
+
+  return 0;
+} /* }}} int wh_check_writable_nolock */
+
+/* Queues the send buffer and continues with a spare buffer.
+ * Must hold cb->send_lock when calling. */
+static int wh_queue_send_buffer_nolock(wh_callback_t *cb) /* {{{ */
+{
+  wh_body_t *body = cb->spare;
+  if (body != NULL) {
+    cb->spare = body->next;
+  } else {
+    body = calloc(1, sizeof(*body));
+    if (body != NULL)
+      body->data = malloc(cb->send_buffer_size);
+    if ((body == NULL) || (body->data == NULL)) {
+      ERROR("write_http plugin: Allocating a send buffer failed.");
+      sfree(body);
+      return ENOMEM;
+    }
+    body->size = cb->send_buffer_size;
+  }
+
+  char *data = body->data;
+  body->data = cb->send_buffer;
+  body->len = cb->send_buffer_fill;
+  cb->send_buffer = data;
+
+  if (cb->batch_active) {
+    body->next = NULL;
+    if (cb->batch_tail == NULL)
+      cb->batch_head = body;
+    else
+      cb->batch_tail->next = body;
+    cb->batch_tail = body;
+  } else {
+    wh_queue_append_nolock(cb, body);
+  }
+  wh_reset_buffer(cb);
+  return 0;
+} /* }}} int wh_queue_send_buffer_nolock */
+
+/* Restores the send buffer to its state before a batch was appended. `bodies'
+ * are the send buffers filled while appending the batch; the first one holds
+ * the data written before the batch. Must hold cb->send_lock when calling. */
+static void wh_batch_rollback_nolock(wh_callback_t *cb, /* {{{ */
+                                     wh_body_t *bodies, size_t fill,
+                                     cdtime_t init_time) {
+  if (bodies != NULL) {
+    char *data = bodies->data;
+    bodies->data = cb->send_buffer;
+    cb->send_buffer = data;
+
+    /* Undo format_json_finalize(), which replaced the leading comma. */
+    if ((fill > 0) && (cb->format == WH_FORMAT_JSON ||
+                       cb->format == WH_FORMAT_KAIROSDB))
+      cb->send_buffer[0] = ',';
+  } else if (cb->send_buffer_fill < fill) {
+    /* The buffer has been reset after an error; its data is lost. */
+    return;
+  }
+
+  while (bodies != NULL) {
+    wh_body_t *next = bodies->next;
+    wh_body_recycle_nolock(cb, bodies);
+    bodies = next;
+  }
+
+  cb->send_buffer[fill] = 0;
+  cb->send_buffer_fill = fill;
+  cb->send_buffer_free = cb->send_buffer_size - fill;
+  cb->send_buffer_init_time = init_time;
+} /* }}} void wh_batch_rollback_nolock */
+
+#if HAVE_ZLIB
+static int wh_gzip_nolock(wh_request_t *req) /* {{{ */
+{
+  z_stream z = {0};
+
+  /* 16 + MAX_WBITS selects the gzip format. */
+  if (deflateInit2(&z, Z_BEST_SPEED, Z_DEFLATED, 16 + MAX_WBITS,
+                   /* memLevel = */ 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    return -1;
+
+  size_t size = (size_t)deflateBound(&z, (uLong)req->body->len);
+  if (req->gzip_buffer_size < size) {
+    char *tmp = realloc(req->gzip_buffer, size);
+    if (tmp == NULL) {
+      deflateEnd(&z);
+      return ENOMEM;
+    }
+    req->gzip_buffer = tmp;
+    req->gzip_buffer_size = size;
+  }
+
+  z.next_in = (Bytef *)req->body->data;
+  z.avail_in = (uInt)req->body->len;
+  z.next_out = (Bytef *)req->gzip_buffer;
+  z.avail_out = (uInt)req->gzip_buffer_size;
+
+  int status = deflate(&z, Z_FINISH);
+  size_t len = req->gzip_buffer_size - z.avail_out;
+  deflateEnd(&z);
+  if (status != Z_STREAM_END)
+    return -1;
+
+  curl_easy_setopt(req->curl, CURLOPT_POSTFIELDS, req->gzip_buffer);
+  curl_easy_setopt(req->curl, CURLOPT_POSTFIELDSIZE, (long)len);
+  return 0;
+} /* }}} int wh_gzip_nolock */
+#endif
+
+/* Adds the request's body to the multi handle. Called by the sender thread
+ * only, so the request may be accessed without holding cb->send_lock. */
+static int wh_request_start(wh_callback_t *cb, wh_request_t *req) /* {{{ */
+{
+  memset(req->response_buffer, 0, sizeof(req->response_buffer));
+  req->response_buffer_pos = 0;
+  req->curl_errbuf[0] = 0;
 
-  curl_easy_setopt(cb->curl, CURLOPT_URL, cb->location);
-  curl_easy_setopt(cb->curl, CURLOPT_POSTFIELDS, data);
-  curl_easy_setopt(cb->curl, CURLOPT_WRITEFUNCTION, &wh_curl_write_callback);
-  curl_easy_setopt(cb->curl, CURLOPT_WRITEDATA, (void *)cb);
-  status = curl_easy_perform(cb->curl);
-
-  wh_log_http_error(cb);
-
-  if (cb->curl_stats != NULL) {
-    int rc = curl_stats_dispatch(cb->curl_stats, cb->curl, NULL, "write_http",
-                                 cb->name);
-    if (rc != 0) {
-      ERROR("write_http plugin: curl_stats_dispatch failed with "
-            "status %i",
-            rc);
+#if HAVE_ZLIB
+  if (cb->compression == WH_COMPRESSION_GZIP) {
+    int status = wh_gzip_nolock(req);
+    if (status != 0) {
+      ERROR("write_http plugin: Compressing the request body failed.");
+      return status;
     }
+  } else
+#endif
+  {
+    curl_easy_setopt(req->curl, CURLOPT_POSTFIELDS, req->body->data);
+    curl_easy_setopt(req->curl, CURLOPT_POSTFIELDSIZE, (long)req->body->len);
   }
 
-  if (status != CURLE_OK) {
-    ERROR("write_http plugin: curl_easy_perform failed with "
-          "status %i: %s",
-          status, cb->curl_errbuf);
-    if (strlen(cb->response_buffer) > 0) {
-      ERROR("write_http plugin: curl_response=%s", cb->response_buffer);
+  CURLMcode status = curl_multi_add_handle(cb->multi, req->curl);
+  if (status != CURLM_OK) {
+    ERROR("write_http plugin: curl_multi_add_handle failed: %s",
+          curl_multi_strerror(status));
+    return -1;
+  }
+
+  req->running = true;
+  return 0;
+} /* }}} int wh_request_start */
+
+/* Logs the result of a finished request and returns its body. If the request
+ * failed, the body is queued again and the node is marked as down. */
+static void wh_request_finish(wh_callback_t *cb, wh_request_t *req, /* {{{ */
+                              CURLcode status) {
+  bool sent = req->running;
+  bool failed = sent && (status != CURLE_OK);
+
+  if (req->running) {
+    curl_multi_remove_handle(cb->multi, req->curl);
+    req->running = false;
+
+    wh_log_http_error(cb, req->curl);
+
+    if (cb->curl_stats != NULL) {
+      int rc = curl_stats_dispatch(cb->curl_stats, req->curl, NULL,
+                                   "write_http", cb->name);
+      if (rc != 0) {
+        ERROR("write_http plugin: curl_stats_dispatch failed with "
+              "status %i",
+              rc);
+      }
     }
+
+    /* Only the sender thread modifies cb->down. While the node is down,
+     * failed retries are not logged again. */
+    if ((status != CURLE_OK) && cb->down) {
+      DEBUG("write_http plugin: Sending data to \"%s\" failed again with "
+            "status %i: %s",
+            cb->location, status, req->curl_errbuf);
+    } else if (status != CURLE_OK) {
+      ERROR("write_http plugin: Sending data to \"%s\" failed with "
+            "status %i: %s",
+            cb->location, status, req->curl_errbuf);
+      if (strlen(req->response_buffer) > 0) {
+        ERROR("write_http plugin: curl_response=%s", req->response_buffer);
+      }
+    } else {
+      DEBUG("write_http plugin: curl_response=%s", req->response_buffer);
+    }
+  }
+
+  pthread_mutex_lock(&cb->send_lock);
+  if (failed && !cb->shutdown) {
+    if (!cb->down)
+      WARNING("write_http plugin: \"%s\" is unreachable. Failing writes "
+              "until sending succeeds again.",
+              cb->name);
+    cb->down = true;
+    cb->retry_time = cdtime() + WRITE_HTTP_RETRY_INTERVAL;
+
+    req->body->next = cb->queue_head;
+    cb->queue_head = req->body;
+    if (cb->queue_tail == NULL)
+      cb->queue_tail = req->body;
+    cb->queue_num++;
   } else {
-    DEBUG("write_http plugin: curl_response=%s", cb->response_buffer);
+    if (sent && !failed && cb->down) {
+      cb->down = false;
+      INFO("write_http plugin: \"%s\" is reachable again.", cb->name);
+    }
+    wh_body_recycle_nolock(cb, req->body);
   }
-  return status;
-} /* }}} wh_post_nolock */
+  req->body = NULL;
+  pthread_mutex_unlock(&cb->send_lock);
+} /* }}} void wh_request_finish */
 
-static int wh_callback_init(wh_callback_t *cb) /* {{{ */
+/* The sender thread moves queued bodies into free slots of the in-flight
+ * window and drives the transfers until the queue is empty and the node is
+ * being shut down. */
+static void *wh_sender_thread(void *arg) /* {{{ */
 {
-  if (cb->curl != NULL)
-    return 0;
+  wh_callback_t *cb = arg;
+  size_t running = 0;
+
+  while (42) {
+    pthread_mutex_lock(&cb->send_lock);
+    while ((running == 0) && !cb->shutdown) {
+      if (cb->queue_num == 0) {
+        pthread_cond_wait(&cb->queue_cond, &cb->send_lock);
+      } else if (cb->down && (cdtime() < cb->retry_time)) {
+        struct timespec ts = CDTIME_T_TO_TIMESPEC(cb->retry_time);
+        pthread_cond_timedwait(&cb->queue_cond, &cb->send_lock, &ts);
+      } else {
+        break;
+      }
+    }
 
-  cb->curl = curl_easy_init();
-  if (cb->curl == NULL) {
+    /* Don't wait for a server that is down when shutting down. */
+    if (cb->shutdown && cb->down && (cb->queue_num > 0)) {
+      ERROR("write_http plugin: \"%s\" is unreachable, dropping %" PRIsz
+            " queued requests.",
+            cb->name, cb->queue_num);
+      while (cb->queue_head != NULL) {
+        wh_body_t *next = cb->queue_head->next;
+        wh_body_recycle_nolock(cb, cb->queue_head);
+        cb->queue_head = next;
+      }
+      cb->queue_tail = NULL;
+      cb->queue_num = 0;
+    }
+
+    if ((running == 0) && (cb->queue_num == 0)) {
+      pthread_mutex_unlock(&cb->send_lock);
+      break;
+    }
+
+    /* While the server is down, only the oldest body is sent, once the retry
+     * time has come. */
+    size_t max = cb->requests_num;
+    if (cb->down)
+      max = ((running == 0) && (cdtime() >= cb->retry_time)) ? 1 : 0;
+
+    bool dequeued = false;
+    for (size_t i = 0; (i < cb->requests_num) && (max > 0); i++) {
+      wh_request_t *req = cb->requests + i;
+      if ((req->body != NULL) || (cb->queue_head == NULL))
+        continue;
+
+      req->body = cb->queue_head;
+      cb->queue_head = req->body->next;
+      if (cb->queue_head == NULL)
+        cb->queue_tail = NULL;
+      cb->queue_num--;
+      dequeued = true;
+      max--;
+    }
+    if (dequeued)
+      pthread_cond_broadcast(&cb->space_cond);
+    pthread_mutex_unlock(&cb->send_lock);
+
+    for (size_t i = 0; i < cb->requests_num; i++) {
+      wh_request_t *req = cb->requests + i;
+      if ((req->body == NULL) || req->running)
+        continue;
+
+      if (wh_request_start(cb, req) == 0)
+        running++;
+      else
+        wh_request_finish(cb, req, CURLE_OK);
+    }
+
+    int still_running = 0;
+    curl_multi_perform(cb->multi, &still_running);
+
+    CURLMsg *msg;
+    int msgs_left = 0;
+    while ((msg = curl_multi_info_read(cb->multi, &msgs_left)) != NULL) {
+      if (msg->msg != CURLMSG_DONE)
+        continue;
+
+      wh_request_t *req = NULL;
+      curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **)&req);
+      if (req == NULL)
+        continue;
+
+      wh_request_finish(cb, req, msg->data.result);
+      running--;
+    }
+
+    if (running == 0)
+      continue;
+
+#if HAVE_CURL_MULTI_POLL
+    /* Writers call curl_multi_wakeup() when they queue a body. */
+    curl_multi_poll(cb->multi, NULL, 0, /* timeout_ms = */ 1000, NULL);
+#else
+    curl_multi_wait(cb->multi, NULL, 0, /* timeout_ms = */ 100, NULL);
+#endif
+  }
+
+  return NULL;
+} /* }}} void *wh_sender_thread */
+
+static int wh_curl_setup(wh_callback_t *cb, wh_request_t *req) /* {{{ */
+{
+  req->curl = curl_easy_init();
+  if (req->curl == NULL) {
     ERROR("curl plugin: curl_easy_init failed.");
     return -1;
   }
 
   if (cb->low_speed_limit > 0 && cb->low_speed_time > 0) {
-    curl_easy_setopt(cb->curl, CURLOPT_LOW_SPEED_LIMIT,
+    curl_easy_setopt(req->curl, CURLOPT_LOW_SPEED_LIMIT,
                      (long)(cb->low_speed_limit * cb->low_speed_time));
-    curl_easy_setopt(cb->curl, CURLOPT_LOW_SPEED_TIME,
+    curl_easy_setopt(req->curl, CURLOPT_LOW_SPEED_TIME,
                      (long)cb->low_speed_time);
   }
 
 #ifdef HAVE_CURLOPT_TIMEOUT_MS
   if (cb->timeout > 0)
-    curl_easy_setopt(cb->curl, CURLOPT_TIMEOUT_MS, (long)cb->timeout);
+    curl_easy_setopt(req->curl, CURLOPT_TIMEOUT_MS, (long)cb->timeout);
+#endif
+
+  curl_easy_setopt(req->curl, CURLOPT_NOSIGNAL, 1L);
+  curl_easy_setopt(req->curl, CURLOPT_USERAGENT, COLLECTD_USERAGENT);
+  curl_easy_setopt(req->curl, CURLOPT_HTTPHEADER, cb->headers);
+
+  curl_easy_setopt(req->curl, CURLOPT_ERRORBUFFER, req->curl_errbuf);
+  curl_easy_setopt(req->curl, CURLOPT_FOLLOWLOCATION, 1L);
+  curl_easy_setopt(req->curl, CURLOPT_MAXREDIRS, 50L);
+
+  if (cb->user != NULL) {
+#ifdef HAVE_CURLOPT_USERNAME
+    curl_easy_setopt(req->curl, CURLOPT_USERNAME, cb->user);
+    curl_easy_setopt(req->curl, CURLOPT_PASSWORD,
+                     (cb->pass == NULL) ? "" : cb->pass);
+#else
+    curl_easy_setopt(req->curl, CURLOPT_USERPWD, cb->credentials);
 #endif
+    curl_easy_setopt(req->curl, CURLOPT_HTTPAUTH, CURLAUTH_ANY);
+  }
+
+  curl_easy_setopt(req->curl, CURLOPT_SSL_VERIFYPEER, (long)cb->verify_peer);
+  curl_easy_setopt(req->curl, CURLOPT_SSL_VERIFYHOST,
+                   cb->verify_host ? 2L : 0L);
+  curl_easy_setopt(req->curl, CURLOPT_SSLVERSION, cb->sslversion);
+  if (cb->cacert != NULL)
+    curl_easy_setopt(req->curl, CURLOPT_CAINFO, cb->cacert);
+  if (cb->capath != NULL)
+    curl_easy_setopt(req->curl, CURLOPT_CAPATH, cb->capath);
+
+  if (cb->clientkey != NULL && cb->clientcert != NULL) {
+    curl_easy_setopt(req->curl, CURLOPT_SSLKEY, cb->clientkey);
+    curl_easy_setopt(req->curl, CURLOPT_SSLCERT, cb->clientcert);
+
+    if (cb->clientkeypass != NULL)
+      curl_easy_setopt(req->curl, CURLOPT_SSLKEYPASSWD, cb->clientkeypass);
+  }
+
+  curl_easy_setopt(req->curl, CURLOPT_URL, cb->location);
+  curl_easy_setopt(req->curl, CURLOPT_POST, 1L);
+  curl_easy_setopt(req->curl, CURLOPT_WRITEFUNCTION, &wh_curl_write_callback);
+  curl_easy_setopt(req->curl, CURLOPT_WRITEDATA, (void *)req);
+  curl_easy_setopt(req->curl, CURLOPT_PRIVATE, (void *)req);
+
+  return 0;
+} /* }}} int wh_curl_setup */
 
-  curl_easy_setopt(cb->curl, CURLOPT_NOSIGNAL, 1L);
-  curl_easy_setopt(cb->curl, CURLOPT_USERAGENT, COLLECTD_USERAGENT);
+/* must hold cb->send_lock when calling */
+static int wh_callback_init(wh_callback_t *cb) /* {{{ */
+{
+  if (cb->multi != NULL)
+    return 0;
+
+  cb->multi = curl_multi_init();
+  if (cb->multi == NULL) {
+    ERROR("write_http plugin: curl_multi_init failed.");
+    return -1;
+  }
+  curl_multi_setopt(cb->multi, CURLMOPT_MAXCONNECTS, (long)cb->max_requests);
 
   cb->headers = curl_slist_append(cb->headers, "Accept:  */*");
   if (cb->format == WH_FORMAT_JSON || cb->format == WH_FORMAT_KAIROSDB)
@@ -228,19 +737,12 @@ static int wh_callback_init(wh_callback_t *cb) /* {{{ */
         curl_slist_append(cb->headers, "Content-Type: application/json");
   else
     cb->headers = curl_slist_append(cb->headers, "Content-Type: text/plain");
+  if (cb->compression == WH_COMPRESSION_GZIP)
+    cb->headers = curl_slist_append(cb->headers, "Content-Encoding: gzip");
   cb->headers = curl_slist_append(cb->headers, "Expect:");
-  curl_easy_setopt(cb->curl, CURLOPT_HTTPHEADER, cb->headers);
-
-  curl_easy_setopt(cb->curl, CURLOPT_ERRORBUFFER, cb->curl_errbuf);
-  curl_easy_setopt(cb->curl, CURLOPT_FOLLOWLOCATION, 1L);
-  curl_easy_setopt(cb->curl, CURLOPT_MAXREDIRS, 50L);
 
+#ifndef HAVE_CURLOPT_USERNAME
   if (cb->user != NULL) {
-#ifdef HAVE_CURLOPT_USERNAME
-    curl_easy_setopt(cb->curl, CURLOPT_USERNAME, cb->user);
-    curl_easy_setopt(cb->curl, CURLOPT_PASSWORD,
-                     (cb->pass == NULL) ? "" : cb->pass);
-#else
     size_t credentials_size;
 
     credentials_size = strlen(cb->user) + 2;
@@ -255,28 +757,29 @@ static int wh_callback_init(wh_callback_t *cb) /* {{{ */
 
     snprintf(cb->credentials, credentials_size, "%s:%s", cb->user,
              (cb->pass == NULL) ? "" : cb->pass);
-    curl_easy_setopt(cb->curl, CURLOPT_USERPWD, cb->credentials);
-#endif
-    curl_easy_setopt(cb->curl, CURLOPT_HTTPAUTH, CURLAUTH_ANY);
   }
+#endif
 
-  curl_easy_setopt(cb->curl, CURLOPT_SSL_VERIFYPEER, (long)cb->verify_peer);
-  curl_easy_setopt(cb->curl, CURLOPT_SSL_VERIFYHOST, cb->verify_host ? 2L : 0L);
-  curl_easy_setopt(cb->curl, CURLOPT_SSLVERSION, cb->sslversion);
-  if (cb->cacert != NULL)
-    curl_easy_setopt(cb->curl, CURLOPT_CAINFO, cb->cacert);
-  if (cb->capath != NULL)
-    curl_easy_setopt(cb->curl, CURLOPT_CAPATH, cb->capath);
-
-  if (cb->clientkey != NULL && cb->clientcert != NULL) {
-    curl_easy_setopt(cb->curl, CURLOPT_SSLKEY, cb->clientkey);
-    curl_easy_setopt(cb->curl, CURLOPT_SSLCERT, cb->clientcert);
+  cb->requests = calloc((size_t)cb->max_requests, sizeof(*cb->requests));
+  if (cb->requests == NULL) {
+    ERROR("write_http plugin: calloc failed.");
+    return -1;
+  }
+  cb->requests_num = (size_t)cb->max_requests;
 
-    if (cb->clientkeypass != NULL)
-      curl_easy_setopt(cb->curl, CURLOPT_SSLKEYPASSWD, cb->clientkeypass);
+  for (size_t i = 0; i < cb->requests_num; i++) {
+    if (wh_curl_setup(cb, cb->requests + i) != 0)
+      return -1;
   }
 
-  wh_reset_buffer(cb);
+  int status = plugin_thread_create(&cb->sender, wh_sender_thread, cb,
+                                    "write_http send");
+  if (status != 0) {
+    ERROR("write_http plugin: Starting the sender thread failed: %s",
+          STRERROR(status));
+    return -1;
+  }
+  cb->sender_running = true;
 
   return 0;
 } /* }}} int wh_callback_init */
@@ -304,14 +807,22 @@ static int wh_flush_nolock(cdtime_t timeout, wh_callback_t *cb) /* {{{ */
       return 0;
     }
 
-    status = wh_post_nolock(cb, cb->send_buffer);
-    wh_reset_buffer(cb);
+    wh_queue_wait_nolock(cb);
+    /* Another thread may have flushed the buffer while we were waiting. */
+    if (cb->send_buffer_fill == 0)
+      return 0;
+
+    status = wh_queue_send_buffer_nolock(cb);
   } else if (cb->format == WH_FORMAT_JSON || cb->format == WH_FORMAT_KAIROSDB) {
     if (cb->send_buffer_fill <= 2) {
       cb->send_buffer_init_time = cdtime();
       return 0;
     }
 
+    wh_queue_wait_nolock(cb);
+    if (cb->send_buffer_fill <= 2)
+      return 0;
+
     status = format_json_finalize(cb->send_buffer, &cb->send_buffer_fill,
                                   &cb->send_buffer_free);
     if (status != 0) {
@@ -321,8 +832,7 @@ static int wh_flush_nolock(cdtime_t timeout, wh_callback_t *cb) /* {{{ */
       return status;
     }
 
-    status = wh_post_nolock(cb, cb->send_buffer);
-    wh_reset_buffer(cb);
+    status = wh_queue_send_buffer_nolock(cb);
   } else {
     ERROR("write_http: wh_flush_nolock: "
           "Unknown format: %i",
@@ -330,6 +840,8 @@ static int wh_flush_nolock(cdtime_t timeout, wh_callback_t *cb) /* {{{ */
     return -1;
   }
 
+  if (status != 0)
+    wh_reset_buffer(cb);
   return status;
 } /* }}} wh_flush_nolock */
 
@@ -367,12 +879,49 @@ static void wh_callback_free(void *data) /* {{{ */
 
   cb = data;
 
-  if (cb->send_buffer != NULL)
-    wh_flush_nolock(/* timeout = */ 0, cb);
+  if (cb->sender_running) {
+    pthread_mutex_lock(&cb->send_lock);
+    if (cb->send_buffer != NULL)
+      wh_flush_nolock(/* timeout = */ 0, cb);
+
+    /* The sender thread sends everything that has been queued before it
+     * exits. */
+    cb->shutdown = true;
+    pthread_cond_broadcast(&cb->queue_cond);
+    pthread_cond_broadcast(&cb->space_cond);
+#if HAVE_CURL_MULTI_POLL
+    curl_multi_wakeup(cb->multi);
+#endif
+    pthread_mutex_unlock(&cb->send_lock);
+
+    pthread_join(cb->sender, NULL);
+    cb->sender_running = false;
+  }
+
+  for (size_t i = 0; i < cb->requests_num; i++) {
+    wh_request_t *req = cb->requests + i;
+    if (req->curl != NULL)
+      curl_easy_cleanup(req->curl);
+    wh_body_free(req->body);
+    sfree(req->gzip_buffer);
+  }
+  sfree(cb->requests);
+  cb->requests_num = 0;
+
+  if (cb->multi != NULL) {
+    curl_multi_cleanup(cb->multi);
+    cb->multi = NULL;
+  }
 
-  if (cb->curl != NULL) {
-    curl_easy_cleanup(cb->curl);
-    cb->curl = NULL;
+  while (cb->queue_head != NULL) {
+    wh_body_t *next = cb->queue_head->next;
+    wh_body_free(cb->queue_head);
+    cb->queue_head = next;
+  }
+  while (cb->spare != NULL) {
+    wh_body_t *next = cb->spare->next;
+    wh_body_free(cb->spare);
+    cb->spare = next;
   }
 
   curl_stats_destroy(cb->curl_stats);
@@ -383,6 +932,10 @@ static void wh_callback_free(void *data) /* {{{ */
     cb->headers = NULL;
   }
 
+  pthread_cond_destroy(&cb->queue_cond);
+  pthread_cond_destroy(&cb->space_cond);
+  pthread_mutex_destroy(&cb->send_lock);
+
   sfree(cb->name);
   sfree(cb->location);
   sfree(cb->user);
@@ -399,9 +952,10 @@ static void wh_callback_free(void *data) /* {{{ */
   sfree(cb);
 } /* }}} void wh_callback_free */
 
-static int wh_write_command(const data_set_t *ds,
-                            const value_list_t *vl, /* {{{ */
-                            wh_callback_t *cb) {
+/* must hold cb->send_lock when calling */
+static int wh_write_command_nolock(const data_set_t *ds,
+                                   const value_list_t *vl, /* {{{ */
+                                   wh_callback_t *cb) {
   char key[10 * DATA_MAX_NAME_LEN];
   char values[512];
   char command[1024];
@@ -446,19 +1000,15 @@ static int wh_write_command(const data_set_t *ds,
     return -1;
   }
 
-  pthread_mutex_lock(&cb->send_lock);
   if (wh_callback_init(cb) != 0) {
     ERROR("write_http plugin: wh_callback_init failed.");
-    pthread_mutex_unlock(&cb->send_lock);
     return -1;
   }
 
   if (command_len >= cb->send_buffer_free) {
     status = wh_flush_nolock(/* timeout = */ 0, cb);
-    if (status != 0) {
-      pthread_mutex_unlock(&cb->send_lock);
+    if (status != 0)
       return status;
-    }
   }
   assert(command_len < cb->send_buffer_free);
 
@@ -476,20 +1026,17 @@ static int wh_write_command(const data_set_t *ds,
         100.0 * ((double)cb->send_buffer_fill) / ((double)cb->send_buffer_size),
         command);
 
-  /* Check if we have enough space for this command. */
-  pthread_mutex_unlock(&cb->send_lock);
-
   return 0;
-} /* }}} int wh_write_command */
+} /* }}} int wh_write_command_nolock */
 
-static int wh_write_json(const data_set_t *ds, const value_list_t *vl, /* {{{ */
-                         wh_callback_t *cb) {
+/* must hold cb->send_lock when calling */
+static int wh_write_json_nolock(const data_set_t *ds,
+                                const value_list_t *vl, /* {{{ */
+                                wh_callback_t *cb) {
   int status;
 
-  pthread_mutex_lock(&cb->send_lock);
   if (wh_callback_init(cb) != 0) {
     ERROR("write_http plugin: wh_callback_init failed.");
-    pthread_mutex_unlock(&cb->send_lock);
     return -1;
   }
 
@@ -500,7 +1047,6 @@ static int wh_write_json(const data_set_t *ds, const value_list_t *vl, /* {{{ */
     status = wh_flush_nolock(/* timeout = */ 0, cb);
     if (status != 0) {
       wh_reset_buffer(cb);
-      pthread_mutex_unlock(&cb->send_lock);
       return status;
     }
 
@@ -508,36 +1054,26 @@ static int wh_write_json(const data_set_t *ds, const value_list_t *vl, /* {{{ */
         format_json_value_list(cb->send_buffer, &cb->send_buffer_fill,
                                &cb->send_buffer_free, ds, vl, cb->store_rates);
   }
-  if (status != 0) {
-    pthread_mutex_unlock(&cb->send_lock);
+  if (status != 0)
     return status;
-  }
 
   DEBUG("write_http plugin: <%s> buffer %" PRIsz "/%" PRIsz " (%g%%)",
         cb->location, cb->send_buffer_fill, cb->send_buffer_size,
         100.0 * ((double)cb->send_buffer_fill) /
             ((double)cb->send_buffer_size));
 
-  /* Check if we have enough space for this command. */
-  pthread_mutex_unlock(&cb->send_lock);
-
   return 0;
-} /* }}} int wh_write_json */
+} /* }}} int wh_write_json_nolock */
 
-static int wh_write_kairosdb(const data_set_t *ds,
-                             const value_list_t *vl, /* {{{ */
-                             wh_callback_t *cb) {
+/* must hold cb->send_lock when calling */
+static int wh_write_kairosdb_nolock(const data_set_t *ds,
+                                    const value_list_t *vl, /* {{{ */
+                                    wh_callback_t *cb) {
   int status;
 
-  pthread_mutex_lock(&cb->send_lock);
-
-  if (cb->curl == NULL) {
-    status = wh_callback_init(cb);
-    if (status != 0) {
-      ERROR("write_http plugin: wh_callback_init failed.");
-      pthread_mutex_unlock(&cb->send_lock);
-      return -1;
-    }
+  if (wh_callback_init(cb) != 0) {
+    ERROR("write_http plugin: wh_callback_init failed.");
+    return -1;
   }
 
   status = format_kairosdb_value_list(
@@ -548,7 +1084,6 @@ static int wh_write_kairosdb(const data_set_t *ds,
     status = wh_flush_nolock(/* timeout = */ 0, cb);
     if (status != 0) {
       wh_reset_buffer(cb);
-      pthread_mutex_unlock(&cb->send_lock);
       return status;
     }
 
@@ -557,26 +1092,35 @@ static int wh_write_kairosdb(const data_set_t *ds,
         cb->store_rates, (char const *const *)http_attrs, http_attrs_num,
         cb->data_ttl, cb->metrics_prefix);
   }
-  if (status != 0) {
-    pthread_mutex_unlock(&cb->send_lock);
+  if (status != 0)
     return status;
-  }
 
   DEBUG("write_http plugin: <%s> buffer %" PRIsz "/%" PRIsz " (%g%%)",
         cb->location, cb->send_buffer_fill, cb->send_buffer_size,
         100.0 * ((double)cb->send_buffer_fill) /
             ((double)cb->send_buffer_size));
 
-  /* Check if we have enough space for this command. */
-  pthread_mutex_unlock(&cb->send_lock);
-
   return 0;
-} /* }}} int wh_write_kairosdb */
+} /* }}} int wh_write_kairosdb_nolock */
 
-static int wh_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
-                    user_data_t *user_data) {
+/* must hold cb->send_lock when calling */
+static int wh_write_nolock(const data_set_t *ds, /* {{{ */
+                           const value_list_t *vl, wh_callback_t *cb) {
+  switch (cb->format) {
+  case WH_FORMAT_JSON:
+    return wh_write_json_nolock(ds, vl, cb);
+  case WH_FORMAT_KAIROSDB:
+    return wh_write_kairosdb_nolock(ds, vl, cb);
+  default:
+    return wh_write_command_nolock(ds, vl, cb);
+  }
+} /* }}} int wh_write_nolock */
+
+static int wh_write_batch(const data_set_t *const *ds, /* {{{ */
+                          const value_list_t *const *vl, size_t num,
+                          user_data_t *user_data) {
   wh_callback_t *cb;
-  int status;
+  int status = 0;
 
   if (user_data == NULL)
     return -EINVAL;
@@ -584,19 +1128,46 @@ static int wh_write(const data_set_t *ds, const value_list_t *vl, /* {{{ */
   cb = user_data->data;
   assert(cb->send_metrics);
 
-  switch (cb->format) {
-  case WH_FORMAT_JSON:
-    status = wh_write_json(ds, vl, cb);
-    break;
-  case WH_FORMAT_KAIROSDB:
-    status = wh_write_kairosdb(ds, vl, cb);
-    break;
-  default:
-    status = wh_write_command(ds, vl, cb);
-    break;
+  /* Append the whole batch to the send buffer under a single lock. The batch
+   * is either accepted or failed as a whole, so that failed value lists can
+   * be stored in a spill queue without duplicates: send buffers filled by the
+   * batch are only queued once all of it has been appended, and the send
+   * buffer is rolled back if appending fails. */
+  pthread_mutex_lock(&cb->send_lock);
+  status = wh_check_writable_nolock(cb);
+  if (status != 0) {
+    pthread_mutex_unlock(&cb->send_lock);
+    return status;
   }
-  return status;
-} /* }}} int wh_write */
+
+  size_t fill = cb->send_buffer_fill;
+  cdtime_t init_time = cb->send_buffer_init_time;
+
+  cb->batch_active = true;
+  for (size_t i = 0; (i < num) && (status == 0); i++)
+    status = wh_write_nolock(ds[i], vl[i], cb);
+  cb->batch_active = false;
+
+  wh_body_t *bodies = cb->batch_head;
+  cb->batch_head = NULL;
+  cb->batch_tail = NULL;
+
+  if (status != 0) {
+    wh_batch_rollback_nolock(cb, bodies, fill, init_time);
+    pthread_mutex_unlock(&cb->send_lock);
+    return status;
+  }
+
+  while (bodies != NULL) {
+    wh_body_t *next = bodies->next;
+    wh_queue_wait_nolock(cb);
+    wh_queue_append_nolock(cb, bodies);
+    bodies = next;
+  }
+  pthread_mutex_unlock(&cb->send_lock);
+
+  return 0;
+} /* }}} int wh_write_batch */
 
 static int wh_notify(notification_t const *n, user_data_t *ud) /* {{{ */
 {
@@ -616,17 +1187,40 @@ static int wh_notify(notification_t const *n, user_data_t *ud) /* {{{ */
     return status;
   }
 
+  wh_body_t *body = calloc(1, sizeof(*body));
+  if (body == NULL) {
+    ERROR("write_http plugin: calloc failed.");
+    return ENOMEM;
+  }
+  body->len = strlen(alert);
+  body->size = body->len + 1;
+  body->data = strdup(alert);
+  if (body->data == NULL) {
+    ERROR("write_http plugin: strdup failed.");
+    sfree(body);
+    return ENOMEM;
+  }
+
   pthread_mutex_lock(&cb->send_lock);
   if (wh_callback_init(cb) != 0) {
     ERROR("write_http plugin: wh_callback_init failed.");
     pthread_mutex_unlock(&cb->send_lock);
+    wh_body_free(body);
     return -1;
   }
 
-  status = wh_post_nolock(cb, alert);
+  status = wh_check_writable_nolock(cb);
+  if (status != 0) {
+    pthread_mutex_unlock(&cb->send_lock);
+    wh_body_free(body);
+    return status;
+  }
+
+  wh_queue_wait_nolock(cb);
+  wh_queue_append_nolock(cb, body);
   pthread_mutex_unlock(&cb->send_lock);
 
-  return status;
+  return 0;
 } /* }}} int wh_notify */
 
 static int config_set_format(wh_callback_t *cb, /* {{{ */
@@ -655,6 +1249,54 @@ static int config_set_format(wh_callback_t *cb, /* {{{ */
   return 0;
 } /* }}} int config_set_format */
 
+static int config_set_queue_full(wh_callback_t *cb, /* {{{ */
+                                 oconfig_item_t *ci) {
+  char *string = NULL;
+  int status = cf_util_get_string(ci, &string);
+  if (status != 0)
+    return status;
+
+  if (strcasecmp("Block", string) == 0)
+    cb->queue_full_action = WH_QUEUE_FULL_BLOCK;
+  else if (strcasecmp("Drop", string) == 0)
+    cb->queue_full_action = WH_QUEUE_FULL_DROP;
+  else if (strcasecmp("Fail", string) == 0)
+    cb->queue_full_action = WH_QUEUE_FULL_FAIL;
+  else {
+    ERROR("write_http plugin: Invalid QueueFull option: %s", string);
+    status = EINVAL;
+  }
+
+  sfree(string);
+  return status;
+} /* }}} int config_set_queue_full */
+
+static int config_set_compression(wh_callback_t *cb, /* {{{ */
+                                  oconfig_item_t *ci) {
+  char *string = NULL;
+  int status = cf_util_get_string(ci, &string);
+  if (status != 0)
+    return status;
+
+  if (strcasecmp("None", string) == 0)
+    cb->compression = WH_COMPRESSION_NONE;
+  else if (strcasecmp("Gzip", string) == 0) {
+#if HAVE_ZLIB
+    cb->compression = WH_COMPRESSION_GZIP;
+#else
+    ERROR("write_http plugin: Compression \"Gzip\" is not supported: "
+          "collectd was built without zlib.");
+    status = ENOTSUP;
+#endif
+  } else {
+    ERROR("write_http plugin: Invalid Compression option: %s", string);
+    status = EINVAL;
+  }
+
+  sfree(string);
+  return status;
+} /* }}} int config_set_compression */
+
 static int wh_config_append_string(const char *name,
                                    struct curl_slist **dest, /* {{{ */
                                    oconfig_item_t *ci) {
@@ -698,6 +1340,11 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
   cb->data_ttl = 0;
   cb->metrics_prefix = strdup(WRITE_HTTP_DEFAULT_PREFIX);
   cb->curl_stats = NULL;
+  cb->compression = WH_COMPRESSION_NONE;
+  cb->queue_full_action = WH_QUEUE_FULL_FAIL;
+  cb->queue_limit = WRITE_HTTP_DEFAULT_QUEUE_LIMIT;
+  cb->max_requests = 1;
+  C_COMPLAIN_INIT(&cb->complaint);
 
   if (cb->metrics_prefix == NULL) {
     ERROR("write_http plugin: strdup failed.");
@@ -706,6 +1353,8 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
   }
 
   pthread_mutex_init(&cb->send_lock, /* attr = */ NULL);
+  pthread_cond_init(&cb->queue_cond, /* attr = */ NULL);
+  pthread_cond_init(&cb->space_cond, /* attr = */ NULL);
 
   cf_util_get_string(ci, &cb->name);
 
@@ -821,6 +1470,14 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
       status = cf_util_get_int(child, &cb->data_ttl);
     } else if (strcasecmp("Prefix", child->key) == 0) {
       status = cf_util_get_string(child, &cb->metrics_prefix);
+    } else if (strcasecmp("MaxRequests", child->key) == 0) {
+      status = cf_util_get_int(child, &cb->max_requests);
+    } else if (strcasecmp("QueueLimit", child->key) == 0) {
+      status = cf_util_get_int(child, &cb->queue_limit);
+    } else if (strcasecmp("QueueFull", child->key) == 0) {
+      status = config_set_queue_full(cb, child);
+    } else if (strcasecmp("Compression", child->key) == 0) {
+      status = config_set_compression(cb, child);
     } else {
       ERROR("write_http plugin: Invalid configuration "
             "option: %s.",
@@ -854,6 +1511,18 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
   if (strlen(cb->metrics_prefix) == 0)
     sfree(cb->metrics_prefix);
 
+  if (cb->max_requests < 1) {
+    ERROR("write_http plugin: Ignoring invalid MaxRequests setting (%d).",
+          cb->max_requests);
+    cb->max_requests = 1;
+  }
+
+  if (cb->queue_limit < 0) {
+    ERROR("write_http plugin: Ignoring invalid QueueLimit setting (%d).",
+          cb->queue_limit);
+    cb->queue_limit = WRITE_HTTP_DEFAULT_QUEUE_LIMIT;
+  }
+
   if (cb->low_speed_limit > 0)
     cb->low_speed_time = CDTIME_T_TO_TIME_T(plugin_get_interval());
 
@@ -887,7 +1556,7 @@ static int wh_config_node(oconfig_item_t *ci) /* {{{ */
   };
 
   if (cb->send_metrics) {
-    plugin_register_write(callback_name, wh_write, &user_data);
+    plugin_register_write_batch(callback_name, wh_write_batch, &user_data);
     user_data.free_func = NULL;
 
     plugin_register_flush(callback_name, wh_flush, &user_data);
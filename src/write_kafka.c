@@ -176,8 +176,6 @@ static int kafka_write(const data_set_t *ds, /* {{{ */
   void *key;
   size_t keylen = 0;
   char buffer[8192];
-  size_t bfree = sizeof(buffer);
-  size_t bfill = 0;
   size_t blen = 0;
   struct kafka_topic_context *ctx = ud->data;
 
@@ -202,12 +200,21 @@ static int kafka_write(const data_set_t *ds, /* {{{ */
     }
     blen = strlen(buffer);
     break;
-  case KAFKA_FORMAT_JSON:
-    format_json_initialize(buffer, &bfill, &bfree);
-    format_json_value_list(buffer, &bfill, &bfree, ds, vl, ctx->store_rates);
-    format_json_finalize(buffer, &bfill, &bfree);
-    blen = strlen(buffer);
+  case KAFKA_FORMAT_JSON: {
+    json_encoder_t e;
+    json_encoder_init_fixed(&e, buffer, sizeof(buffer));
+    json_encoder_array_open(&e);
+    status = format_json_encode_value_list(&e, ds, vl, ctx->store_rates);
+    json_encoder_array_close(&e);
+    if (status != 0) {
+      ERROR("write_kafka plugin: format_json_encode_value_list failed with "
+            "status %i.",
+            status);
+      return status;
+    }
+    blen = json_encoder_len(&e);
     break;
+  }
   case KAFKA_FORMAT_GRAPHITE:
     status =
         format_graphite(buffer, sizeof(buffer), ds, vl, ctx->prefix,
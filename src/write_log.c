@@ -62,23 +62,22 @@ static int wl_write_graphite(const data_set_t *ds, const value_list_t *vl) {
 } /* int wl_write_graphite */
 
 static int wl_write_json(const data_set_t *ds, const value_list_t *vl) {
-  char buffer[WL_BUF_SIZE] = {0};
-  size_t bfree = sizeof(buffer);
-  size_t bfill = 0;
-
   if (0 != strcmp(ds->type, vl->type)) {
     ERROR("write_log plugin: DS type does not match value list type");
     return -1;
   }
 
-  format_json_initialize(buffer, &bfill, &bfree);
-  format_json_value_list(buffer, &bfill, &bfree, ds, vl,
-                         /* store rates = */ 0);
-  format_json_finalize(buffer, &bfill, &bfree);
-
-  INFO("write_log values:\n%s", buffer);
+  json_encoder_t e;
+  json_encoder_init(&e);
+  int status = format_json_value_lists(&e, &ds, &vl, 1, /* store rates = */ 0);
+  if (status == 0)
+    INFO("write_log values:\n%s", json_encoder_buffer(&e));
+  else
+    ERROR("write_log plugin: format_json_value_lists failed with status %i.",
+          status);
+  json_encoder_destroy(&e);
 
-  return 0;
+  return status;
 } /* int wl_write_json */
 
 static int wl_write(const data_set_t *ds, const value_list_t *vl,
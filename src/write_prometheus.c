@@ -40,6 +40,10 @@
 #include <sys/socket.h>
 #include <sys/types.h>
 
+#if HAVE_ZLIB
+#include <zlib.h>
+#endif
+
 #ifndef PROMETHEUS_DEFAULT_STALENESS_DELTA
 #define PROMETHEUS_DEFAULT_STALENESS_DELTA TIME_T_TO_CDTIME_T_STATIC(300)
 #endif
@@ -51,8 +55,101 @@
   "encoding=delimited"
 #define CONTENT_TYPE_TEXT "text/plain; version=0.0.4"
 
+/* Variants of a snapshot. SNAPSHOT_GZIP is combined with one of the formats. */
+#define SNAPSHOT_TEXT 0
+#define SNAPSHOT_PROTO 1
+#define SNAPSHOT_GZIP 2
+#define SNAPSHOT_VARIANTS 4
+
+/* A metric together with its labels in the text exposition format, i.e.
+ * "{key0="value0",key1="value1"} ". The labels are escaped once, when the
+ * metric is created, instead of on every scrape. All metrics in the metric
+ * families are allocated as prom_metric_t. */
+typedef struct {
+  Io__Prometheus__Client__Metric pb; /* must be first */
+  char *labels_text;
+  size_t labels_text_len;
+
+  uint64_t hash; /* hash of the label values, see metric_hash() */
+  uint32_t slot; /* index in prom_family_t.slots */
+} prom_metric_t;
+
+/* A metric family with an index of its metrics. Metrics are stored in "slots"
+ * and keep their slot for their whole life time; slots of deleted metrics are
+ * put on a free list and reused. "index" is an open addressing hash table
+ * mapping the label values to slot + 1 (zero marks an empty entry), so adding,
+ * looking up and deleting a metric take constant time regardless of the number
+ * of metrics in the family.
+ *
+ * The sorted "pb.metric" array used for the exposition formats is only built by
+ * metric_family_sort() when the family is rendered, and only if metrics have
+ * been added or deleted since. All metric families are allocated as
+ * prom_family_t. */
+typedef struct {
+  Io__Prometheus__Client__MetricFamily pb; /* must be first */
+
+  prom_metric_t **slots;
+  size_t slots_num;  /* slots in use, including free ones */
+  size_t slots_size; /* allocated size of "slots", "free_slots", "pb.metric" */
+  uint32_t *free_slots;
+  size_t free_slots_num;
+
+  uint32_t *index;
+  size_t index_size; /* power of two */
+
+  size_t metrics_num;
+  bool unsorted;
+} prom_family_t;
+
+/* Copy of a metric in a snapshot. The label pairs and the value are stored
+ * inline; the strings point into the snapshot's "strings". */
+typedef struct {
+  prom_metric_t m; /* must be first */
+  Io__Prometheus__Client__LabelPair labels[3];
+  Io__Prometheus__Client__LabelPair *label_ptrs[3];
+  Io__Prometheus__Client__Gauge gauge;
+  Io__Prometheus__Client__Counter counter;
+} prom_metric_copy_t;
+
+#define VARIANT_NONE 0
+#define VARIANT_RENDERING 1
+#define VARIANT_RENDERED 2
+
+/* A copy of all metric families, taken while holding "metrics_lock", and its
+ * renderings. The first scrape after the metrics have changed takes the copy;
+ * each variant is rendered from the copy without holding "metrics_lock" by
+ * the first scrape asking for it, and is shared by all later scrapes. The
+ * copy is never modified; "state", "data" and "size" are protected by
+ * "snapshot_lock" until the variant has been rendered. A variant's data is
+ * NULL if rendering it failed. */
+typedef struct {
+  uint64_t generation;
+  size_t refcount; /* protected by snapshot_lock */
+
+  Io__Prometheus__Client__MetricFamily *families;
+  size_t families_num;
+  Io__Prometheus__Client__Metric **metric_ptrs;
+  prom_metric_copy_t *metrics;
+  char *strings;
+
+  int state[SNAPSHOT_VARIANTS];
+  uint8_t *data[SNAPSHOT_VARIANTS];
+  size_t size[SNAPSHOT_VARIANTS];
+} prom_snapshot_t;
+
 static c_avl_tree_t *metrics;
 static pthread_mutex_t metrics_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Incremented whenever "metrics" is modified. */
+static uint64_t metrics_generation;
+
+static prom_snapshot_t *snapshot;
+static pthread_mutex_t snapshot_lock = PTHREAD_MUTEX_INITIALIZER;
+/* Signaled when a snapshot has been taken or a variant has been rendered. */
+static pthread_cond_t snapshot_cond = PTHREAD_COND_INITIALIZER;
+static bool snapshot_taking;  /* protected by snapshot_lock */
+static uint64_t snapshot_num; /* protected by snapshot_lock */
+
+static void metric_family_sort(Io__Prometheus__Client__MetricFamily *fam);
 
 static char *httpd_host = NULL;
 static unsigned short httpd_port = 9103;
@@ -77,16 +174,14 @@ static size_t varint(uint8_t buffer[static VARINT_UINT32_BYTES],
   return 0;
 }
 
-/* format_protobuf iterates over all metric families in "metrics" and adds them
- * to a buffer in ProtoBuf format. It prefixes each protobuf with its encoded
- * size, the so called "delimited" format. */
-static void format_protobuf(ProtobufCBuffer *buffer) {
-  pthread_mutex_lock(&metrics_lock);
+/* format_protobuf iterates over all metric families in the snapshot "s" and
+ * adds them to a buffer in ProtoBuf format. It prefixes each protobuf with its
+ * encoded size, the so called "delimited" format. */
+static void format_protobuf(ProtobufCBuffer *buffer,
+                            prom_snapshot_t const *s) {
+  for (size_t f = 0; f < s->families_num; f++) {
+    Io__Prometheus__Client__MetricFamily *fam = s->families + f;
 
-  char *unused_name;
-  Io__Prometheus__Client__MetricFamily *fam;
-  c_avl_iterator_t *iter = c_avl_get_iterator(metrics);
-  while (c_avl_iterator_next(iter, (void *)&unused_name, (void *)&fam) == 0) {
     /* Prometheus uses a message length prefix to determine where one
      * MetricFamily ends and the next begins. This delimiter is encoded as a
      * "varint", which is common in Protobufs. */
@@ -98,9 +193,6 @@ static void format_protobuf(ProtobufCBuffer *buffer) {
 
     io__prometheus__client__metric_family__pack_to_buffer(fam, buffer);
   }
-  c_avl_iterator_destroy(iter);
-
-  pthread_mutex_unlock(&metrics_lock);
 }
 
 static char const *escape_label_value(char *buffer, size_t buffer_size,
@@ -173,15 +265,12 @@ static char *format_labels(char *buffer, size_t buffer_size,
   return buffer;
 }
 
-/* format_protobuf iterates over all metric families in "metrics" and adds them
- * to a buffer in plain text format. */
-static void format_text(ProtobufCBuffer *buffer) {
-  pthread_mutex_lock(&metrics_lock);
+/* format_text iterates over all metric families in the snapshot "s" and adds
+ * them to a buffer in plain text format. */
+static void format_text(ProtobufCBuffer *buffer, prom_snapshot_t const *s) {
+  for (size_t f = 0; f < s->families_num; f++) {
+    Io__Prometheus__Client__MetricFamily *fam = s->families + f;
 
-  char *unused_name;
-  Io__Prometheus__Client__MetricFamily *fam;
-  c_avl_iterator_t *iter = c_avl_get_iterator(metrics);
-  while (c_avl_iterator_next(iter, (void *)&unused_name, (void *)&fam) == 0) {
     char line[1024]; /* 4x DATA_MAX_NAME_LEN? */
 
     ssnprintf(line, sizeof(line), "# HELP %s %s\n", fam->name, fam->help);
@@ -193,10 +282,13 @@ static void format_text(ProtobufCBuffer *buffer) {
                   : "counter");
     buffer->append(buffer, strlen(line), (uint8_t *)line);
 
+    size_t name_len = strlen(fam->name);
     for (size_t i = 0; i < fam->n_metric; i++) {
-      Io__Prometheus__Client__Metric *m = fam->metric[i];
+      prom_metric_t *pm = (prom_metric_t *)fam->metric[i];
+      Io__Prometheus__Client__Metric *m = &pm->pb;
 
-      char labels[1024];
+      buffer->append(buffer, name_len, (uint8_t *)fam->name);
+      buffer->append(buffer, pm->labels_text_len, (uint8_t *)pm->labels_text);
 
       char timestamp_ms[24] = "";
       if (m->has_timestamp_ms)
@@ -204,26 +296,350 @@ static void format_text(ProtobufCBuffer *buffer) {
                   m->timestamp_ms);
 
       if (fam->type == IO__PROMETHEUS__CLIENT__METRIC_TYPE__GAUGE)
-        ssnprintf(line, sizeof(line), "%s{%s} " GAUGE_FORMAT "%s\n", fam->name,
-                  format_labels(labels, sizeof(labels), m), m->gauge->value,
+        ssnprintf(line, sizeof(line), GAUGE_FORMAT "%s\n", m->gauge->value,
                   timestamp_ms);
       else /* if (fam->type == IO__PROMETHEUS__CLIENT__METRIC_TYPE__COUNTER) */
-        ssnprintf(line, sizeof(line), "%s{%s} %.0f%s\n", fam->name,
-                  format_labels(labels, sizeof(labels), m), m->counter->value,
+        ssnprintf(line, sizeof(line), "%.0f%s\n", m->counter->value,
                   timestamp_ms);
 
       buffer->append(buffer, strlen(line), (uint8_t *)line);
     }
   }
-  c_avl_iterator_destroy(iter);
 
   char server[1024];
   ssnprintf(server, sizeof(server), "\n# collectd/write_prometheus %s at %s\n",
             PACKAGE_VERSION, hostname_g);
   buffer->append(buffer, strlen(server), (uint8_t *)server);
+}
+
+static void prom_snapshot_free(prom_snapshot_t *s) /* {{{ */
+{
+  if (s == NULL)
+    return;
+
+  for (size_t i = 0; i < SNAPSHOT_VARIANTS; i++)
+    sfree(s->data[i]);
+  sfree(s->families);
+  sfree(s->metric_ptrs);
+  sfree(s->metrics);
+  sfree(s->strings);
+  sfree(s);
+} /* }}} void prom_snapshot_free */
+
+static void prom_snapshot_unref(prom_snapshot_t *s) /* {{{ */
+{
+  if (s == NULL)
+    return;
+
+  pthread_mutex_lock(&snapshot_lock);
+  s->refcount--;
+  bool destroy = (s->refcount == 0);
+  pthread_mutex_unlock(&snapshot_lock);
+
+  if (destroy)
+    prom_snapshot_free(s);
+} /* }}} void prom_snapshot_unref */
+
+/* strings_copy copies "len" bytes of "str" to "*ptr", terminates them and
+ * advances "*ptr". */
+static char *strings_copy(char **ptr, char const *str, size_t len) /* {{{ */
+{
+  char *copy = *ptr;
+  memcpy(copy, str, len);
+  copy[len] = 0;
+  *ptr += len + 1;
+  return copy;
+} /* }}} char *strings_copy */
+
+/* prom_snapshot_copy copies all metric families to "s". Only memory for the
+ * copy is allocated and strings are copied; nothing is formatted. Must be
+ * called with "metrics_lock" held. */
+static int prom_snapshot_copy(prom_snapshot_t *s) /* {{{ */
+{
+  char *unused_name;
+  Io__Prometheus__Client__MetricFamily *fam;
+  size_t metrics_num = 0;
+  size_t strings_size = 0;
+
+  c_avl_iterator_t *iter = c_avl_get_iterator(metrics);
+  while (c_avl_iterator_next(iter, (void *)&unused_name, (void *)&fam) == 0) {
+    metric_family_sort(fam);
+
+    s->families_num++;
+    metrics_num += fam->n_metric;
+    strings_size += strlen(fam->name) + strlen(fam->help) + 2;
+    for (size_t i = 0; i < fam->n_metric; i++) {
+      prom_metric_t *pm = (prom_metric_t *)fam->metric[i];
+      strings_size += pm->labels_text_len + 1;
+      for (size_t j = 0; j < pm->pb.n_label; j++)
+        strings_size += strlen(pm->pb.label[j]->name) +
+                        strlen(pm->pb.label[j]->value) + 2;
+    }
+  }
+  c_avl_iterator_destroy(iter);
+
+  s->families = calloc(s->families_num + 1, sizeof(*s->families));
+  s->metric_ptrs = calloc(metrics_num + 1, sizeof(*s->metric_ptrs));
+  s->metrics = calloc(metrics_num + 1, sizeof(*s->metrics));
+  s->strings = malloc(strings_size + 1);
+  if ((s->families == NULL) || (s->metric_ptrs == NULL) ||
+      (s->metrics == NULL) || (s->strings == NULL))
+    return ENOMEM;
+
+  char *strings = s->strings;
+  size_t f = 0;
+  size_t m = 0;
+  iter = c_avl_get_iterator(metrics);
+  while (c_avl_iterator_next(iter, (void *)&unused_name, (void *)&fam) == 0) {
+    Io__Prometheus__Client__MetricFamily *fam_copy = s->families + f;
+    f++;
+
+    *fam_copy = *fam;
+    fam_copy->name = strings_copy(&strings, fam->name, strlen(fam->name));
+    fam_copy->help = strings_copy(&strings, fam->help, strlen(fam->help));
+    fam_copy->metric = s->metric_ptrs + m;
 
+    for (size_t i = 0; i < fam->n_metric; i++) {
+      prom_metric_t *pm = (prom_metric_t *)fam->metric[i];
+      prom_metric_copy_t *copy = s->metrics + m;
+      s->metric_ptrs[m] = &copy->m.pb;
+      m++;
+
+      copy->m.pb = pm->pb;
+      copy->m.labels_text =
+          strings_copy(&strings, pm->labels_text, pm->labels_text_len);
+      copy->m.labels_text_len = pm->labels_text_len;
+
+      copy->m.pb.label = copy->label_ptrs;
+      for (size_t j = 0; j < pm->pb.n_label; j++) {
+        Io__Prometheus__Client__LabelPair const *lp = pm->pb.label[j];
+        copy->labels[j] = *lp;
+        copy->labels[j].name =
+            strings_copy(&strings, lp->name, strlen(lp->name));
+        copy->labels[j].value =
+            strings_copy(&strings, lp->value, strlen(lp->value));
+        copy->label_ptrs[j] = copy->labels + j;
+      }
+
+      if (pm->pb.gauge != NULL) {
+        copy->gauge = *pm->pb.gauge;
+        copy->m.pb.gauge = &copy->gauge;
+      }
+      if (pm->pb.counter != NULL) {
+        copy->counter = *pm->pb.counter;
+        copy->m.pb.counter = &copy->counter;
+      }
+    }
+  }
+  c_avl_iterator_destroy(iter);
+
+  return 0;
+} /* }}} int prom_snapshot_copy */
+
+/* prom_snapshot_take returns a new snapshot of the metrics. Only copying the
+ * metrics is done while holding "metrics_lock". */
+static prom_snapshot_t *prom_snapshot_take(void) /* {{{ */
+{
+  prom_snapshot_t *s = calloc(1, sizeof(*s));
+  if (s == NULL) {
+    ERROR("write_prometheus plugin: calloc failed.");
+    return NULL;
+  }
+  s->refcount = 1; /* the reference held by "snapshot" */
+
+  pthread_mutex_lock(&metrics_lock);
+  s->generation = __atomic_load_n(&metrics_generation, __ATOMIC_ACQUIRE);
+  int status = prom_snapshot_copy(s);
   pthread_mutex_unlock(&metrics_lock);
-}
+
+  if (status != 0) {
+    ERROR("write_prometheus plugin: Copying the metrics failed.");
+    prom_snapshot_free(s);
+    return NULL;
+  }
+
+  return s;
+} /* }}} prom_snapshot_t *prom_snapshot_take */
+
+/* prom_snapshot_get returns a reference to a snapshot of the current metrics.
+ * The first scrape after the metrics have changed takes a new snapshot, while
+ * concurrent scrapes wait for and share it. Returns NULL on error. */
+static prom_snapshot_t *prom_snapshot_get(void) /* {{{ */
+{
+  prom_snapshot_t *old = NULL;
+
+  pthread_mutex_lock(&snapshot_lock);
+  uint64_t num = snapshot_num;
+  while (snapshot_taking)
+    pthread_cond_wait(&snapshot_cond, &snapshot_lock);
+
+  /* If a snapshot has been taken while waiting, use it even if the metrics
+   * have changed since, so that scrapes do not queue up behind each other
+   * while the metrics are being written to. */
+  uint64_t generation = __atomic_load_n(&metrics_generation, __ATOMIC_ACQUIRE);
+  if ((snapshot == NULL) ||
+      ((snapshot_num == num) && (snapshot->generation != generation))) {
+    snapshot_taking = true;
+    pthread_mutex_unlock(&snapshot_lock);
+    prom_snapshot_t *s = prom_snapshot_take();
+    pthread_mutex_lock(&snapshot_lock);
+    snapshot_taking = false;
+    snapshot_num++;
+
+    if (s != NULL) {
+      /* Drop the reference held by "snapshot". Scrapes still using the old
+       * snapshot keep it alive. */
+      if ((snapshot != NULL) && (--snapshot->refcount == 0))
+        old = snapshot;
+      snapshot = s;
+    }
+    pthread_cond_broadcast(&snapshot_cond);
+  }
+
+  prom_snapshot_t *s = snapshot;
+  if (s != NULL)
+    s->refcount++;
+  pthread_mutex_unlock(&snapshot_lock);
+
+  prom_snapshot_free(old);
+  return s;
+} /* }}} prom_snapshot_t *prom_snapshot_get */
+
+#if HAVE_ZLIB
+static int gzip_compress(uint8_t const *in, size_t in_size, /* {{{ */
+                         uint8_t **ret_out, size_t *ret_out_size) {
+  z_stream z = {0};
+
+  /* 16 + MAX_WBITS selects the gzip format. */
+  if (deflateInit2(&z, Z_BEST_SPEED, Z_DEFLATED, 16 + MAX_WBITS,
+                   /* memLevel = */ 8, Z_DEFAULT_STRATEGY) != Z_OK)
+    return -1;
+
+  size_t out_size = (size_t)deflateBound(&z, (uLong)in_size);
+  uint8_t *out = malloc(out_size);
+  if (out == NULL) {
+    deflateEnd(&z);
+    return ENOMEM;
+  }
+
+  z.next_in = (Bytef *)in;
+  z.avail_in = (uInt)in_size;
+  z.next_out = out;
+  z.avail_out = (uInt)out_size;
+
+  int status = deflate(&z, Z_FINISH);
+  deflateEnd(&z);
+  if (status != Z_STREAM_END) {
+    free(out);
+    return -1;
+  }
+
+  *ret_out = out;
+  *ret_out_size = out_size - z.avail_out;
+  return 0;
+} /* }}} int gzip_compress */
+#endif
+
+/* prom_snapshot_store moves the data of "simple" into the variant of "s". */
+static void prom_snapshot_store(prom_snapshot_t *s, int variant, /* {{{ */
+                               ProtobufCBufferSimple *simple) {
+  /* Take over the buffer unless it still is the scratch space. */
+  if (simple->must_free_data) {
+    s->data[variant] = simple->data;
+  } else {
+    s->data[variant] = malloc(simple->len > 0 ? simple->len : 1);
+    if (s->data[variant] == NULL) {
+      ERROR("write_prometheus plugin: malloc failed.");
+      return;
+    }
+    memcpy(s->data[variant], simple->data, simple->len);
+  }
+  s->size[variant] = simple->len;
+} /* }}} void prom_snapshot_store */
+
+/* prom_snapshot_render renders "variant" of "s" unless that has already been
+ * done. Must be called with "snapshot_lock" held, which is released while
+ * rendering. */
+static void prom_snapshot_render(prom_snapshot_t *s, int variant) /* {{{ */
+{
+  while (s->state[variant] == VARIANT_RENDERING)
+    pthread_cond_wait(&snapshot_cond, &snapshot_lock);
+  if (s->state[variant] == VARIANT_RENDERED)
+    return;
+
+  int format = variant & ~SNAPSHOT_GZIP;
+  if (variant != format)
+    prom_snapshot_render(s, format);
+
+  s->state[variant] = VARIANT_RENDERING;
+  pthread_mutex_unlock(&snapshot_lock);
+
+  if (variant == format) {
+    uint8_t scratch[4096] = {0};
+    ProtobufCBufferSimple simple = PROTOBUF_C_BUFFER_SIMPLE_INIT(scratch);
+    if (format == SNAPSHOT_PROTO)
+      format_protobuf((ProtobufCBuffer *)&simple, s);
+    else
+      format_text((ProtobufCBuffer *)&simple, s);
+    prom_snapshot_store(s, variant, &simple);
+  }
+#if HAVE_ZLIB
+  else if (s->data[format] != NULL) {
+    /* The uncompressed variant is not modified once it has been rendered. */
+    int status = gzip_compress(s->data[format], s->size[format],
+                               &s->data[variant], &s->size[variant]);
+    if (status != 0)
+      ERROR("write_prometheus plugin: Compressing the metrics failed.");
+  }
+#endif
+
+  pthread_mutex_lock(&snapshot_lock);
+  s->state[variant] = VARIANT_RENDERED;
+  pthread_cond_broadcast(&snapshot_cond);
+} /* }}} void prom_snapshot_render */
+
+/* accepts_gzip returns true if the value of an Accept-Encoding header allows
+ * a gzip encoded response. Codings with a quality value of zero, e.g.
+ * "gzip;q=0", are not acceptable; "*" matches gzip unless it is listed. */
+static bool accepts_gzip(char const *accept_encoding) /* {{{ */
+{
+  if (accept_encoding == NULL)
+    return false;
+
+  char *copy = strdup(accept_encoding);
+  if (copy == NULL)
+    return false;
+
+  int gzip = -1; /* -1: not listed, 0: not acceptable, 1: acceptable */
+  int any = -1;
+
+  char *saveptr = NULL;
+  for (char *coding = strtok_r(copy, ",", &saveptr); coding != NULL;
+       coding = strtok_r(NULL, ",", &saveptr)) {
+    char *param_saveptr = NULL;
+    char *name = strtok_r(coding, ";", &param_saveptr);
+    if (name == NULL)
+      continue;
+    name += strspn(name, " \t");
+    name[strcspn(name, " \t")] = 0;
+
+    double q = 1.0;
+    for (char *param = strtok_r(NULL, ";", &param_saveptr); param != NULL;
+         param = strtok_r(NULL, ";", &param_saveptr)) {
+      param += strspn(param, " \t");
+      if (((param[0] == 'q') || (param[0] == 'Q')) && (param[1] == '='))
+        q = strtod(param + 2, NULL);
+    }
+
+    if (strcasecmp("gzip", name) == 0 || strcasecmp("x-gzip", name) == 0)
+      gzip = (q > 0.0);
+    else if (strcmp("*", name) == 0)
+      any = (q > 0.0);
+  }
+
+  free(copy);
+  return (gzip != -1) ? (gzip == 1) : (any == 1);
+} /* }}} bool accepts_gzip */
 
 /* http_handler is the callback called by the microhttpd library. It essentially
  * handles all HTTP request aspects and creates an HTTP response. */
@@ -249,29 +665,52 @@ static int http_handler(void *cls, struct MHD_Connection *connection,
   bool want_proto = (accept != NULL) &&
                     (strstr(accept, "application/vnd.google.protobuf") != NULL);
 
-  uint8_t scratch[4096] = {0};
-  ProtobufCBufferSimple simple = PROTOBUF_C_BUFFER_SIMPLE_INIT(scratch);
-  ProtobufCBuffer *buffer = (ProtobufCBuffer *)&simple;
+  char const *accept_encoding = MHD_lookup_connection_value(
+      connection, MHD_HEADER_KIND, MHD_HTTP_HEADER_ACCEPT_ENCODING);
+
+  prom_snapshot_t *s = prom_snapshot_get();
+  if (s == NULL)
+    return MHD_NO;
+
+  int variant = want_proto ? SNAPSHOT_PROTO : SNAPSHOT_TEXT;
+  pthread_mutex_lock(&snapshot_lock);
+#if HAVE_ZLIB
+  if (accepts_gzip(accept_encoding)) {
+    prom_snapshot_render(s, variant | SNAPSHOT_GZIP);
+    /* Fall back to an uncompressed response if compression failed. */
+    if (s->data[variant | SNAPSHOT_GZIP] != NULL)
+      variant |= SNAPSHOT_GZIP;
+  }
+#endif
+  prom_snapshot_render(s, variant);
+  pthread_mutex_unlock(&snapshot_lock);
 
-  if (want_proto)
-    format_protobuf(buffer);
-  else
-    format_text(buffer);
+  /* Rendered variants are never modified, so they can be read without a
+   * lock. */
+  if (s->data[variant] == NULL) {
+    prom_snapshot_unref(s);
+    return MHD_NO;
+  }
 
 #if defined(MHD_VERSION) && MHD_VERSION >= 0x00090500
   struct MHD_Response *res = MHD_create_response_from_buffer(
-      simple.len, simple.data, MHD_RESPMEM_MUST_COPY);
+      s->size[variant], s->data[variant], MHD_RESPMEM_MUST_COPY);
 #else
   struct MHD_Response *res = MHD_create_response_from_data(
-      simple.len, simple.data, /* must_free = */ 0, /* must_copy = */ 1);
+      s->size[variant], s->data[variant], /* must_free = */ 0,
+      /* must_copy = */ 1);
 #endif
+  prom_snapshot_unref(s);
+
   MHD_add_response_header(res, MHD_HTTP_HEADER_CONTENT_TYPE,
                           want_proto ? CONTENT_TYPE_PROTO : CONTENT_TYPE_TEXT);
+  if (variant & SNAPSHOT_GZIP)
+    MHD_add_response_header(res, MHD_HTTP_HEADER_CONTENT_ENCODING, "gzip");
+  MHD_add_response_header(res, MHD_HTTP_HEADER_VARY, "Accept-Encoding");
 
   int status = MHD_queue_response(connection, MHD_HTTP_OK, res);
 
   MHD_destroy_response(res);
-  PROTOBUF_C_BUFFER_SIMPLE_CLEAR(&simple);
   return status;
 }
 
@@ -333,6 +772,7 @@ static void metric_destroy(Io__Prometheus__Client__Metric *msg) {
   sfree(msg->gauge);
   sfree(msg->counter);
 
+  sfree(((prom_metric_t *)msg)->labels_text);
   sfree(msg);
 }
 
@@ -424,12 +864,15 @@ static int metric_cmp(void const *a, void const *b) {
     (m)->n_label++;                                                            \
   } while (0)
 
-/* metric_clone allocates and initializes a new metric based on orig. */
+/* metric_clone allocates and initializes a new metric based on orig. The
+ * metric is allocated as a prom_metric_t and its labels are formatted for the
+ * text format right away. */
 static Io__Prometheus__Client__Metric *
 metric_clone(Io__Prometheus__Client__Metric const *orig) {
-  Io__Prometheus__Client__Metric *copy = calloc(1, sizeof(*copy));
-  if (copy == NULL)
+  prom_metric_t *pm = calloc(1, sizeof(*pm));
+  if (pm == NULL)
     return NULL;
+  Io__Prometheus__Client__Metric *copy = &pm->pb;
   io__prometheus__client__metric__init(copy);
 
   copy->n_label = orig->n_label;
@@ -447,6 +890,16 @@ metric_clone(Io__Prometheus__Client__Metric const *orig) {
     }
   }
 
+  char labels[1024];
+  format_labels(labels, sizeof(labels), copy);
+  pm->labels_text_len = strlen(labels) + strlen("{} ");
+  pm->labels_text = malloc(pm->labels_text_len + 1);
+  if (pm->labels_text == NULL) {
+    metric_destroy(copy);
+    return NULL;
+  }
+  ssnprintf(pm->labels_text, pm->labels_text_len + 1, "{%s} ", labels);
+
   return copy;
 }
 
@@ -510,21 +963,153 @@ static int metric_update(Io__Prometheus__Client__Metric *m, value_t value,
   return 0;
 }
 
-/* metric_family_add_metric adds m to the metric list of fam. */
+/* metric_hash returns the 64 bit FNV-1a hash of a metric's label values. Like
+ * metric_cmp(), it ignores the label names. */
+static uint64_t metric_hash(Io__Prometheus__Client__Metric const *m) {
+  uint64_t hash = 14695981039346656037ULL;
+
+  for (size_t i = 0; i < m->n_label; i++) {
+    /* Include the terminating null byte so that the boundaries between the
+     * values are part of the hash. */
+    for (char const *c = m->label[i]->value;; c++) {
+      hash ^= (uint64_t)(unsigned char)*c;
+      hash *= 1099511628211ULL;
+      if (*c == 0)
+        break;
+    }
+  }
+
+  return hash;
+}
+
+/* metric_family_index_find returns the position of the metric matching key in
+ * the index, or the position of the empty entry terminating its probe
+ * sequence. */
+static size_t metric_family_index_find(prom_family_t const *pf, uint64_t hash,
+                                       Io__Prometheus__Client__Metric *key) {
+  size_t mask = pf->index_size - 1;
+
+  for (size_t i = (size_t)hash & mask;; i = (i + 1) & mask) {
+    if (pf->index[i] == 0)
+      return i;
+
+    prom_metric_t *pm = pf->slots[pf->index[i] - 1];
+    Io__Prometheus__Client__Metric *m = &pm->pb;
+    if ((pm->hash == hash) && (metric_cmp(&key, &m) == 0))
+      return i;
+  }
+}
+
+/* metric_family_index_grow doubles the size of the index and re-inserts all
+ * metrics. */
+static int metric_family_index_grow(prom_family_t *pf) {
+  size_t index_size = (pf->index_size == 0) ? 16 : 2 * pf->index_size;
+  uint32_t *index = calloc(index_size, sizeof(*index));
+  if (index == NULL)
+    return ENOMEM;
+
+  size_t mask = index_size - 1;
+  for (size_t slot = 0; slot < pf->slots_num; slot++) {
+    if (pf->slots[slot] == NULL)
+      continue;
+
+    size_t i = (size_t)pf->slots[slot]->hash & mask;
+    while (index[i] != 0)
+      i = (i + 1) & mask;
+    index[i] = (uint32_t)(slot + 1);
+  }
+
+  sfree(pf->index);
+  pf->index = index;
+  pf->index_size = index_size;
+  return 0;
+}
+
+/* metric_family_index_remove removes the entry at position pos from the index.
+ * Following entries of the probe sequence are moved back, so that no
+ * tombstones are needed. */
+static void metric_family_index_remove(prom_family_t *pf, size_t pos) {
+  size_t mask = pf->index_size - 1;
+  size_t i = pos;
+
+  pf->index[i] = 0;
+  for (size_t j = (i + 1) & mask; pf->index[j] != 0; j = (j + 1) & mask) {
+    size_t home = (size_t)pf->slots[pf->index[j] - 1]->hash & mask;
+
+    /* The entry at j may stay if its home position lies cyclically in
+     * (i, j]. */
+    bool stays = (i <= j) ? ((i < home) && (home <= j))
+                          : ((i < home) || (home <= j));
+    if (stays)
+      continue;
+
+    pf->index[i] = pf->index[j];
+    pf->index[j] = 0;
+    i = j;
+  }
+}
+
+/* metric_family_add_metric adds m to fam. The slot is taken from the free list
+ * if possible. */
 static int metric_family_add_metric(Io__Prometheus__Client__MetricFamily *fam,
                                     Io__Prometheus__Client__Metric *m) {
-  Io__Prometheus__Client__Metric **tmp =
-      realloc(fam->metric, (fam->n_metric + 1) * sizeof(*fam->metric));
-  if (tmp == NULL)
-    return ENOMEM;
-  fam->metric = tmp;
+  prom_family_t *pf = (prom_family_t *)fam;
+  prom_metric_t *pm = (prom_metric_t *)m;
 
-  fam->metric[fam->n_metric] = m;
-  fam->n_metric++;
+  /* Keep the load factor of the index at or below one half. */
+  if (2 * (pf->metrics_num + 1) > pf->index_size) {
+    int status = metric_family_index_grow(pf);
+    if (status != 0)
+      return status;
+  }
 
-  /* Sort the metrics so that lookup is fast. */
-  qsort(fam->metric, fam->n_metric, sizeof(*fam->metric), metric_cmp);
+  if ((pf->free_slots_num == 0) && (pf->slots_num == pf->slots_size)) {
+    size_t slots_size = (pf->slots_size == 0) ? 16 : 2 * pf->slots_size;
+    if (slots_size > UINT32_MAX)
+      return ENOMEM;
+
+    prom_metric_t **slots =
+        realloc(pf->slots, slots_size * sizeof(*pf->slots));
+    if (slots == NULL)
+      return ENOMEM;
+    pf->slots = slots;
+
+    uint32_t *free_slots =
+        realloc(pf->free_slots, slots_size * sizeof(*pf->free_slots));
+    if (free_slots == NULL)
+      return ENOMEM;
+    pf->free_slots = free_slots;
+
+    /* pb.metric is filled in by metric_family_sort() and never needs more
+     * entries than there are slots. */
+    Io__Prometheus__Client__Metric **metric =
+        realloc(fam->metric, slots_size * sizeof(*fam->metric));
+    if (metric == NULL)
+      return ENOMEM;
+    fam->metric = metric;
+
+    pf->slots_size = slots_size;
+  }
+
+  size_t slot;
+  if (pf->free_slots_num > 0) {
+    pf->free_slots_num--;
+    slot = pf->free_slots[pf->free_slots_num];
+  } else {
+    slot = pf->slots_num;
+    pf->slots_num++;
+  }
+
+  pm->hash = metric_hash(m);
+  pm->slot = (uint32_t)slot;
+  pf->slots[slot] = pm;
 
+  size_t pos = metric_family_index_find(pf, pm->hash, m);
+  assert(pf->index[pos] == 0);
+  pf->index[pos] = (uint32_t)(slot + 1);
+
+  pf->metrics_num++;
+  pf->unsorted = true;
   return 0;
 }
 
@@ -533,52 +1118,66 @@ static int metric_family_add_metric(Io__Prometheus__Client__MetricFamily *fam,
 static int
 metric_family_delete_metric(Io__Prometheus__Client__MetricFamily *fam,
                             value_list_t const *vl) {
+  prom_family_t *pf = (prom_family_t *)fam;
+  if (pf->metrics_num == 0)
+    return ENOENT;
+
   Io__Prometheus__Client__Metric *key = METRIC_INIT;
   METRIC_ADD_LABELS(key, vl);
 
-  size_t i;
-  for (i = 0; i < fam->n_metric; i++) {
-    if (metric_cmp(&key, &fam->metric[i]) == 0)
-      break;
-  }
-
-  if (i >= fam->n_metric)
+  size_t pos = metric_family_index_find(pf, metric_hash(key), key);
+  if (pf->index[pos] == 0)
     return ENOENT;
 
-  metric_destroy(fam->metric[i]);
-  if ((fam->n_metric - 1) > i)
-    memmove(&fam->metric[i], &fam->metric[i + 1],
-            ((fam->n_metric - 1) - i) * sizeof(fam->metric[i]));
-  fam->n_metric--;
+  size_t slot = pf->index[pos] - 1;
+  metric_family_index_remove(pf, pos);
 
-  if (fam->n_metric == 0) {
-    sfree(fam->metric);
-    return 0;
-  }
-
-  Io__Prometheus__Client__Metric **tmp =
-      realloc(fam->metric, fam->n_metric * sizeof(*fam->metric));
-  if (tmp != NULL)
-    fam->metric = tmp;
+  metric_destroy(&pf->slots[slot]->pb);
+  pf->slots[slot] = NULL;
+  pf->free_slots[pf->free_slots_num] = (uint32_t)slot;
+  pf->free_slots_num++;
 
+  pf->metrics_num--;
+  pf->unsorted = true;
   return 0;
 }
 
+/* metric_family_sort fills the pb.metric array of a metric family with all of
+ * its metrics, sorted by their labels. This is done when the metrics are
+ * rendered and only if metrics have been added or deleted since the last
+ * time. */
+static void metric_family_sort(Io__Prometheus__Client__MetricFamily *fam) {
+  prom_family_t *pf = (prom_family_t *)fam;
+  if (!pf->unsorted)
+    return;
+
+  fam->n_metric = 0;
+  for (size_t slot = 0; slot < pf->slots_num; slot++) {
+    if (pf->slots[slot] != NULL) {
+      fam->metric[fam->n_metric] = &pf->slots[slot]->pb;
+      fam->n_metric++;
+    }
+  }
+  assert(fam->n_metric == pf->metrics_num);
+
+  qsort(fam->metric, fam->n_metric, sizeof(*fam->metric), metric_cmp);
+  pf->unsorted = false;
+}
+
 /* metric_family_get_metric looks up the matching metric in a metric family,
  * allocating it if necessary. */
 static Io__Prometheus__Client__Metric *
 metric_family_get_metric(Io__Prometheus__Client__MetricFamily *fam,
                          value_list_t const *vl) {
+  prom_family_t *pf = (prom_family_t *)fam;
+
   Io__Prometheus__Client__Metric *key = METRIC_INIT;
   METRIC_ADD_LABELS(key, vl);
 
-  /* Metrics are sorted in metric_family_add_metric() so that we can do a binary
-   * search here. */
-  Io__Prometheus__Client__Metric **m = bsearch(
-      &key, fam->metric, fam->n_metric, sizeof(*fam->metric), metric_cmp);
-
-  if (m != NULL) {
-    return *m;
+  if (pf->metrics_num > 0) {
+    size_t pos = metric_family_index_find(pf, metric_hash(key), key);
+    if (pf->index[pos] != 0)
+      return &pf->slots[pf->index[pos] - 1]->pb;
   }
 
   Io__Prometheus__Client__Metric *new_metric = metric_clone(key);
@@ -613,12 +1212,18 @@ static void metric_family_destroy(Io__Prometheus__Client__MetricFamily *msg) {
   if (msg == NULL)
     return;
 
+  prom_family_t *pf = (prom_family_t *)msg;
+
   sfree(msg->name);
   sfree(msg->help);
 
-  for (size_t i = 0; i < msg->n_metric; i++) {
-    metric_destroy(msg->metric[i]);
+  for (size_t i = 0; i < pf->slots_num; i++) {
+    if (pf->slots[i] != NULL)
+      metric_destroy(&pf->slots[i]->pb);
   }
+  sfree(pf->slots);
+  sfree(pf->free_slots);
+  sfree(pf->index);
   sfree(msg->metric);
 
   sfree(msg);
@@ -628,9 +1233,10 @@ static void metric_family_destroy(Io__Prometheus__Client__MetricFamily *msg) {
 static Io__Prometheus__Client__MetricFamily *
 metric_family_create(char *name, data_set_t const *ds, value_list_t const *vl,
                      size_t ds_index) {
-  Io__Prometheus__Client__MetricFamily *msg = calloc(1, sizeof(*msg));
-  if (msg == NULL)
+  prom_family_t *pf = calloc(1, sizeof(*pf));
+  if (pf == NULL)
     return NULL;
+  Io__Prometheus__Client__MetricFamily *msg = &pf->pb;
   io__prometheus__client__metric_family__init(msg);
 
   msg->name = name;
@@ -926,6 +1532,7 @@ static int prom_write(data_set_t const *ds, value_list_t const *vl,
     }
   }
 
+  __atomic_add_fetch(&metrics_generation, 1, __ATOMIC_RELEASE);
   pthread_mutex_unlock(&metrics_lock);
   return 0;
 }
@@ -953,7 +1560,7 @@ static int prom_missing(value_list_t const *vl,
       continue;
     }
 
-    if (fam->n_metric == 0) {
+    if (((prom_family_t *)fam)->metrics_num == 0) {
       int status = c_avl_remove(metrics, fam->name, NULL, NULL);
       if (status != 0) {
         ERROR("write_prometheus plugin: Deleting metric family \"%s\" failed "
@@ -965,6 +1572,7 @@ static int prom_missing(value_list_t const *vl,
     }
   }
 
+  __atomic_add_fetch(&metrics_generation, 1, __ATOMIC_RELEASE);
   pthread_mutex_unlock(&metrics_lock);
   return 0;
 }
@@ -990,6 +1598,13 @@ static int prom_shutdown() {
   }
   pthread_mutex_unlock(&metrics_lock);
 
+  pthread_mutex_lock(&snapshot_lock);
+  prom_snapshot_t *s = snapshot;
+  snapshot = NULL;
+  pthread_mutex_unlock(&snapshot_lock);
+  /* The HTTP daemon has been stopped, so this is the last reference. */
+  prom_snapshot_free(s);
+
   sfree(httpd_host);
 
   return 0;
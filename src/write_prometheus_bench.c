@@ -0,0 +1,114 @@
+/**
+ * collectd - src/write_prometheus_bench.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+/*
+ * Measures how fast a large metric family handles instances coming and going,
+ * e.g. the network interfaces of containers. Build with
+ * "make bench_write_prometheus" and run as
+ * "./bench_write_prometheus [metrics] [rounds]".
+ *
+ * Every round replaces 10% of the family's metrics and then sorts the family,
+ * as a scrape does.
+ */
+
+#include "write_prometheus.c" /* sic */
+
+static data_source_t bench_dsrc = {"value", DS_TYPE_DERIVE, 0.0, NAN};
+static data_set_t bench_ds = {"if_octets", 1, &bench_dsrc};
+
+static void set_instance(value_list_t *vl, int instance) {
+  ssnprintf(vl->plugin_instance, sizeof(vl->plugin_instance), "veth%08x",
+            (unsigned int)instance);
+}
+
+static cdtime_t now(void) {
+  struct timespec ts = {0};
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return TIMESPEC_TO_CDTIME_T(&ts);
+}
+
+int main(int argc, char **argv) {
+  int metrics_num = (argc > 1) ? atoi(argv[1]) : 20000;
+  int rounds = (argc > 2) ? atoi(argv[2]) : 50;
+  if ((metrics_num < 10) || (rounds < 1)) {
+    fprintf(stderr, "Usage: %s [metrics] [rounds]\n", argv[0]);
+    return 1;
+  }
+
+  value_list_t vl = VALUE_LIST_INIT;
+  sstrncpy(vl.host, "example.com", sizeof(vl.host));
+  sstrncpy(vl.plugin, "interface", sizeof(vl.plugin));
+  sstrncpy(vl.type, "if_octets", sizeof(vl.type));
+  vl.values = &(value_t){.derive = 42};
+  vl.values_len = 1;
+
+  char *name = metric_family_name(&bench_ds, &vl, 0);
+  Io__Prometheus__Client__MetricFamily *fam =
+      (name != NULL) ? metric_family_create(name, &bench_ds, &vl, 0) : NULL;
+  if (fam == NULL) {
+    fprintf(stderr, "Creating the metric family failed.\n");
+    return 1;
+  }
+
+  cdtime_t start = now();
+
+  int failed = 0;
+  for (int i = 0; i < metrics_num; i++) {
+    set_instance(&vl, i);
+    if (metric_family_update(fam, &bench_ds, &vl, 0) != 0)
+      failed++;
+  }
+
+  int first = 0;
+  int next = metrics_num;
+  for (int round = 0; round < rounds; round++) {
+    for (int i = 0; i < metrics_num / 10; i++) {
+      set_instance(&vl, first);
+      if (metric_family_delete_metric(fam, &vl) != 0)
+        failed++;
+      first++;
+
+      set_instance(&vl, next);
+      if (metric_family_update(fam, &bench_ds, &vl, 0) != 0)
+        failed++;
+      next++;
+    }
+
+    metric_family_sort(fam);
+    if (fam->n_metric != (size_t)metrics_num)
+      failed++;
+  }
+
+  double seconds = CDTIME_T_TO_DOUBLE(now() - start);
+  int changes = metrics_num + 2 * rounds * (metrics_num / 10);
+  metric_family_destroy(fam);
+
+  if (failed != 0) {
+    fprintf(stderr, "%d updates failed.\n", failed);
+    return 1;
+  }
+
+  printf("churn %10.0f changes/s (%d changes, %d sorts)\n",
+         (double)changes / seconds, changes, rounds);
+  return 0;
+}
@@ -0,0 +1,124 @@
+/**
+ * collectd - src/write_prometheus_test.c
+ * Copyright (C) 2026       collectd contributors
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ **/
+
+#include "write_prometheus.c" /* sic */
+
+#include "testing.h"
+
+static data_source_t test_dsrc = {"value", DS_TYPE_DERIVE, 0.0, NAN};
+static data_set_t test_ds = {"if_octets", 1, &test_dsrc};
+
+static void set_instance(value_list_t *vl, int instance) {
+  ssnprintf(vl->plugin_instance, sizeof(vl->plugin_instance), "veth%08x",
+            (unsigned int)instance);
+}
+
+static Io__Prometheus__Client__MetricFamily *test_family(value_list_t *vl) {
+  sstrncpy(vl->host, "example.com", sizeof(vl->host));
+  sstrncpy(vl->plugin, "interface", sizeof(vl->plugin));
+  sstrncpy(vl->type, "if_octets", sizeof(vl->type));
+  vl->values = &(value_t){.derive = 42};
+  vl->values_len = 1;
+
+  char *name = metric_family_name(&test_ds, vl, 0);
+  if (name == NULL)
+    return NULL;
+  return metric_family_create(name, &test_ds, vl, 0);
+}
+
+static bool family_is_sorted(Io__Prometheus__Client__MetricFamily *fam) {
+  for (size_t i = 1; i < fam->n_metric; i++) {
+    if (metric_cmp(&fam->metric[i - 1], &fam->metric[i]) >= 0)
+      return false;
+  }
+  return true;
+}
+
+DEF_TEST(metric_family_index) {
+  value_list_t vl = VALUE_LIST_INIT;
+  Io__Prometheus__Client__MetricFamily *fam;
+  CHECK_NOT_NULL(fam = test_family(&vl));
+  prom_family_t *pf = (prom_family_t *)fam;
+
+  Io__Prometheus__Client__Metric *metrics[1000];
+  int failed = 0;
+  for (int i = 0; i < 1000; i++) {
+    set_instance(&vl, i);
+    metrics[i] = metric_family_get_metric(fam, &vl);
+    if (metrics[i] == NULL)
+      failed++;
+  }
+  EXPECT_EQ_INT(0, failed);
+  EXPECT_EQ_INT(1000, (int)pf->metrics_num);
+
+  /* Looking up existing label sets returns the same metric. */
+  for (int i = 999; i >= 0; i--) {
+    set_instance(&vl, i);
+    if (metric_family_get_metric(fam, &vl) != metrics[i])
+      failed++;
+  }
+  EXPECT_EQ_INT(0, failed);
+  EXPECT_EQ_INT(1000, (int)pf->metrics_num);
+
+  for (int i = 0; i < 1000; i += 2) {
+    set_instance(&vl, i);
+    if (metric_family_delete_metric(fam, &vl) != 0)
+      failed++;
+  }
+  EXPECT_EQ_INT(0, failed);
+  EXPECT_EQ_INT(500, (int)pf->metrics_num);
+
+  set_instance(&vl, 0);
+  EXPECT_EQ_INT(ENOENT, metric_family_delete_metric(fam, &vl));
+
+  /* The remaining metrics are still found ... */
+  for (int i = 1; i < 1000; i += 2) {
+    set_instance(&vl, i);
+    if (metric_family_get_metric(fam, &vl) != metrics[i])
+      failed++;
+  }
+  EXPECT_EQ_INT(0, failed);
+
+  /* ... and new ones reuse the free slots. */
+  for (int i = 1000; i < 1500; i++) {
+    set_instance(&vl, i);
+    if (metric_family_get_metric(fam, &vl) == NULL)
+      failed++;
+  }
+  EXPECT_EQ_INT(0, failed);
+  EXPECT_EQ_INT(1000, (int)pf->metrics_num);
+  EXPECT_EQ_INT(1000, (int)pf->slots_num);
+
+  metric_family_sort(fam);
+  EXPECT_EQ_INT(1000, (int)fam->n_metric);
+  OK(family_is_sorted(fam));
+
+  metric_family_destroy(fam);
+  return 0;
+}
+
+int main(void) {
+  RUN_TEST(metric_family_index);
+
+  END_TEST;
+}